@@ -6,6 +6,7 @@
 #include <fc/io/raw.hpp>
 #include <boost/algorithm/string/predicate.hpp>
 #include <fc/io/varint.hpp>
+#include <fc/io/json.hpp>
 
 using namespace boost;
 
@@ -13,6 +14,7 @@ using namespace boost;
 namespace eosio { namespace chain {
 
    const size_t abi_serializer::max_recursion_depth;
+   const uint32_t abi_serializer::deadline_check_interval;
 
    using boost::algorithm::ends_with;
    using std::string;
@@ -34,44 +36,49 @@ namespace eosio { namespace chain {
       return fc::variant( temp, y );
    }
 
-   template <typename T>
-   auto pack_function() {
-      return []( const fc::variant& var, fc::datastream<char*>& ds, bool is_array, bool is_optional, const abi_serializer::yield_function_t& yield ){
-         if( is_array )
-            fc::raw::pack( ds, var.as<vector<T>>() );
-         else if ( is_optional )
-            fc::raw::pack( ds, var.as<optional<T>>() );
-         else
-            fc::raw::pack( ds,  var.as<T>());
-      };
+   template <typename T, bool Deadline>
+   fc::variant unpack_built_in( fc::datastream<const char*>& stream, bool is_array, bool is_optional,
+                                const abi_serializer::yield_function_t& yield ) {
+      if( is_array )
+         return variant_from_stream<vector<T>>(stream);
+      else if ( is_optional )
+         return variant_from_stream<optional<T>>(stream);
+      if( Deadline )
+         return variant_from_stream<T>(stream, yield);
+      return variant_from_stream<T>(stream);
    }
 
    template <typename T>
+   void pack_built_in( const fc::variant& var, fc::datastream<char*>& ds, bool is_array, bool is_optional ) {
+      if( is_array )
+         fc::raw::pack( ds, var.as<vector<T>>() );
+      else if ( is_optional )
+         fc::raw::pack( ds, var.as<optional<T>>() );
+      else
+         fc::raw::pack( ds,  var.as<T>());
+   }
+
+   template <typename T, bool Deadline>
    auto pack_unpack() {
       return std::make_pair<abi_serializer::unpack_function, abi_serializer::pack_function>(
-         []( fc::datastream<const char*>& stream, bool is_array, bool is_optional, const abi_serializer::yield_function_t& yield) {
-            if( is_array )
-               return variant_from_stream<vector<T>>(stream);
-            else if ( is_optional )
-               return variant_from_stream<optional<T>>(stream);
-            return variant_from_stream<T>(stream);
-         },
-         pack_function<T>()
+         &unpack_built_in<T, Deadline>,
+         []( const fc::variant& var, fc::datastream<char*>& ds, bool is_array, bool is_optional, const abi_serializer::yield_function_t& ) {
+            pack_built_in<T>( var, ds, is_array, is_optional );
+         }
       );
    }
 
-   template <typename T>
-   auto pack_unpack_deadline() {
-      return std::make_pair<abi_serializer::unpack_function, abi_serializer::pack_function>(
-         []( fc::datastream<const char*>& stream, bool is_array, bool is_optional, const abi_serializer::yield_function_t& yield) {
-            if( is_array )
-               return variant_from_stream<vector<T>>(stream);
-            else if ( is_optional )
-               return variant_from_stream<optional<T>>(stream);
-            return variant_from_stream<T>(stream, yield);
-         },
-         pack_function<T>()
-      );
+   /// calls f with a null pointer to the C++ type of kind and the deadline flag of its row in EOSIO_ABI_BUILT_IN_TYPES
+   template <typename Kind, typename F>
+   decltype(auto) visit_built_in( Kind kind, F&& f ) {
+      switch( kind ) {
+#define EOSIO_ABI_BUILT_IN_CASE(abi_name, kind, type, deadline) \
+         case Kind::kind: return f( static_cast<type*>(nullptr), std::integral_constant<bool, deadline>() );
+         EOSIO_ABI_BUILT_IN_TYPES(EOSIO_ABI_BUILT_IN_CASE)
+#undef EOSIO_ABI_BUILT_IN_CASE
+         default: break;
+      }
+      EOS_THROW( invalid_type_inside_abi, "type has no built-in encoding" );
    }
 
    abi_serializer::abi_serializer( const abi_def& abi, const yield_function_t& yield ) {
@@ -79,52 +86,67 @@ namespace eosio { namespace chain {
       set_abi(abi, yield);
    }
 
+   abi_serializer::abi_serializer( const abi_serializer& other )
+   :typedefs( other.typedefs )
+   ,structs( other.structs )
+   ,actions( other.actions )
+   ,tables( other.tables )
+   ,error_messages( other.error_messages )
+   ,variants( other.variants )
+   ,built_in_types( other.built_in_types )
+   ,specialized_types( other.specialized_types )
+   {
+      // plans refer into the maps of the serializer they were built for
+      build_type_plans();
+   }
+
+   abi_serializer& abi_serializer::operator=( const abi_serializer& other ) {
+      if( this != &other ) {
+         typedefs       = other.typedefs;
+         structs        = other.structs;
+         actions        = other.actions;
+         tables         = other.tables;
+         error_messages = other.error_messages;
+         variants       = other.variants;
+         built_in_types = other.built_in_types;
+         specialized_types = other.specialized_types;
+         build_type_plans();
+      }
+      return *this;
+   }
+
    void abi_serializer::add_specialized_unpack_pack( const string& name,
                                                      std::pair<abi_serializer::unpack_function, abi_serializer::pack_function> unpack_pack ) {
       built_in_types[name] = std::move( unpack_pack );
+      specialized_types.insert( name );
+      build_type_plans();
    }
 
    void abi_serializer::configure_built_in_types() {
+#define EOSIO_ABI_BUILT_IN_ENTRY(abi_name, kind, type, deadline) \
+      built_in_types.emplace(abi_name, pack_unpack<type, deadline>());
+      EOSIO_ABI_BUILT_IN_TYPES(EOSIO_ABI_BUILT_IN_ENTRY)
+#undef EOSIO_ABI_BUILT_IN_ENTRY
+   }
 
-      built_in_types.emplace("bool",                      pack_unpack<uint8_t>());
-      built_in_types.emplace("int8",                      pack_unpack<int8_t>());
-      built_in_types.emplace("uint8",                     pack_unpack<uint8_t>());
-      built_in_types.emplace("int16",                     pack_unpack<int16_t>());
-      built_in_types.emplace("uint16",                    pack_unpack<uint16_t>());
-      built_in_types.emplace("int32",                     pack_unpack<int32_t>());
-      built_in_types.emplace("uint32",                    pack_unpack<uint32_t>());
-      built_in_types.emplace("int64",                     pack_unpack<int64_t>());
-      built_in_types.emplace("uint64",                    pack_unpack<uint64_t>());
-      built_in_types.emplace("int128",                    pack_unpack<int128_t>());
-      built_in_types.emplace("uint128",                   pack_unpack<uint128_t>());
-      built_in_types.emplace("varint32",                  pack_unpack<fc::signed_int>());
-      built_in_types.emplace("varuint32",                 pack_unpack<fc::unsigned_int>());
-
-      // TODO: Add proper support for floating point types. For now this is good enough.
-      built_in_types.emplace("float32",                   pack_unpack<float>());
-      built_in_types.emplace("float64",                   pack_unpack<double>());
-      built_in_types.emplace("float128",                  pack_unpack<float128_t>());
-
-      built_in_types.emplace("time_point",                pack_unpack<fc::time_point>());
-      built_in_types.emplace("time_point_sec",            pack_unpack<fc::time_point_sec>());
-      built_in_types.emplace("block_timestamp_type",      pack_unpack<block_timestamp_type>());
-
-      built_in_types.emplace("name",                      pack_unpack<name>());
-
-      built_in_types.emplace("bytes",                     pack_unpack<bytes>());
-      built_in_types.emplace("string",                    pack_unpack<string>());
-
-      built_in_types.emplace("checksum160",               pack_unpack<checksum160_type>());
-      built_in_types.emplace("checksum256",               pack_unpack<checksum256_type>());
-      built_in_types.emplace("checksum512",               pack_unpack<checksum512_type>());
-
-      built_in_types.emplace("public_key",                pack_unpack_deadline<public_key_type>());
-      built_in_types.emplace("signature",                 pack_unpack_deadline<signature_type>());
+   abi_serializer::built_in_kind abi_serializer::built_in_kind_of( const std::string_view& type ) {
+      static const std::unordered_map<std::string_view, built_in_kind> kinds = {
+#define EOSIO_ABI_BUILT_IN_KIND_NAME(abi_name, kind, type, deadline) { abi_name, built_in_kind::kind },
+         EOSIO_ABI_BUILT_IN_TYPES(EOSIO_ABI_BUILT_IN_KIND_NAME)
+#undef EOSIO_ABI_BUILT_IN_KIND_NAME
+      };
+      auto itr = kinds.find( type );
+      return itr == kinds.end() ? built_in_kind::none : itr->second;
+   }
 
-      built_in_types.emplace("symbol",                    pack_unpack<symbol>());
-      built_in_types.emplace("symbol_code",               pack_unpack<symbol_code>());
-      built_in_types.emplace("asset",                     pack_unpack<asset>());
-      built_in_types.emplace("extended_asset",            pack_unpack<extended_asset>());
+   fc::variant abi_serializer::unpack_built_in_value( const type_plan& plan, fc::datastream<const char*>& stream,
+                                                      impl::binary_to_variant_context& ctx )const {
+      if( plan.kind == built_in_kind::none )
+         return plan.built_in->first(stream, plan.array_type, plan.optional_type, ctx.get_yield_function());
+      return visit_built_in( plan.kind, [&]( auto* t, auto deadline ) {
+         return unpack_built_in<std::remove_pointer_t<decltype(t)>, decltype(deadline)::value>(
+                   stream, plan.array_type, plan.optional_type, ctx.get_yield_function() );
+      } );
    }
 
    void abi_serializer::set_abi(const abi_def& abi, const yield_function_t& yield) {
@@ -172,6 +194,84 @@ namespace eosio { namespace chain {
       EOS_ASSERT( variants.size() == abi.variants.value.size(), duplicate_abi_variant_def_exception, "duplicate variant definition detected" );
 
       validate(ctx);
+      build_type_plans();
+   }
+
+   abi_serializer::type_plan abi_serializer::make_type_plan( const std::string_view& type )const {
+      type_plan p;
+      p.rtype = resolve_type(type);
+      p.ftype = fundamental_type(p.rtype);
+      p.array_type = is_array(p.rtype);
+      p.optional_type = is_optional(p.rtype);
+      auto btype = built_in_types.find(p.ftype);
+      if( btype != built_in_types.end() ) {
+         p.built_in = &btype->second;
+         if( !specialized_types.count( p.ftype ) )
+            p.kind = built_in_kind_of( p.ftype );
+      }
+      auto v_itr = variants.find(p.rtype);
+      if( v_itr != variants.end() )
+         p.variant_itr = v_itr;
+      auto s_itr = structs.find(p.rtype);
+      if( s_itr != structs.end() )
+         p.struct_itr = s_itr;
+      link_type_plan( p );
+      return p;
+   }
+
+   void abi_serializer::link_type_plan( type_plan& p )const {
+      p.element = nullptr;
+      p.base = nullptr;
+      p.fields.clear();
+      if( !p.built_in && (p.array_type || p.optional_type) )
+         p.element = find_type_plan( p.ftype );
+      if( p.struct_itr ) {
+         const auto& st = (*p.struct_itr)->second;
+         if( st.base != type_name() )
+            p.base = find_type_plan( st.base );
+         p.fields.reserve( st.fields.size() );
+         for( const auto& f : st.fields ) {
+            auto ftype = _remove_bin_extension( f.type );
+            p.fields.push_back( field_plan{ &f, ftype, find_type_plan( ftype ), ftype.size() != f.type.size() } );
+         }
+      }
+   }
+
+   void abi_serializer::build_type_plans() {
+      type_plans.clear();
+
+      // every name below views storage owned by one of the maps, so the keys stay valid as long as the maps do
+      vector<std::string_view> names;
+      for( const auto& b : built_in_types ) names.emplace_back( b.first );
+      for( const auto& t : typedefs )       { names.emplace_back( t.first ); names.emplace_back( t.second ); }
+      for( const auto& a : actions )        names.emplace_back( a.second );
+      for( const auto& t : tables )         names.emplace_back( t.second );
+      for( const auto& v : variants ) {
+         names.emplace_back( v.first );
+         for( const auto& t : v.second.types ) names.emplace_back( t );
+      }
+      for( const auto& s : structs ) {
+         names.emplace_back( s.first );
+         if( s.second.base != type_name() ) names.emplace_back( s.second.base );
+         for( const auto& f : s.second.fields ) names.emplace_back( _remove_bin_extension( f.type ) );
+      }
+
+      for( size_t i = 0; i < names.size(); ++i ) {
+         if( type_plans.count( names[i] ) ) continue;
+         auto res = type_plans.emplace( names[i], make_type_plan( names[i] ) );
+         const auto& p = res.first->second;
+         if( p.ftype != p.rtype ) names.emplace_back( p.ftype );
+         if( p.rtype != names[i] ) names.emplace_back( p.rtype );
+      }
+
+      // now that every plan exists, link them to each other
+      for( auto& tp : type_plans )
+         link_type_plan( tp.second );
+   }
+
+   const abi_serializer::type_plan* abi_serializer::find_type_plan( const std::string_view& type )const {
+      auto itr = type_plans.find( type );
+      return itr == type_plans.end() ? nullptr : &itr->second;
    }
 
    bool abi_serializer::is_builtin_type(const std::string_view& type)const {
@@ -304,24 +404,28 @@ namespace eosio { namespace chain {
       return type;
    }
 
-   void abi_serializer::_binary_to_variant( const std::string_view& type, fc::datastream<const char *>& stream,
+   void abi_serializer::_binary_to_variant( const type_plan& plan, fc::datastream<const char *>& stream,
                                             fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
-      auto s_itr = structs.find(type);
-      EOS_ASSERT( s_itr != structs.end(), invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(type)) );
+      EOS_ASSERT( plan.struct_itr, invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(plan.rtype)) );
+      const auto& s_itr = *plan.struct_itr;
       ctx.hint_struct_type_if_in_array( s_itr );
       const auto& st = s_itr->second;
       if( st.base != type_name() ) {
-         _binary_to_variant(resolve_type(st.base), stream, obj, ctx);
+         if( plan.base ) {
+            _binary_to_variant(*plan.base, stream, obj, ctx);
+         } else {
+            _binary_to_variant(make_type_plan(st.base), stream, obj, ctx);
+         }
       }
       bool encountered_extension = false;
-      for( uint32_t i = 0; i < st.fields.size(); ++i ) {
-         const auto& field = st.fields[i];
-         bool extension = ends_with(field.type, "$");
-         encountered_extension |= extension;
+      for( uint32_t i = 0; i < plan.fields.size(); ++i ) {
+         const auto& fp = plan.fields[i];
+         const auto& field = *fp.def;
+         encountered_extension |= fp.extension;
          if( !stream.remaining() ) {
-            if( extension ) {
+            if( fp.extension ) {
                continue;
             }
             if( encountered_extension ) {
@@ -333,25 +437,32 @@ namespace eosio { namespace chain {
 
          }
          auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
-         obj( field.name, _binary_to_variant(resolve_type( extension ? _remove_bin_extension(field.type) : field.type ), stream, ctx) );
+         obj( field.name, fp.plan ? _binary_to_variant(*fp.plan, stream, ctx) : _binary_to_variant(fp.type, stream, ctx) );
       }
    }
 
    fc::variant abi_serializer::_binary_to_variant( const std::string_view& type, fc::datastream<const char *>& stream,
                                                    impl::binary_to_variant_context& ctx )const
+   {
+      if( const auto* plan = find_type_plan(type) )
+         return _binary_to_variant(*plan, stream, ctx);
+      return _binary_to_variant(make_type_plan(type), stream, ctx);
+   }
+
+   fc::variant abi_serializer::_binary_to_variant( const type_plan& plan, fc::datastream<const char *>& stream,
+                                                   impl::binary_to_variant_context& ctx )const
    {
       auto h = ctx.enter_scope();
-      auto rtype = resolve_type(type);
-      auto ftype = fundamental_type(rtype);
-      auto btype = built_in_types.find(ftype );
-      if( btype != built_in_types.end() ) {
+      const auto& rtype = plan.rtype;
+      const auto& ftype = plan.ftype;
+      if( plan.built_in ) {
          try {
-            return btype->second.first(stream, is_array(rtype), is_optional(rtype), ctx.get_yield_function());
+            return unpack_built_in_value( plan, stream, ctx );
          } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
-                                   ("class", is_array(rtype) ? "array of built-in" : is_optional(rtype) ? "optional of built-in" : "built-in")
+                                   ("class", plan.array_type ? "array of built-in" : plan.optional_type ? "optional of built-in" : "built-in")
                                    ("type", impl::limit_size(ftype))("p", ctx.get_path_string()) )
       }
-      if ( is_array(rtype) ) {
+      if ( plan.array_type ) {
          ctx.hint_array_type_if_in_array();
          fc::unsigned_int size;
          try {
@@ -361,7 +472,7 @@ namespace eosio { namespace chain {
          auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
          for( decltype(size.value) i = 0; i < size; ++i ) {
             ctx.set_array_index_of_path_back(i);
-            auto v = _binary_to_variant(ftype, stream, ctx);
+            auto v = plan.element ? _binary_to_variant(*plan.element, stream, ctx) : _binary_to_variant(ftype, stream, ctx);
             // QUESTION: Is it actually desired behavior to require the returned variant to not be null?
             //           This would disallow arrays of optionals in general (though if all optionals in the array were present it would be allowed).
             //           Is there any scenario in which the returned variant would be null other than in the case of an empty optional?
@@ -374,29 +485,28 @@ namespace eosio { namespace chain {
                      "packed size does not match unpacked array size, packed size ${p} actual size ${a}",
                      ("p", size)("a", vars.size()) );
          return fc::variant( std::move(vars) );
-      } else if ( is_optional(rtype) ) {
+      } else if ( plan.optional_type ) {
          char flag;
          try {
             fc::raw::unpack(stream, flag);
          } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
-         return flag ? _binary_to_variant(ftype, stream, ctx) : fc::variant();
-      } else {
-         auto v_itr = variants.find(rtype);
-         if( v_itr != variants.end() ) {
-            ctx.hint_variant_type_if_in_array( v_itr );
-            fc::unsigned_int select;
-            try {
-               fc::raw::unpack(stream, select);
-            } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
-            EOS_ASSERT( (size_t)select < v_itr->second.types.size(), unpack_exception,
-                        "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
-            auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
-            return vector<fc::variant>{v_itr->second.types[select], _binary_to_variant(v_itr->second.types[select], stream, ctx)};
-         }
+         if( !flag ) return fc::variant();
+         return plan.element ? _binary_to_variant(*plan.element, stream, ctx) : _binary_to_variant(ftype, stream, ctx);
+      } else if( plan.variant_itr ) {
+         const auto& v_itr = *plan.variant_itr;
+         ctx.hint_variant_type_if_in_array( v_itr );
+         fc::unsigned_int select;
+         try {
+            fc::raw::unpack(stream, select);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+         EOS_ASSERT( (size_t)select < v_itr->second.types.size(), unpack_exception,
+                     "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+         return vector<fc::variant>{v_itr->second.types[select], _binary_to_variant(v_itr->second.types[select], stream, ctx)};
       }
 
       fc::mutable_variant_object mvo;
-      _binary_to_variant(rtype, stream, mvo, ctx);
+      _binary_to_variant(plan, stream, mvo, ctx);
       // QUESTION: Is this assert actually desired? It disallows unpacking empty structs from datastream.
       EOS_ASSERT( mvo.size() > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
       return fc::variant( std::move(mvo) );
@@ -421,18 +531,187 @@ namespace eosio { namespace chain {
       return _binary_to_variant(type, binary, ctx);
    }
 
+   static void append_json_string( std::string& out, const std::string_view& s ) {
+      static const char hex[] = "0123456789abcdef";
+      out += '"';
+      for( char c : s ) {
+         switch( c ) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+               if( static_cast<unsigned char>(c) < 0x20 ) {
+                  out += "\\u00";
+                  out += hex[(c >> 4) & 0xf];
+                  out += hex[c & 0xf];
+               } else {
+                  out += c;
+               }
+         }
+      }
+      out += '"';
+   }
+
+   size_t abi_serializer::_binary_to_json_fields( const type_plan& plan, fc::datastream<const char *>& stream, std::string& out,
+                                                  bool first, impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      EOS_ASSERT( plan.struct_itr, invalid_type_inside_abi, "Unknown type ${type}", ("type",ctx.maybe_shorten(plan.rtype)) );
+      const auto& s_itr = *plan.struct_itr;
+      ctx.hint_struct_type_if_in_array( s_itr );
+      const auto& st = s_itr->second;
+      size_t written = 0;
+      if( st.base != type_name() ) {
+         if( plan.base ) {
+            written += _binary_to_json_fields(*plan.base, stream, out, first, ctx);
+         } else {
+            written += _binary_to_json_fields(make_type_plan(st.base), stream, out, first, ctx);
+         }
+      }
+      bool encountered_extension = false;
+      for( uint32_t i = 0; i < plan.fields.size(); ++i ) {
+         const auto& fp = plan.fields[i];
+         const auto& field = *fp.def;
+         encountered_extension |= fp.extension;
+         if( !stream.remaining() ) {
+            if( fp.extension ) {
+               continue;
+            }
+            if( encountered_extension ) {
+               EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
+                          ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+            }
+            EOS_THROW( unpack_exception, "Stream unexpectedly ended; unable to unpack field '${f}' of struct '${p}'",
+                       ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
+
+         }
+         auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
+         if( !first || written ) out += ',';
+         append_json_string( out, field.name );
+         out += ':';
+         fp.plan ? _binary_to_json(*fp.plan, stream, out, ctx) : _binary_to_json(fp.type, stream, out, ctx);
+         ++written;
+      }
+      return written;
+   }
+
+   bool abi_serializer::_binary_to_json( const std::string_view& type, fc::datastream<const char *>& stream, std::string& out,
+                                         impl::binary_to_variant_context& ctx )const
+   {
+      if( const auto* plan = find_type_plan(type) )
+         return _binary_to_json(*plan, stream, out, ctx);
+      return _binary_to_json(make_type_plan(type), stream, out, ctx);
+   }
+
+   bool abi_serializer::_binary_to_json( const type_plan& plan, fc::datastream<const char *>& stream, std::string& out,
+                                         impl::binary_to_variant_context& ctx )const
+   {
+      auto h = ctx.enter_scope();
+      const auto& ftype = plan.ftype;
+      if( plan.built_in ) {
+         fc::variant v;
+         try {
+            v = unpack_built_in_value( plan, stream, ctx );
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack ${class} type '${type}' while processing '${p}'",
+                                   ("class", plan.array_type ? "array of built-in" : plan.optional_type ? "optional of built-in" : "built-in")
+                                   ("type", impl::limit_size(ftype))("p", ctx.get_path_string()) )
+         // built-in values are leaves, so rendering them through a variant costs no more than unpacking them did
+         out += fc::json::to_string( v, fc::time_point::maximum() );
+         return !v.is_null();
+      }
+      if ( plan.array_type ) {
+         ctx.hint_array_type_if_in_array();
+         fc::unsigned_int size;
+         try {
+            fc::raw::unpack(stream, size);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack size of array '${p}'", ("p", ctx.get_path_string()) )
+         out += '[';
+         auto h1 = ctx.push_to_path( impl::array_index_path_item{} );
+         for( decltype(size.value) i = 0; i < size; ++i ) {
+            ctx.set_array_index_of_path_back(i);
+            if( i ) out += ',';
+            bool not_null = plan.element ? _binary_to_json(*plan.element, stream, out, ctx) : _binary_to_json(ftype, stream, out, ctx);
+            EOS_ASSERT( not_null, unpack_exception, "Invalid packed array '${p}'", ("p", ctx.get_path_string()) );
+         }
+         out += ']';
+         return true;
+      } else if ( plan.optional_type ) {
+         char flag;
+         try {
+            fc::raw::unpack(stream, flag);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack presence flag of optional '${p}'", ("p", ctx.get_path_string()) )
+         if( !flag ) {
+            out += "null";
+            return false;
+         }
+         return plan.element ? _binary_to_json(*plan.element, stream, out, ctx) : _binary_to_json(ftype, stream, out, ctx);
+      } else if( plan.variant_itr ) {
+         const auto& v_itr = *plan.variant_itr;
+         ctx.hint_variant_type_if_in_array( v_itr );
+         fc::unsigned_int select;
+         try {
+            fc::raw::unpack(stream, select);
+         } EOS_RETHROW_EXCEPTIONS( unpack_exception, "Unable to unpack tag of variant '${p}'", ("p", ctx.get_path_string()) )
+         EOS_ASSERT( (size_t)select < v_itr->second.types.size(), unpack_exception,
+                     "Unpacked invalid tag (${select}) for variant '${p}'", ("select", select.value)("p",ctx.get_path_string()) );
+         auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(select) } );
+         out += '[';
+         append_json_string( out, v_itr->second.types[select] );
+         out += ',';
+         _binary_to_json(v_itr->second.types[select], stream, out, ctx);
+         out += ']';
+         return true;
+      }
+
+      out += '{';
+      const size_t written = _binary_to_json_fields(plan, stream, out, true, ctx);
+      EOS_ASSERT( written > 0, unpack_exception, "Unable to unpack '${p}' from stream", ("p", ctx.get_path_string()) );
+      out += '}';
+      return true;
+   }
+
+   void abi_serializer::binary_to_json( const std::string_view& type, const bytes& binary, std::string& out, const yield_function_t& yield, bool short_path )const {
+      fc::datastream<const char*> ds( binary.data(), binary.size() );
+      binary_to_json( type, ds, out, yield, short_path );
+   }
+
+   void abi_serializer::binary_to_json( const std::string_view& type, fc::datastream<const char*>& binary, std::string& out, const yield_function_t& yield, bool short_path )const {
+      impl::binary_to_variant_context ctx(*this, yield, type);
+      ctx.short_path = short_path;
+      _binary_to_json(type, binary, out, ctx);
+   }
+
    void abi_serializer::_variant_to_binary( const std::string_view& type, const fc::variant& var, fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
+   {
+      if( const auto* plan = find_type_plan(type) )
+         _variant_to_binary(*plan, type, var, ds, ctx);
+      else
+         _variant_to_binary(make_type_plan(type), type, var, ds, ctx);
+   }
+
+   void abi_serializer::_variant_to_binary( const type_plan& plan, const std::string_view& type, const fc::variant& var,
+                                            fc::datastream<char *>& ds, impl::variant_to_binary_context& ctx )const
    { try {
       auto h = ctx.enter_scope();
-      auto rtype = resolve_type(type);
 
-      auto v_itr = variants.end();
-      auto s_itr = structs.end();
+      auto encode_element = [&]( const fc::variant& v ) {
+         if( plan.element )
+            _variant_to_binary(*plan.element, plan.ftype, v, ds, ctx);
+         else
+            _variant_to_binary(plan.ftype, v, ds, ctx);
+      };
 
-      auto btype = built_in_types.find(fundamental_type(rtype));
-      if( btype != built_in_types.end() ) {
-         btype->second.second(var, ds, is_array(rtype), is_optional(rtype), ctx.get_yield_function());
-      } else if ( is_array(rtype) ) {
+      if( plan.built_in ) {
+         if( plan.kind != built_in_kind::none ) {
+            visit_built_in( plan.kind, [&]( auto* t, auto ) {
+               pack_built_in<std::remove_pointer_t<decltype(t)>>( var, ds, plan.array_type, plan.optional_type );
+            } );
+         } else {
+            plan.built_in->second(var, ds, plan.array_type, plan.optional_type, ctx.get_yield_function());
+         }
+      } else if ( plan.array_type ) {
          ctx.hint_array_type_if_in_array();
          vector<fc::variant> vars = var.get_array();
          fc::raw::pack(ds, (fc::unsigned_int)vars.size());
@@ -443,16 +722,17 @@ namespace eosio { namespace chain {
          int64_t i = 0;
          for (const auto& var : vars) {
             ctx.set_array_index_of_path_back(i);
-           _variant_to_binary(fundamental_type(rtype), var, ds, ctx);
-           ++i;
+            encode_element(var);
+            ++i;
          }
-      } else if( is_optional(rtype) ) {
+      } else if( plan.optional_type ) {
          char flag = !var.is_null();
          fc::raw::pack(ds, flag);
          if( flag ) {
-            _variant_to_binary(fundamental_type(rtype), var, ds, ctx);
+            encode_element(var);
          }
-      } else if( (v_itr = variants.find(rtype)) != variants.end() ) {
+      } else if( plan.variant_itr ) {
+         const auto& v_itr = *plan.variant_itr;
          ctx.hint_variant_type_if_in_array( v_itr );
          auto& v = v_itr->second;
          EOS_ASSERT( var.is_array() && var.size() == 2, pack_exception,
@@ -467,30 +747,43 @@ namespace eosio { namespace chain {
          fc::raw::pack(ds, fc::unsigned_int(it - v.types.begin()));
          auto h1 = ctx.push_to_path( impl::variant_path_item{ .variant_itr = v_itr, .variant_ordinal = static_cast<uint32_t>(it - v.types.begin()) } );
          _variant_to_binary( *it, var[size_t(1)], ds, ctx );
-      } else if( (s_itr = structs.find(rtype)) != structs.end() ) {
+      } else if( plan.struct_itr ) {
+         const auto& s_itr = *plan.struct_itr;
          ctx.hint_struct_type_if_in_array( s_itr );
          const auto& st = s_itr->second;
 
+         auto encode_field = [&]( const field_plan& fp, const fc::variant& v ) {
+            if( fp.plan )
+               _variant_to_binary(*fp.plan, fp.type, v, ds, ctx);
+            else
+               _variant_to_binary(fp.type, v, ds, ctx);
+         };
+
          if( var.is_object() ) {
             const auto& vo = var.get_object();
 
             if( st.base != type_name() ) {
                auto h2 = ctx.disallow_extensions_unless(false);
-               _variant_to_binary(resolve_type(st.base), var, ds, ctx);
+               if( plan.base )
+                  _variant_to_binary(*plan.base, st.base, var, ds, ctx);
+               else
+                  _variant_to_binary(resolve_type(st.base), var, ds, ctx);
             }
             bool disallow_additional_fields = false;
-            for( uint32_t i = 0; i < st.fields.size(); ++i ) {
-               const auto& field = st.fields[i];
-               if( vo.contains( string(field.name).c_str() ) ) {
+            for( uint32_t i = 0; i < plan.fields.size(); ++i ) {
+               const auto& fp = plan.fields[i];
+               const auto& field = *fp.def;
+               auto field_itr = vo.find( field.name );
+               if( field_itr != vo.end() ) {
                   if( disallow_additional_fields )
                      EOS_THROW( pack_exception, "Unexpected field '${f}' found in input object while processing struct '${p}'",
                                 ("f", ctx.maybe_shorten(field.name))("p", ctx.get_path_string()) );
                   {
                      auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
                      auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
-                     _variant_to_binary(_remove_bin_extension(field.type), vo[field.name], ds, ctx);
+                     encode_field( fp, field_itr->value() );
                   }
-               } else if( ends_with(field.type, "$") && ctx.extensions_allowed() ) {
+               } else if( fp.extension && ctx.extensions_allowed() ) {
                   disallow_additional_fields = true;
                } else if( disallow_additional_fields ) {
                   EOS_THROW( abi_exception, "Encountered field '${f}' without binary extension designation while processing struct '${p}'",
@@ -505,13 +798,14 @@ namespace eosio { namespace chain {
             EOS_ASSERT( st.base == type_name(), invalid_type_inside_abi,
                         "Using input array to specify the fields of the derived struct '${p}'; input arrays are currently only allowed for structs without a base",
                         ("p",ctx.get_path_string()) );
-            for( uint32_t i = 0; i < st.fields.size(); ++i ) {
-               const auto& field = st.fields[i];
+            for( uint32_t i = 0; i < plan.fields.size(); ++i ) {
+               const auto& fp = plan.fields[i];
+               const auto& field = *fp.def;
                if( va.size() > i ) {
                   auto h1 = ctx.push_to_path( impl::field_path_item{ .parent_struct_itr = s_itr, .field_ordinal = i } );
                   auto h2 = ctx.disallow_extensions_unless( &field == &st.fields.back() );
-                  _variant_to_binary(_remove_bin_extension(field.type), va[i], ds, ctx);
-               } else if( ends_with(field.type, "$") && ctx.extensions_allowed() ) {
+                  encode_field( fp, va[i] );
+               } else if( fp.extension && ctx.extensions_allowed() ) {
                   break;
                } else {
                   EOS_THROW( pack_exception, "Early end to input array specifying the fields of struct '${p}'; require input for field '${f}'",
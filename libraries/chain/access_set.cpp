@@ -0,0 +1,78 @@
+#include <eosio/chain/access_set.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace {
+      auto key( const table_access& t ) {
+         return std::tie( t.code, t.scope, t.table );
+      }
+
+      template<typename Set>
+      bool intersects( const Set& a, const Set& b ) {
+         auto i = a.begin(), j = b.begin();
+         while( i != a.end() && j != b.end() ) {
+            if( *i < *j ) ++i;
+            else if( *j < *i ) ++j;
+            else return true;
+         }
+         return false;
+      }
+
+      bool conflicts( const table_access& a, const table_access& b ) {
+         if( a.writes.empty() && b.writes.empty() )
+            return false;
+         if( (a.scanned && !b.writes.empty()) || (b.scanned && !a.writes.empty()) )
+            return true;
+         return intersects( a.writes, b.writes ) || intersects( a.writes, b.reads ) || intersects( a.reads, b.writes );
+      }
+   }
+
+   table_access& access_set::find_or_add( account_name code, scope_name scope, table_name table ) {
+      const auto k = std::tie( code, scope, table );
+      if( last < tables.size() && key( tables[last] ) == k )
+         return tables[last];
+      auto itr = std::lower_bound( tables.begin(), tables.end(), k,
+                                   []( const table_access& t, const auto& k ) { return key( t ) < k; } );
+      if( itr == tables.end() || key( *itr ) != k ) {
+         itr = tables.emplace( itr );
+         itr->code  = code;
+         itr->scope = scope;
+         itr->table = table;
+      }
+      last = itr - tables.begin();
+      return *itr;
+   }
+
+   void access_set::read( account_name code, scope_name scope, table_name table, uint64_t primary ) {
+      auto& t = find_or_add( code, scope, table );
+      if( !t.scanned )
+         t.reads.insert( primary );
+   }
+
+   void access_set::write( account_name code, scope_name scope, table_name table, uint64_t primary ) {
+      find_or_add( code, scope, table ).writes.insert( primary );
+   }
+
+   void access_set::scan( account_name code, scope_name scope, table_name table ) {
+      auto& t = find_or_add( code, scope, table );
+      if( !t.scanned ) {
+         t.scanned = true;
+         t.reads.clear();
+      }
+   }
+
+   bool access_set::conflicts_with( const access_set& other )const {
+      auto i = tables.begin(), j = other.tables.begin();
+      while( i != tables.end() && j != other.tables.end() ) {
+         if( key( *i ) < key( *j ) ) ++i;
+         else if( key( *j ) < key( *i ) ) ++j;
+         else {
+            if( conflicts( *i, *j ) )
+               return true;
+            ++i; ++j;
+         }
+      }
+      return false;
+   }
+
+} } /// eosio::chain
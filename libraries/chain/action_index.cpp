@@ -0,0 +1,168 @@
+#include <eosio/chain/action_index.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <queue>
+
+namespace eosio { namespace chain {
+
+namespace {
+
+   void write_action_index_run(const fc::path& file, std::vector<action_index_entry>& entries) {
+      std::sort(entries.begin(), entries.end());
+      std::ofstream out(file.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc);
+      out.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(action_index_entry));
+      EOS_ASSERT( out, block_log_exception, "Writing action index run ${f} failed", ("f", file.generic_string()) );
+      entries.clear();
+   }
+
+   /// buffered sequential reader of a sorted run of action_index_entry
+   struct action_index_run {
+      explicit action_index_run(const fc::path& file)
+      : in(file.generic_string(), std::ios::in | std::ios::binary) {
+         EOS_ASSERT( in, block_log_exception, "Could not open action index run ${f}", ("f", file.generic_string()) );
+         fill();
+      }
+
+      bool empty() const { return pos == buf.size(); }
+      const action_index_entry& front() const { return buf[pos]; }
+      void pop() {
+         if (++pos == buf.size())
+            fill();
+      }
+
+   private:
+      void fill() {
+         buf.resize(1U << 16);
+         in.read(reinterpret_cast<char*>(buf.data()), buf.size() * sizeof(action_index_entry));
+         buf.resize(in.gcount() / sizeof(action_index_entry));
+         pos = 0;
+      }
+
+      std::ifstream                   in;
+      std::vector<action_index_entry> buf;
+      size_t                          pos = 0;
+   };
+
+}
+
+void append_action_entries(const signed_block& block, std::vector<action_index_entry>& entries) {
+   std::vector<uint64_t> accounts;
+   for (uint32_t t = 0; t < block.transactions.size(); ++t) {
+      const auto& receipt = block.transactions[t];
+      if (receipt.status != transaction_receipt_header::executed || !receipt.trx.contains<packed_transaction>())
+         continue;
+      const auto& trx = receipt.trx.get<packed_transaction>().get_transaction();
+      uint32_t ordinal = 0;
+      auto add = [&](const action& act) {
+         ++ordinal;
+         accounts.assign(1, act.account.to_uint64_t());
+         for (const auto& auth : act.authorization)
+            accounts.push_back(auth.actor.to_uint64_t());
+         std::sort(accounts.begin(), accounts.end());
+         accounts.erase(std::unique(accounts.begin(), accounts.end()), accounts.end());
+         for (auto a : accounts)
+            entries.push_back(action_index_entry{a, block.block_num(), t, ordinal});
+      };
+      for (const auto& act : trx.context_free_actions)
+         add(act);
+      for (const auto& act : trx.actions)
+         add(act);
+   }
+}
+
+action_index_header make_action_index(const fc::path& blocks_dir, const fc::path& out_file,
+                                      uint32_t first, uint32_t last, uint32_t threads) {
+   EOS_ASSERT( threads > 0, fc::invalid_arg_exception, "threads must be greater than 0" );
+   block_log blog(blocks_dir, true);
+   const auto head = blog.head();
+   EOS_ASSERT( head, block_log_exception, "No blocks found in block log" );
+   first = std::max(first, blog.first_block_num());
+   last = std::min(last, head->block_num());
+   EOS_ASSERT( first <= last, fc::invalid_arg_exception, "No blocks of the block log are in the range ${f} - ${l}", ("f", first)("l", last) );
+   ilog( "indexing the actions of blocks ${f} through ${l} into ${o}", ("f", first)("l", last)("o", out_file.generic_string()) );
+
+   // every worker takes chunks of blocks in turn and spills its entries into sorted runs, which are merged at the end
+   const fc::path runs_dir = out_file.parent_path() / (out_file.filename().string() + ".runs");
+   fc::remove_all(runs_dir);
+   fc::create_directories(runs_dir);
+   constexpr uint32_t chunk_blocks = 1000;
+   constexpr size_t   run_entries = 1U << 22;
+   std::atomic<uint64_t> next_chunk{first};
+   std::atomic<uint32_t> num_runs{0};
+   auto run_file = [&runs_dir](uint32_t r) { return runs_dir / ("run-" + std::to_string(r)); };
+   {
+      named_thread_pool pool("index", threads);
+      std::vector<std::future<void>> workers;
+      for (uint32_t w = 0; w < threads; ++w) {
+         workers.emplace_back(async_thread_pool(pool.get_executor(), [&]() {
+            std::vector<action_index_entry> entries;
+            for (uint64_t begin; (begin = next_chunk.fetch_add(chunk_blocks)) <= last;) {
+               const uint64_t end = std::min<uint64_t>(begin + chunk_blocks - 1, last);
+               for (uint64_t n = begin; n <= end; ++n) {
+                  const auto block = blog.read_block_by_num(n);
+                  EOS_ASSERT( block, block_log_exception, "Block ${n} could not be read from the block log", ("n", n) );
+                  append_action_entries(*block, entries);
+               }
+               if (entries.size() >= run_entries)
+                  write_action_index_run(run_file(num_runs++), entries);
+            }
+            if (!entries.empty())
+               write_action_index_run(run_file(num_runs++), entries);
+         }));
+      }
+      for (auto& w : workers)
+         w.get();
+   }
+
+   std::vector<std::unique_ptr<action_index_run>> runs;
+   for (uint32_t r = 0; r < num_runs; ++r)
+      runs.emplace_back(std::make_unique<action_index_run>(run_file(r)));
+   auto greater = [&runs](uint32_t a, uint32_t b) { return runs[b]->front() < runs[a]->front(); };
+   std::priority_queue<uint32_t, std::vector<uint32_t>, decltype(greater)> heads(greater);
+   for (uint32_t r = 0; r < runs.size(); ++r)
+      if (!runs[r]->empty())
+         heads.push(r);
+
+   action_index_header header;
+   header.first_block = first;
+   header.last_block = last;
+   std::ofstream out(out_file.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc);
+   EOS_ASSERT( out, block_log_exception, "Could not open ${f}", ("f", out_file.generic_string()) );
+   out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   std::vector<action_index_entry> buf;
+   buf.reserve(1U << 16);
+   while (!heads.empty()) {
+      const uint32_t r = heads.top();
+      heads.pop();
+      buf.push_back(runs[r]->front());
+      if (buf.size() == buf.capacity()) {
+         out.write(reinterpret_cast<const char*>(buf.data()), buf.size() * sizeof(action_index_entry));
+         header.entries += buf.size();
+         buf.clear();
+      }
+      runs[r]->pop();
+      if (!runs[r]->empty())
+         heads.push(r);
+   }
+   out.write(reinterpret_cast<const char*>(buf.data()), buf.size() * sizeof(action_index_entry));
+   header.entries += buf.size();
+   out.seekp(0);
+   out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+   out.close();
+   EOS_ASSERT( out, block_log_exception, "Writing ${f} failed", ("f", out_file.generic_string()) );
+   runs.clear();
+   fc::remove_all(runs_dir);
+
+   ilog( "wrote ${n} action index entries from ${r} sorted runs", ("n", header.entries)("r", num_runs.load()) );
+   return header;
+}
+
+} } /// eosio::chain
@@ -0,0 +1,94 @@
+#include <eosio/chain/app_thread_stats.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
+namespace eosio { namespace chain {
+
+constexpr std::array<uint32_t, 8> app_thread_origin::wait_bounds_us;
+
+std::atomic<uint64_t> app_thread_stats::_blocks_pending{0};
+std::atomic<int64_t>  app_thread_stats::_last_block_started_us{0};
+
+namespace {
+   std::mutex                    origins_mtx;
+   std::deque<app_thread_origin> origins; // guarded by origins_mtx, a deque so that references stay valid
+}
+
+app_thread_origin::app_thread_origin( std::string name, int priority, bool carries_block )
+: _name( std::move( name ) )
+, _priority( priority )
+, _carries_block( carries_block )
+{}
+
+void app_thread_origin::posted() {
+   _posted.fetch_add( 1, std::memory_order_relaxed );
+   if( _carries_block )
+      app_thread_stats::_blocks_pending.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void app_thread_origin::dequeued( fc::microseconds waited ) {
+   if( _carries_block )
+      app_thread_stats::_blocks_pending.fetch_sub( 1, std::memory_order_relaxed );
+   const uint64_t us = std::max<int64_t>( waited.count(), 0 );
+   _wait_us.fetch_add( us, std::memory_order_relaxed );
+   uint64_t max = _max_wait_us.load( std::memory_order_relaxed );
+   while( us > max && !_max_wait_us.compare_exchange_weak( max, us, std::memory_order_relaxed ) ) {}
+   const auto b = std::lower_bound( wait_bounds_us.begin(), wait_bounds_us.end(), us ) - wait_bounds_us.begin();
+   _wait_buckets[b].fetch_add( 1, std::memory_order_relaxed );
+}
+
+void app_thread_origin::started( fc::microseconds waited ) {
+   dequeued( waited );
+   if( _carries_block )
+      app_thread_stats::_last_block_started_us.store( fc::time_point::now().time_since_epoch().count(), std::memory_order_relaxed );
+   _ran.fetch_add( 1, std::memory_order_relaxed );
+}
+
+void app_thread_origin::finished( fc::microseconds ran ) {
+   _run_us.fetch_add( std::max<int64_t>( ran.count(), 0 ), std::memory_order_relaxed );
+}
+
+void app_thread_origin::shed( fc::microseconds waited ) {
+   dequeued( waited );
+   _shed.fetch_add( 1, std::memory_order_relaxed );
+}
+
+app_thread_origin::stats app_thread_origin::get_stats()const {
+   stats s;
+   s.name        = _name;
+   s.priority    = _priority;
+   // read the outcomes before the posts so that a racing post never makes queued negative
+   s.ran         = _ran.load( std::memory_order_relaxed );
+   s.shed        = _shed.load( std::memory_order_relaxed );
+   s.posted      = std::max( _posted.load( std::memory_order_relaxed ), s.ran + s.shed );
+   s.queued      = s.posted - s.ran - s.shed;
+   s.wait_us     = _wait_us.load( std::memory_order_relaxed );
+   s.max_wait_us = _max_wait_us.load( std::memory_order_relaxed );
+   s.run_us      = _run_us.load( std::memory_order_relaxed );
+   for( const auto& b : _wait_buckets )
+      s.wait_buckets.push_back( b.load( std::memory_order_relaxed ) );
+   return s;
+}
+
+app_thread_origin& app_thread_stats::origin( const std::string& name, int priority, bool carries_block ) {
+   std::lock_guard<std::mutex> g( origins_mtx );
+   for( auto& o : origins ) {
+      if( o.priority() == priority && o.name() == name )
+         return o;
+   }
+   origins.emplace_back( name, priority, carries_block );
+   return origins.back();
+}
+
+std::vector<app_thread_origin::stats> app_thread_stats::all() {
+   std::lock_guard<std::mutex> g( origins_mtx );
+   std::vector<app_thread_origin::stats> result;
+   result.reserve( origins.size() );
+   for( const auto& o : origins )
+      result.push_back( o.get_stats() );
+   return result;
+}
+
+} } // eosio::chain
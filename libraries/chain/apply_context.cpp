@@ -42,16 +42,26 @@ apply_context::apply_context(controller& con, transaction_context& trx_ctx, uint
 ,idx256(*this)
 ,idx_double(*this)
 ,idx_long_double(*this)
+,keyval_cache(arena())
+,_notified(arena())
+,_inline_actions(arena())
+,_cfa_inline_actions(arena())
 {
    action_trace& trace = trx_ctx.get_action_trace(action_ordinal);
    act = &trace.act;
    receiver = trace.receiver;
    context_free = trace.context_free;
+   if( trx_ctx.trace->accesses )
+      accesses = &*trx_ctx.trace->accesses;
+   sample_table_accesses = con.table_access_sample_rate() > 0;
 }
 
 void apply_context::exec_one()
 {
    auto start = fc::time_point::now();
+   const uint64_t host_calls_at_start = host_calls;
+   if( trx_context.trace->cpu_breakdown )
+      _cpu_breakdown.emplace();
 
    action_receipt r;
    r.receiver         = receiver;
@@ -61,7 +71,7 @@ void apply_context::exec_one()
    const account_metadata_object* receiver_account = nullptr;
    try {
       try {
-         receiver_account = &db.get<account_metadata_object,by_name>( receiver );
+         receiver_account = &trx_context.get_account_metadata( receiver );
          privileged = receiver_account->is_privileged();
          auto native = control.find_apply_handler( receiver, act->account, act->name );
          if( native ) {
@@ -83,12 +93,20 @@ void apply_context::exec_one()
                control.check_contract_list( receiver );
                control.check_action_list( act->account, act->name );
             }
-            try {
-               control.get_wasm_interface().apply( receiver_account->code_hash, receiver_account->vm_type, receiver_account->vm_version, *this );
-            } catch( const wasm_exit& ) {}
+            const apply_handler* native_contract = nullptr;
+            if( receiver == act->account && receiver_account->vm_type == 0 && receiver_account->vm_version == 0 )
+               native_contract = control.find_native_contract_handler( receiver_account->code_hash, act->name );
+            if( native_contract ) {
+               (*native_contract)( *this );
+            } else {
+               try {
+                  control.get_wasm_interface().apply( receiver_account->code_hash, receiver_account->vm_type, receiver_account->vm_version, *this );
+               } catch( const wasm_exit& ) {}
+            }
          }
 
          if( !privileged && control.is_builtin_activated( builtin_protocol_feature_t::ram_restrictions ) ) {
+            scoped_cpu_timer ram_timer( _cpu_breakdown ? &_cpu_breakdown->ram_ns : nullptr );
             const size_t checktime_interval = 10;
             size_t counter = 0;
             bool   not_in_notify_context = (receiver == act->account);
@@ -131,7 +149,7 @@ void apply_context::exec_one()
    if( act->account == receiver ) {
       first_receiver_account = receiver_account;
    } else {
-      first_receiver_account = &db.get<account_metadata_object, by_name>(act->account);
+      first_receiver_account = &trx_context.get_account_metadata( act->account );
    }
 
    r.code_sequence    = first_receiver_account->code_sequence; // could be modified by action execution above
@@ -148,6 +166,10 @@ void apply_context::exec_one()
 
    finalize_trace( trace, start );
 
+   if( control.is_profiled_account( receiver ) ) {
+      control.record_action_profile( receiver, act->account, act->name, trace.elapsed, host_calls - host_calls_at_start );
+   }
+
    if ( control.contracts_console() ) {
       print_debug(receiver, trace);
    }
@@ -162,6 +184,14 @@ void apply_context::finalize_trace( action_trace& trace, const fc::time_point& s
    _pending_console_output.clear();
 
    trace.elapsed = fc::time_point::now() - start;
+
+   if( _cpu_breakdown ) {
+      // wasm_interface timed the whole apply, which includes the host functions it called
+      auto& wasm_ns = _cpu_breakdown->wasm_oc_ns ? _cpu_breakdown->wasm_oc_ns : _cpu_breakdown->wasm_baseline_ns;
+      wasm_ns -= std::min( wasm_ns, _cpu_breakdown->host_ns() );
+      trace.cpu_breakdown = *_cpu_breakdown;
+      _cpu_breakdown.reset();
+   }
 }
 
 void apply_context::exec()
@@ -188,8 +218,12 @@ void apply_context::exec()
 
 } /// exec()
 
+boost::container::pmr::memory_resource* apply_context::arena()const {
+   return &trx_context.action_arena;
+}
+
 bool apply_context::is_account( const account_name& account )const {
-   return nullptr != db.find<account_object,by_name>( account );
+   return trx_context.is_account( account );
 }
 
 void apply_context::require_authorization( const account_name& account ) {
@@ -221,6 +255,8 @@ void apply_context::require_authorization(const account_name& account,
 }
 
 bool apply_context::has_recipient( account_name code )const {
+   if( !_notified_index.empty() )
+      return _notified_index.count( code );
    for( const auto& p : _notified )
       if( p.first == code )
          return true;
@@ -233,6 +269,13 @@ void apply_context::require_recipient( account_name recipient ) {
          recipient,
          schedule_action( action_ordinal, recipient, false )
       );
+      // past a few recipients they are looked up hashed rather than scanned
+      if( !_notified_index.empty() ) {
+         _notified_index.insert( recipient );
+      } else if( _notified.size() > max_scanned_recipients ) {
+         for( const auto& p : _notified )
+            _notified_index.insert( p.first );
+      }
    }
 }
 
@@ -253,8 +296,7 @@ void apply_context::require_recipient( account_name recipient ) {
  *   can better understand the security risk.
  */
 void apply_context::execute_inline( action&& a ) {
-   auto* code = control.db().find<account_object, by_name>(a.account);
-   EOS_ASSERT( code != nullptr, action_validate_exception,
+   EOS_ASSERT( is_account( a.account ), action_validate_exception,
                "inline action's code account ${account} does not exist", ("account", a.account) );
 
    bool enforce_actor_whitelist_blacklist = trx_context.enforce_whiteblacklist && control.is_producing_block();
@@ -270,8 +312,7 @@ void apply_context::execute_inline( action&& a ) {
    }
 
    for( const auto& auth : a.authorization ) {
-      auto* actor = control.db().find<account_object, by_name>(auth.actor);
-      EOS_ASSERT( actor != nullptr, action_validate_exception,
+      EOS_ASSERT( is_account( auth.actor ), action_validate_exception,
                   "inline action's authorizing actor ${account} does not exist", ("account", auth.actor) );
       EOS_ASSERT( control.get_authorization_manager().find_permission(auth) != nullptr, action_validate_exception,
                   "inline action's authorizations include a non-existent permission: ${permission}",
@@ -330,8 +371,7 @@ void apply_context::execute_inline( action&& a ) {
 }
 
 void apply_context::execute_context_free_inline( action&& a ) {
-   auto* code = control.db().find<account_object, by_name>(a.account);
-   EOS_ASSERT( code != nullptr, action_validate_exception,
+   EOS_ASSERT( is_account( a.account ), action_validate_exception,
                "inline action's code account ${account} does not exist", ("account", a.account) );
 
    EOS_ASSERT( a.authorization.size() == 0, action_validate_exception,
@@ -676,6 +716,7 @@ int apply_context::db_store_i64( name code, name scope, name table, const accoun
 
    int64_t billable_size = (int64_t)(buffer_size + config::billable_size_v<key_value_object>);
    update_db_usage( payer, billable_size);
+   record_write( tab, id );
 
    keyval_cache.cache_table( tab );
    return keyval_cache.add( obj );
@@ -705,6 +746,7 @@ void apply_context::db_update_i64( int iterator, account_name payer, const char*
       update_db_usage( obj.payer, new_size - old_size);
    }
 
+   record_write( table_obj, obj.primary_key );
    db.modify( obj, [&]( auto& o ) {
      o.value.assign( buffer, buffer_size );
      o.payer = payer;
@@ -720,6 +762,7 @@ void apply_context::db_remove_i64( int iterator ) {
 //   require_write_lock( table_obj.scope );
 
    update_db_usage( obj.payer,  -(obj.value.size() + config::billable_size_v<key_value_object>) );
+   record_write( table_obj, obj.primary_key );
 
    db.modify( table_obj, [&]( auto& t ) {
       --t.count;
@@ -745,10 +788,56 @@ int apply_context::db_get_i64( int iterator, char* buffer, size_t buffer_size )
    return copy_size;
 }
 
+int apply_context::db_get_i64_batch( int iterator, uint32_t max_rows, char* buffer, size_t buffer_size, uint32_t& rows_read ) {
+   rows_read = 0;
+   if( iterator < -1 ) return iterator; // end iterator, nothing to read
+
+   const auto& first = keyval_cache.get( iterator ); // Check for iterator != -1 happens in this call
+   record_scan( keyval_cache.get_table( first.t_id ) );
+   const auto& idx = db.get_index<key_value_index, by_scope_primary>();
+   constexpr size_t row_header_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+   size_t pos = 0;
+   auto itr = idx.iterator_to( first );
+   for( ; rows_read < max_rows && itr != idx.end() && itr->t_id == first.t_id; ++itr, ++rows_read ) {
+      const uint64_t primary_key = itr->primary_key;
+      const uint32_t value_size = itr->value.size();
+      if( buffer_size - pos < row_header_size + value_size ) break;
+      memcpy( buffer + pos, &primary_key, sizeof(primary_key) );
+      memcpy( buffer + pos + sizeof(primary_key), &value_size, sizeof(value_size) );
+      memcpy( buffer + pos + row_header_size, itr->value.data(), value_size );
+      pos += row_header_size + value_size;
+   }
+
+   if( itr == idx.end() || itr->t_id != first.t_id ) return keyval_cache.get_end_iterator_by_table_id( first.t_id );
+   return keyval_cache.add( *itr );
+}
+
+int apply_context::db_store_i64_batch( name scope, name table, const account_name& payer, const char* buffer, size_t buffer_size ) {
+   constexpr size_t row_header_size = sizeof(uint64_t) + sizeof(uint32_t);
+
+   int rows = 0;
+   size_t pos = 0;
+   while( pos < buffer_size ) {
+      EOS_ASSERT( buffer_size - pos >= row_header_size, table_operation_not_permitted, "truncated row header in batch" );
+      uint64_t id;
+      uint32_t value_size;
+      memcpy( &id, buffer + pos, sizeof(id) );
+      memcpy( &value_size, buffer + pos + sizeof(id), sizeof(value_size) );
+      pos += row_header_size;
+      EOS_ASSERT( buffer_size - pos >= value_size, table_operation_not_permitted, "truncated row value in batch" );
+      db_store_i64( receiver, scope, table, payer, id, buffer + pos, value_size );
+      pos += value_size;
+      ++rows;
+   }
+   return rows;
+}
+
 int apply_context::db_next_i64( int iterator, uint64_t& primary ) {
    if( iterator < -1 ) return -1; // cannot increment past end iterator of table
 
    const auto& obj = keyval_cache.get( iterator ); // Check for iterator != -1 happens in this call
+   record_scan( keyval_cache.get_table( obj.t_id ) );
    const auto& idx = db.get_index<key_value_index, by_scope_primary>();
 
    auto itr = idx.iterator_to( obj );
@@ -767,6 +856,7 @@ int apply_context::db_previous_i64( int iterator, uint64_t& primary ) {
    {
       auto tab = keyval_cache.find_table_by_end_iterator(iterator);
       EOS_ASSERT( tab, invalid_table_iterator, "not a valid end iterator" );
+      record_scan( *tab );
 
       auto itr = idx.upper_bound(tab->id);
       if( idx.begin() == idx.end() || itr == idx.begin() ) return -1; // Empty table
@@ -780,6 +870,7 @@ int apply_context::db_previous_i64( int iterator, uint64_t& primary ) {
    }
 
    const auto& obj = keyval_cache.get(iterator); // Check for iterator != -1 happens in this call
+   record_scan( keyval_cache.get_table( obj.t_id ) );
 
    auto itr = idx.iterator_to(obj);
    if( itr == idx.begin() ) return -1; // cannot decrement past beginning iterator of table
@@ -796,7 +887,11 @@ int apply_context::db_find_i64( name code, name scope, name table, uint64_t id )
    //require_read_lock( code, scope ); // redundant?
 
    const auto* tab = find_table( code, scope, table );
-   if( !tab ) return -1;
+   if( !tab ) {
+      record_scan( code, scope, table );
+      return -1;
+   }
+   record_read( *tab, id );
 
    auto table_end_itr = keyval_cache.cache_table( *tab );
 
@@ -809,6 +904,7 @@ int apply_context::db_find_i64( name code, name scope, name table, uint64_t id )
 int apply_context::db_lowerbound_i64( name code, name scope, name table, uint64_t id ) {
    //require_read_lock( code, scope ); // redundant?
 
+   record_scan( code, scope, table );
    const auto* tab = find_table( code, scope, table );
    if( !tab ) return -1;
 
@@ -825,6 +921,7 @@ int apply_context::db_lowerbound_i64( name code, name scope, name table, uint64_
 int apply_context::db_upperbound_i64( name code, name scope, name table, uint64_t id ) {
    //require_read_lock( code, scope ); // redundant?
 
+   record_scan( code, scope, table );
    const auto* tab = find_table( code, scope, table );
    if( !tab ) return -1;
 
@@ -841,6 +938,7 @@ int apply_context::db_upperbound_i64( name code, name scope, name table, uint64_
 int apply_context::db_end_i64( name code, name scope, name table ) {
    //require_read_lock( code, scope ); // redundant?
 
+   record_scan( code, scope, table );
    const auto* tab = find_table( code, scope, table );
    if( !tab ) return -1;
 
@@ -862,7 +960,7 @@ uint64_t apply_context::next_recv_sequence( const account_metadata_object& recei
    return receiver_account.recv_sequence;
 }
 uint64_t apply_context::next_auth_sequence( account_name actor ) {
-   const auto& amo = db.get<account_metadata_object,by_name>( actor );
+   const auto& amo = trx_context.get_account_metadata( actor );
    db.modify( amo, [&](auto& am ){
       ++am.auth_sequence;
    });
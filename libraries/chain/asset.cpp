@@ -17,15 +17,24 @@ int64_t asset::precision()const {
 }
 
 string asset::to_string()const {
-   string sign = amount < 0 ? "-" : "";
-   int64_t abs_amount = std::abs(amount);
-   string result = fc::to_string( static_cast<int64_t>(abs_amount) / precision());
+   // appended to a string sized for the longest asset, so it is built without reallocating
+   string result;
+   result.reserve( 1 + 19 + 1 + symbol::max_precision + 1 + 7 );
+   if( amount < 0 )
+      result += '-';
+   const uint64_t abs_amount = amount < 0 ? -uint64_t(amount) : uint64_t(amount);
+   const uint64_t p = precision();
+   result += fc::to_string( abs_amount / p );
    if( decimals() )
    {
-      auto fract = static_cast<int64_t>(abs_amount) % precision();
-      result += "." + fc::to_string(precision() + fract).erase(0,1);
+      // the fraction with its leading zeros
+      const string fract = fc::to_string( p + abs_amount % p );
+      result += '.';
+      result.append( fract, 1, string::npos );
    }
-   return sign + result + " " + symbol_name();
+   result += ' ';
+   result += symbol_name();
+   return result;
 }
 
 asset asset::from_string(const string& from)
@@ -45,16 +54,10 @@ asset asset::from_string(const string& from)
          EOS_ASSERT((dot_pos != amount_str.size() - 1), asset_type_exception, "Missing decimal fraction after decimal point");
       }
 
-      // Parse symbol
-      string precision_digit_str;
-      if (dot_pos != string::npos) {
-         precision_digit_str = eosio::chain::to_string(amount_str.size() - dot_pos - 1);
-      } else {
-         precision_digit_str = "0";
-      }
-
-      string symbol_part = precision_digit_str + ',' + symbol_str;
-      symbol sym = symbol::from_string(symbol_part);
+      // Parse symbol, precision being the count of fraction digits
+      const uint8_t p = dot_pos != string::npos ? amount_str.size() - dot_pos - 1 : 0;
+      EOS_ASSERT( p <= symbol::max_precision, symbol_type_exception, "precision ${p} should be <= 18", ("p", p));
+      symbol sym(string_to_symbol(p, symbol_str.c_str()));
 
       // Parse amount
       safe<int64_t> int_part, fract_part;
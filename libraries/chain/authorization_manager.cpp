@@ -8,6 +8,8 @@
 #include <eosio/chain/contract_types.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <boost/tuple/tuple_io.hpp>
+#include <algorithm>
+#include <iterator>
 #include <eosio/chain/database_utils.hpp>
 #include <eosio/chain/protocol_state_object.hpp>
 
@@ -149,6 +151,7 @@ namespace eosio { namespace chain {
          p.last_used = creation_time;
       });
 
+      clear_satisfied_cache();
       const auto& perm = _db.create<permission_object>([&](auto& p) {
          p.usage_id     = perm_usage.id;
          p.parent       = parent;
@@ -180,6 +183,7 @@ namespace eosio { namespace chain {
          p.last_used = creation_time;
       });
 
+      clear_satisfied_cache();
       const auto& perm = _db.create<permission_object>([&](auto& p) {
          p.usage_id     = perm_usage.id;
          p.parent       = parent;
@@ -196,6 +200,7 @@ namespace eosio { namespace chain {
          EOS_ASSERT(k.key.which() < _db.get<protocol_state_object>().num_supported_key_types, unactivated_key_type,
            "Unactivated key type used when modifying permission");
 
+      clear_satisfied_cache();
       _db.modify( permission, [&](permission_object& po) {
          po.auth = auth;
          po.last_updated = _control.pending_block_time();
@@ -208,6 +213,7 @@ namespace eosio { namespace chain {
       EOS_ASSERT( range.first == range.second, action_validate_exception,
                   "Cannot remove a permission which has children. Remove the children first.");
 
+      clear_satisfied_cache();
       _db.get_mutable_index<permission_usage_index>().remove_object( permission.usage_id._id );
       _db.remove( permission );
    }
@@ -444,7 +450,8 @@ namespace eosio { namespace chain {
                                                fc::microseconds                     provided_delay,
                                                const std::function<void()>&         _checktime,
                                                bool                                 allow_unused_keys,
-                                               const flat_set<permission_level>&    satisfied_authorizations
+                                               const flat_set<permission_level>&    satisfied_authorizations,
+                                               bool                                 use_satisfied_cache
                                              )const
    {
       const auto& checktime = ( static_cast<bool>(_checktime) ? _checktime : _noop_checktime );
@@ -453,7 +460,7 @@ namespace eosio { namespace chain {
 
       auto effective_provided_delay =  (provided_delay >= delay_max_limit) ? fc::microseconds::maximum() : provided_delay;
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const shared_authority& { return get_permission(p).auth; },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
@@ -517,20 +524,59 @@ namespace eosio { namespace chain {
       // for checking the set of declared authorizations.
       // The permission_levels are traversed in ascending order, which is:
       // ascending order of the actor name with ties broken by ascending order of the permission name.
-      for( const auto& p : permissions_to_satisfy ) {
-         checktime(); // TODO: this should eventually move into authority_checker instead
-         EOS_ASSERT( checker.satisfied( p.first, p.second ), unsatisfied_authorization,
+      auto assert_satisfied = [&]( auto& checker, const permission_level& level, fc::microseconds delay ) {
+         EOS_ASSERT( checker.satisfied( level, delay ), unsatisfied_authorization,
                      "transaction declares authority '${auth}', "
                      "but does not have signatures for it under a provided delay of ${provided_delay} ms, "
                      "provided permissions ${provided_permissions}, provided keys ${provided_keys}, "
                      "and a delay max limit of ${delay_max_limit_ms} ms",
-                     ("auth", p.first)
+                     ("auth", level)
                      ("provided_delay", provided_delay.count()/1000)
                      ("provided_permissions", provided_permissions)
                      ("provided_keys", provided_keys)
                      ("delay_max_limit_ms", delay_max_limit.count()/1000)
                    );
+      };
+
+      if( use_satisfied_cache && provided_permissions.empty() && !provided_keys.empty() ) {
+         // The keys an authority check marks as used depend only on the authority graph and the provided keys, so
+         // checking each permission with its own checker and merging the used keys is equivalent to sharing one.
+         const auto max_authority_depth = _control.get_global_properties().configuration.max_authority_depth;
+         const auto keys_digest = digest_type::hash( provided_keys );
+         flat_set<public_key_type> used_keys;
+         for( const auto& p : permissions_to_satisfy ) {
+            checktime(); // TODO: this should eventually move into authority_checker instead
+            satisfied_cache_key key{ keys_digest, p.first, p.second.count(), max_authority_depth };
+            auto itr = _satisfied_cache.find( key );
+            if( itr == _satisfied_cache.end() ) {
+               auto permission_checker = make_auth_checker( [&](const permission_level& perm) -> const shared_authority& { return get_permission(perm).auth; },
+                                                            max_authority_depth,
+                                                            provided_keys,
+                                                            provided_permissions,
+                                                            effective_provided_delay,
+                                                            checktime
+                                                          );
+               assert_satisfied( permission_checker, p.first, p.second );
+               if( _satisfied_cache.size() >= max_satisfied_cache_size )
+                  _satisfied_cache.clear();
+               itr = _satisfied_cache.emplace( std::move(key), permission_checker.used_keys() ).first;
+            }
+            used_keys.insert( itr->second.begin(), itr->second.end() );
+         }
 
+         if( !allow_unused_keys && used_keys.size() != provided_keys.size() ) {
+            flat_set<public_key_type> unused_keys;
+            std::set_difference( provided_keys.begin(), provided_keys.end(), used_keys.begin(), used_keys.end(),
+                                 std::inserter( unused_keys, unused_keys.end() ) );
+            EOS_THROW( tx_irrelevant_sig, "transaction bears irrelevant signatures from these keys: ${keys}",
+                       ("keys", unused_keys) );
+         }
+         return;
+      }
+
+      for( const auto& p : permissions_to_satisfy ) {
+         checktime(); // TODO: this should eventually move into authority_checker instead
+         assert_satisfied( checker, p.first, p.second );
       }
 
       if( !allow_unused_keys ) {
@@ -554,7 +600,7 @@ namespace eosio { namespace chain {
 
       auto delay_max_limit = fc::seconds( _control.get_global_properties().configuration.max_transaction_delay );
 
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const shared_authority& { return get_permission(p).auth; },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         provided_keys,
                                         provided_permissions,
@@ -585,7 +631,7 @@ namespace eosio { namespace chain {
                                                                        fc::microseconds provided_delay
                                                                      )const
    {
-      auto checker = make_auth_checker( [&](const permission_level& p){ return get_permission(p).auth; },
+      auto checker = make_auth_checker( [&](const permission_level& p) -> const shared_authority& { return get_permission(p).auth; },
                                         _control.get_global_properties().configuration.max_authority_depth,
                                         candidate_keys,
                                         {},
@@ -4,6 +4,23 @@
 #include <fc/bitutil.hpp>
 #include <fc/io/cfile.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/log/logger_config.hpp> //set_os_thread_name()
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <list>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
 
 
 #define LOG_READ  (std::ios::in | std::ios::binary)
@@ -36,9 +53,169 @@ namespace eosio { namespace chain {
 
    namespace detail {
       using unique_file = std::unique_ptr<FILE, decltype(&fclose)>;
+      namespace bip = boost::interprocess;
+
+      /**
+       * Bounded LRU of decoded blocks keyed by block number. Entries are spread over independently locked
+       * shards so that concurrent readers of different (consecutive) blocks do not contend on a single mutex.
+       * Every entry records the generation of the log it was read from; the generation changes whenever the files
+       * are closed (open, reset, roll, index rebuild), after which entries of an older generation are misses.
+       */
+      class block_cache {
+         public:
+            explicit block_cache( uint32_t capacity )
+            :_shard_capacity( (capacity + num_shards - 1) / num_shards ) {}
+
+            bool enabled()const { return _shard_capacity > 0; }
+
+            signed_block_ptr get( uint32_t block_num, uint64_t generation ) {
+               auto& s = shard_for( block_num );
+               std::lock_guard<std::mutex> g( s.mtx );
+               auto itr = s.index.find( block_num );
+               if( itr == s.index.end() )
+                  return {};
+               if( itr->second->generation != generation ) {
+                  s.lru.erase( itr->second );
+                  s.index.erase( itr );
+                  return {};
+               }
+               s.lru.splice( s.lru.begin(), s.lru, itr->second );
+               return itr->second->block;
+            }
+
+            void put( uint32_t block_num, uint64_t generation, const signed_block_ptr& b ) {
+               auto& s = shard_for( block_num );
+               std::lock_guard<std::mutex> g( s.mtx );
+               auto itr = s.index.find( block_num );
+               if( itr != s.index.end() ) {
+                  itr->second->generation = generation;
+                  itr->second->block = b;
+                  s.lru.splice( s.lru.begin(), s.lru, itr->second );
+                  return;
+               }
+               s.lru.push_front( entry{ block_num, generation, b } );
+               s.index.emplace( block_num, s.lru.begin() );
+               if( s.lru.size() > _shard_capacity ) {
+                  s.index.erase( s.lru.back().block_num );
+                  s.lru.pop_back();
+               }
+            }
+
+            void clear() {
+               for( auto& s : _shards ) {
+                  std::lock_guard<std::mutex> g( s.mtx );
+                  s.index.clear();
+                  s.lru.clear();
+               }
+            }
+
+         private:
+            static constexpr uint32_t num_shards = 16;
+
+            struct entry {
+               uint32_t          block_num;
+               uint64_t          generation;
+               signed_block_ptr  block;
+            };
+
+            struct shard {
+               using entry_list = std::list<entry>;
+               std::mutex                                           mtx;
+               entry_list                                           lru;
+               std::unordered_map<uint32_t, entry_list::iterator>   index;
+            };
+
+            shard& shard_for( uint32_t block_num ) { return _shards[block_num % num_shards]; }
+
+            const size_t                        _shard_capacity;
+            std::array<shard, num_shards>        _shards;
+      };
+
+      /**
+       * Read-only snapshot of the mapped block and index files. A mapping only covers the bytes present when it
+       * was created; readers needing data past its end request a new one via block_log_impl::mapping_for().
+       * Readers hold a shared_ptr to the mapping they use, so it is never unmapped underneath them.
+       */
+      struct log_mapping {
+         log_mapping( const fc::path& block_file_path, const fc::path& index_file_path ) {
+            map( block_file_path, block_fm, block_region );
+            map( index_file_path, index_fm, index_region );
+         }
+
+         const char* block_data()const { return static_cast<const char*>(block_region.get_address()); }
+         uint64_t    block_size()const { return block_region.get_size(); }
+         const char* index_data()const { return static_cast<const char*>(index_region.get_address()); }
+         uint64_t    index_size()const { return index_region.get_size(); }
+
+      private:
+         static void map( const fc::path& p, bip::file_mapping& fm, bip::mapped_region& region ) {
+            if( fc::file_size( p ) == 0 )
+               return; // cannot map an empty file, leave the region empty
+            fm = bip::file_mapping( p.generic_string().c_str(), bip::read_only );
+            region = bip::mapped_region( fm, bip::read_only );
+         }
+
+         bip::file_mapping    block_fm;
+         bip::mapped_region   block_region;
+         bip::file_mapping    index_fm;
+         bip::mapped_region   index_region;
+      };
+      using log_mapping_ptr = std::shared_ptr<const log_mapping>;
+
+      /// a range of the block log rolled off by the stride mode, the ordinary block log pair blocks-<first>-<last>.log/.index
+      struct block_range {
+         uint32_t  first = 0;
+         uint32_t  last = 0;
+         fc::path  block_file;
+         fc::path  index_file;
+      };
+
+      block_range make_block_range( const fc::path& dir, uint32_t first, uint32_t last ) {
+         const auto name = "blocks-" + std::to_string(first) + "-" + std::to_string(last);
+         return { first, last, dir / (name + ".log"), dir / (name + ".index") };
+      }
+
+      /// the complete block ranges in dir, ordered by block number
+      std::vector<block_range> find_block_ranges( const fc::path& dir ) {
+         std::vector<block_range> ranges;
+         if( !fc::is_directory( dir ) )
+            return ranges;
+         for( boost::filesystem::directory_iterator itr( dir ), end; itr != end; ++itr ) {
+            uint32_t first = 0, last = 0;
+            char ext[8] = {};
+            if( sscanf( itr->path().filename().string().c_str(), "blocks-%u-%u.%7s", &first, &last, ext ) != 3 ||
+                strcmp( ext, "log" ) != 0 || first > last )
+               continue;
+            auto r = make_block_range( dir, first, last );
+            if( fc::exists( r.index_file ) )
+               ranges.emplace_back( std::move(r) );
+         }
+         std::sort( ranges.begin(), ranges.end(), []( const auto& a, const auto& b ) { return a.first < b.first; } );
+         return ranges;
+      }
+
+      /// reads block_num from the memory mapped range m
+      signed_block_ptr read_range_block( const log_mapping& m, const block_range& r, uint32_t block_num ) {
+         const uint64_t index_pos = sizeof(uint64_t) * (block_num - r.first);
+         EOS_ASSERT( index_pos + sizeof(uint64_t) <= m.index_size(), block_log_exception,
+                     "Block ${n} is past the end of ${f}", ("n", block_num)("f", r.index_file) );
+         uint64_t pos;
+         memcpy( &pos, m.index_data() + index_pos, sizeof(pos) );
+         EOS_ASSERT( pos + sizeof(uint64_t) <= m.block_size(), block_log_exception,
+                     "Block ${n} is past the end of ${f}", ("n", block_num)("f", r.block_file) );
+         auto b = std::make_shared<signed_block>();
+         fc::datastream<const char*> ds( m.block_data() + pos, m.block_size() - pos );
+         fc::raw::unpack( ds, *b );
+         EOS_ASSERT( b->block_num() == block_num, block_log_exception, "Wrong block was read from ${f}.",
+                     ("f", r.block_file)("returned", b->block_num())("expected", block_num) );
+         return b;
+      }
 
       class block_log_impl {
          public:
+            block_log_impl( bool mmap_reads, uint32_t cache_size, const block_log_stride_config& stride )
+            :mmap_reads( mmap_reads ), cache( cache_size ), stride( stride ) {}
+
             signed_block_ptr         head;
             block_id_type            head_id;
             fc::cfile                block_file;
@@ -47,6 +224,16 @@ namespace eosio { namespace chain {
             bool                     genesis_written_to_block_log = false;
             uint32_t                 version = 0;
             uint32_t                 first_block_num = 0;
+            const bool               mmap_reads = false;
+            block_cache              cache;
+            std::atomic<uint64_t>    generation{0}; ///< of the open files, see block_cache
+            log_mapping_ptr          mapping; ///< only accessed through std::atomic_load/std::atomic_store
+            std::mutex               remap_mtx;
+            std::unique_ptr<block_log_archive> archive; ///< of the blocks before first_block_num, if any
+            const block_log_stride_config stride;
+            std::vector<block_range> ranges;       ///< rolled off ranges in the blocks dir, guarded by ranges_mtx
+            std::list<std::pair<uint32_t, log_mapping_ptr>> range_mappings; ///< most recently read ranges first, guarded by ranges_mtx
+            mutable std::mutex       ranges_mtx;
 
             inline void check_open_files() {
                if( !open_files ) {
@@ -61,6 +248,32 @@ namespace eosio { namespace chain {
                if( index_file.is_open() )
                   index_file.close();
                open_files = false;
+               ++generation;
+               std::atomic_store( &mapping, log_mapping_ptr() );
+            }
+
+            /// returns a mapping of the block file covering at least [0, block_end) and of the index file covering [0, index_end)
+            log_mapping_ptr mapping_for( uint64_t block_end, uint64_t index_end );
+
+            /**
+             * Unpacks t from the block at pos. The block's size is not known up front, and a mapping made while it was
+             * being appended ends inside it, so a short read is retried on a new mapping.
+             */
+            template<typename T>
+            void unpack_mapped( uint64_t pos, T& t ) {
+               // a block is always followed by its 8 byte position, so at least that much must be mapped
+               auto m = mapping_for( pos + sizeof(uint64_t), 0 );
+               EOS_ASSERT( pos + sizeof(uint64_t) <= m->block_size(), block_log_exception,
+                           "Block position ${pos} is past the end of the block log", ("pos", pos) );
+               try {
+                  fc::datastream<const char*> ds( m->block_data() + pos, m->block_size() - pos );
+                  fc::raw::unpack( ds, t );
+                  return;
+               } catch( const fc::out_of_range_exception& ) {}
+
+               m = mapping_for( m->block_size() + 1, 0 );
+               fc::datastream<const char*> ds( m->block_data() + pos, m->block_size() - pos );
+               fc::raw::unpack( ds, t );
             }
 
             template<typename T>
@@ -72,10 +285,15 @@ namespace eosio { namespace chain {
 
             void flush();
 
-            uint64_t append(const signed_block_ptr& b);
+            uint64_t append(const signed_block_ptr& b, const char* packed_block, size_t size);
+
+            /// renames the log ending at the head block to its range and starts a new log after it
+            void roll();
+            void apply_retention();
+            signed_block_ptr read_from_ranges( uint32_t block_num );
 
             template <typename ChainContext, typename Lambda>
-            static fc::optional<ChainContext> extract_chain_context( const fc::path& data_dir, Lambda&& lambda );
+            static fc::optional<ChainContext> extract_chain_context( const fc::path& block_file, Lambda&& lambda );
       };
 
       void detail::block_log_impl::reopen() {
@@ -94,6 +312,26 @@ namespace eosio { namespace chain {
          open_files = true;
       }
 
+      log_mapping_ptr detail::block_log_impl::mapping_for( uint64_t block_end, uint64_t index_end ) {
+         auto covers = [&]( const log_mapping_ptr& m ) {
+            return m && m->block_size() >= block_end && m->index_size() >= index_end;
+         };
+
+         auto m = std::atomic_load( &mapping );
+         if( covers( m ) )
+            return m;
+
+         std::lock_guard<std::mutex> g( remap_mtx );
+         m = std::atomic_load( &mapping );
+         if( covers( m ) )
+            return m;
+
+         // appends are flushed before they are visible through head, so the files contain everything readable
+         m = std::make_shared<const log_mapping>( block_file.get_file_path(), index_file.get_file_path() );
+         std::atomic_store( &mapping, m );
+         return m;
+      }
+
       class reverse_iterator {
       public:
          reverse_iterator();
@@ -179,10 +417,164 @@ namespace eosio { namespace chain {
          FILE* const _file;
          const std::string _filename;
       };
+
+      /**
+       * Read-only mapping of a whole blocks.log used by the parallel index rebuild and repair. Every block is
+       * followed by the 8 byte position it starts at, so once the mapping is resident block boundaries can be
+       * recovered by chasing those positions back from the end without reading the blocks themselves.
+       */
+      struct mapped_block_log {
+         explicit mapped_block_log(const fc::path& block_file_name)
+         : file(block_file_name.generic_string().c_str(), bip::read_only)
+         , region(file, bip::read_only)
+         , data(static_cast<const char*>(region.get_address()))
+         , size(region.get_size())
+         , name(block_file_name.generic_string()) {
+            EOS_ASSERT( size >= sizeof(version), block_log_exception, "Block log file at '${blocks_log}' could not be read.", ("blocks_log", name) );
+            memcpy(&version, data, sizeof(version));
+            EOS_ASSERT( block_log::is_supported_version(version), block_log_unsupported_version,
+                        "block log version ${v} is not supported", ("v", version));
+            if (version != 1) {
+               EOS_ASSERT( size >= sizeof(version) + sizeof(first_block_num), block_log_exception,
+                           "Block log file at '${blocks_log}' not formatted consistently with version ${v}.", ("blocks_log", name)("v", version) );
+               memcpy(&first_block_num, data + sizeof(version), sizeof(first_block_num));
+            }
+         }
+
+         uint64_t position_at(uint64_t offset) const {
+            uint64_t pos;
+            memcpy(&pos, data + offset, sizeof(pos));
+            return pos;
+         }
+
+         // block number of the block starting at block_pos, from the big endian block number of its previous block
+         uint32_t block_num_at(uint64_t block_pos) const {
+            uint32_t bnum;
+            memcpy(&bnum, data + block_pos + trim_data::blknum_offset, sizeof(bnum));
+            return fc::endian_reverse_u32(bnum) + 1;
+         }
+
+         bip::file_mapping   file;
+         bip::mapped_region  region;
+         const char*         data;
+         uint64_t            size;
+         std::string         name;
+         uint32_t            version         = 0;
+         uint32_t            first_block_num = 1;
+      };
+
+      // splits [0, count) into one contiguous segment per hardware thread and runs f(segment, begin, end) on each,
+      // rethrowing the first exception raised by any of them
+      uint32_t segment_count(uint32_t count) {
+         constexpr uint32_t min_segment = 1U << 12;
+         return std::max(1U, std::min(std::thread::hardware_concurrency(), count / min_segment));
+      }
+
+      template<typename F>
+      void for_each_segment(uint32_t count, F&& f) {
+         const uint32_t threads = segment_count(count);
+         std::vector<std::future<void>> done;
+         for (uint32_t s = 0; s < threads; ++s) {
+            const uint32_t begin = uint64_t(count) * s / threads;
+            const uint32_t end   = uint64_t(count) * (s + 1) / threads;
+            done.emplace_back(std::async(std::launch::async, [&f, s, begin, end]() { f(s, begin, end); }));
+         }
+         for (auto& d : done)
+            d.get();
+      }
+
+      // faults [begin, end) of the mapping in with one sequential read, just ahead of the trailing positions being
+      // chased backwards, which would otherwise wait on the disk one block at a time
+      void prefault(const mapped_block_log& log, uint64_t begin, uint64_t end) {
+         constexpr uint64_t page_size = 4096;
+         volatile char sink = 0;
+         for (uint64_t p = begin - begin % page_size; p < end; p += page_size)
+            sink += log.data[p];
+      }
+
+      struct verified_blocks {
+         uint32_t      count = 0;
+         uint64_t      end   = 0; ///< position just past the trailing position of the last verified block
+         block_id_type last_id;
+      };
+
+      /**
+       * Verifies the leading blocks of a possibly damaged log in parallel, taking their boundaries from the index
+       * that was kept alongside it. Blocks are accepted up to the first one that does not unpack, does not repack to
+       * its stored size, is not followed by its own position or does not link to the block before it; the caller
+       * recovers whatever follows block by block.
+       */
+      verified_blocks verify_indexed_blocks(const mapped_block_log& log, const fc::path& index_file_name,
+                                            uint64_t first_pos, const block_id_type& previous, uint32_t max_blocks) {
+         verified_blocks result{0, first_pos, previous};
+         if (!fc::is_regular_file(index_file_name) || fc::file_size(index_file_name) < sizeof(uint64_t))
+            return result;
+
+         bip::file_mapping  index_mapping(index_file_name.generic_string().c_str(), bip::read_only);
+         bip::mapped_region index_region(index_mapping, bip::read_only);
+         const char* const  index = static_cast<const char*>(index_region.get_address());
+         const uint32_t     num_blocks = std::min<uint64_t>(index_region.get_size() / sizeof(uint64_t), max_blocks);
+         auto entry = [index](uint32_t i) {
+            uint64_t pos;
+            memcpy(&pos, index + uint64_t(i) * sizeof(pos), sizeof(pos));
+            return pos;
+         };
+         if (num_blocks == 0 || entry(0) != first_pos)
+            return result;
+
+         struct segment_result {
+            uint32_t      count = 0;
+            uint64_t      end   = 0;
+            block_id_type first_previous;
+            block_id_type last_id;
+         };
+         std::vector<segment_result> segments(segment_count(num_blocks));
+         for_each_segment(num_blocks, [&](uint32_t segment, uint32_t begin, uint32_t end) {
+            auto& r = segments[segment];
+            for (uint32_t i = begin; i < end; ++i) {
+               const uint64_t pos = entry(i);
+               if (pos >= log.size)
+                  break;
+               signed_block block;
+               fc::datastream<const char*> ds(log.data + pos, log.size - pos);
+               try {
+                  fc::raw::unpack(ds, block);
+               } catch (...) {
+                  break;
+               }
+               const uint64_t block_end = pos + ds.tellp();
+               if (block_end + sizeof(uint64_t) > log.size || log.position_at(block_end) != pos ||
+                   fc::raw::pack_size(block) != block_end - pos || block.block_num() != log.first_block_num + i ||
+                   (i + 1 < num_blocks && entry(i + 1) != block_end + sizeof(uint64_t)))
+                  break;
+               if (i == begin)
+                  r.first_previous = block.previous;
+               else if (block.previous != r.last_id)
+                  break;
+               r.last_id = block.id();
+               r.end     = block_end + sizeof(uint64_t);
+               ++r.count;
+            }
+            ilog("verified ${n} blocks starting at block ${first}", ("n", r.count)("first", log.first_block_num + begin));
+         });
+
+         // segments only extend the verified prefix while each one is whole and links to the one before it
+         for (uint32_t s = 0; s < segments.size(); ++s) {
+            const auto& r = segments[s];
+            if (r.count == 0 || r.first_previous != result.last_id)
+               break;
+            result.count  += r.count;
+            result.end     = r.end;
+            result.last_id = r.last_id;
+            if (r.count != uint64_t(num_blocks) * (s + 1) / segments.size() - uint64_t(num_blocks) * s / segments.size())
+               break;
+         }
+         return result;
+      }
    }
 
-   block_log::block_log(const fc::path& data_dir)
-   :my(new detail::block_log_impl()) {
+   block_log::block_log(const fc::path& data_dir, bool mmap_reads, uint32_t cache_size, const block_log_stride_config& stride)
+   :my(new detail::block_log_impl(mmap_reads, cache_size, stride)) {
       open(data_dir);
    }
 
@@ -284,13 +676,47 @@ namespace eosio { namespace chain {
          fc::remove_all( my->index_file.get_file_path() );
          my->reopen();
       }
+
+      {
+         std::lock_guard<std::mutex> g( my->ranges_mtx );
+         my->ranges = detail::find_block_ranges( data_dir );
+         // a range overlapping the log is left over from a roll interrupted before the new log was started
+         while( !my->ranges.empty() && log_size && my->ranges.back().last >= my->first_block_num )
+            my->ranges.pop_back();
+         my->range_mappings.clear();
+      }
+      if( !my->ranges.empty() ) {
+         const auto& newest = my->ranges.back();
+         ilog("Block log ranges hold blocks ${f} through ${l}", ("f", my->ranges.front().first)("l", newest.last));
+         if( !log_size ) {
+            // interrupted after the log was renamed to its range, start the log that follows it
+            my->reset( extract_chain_id_from_file( newest.block_file ), signed_block_ptr(), newest.last + 1 );
+         }
+         if( !my->head ) {
+            my->head = my->read_from_ranges( newest.last );
+            my->head_id = my->head->id();
+         }
+      }
+      my->apply_retention();
+
+      my->archive.reset();
+      if( block_log_archive::exists( data_dir ) ) {
+         my->archive = std::make_unique<block_log_archive>( data_dir );
+         ilog("Block log archive holds blocks ${f} through ${l}",
+              ("f", my->archive->first_block_num())("l", my->archive->last_block_num()));
+      }
    }
 
    uint64_t block_log::append(const signed_block_ptr& b) {
-      return my->append(b);
+      auto data = fc::raw::pack(*b);
+      return my->append(b, data.data(), data.size());
+   }
+
+   uint64_t block_log::append(const signed_block_ptr& b, const char* packed_block, size_t size) {
+      return my->append(b, packed_block, size);
    }
 
-   uint64_t detail::block_log_impl::append(const signed_block_ptr& b) {
+   uint64_t detail::block_log_impl::append(const signed_block_ptr& b, const char* packed_block, size_t size) {
       try {
          EOS_ASSERT( genesis_written_to_block_log, block_log_append_fail, "Cannot append to block log until the genesis is first written" );
 
@@ -304,8 +730,7 @@ namespace eosio { namespace chain {
                    "Append to index file occuring at wrong position.",
                    ("position", (uint64_t) index_file.tellp())
                    ("expected", (b->block_num() - first_block_num) * sizeof(uint64_t)));
-         auto data = fc::raw::pack(*b);
-         block_file.write(data.data(), data.size());
+         block_file.write(packed_block, size);
          block_file.write((char*)&pos, sizeof(pos));
          index_file.write((char*)&pos, sizeof(pos));
          head = b;
@@ -313,11 +738,96 @@ namespace eosio { namespace chain {
 
          flush();
 
+         if( stride.stride > 0 && b->block_num() % stride.stride == 0 )
+            roll();
+
          return pos;
       }
       FC_LOG_AND_RETHROW()
    }
 
+   void detail::block_log_impl::roll() {
+      const auto dir = block_file.get_file_path().parent_path();
+      const uint32_t last = block_header::num_from_id( head_id );
+      const auto chain_id = block_log::extract_chain_id_from_file( block_file.get_file_path() );
+      auto r = make_block_range( dir, first_block_num, last );
+
+      close();
+      fc::rename( block_file.get_file_path(), r.block_file );
+      fc::rename( index_file.get_file_path(), r.index_file );
+      ilog( "Rolled block log to ${f}", ("f", r.block_file.filename().generic_string()) );
+      {
+         std::lock_guard<std::mutex> g( ranges_mtx );
+         ranges.emplace_back( std::move(r) );
+      }
+
+      // the head stays the last block of the range until a block is appended to the new log
+      auto h = head;
+      auto h_id = head_id;
+      reset( chain_id, signed_block_ptr(), last + 1 );
+      head = std::move(h);
+      head_id = h_id;
+
+      apply_retention();
+   }
+
+   void detail::block_log_impl::apply_retention() {
+      if( stride.max_retained_files == 0 )
+         return;
+      while( true ) {
+         block_range r;
+         {
+            std::lock_guard<std::mutex> g( ranges_mtx );
+            if( ranges.size() <= stride.max_retained_files )
+               return;
+            r = std::move( ranges.front() );
+            ranges.erase( ranges.begin() );
+            range_mappings.remove_if( [&]( const auto& e ) { return e.first == r.first; } );
+         }
+         // readers still holding a mapping of the range keep reading it, the files are only unlinked
+         if( stride.archive_dir.empty() ) {
+            fc::remove( r.block_file );
+            fc::remove( r.index_file );
+            ilog( "Removed block log range ${f}", ("f", r.block_file.filename().generic_string()) );
+         } else {
+            fc::create_directories( stride.archive_dir );
+            fc::rename( r.block_file, stride.archive_dir / r.block_file.filename() );
+            fc::rename( r.index_file, stride.archive_dir / r.index_file.filename() );
+            ilog( "Moved block log range ${f} to ${d}",
+                  ("f", r.block_file.filename().generic_string())("d", stride.archive_dir.generic_string()) );
+         }
+      }
+   }
+
+   signed_block_ptr detail::block_log_impl::read_from_ranges( uint32_t block_num ) {
+      constexpr size_t max_range_mappings = 2;
+      block_range r;
+      log_mapping_ptr m;
+      {
+         std::lock_guard<std::mutex> g( ranges_mtx );
+         auto itr = std::upper_bound( ranges.begin(), ranges.end(), block_num,
+                                      []( uint32_t n, const block_range& r ) { return n < r.first; } );
+         if( itr == ranges.begin() || block_num > std::prev(itr)->last )
+            return {};
+         r = *std::prev(itr);
+         for( auto e = range_mappings.begin(); e != range_mappings.end(); ++e ) {
+            if( e->first == r.first ) {
+               range_mappings.splice( range_mappings.begin(), range_mappings, e );
+               m = e->second;
+               break;
+            }
+         }
+      }
+      if( !m ) {
+         m = std::make_shared<const log_mapping>( r.block_file, r.index_file );
+         std::lock_guard<std::mutex> g( ranges_mtx );
+         range_mappings.emplace_front( r.first, m );
+         if( range_mappings.size() > max_range_mappings )
+            range_mappings.pop_back();
+      }
+      return read_range_block( *m, r, block_num );
+   }
+
    void block_log::flush() {
       my->flush();
    }
@@ -330,6 +840,7 @@ namespace eosio { namespace chain {
    template<typename T>
    void detail::block_log_impl::reset( const T& t, const signed_block_ptr& first_block, uint32_t first_bnum ) {
       close();
+      cache.clear();
 
       fc::remove_all( block_file.get_file_path() );
       fc::remove_all( index_file.get_file_path() );
@@ -351,7 +862,8 @@ namespace eosio { namespace chain {
       block_file.write((char*)&totem, sizeof(totem));
 
       if (first_block) {
-         append(first_block);
+         auto data = fc::raw::pack(*first_block);
+         append(first_block, data.data(), data.size());
       } else {
          head.reset();
          head_id = {};
@@ -391,8 +903,13 @@ namespace eosio { namespace chain {
    signed_block_ptr block_log::read_block(uint64_t pos)const {
       my->check_open_files();
 
-      my->block_file.seek(pos);
       signed_block_ptr result = std::make_shared<signed_block>();
+      if( my->mmap_reads ) {
+         my->unpack_mapped( pos, *result );
+         return result;
+      }
+
+      my->block_file.seek(pos);
       auto ds = my->block_file.create_datastream();
       fc::raw::unpack(ds, *result);
       return result;
@@ -401,6 +918,11 @@ namespace eosio { namespace chain {
    void block_log::read_block_header(block_header& bh, uint64_t pos)const {
       my->check_open_files();
 
+      if( my->mmap_reads ) {
+         my->unpack_mapped( pos, bh );
+         return;
+      }
+
       my->block_file.seek(pos);
       auto ds = my->block_file.create_datastream();
       fc::raw::unpack(ds, bh);
@@ -408,19 +930,73 @@ namespace eosio { namespace chain {
 
    signed_block_ptr block_log::read_block_by_num(uint32_t block_num)const {
       try {
+         if( block_num < my->first_block_num ) {
+            auto b = my->read_from_ranges(block_num);
+            if( !b && my->archive )
+               b = my->archive->read_block_by_num(block_num);
+            return b;
+         }
          signed_block_ptr b;
+         const uint64_t generation = my->generation.load();
+         if( my->cache.enabled() ) {
+            b = my->cache.get(block_num, generation);
+            if( b ) return b;
+         }
          uint64_t pos = get_block_pos(block_num);
          if (pos != npos) {
             b = read_block(pos);
             EOS_ASSERT(b->block_num() == block_num, reversible_blocks_exception,
                       "Wrong block was read from block log.", ("returned", b->block_num())("expected", block_num));
+            if( my->cache.enabled() )
+               my->cache.put(block_num, generation, b);
          }
          return b;
       } FC_LOG_AND_RETHROW()
    }
 
+   std::vector<char> block_log::read_serialized_block_by_num(uint32_t block_num, size_t prefix_size)const {
+      std::vector<char> result;
+      if( block_num < my->first_block_num )
+         return result;
+      const uint64_t pos = get_block_pos(block_num);
+      if( pos == npos )
+         return result;
+
+      // every block is followed by its 8 byte position, the next block or the end of the file follows that
+      uint64_t end;
+      if( block_num < block_header::num_from_id(my->head_id) ) {
+         end = get_block_pos(block_num + 1);
+      } else {
+         end = fc::file_size( my->block_file.get_file_path() );
+      }
+      EOS_ASSERT( end != npos && end >= pos + 2 * sizeof(uint64_t), block_log_exception,
+                  "Block ${num} at ${pos} has no room in the block log", ("num", block_num)("pos", pos) );
+      const uint64_t size = end - pos - sizeof(uint64_t);
+
+      result.resize( prefix_size + size + sizeof(uint64_t) );
+      if( my->mmap_reads ) {
+         auto m = my->mapping_for( end, 0 );
+         EOS_ASSERT( end <= m->block_size(), block_log_exception,
+                     "Block ${num} is past the end of the block log", ("num", block_num) );
+         memcpy( result.data() + prefix_size, m->block_data() + pos, size + sizeof(uint64_t) );
+      } else {
+         my->block_file.seek(pos);
+         my->block_file.read( result.data() + prefix_size, size + sizeof(uint64_t) );
+      }
+      uint64_t trailing_pos;
+      memcpy( &trailing_pos, result.data() + prefix_size + size, sizeof(trailing_pos) );
+      EOS_ASSERT( trailing_pos == pos, block_log_exception,
+                  "Block ${num} at ${pos} is not followed by its position in the block log", ("num", block_num)("pos", pos) );
+      result.resize( prefix_size + size );
+      return result;
+   }
+
    block_id_type block_log::read_block_id_by_num(uint32_t block_num)const {
       try {
+         if( block_num < my->first_block_num ) {
+            auto b = read_block_by_num(block_num);
+            return b ? b->id() : block_id_type();
+         }
          uint64_t pos = get_block_pos(block_num);
          if (pos != npos) {
             block_header bh;
@@ -437,8 +1013,16 @@ namespace eosio { namespace chain {
       my->check_open_files();
       if (!(my->head && block_num <= block_header::num_from_id(my->head_id) && block_num >= my->first_block_num))
          return npos;
-      my->index_file.seek(sizeof(uint64_t) * (block_num - my->first_block_num));
+      const uint64_t index_pos = sizeof(uint64_t) * (block_num - my->first_block_num);
       uint64_t pos;
+      if( my->mmap_reads ) {
+         auto m = my->mapping_for( 0, index_pos + sizeof(pos) );
+         EOS_ASSERT( index_pos + sizeof(pos) <= m->index_size(), block_log_exception,
+                     "Block ${num} is past the end of the block log index", ("num", block_num) );
+         memcpy( &pos, m->index_data() + index_pos, sizeof(pos) );
+         return pos;
+      }
+      my->index_file.seek(index_pos);
       my->index_file.read((char*)&pos, sizeof(pos));
       return pos;
    }
@@ -471,7 +1055,8 @@ namespace eosio { namespace chain {
    }
 
    uint32_t block_log::first_block_num() const {
-      return my->first_block_num;
+      std::lock_guard<std::mutex> g( my->ranges_mtx );
+      return my->ranges.empty() ? my->first_block_num : my->ranges.front().first;
    }
 
    void block_log::construct_index() {
@@ -491,28 +1076,77 @@ namespace eosio { namespace chain {
    } // construct_index
 
    void block_log::construct_index(const fc::path& block_file_name, const fc::path& index_file_name) {
-      detail::reverse_iterator block_log_iter;
-
       ilog("Will read existing blocks.log file ${file}", ("file", block_file_name.generic_string()));
       ilog("Will write new blocks.index file ${file}", ("file", index_file_name.generic_string()));
 
-      const uint32_t num_blocks = block_log_iter.open(block_file_name);
-
-      ilog("block log version= ${version}", ("version", block_log_iter.version()));
+      const detail::mapped_block_log log(block_file_name);
+      ilog("block log version= ${version}", ("version", log.version));
 
-      if (num_blocks == 0) {
+      EOS_ASSERT( log.size >= sizeof(uint64_t), block_log_exception, "Block log file at '${blocks_log}' could not be read.", ("blocks_log", log.name) );
+      const uint64_t last_pos = log.position_at(log.size - sizeof(uint64_t));
+      if (last_pos == npos) {
          return;
       }
+      EOS_ASSERT( last_pos + trim_data::blknum_offset + sizeof(uint32_t) <= log.size, block_log_exception,
+                  "Block log file at '${blocks_log}' formatting is incorrect, last block position ${pos} is past the end of the file",
+                  ("blocks_log", log.name)("pos", last_pos) );
+      const uint32_t last_block_num = log.block_num_at(last_pos);
+      EOS_ASSERT( last_block_num >= log.first_block_num, block_log_exception,
+                  "Block log file at '${blocks_log}' formatting indicated last block: ${last_block_num}, first block: ${first_block_num}",
+                  ("blocks_log", log.name)("last_block_num", last_block_num)("first_block_num", log.first_block_num) );
+      const uint32_t num_blocks = last_block_num - log.first_block_num + 1;
+
+      ilog("first block= ${first}         last block= ${last}", ("first", log.first_block_num)("last", last_block_num));
+
+      {
+         std::ofstream create(index_file_name.generic_string(), std::ios::out | std::ios::binary | std::ios::trunc);
+      }
+      boost::filesystem::resize_file(index_file_name, uint64_t(num_blocks) * sizeof(uint64_t));
+      bip::file_mapping  index_mapping(index_file_name.generic_string().c_str(), bip::read_write);
+      bip::mapped_region index_region(index_mapping, bip::read_write);
+      char* const index = static_cast<char*>(index_region.get_address());
+      auto index_at = [index](uint32_t i) {
+         uint64_t pos;
+         memcpy(&pos, index + uint64_t(i) * sizeof(uint64_t), sizeof(pos));
+         return pos;
+      };
 
-      ilog("first block= ${first}         last block= ${last}",
-           ("first", block_log_iter.first_block_num())("last", (block_log_iter.first_block_num() + num_blocks)));
-
-      detail::index_writer index(index_file_name, num_blocks);
-      uint64_t position;
-      while ((position = block_log_iter.previous()) != npos) {
-         index.write(position);
+      // the trailing positions only link backwards, so the chain itself is followed on one thread, writing the index
+      // from its end; the log is faulted in a window at a time just ahead of the chase, so each page is read once
+      constexpr uint64_t prefault_window = 64*1024*1024;
+      uint64_t faulted = log.size;
+      uint64_t trailer = log.size - sizeof(uint64_t);
+      for (uint32_t i = num_blocks; i-- > 0;) {
+         if (trailer < faulted) {
+            const uint64_t begin = trailer > prefault_window ? trailer - prefault_window : 0;
+            detail::prefault(log, begin, faulted);
+            faulted = begin;
+         }
+         const uint64_t pos = log.position_at(trailer);
+         EOS_ASSERT( pos != npos && pos >= sizeof(uint64_t) && pos < trailer, block_log_exception,
+                     "Block log file at '${blocks_log}' formatting is incorrect, indicates position ${pos} for block ${num}, which was retrieved at: ${orig_pos}.",
+                     ("blocks_log", log.name)("pos", pos)("num", log.first_block_num + i)("orig_pos", trailer) );
+         memcpy(index + uint64_t(i) * sizeof(uint64_t), &pos, sizeof(pos));
+         trailer = pos - sizeof(uint64_t);
       }
-      index.complete();
+      if (log.version != 1) {
+         EOS_ASSERT( log.position_at(trailer) == npos, block_log_exception,
+                     "Block log file at '${blocks_log}' formatting indicated last block: ${last_block_num}, first block: ${first_block_num}, but more blocks were found",
+                     ("blocks_log", log.name)("last_block_num", last_block_num)("first_block_num", log.first_block_num) );
+      }
+
+      // every region checks that its blocks carry consecutive block numbers
+      detail::for_each_segment(num_blocks, [&](uint32_t segment, uint32_t begin, uint32_t end) {
+         for (uint32_t i = begin; i < end; ++i) {
+            const uint32_t expected = log.first_block_num + i;
+            const uint64_t pos = index_at(i);
+            EOS_ASSERT( log.block_num_at(pos) == expected, block_log_exception,
+                        "Block log file at '${blocks_log}' has block ${actual} at position ${pos} where block ${expected} was expected",
+                        ("blocks_log", log.name)("actual", log.block_num_at(pos))("pos", pos)("expected", expected) );
+         }
+         ilog("indexed blocks ${first} - ${last}", ("first", log.first_block_num + begin)("last", log.first_block_num + end - 1));
+      });
+      index_region.flush();
    }
 
    fc::path block_log::repair_log( const fc::path& data_dir, uint32_t truncate_at_block ) {
@@ -617,7 +1251,27 @@ namespace eosio { namespace chain {
       block_id_type previous;
 
       uint64_t pos = old_block_stream.tellg();
-      while( pos < end_pos ) {
+
+      // the blocks still covered by the old index are verified in parallel and copied through unchanged
+      bool truncated = false;
+      {
+         const detail::mapped_block_log old_log( backup_dir / "blocks.log" );
+         const uint32_t max_blocks = truncate_at_block ? truncate_at_block - first_block_num + 1 : std::numeric_limits<uint32_t>::max();
+         const auto verified = detail::verify_indexed_blocks( old_log, backup_dir / "blocks.index", pos, previous, max_blocks );
+         if( verified.count > 0 ) {
+            constexpr uint64_t chunk = 1U << 26;
+            for( uint64_t p = pos; p < verified.end; p += chunk )
+               new_block_stream.write( old_log.data + p, std::min( chunk, verified.end - p ) );
+            block_num = first_block_num + verified.count - 1;
+            previous  = verified.last_id;
+            pos       = verified.end;
+            old_block_stream.seekg( pos );
+            truncated = block_num == truncate_at_block;
+            ilog( "Recovered blocks ${first} - ${last} covered by the existing index", ("first", first_block_num)("last", block_num) );
+         }
+      }
+
+      while( !truncated && pos < end_pos ) {
          signed_block tmp;
 
          try {
@@ -702,12 +1356,12 @@ namespace eosio { namespace chain {
    }
 
    template <typename ChainContext, typename Lambda>
-   fc::optional<ChainContext> detail::block_log_impl::extract_chain_context( const fc::path& data_dir, Lambda&& lambda ) {
-      EOS_ASSERT( fc::is_directory(data_dir) && fc::is_regular_file(data_dir / "blocks.log"), block_log_not_found,
-                  "Block log not found in '${blocks_dir}'", ("blocks_dir", data_dir)          );
+   fc::optional<ChainContext> detail::block_log_impl::extract_chain_context( const fc::path& block_file, Lambda&& lambda ) {
+      EOS_ASSERT( fc::is_regular_file(block_file), block_log_not_found,
+                  "Block log '${block_file}' not found", ("block_file", block_file)          );
 
       std::fstream  block_stream;
-      block_stream.open( (data_dir / "blocks.log").generic_string().c_str(), LOG_READ );
+      block_stream.open( block_file.generic_string().c_str(), LOG_READ );
 
       uint32_t version = 0;
       block_stream.read( (char*)&version, sizeof(version) );
@@ -724,7 +1378,7 @@ namespace eosio { namespace chain {
    }
 
    fc::optional<genesis_state> block_log::extract_genesis_state( const fc::path& data_dir ) {
-      return detail::block_log_impl::extract_chain_context<genesis_state>(data_dir, [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<genesis_state> {
+      return detail::block_log_impl::extract_chain_context<genesis_state>(data_dir / "blocks.log", [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<genesis_state> {
          if (contains_genesis_state(version, first_block_num)) {
             genesis_state gs;
             fc::raw::unpack(block_stream, gs);
@@ -737,7 +1391,11 @@ namespace eosio { namespace chain {
    }
 
    chain_id_type block_log::extract_chain_id( const fc::path& data_dir ) {
-      return *(detail::block_log_impl::extract_chain_context<chain_id_type>(data_dir, [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<chain_id_type> {
+      return extract_chain_id_from_file( data_dir / "blocks.log" );
+   }
+
+   chain_id_type block_log::extract_chain_id_from_file( const fc::path& block_file ) {
+      return *(detail::block_log_impl::extract_chain_context<chain_id_type>(block_file, [](std::fstream& block_stream, uint32_t version, uint32_t first_block_num ) -> fc::optional<chain_id_type> {
          // supported versions either contain a genesis state, or else the chain id only
          if (contains_genesis_state(version, first_block_num)) {
             genesis_state gs;
@@ -1184,4 +1842,486 @@ namespace eosio { namespace chain {
       return block_n_pos;
    }
 
+   namespace detail {
+      class block_log_prefetcher_impl {
+         public:
+            block_log_prefetcher_impl( const fc::path& data_dir, uint32_t start_block_num, uint32_t end_block_num,
+                                       uint32_t read_ahead )
+            :start_block_num( start_block_num ), end_block_num( end_block_num )
+            ,read_ahead( std::max<uint32_t>( read_ahead, 1 ) )
+            {
+               uint32_t version = 0, first_block_num = 1;
+               {
+                  std::ifstream header( (data_dir / "blocks.log").generic_string().c_str(), LOG_READ );
+                  header.read( (char*)&version, sizeof(version) );
+                  if( version > 1 )
+                     header.read( (char*)&first_block_num, sizeof(first_block_num) );
+                  EOS_ASSERT( header.good() && block_log::is_supported_version( version ), block_log_exception,
+                              "Unable to read the header of the block log in ${d}", ("d", data_dir) );
+               }
+               // blocks before the first of blocks.log are read from the ranges rolled off by the stride mode
+               files = find_block_ranges( data_dir );
+               files.erase( std::remove_if( files.begin(), files.end(), [&]( const auto& r ) { return r.last >= first_block_num; } ),
+                            files.end() );
+               files.push_back( { first_block_num, std::numeric_limits<uint32_t>::max(),
+                                  data_dir / "blocks.log", data_dir / "blocks.index" } );
+               reader = std::thread( [this]() {
+                  fc::set_os_thread_name( "blockread" );
+                  read_blocks();
+               } );
+            }
+
+            ~block_log_prefetcher_impl() {
+               {
+                  std::lock_guard<std::mutex> g( mtx );
+                  stopping = true;
+               }
+               cv.notify_all();
+               reader.join();
+            }
+
+            signed_block_ptr next() {
+               std::unique_lock<std::mutex> g( mtx );
+               cv.wait( g, [this]() { return !blocks.empty() || done; } );
+               if( !blocks.empty() ) {
+                  auto b = std::move( blocks.front() );
+                  blocks.pop_front();
+                  cv.notify_all();
+                  return b;
+               }
+               if( except )
+                  std::rethrow_exception( except );
+               return {};
+            }
+
+         private:
+            /// opens the file pair holding block_num unless it is already open
+            void open_file_for( uint32_t block_num ) {
+               if( cur_file && block_num >= cur_file->first && block_num <= cur_file->last )
+                  return;
+               auto itr = std::find_if( files.begin(), files.end(), [&]( const auto& f ) {
+                  return block_num >= f.first && block_num <= f.last;
+               } );
+               EOS_ASSERT( itr != files.end(), block_log_exception, "Block ${n} is not in the block log", ("n", block_num) );
+               cur_file = &*itr;
+               block_stream.close();
+               index_stream.close();
+               block_stream.clear();
+               index_stream.clear();
+               block_stream.open( cur_file->block_file.generic_string().c_str(), LOG_READ );
+               index_stream.open( cur_file->index_file.generic_string().c_str(), LOG_READ );
+               EOS_ASSERT( block_stream.is_open() && index_stream.is_open(), block_log_exception,
+                           "Unable to open block log ${f} for reading", ("f", cur_file->block_file) );
+               block_stream.seekg( 0, std::ios::end );
+               block_file_size = block_stream.tellg();
+            }
+
+            uint64_t block_pos( uint32_t block_num ) {
+               uint64_t pos;
+               index_stream.seekg( sizeof(pos) * (block_num - cur_file->first) );
+               index_stream.read( (char*)&pos, sizeof(pos) );
+               EOS_ASSERT( index_stream.good(), block_log_exception,
+                           "Unable to read the position of block ${n} from the block log index", ("n", block_num) );
+               return pos;
+            }
+
+            void read_blocks() {
+               try {
+                  std::vector<char> buf;
+                  uint64_t pos = 0;
+                  for( uint32_t n = start_block_num; n <= end_block_num; ++n ) {
+                     if( !cur_file || n > cur_file->last ) {
+                        open_file_for( n );
+                        pos = block_pos( n );
+                     }
+                     // every block is followed by its 8 byte position, the next block starts after it
+                     const uint64_t end = n < std::min( end_block_num, cur_file->last ) ? block_pos( n + 1 ) : block_file_size;
+                     EOS_ASSERT( end >= pos + sizeof(uint64_t), block_log_exception,
+                                 "Invalid position of block ${n} in the block log index", ("n", n + 1) );
+                     buf.resize( end - pos - sizeof(uint64_t) );
+                     block_stream.seekg( pos );
+                     block_stream.read( buf.data(), buf.size() );
+                     EOS_ASSERT( block_stream.good(), block_log_exception, "Unable to read block ${n} from the block log", ("n", n) );
+
+                     auto b = std::make_shared<signed_block>();
+                     fc::datastream<const char*> ds( buf.data(), buf.size() );
+                     fc::raw::unpack( ds, *b );
+                     EOS_ASSERT( b->block_num() == n, block_log_exception, "Wrong block was read from block log.",
+                                 ("returned", b->block_num())("expected", n) );
+
+                     std::unique_lock<std::mutex> g( mtx );
+                     cv.wait( g, [this]() { return stopping || blocks.size() < read_ahead; } );
+                     if( stopping )
+                        return;
+                     blocks.emplace_back( std::move( b ) );
+                     cv.notify_all();
+                     pos = end;
+                  }
+               } catch( ... ) {
+                  std::lock_guard<std::mutex> g( mtx );
+                  except = std::current_exception();
+               }
+               std::lock_guard<std::mutex> g( mtx );
+               done = true;
+               cv.notify_all();
+            }
+
+            std::vector<block_range>     files;     ///< holding the blocks to read, ordered by block number
+            const block_range*           cur_file = nullptr;
+            const uint32_t               start_block_num;
+            const uint32_t               end_block_num;
+            const uint32_t               read_ahead;
+            std::ifstream                block_stream;  ///< reader thread only, after construction
+            std::ifstream                index_stream;  ///< reader thread only, after construction
+            uint64_t                     block_file_size = 0;
+
+            std::mutex                   mtx;
+            std::condition_variable      cv;
+            std::deque<signed_block_ptr> blocks;
+            bool                         done = false;
+            bool                         stopping = false;
+            std::exception_ptr           except;
+            std::thread                  reader;
+      };
+   }
+
+   block_log_prefetcher::block_log_prefetcher(const fc::path& data_dir, uint32_t start_block_num, uint32_t end_block_num,
+                                              uint32_t read_ahead)
+   :my( std::make_unique<detail::block_log_prefetcher_impl>( data_dir, start_block_num, end_block_num, read_ahead ) )
+   {}
+
+   block_log_prefetcher::~block_log_prefetcher() {}
+
+   signed_block_ptr block_log_prefetcher::next() {
+      return my->next();
+   }
+
+   namespace detail {
+      class block_log_reader_impl {
+         public:
+            explicit block_log_reader_impl( const fc::path& data_dir ) : data_dir( data_dir ) {}
+
+            void refresh() {
+               const auto block_file = data_dir / "blocks.log";
+               const auto index_file = data_dir / "blocks.index";
+               std::vector<block_range> found = find_block_ranges( data_dir );
+               log_mapping_ptr log;
+               if( fc::exists( block_file ) && fc::file_size( block_file ) > 0 ) {
+                  uint32_t version = 0, first_block_num = 1;
+                  {
+                     std::ifstream header( block_file.generic_string().c_str(), LOG_READ );
+                     header.read( (char*)&version, sizeof(version) );
+                     if( version > 1 )
+                        header.read( (char*)&first_block_num, sizeof(first_block_num) );
+                     EOS_ASSERT( header.good() && block_log::is_supported_version( version ), block_log_exception,
+                                 "Unable to read the header of the block log in ${d}", ("d", data_dir) );
+                  }
+                  found.erase( std::remove_if( found.begin(), found.end(), [&]( const auto& r ) { return r.last >= first_block_num; } ),
+                               found.end() );
+                  const uint64_t index_size = fc::exists( index_file ) ? fc::file_size( index_file ) : 0;
+                  if( index_size >= sizeof(uint64_t) ) {
+                     // mapped now, the file at this path is another one once the log rolls
+                     found.push_back( { first_block_num, first_block_num + static_cast<uint32_t>( index_size / sizeof(uint64_t) ) - 1,
+                                        block_file, index_file } );
+                     log = std::make_shared<const log_mapping>( block_file, index_file );
+                  }
+               }
+               auto a = block_log_archive::exists( data_dir ) ? std::make_shared<const block_log_archive>( data_dir )
+                                                              : std::shared_ptr<const block_log_archive>();
+
+               std::lock_guard<std::mutex> g( mtx );
+               files = std::move( found );
+               mappings.clear();
+               if( log )
+                  mappings.emplace( files.back().first, std::move( log ) );
+               archive = std::move( a );
+            }
+
+            signed_block_ptr read_block_by_num( uint32_t block_num ) {
+               constexpr size_t max_mappings = 3;
+               block_range r;
+               log_mapping_ptr m;
+               std::shared_ptr<const block_log_archive> a;
+               {
+                  std::lock_guard<std::mutex> g( mtx );
+                  auto itr = std::upper_bound( files.begin(), files.end(), block_num,
+                                               []( uint32_t n, const block_range& r ) { return n < r.first; } );
+                  if( itr == files.begin() || block_num > std::prev(itr)->last ) {
+                     a = archive;
+                  } else {
+                     r = *std::prev(itr);
+                     auto mitr = mappings.find( r.first );
+                     if( mitr != mappings.end() )
+                        m = mitr->second;
+                  }
+               }
+               if( r.block_file.empty() ) {
+                  if( a && block_num >= a->first_block_num() && block_num <= a->last_block_num() )
+                     return a->read_block_by_num( block_num );
+                  return {};
+               }
+               if( !m ) {
+                  m = std::make_shared<const log_mapping>( r.block_file, r.index_file );
+                  std::lock_guard<std::mutex> g( mtx );
+                  // the ranges come before the log, which is never evicted first
+                  if( mappings.size() >= max_mappings )
+                     mappings.erase( mappings.begin() );
+                  mappings.emplace( r.first, m );
+               }
+               return read_range_block( *m, r, block_num );
+            }
+
+         private:
+            const fc::path                            data_dir;
+            std::mutex                                mtx;
+            std::vector<block_range>                  files;    ///< ordered by block number, the log last; guarded by mtx
+            std::map<uint32_t, log_mapping_ptr>       mappings; ///< by the first block of the file, guarded by mtx
+            std::shared_ptr<const block_log_archive>  archive;  ///< guarded by mtx
+      };
+   }
+
+   block_log_reader::block_log_reader(const fc::path& data_dir)
+   :my( new detail::block_log_reader_impl( data_dir ) ) {
+      my->refresh();
+   }
+
+   block_log_reader::~block_log_reader() {}
+
+   void block_log_reader::refresh() {
+      my->refresh();
+   }
+
+   signed_block_ptr block_log_reader::read_block_by_num(uint32_t block_num)const {
+      return my->read_block_by_num( block_num );
+   }
+
+   namespace detail {
+      namespace bio = boost::iostreams;
+
+      /// entry of blocks.zindex, packed on disk
+      struct archive_index_entry {
+         uint64_t frame_pos = 0;    ///< of the frame holding the block in blocks.zlog
+         uint32_t offset = 0;       ///< of the block in the decompressed frame
+      };
+      constexpr size_t archive_index_entry_size = sizeof(uint64_t) + sizeof(uint32_t);
+      constexpr size_t archive_header_size = 3 * sizeof(uint32_t) + sizeof(chain_id_type);
+      constexpr size_t archive_frame_header_size = 2 * sizeof(uint32_t);
+
+      using archive_frame = std::shared_ptr<const std::vector<char>>;
+
+      class block_log_archive_impl {
+         public:
+            block_log_archive_impl( const fc::path& block_dir, uint32_t frame_cache_size )
+            :frame_cache_size( frame_cache_size ) {
+               map( block_dir / "blocks.zlog", log_fm, log_region );
+               map( block_dir / "blocks.zindex", index_fm, index_region );
+
+               EOS_ASSERT( log_region.get_size() >= archive_header_size, block_log_exception,
+                           "Block log archive in ${d} is truncated", ("d", block_dir) );
+               uint32_t magic = 0, version = 0;
+               memcpy( &magic, log_data(), sizeof(magic) );
+               memcpy( &version, log_data() + sizeof(magic), sizeof(version) );
+               EOS_ASSERT( magic == block_log_archive::magic_number, block_log_exception,
+                           "Block log archive in ${d} has unexpected magic number", ("d", block_dir) );
+               EOS_ASSERT( version == block_log_archive::version, block_log_exception,
+                           "Block log archive in ${d} is an unsupported version ${v}", ("d", block_dir)("v", version) );
+               memcpy( &first_block_num, log_data() + 2 * sizeof(uint32_t), sizeof(first_block_num) );
+               chain_id.emplace( log_data() + 3 * sizeof(uint32_t), sizeof(fc::sha256) );
+               num_blocks = index_region.get_size() / archive_index_entry_size;
+            }
+
+            archive_index_entry entry( uint32_t block_num )const {
+               archive_index_entry e;
+               const char* p = static_cast<const char*>( index_region.get_address() ) +
+                               uint64_t( block_num - first_block_num ) * archive_index_entry_size;
+               memcpy( &e.frame_pos, p, sizeof(e.frame_pos) );
+               memcpy( &e.offset, p + sizeof(e.frame_pos), sizeof(e.offset) );
+               return e;
+            }
+
+            /// the decompressed frame at frame_pos, from the cache when it was used recently
+            archive_frame frame( uint64_t frame_pos )const {
+               {
+                  std::lock_guard<std::mutex> g( cache_mtx );
+                  for( auto itr = cache.begin(); itr != cache.end(); ++itr ) {
+                     if( itr->first == frame_pos ) {
+                        cache.splice( cache.begin(), cache, itr );
+                        return itr->second;
+                     }
+                  }
+               }
+
+               EOS_ASSERT( frame_pos + archive_frame_header_size <= log_region.get_size(), block_log_exception,
+                           "Block log archive frame ${p} is past the end of blocks.zlog", ("p", frame_pos) );
+               uint32_t compressed_size = 0, size = 0;
+               memcpy( &compressed_size, log_data() + frame_pos, sizeof(compressed_size) );
+               memcpy( &size, log_data() + frame_pos + sizeof(compressed_size), sizeof(size) );
+               EOS_ASSERT( frame_pos + archive_frame_header_size + compressed_size <= log_region.get_size(), block_log_exception,
+                           "Block log archive frame ${p} is truncated", ("p", frame_pos) );
+
+               auto data = std::make_shared<std::vector<char>>();
+               data->reserve( size );
+               try {
+                  bio::filtering_ostream decomp;
+                  decomp.push( bio::zlib_decompressor() );
+                  decomp.push( bio::back_inserter( *data ) );
+                  decomp.write( log_data() + frame_pos + archive_frame_header_size, compressed_size );
+                  bio::close( decomp );
+               } catch( const bio::zlib_error& e ) {
+                  EOS_THROW( block_log_exception, "Block log archive frame ${p} does not decompress: ${e}",
+                             ("p", frame_pos)("e", e.what()) );
+               }
+               EOS_ASSERT( data->size() == size, block_log_exception,
+                           "Block log archive frame ${p} has ${a} bytes, expected ${e}", ("p", frame_pos)("a", data->size())("e", size) );
+
+               std::lock_guard<std::mutex> g( cache_mtx );
+               if( frame_cache_size > 0 ) {
+                  cache.emplace_front( frame_pos, data );
+                  if( cache.size() > frame_cache_size )
+                     cache.pop_back();
+               }
+               return data;
+            }
+
+            const char* log_data()const { return static_cast<const char*>( log_region.get_address() ); }
+
+            static void map( const fc::path& p, bip::file_mapping& fm, bip::mapped_region& region ) {
+               if( fc::file_size( p ) == 0 )
+                  return;
+               fm = bip::file_mapping( p.generic_string().c_str(), bip::read_only );
+               region = bip::mapped_region( fm, bip::read_only );
+            }
+
+            uint32_t                 first_block_num = 0;
+            uint32_t                 num_blocks = 0;
+            fc::optional<chain_id_type> chain_id;
+            const uint32_t           frame_cache_size;
+            bip::file_mapping        log_fm;
+            bip::mapped_region       log_region;
+            bip::file_mapping        index_fm;
+            bip::mapped_region       index_region;
+
+            mutable std::mutex                                    cache_mtx;
+            mutable std::list<std::pair<uint64_t, archive_frame>> cache; ///< most recently used first
+      };
+   }
+
+   block_log_archive::block_log_archive(const fc::path& block_dir, uint32_t frame_cache_size)
+   :my( std::make_unique<detail::block_log_archive_impl>( block_dir, frame_cache_size ) )
+   {}
+
+   block_log_archive::~block_log_archive() {}
+
+   bool block_log_archive::exists(const fc::path& block_dir) {
+      return fc::exists( block_dir / "blocks.zlog" ) && fc::exists( block_dir / "blocks.zindex" );
+   }
+
+   signed_block_ptr block_log_archive::read_block_by_num(uint32_t block_num)const {
+      if( block_num < my->first_block_num || block_num - my->first_block_num >= my->num_blocks )
+         return {};
+      const auto e = my->entry( block_num );
+      const auto frame = my->frame( e.frame_pos );
+      EOS_ASSERT( e.offset < frame->size(), block_log_exception,
+                  "Block ${n} is past the end of its block log archive frame", ("n", block_num) );
+      auto b = std::make_shared<signed_block>();
+      fc::datastream<const char*> ds( frame->data() + e.offset, frame->size() - e.offset );
+      fc::raw::unpack( ds, *b );
+      EOS_ASSERT( b->block_num() == block_num, block_log_exception,
+                  "Wrong block was read from block log archive.", ("returned", b->block_num())("expected", block_num) );
+      return b;
+   }
+
+   uint32_t block_log_archive::first_block_num()const {
+      return my->first_block_num;
+   }
+
+   uint32_t block_log_archive::last_block_num()const {
+      return my->first_block_num + my->num_blocks - 1;
+   }
+
+   const chain_id_type& block_log_archive::chain_id()const {
+      return *my->chain_id;
+   }
+
+   bool block_log_archive::archive_blocklog_front(const fc::path& block_dir, const fc::path& temp_dir, uint32_t truncate_at_block,
+                                                  uint32_t blocks_per_frame) {
+      EOS_ASSERT( blocks_per_frame > 0, block_log_exception, "blocks_per_frame must be greater than 0" );
+      uint32_t start_block = 0;
+      {
+         trim_data log(block_dir);
+         if (truncate_at_block <= log.first_block || truncate_at_block > log.last_block) {
+            ilog("Block ${n} is not after the first block and within blocks.log, nothing to archive.", ("n", truncate_at_block));
+            return false;
+         }
+         start_block = log.first_block;
+
+         fc::cfile zlog, zindex;
+         zlog.set_file_path( block_dir / "blocks.zlog" );
+         zindex.set_file_path( block_dir / "blocks.zindex" );
+         if( exists(block_dir) ) {
+            block_log_archive archive(block_dir, 0);
+            EOS_ASSERT( archive.chain_id() == log.chain_id, block_log_exception,
+                        "Block log archive chain id ${a} does not match blocks.log chain id ${l}", ("a", archive.chain_id())("l", log.chain_id) );
+            EOS_ASSERT( archive.last_block_num() + 1 >= log.first_block, block_log_exception,
+                        "Block log archive ends at block ${a}, blocks.log starts at ${l}, blocks in between are missing",
+                        ("a", archive.last_block_num())("l", log.first_block) );
+            // blocks already archived, e.g. by an attempt that was interrupted before the trim, are not archived again
+            start_block = std::max(start_block, archive.last_block_num() + 1);
+            zlog.open( LOG_WRITE_C );
+            zindex.open( LOG_WRITE_C );
+         } else {
+            // a partial archive without its header or index is of no use
+            fc::remove( block_dir / "blocks.zlog" );
+            fc::remove( block_dir / "blocks.zindex" );
+            zlog.open( LOG_WRITE_C );
+            zindex.open( LOG_WRITE_C );
+            const uint32_t magic = block_log_archive::magic_number, version = block_log_archive::version;
+            zlog.write( (const char*)&magic, sizeof(magic) );
+            zlog.write( (const char*)&version, sizeof(version) );
+            zlog.write( (const char*)&start_block, sizeof(start_block) );
+            zlog << log.chain_id;
+         }
+         ilog("Archiving blocks ${s} to ${e} of ${d} in frames of ${n} blocks",
+              ("s", start_block)("e", truncate_at_block - 1)("d", block_dir.generic_string())("n", blocks_per_frame));
+
+         std::vector<char> raw, index;
+         for (uint32_t frame_start = start_block; frame_start < truncate_at_block; frame_start += blocks_per_frame) {
+            const uint32_t frame_end = std::min<uint64_t>(uint64_t(frame_start) + blocks_per_frame, truncate_at_block);
+            zlog.seek_end(0);
+            const uint64_t frame_pos = zlog.tellp();
+            raw.clear();
+            index.clear();
+            for (uint32_t n = frame_start; n < frame_end; ++n) {
+               // block n is followed by its 8 byte position, then block n+1
+               const uint64_t pos = log.block_pos(n);
+               const uint64_t size = log.block_pos(n + 1) - pos - sizeof(uint64_t);
+               const uint32_t offset = raw.size();
+               index.insert(index.end(), (const char*)&frame_pos, (const char*)&frame_pos + sizeof(frame_pos));
+               index.insert(index.end(), (const char*)&offset, (const char*)&offset + sizeof(offset));
+               raw.resize(raw.size() + size);
+               EOS_ASSERT( fseek(log.blk_in, pos, SEEK_SET) == 0 && fread(raw.data() + offset, size, 1, log.blk_in) == 1,
+                           block_log_exception, "cannot read block ${n} from ${f}", ("n", n)("f", log.block_file_name.string()) );
+            }
+            std::vector<char> compressed;
+            {
+               detail::bio::filtering_ostream comp;
+               comp.push( detail::bio::zlib_compressor( detail::bio::zlib::best_compression ) );
+               comp.push( detail::bio::back_inserter( compressed ) );
+               comp.write( raw.data(), raw.size() );
+               detail::bio::close( comp );
+            }
+            const uint32_t compressed_size = compressed.size();
+            const uint32_t size = raw.size();
+            zlog.write( (const char*)&compressed_size, sizeof(compressed_size) );
+            zlog.write( (const char*)&size, sizeof(size) );
+            zlog.write( compressed.data(), compressed.size() );
+            // the frame is complete before the index refers to it
+            zlog.flush();
+            zindex.write( index.data(), index.size() );
+            zindex.flush();
+         }
+      }
+      return block_log::trim_blocklog_front(block_dir, temp_dir, truncate_at_block);
+   }
+
    } } /// eosio::chain
@@ -0,0 +1,69 @@
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <cstring>
+#include <limits>
+
+namespace eosio { namespace chain { namespace code_compression {
+
+namespace bio = boost::iostreams;
+
+namespace {
+   constexpr char   magic[4] = { '\0', 'e', 'o', 'z' };
+   constexpr size_t header_size = sizeof(magic) + sizeof(uint32_t);
+}
+
+bool is_compressed( const char* data, size_t size ) {
+   return size >= header_size && memcmp( data, magic, sizeof(magic) ) == 0;
+}
+
+size_t uncompressed_size( const char* data, size_t size ) {
+   if( !is_compressed( data, size ) )
+      return size;
+   uint32_t s;
+   memcpy( &s, data + sizeof(magic), sizeof(s) );
+   return s;
+}
+
+std::string compress( const char* wasm, size_t size ) {
+   if( size > std::numeric_limits<uint32_t>::max() )
+      return {};
+   const uint32_t s = size;
+   std::string out( magic, sizeof(magic) );
+   out.append( reinterpret_cast<const char*>( &s ), sizeof(s) );
+
+   bio::filtering_ostream comp;
+   comp.push( bio::zlib_compressor( bio::zlib::best_compression ) );
+   comp.push( bio::back_inserter( out ) );
+   bio::write( comp, wasm, size );
+   bio::close( comp );
+
+   if( out.size() >= size )
+      return {};
+   return out;
+}
+
+std::string decompress( const char* data, size_t size ) {
+   EOS_ASSERT( is_compressed( data, size ), database_exception, "contract code is not compressed" );
+   const size_t expected = uncompressed_size( data, size );
+   std::string out;
+   out.reserve( expected );
+   try {
+      bio::filtering_ostream decomp;
+      decomp.push( bio::zlib_decompressor() );
+      decomp.push( bio::back_inserter( out ) );
+      bio::write( decomp, data + header_size, size - header_size );
+      bio::close( decomp );
+   } catch( const bio::zlib_error& e ) {
+      EOS_THROW( database_exception, "compressed contract code is corrupt: ${e}", ("e", e.what()) );
+   }
+   EOS_ASSERT( out.size() == expected, database_exception,
+               "compressed contract code holds ${s} bytes instead of ${e}", ("s", out.size())("e", expected) );
+   return out;
+}
+
+} } } // eosio::chain::code_compression
@@ -2,6 +2,11 @@
 #include <eosio/chain/transaction_context.hpp>
 
 #include <eosio/chain/block_log.hpp>
+#include <eosio/chain/transaction_conflict_groups.hpp>
+#include <eosio/chain/recovered_keys_cache.hpp>
+#include <eosio/chain/transaction_metadata_pool.hpp>
+#include <eosio/chain/transaction_latency.hpp>
+#include <eosio/chain/replica_head.hpp>
 #include <eosio/chain/fork_database.hpp>
 #include <eosio/chain/exceptions.hpp>
 
@@ -9,6 +14,7 @@
 #include <eosio/chain/code_object.hpp>
 #include <eosio/chain/block_summary_object.hpp>
 #include <eosio/chain/eosio_contract.hpp>
+#include <eosio/chain/native_contracts.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/protocol_state_object.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
@@ -22,9 +28,13 @@
 #include <eosio/chain/protocol_feature_manager.hpp>
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/resource_limits.hpp>
+#include <eosio/chain/resource_limits_private.hpp>
+#include <eosio/chain/permission_object.hpp>
+#include <eosio/chain/permission_link_object.hpp>
 #include <eosio/chain/chain_snapshot.hpp>
 #include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/platform_timer.hpp>
+#include <eosio/chain/span_tracer.hpp>
 
 #include <chainbase/chainbase.hpp>
 #include <fc/io/json.hpp>
@@ -32,7 +42,15 @@
 #include <fc/scoped_exit.hpp>
 #include <fc/variant_object.hpp>
 
+#include <boost/core/demangle.hpp>
+#include <boost/mpl/size.hpp>
+
 #include <new>
+#include <atomic>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <mutex>
 
 namespace eosio { namespace chain {
 
@@ -122,7 +140,7 @@ struct building_block {
    size_t                                _num_new_protocol_features_that_have_activated = 0;
    vector<transaction_metadata_ptr>      _pending_trx_metas;
    vector<transaction_receipt>           _pending_trx_receipts;
-   vector<action_receipt>                _actions;
+   vector<digest_type>                   _action_receipt_digests; ///< digests of the action receipts of the block, in order
    optional<checksum256_type>            _transaction_mroot;
 };
 
@@ -155,6 +173,7 @@ struct pending_state {
    block_stage_type                   _block_stage;
    controller::block_status           _block_status = controller::block_status::incomplete;
    optional<block_id_type>            _producer_block_id;
+   vector<std::tuple<digest_type, uint8_t, uint8_t>> _code_to_compress; ///< code created by setcode in this block
 
    /** @pre _block_stage cannot hold completed_block alternative */
    const pending_block_header_state& get_pending_block_header_state()const {
@@ -225,6 +244,7 @@ struct controller_impl {
 
    reset_new_handler              rnh; // placed here to allow for this to be set before constructing the other fields
    controller&                    self;
+   std::future<block_log>         opening_blog; ///< opens, and if need be indexes, the block log while the databases are mapped
    chainbase::database            db;
    chainbase::database            reversible_blocks; ///< a special database to persist blocks that have successfully been applied but are still reversible
    block_log                      blog;
@@ -236,6 +256,10 @@ struct controller_impl {
    authorization_manager          authorization;
    protocol_feature_manager       protocol_features;
    controller::config             conf;
+   controller::action_profile_map action_profiles;
+   std::atomic<uint64_t>          table_access_count{0};
+   mutable std::mutex             table_accesses_mtx;
+   controller::table_access_map   table_accesses;
    const chain_id_type            chain_id; // read by thread_pool threads, value will not be changed
    optional<fc::time_point>       replay_head_time;
    db_read_mode                   read_mode = db_read_mode::SPECULATIVE;
@@ -243,16 +267,37 @@ struct controller_impl {
    optional<fc::microseconds>     subjective_cpu_leeway;
    bool                           trusted_producer_light_validation = false;
    uint32_t                       snapshot_head_block = 0;
-   named_thread_pool              thread_pool;
+   mutable named_thread_pool      thread_pool; ///< mutable so const snapshot writing can post work to it
+   recovered_keys_cache           recovered_keys;
+   transaction_metadata_pool      trx_metadata_pool;
+   /// key recovery started for the transactions of fork_db blocks off the best branch, by block id
+   std::map<block_id_type, std::vector<recover_keys_future>> prepared_trx_metas;
    platform_timer                 timer;
+   optional<replica_head_marker>  replica_marker; ///< published to by a primary, followed by a state replica
+   uint64_t                       replica_sequence = 0; ///< state replica: sequence of the followed head
+   optional<replica_head>         replica; ///< state replica: the followed head
+   optional<block_log_reader>     replica_blocks; ///< state replica: the block log of the primary
+   bool                           partial_state = false; ///< holds only the contract tables of conf.snapshot_contracts
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
    vm::wasm_allocator                 wasm_alloc;
 #endif
 
    typedef pair<scope_name,action_name>                   handler_key;
    map< account_name, map<handler_key, apply_handler> >   apply_handlers;
+   map< pair<digest_type,action_name>, apply_handler >    native_contract_handlers;
    unordered_map< builtin_protocol_feature_t, std::function<void(controller_impl&)>, enum_hash<builtin_protocol_feature_t> > protocol_feature_activation_handlers;
 
+   /// marks the state directory as holding a partial state, so restarts without snapshot_contracts stay read-only
+   void set_partial_state( bool partial ) {
+      partial_state = partial;
+      const auto marker = conf.state_dir / controller::partial_state_file_name;
+      if( partial ) {
+         std::ofstream( marker.generic_string() ) << fc::json::to_string( conf.snapshot_contracts ) << '\n';
+      } else if( fc::exists( marker ) ) {
+         fc::remove( marker );
+      }
+   }
+
    void pop_block() {
       auto prev = fork_db.get_block( head->header.previous );
 
@@ -272,6 +317,7 @@ struct controller_impl {
 
       head = prev;
 
+      if( replica_marker ) replica_marker->begin_write();
       db.undo();
 
       protocol_features.popped_blocks_to( prev->block_num );
@@ -299,34 +345,60 @@ struct controller_impl {
    controller_impl( const controller::config& cfg, controller& s, protocol_feature_set&& pfs, const chain_id_type& chain_id )
    :rnh(),
     self(s),
+    opening_blog( std::async( std::launch::async, [&cfg]() {
+       return block_log( cfg.blocks_dir, cfg.blocks_log_mmap, cfg.blocks_log_cache_size,
+                         block_log_stride_config{ cfg.blocks_log_stride, cfg.max_retained_block_files, cfg.blocks_archive_dir } );
+    } ) ),
     db( cfg.state_dir,
-        cfg.read_only ? database::read_only : database::read_write,
-        cfg.state_size, false, cfg.db_map_mode, cfg.db_hugepage_paths ),
-    reversible_blocks( cfg.blocks_dir/config::reversible_blocks_dir_name,
-        cfg.read_only ? database::read_only : database::read_write,
-        cfg.reversible_cache_size, false, cfg.db_map_mode, cfg.db_hugepage_paths ),
-    blog( cfg.blocks_dir ),
-    fork_db( cfg.state_dir ),
-    wasmif( cfg.wasm_runtime, cfg.eosvmoc_tierup, db, cfg.state_dir, cfg.eosvmoc_config ),
+        (cfg.read_only || cfg.state_replica) ? database::read_only : database::read_write,
+        cfg.state_size, cfg.state_replica, cfg.db_map_mode, cfg.db_hugepage_paths ), // the primary keeps it dirty
+    reversible_blocks( (cfg.state_replica ? cfg.replica_blocks_dir : cfg.blocks_dir)/config::reversible_blocks_dir_name,
+        (cfg.read_only || cfg.state_replica) ? database::read_only : database::read_write,
+        cfg.reversible_cache_size, cfg.state_replica, cfg.db_map_mode, cfg.db_hugepage_paths ),
+    blog( opening_blog.get() ),
+    fork_db( cfg.state_replica ? cfg.blocks_dir : cfg.state_dir ), // a replica must not take over fork_db.dat of its primary
+    wasmif( cfg.wasm_runtime, cfg.eosvmoc_tierup, db, cfg.state_dir, cfg.eosvmoc_config, cfg.wasm_instantiation_cache_size ),
     resource_limits( db ),
     authorization( s, db ),
     protocol_features( std::move(pfs) ),
     conf( cfg ),
     chain_id( chain_id ),
     read_mode( cfg.read_mode ),
-    thread_pool( "chain", cfg.thread_pool_size )
+    thread_pool( "chain", cfg.thread_pool_size ),
+    recovered_keys( cfg.sig_recovery_cache_size ),
+    trx_metadata_pool( cfg.trx_metadata_pool_size )
    {
-      fork_db.open( [this]( block_timestamp_type timestamp,
-                            const flat_set<digest_type>& cur_features,
-                            const vector<digest_type>& new_features )
-                           { check_protocol_features( timestamp, cur_features, new_features ); }
-      );
+      // registered here rather than in add_indices, fork_db.dat references the blocks it holds
+      reversible_blocks.add_index<reversible_block_index>();
+      fork_db.set_block_store( fork_database::block_store{
+         [this]( uint32_t block_num, const block_id_type& id ) {
+            const auto* b = reversible_blocks.find<reversible_block_object,by_num>( block_num );
+            return b && b->get_block_id() == id;
+         },
+         [this]( uint32_t block_num ) {
+            const auto* b = reversible_blocks.find<reversible_block_object,by_num>( block_num );
+            return b ? b->get_block() : signed_block_ptr{};
+         }
+      } );
+      if( cfg.state_replica ) {
+         replica_marker.emplace( cfg.state_dir, replica_head_marker::mode::follow );
+         replica_blocks.emplace( cfg.replica_blocks_dir );
+      } else {
+         fork_db.open( [this]( block_timestamp_type timestamp,
+                               const flat_set<digest_type>& cur_features,
+                               const vector<digest_type>& new_features )
+                              { check_protocol_features( timestamp, cur_features, new_features ); }
+         );
+         if( cfg.publish_replica_head )
+            replica_marker.emplace( cfg.state_dir, replica_head_marker::mode::publish );
+      }
 
       set_activation_handler<builtin_protocol_feature_t::preactivate_feature>();
       set_activation_handler<builtin_protocol_feature_t::replace_deferred>();
       set_activation_handler<builtin_protocol_feature_t::get_sender>();
       set_activation_handler<builtin_protocol_feature_t::webauthn_key>();
       set_activation_handler<builtin_protocol_feature_t::wtmsig_block_signatures>();
+      set_activation_handler<builtin_protocol_feature_t::batched_db_intrinsics>();
 
       self.irreversible_block.connect([this](const block_state_ptr& bsp) {
          wasmif.current_lib(bsp->block_num);
@@ -351,6 +423,11 @@ struct controller_impl {
 */
 
    SET_APP_HANDLER( eosio, eosio, canceldelay );
+
+   if( conf.native_contracts ) {
+      for( const auto& h : vetted_native_contract_handlers() )
+         native_contract_handlers[make_pair(h.code_hash, h.action)] = h.handler;
+   }
    }
 
    /**
@@ -414,14 +491,24 @@ struct controller_impl {
                apply_block( *bitr, controller::block_status::complete, trx_meta_cache_lookup{} );
                head = (*bitr);
                fork_db.mark_valid( head );
+               emit( self.committed_block, head );
             }
 
+            // committing frees undo state, and replicas read the reversible blocks and the block log as well
+            if( replica_marker ) replica_marker->begin_write();
+
             emit( self.irreversible_block, *bitr );
+            transaction_latency::irreversible( *(*bitr)->block );
 
             db.commit( (*bitr)->block_num );
             root_id = (*bitr)->id;
 
-            blog.append( (*bitr)->block );
+            // the reversible block database already holds the block packed, unless it was never applied here
+            const auto* rb = reversible_blocks.find<reversible_block_object,by_num>( (*bitr)->block_num );
+            if( rb && rb->get_block_id() == (*bitr)->id )
+               blog.append( (*bitr)->block, rb->packedblock.data(), rb->packedblock.size() );
+            else
+               blog.append( (*bitr)->block );
 
             auto rbitr = rbi.begin();
             while( rbitr != rbi.end() && rbitr->blocknum <= (*bitr)->block_num ) {
@@ -441,6 +528,34 @@ struct controller_impl {
       if( root_id != fork_db.root()->id ) {
          fork_db.advance_root( root_id );
       }
+
+      // the branches pruned with the old root will never be applied
+      for( auto itr = prepared_trx_metas.begin(); itr != prepared_trx_metas.end(); ) {
+         itr = fork_db.get_block( itr->first ) ? std::next( itr ) : prepared_trx_metas.erase( itr );
+      }
+
+      // otherwise commit_block publishes once the pending block is complete
+      if( !pending ) publish_replica_head( head );
+   }
+
+   /**
+    *  Starts recovering the keys of the transactions of a block that is not applied yet on the chain thread pool, so
+    *  that switching to its branch later pays only for applying them. Headers, producer signatures and transaction
+    *  merkle roots were already validated by create_block_state_future.
+    */
+   void prepare_trx_metas( const block_state_ptr& bsp ) {
+      if( self.skip_auth_check() || bsp->is_pub_keys_recovered() || prepared_trx_metas.count( bsp->id ) )
+         return;
+      std::vector<recover_keys_future> futures;
+      futures.reserve( bsp->block->transactions.size() );
+      for( const auto& receipt : bsp->block->transactions ) {
+         if( receipt.trx.contains<packed_transaction>() ) {
+            futures.emplace_back( transaction_metadata::start_recover_keys(
+                  std::make_shared<packed_transaction>( receipt.trx.get<packed_transaction>() ), thread_pool.get_executor(),
+                  chain_id, microseconds::maximum(), UINT32_MAX, &recovered_keys ) );
+         }
+      }
+      prepared_trx_metas.emplace( bsp->id, std::move( futures ) );
    }
 
    /**
@@ -482,11 +597,15 @@ struct controller_impl {
          ilog( "existing block log, attempting to replay from ${s} to ${n} blocks",
                ("s", start_block_num)("n", blog_head->block_num()) );
          try {
-            while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
-               replay_push_block( next, controller::block_status::irreversible );
-               if( next->block_num() % 500 == 0 ) {
-                  ilog( "${n} of ${head}", ("n", next->block_num())("head", blog_head->block_num()) );
-                  if( shutdown() ) break;
+            if( conf.replay_read_ahead_blocks > 0 ) {
+               replay_read_ahead( shutdown, blog_head->block_num() );
+            } else {
+               while( auto next = blog.read_block_by_num( head->block_num + 1 ) ) {
+                  replay_push_block( next, controller::block_status::irreversible );
+                  if( next->block_num() % 500 == 0 ) {
+                     ilog( "${n} of ${head}", ("n", next->block_num())("head", blog_head->block_num()) );
+                     if( shutdown() ) break;
+                  }
                }
             }
          } catch(  const database_guard_exception& e ) {
@@ -536,11 +655,77 @@ struct controller_impl {
       }
    }
 
+   /**
+    *  Replays the irreversible blocks after head up to end_block_num as a pipeline: a reader thread reads and unpacks
+    *  blocks from the block log, the thread pool creates the transaction metadata, recovering keys unless auth checks
+    *  are skipped, of up to replay_read_ahead_blocks blocks, and this thread applies them in order.
+    */
+   void replay_read_ahead( const std::function<bool()>& shutdown, uint32_t end_block_num ) {
+      struct prepared_block {
+         signed_block_ptr                 block;
+         std::vector<recover_keys_future> trx_metas; ///< of the packed transactions, in order
+      };
+
+      const bool skip_auth_checks = self.skip_auth_check();
+      auto prepare = [&]( signed_block_ptr b ) {
+         prepared_block p{ std::move( b ), {} };
+         p.trx_metas.reserve( p.block->transactions.size() );
+         for( const auto& receipt : p.block->transactions ) {
+            if( !receipt.trx.contains<packed_transaction>() )
+               continue;
+            const auto& pt = receipt.trx.get<packed_transaction>();
+            if( skip_auth_checks ) {
+               // b keeps pt alive until the task has run
+               p.trx_metas.emplace_back( async_thread_pool( thread_pool.get_executor(), [b = p.block, &pt]() {
+                  return transaction_metadata::create_no_recover_keys( pt, transaction_metadata::trx_type::input );
+               } ) );
+            } else {
+               p.trx_metas.emplace_back( transaction_metadata::start_recover_keys(
+                     std::make_shared<packed_transaction>( pt ), thread_pool.get_executor(), chain_id,
+                     microseconds::maximum(), UINT32_MAX, &recovered_keys ) );
+            }
+         }
+         return p;
+      };
+
+      block_log_prefetcher reader( conf.blocks_dir, head->block_num + 1, end_block_num, conf.replay_read_ahead_blocks );
+      std::deque<prepared_block> prepared;
+      while( true ) {
+         while( prepared.size() < conf.replay_read_ahead_blocks ) {
+            auto b = reader.next();
+            if( !b )
+               break;
+            prepared.emplace_back( prepare( std::move( b ) ) );
+         }
+         if( prepared.empty() )
+            break;
+
+         auto& p = prepared.front();
+         size_t next_meta = 0;
+         auto lookup = [&p, &next_meta]( const transaction_id_type& id ) -> transaction_metadata_ptr {
+            if( next_meta >= p.trx_metas.size() )
+               return {};
+            auto trx_meta = p.trx_metas[next_meta++].get();
+            return trx_meta->id() == id ? trx_meta : transaction_metadata_ptr{};
+         };
+         const signed_block_ptr b = p.block;
+         replay_push_block( b, controller::block_status::irreversible, lookup );
+         prepared.pop_front();
+         if( b->block_num() % 500 == 0 ) {
+            ilog( "${n} of ${head}", ("n", b->block_num())("head", end_block_num) );
+            if( shutdown() ) break;
+         }
+      }
+   }
+
    void startup(std::function<bool()> shutdown, const snapshot_reader_ptr& snapshot) {
       EOS_ASSERT( snapshot, snapshot_exception, "No snapshot reader provided" );
       ilog( "Starting initialization from snapshot, this may take a significant amount of time" );
       try {
          snapshot->validate();
+         set_partial_state( !conf.snapshot_contracts.empty() );
+         if( partial_state )
+            ilog( "loading the contract tables of ${c} only", ("c", conf.snapshot_contracts) );
          if( blog.head() ) {
             read_from_snapshot( snapshot, blog.first_block_num(), blog.head()->block_num() );
          } else {
@@ -565,6 +750,8 @@ struct controller_impl {
 
    void startup(std::function<bool()> shutdown, const genesis_state& genesis) {
       EOS_ASSERT( db.revision() < 1, database_exception, "This version of controller::startup only works with a fresh state database." );
+      EOS_ASSERT( conf.snapshot_contracts.empty(), snapshot_exception, "snapshot_contracts requires starting from a snapshot" );
+      set_partial_state( false );
       const auto& genesis_chain_id = genesis.compute_chain_id();
       EOS_ASSERT( genesis_chain_id == chain_id, chain_id_type_exception,
                   "genesis state provided to startup corresponds to a chain ID (${genesis_chain_id}) that does not match the chain ID that controller was constructed with (${controller_chain_id})",
@@ -596,8 +783,13 @@ struct controller_impl {
    }
 
    void startup(std::function<bool()> shutdown) {
+      if( conf.state_replica ) {
+         startup_replica( shutdown );
+         return;
+      }
       EOS_ASSERT( db.revision() >= 1, database_exception, "This version of controller::startup does not work with a fresh state database." );
       EOS_ASSERT( fork_db.head(), fork_database_exception, "No existing fork database despite existing chain state. Replay required." );
+      partial_state = fc::exists( conf.state_dir / controller::partial_state_file_name );
 
       uint32_t lib_num = fork_db.root()->block_num;
       auto first_block_num = blog.first_block_num();
@@ -624,6 +816,82 @@ struct controller_impl {
       init(shutdown);
    }
 
+   /// nothing is replayed or applied: the state is the primary's, once the primary has published a head for it
+   void startup_replica(std::function<bool()> shutdown) {
+      ilog( "following the head published to ${p}", ("p", (conf.state_dir / replica_head_marker::file_name).generic_string()) );
+      while( !refresh_replica_head() ) {
+         if( shutdown() ) return;
+         std::this_thread::sleep_for( std::chrono::milliseconds( 100 ) );
+      }
+   }
+
+   bool refresh_replica_head() {
+      auto published = replica_marker->read();
+      if( !published || published->first == replica_sequence )
+         return false;
+
+      // what is needed of the state is copied out first, and only used if the primary did not change the state meanwhile
+      vector<std::pair<digest_type, uint32_t>> activated;
+      optional<chain_id_type> state_chain_id;
+      try {
+         if( !replica ) {
+            validate_db_version( db );
+            state_chain_id = db.get<global_property_object>().chain_id;
+         }
+         for( const auto& f : db.get<protocol_state_object>().activated_protocol_features )
+            activated.emplace_back( f.feature_digest, f.activation_block_num );
+      } catch( ... ) {
+         if( replica_marker->unchanged_since( published->first ) )
+            throw;
+         return false;
+      }
+      if( !replica_marker->unchanged_since( published->first ) )
+         return false;
+
+      if( !replica ) {
+         EOS_ASSERT( *state_chain_id == chain_id, chain_id_type_exception,
+                     "chain ID in state (${state_chain_id}) does not match the chain ID that controller was constructed with (${controller_chain_id})",
+                     ("state_chain_id", *state_chain_id)("controller_chain_id", chain_id)
+         );
+         protocol_features.init( activated );
+      }
+
+      auto bsp = std::make_shared<block_state>();
+      static_cast<block_header_state&>(*bsp) = std::move( published->second.head );
+      bsp->validated = true;
+      fork_db.reset( *bsp );
+      head = fork_db.head();
+
+      // bring the activated protocol features in line with the state, the head may also have moved back on a fork
+      protocol_features.popped_blocks_to( head->block_num );
+      const auto known = static_cast<size_t>( std::distance( protocol_features.begin(), protocol_features.end() ) );
+      for( size_t i = known; i < activated.size(); ++i )
+         protocol_features.activate_feature( activated[i].first, activated[i].second );
+
+      // the primary appends to its block log and rolls it only while it changes the state
+      if( !replica || replica->irreversible_block_num != published->second.irreversible_block_num )
+         replica_blocks->refresh();
+
+      replica = std::move( published->second );
+      replica_sequence = published->first;
+      return true;
+   }
+
+   /// state replica: blocks in the reversible block database or the block log of the primary, read under read_state
+   signed_block_ptr fetch_replica_block( uint32_t block_num )const {
+      if( const auto* rb = reversible_blocks.find<reversible_block_object,by_num>( block_num ) )
+         return rb->get_block();
+      if( replica && block_num <= replica->irreversible_block_num )
+         return replica_blocks->read_block_by_num( block_num );
+      return {};
+   }
+
+   void publish_replica_head( const block_state_ptr& bsp ) {
+      if( !replica_marker || conf.state_replica || !bsp ) return;
+      const auto& lib = read_mode == db_read_mode::IRREVERSIBLE ? bsp : fork_db.root();
+      replica_marker->publish( replica_head{ *bsp, lib->block_num, lib->id, lib->header.timestamp } );
+   }
+
 
    static auto validate_db_version( const chainbase::database& db ) {
       // check database version
@@ -675,6 +943,9 @@ struct controller_impl {
          db.undo();
       }
 
+      if( !conf.read_only )
+         convert_code_storage();
+
       protocol_features.init( db );
 
       const auto& rbi = reversible_blocks.get_index<reversible_block_index,by_num>();
@@ -738,7 +1009,13 @@ struct controller_impl {
          // else no checks needed since fork_db will be completely reset on replay anyway
       }
 
-      if( last_block_num > head->block_num ) {
+      // compile the hottest contracts before applying any blocks
+      wasmif.warm_up_code_cache();
+
+      if( partial_state ) {
+         if( last_block_num > head->block_num )
+            wlog( "partial state is at block ${h}, not applying the blocks after it", ("h", head->block_num) );
+      } else if( last_block_num > head->block_num ) {
          replay( shutdown ); // replay any irreversible and reversible blocks ahead of current head
       }
 
@@ -758,6 +1035,8 @@ struct controller_impl {
             maybe_switch_forks( pending_head, controller::block_status::complete, forked_branch_callback{}, trx_meta_cache_lookup{} );
          }
       }
+
+      publish_replica_head( head );
    }
 
    ~controller_impl() {
@@ -766,8 +1045,6 @@ struct controller_impl {
    }
 
    void add_indices() {
-      reversible_blocks.add_index<reversible_block_index>();
-
       controller_index_set::add_indices(db);
       contract_database_index_set::add_indices(db);
 
@@ -785,57 +1062,119 @@ struct controller_impl {
                   */
    }
 
+   template<typename Section>
+   void add_contract_table_to_snapshot( const table_id_object& table_row, Section& section ) const {
+      // add a row for the table
+      section.add_row(table_row, db);
+
+      // followed by a size row and then N data rows for each type of table
+      contract_database_index_set::walk_indices([this, &section, &table_row]( auto utils ) {
+         using utils_t = decltype(utils);
+         using value_t = typename decltype(utils)::index_t::value_type;
+         using by_table_id = object_to_table_id_tag_t<value_t>;
+
+         auto tid_key = boost::make_tuple(table_row.id);
+         auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
+
+         unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
+         section.add_row(size, db);
+
+         utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section]( const auto &row ) {
+            section.add_row(row, db);
+         });
+      });
+   }
+
    void add_contract_tables_to_snapshot( const snapshot_writer_ptr& snapshot ) const {
+      if( snapshot->supports_packed_rows() ) {
+         add_contract_tables_to_snapshot_parallel( snapshot );
+         return;
+      }
+
       snapshot->write_section("contract_tables", [this]( auto& section ) {
          index_utils<table_id_multi_index>::walk(db, [this, &section]( const table_id_object& table_row ){
-            // add a row for the table
-            section.add_row(table_row, db);
+            add_contract_table_to_snapshot(table_row, section);
+         });
+      });
+   }
 
-            // followed by a size row and then N data rows for each type of table
-            contract_database_index_set::walk_indices([this, &section, &table_row]( auto utils ) {
-               using utils_t = decltype(utils);
-               using value_t = typename decltype(utils)::index_t::value_type;
-               using by_table_id = object_to_table_id_tag_t<value_t>;
+   /**
+    * Contract tables dominate snapshot size. Pack them on the chain thread pool in chunks of tables and append
+    * the packed chunks in table order, so the output is byte for byte what the sequential path produces.
+    * The database is not modified while a snapshot is written, so the worker threads only read it.
+    */
+   void add_contract_tables_to_snapshot_parallel( const snapshot_writer_ptr& snapshot ) const {
+      constexpr size_t tables_per_chunk = 256;
+      const size_t max_pending_chunks = 2 * std::max<size_t>(conf.thread_pool_size, 1);
 
-               auto tid_key = boost::make_tuple(table_row.id);
-               auto next_tid_key = boost::make_tuple(table_id_object::id_type(table_row.id._id + 1));
+      std::vector<const table_id_object*> tables;
+      index_utils<table_id_multi_index>::walk(db, [&tables]( const table_id_object& table_row ){
+         tables.push_back(&table_row);
+      });
 
-               unsigned_int size = utils_t::template size_range<by_table_id>(db, tid_key, next_tid_key);
-               section.add_row(size, db);
+      using packed_chunk = std::pair<std::string, uint64_t>;
 
-               utils_t::template walk_range<by_table_id>(db, tid_key, next_tid_key, [this, &section]( const auto &row ) {
-                  section.add_row(row, db);
-               });
-            });
+      snapshot->write_section("contract_tables", [&]( auto& section ) {
+         std::deque<std::future<packed_chunk>> pending;
+         // queued chunks reference tables, make sure they are done before unwinding on error
+         auto wait_pending = fc::make_scoped_exit([&pending]() {
+            for( auto& f : pending ) f.wait();
          });
+         size_t next = 0;
+         while( next < tables.size() || !pending.empty() ) {
+            while( next < tables.size() && pending.size() < max_pending_chunks ) {
+               const size_t end = std::min(next + tables_per_chunk, tables.size());
+               pending.emplace_back( async_thread_pool( thread_pool.get_executor(), [this, &tables, next, end]() {
+                  detail::packed_rows_buffer buffer;
+                  for( size_t i = next; i < end; ++i ) {
+                     add_contract_table_to_snapshot(*tables[i], buffer);
+                  }
+                  return packed_chunk{ buffer.data(), buffer.row_count };
+               } ) );
+               next = end;
+            }
+
+            packed_chunk chunk = pending.front().get();
+            pending.pop_front();
+            section.add_packed_rows(chunk.first, chunk.second);
+         }
       });
    }
 
    void read_contract_tables_from_snapshot( const snapshot_reader_ptr& snapshot ) {
-      snapshot->read_section("contract_tables", [this]( auto& section ) {
+      const auto& contracts = conf.snapshot_contracts;
+      snapshot->read_section("contract_tables", [this, &contracts]( auto& section ) {
          bool more = !section.empty();
          while (more) {
             // read the row for the table
             table_id_object::id_type t_id;
-            index_utils<table_id_multi_index>::create(db, [this, &section, &t_id](auto& row) {
+            bool keep = true;
+            index_utils<table_id_multi_index>::create(db, [this, &section, &t_id, &keep, &contracts](auto& row) {
                section.read_row(row, db);
                t_id = row.id;
+               keep = contracts.empty() || contracts.count(row.code);
             });
 
-            // read the size and data rows for each type of table
-            contract_database_index_set::walk_indices([this, &section, &t_id, &more](auto utils) {
-               using utils_t = decltype(utils);
+            // read the size and data rows for each type of table, the rows of a table not kept are dropped as they
+            // are read so that the state never holds more than one of them
+            contract_database_index_set::walk_indices([this, &section, &t_id, &more, keep](auto utils) {
+               using value_t = typename decltype(utils)::index_t::value_type;
 
                unsigned_int size;
                more = section.read_row(size, db);
 
                for (size_t idx = 0; idx < size.value; idx++) {
-                  utils_t::create(db, [this, &section, &more, &t_id](auto& row) {
+                  const auto& row = db.create<value_t>([this, &section, &more, &t_id](auto& row) {
                      row.t_id = t_id;
                      more = section.read_row(row, db);
                   });
+                  if (!keep)
+                     db.remove(row);
                }
             });
+
+            if (!keep)
+               db.remove(db.get<table_id_object>(t_id));
          }
       });
    }
@@ -1029,6 +1368,43 @@ struct controller_impl {
       resource_limits.verify_account_ram_usage(name);
    }
 
+   /// stores every contract's code compressed or not as configured, which leaves RAM billing and code hashes as they are
+   void convert_code_storage() {
+      const auto& idx = db.get_index<code_index, by_id>();
+      uint64_t converted = 0, stored_before = 0, stored_after = 0;
+      for( auto itr = idx.begin(); itr != idx.end(); ++itr ) {
+         const code_object& c = *itr;
+         const bool compressed = code_compression::is_compressed( c.code.data(), c.code.size() );
+         stored_before += c.code.size();
+         if( compressed != conf.compress_contract_code ) {
+            const std::string stored = conf.compress_contract_code ? code_compression::compress( c.code.data(), c.code.size() )
+                                                                   : code_compression::decompress( c.code.data(), c.code.size() );
+            if( !stored.empty() ) {
+               db.modify( c, [&]( code_object& o ) { o.code.assign( stored.data(), stored.size() ); } );
+               ++converted;
+            }
+         }
+         stored_after += c.code.size();
+      }
+      if( converted )
+         ilog( "${action} ${n} contracts, contract code takes ${after} bytes of state instead of ${before}",
+               ("action", conf.compress_contract_code ? "compressed" : "decompressed")("n", converted)
+               ("after", stored_after)("before", stored_before) );
+   }
+
+   /// compresses the code setcode stored in the pending block, skipping code the block has since removed
+   void compress_pending_code() {
+      for( const auto& k : pending->_code_to_compress ) {
+         const auto* c = db.find<code_object, by_code_hash>( boost::make_tuple( std::get<0>(k), std::get<1>(k), std::get<2>(k) ) );
+         if( !c || code_compression::is_compressed( c->code.data(), c->code.size() ) )
+            continue;
+         const std::string stored = code_compression::compress( c->code.data(), c->code.size() );
+         if( !stored.empty() )
+            db.modify( *c, [&]( code_object& o ) { o.code.assign( stored.data(), stored.size() ); } );
+      }
+      pending->_code_to_compress.clear();
+   }
+
    void initialize_database(const genesis_state& genesis) {
       // create the database header sigil
       db.create<database_header_object>([&]( auto& header ){
@@ -1089,7 +1465,7 @@ struct controller_impl {
       auto& bb = pending->_block_stage.get<building_block>();
       auto orig_block_transactions_size = bb._pending_trx_receipts.size();
       auto orig_state_transactions_size = bb._pending_trx_metas.size();
-      auto orig_state_actions_size      = bb._actions.size();
+      auto orig_state_actions_size      = bb._action_receipt_digests.size();
 
       std::function<void()> callback = [this,
                                         orig_block_transactions_size,
@@ -1099,7 +1475,7 @@ struct controller_impl {
          auto& bb = pending->_block_stage.get<building_block>();
          bb._pending_trx_receipts.resize(orig_block_transactions_size);
          bb._pending_trx_metas.resize(orig_state_transactions_size);
-         bb._actions.resize(orig_state_actions_size);
+         bb._action_receipt_digests.resize(orig_state_actions_size);
       };
 
       return fc::make_scoped_exit( std::move(callback) );
@@ -1143,7 +1519,7 @@ struct controller_impl {
          auto restore = make_block_restore_point();
          trace->receipt = push_receipt( gtrx.trx_id, transaction_receipt::soft_fail,
                                         trx_context.billed_cpu_time_us, trace->net_usage );
-         fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         append_action_receipt_digests( trx_context.executed );
 
          trx_context.squash();
          restore.cancel();
@@ -1221,14 +1597,14 @@ struct controller_impl {
       // resulting in the GTO being restored and available for a future block to retire.
       int64_t trx_removal_ram_delta = remove_scheduled_transaction(gto);
 
-      fc::datastream<const char*> ds( gtrx.packed_trx.data(), gtrx.packed_trx.size() );
-
       EOS_ASSERT( gtrx.delay_until <= self.pending_block_time(), transaction_exception, "this transaction isn't ready",
                  ("gtrx.delay_until",gtrx.delay_until)("pbt",self.pending_block_time())          );
 
-      signed_transaction dtrx;
-      fc::raw::unpack(ds,static_cast<transaction&>(dtrx) );
-      transaction_metadata_ptr trx = transaction_metadata::create_no_recover_keys( packed_transaction( dtrx ), transaction_metadata::trx_type::scheduled );
+      // the stored bytes are the packed transaction, used as they are rather than unpacked and packed again
+      transaction_metadata_ptr trx = transaction_metadata::create_no_recover_keys(
+            packed_transaction( bytes( gtrx.packed_trx ), vector<signature_type>(), bytes(), packed_transaction::compression_type::none ),
+            transaction_metadata::trx_type::scheduled );
+      const signed_transaction& dtrx = trx->packed_trx()->get_signed_transaction();
       trx->accepted = true;
 
       transaction_trace_ptr trace;
@@ -1285,7 +1661,7 @@ struct controller_impl {
                                         trx_context.billed_cpu_time_us,
                                         trace->net_usage );
 
-         fc::move_append( pending->_block_stage.get<building_block>()._actions, move(trx_context.executed) );
+         append_action_receipt_digests( trx_context.executed );
 
          trace->account_ram_delta = account_delta( gtrx.payer, trx_removal_ram_delta );
 
@@ -1406,10 +1782,11 @@ struct controller_impl {
    {
       EOS_ASSERT(deadline != fc::time_point(), transaction_exception, "deadline cannot be uninitialized");
 
+      scoped_span span( "chain", "push_transaction", span_trace_id( trx->id() ) );
       transaction_trace_ptr trace;
       try {
          auto start = fc::time_point::now();
-         const bool check_auth = !self.skip_auth_check() && !trx->implicit;
+         const bool check_auth = !self.skip_auth_check() && !trx->implicit && !trx->read_only;
          const fc::microseconds sig_cpu_usage = trx->signature_cpu_usage();
 
          if( !explicit_billed_cpu_time ) {
@@ -1446,18 +1823,27 @@ struct controller_impl {
             trx_context.delay = fc::seconds(trn.delay_sec);
 
             if( check_auth ) {
+               scoped_cpu_timer auth_timer( trace->cpu_breakdown ? &trace->cpu_breakdown->authorization_ns : nullptr );
                authorization.check_authorization(
                        trn.actions,
                        trx->recovered_keys(),
                        {},
                        trx_context.delay,
                        [&trx_context](){ trx_context.checktime(); },
-                       false
+                       false,
+                       {},
+                       true
                );
             }
             trx_context.exec();
             trx_context.finalize(); // Automatically rounds up network and CPU usage in trace and bills payers if successful
 
+            if( trx->read_only ) {
+               // never part of the block and not reported to subscribers
+               trx_context.undo();
+               return trace;
+            }
+
             auto restore = make_block_restore_point();
 
             if (!trx->implicit) {
@@ -1475,7 +1861,7 @@ struct controller_impl {
                trace->receipt = r;
             }
 
-            fc::move_append(pending->_block_stage.get<building_block>()._actions, move(trx_context.executed));
+            append_action_receipt_digests( trx_context.executed );
 
             // call the accept signal but only once for this transaction
             if (!trx->accepted) {
@@ -1485,6 +1871,9 @@ struct controller_impl {
 
             emit(self.applied_transaction, std::tie(trace, trn));
 
+            if( !trx->implicit && pending->_block_status == controller::block_status::incomplete ) {
+               transaction_latency::executed( trx->id() );
+            }
 
             if ( read_mode != db_read_mode::SPECULATIVE && pending->_block_status == controller::block_status::incomplete ) {
                //this may happen automatically in destructor, but I prefere make it more explicit
@@ -1505,8 +1894,10 @@ struct controller_impl {
             trace->except_ptr = std::current_exception();
          }
 
-         emit( self.accepted_transaction, trx );
-         emit( self.applied_transaction, std::tie(trace, trn) );
+         if( !trx->read_only ) {
+            emit( self.accepted_transaction, trx );
+            emit( self.applied_transaction, std::tie(trace, trn) );
+         }
 
          return trace;
       } FC_CAPTURE_AND_RETHROW((trace))
@@ -1519,6 +1910,13 @@ struct controller_impl {
                      const optional<block_id_type>& producer_block_id )
    {
       EOS_ASSERT( !pending, block_validate_exception, "pending block already exists" );
+      EOS_ASSERT( !conf.state_replica, block_validate_exception, "a state replica does not apply blocks" );
+      EOS_ASSERT( !partial_state, block_validate_exception, "a partial state does not apply blocks" );
+
+      if( replica_marker ) replica_marker->begin_write();
+
+      // state may have been reverted (aborted block, fork switch) since permissions were last checked
+      authorization.clear_satisfied_cache();
 
       auto guard_pending = fc::make_scoped_exit([this, head_block_num=head->block_num](){
          protocol_features.popped_blocks_to( head_block_num );
@@ -1613,7 +2011,7 @@ struct controller_impl {
 
          if( gpo.proposed_schedule_block_num.valid() && // if there is a proposed schedule that was proposed in a block ...
              ( *gpo.proposed_schedule_block_num <= pbhs.dpos_irreversible_blocknum ) && // ... that has now become irreversible ...
-             pbhs.prev_pending_schedule.schedule.producers.size() == 0 // ... and there was room for a new pending schedule prior to any possible promotion
+             pbhs.prev_pending_schedule.schedule->producers.size() == 0 // ... and there was room for a new pending schedule prior to any possible promotion
          )
          {
             // Promote proposed schedule to pending schedule.
@@ -1672,6 +2070,8 @@ struct controller_impl {
 
       auto& pbhs = pending->get_pending_block_header_state();
 
+      compress_pending_code();
+
       // Update resource limits:
       resource_limits.process_account_limit_updates();
       const auto& chain_config = self.get_global_properties().configuration;
@@ -1753,6 +2153,7 @@ struct controller_impl {
          }
 
          emit( self.accepted_block, bsp );
+         transaction_latency::included( *bsp->block );
 
          if( add_to_fork_db ) {
             log_irreversible();
@@ -1766,6 +2167,15 @@ struct controller_impl {
 
       // push the state for pending.
       pending->push();
+
+      auto bsp = pending->_block_stage.get<completed_block>()._block_state;
+      publish_replica_head( bsp );
+
+      reset_pending_on_exit.cancel();
+      pending.reset();
+      // otherwise head becomes the block once the caller has applied it
+      if( add_to_fork_db )
+         emit( self.committed_block, bsp );
    }
 
    /**
@@ -1852,6 +2262,7 @@ struct controller_impl {
 
    void apply_block( const block_state_ptr& bsp, controller::block_status s, const trx_meta_cache_lookup& trx_lookup )
    { try {
+      scoped_span span( "chain", "apply_block", span_trace_id( bsp->id ) );
       try {
          const signed_block_ptr& b = bsp->block;
          const auto& new_protocol_feature_activations = bsp->get_new_protocol_feature_activations();
@@ -1859,6 +2270,13 @@ struct controller_impl {
          auto producer_block_id = b->id();
          start_block( b->timestamp, b->confirmed, new_protocol_feature_activations, s, producer_block_id);
 
+         if( conf.report_trx_conflict_groups && !b->transactions.empty() ) {
+            auto conflicts = compute_transaction_conflict_groups( *b );
+            ilog( "block ${n}: ${t} transactions in ${g} independent groups, largest ${l}, ${s} scheduled",
+                  ("n", b->block_num())("t", b->transactions.size())("g", conflicts.groups.size())
+                  ("l", conflicts.largest_group())("s", conflicts.scheduled.size()) );
+         }
+
          const bool existing_trxs_metas = !bsp->trxs_metas().empty();
          const bool pub_keys_recovered = bsp->is_pub_keys_recovered();
          const bool skip_auth_checks = self.skip_auth_check();
@@ -1867,11 +2285,25 @@ struct controller_impl {
          if( pub_keys_recovered || (skip_auth_checks && existing_trxs_metas) ) {
             use_bsp_cached = true;
          } else {
+            auto prepared = prepared_trx_metas.find( bsp->id );
+            auto remove_prepared = fc::make_scoped_exit( [&]() {
+               if( prepared != prepared_trx_metas.end() )
+                  prepared_trx_metas.erase( prepared );
+            } );
             trx_metas.reserve( b->transactions.size() );
             for( const auto& receipt : b->transactions ) {
                if( receipt.trx.contains<packed_transaction>()) {
                   const auto& pt = receipt.trx.get<packed_transaction>();
+                  if( prepared != prepared_trx_metas.end() ) {
+                     trx_metas.emplace_back( transaction_metadata_ptr{}, std::move( prepared->second.at( trx_metas.size() ) ) );
+                     continue;
+                  }
                   transaction_metadata_ptr trx_meta_ptr = trx_lookup ? trx_lookup( pt.id() ) : transaction_metadata_ptr{};
+                  // the id does not cover signatures or context free data, only exactly the transaction of the block will do
+                  if( trx_meta_ptr && *trx_meta_ptr->packed_trx() != pt )
+                     trx_meta_ptr.reset();
+                  if( !trx_meta_ptr )
+                     trx_meta_ptr = trx_metadata_pool.find( pt );
                   if( trx_meta_ptr && ( skip_auth_checks || !trx_meta_ptr->recovered_keys().empty() ) ) {
                      trx_metas.emplace_back( std::move( trx_meta_ptr ), recover_keys_future{} );
                   } else if( skip_auth_checks ) {
@@ -1881,7 +2313,8 @@ struct controller_impl {
                   } else {
                      auto ptrx = std::make_shared<packed_transaction>( pt );
                      auto fut = transaction_metadata::start_recover_keys(
-                           std::move( ptrx ), thread_pool.get_executor(), chain_id, microseconds::maximum() );
+                           std::move( ptrx ), thread_pool.get_executor(), chain_id, microseconds::maximum(),
+                           UINT32_MAX, &recovered_keys );
                      trx_metas.emplace_back( transaction_metadata_ptr{}, std::move( fut ) );
                   }
                }
@@ -1996,6 +2429,8 @@ struct controller_impl {
    {
       controller::block_status s = controller::block_status::complete;
       EOS_ASSERT(!pending, block_validate_exception, "it is not valid to push a block when there is a pending block");
+      EOS_ASSERT(!conf.state_replica, block_validate_exception, "a state replica does not apply blocks");
+      EOS_ASSERT(!partial_state, block_validate_exception, "a partial state does not apply blocks");
 
       auto reset_prod_light_validation = fc::make_scoped_exit([old_value=trusted_producer_light_validation, this]() {
          trusted_producer_light_validation = old_value;
@@ -2015,6 +2450,9 @@ struct controller_impl {
          emit( self.accepted_block_header, bsp );
 
          if( read_mode != db_read_mode::IRREVERSIBLE ) {
+            // a block off the best branch waits in fork_db, perhaps until its branch overtakes
+            if( fork_db.pending_head() != bsp )
+               prepare_trx_metas( bsp );
             maybe_switch_forks( fork_db.pending_head(), s, forked_branch_cb, trx_lookup );
          } else {
             log_irreversible();
@@ -2023,7 +2461,8 @@ struct controller_impl {
       } FC_LOG_AND_RETHROW( )
    }
 
-   void replay_push_block( const signed_block_ptr& b, controller::block_status s ) {
+   void replay_push_block( const signed_block_ptr& b, controller::block_status s,
+                           const trx_meta_cache_lookup& trx_lookup = trx_meta_cache_lookup{} ) {
       self.validate_db_available_size();
       self.validate_reversible_available_size();
 
@@ -2054,8 +2493,9 @@ struct controller_impl {
          emit( self.accepted_block_header, bsp );
 
          if( s == controller::block_status::irreversible ) {
-            apply_block( bsp, s, trx_meta_cache_lookup{} );
+            apply_block( bsp, s, trx_lookup );
             head = bsp;
+            emit( self.committed_block, bsp );
 
             // On replay, log_irreversible is not called and so no irreversible_block signal is emittted.
             // So emit it explicitly here.
@@ -2087,6 +2527,7 @@ struct controller_impl {
             fork_db.remove( new_head->id );
             throw;
          }
+         emit( self.committed_block, head );
       } else if( new_head->id != head->id ) {
          auto old_head = head;
          ilog("switching forks from ${current_head_id} (block number ${current_head_num}) to ${new_head_id} (block number ${new_head_num})",
@@ -2103,6 +2544,10 @@ struct controller_impl {
             if( forked_branch_cb ) forked_branch_cb( branches.second );
          }
 
+         // recover the keys of the whole new branch at once, later blocks recover while earlier ones apply
+         for( const auto& b : branches.first )
+            prepare_trx_metas( b );
+
          for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr ) {
             optional<fc::exception> except;
             try {
@@ -2113,6 +2558,8 @@ struct controller_impl {
             } catch (const fc::exception& e) {
                except = e;
             }
+            if( !except )
+               emit( self.committed_block, head );
             if( except ) {
                elog("exception thrown while switching forks ${e}", ("e", except->to_detail_string()));
 
@@ -2133,6 +2580,7 @@ struct controller_impl {
                for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr ) {
                   apply_block( *ritr, controller::block_status::validated /* we previously validated these blocks*/, trx_lookup );
                   head = *ritr;
+                  emit( self.committed_block, head );
                }
                throw *except;
             } // end if exception
@@ -2153,32 +2601,56 @@ struct controller_impl {
       if( pending ) {
          applied_trxs = pending->extract_trx_metas();
          pending.reset();
+         authorization.clear_satisfied_cache();
          protocol_features.popped_blocks_to( head->block_num );
+         publish_replica_head( head ); // back at head
       }
       return applied_trxs;
    }
 
-   checksum256_type calculate_action_merkle() {
-      vector<digest_type> action_digests;
-      const auto& actions = pending->_block_stage.get<building_block>()._actions;
-      action_digests.reserve( actions.size() );
-      for( const auto& a : actions )
-         action_digests.emplace_back( a.digest() );
+   /// digest() of each item in order; large sets are split across the chain thread pool
+   template<typename T>
+   vector<digest_type> calculate_digests( const vector<T>& items ) {
+      constexpr size_t min_items_per_task = 512;
+      vector<digest_type> digests( items.size() );
+
+      auto digest_range = [&items, &digests]( size_t begin, size_t end ) {
+         for( size_t i = begin; i < end; ++i )
+            digests[i] = items[i].digest();
+      };
+
+      if( items.size() < 2 * min_items_per_task ) {
+         digest_range( 0, items.size() );
+         return digests;
+      }
 
-      return merkle( move(action_digests) );
+      // ranges of min_items_per_task and up are spread by work stealing, which keeps the calling thread busy too
+      const size_t ranges = (items.size() + min_items_per_task - 1) / min_items_per_task;
+      thread_pool.parallel_for( ranges, [&]( size_t r ) {
+         digest_range( r * min_items_per_task, std::min( (r + 1) * min_items_per_task, items.size() ) );
+      } );
+
+      return digests;
    }
 
-   static checksum256_type calculate_trx_merkle( const vector<transaction_receipt>& trxs ) {
-      vector<digest_type> trx_digests;
-      trx_digests.reserve( trxs.size() );
-      for( const auto& a : trxs )
-         trx_digests.emplace_back( a.digest() );
+   /// action receipts are hashed as each transaction is added, so finalizing only combines the digests
+   void append_action_receipt_digests( const vector<action_receipt>& executed ) {
+      auto& digests = pending->_block_stage.get<building_block>()._action_receipt_digests;
+      digests.reserve( digests.size() + executed.size() );
+      for( const auto& a : executed )
+         digests.emplace_back( a.digest() );
+   }
 
-      return merkle( move(trx_digests) );
+   checksum256_type calculate_action_merkle() {
+      return merkle( pending->_block_stage.get<building_block>()._action_receipt_digests );
+   }
+
+   checksum256_type calculate_trx_merkle( const vector<transaction_receipt>& trxs ) {
+      return merkle( calculate_digests( trxs ) );
    }
 
    void update_producers_authority() {
-      const auto& producers = pending->get_pending_block_header_state().active_schedule.producers;
+      const auto& producers = pending->get_pending_block_header_state().active_schedule->producers;
 
       auto update_permission = [&]( auto& permission, auto threshold ) {
          auto auth = authority( threshold, {}, {});
@@ -2666,6 +3138,14 @@ boost::asio::io_context& controller::get_thread_pool() {
    return my->thread_pool.get_executor();
 }
 
+recovered_keys_cache& controller::get_recovered_keys_cache() {
+   return my->recovered_keys;
+}
+
+transaction_metadata_pool& controller::get_transaction_metadata_pool() {
+   return my->trx_metadata_pool;
+}
+
 std::future<block_state_ptr> controller::create_block_state_future( const signed_block_ptr& b ) {
    return my->create_block_state_future( b );
 }
@@ -2683,6 +3163,7 @@ transaction_trace_ptr controller::push_transaction( const transaction_metadata_p
    validate_db_available_size();
    EOS_ASSERT( get_read_mode() != db_read_mode::IRREVERSIBLE, transaction_type_exception, "push transaction not allowed in irreversible mode" );
    EOS_ASSERT( trx && !trx->implicit && !trx->scheduled, transaction_type_exception, "Implicit/Scheduled transaction not allowed" );
+   EOS_ASSERT( !trx->read_only || my->pending, missing_pending_block_state, "read-only transaction requires a pending block" );
    return my->push_transaction(trx, deadline, billed_cpu_time_us, explicit_billed_cpu_time );
 }
 
@@ -2825,16 +3306,19 @@ const vector<transaction_receipt>& controller::get_pending_trx_receipts()const {
 }
 
 uint32_t controller::last_irreversible_block_num() const {
+   if( my->replica ) return my->replica->irreversible_block_num;
    return my->fork_db.root()->block_num;
 }
 
 block_id_type controller::last_irreversible_block_id() const {
+   if( my->replica ) return my->replica->irreversible_block_id;
    auto lib_num = last_irreversible_block_num();
 
    return get_block_id_for_num( lib_num );
 }
 
 time_point controller::last_irreversible_block_time() const {
+   if( my->replica ) return my->replica->irreversible_block_time.to_time_point();
    return my->fork_db.root()->header.timestamp.to_time_point();
 }
 
@@ -2856,18 +3340,33 @@ signed_block_ptr controller::fetch_block_by_id( block_id_type id )const {
 
 signed_block_ptr controller::fetch_block_by_number( uint32_t block_num )const  { try {
    auto blk_state = fetch_block_state_by_number( block_num );
-   if( blk_state ) {
+   if( blk_state && blk_state->block ) {
       return blk_state->block;
    }
 
+   if( my->replica_blocks ) return my->fetch_replica_block( block_num );
    return my->blog.read_block_by_num(block_num);
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+std::vector<char> controller::fetch_serialized_block_by_number( uint32_t block_num, size_t prefix_size )const  { try {
+   if( const auto* rb = my->reversible_blocks.find<reversible_block_object,by_num>( block_num ) ) {
+      std::vector<char> result( prefix_size + rb->packedblock.size() );
+      memcpy( result.data() + prefix_size, rb->packedblock.data(), rb->packedblock.size() );
+      return result;
+   }
+   return my->blog.read_serialized_block_by_num( block_num, prefix_size );
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
 block_state_ptr controller::fetch_block_state_by_id( block_id_type id )const {
    auto state = my->fork_db.get_block(id);
    return state;
 }
 
+size_t controller::prepared_trx_count( const block_id_type& id )const {
+   auto itr = my->prepared_trx_metas.find( id );
+   return itr != my->prepared_trx_metas.end() ? itr->second.size() : 0;
+}
+
 block_state_ptr controller::fetch_block_state_by_number( uint32_t block_num )const  { try {
    const auto& rev_blocks = my->reversible_blocks.get_index<reversible_block_index,by_num>();
    auto objitr = rev_blocks.find(block_num);
@@ -2889,6 +3388,12 @@ block_id_type controller::get_block_id_for_num( uint32_t block_num )const { try
    if( block_header::num_from_id(tapos_block_summary.block_id) == block_num )
       return tapos_block_summary.block_id;
 
+   if( my->replica_blocks ) {
+      const auto b = my->fetch_replica_block( block_num );
+      EOS_ASSERT( b, unknown_block_exception, "Could not find block: ${block}", ("block", block_num) );
+      return b->id();
+   }
+
    const auto& blog_head = my->blog.head();
 
    bool find_in_blog = (blog_head && block_num <= blog_head->block_num());
@@ -2921,6 +3426,7 @@ sha256 controller::calculate_integrity_hash()const { try {
 
 void controller::write_snapshot( const snapshot_writer_ptr& snapshot ) const {
    EOS_ASSERT( !my->pending, block_validate_exception, "cannot take a consistent snapshot with a pending block" );
+   EOS_ASSERT( !my->partial_state, snapshot_exception, "cannot take a snapshot of a partial state" );
    return my->add_to_snapshot(snapshot);
 }
 
@@ -3064,10 +3570,53 @@ bool controller::contracts_console()const {
    return my->conf.contracts_console;
 }
 
+bool controller::track_access_sets()const {
+   return my->conf.track_access_sets;
+}
+
+bool controller::trace_cpu_breakdown()const {
+   return my->conf.trace_cpu_breakdown;
+}
+
+bool controller::compress_contract_code()const {
+   return my->conf.compress_contract_code;
+}
+
+void controller::queue_code_compression( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version ) {
+   EOS_ASSERT( my->pending, block_validate_exception, "no pending block" );
+   if( my->conf.compress_contract_code )
+      my->pending->_code_to_compress.emplace_back( code_hash, vm_type, vm_version );
+}
+
 chain_id_type controller::get_chain_id()const {
    return my->chain_id;
 }
 
+bool controller::is_state_replica()const {
+   return my->conf.state_replica;
+}
+
+bool controller::is_partial_state()const {
+   return my->partial_state;
+}
+
+bool controller::refresh_replica_head() {
+   EOS_ASSERT( my->conf.state_replica, misc_exception, "not a state replica" );
+   return my->refresh_replica_head();
+}
+
+uint64_t controller::begin_replica_read()const {
+   EOS_ASSERT( my->conf.state_replica, misc_exception, "not a state replica" );
+   EOS_ASSERT( my->replica_marker->sequence() == my->replica_sequence, replica_state_exception,
+               "the primary is changing the state, retry" );
+   return my->replica_sequence;
+}
+
+void controller::end_replica_read( uint64_t sequence )const {
+   EOS_ASSERT( my->replica_marker->unchanged_since( sequence ), replica_state_exception,
+               "the primary changed the state while it was read, retry" );
+}
+
 db_read_mode controller::get_read_mode()const {
    return my->read_mode;
 }
@@ -3086,6 +3635,14 @@ const apply_handler* controller::find_apply_handler( account_name receiver, acco
    }
    return nullptr;
 }
+const apply_handler* controller::find_native_contract_handler( const digest_type& code_hash, action_name act ) const
+{
+   auto handler = my->native_contract_handlers.find( make_pair( code_hash, act ) );
+   if( handler != my->native_contract_handlers.end() )
+      return &handler->second;
+   return nullptr;
+}
+
 wasm_interface& controller::get_wasm_interface() {
    return my->wasmif;
 }
@@ -3214,6 +3771,152 @@ uint32_t controller::get_greylist_limit()const {
    return my->conf.greylist_limit;
 }
 
+bool controller::is_profiled_account(const account_name& receiver) const {
+   return my->conf.profile_accounts.find(receiver) != my->conf.profile_accounts.end();
+}
+
+void controller::record_action_profile(const account_name& receiver, const account_name& code, const action_name& act,
+                                       const fc::microseconds& elapsed, uint64_t host_calls) {
+   action_profile& p = my->action_profiles[std::make_tuple(receiver, code, act)];
+   ++p.executions;
+   p.elapsed += elapsed;
+   p.host_calls += host_calls;
+}
+
+const controller::action_profile_map& controller::get_action_profiles() const {
+   return my->action_profiles;
+}
+
+namespace {
+   // header of every allocation from the shared memory segment
+   constexpr uint64_t allocation_overhead = 2 * sizeof(void*);
+
+   // dynamically sized members of rows, each allocated separately from the row
+   uint64_t dynamic_bytes( const account_object& a )                 { return a.abi.size(); }
+   uint64_t dynamic_bytes( const code_object& c )                    { return c.code.size(); }
+   uint64_t dynamic_bytes( const key_value_object& kv )              { return kv.value.size(); }
+   uint64_t dynamic_bytes( const generated_transaction_object& gto ) { return gto.packed_trx.size(); }
+   uint64_t dynamic_bytes( const permission_object& p ) {
+      return p.auth.keys.size() * sizeof(shared_key_weight) + p.auth.accounts.size() * sizeof(permission_level_weight) +
+             p.auth.waits.size() * sizeof(wait_weight);
+   }
+
+   template<typename T, typename = void>
+   struct has_dynamic_bytes : std::false_type {};
+   template<typename T>
+   struct has_dynamic_bytes<T, decltype(void(dynamic_bytes(std::declval<const T&>())))> : std::true_type {};
+
+   // a node holds the row and the three offset pointers of its links in the tree of every ordering
+   template<typename Index>
+   uint64_t node_bytes() {
+      return sizeof(typename Index::value_type) + boost::mpl::size<typename Index::index_type_list>::value * 3 * sizeof(void*) +
+             allocation_overhead;
+   }
+
+   template<typename Object>
+   uint64_t row_bytes( const Object& o, uint64_t node ) {
+      if constexpr( has_dynamic_bytes<Object>::value ) {
+         const uint64_t dynamic = dynamic_bytes( o );
+         return dynamic ? node + dynamic + allocation_overhead : node;
+      }
+      return node;
+   }
+}
+
+std::vector<controller::index_memory_usage> controller::get_index_memory_usage( const fc::time_point& deadline ) const {
+   // rows visited of an index with dynamically sized members before the deadline is checked, and between checks
+   constexpr uint64_t deadline_check_rows = 256;
+   std::vector<index_memory_usage> result;
+   auto add = [&]( auto utils ) {
+      using index_t = typename decltype(utils)::index_t;
+      using object_t = typename index_t::value_type;
+      const auto& idx = my->db.get_index<index_t>().indices();
+      const uint64_t node = node_bytes<index_t>();
+      index_memory_usage& u = result.emplace_back();
+      // named like the index names of chainbase::database::row_count_per_index
+      u.index = boost::core::demangle( typeid(object_t).name() );
+      u.row_count = idx.size();
+      if constexpr( has_dynamic_bytes<object_t>::value ) {
+         uint64_t visited = 0;
+         for( const auto& o : idx ) {
+            if( visited % deadline_check_rows == 0 && visited > 0 && fc::time_point::now() > deadline ) break;
+            u.estimated_bytes += row_bytes( o, node );
+            ++visited;
+         }
+         if( visited < u.row_count ) {
+            u.estimated_bytes = u.estimated_bytes * u.row_count / visited;
+            u.extrapolated = true;
+         }
+      } else {
+         u.estimated_bytes = u.row_count * node;
+      }
+   };
+   controller_index_set::walk_indices( add );
+   contract_database_index_set::walk_indices( add );
+   index_set<permission_index, permission_usage_index, permission_link_index>::walk_indices( add );
+   index_set<resource_limits::resource_limits_index, resource_limits::resource_usage_index,
+             resource_limits::resource_limits_state_index, resource_limits::resource_limits_config_index>::walk_indices( add );
+   return result;
+}
+
+controller::table_usage_page controller::get_table_usage( const account_name& code, const optional<table_usage_cursor>& from,
+                                                          uint32_t limit, const fc::time_point& deadline ) const {
+   table_usage_page page;
+   std::map<std::pair<account_name, table_name>, table_usage> usage;
+   const auto& tables = my->db.get_index<table_id_multi_index, by_code_scope_table>();
+   auto t = from ? tables.lower_bound( boost::make_tuple( from->code, from->scope, from->table ) )
+                 : code.empty() ? tables.begin() : tables.lower_bound( boost::make_tuple( code ) );
+   for( bool first = true; t != tables.end() && (code.empty() || t->code == code); ++t, first = false ) {
+      // a page always walks one table so that following the cursors makes progress
+      const auto key = std::make_pair( t->code, t->table );
+      if( !first && ((usage.size() >= limit && usage.count( key ) == 0) || fc::time_point::now() > deadline) ) {
+         page.more = table_usage_cursor{ t->code, t->scope, t->table };
+         break;
+      }
+      table_usage& u = usage[key];
+      u.code = t->code;
+      u.table = t->table;
+      ++u.scopes;
+      u.estimated_bytes += node_bytes<table_id_multi_index>();
+      contract_database_index_set::walk_indices( [&]( auto utils ) {
+         using index_t = typename decltype(utils)::index_t;
+         using object_t = typename index_t::value_type;
+         const auto& idx = my->db.get_index<index_t, object_to_table_id_tag_t<object_t>>();
+         const uint64_t node = node_bytes<index_t>();
+         for( auto row = idx.lower_bound( boost::make_tuple( t->id ) ); row != idx.end() && row->t_id == t->id; ++row ) {
+            ++(std::is_same<object_t, key_value_object>::value ? u.primary_rows : u.secondary_rows);
+            u.estimated_bytes += row_bytes( *row, node );
+         }
+      } );
+   }
+
+   page.tables.reserve( usage.size() );
+   for( auto& u : usage )
+      page.tables.emplace_back( std::move( u.second ) );
+   std::sort( page.tables.begin(), page.tables.end(), []( const table_usage& a, const table_usage& b ) {
+      return a.estimated_bytes > b.estimated_bytes;
+   } );
+   return page;
+}
+
+uint32_t controller::table_access_sample_rate() const {
+   return my->conf.table_access_sample_rate;
+}
+
+void controller::record_table_access( const account_name& code, const table_name& table, bool write ) {
+   // read-only transactions apply on several threads at once
+   if( my->table_access_count.fetch_add( 1, std::memory_order_relaxed ) % my->conf.table_access_sample_rate )
+      return;
+   std::lock_guard<std::mutex> g( my->table_accesses_mtx );
+   table_access& a = my->table_accesses[std::make_pair( code, table )];
+   ++(write ? a.writes : a.reads);
+}
+
+controller::table_access_map controller::get_table_accesses() const {
+   std::lock_guard<std::mutex> g( my->table_accesses_mtx );
+   return my->table_accesses;
+}
+
 void controller::add_resource_greylist(const account_name &name) {
    my->conf.resource_greylist.insert(name);
 }
@@ -3286,9 +3989,9 @@ chain_id_type controller::extract_chain_id(snapshot_reader& snapshot) {
    return chain_id;
 }
 
-fc::optional<chain_id_type> controller::extract_chain_id_from_db( const path& state_dir ) {
+fc::optional<chain_id_type> controller::extract_chain_id_from_db( const path& state_dir, bool allow_dirty ) {
    try {
-      chainbase::database db( state_dir, chainbase::database::read_only );
+      chainbase::database db( state_dir, chainbase::database::read_only, 0, allow_dirty );
 
       db.add_index<database_header_multi_index>();
       db.add_index<global_property_multi_index>();
@@ -3354,6 +4057,14 @@ void controller_impl::on_activation<builtin_protocol_feature_t::wtmsig_block_sig
    } );
 }
 
+template<>
+void controller_impl::on_activation<builtin_protocol_feature_t::batched_db_intrinsics>() {
+   db.modify( db.get<protocol_state_object>(), [&]( auto& ps ) {
+      add_intrinsic_to_whitelist( ps.whitelisted_intrinsics, "db_get_i64_batch" );
+      add_intrinsic_to_whitelist( ps.whitelisted_intrinsics, "db_store_i64_batch" );
+   } );
+}
+
 
 
 /// End of protocol feature activation handlers
@@ -0,0 +1,59 @@
+#include <eosio/chain/cpu_features.hpp>
+
+#include <openssl/crypto.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+namespace eosio { namespace chain {
+
+const cpu_features& cpu_features::host() {
+   static const cpu_features features = []() {
+      cpu_features f;
+#if defined(__x86_64__) || defined(__i386__)
+      unsigned int eax, ebx, ecx, edx;
+      if( __get_cpuid( 1, &eax, &ebx, &ecx, &edx ) )
+         f.sse41 = ecx & bit_SSE4_1;
+      if( __get_cpuid_count( 7, 0, &eax, &ebx, &ecx, &edx ) ) {
+         f.avx2   = ebx & bit_AVX2;
+         f.bmi2   = ebx & bit_BMI2;
+         f.adx    = ebx & (1u << 19);
+         f.sha_ni = ebx & (1u << 29);
+      }
+#endif
+      return f;
+   }();
+   return features;
+}
+
+std::string cpu_features::to_string()const {
+   std::string result;
+   const std::pair<bool, const char*> names[] = {
+      { sse41, "sse4.1" }, { avx2, "avx2" }, { bmi2, "bmi2" }, { adx, "adx" }, { sha_ni, "sha_ni" } };
+   for( const auto& n : names ) {
+      if( !n.first )
+         continue;
+      if( !result.empty() )
+         result += ' ';
+      result += n.second;
+   }
+   return result.empty() ? "none" : result;
+}
+
+std::vector<std::string> crypto_kernel_report() {
+   const cpu_features& cpu = cpu_features::host();
+   const std::string openssl = OpenSSL_version( OPENSSL_VERSION );
+   // OPENSSL_ia32cap in the environment masks what OpenSSL detects, so the sha extensions may still be turned off
+   const char* sha = cpu.sha_ni ? "sha extensions" : cpu.avx2 ? "avx2" : cpu.sse41 ? "ssse3" : "portable";
+
+   return {
+      "cpu features: " + cpu.to_string(),
+      "sha1, sha256: " + openssl + ", " + sha + " unless masked by OPENSSL_ia32cap",
+      "sha512: " + openssl + ", " + (cpu.avx2 ? "avx2" : "portable") + " unless masked by OPENSSL_ia32cap",
+      "ripemd160: " + openssl + ", portable",
+      "secp256k1 recovery: libsecp256k1, field arithmetic chosen at build time; secp256r1: " + openssl
+   };
+}
+
+} } // eosio::chain
@@ -137,7 +137,7 @@ void apply_eosio_setcode(apply_context& context) {
 
    if( code_size > 0 ) {
      code_hash = fc::sha256::hash( act.code.data(), (uint32_t)act.code.size() );
-     wasm_interface::validate(context.control, act.code);
+     context.control.get_wasm_interface().validate_new_code(context.control, code_hash, act.code);
    }
 
    const auto& account = db.get<account_metadata_object,by_name>(act.account);
@@ -152,7 +152,7 @@ void apply_eosio_setcode(apply_context& context) {
       const code_object& old_code_entry = db.get<code_object, by_code_hash>(boost::make_tuple(account.code_hash, account.vm_type, account.vm_version));
       EOS_ASSERT( old_code_entry.code_hash != code_hash, set_exact_code,
                   "contract is already running this version of code" );
-      old_size  = (int64_t)old_code_entry.code.size() * config::setcode_ram_bytes_multiplier;
+      old_size  = (int64_t)old_code_entry.code_size() * config::setcode_ram_bytes_multiplier;
       if( old_code_entry.code_ref_count == 1 ) {
          db.remove(old_code_entry);
          context.control.get_wasm_interface().code_block_num_last_used(account.code_hash, account.vm_type, account.vm_version, context.control.head_block_num() + 1);
@@ -179,6 +179,7 @@ void apply_eosio_setcode(apply_context& context) {
             o.vm_type = act.vmtype;
             o.vm_version = act.vmversion;
          });
+         context.control.queue_code_compression(code_hash, act.vmtype, act.vmversion);
       }
    }
 
@@ -8,6 +8,8 @@
 #include <boost/multi_index/global_fun.hpp>
 #include <boost/multi_index/composite_key.hpp>
 #include <fc/io/fstream.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <fstream>
 
 namespace eosio { namespace chain {
@@ -17,7 +19,7 @@ namespace eosio { namespace chain {
    const uint32_t fork_database::magic_number = 0x30510FDB;
 
    const uint32_t fork_database::min_supported_version = 1;
-   const uint32_t fork_database::max_supported_version = 1;
+   const uint32_t fork_database::max_supported_version = 2;
 
    // work around block_state::is_valid being private
    inline bool block_state_is_valid( const block_state& bs ) {
@@ -27,6 +29,8 @@ namespace eosio { namespace chain {
    /**
     * History:
     * Version 1: initial version of the new refactored fork database portable format
+    * Version 2: each block state is its block_header_state, validated flag and whether its block is in the block_store,
+    *            followed by the block only when it is not
     */
 
    struct by_block_id;
@@ -36,7 +40,7 @@ namespace eosio { namespace chain {
       block_state_ptr,
       indexed_by<
          hashed_unique< tag<by_block_id>, member<block_header_state, block_id_type, &block_header_state::id>, std::hash<block_id_type>>,
-         ordered_non_unique< tag<by_prev>, const_mem_fun<block_header_state, const block_id_type&, &block_header_state::prev> >,
+         hashed_non_unique< tag<by_prev>, const_mem_fun<block_header_state, const block_id_type&, &block_header_state::prev>, std::hash<block_id_type>>,
          ordered_unique< tag<by_lib_block_num>,
             composite_key< block_state,
                global_fun<const block_state&,            bool,          &block_state_is_valid>,
@@ -65,11 +69,12 @@ namespace eosio { namespace chain {
       ,datadir(data_dir)
       {}
 
-      fork_database&        self;
-      fork_multi_index_type index;
-      block_state_ptr       root; // Only uses the block_header_state portion
-      block_state_ptr       head;
-      fc::path              datadir;
+      fork_database&            self;
+      fork_multi_index_type     index;
+      block_state_ptr           root; // Only uses the block_header_state portion
+      block_state_ptr           head;
+      fc::path                  datadir;
+      fork_database::block_store store;
 
       void add( const block_state_ptr& n,
                 bool ignore_duplicate, bool validate,
@@ -83,6 +88,10 @@ namespace eosio { namespace chain {
    :my( new fork_database_impl( *this, data_dir ) )
    {}
 
+   void fork_database::set_block_store( block_store store ) {
+      my->store = std::move( store );
+   }
+
 
    void fork_database::open( const std::function<void( block_timestamp_type,
                                                        const flat_set<digest_type>&,
@@ -94,10 +103,11 @@ namespace eosio { namespace chain {
       auto fork_db_dat = my->datadir / config::forkdb_filename;
       if( fc::exists( fork_db_dat ) ) {
          try {
-            string content;
-            fc::read_file_contents( fork_db_dat, content );
+            namespace bip = boost::interprocess;
+            bip::file_mapping  fm( fork_db_dat.generic_string().c_str(), bip::read_only );
+            bip::mapped_region region( fm, bip::read_only );
 
-            fc::datastream<const char*> ds( content.data(), content.size() );
+            fc::datastream<const char*> ds( static_cast<const char*>( region.get_address() ), region.get_size() );
 
             // validate totem
             uint32_t totem = 0;
@@ -126,35 +136,67 @@ namespace eosio { namespace chain {
             fc::raw::unpack( ds, bhs );
             reset( bhs );
 
+            // blocks kept in the block store may be gone after --fix-reversible-blocks or --truncate-at-block
+            bool missing_block = false;
             unsigned_int size; fc::raw::unpack( ds, size );
-            for( uint32_t i = 0, n = size.value; i < n; ++i ) {
+            for( uint32_t i = 0, n = size.value; i < n && !missing_block; ++i ) {
                block_state s;
-               fc::raw::unpack( ds, s );
+               if( version == 1 ) {
+                  fc::raw::unpack( ds, s );
+               } else {
+                  fc::raw::unpack( ds, static_cast<block_header_state&>( s ) );
+                  fc::raw::unpack( ds, s.validated );
+                  bool stored = false;
+                  fc::raw::unpack( ds, stored );
+                  if( stored ) {
+                     EOS_ASSERT( my->store.fetch, fork_database_exception,
+                                 "Fork database file '${filename}' references stored blocks but no block store is set",
+                                 ("filename", fork_db_dat.generic_string()) );
+                     s.block = my->store.fetch( s.block_num );
+                     if( !s.block || s.block->id() != s.id ) {
+                        wlog( "Block ${num} ${id} referenced by fork database file '${filename}' is not in the block store, "
+                              "discarding the fork database and resetting it to its root ${root}",
+                              ("num", s.block_num)("id", s.id)("filename", fork_db_dat.generic_string())("root", bhs.block_num) );
+                        reset( bhs );
+                        missing_block = true;
+                        continue;
+                     }
+                  } else {
+                     s.block = std::make_shared<signed_block>();
+                     fc::raw::unpack( ds, *s.block );
+                  }
+               }
                // do not populate transaction_metadatas, they will be created as needed in apply_block with appropriate key recovery
                s.header_exts = s.block->validate_and_extract_header_extensions();
+               // each state was unpacked with its own copies, share the ones that did not change since its parent
+               if( auto prev = get_block_header( s.header.previous ) )
+                  s.share_unchanged_with( *prev );
                my->add( std::make_shared<block_state>( move( s ) ), false, true, validator );
             }
-            block_id_type head_id;
-            fc::raw::unpack( ds, head_id );
-
-            if( my->root->id == head_id ) {
-               my->head = my->root;
-            } else {
-               my->head = get_block( head_id );
-               EOS_ASSERT( my->head, fork_database_exception,
-                           "could not find head while reconstructing fork database from file; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            }
-
-            auto candidate = my->index.get<by_lib_block_num>().begin();
-            if( candidate == my->index.get<by_lib_block_num>().end() || !(*candidate)->is_valid() ) {
-               EOS_ASSERT( my->head->id == my->root->id, fork_database_exception,
-                           "head not set to root despite no better option available; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
-            } else {
-               EOS_ASSERT( !first_preferred( **candidate, *my->head ), fork_database_exception,
-                           "head not set to best available option available; '${filename}' is likely corrupted",
-                           ("filename", fork_db_dat.generic_string()) );
+            // after a missing block the rest of the file is skipped, the fork database holds only its root
+            if( !missing_block ) {
+               block_id_type head_id;
+               fc::raw::unpack( ds, head_id );
+
+               if( my->root->id == head_id ) {
+                  my->head = my->root;
+               } else {
+                  my->head = get_block( head_id );
+                  EOS_ASSERT( my->head, fork_database_exception,
+                              "could not find head while reconstructing fork database from file; '${filename}' is likely corrupted",
+                              ("filename", fork_db_dat.generic_string()) );
+               }
+
+               auto candidate = my->index.get<by_lib_block_num>().begin();
+               if( candidate == my->index.get<by_lib_block_num>().end() || !(*candidate)->is_valid() ) {
+                  EOS_ASSERT( my->head->id == my->root->id, fork_database_exception,
+                              "head not set to root despite no better option available; '${filename}' is likely corrupted",
+                              ("filename", fork_db_dat.generic_string()) );
+               } else {
+                  EOS_ASSERT( !first_preferred( **candidate, *my->head ), fork_database_exception,
+                              "head not set to best available option available; '${filename}' is likely corrupted",
+                              ("filename", fork_db_dat.generic_string()) );
+               }
             }
          } FC_CAPTURE_AND_RETHROW( (fork_db_dat) )
 
@@ -212,7 +254,13 @@ namespace eosio { namespace chain {
             ++validated_itr;
          }
 
-         fc::raw::pack( out, *(*itr) );
+         const block_state& s = **itr;
+         fc::raw::pack( out, static_cast<const block_header_state&>( s ) );
+         fc::raw::pack( out, s.validated );
+         const bool stored = my->store.contains && my->store.contains( s.block_num, s.id );
+         fc::raw::pack( out, stored );
+         if( !stored )
+            fc::raw::pack( out, *s.block );
       }
 
       if( my->head ) {
@@ -450,10 +498,9 @@ namespace eosio { namespace chain {
          EOS_ASSERT( remove_queue[i] != head_id, fork_database_exception,
                      "removing the block and its descendants would remove the current head block" );
 
-         auto previtr = previdx.lower_bound( remove_queue[i] );
-         while( previtr != previdx.end() && (*previtr)->header.previous == remove_queue[i] ) {
+         auto children = previdx.equal_range( remove_queue[i] );
+         for( auto previtr = children.first; previtr != children.second; ++previtr ) {
             remove_queue.push_back( (*previtr)->id );
-            ++previtr;
          }
       }
 
@@ -0,0 +1,190 @@
+#include <eosio/chain/hardware_float.hpp>
+
+#include <fc/log/logger.hpp>
+
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
+namespace eosio { namespace chain { namespace hardware_float {
+
+#if defined(__x86_64__) || defined(__aarch64__)
+static_assert( FLT_EVAL_METHOD == 0, "floats and doubles must be computed at their own precision" );
+#endif
+
+namespace {
+
+   std::atomic<bool> fast_path{false};
+
+   bool environment_ok() {
+#if defined(__x86_64__)
+      // MXCSR: rounding control in bits 13 and 14, flush to zero in 15, denormals are zero in 6, and every exception
+      // masked in 7 through 12 so that no operation traps
+      const uint32_t csr = _mm_getcsr();
+      return ( csr & 0xE040u ) == 0 && ( csr & 0x1F80u ) == 0x1F80u;
+#elif defined(__aarch64__)
+      // FPCR: rounding mode in bits 22 and 23, flush to zero in 24, FEAT_AFP's FIZ and AH in 0 and 1, and the trap
+      // enables IOE, DZE, OFE, UFE, IXE in 8 through 12 and IDE in 15 all clear so that no operation traps
+      uint64_t fpcr;
+      __asm__ __volatile__( "mrs %0, fpcr" : "=r"( fpcr ) );
+      return ( fpcr & ( (3u << 22) | (1u << 24) | (1u << 15) | (0x1Fu << 8) | 3u ) ) == 0;
+#else
+      return false;
+#endif
+   }
+
+   float     to_float( float32_t f )  { float r;     std::memcpy( &r, &f, sizeof(r) ); return r; }
+   double    to_double( float64_t f ) { double r;    std::memcpy( &r, &f, sizeof(r) ); return r; }
+   float32_t to_f32( float f )        { float32_t r; std::memcpy( &r, &f, sizeof(r) ); return r; }
+   float64_t to_f64( double f )       { float64_t r; std::memcpy( &r, &f, sizeof(r) ); return r; }
+
+   // this file is built with -ffp-contract=off, so each of these is the one instruction IEEE-754 specifies
+   float  hw_add( float a, float b )   { return a + b; }
+   float  hw_sub( float a, float b )   { return a - b; }
+   float  hw_mul( float a, float b )   { return a * b; }
+   float  hw_div( float a, float b )   { return a / b; }
+   float  hw_sqrt( float a )           { return std::sqrt( a ); }
+   double hw_add( double a, double b ) { return a + b; }
+   double hw_sub( double a, double b ) { return a - b; }
+   double hw_mul( double a, double b ) { return a * b; }
+   double hw_div( double a, double b ) { return a / b; }
+   double hw_sqrt( double a )          { return std::sqrt( a ); }
+
+   /// sign, exponent and significand patterns around each boundary of the format: zero, subnormal, one, overflow
+   template<typename UI>
+   std::vector<UI> hard_cases( int exponent_bits, int significand_bits ) {
+      const UI max_exp = ( UI(1) << exponent_bits ) - 1;
+      const UI bias = max_exp / 2;
+      const UI half = UI(1) << ( significand_bits - 1 );
+      const UI all = ( UI(1) << significand_bits ) - 1;
+      std::vector<UI> cases;
+      for( UI sign : { UI(0), UI(1) } ) {
+         for( UI e : { UI(0), UI(1), UI(2), UI(bias - 1), bias, UI(bias + 1), UI(max_exp - 2), UI(max_exp - 1), max_exp } ) {
+            for( UI m : { UI(0), UI(1), UI(2), UI(half - 1), half, UI(half + 1), UI(all - 1), all } )
+               cases.push_back( sign << ( exponent_bits + significand_bits ) | e << significand_bits | m );
+         }
+      }
+      return cases;
+   }
+
+   /// a hardware result agrees when it has softfloat's bits, or when both are NaN, which the fast path recomputes
+   bool agrees( float hw, float32_t soft ) {
+      return std::isnan( hw ) ? ( soft.v & 0x7FFFFFFFu ) > 0x7F800000u : to_f32( hw ).v == soft.v;
+   }
+   bool agrees( double hw, float64_t soft ) {
+      return std::isnan( hw ) ? ( soft.v & 0x7FFFFFFFFFFFFFFFull ) > 0x7FF0000000000000ull : to_f64( hw ).v == soft.v;
+   }
+
+   bool run_hard_cases() {
+      for( uint32_t a : hard_cases<uint32_t>( 8, 23 ) ) {
+         const float32_t sa{ a };
+         if( !agrees( hw_sqrt( to_float( sa ) ), ::f32_sqrt( sa ) ) )
+            return false;
+         for( uint32_t b : hard_cases<uint32_t>( 8, 23 ) ) {
+            const float32_t sb{ b };
+            const float fa = to_float( sa ), fb = to_float( sb );
+            if( !agrees( hw_add( fa, fb ), ::f32_add( sa, sb ) ) || !agrees( hw_sub( fa, fb ), ::f32_sub( sa, sb ) ) ||
+                !agrees( hw_mul( fa, fb ), ::f32_mul( sa, sb ) ) || !agrees( hw_div( fa, fb ), ::f32_div( sa, sb ) ) )
+               return false;
+         }
+      }
+      for( uint64_t a : hard_cases<uint64_t>( 11, 52 ) ) {
+         const float64_t sa{ a };
+         if( !agrees( hw_sqrt( to_double( sa ) ), ::f64_sqrt( sa ) ) )
+            return false;
+         for( uint64_t b : hard_cases<uint64_t>( 11, 52 ) ) {
+            const float64_t sb{ b };
+            const double da = to_double( sa ), db = to_double( sb );
+            if( !agrees( hw_add( da, db ), ::f64_add( sa, sb ) ) || !agrees( hw_sub( da, db ), ::f64_sub( sa, sb ) ) ||
+                !agrees( hw_mul( da, db ), ::f64_mul( sa, sb ) ) || !agrees( hw_div( da, db ), ::f64_div( sa, sb ) ) )
+               return false;
+         }
+      }
+      return true;
+   }
+
+   template<typename Hw, typename Soft>
+   float32_t f32_op( Hw&& hw, Soft&& soft ) {
+      if( usable() ) {
+         const float r = hw();
+         if( !std::isnan( r ) )
+            return to_f32( r );
+      }
+      return soft();
+   }
+
+   template<typename Hw, typename Soft>
+   float64_t f64_op( Hw&& hw, Soft&& soft ) {
+      if( usable() ) {
+         const double r = hw();
+         if( !std::isnan( r ) )
+            return to_f64( r );
+      }
+      return soft();
+   }
+
+}
+
+void set_enabled( bool enabled ) {
+   fast_path.store( enabled, std::memory_order_relaxed );
+}
+
+bool enabled() {
+   return fast_path.load( std::memory_order_relaxed );
+}
+
+bool verified() {
+   static const bool result = []() {
+      if( !compiled || !environment_ok() )
+         return false;
+      const bool ok = run_hard_cases();
+      if( !ok )
+         wlog( "hardware floating point disagrees with softfloat on this host, float intrinsics stay on softfloat" );
+      return ok;
+   }();
+   return result;
+}
+
+bool usable() {
+   return compiled && enabled() && environment_ok() && verified();
+}
+
+float32_t f32_add( float32_t a, float32_t b ) {
+   return f32_op( [&]() { return hw_add( to_float( a ), to_float( b ) ); }, [&]() { return ::f32_add( a, b ); } );
+}
+float32_t f32_sub( float32_t a, float32_t b ) {
+   return f32_op( [&]() { return hw_sub( to_float( a ), to_float( b ) ); }, [&]() { return ::f32_sub( a, b ); } );
+}
+float32_t f32_mul( float32_t a, float32_t b ) {
+   return f32_op( [&]() { return hw_mul( to_float( a ), to_float( b ) ); }, [&]() { return ::f32_mul( a, b ); } );
+}
+float32_t f32_div( float32_t a, float32_t b ) {
+   return f32_op( [&]() { return hw_div( to_float( a ), to_float( b ) ); }, [&]() { return ::f32_div( a, b ); } );
+}
+float32_t f32_sqrt( float32_t a ) {
+   return f32_op( [&]() { return hw_sqrt( to_float( a ) ); }, [&]() { return ::f32_sqrt( a ); } );
+}
+
+float64_t f64_add( float64_t a, float64_t b ) {
+   return f64_op( [&]() { return hw_add( to_double( a ), to_double( b ) ); }, [&]() { return ::f64_add( a, b ); } );
+}
+float64_t f64_sub( float64_t a, float64_t b ) {
+   return f64_op( [&]() { return hw_sub( to_double( a ), to_double( b ) ); }, [&]() { return ::f64_sub( a, b ); } );
+}
+float64_t f64_mul( float64_t a, float64_t b ) {
+   return f64_op( [&]() { return hw_mul( to_double( a ), to_double( b ) ); }, [&]() { return ::f64_mul( a, b ); } );
+}
+float64_t f64_div( float64_t a, float64_t b ) {
+   return f64_op( [&]() { return hw_div( to_double( a ), to_double( b ) ); }, [&]() { return ::f64_div( a, b ); } );
+}
+float64_t f64_sqrt( float64_t a ) {
+   return f64_op( [&]() { return hw_sqrt( to_double( a ) ); }, [&]() { return ::f64_sqrt( a ); } );
+}
+
+} } } // eosio::chain::hardware_float
@@ -3,6 +3,8 @@
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <utility>
+#include <set>
+#include <unordered_map>
 #include <fc/variant_object.hpp>
 #include <fc/scoped_exit.hpp>
 
@@ -24,6 +26,44 @@ namespace impl {
    struct variant_to_binary_context;
 }
 
+/**
+ *  The built-in types of every ABI: X(abi name, kind, C++ type it packs as, whether unpacking it checks the deadline).
+ *  The same list generates the built-in type table and the switch that decodes and encodes them.
+ *  TODO: Add proper support for floating point types. For now this is good enough.
+ */
+#define EOSIO_ABI_BUILT_IN_TYPES(X) \
+   X("bool",                 bool_,                 uint8_t,              false) \
+   X("int8",                 int8,                  int8_t,               false) \
+   X("uint8",                uint8,                 uint8_t,              false) \
+   X("int16",                int16,                 int16_t,              false) \
+   X("uint16",               uint16,                uint16_t,             false) \
+   X("int32",                int32,                 int32_t,              false) \
+   X("uint32",               uint32,                uint32_t,             false) \
+   X("int64",                int64,                 int64_t,              false) \
+   X("uint64",               uint64,                uint64_t,             false) \
+   X("int128",               int128,                int128_t,             false) \
+   X("uint128",              uint128,               uint128_t,            false) \
+   X("varint32",             varint32,              fc::signed_int,       false) \
+   X("varuint32",            varuint32,             fc::unsigned_int,     false) \
+   X("float32",              float32,               float,                false) \
+   X("float64",              float64,               double,               false) \
+   X("float128",             float128,              float128_t,           false) \
+   X("time_point",           time_point,            fc::time_point,       false) \
+   X("time_point_sec",       time_point_sec,        fc::time_point_sec,   false) \
+   X("block_timestamp_type", block_timestamp_type,  block_timestamp_type, false) \
+   X("name",                 name,                  name,                 false) \
+   X("bytes",                bytes,                 bytes,                false) \
+   X("string",               string,                string,               false) \
+   X("checksum160",          checksum160,           checksum160_type,     false) \
+   X("checksum256",          checksum256,           checksum256_type,     false) \
+   X("checksum512",          checksum512,           checksum512_type,     false) \
+   X("public_key",           public_key,            public_key_type,      true)  \
+   X("signature",            signature,             signature_type,       true)  \
+   X("symbol",               symbol,                symbol,               false) \
+   X("symbol_code",          symbol_code,           symbol_code,          false) \
+   X("asset",                asset,                 asset,                false) \
+   X("extended_asset",       extended_asset,        extended_asset,       false)
+
 /**
  *  Describes the binary representation message and table contents so that it can
  *  be converted to and from JSON.
@@ -33,8 +73,12 @@ struct abi_serializer {
    /// passed recursion_depth on each invocation
    using yield_function_t = fc::optional_delegate<void(size_t)>;
 
-   abi_serializer(){ configure_built_in_types(); }
+   abi_serializer(){ configure_built_in_types(); build_type_plans(); }
    abi_serializer( const abi_def& abi, const yield_function_t& yield );
+   abi_serializer( const abi_serializer& other );
+   abi_serializer( abi_serializer&& other ) = default;
+   abi_serializer& operator=( const abi_serializer& other );
+   abi_serializer& operator=( abi_serializer&& other ) = default;
    void set_abi( const abi_def& abi, const yield_function_t& yield );
 
    /// @return string_view of `t` or internal string type
@@ -60,6 +104,13 @@ struct abi_serializer {
    fc::variant binary_to_variant( const std::string_view& type, const bytes& binary, const yield_function_t& yield, bool short_path = false )const;
    fc::variant binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, const yield_function_t& yield, bool short_path = false )const;
 
+   /**
+    * Same result as fc::json::to_string( binary_to_variant(...) ), but the JSON text is appended to `out` while the
+    * binary is walked, so no variant tree is built for structs, arrays, optionals and variants.
+    */
+   void        binary_to_json( const std::string_view& type, const bytes& binary, std::string& out, const yield_function_t& yield, bool short_path = false )const;
+   void        binary_to_json( const std::string_view& type, fc::datastream<const char*>& binary, std::string& out, const yield_function_t& yield, bool short_path = false )const;
+
    bytes       variant_to_binary( const std::string_view& type, const fc::variant& var, const yield_function_t& yield, bool short_path = false )const;
    void        variant_to_binary( const std::string_view& type, const fc::variant& var, fc::datastream<char*>& ds, const yield_function_t& yield, bool short_path = false )const;
 
@@ -93,8 +144,12 @@ struct abi_serializer {
 
    static constexpr size_t max_recursion_depth = 32; // arbitrary depth to prevent infinite recursion
 
+   /// calls of a yield function from create_yield_function per read of the clock
+   static constexpr uint32_t deadline_check_interval = 64;
+
    // create standard yield function that checks for max_serialization_time and max_recursion_depth.
-   // now() deadline caputered at time of this call
+   // now() deadline caputered at time of this call. The recursion depth is checked on every call, the clock on the
+   // first and then every deadline_check_interval calls, so a traversal may overrun by that many steps.
    static yield_function_t create_yield_function(const fc::microseconds& max_serialization_time) {
       fc::time_point deadline = fc::time_point::now();
       if( max_serialization_time > fc::microseconds::maximum() - deadline.time_since_epoch() ) {
@@ -102,10 +157,12 @@ struct abi_serializer {
       } else {
          deadline += max_serialization_time;
       }
-      return [max_serialization_time, deadline](size_t recursion_depth) {
+      return [max_serialization_time, deadline, calls = uint32_t(0)](size_t recursion_depth) mutable {
          EOS_ASSERT( recursion_depth < max_recursion_depth, abi_recursion_depth_exception,
                      "recursive definition, max_recursion_depth ${r} ", ("r", max_recursion_depth) );
 
+         if( deadline == fc::time_point::maximum() || calls++ % deadline_check_interval != 0 )
+            return;
          EOS_ASSERT( fc::time_point::now() < deadline, abi_serialization_deadline_exception,
                      "serialization time limit ${t}us exceeded", ("t", max_serialization_time) );
       };
@@ -121,16 +178,74 @@ private:
    map<type_name, variant_def, std::less<>>   variants;
 
    map<type_name, pair<unpack_function, pack_function>, std::less<>> built_in_types;
+   std::set<type_name, std::less<>>                                  specialized_types; ///< built-ins replaced by add_specialized_unpack_pack
    void configure_built_in_types();
 
+   enum class built_in_kind : uint8_t {
+      none, ///< a specialized or unknown type, handled by its unpack_function and pack_function
+#define EOSIO_ABI_BUILT_IN_KIND(abi_name, kind, type, deadline) kind,
+      EOSIO_ABI_BUILT_IN_TYPES(EOSIO_ABI_BUILT_IN_KIND)
+#undef EOSIO_ABI_BUILT_IN_KIND
+   };
+
+   struct type_plan;
+
+   struct field_plan {
+      const field_def*   def = nullptr;
+      std::string_view   type;             ///< field type without the binary extension marker
+      const type_plan*   plan = nullptr;   ///< plan of `type`, nullptr if it has none
+      bool               extension = false;
+   };
+
+   /**
+    *  Result of resolving a type name against this ABI: typedefs followed, and the built-in, struct or variant it
+    *  names looked up, along with plans for the types it refers to. Plans are built by set_abi for every type
+    *  name mentioned by the ABI so that traversal follows pointers instead of repeating string map lookups for
+    *  every field of every row. All views, pointers and iterators refer into this serializer's own maps.
+    */
+   struct type_plan {
+      std::string_view                               rtype;   ///< type after resolving typedefs
+      std::string_view                               ftype;   ///< fundamental type of rtype
+      bool                                           array_type    = false;
+      bool                                           optional_type = false;
+      const pair<unpack_function, pack_function>*    built_in = nullptr;
+      built_in_kind                                  kind = built_in_kind::none; ///< decoded by a switch rather than built_in
+      optional<decltype(structs)::const_iterator>    struct_itr;
+      optional<decltype(variants)::const_iterator>   variant_itr;
+      const type_plan*                               element  = nullptr; ///< plan of ftype, for arrays and optionals
+      const type_plan*                               base     = nullptr; ///< plan of the struct base
+      vector<field_plan>                             fields;             ///< struct fields, excluding those of the base
+   };
+
+   std::unordered_map<std::string_view, type_plan>   type_plans;
+
+   /// the kind listed for type in EOSIO_ABI_BUILT_IN_TYPES, none if it is not listed
+   static built_in_kind built_in_kind_of( const std::string_view& type );
+   fc::variant unpack_built_in_value( const type_plan& plan, fc::datastream<const char*>& stream, impl::binary_to_variant_context& ctx )const;
+
+   type_plan make_type_plan( const std::string_view& type )const;
+   void link_type_plan( type_plan& p )const;
+   void build_type_plans();
+   const type_plan* find_type_plan( const std::string_view& type )const;
+
    fc::variant _binary_to_variant( const std::string_view& type, const bytes& binary, impl::binary_to_variant_context& ctx )const;
    fc::variant _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& binary, impl::binary_to_variant_context& ctx )const;
-   void        _binary_to_variant( const std::string_view& type, fc::datastream<const char*>& stream,
+   fc::variant _binary_to_variant( const type_plan& plan, fc::datastream<const char*>& binary, impl::binary_to_variant_context& ctx )const;
+   void        _binary_to_variant( const type_plan& plan, fc::datastream<const char*>& stream,
                                    fc::mutable_variant_object& obj, impl::binary_to_variant_context& ctx )const;
 
+   /// @return false if the value written was null
+   bool        _binary_to_json( const std::string_view& type, fc::datastream<const char*>& stream, std::string& out, impl::binary_to_variant_context& ctx )const;
+   bool        _binary_to_json( const type_plan& plan, fc::datastream<const char*>& stream, std::string& out, impl::binary_to_variant_context& ctx )const;
+   /// @return number of fields written
+   size_t      _binary_to_json_fields( const type_plan& plan, fc::datastream<const char*>& stream, std::string& out,
+                                       bool first, impl::binary_to_variant_context& ctx )const;
+
    bytes       _variant_to_binary( const std::string_view& type, const fc::variant& var, impl::variant_to_binary_context& ctx )const;
    void        _variant_to_binary( const std::string_view& type, const fc::variant& var,
                                    fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
+   void        _variant_to_binary( const type_plan& plan, const std::string_view& type, const fc::variant& var,
+                                   fc::datastream<char*>& ds, impl::variant_to_binary_context& ctx )const;
 
    static std::string_view _remove_bin_extension(const std::string_view& type);
    bool _is_type( const std::string_view& type, impl::abi_traverse_context& ctx )const;
@@ -398,7 +513,7 @@ namespace impl {
          mvo("authorization", act.authorization);
 
          try {
-            auto abi = resolver(act.account);
+            const auto& abi = resolver(act.account);
             if (abi.valid()) {
                auto type = abi->get_action_type(act.name);
                if (!type.empty()) {
@@ -648,7 +763,7 @@ namespace impl {
                from_variant(data, act.data);
                valid_empty_data = act.data.empty();
             } else if ( data.is_object() ) {
-               auto abi = resolver(act.account);
+               const auto& abi = resolver(act.account);
                if (abi.valid()) {
                   auto type = abi->get_action_type(act.name);
                   if (!type.empty()) {
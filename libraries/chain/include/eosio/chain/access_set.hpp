@@ -0,0 +1,47 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Contract table rows touched by one table during a transaction, identified by primary key.
+    *
+    * Lookups that depend on rows other than the ones returned (bounds, iteration, end, secondary index
+    * lookups, and lookups in a table that does not exist yet) mark the table `scanned`: any write to the
+    * table by another transaction may change their result.
+    */
+   struct table_access {
+      account_name        code;
+      scope_name          scope;
+      table_name          table;
+      bool                scanned = false;
+      flat_set<uint64_t>  reads;  ///< primary keys looked up, found or not; irrelevant once scanned
+      flat_set<uint64_t>  writes; ///< primary keys stored, updated or removed through any index
+   };
+
+   /**
+    * Read and write set of a transaction over contract tables, recorded by apply_context when the controller is
+    * configured to track access sets. Writes of a transaction that later failed are still listed.
+    *
+    * Only contract tables are covered; native tables (accounts, permissions, resource usage) are not recorded.
+    */
+   struct access_set {
+      vector<table_access>   tables; ///< ordered by code, scope, table
+
+      void read( account_name code, scope_name scope, table_name table, uint64_t primary );
+      void write( account_name code, scope_name scope, table_name table, uint64_t primary );
+      void scan( account_name code, scope_name scope, table_name table );
+
+      /// true when either set writes a row the other reads or writes, or writes to a table the other scanned
+      bool conflicts_with( const access_set& other )const;
+
+   private:
+      table_access& find_or_add( account_name code, scope_name scope, table_name table );
+
+      size_t last = 0; ///< consecutive accesses are usually to the same table
+   };
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::table_access, (code)(scope)(table)(scanned)(reads)(writes) )
+FC_REFLECT( eosio::chain::access_set, (tables) )
@@ -0,0 +1,153 @@
+#pragma once
+
+#include <eosio/chain/action.hpp>
+#include <eosio/chain/types.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Set of receiver:action:actor filter entries, where an empty name in an entry matches any value, compiled for
+    * evaluation once per action trace. Entries are kept in an open addressing hash table and only the wildcard
+    * patterns that some entry actually uses are probed, so a lookup costs at most a handful of probes regardless of
+    * the number of entries.
+    */
+   class action_filter {
+   public:
+      struct entry {
+         name receiver;
+         name action;
+         name actor;
+      };
+
+      void add( const entry& e ) {
+         if( !e.receiver.to_uint64_t() && !e.action.to_uint64_t() && !e.actor.to_uint64_t() ) {
+            _match_all = true;
+            return;
+         }
+         const key k{ e.receiver.to_uint64_t(), e.action.to_uint64_t(), e.actor.to_uint64_t() };
+         if( (_size + 1) * 2 > _slots.size() )
+            grow();
+         if( insert( k ) ) {
+            ++_size;
+            _patterns |= 1u << pattern_of( k );
+         }
+      }
+
+      bool empty()const { return !_match_all && _size == 0; }
+
+      /// true if an entry matches receiver, action and actor; an empty actor only matches entries without an actor
+      bool match( name receiver, name action, name actor )const {
+         if( _match_all )
+            return true;
+         // without an actor only the even patterns, which leave the actor out, apply
+         const uint32_t patterns = _patterns & usable_patterns( receiver, action ) & (actor.to_uint64_t() ? 0xff : 0x55);
+         for( uint32_t p = 0; p < 8; ++p ) {
+            if( (patterns & (1u << p)) && find( mask( p, receiver.to_uint64_t(), action.to_uint64_t(), actor.to_uint64_t() ) ) )
+               return true;
+         }
+         return false;
+      }
+
+      /// true if an entry without an actor matches receiver:action or one with an actor names one of the authorizers
+      bool match( name receiver, name action, const vector<permission_level>& authorization )const {
+         if( _match_all )
+            return true;
+         const uint32_t patterns = _patterns & usable_patterns( receiver, action );
+         for( uint32_t p = 0; p < 8; ++p ) {
+            if( !(patterns & (1u << p)) )
+               continue;
+            if( (p & actor_bit) == 0 ) {
+               if( find( mask( p, receiver.to_uint64_t(), action.to_uint64_t(), 0 ) ) )
+                  return true;
+            } else {
+               for( const auto& a : authorization ) {
+                  if( find( mask( p, receiver.to_uint64_t(), action.to_uint64_t(), a.actor.to_uint64_t() ) ) )
+                     return true;
+               }
+            }
+         }
+         return false;
+      }
+
+   private:
+      struct key {
+         uint64_t receiver = 0;
+         uint64_t action   = 0;
+         uint64_t actor    = 0;
+
+         bool unused()const { return !receiver && !action && !actor; }
+         friend bool operator==( const key& a, const key& b ) {
+            return a.receiver == b.receiver && a.action == b.action && a.actor == b.actor;
+         }
+      };
+
+      static constexpr uint32_t receiver_bit = 4;
+      static constexpr uint32_t action_bit   = 2;
+      static constexpr uint32_t actor_bit    = 1;
+
+      static uint32_t pattern_of( const key& k ) {
+         return (k.receiver ? receiver_bit : 0) | (k.action ? action_bit : 0) | (k.actor ? actor_bit : 0);
+      }
+
+      // patterns that can be probed for receiver and action; a pattern naming an empty value would alias another
+      static uint32_t usable_patterns( name receiver, name action ) {
+         uint32_t patterns = 0xff;
+         if( !receiver.to_uint64_t() )
+            patterns &= 0x0f; // patterns 0-3 leave the receiver out
+         if( !action.to_uint64_t() )
+            patterns &= 0x33; // patterns 0, 1, 4 and 5 leave the action out
+         return patterns;
+      }
+
+      static key mask( uint32_t pattern, uint64_t receiver, uint64_t action, uint64_t actor ) {
+         return key{ pattern & receiver_bit ? receiver : 0, pattern & action_bit ? action : 0, pattern & actor_bit ? actor : 0 };
+      }
+
+      static uint64_t hash( const key& k ) {
+         uint64_t h = k.receiver * 0x9e3779b97f4a7c15ull;
+         h = (h ^ (h >> 32) ^ k.action) * 0xbf58476d1ce4e5b9ull;
+         h = (h ^ (h >> 32) ^ k.actor) * 0x94d049bb133111ebull;
+         return h ^ (h >> 31);
+      }
+
+      bool find( const key& k )const {
+         if( _slots.empty() )
+            return false;
+         const size_t mask = _slots.size() - 1;
+         for( size_t i = hash( k ) & mask; ; i = (i + 1) & mask ) {
+            if( _slots[i].unused() )
+               return false;
+            if( _slots[i] == k )
+               return true;
+         }
+      }
+
+      // returns false if k was already present; the table must have a free slot
+      bool insert( const key& k ) {
+         const size_t mask = _slots.size() - 1;
+         for( size_t i = hash( k ) & mask; ; i = (i + 1) & mask ) {
+            if( _slots[i].unused() ) {
+               _slots[i] = k;
+               return true;
+            }
+            if( _slots[i] == k )
+               return false;
+         }
+      }
+
+      void grow() {
+         std::vector<key> old( std::max<size_t>( 16, _slots.size() * 2 ) );
+         old.swap( _slots );
+         for( const auto& k : old ) {
+            if( !k.unused() )
+               insert( k );
+         }
+      }
+
+      std::vector<key> _slots;
+      size_t           _size      = 0;
+      uint32_t         _patterns  = 0; ///< bit p is set when some entry has wildcard pattern p
+      bool             _match_all = false;
+   };
+
+} } // eosio::chain
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <eosio/chain/block.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Offline index of the actions of irreversible blocks by account: an action_index_header followed by
+    * action_index_entry records sorted by (account, block_num, trx_index, action_ordinal). An action is indexed under
+    * the account it is sent to and under each of its authorizers. Only the actions signed into transactions are in
+    * blocks.log; inline actions and notifications exist only in traces and are not indexed.
+    */
+   struct action_index_header {
+      uint32_t magic = 0x78646961; // "aidx"
+      uint32_t version = 1;
+      uint32_t first_block = 0;
+      uint32_t last_block = 0;
+      uint64_t entries = 0;
+   };
+
+   struct action_index_entry {
+      uint64_t account = 0;
+      uint32_t block_num = 0;
+      uint32_t trx_index = 0;      ///< position of the transaction receipt in the block
+      uint32_t action_ordinal = 0; ///< 1 based with context free actions first, the action_ordinal of state history traces
+      uint32_t reserved = 0;
+
+      friend bool operator<(const action_index_entry& a, const action_index_entry& b) {
+         return std::tie(a.account, a.block_num, a.trx_index, a.action_ordinal) <
+                std::tie(b.account, b.block_num, b.trx_index, b.action_ordinal);
+      }
+   };
+
+   static_assert(sizeof(action_index_header) == 24 && sizeof(action_index_entry) == 24, "index records are written as is");
+
+   /// appends the entries of the actions of the executed transactions of block
+   void append_action_entries(const signed_block& block, std::vector<action_index_entry>& entries);
+
+   /**
+    * Writes the index of the actions of blocks first to last of the block log in blocks_dir to out_file. The range
+    * is clipped to the blocks of the log. Each of the threads workers spills its entries into sorted runs next to
+    * out_file, which are merged into out_file and removed.
+    * @return the header written
+    */
+   action_index_header make_action_index(const fc::path& blocks_dir, const fc::path& out_file,
+                                         uint32_t first, uint32_t last, uint32_t threads);
+
+} } /// eosio::chain
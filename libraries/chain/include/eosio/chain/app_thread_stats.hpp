@@ -0,0 +1,101 @@
+#pragma once
+
+#include <fc/time.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Counts of the work one origin posts to the application thread at one priority: how much is waiting, how long it
+    * waited from being posted to starting and how long it then held the thread. Updates are relaxed atomic adds, so
+    * posting from any thread costs no lock. An origin carrying a block adds to app_thread_stats::blocks_pending()
+    * while it waits and sets app_thread_stats::last_block_started() when it starts, which is what
+    * app_thread_post_read sheds reads against.
+    */
+   class app_thread_origin {
+   public:
+      /// inclusive upper bounds of the wait buckets, one more bucket counts the longer waits
+      static constexpr std::array<uint32_t, 8> wait_bounds_us = { 100, 1000, 5000, 20000, 100000, 500000, 2000000, 10000000 };
+
+      struct stats {
+         std::string           name;
+         int                   priority = 0;
+         uint64_t              posted = 0;
+         uint64_t              ran = 0;
+         uint64_t              shed = 0;
+         uint64_t              queued = 0;       ///< posted and neither run nor shed yet
+         uint64_t              wait_us = 0;      ///< sum over the work run or shed
+         uint64_t              max_wait_us = 0;
+         uint64_t              run_us = 0;       ///< sum of the time the work held the thread
+         std::vector<uint64_t> wait_buckets;     ///< wait_bounds_us.size() + 1 counts, not cumulative
+      };
+
+      app_thread_origin( std::string name, int priority, bool carries_block );
+
+      const std::string& name()const { return _name; }
+      int                priority()const { return _priority; }
+
+      void posted();
+      /// the work is starting after waiting since it was posted
+      void started( fc::microseconds waited );
+      /// the work held the thread this long
+      void finished( fc::microseconds ran );
+      /// the work was dropped instead of run after waiting since it was posted
+      void shed( fc::microseconds waited );
+
+      stats get_stats()const;
+
+   private:
+      void dequeued( fc::microseconds waited );
+
+      const std::string                                      _name;
+      const int                                              _priority;
+      const bool                                             _carries_block;
+      std::atomic<uint64_t>                                  _posted{0};
+      std::atomic<uint64_t>                                  _ran{0};
+      std::atomic<uint64_t>                                  _shed{0};
+      std::atomic<uint64_t>                                  _wait_us{0};
+      std::atomic<uint64_t>                                  _max_wait_us{0};
+      std::atomic<uint64_t>                                  _run_us{0};
+      std::array<std::atomic<uint64_t>, wait_bounds_us.size() + 1> _wait_buckets{};
+   };
+
+   /// the process wide registry of app_thread_origin
+   class app_thread_stats {
+   public:
+      /// the origin of that name and priority, created on first use; it lives as long as the process
+      static app_thread_origin& origin( const std::string& name, int priority, bool carries_block = false );
+
+      /// every origin, in the order they were created
+      static std::vector<app_thread_origin::stats> all();
+
+      /// blocks posted to the application thread that have not started yet
+      static uint64_t blocks_pending() { return _blocks_pending.load( std::memory_order_relaxed ); }
+
+      /// when a block last started on the application thread
+      static fc::time_point last_block_started() {
+         return fc::time_point( fc::microseconds( _last_block_started_us.load( std::memory_order_relaxed ) ) );
+      }
+
+      /**
+       * whether a read queued at queued and starting at start is dropped: past a non-zero deadline while a block is
+       * waiting, or once a block took the thread since the read was queued. Reads are posted below the priority of
+       * blocks, so the blocks that arrived while a read waited have usually run by the time it is dequeued.
+       */
+      static bool should_shed( fc::time_point queued, fc::time_point start, fc::microseconds deadline ) {
+         return deadline.count() > 0 && start - queued > deadline
+                && ( blocks_pending() > 0 || last_block_started() >= queued );
+      }
+
+   private:
+      friend class app_thread_origin;
+      static std::atomic<uint64_t> _blocks_pending;
+      static std::atomic<int64_t>  _last_block_started_us;
+   };
+
+} } // eosio::chain
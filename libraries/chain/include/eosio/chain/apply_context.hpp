@@ -2,10 +2,14 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/access_set.hpp>
+#include <eosio/chain/cpu_breakdown.hpp>
 #include <fc/utility.hpp>
+#include <boost/container/pmr/vector.hpp>
 #include <sstream>
 #include <algorithm>
 #include <set>
+#include <unordered_set>
 
 namespace chainbase { class database; }
 
@@ -19,33 +23,35 @@ class apply_context {
       template<typename T>
       class iterator_cache {
          public:
-            iterator_cache(){
-               _end_iterator_to_table.reserve(8);
-               _iterator_to_object.reserve(32);
-            }
+            /// @param mr all bookkeeping is allocated from mr, normally the arena of the transaction
+            explicit iterator_cache( boost::container::pmr::memory_resource* mr )
+            :_table_cache(mr)
+            ,_end_iterator_to_table(mr)
+            ,_iterator_to_object(mr)
+            ,_object_to_iterator(mr)
+            {}
 
             /// Returns end iterator of the table.
             int cache_table( const table_id_object& tobj ) {
-               auto itr = _table_cache.find(tobj.id);
-               if( itr != _table_cache.end() )
-                  return itr->second.second;
+               if( const auto* e = find_cached_table( tobj.id ) )
+                  return e->end_iterator;
 
                auto ei = index_to_end_iterator(_end_iterator_to_table.size());
                _end_iterator_to_table.push_back( &tobj );
-               _table_cache.emplace( tobj.id, make_pair(&tobj, ei) );
+               _table_cache.push_back( cached_table{ tobj.id, &tobj, ei } );
                return ei;
             }
 
             const table_id_object& get_table( table_id_object::id_type i )const {
-               auto itr = _table_cache.find(i);
-               EOS_ASSERT( itr != _table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
-               return *itr->second.first;
+               const auto* e = find_cached_table( i );
+               EOS_ASSERT( e, table_not_in_cache, "an invariant was broken, table should be in cache" );
+               return *e->table;
             }
 
             int get_end_iterator_by_table_id( table_id_object::id_type i )const {
-               auto itr = _table_cache.find(i);
-               EOS_ASSERT( itr != _table_cache.end(), table_not_in_cache, "an invariant was broken, table should be in cache" );
-               return itr->second.second;
+               const auto* e = find_cached_table( i );
+               EOS_ASSERT( e, table_not_in_cache, "an invariant was broken, table should be in cache" );
+               return e->end_iterator;
             }
 
             const table_id_object* find_table_by_end_iterator( int ei )const {
@@ -72,25 +78,77 @@ class apply_context {
                auto obj_ptr = _iterator_to_object[iterator];
                if( !obj_ptr ) return;
                _iterator_to_object[iterator] = nullptr;
-               _object_to_iterator.erase( obj_ptr );
+               // keep the key so probe sequences stay intact, a negative iterator marks the slot as erased
+               find_slot( obj_ptr ).iterator = -1;
             }
 
             int add( const T& obj ) {
-               auto itr = _object_to_iterator.find( &obj );
-               if( itr != _object_to_iterator.end() )
-                    return itr->second;
+               if( _used_slots * 2 >= _object_to_iterator.size() )
+                  grow_slots();
+
+               auto& slot = find_slot( &obj );
+               if( slot.obj == &obj && slot.iterator >= 0 )
+                  return slot.iterator;
 
+               if( slot.obj == nullptr ) {
+                  slot.obj = &obj;
+                  ++_used_slots;
+               }
                _iterator_to_object.push_back( &obj );
-               _object_to_iterator[&obj] = _iterator_to_object.size() - 1;
+               slot.iterator = _iterator_to_object.size() - 1;
 
-               return _iterator_to_object.size() - 1;
+               return slot.iterator;
             }
 
          private:
-            map<table_id_object::id_type, pair<const table_id_object*, int>> _table_cache;
-            vector<const table_id_object*>                  _end_iterator_to_table;
-            vector<const T*>                                _iterator_to_object;
-            map<const T*,int>                               _object_to_iterator;
+            struct cached_table {
+               table_id_object::id_type   id;
+               const table_id_object*     table;
+               int                        end_iterator;
+            };
+
+            /// open addressing (linear probing) slot of the object to iterator map
+            struct object_slot {
+               const T* obj      = nullptr;
+               int      iterator = -1;
+            };
+
+            /// actions rarely touch more than a handful of tables, a packed linear scan beats any tree or hash lookup
+            boost::container::pmr::vector<cached_table>              _table_cache;
+            boost::container::pmr::vector<const table_id_object*>    _end_iterator_to_table;
+            boost::container::pmr::vector<const T*>                  _iterator_to_object;
+            boost::container::pmr::vector<object_slot>               _object_to_iterator; ///< size is zero or a power of 2
+            size_t                                                   _used_slots = 0;
+
+            const cached_table* find_cached_table( table_id_object::id_type i )const {
+               for( const auto& e : _table_cache ) {
+                  if( e.id == i ) return &e;
+               }
+               return nullptr;
+            }
+
+            /// Precondition: _object_to_iterator is not full
+            /// @return the slot holding obj or the empty slot where it belongs
+            object_slot& find_slot( const T* obj ) {
+               const size_t mask = _object_to_iterator.size() - 1;
+               // objects are at least 16 byte aligned, fibonacci hashing spreads the remaining bits
+               size_t i = ((reinterpret_cast<uintptr_t>(obj) >> 4) * 0x9E3779B97F4A7C15ull) & mask;
+               while( _object_to_iterator[i].obj != nullptr && _object_to_iterator[i].obj != obj )
+                  i = (i + 1) & mask;
+               return _object_to_iterator[i];
+            }
+
+            void grow_slots() {
+               boost::container::pmr::vector<object_slot> old( _object_to_iterator.get_allocator() );
+               old.swap( _object_to_iterator );
+               _object_to_iterator.resize( std::max<size_t>( 32, old.size() * 2 ) );
+               _used_slots = 0;
+               for( const auto& s : old ) {
+                  if( s.obj == nullptr || s.iterator < 0 ) continue; // erased entries are dropped
+                  find_slot( s.obj ) = s;
+                  ++_used_slots;
+               }
+            }
 
             /// Precondition: std::numeric_limits<int>::min() < ei < -1
             /// Iterator of -1 is reserved for invalid iterators (i.e. when the appropriate table has not yet been created).
@@ -171,7 +229,7 @@ class apply_context {
 
             using secondary_key_helper_t = secondary_key_helper<secondary_key_type, secondary_key_proxy_type, secondary_key_proxy_const_type>;
 
-            generic_index( apply_context& c ):context(c){}
+            generic_index( apply_context& c ):context(c),itr_cache(c.arena()){}
 
             int store( uint64_t scope, uint64_t table, const account_name& payer,
                        uint64_t id, secondary_key_proxy_const_type value )
@@ -194,6 +252,7 @@ class apply_context {
                });
 
                context.update_db_usage( payer, config::billable_size_v<ObjectType> );
+               context.record_write( tab, id );
 
                itr_cache.cache_table( tab );
                return itr_cache.add( obj );
@@ -208,6 +267,7 @@ class apply_context {
 
 //               context.require_write_lock( table_obj.scope );
 
+               context.record_write( table_obj, obj.primary_key );
                context.db.modify( table_obj, [&]( auto& t ) {
                   --t.count;
                });
@@ -237,6 +297,7 @@ class apply_context {
                   context.update_db_usage( payer, +(billing_size) );
                }
 
+               context.record_write( table_obj, obj.primary_key );
                context.db.modify( obj, [&]( auto& o ) {
                  secondary_key_helper_t::set(o.secondary_key, secondary);
                  o.payer = payer;
@@ -245,6 +306,7 @@ class apply_context {
 
             int find_secondary( uint64_t code, uint64_t scope, uint64_t table, secondary_key_proxy_const_type secondary, uint64_t& primary ) {
                auto tab = context.find_table( name(code), name(scope), name(table) );
+               context.record_scan( name(code), name(scope), name(table) );
                if( !tab ) return -1;
 
                auto table_end_itr = itr_cache.cache_table( *tab );
@@ -259,6 +321,7 @@ class apply_context {
 
             int lowerbound_secondary( uint64_t code, uint64_t scope, uint64_t table, secondary_key_proxy_type secondary, uint64_t& primary ) {
                auto tab = context.find_table( name(code), name(scope), name(table) );
+               context.record_scan( name(code), name(scope), name(table) );
                if( !tab ) return -1;
 
                auto table_end_itr = itr_cache.cache_table( *tab );
@@ -276,6 +339,7 @@ class apply_context {
 
             int upperbound_secondary( uint64_t code, uint64_t scope, uint64_t table, secondary_key_proxy_type secondary, uint64_t& primary ) {
                auto tab = context.find_table( name(code), name(scope), name(table) );
+               context.record_scan( name(code), name(scope), name(table) );
                if( !tab ) return -1;
 
                auto table_end_itr = itr_cache.cache_table( *tab );
@@ -293,6 +357,7 @@ class apply_context {
 
             int end_secondary( uint64_t code, uint64_t scope, uint64_t table ) {
                auto tab = context.find_table( name(code), name(scope), name(table) );
+               context.record_scan( name(code), name(scope), name(table) );
                if( !tab ) return -1;
 
                return itr_cache.cache_table( *tab );
@@ -302,6 +367,7 @@ class apply_context {
                if( iterator < -1 ) return -1; // cannot increment past end iterator of index
 
                const auto& obj = itr_cache.get(iterator); // Check for iterator != -1 happens in this call
+               context.record_scan( itr_cache.get_table( obj.t_id ) );
                const auto& idx = context.db.get_index<typename chainbase::get_index_type<ObjectType>::type, by_secondary>();
 
                auto itr = idx.iterator_to(obj);
@@ -320,6 +386,7 @@ class apply_context {
                {
                   auto tab = itr_cache.find_table_by_end_iterator(iterator);
                   EOS_ASSERT( tab, invalid_table_iterator, "not a valid end iterator" );
+                  context.record_scan( *tab );
 
                   auto itr = idx.upper_bound(tab->id);
                   if( idx.begin() == idx.end() || itr == idx.begin() ) return -1; // Empty index
@@ -333,6 +400,7 @@ class apply_context {
                }
 
                const auto& obj = itr_cache.get(iterator); // Check for iterator != -1 happens in this call
+               context.record_scan( itr_cache.get_table( obj.t_id ) );
 
                auto itr = idx.iterator_to(obj);
                if( itr == idx.begin() ) return -1; // cannot decrement past beginning iterator of index
@@ -347,7 +415,11 @@ class apply_context {
 
             int find_primary( uint64_t code, uint64_t scope, uint64_t table, secondary_key_proxy_type secondary, uint64_t primary ) {
                auto tab = context.find_table( name(code), name(scope), name(table) );
-               if( !tab ) return -1;
+               if( !tab ) {
+                  context.record_scan( name(code), name(scope), name(table) );
+                  return -1;
+               }
+               context.record_read( *tab, primary );
 
                auto table_end_itr = itr_cache.cache_table( *tab );
 
@@ -360,6 +432,7 @@ class apply_context {
 
             int lowerbound_primary( uint64_t code, uint64_t scope, uint64_t table, uint64_t primary ) {
                auto tab = context.find_table( name(code), name(scope), name(table) );
+               context.record_scan( name(code), name(scope), name(table) );
                if (!tab) return -1;
 
                auto table_end_itr = itr_cache.cache_table( *tab );
@@ -374,6 +447,7 @@ class apply_context {
 
             int upperbound_primary( uint64_t code, uint64_t scope, uint64_t table, uint64_t primary ) {
                auto tab = context.find_table( name(code), name(scope), name(table) );
+               context.record_scan( name(code), name(scope), name(table) );
                if ( !tab ) return -1;
 
                auto table_end_itr = itr_cache.cache_table( *tab );
@@ -391,6 +465,7 @@ class apply_context {
                if( iterator < -1 ) return -1; // cannot increment past end iterator of table
 
                const auto& obj = itr_cache.get(iterator); // Check for iterator != -1 happens in this call
+               context.record_scan( itr_cache.get_table( obj.t_id ) );
                const auto& idx = context.db.get_index<typename chainbase::get_index_type<ObjectType>::type, by_primary>();
 
                auto itr = idx.iterator_to(obj);
@@ -409,6 +484,7 @@ class apply_context {
                {
                   auto tab = itr_cache.find_table_by_end_iterator(iterator);
                   EOS_ASSERT( tab, invalid_table_iterator, "not a valid end iterator" );
+                  context.record_scan( *tab );
 
                   auto itr = idx.upper_bound(tab->id);
                   if( idx.begin() == idx.end() || itr == idx.begin() ) return -1; // Empty table
@@ -422,6 +498,7 @@ class apply_context {
                }
 
                const auto& obj = itr_cache.get(iterator); // Check for iterator != -1 happens in this call
+               context.record_scan( itr_cache.get_table( obj.t_id ) );
 
                auto itr = idx.iterator_to(obj);
                if( itr == idx.begin() ) return -1; // cannot decrement past beginning iterator of table
@@ -521,6 +598,18 @@ class apply_context {
       int  db_upperbound_i64( name code, name scope, name table, uint64_t id );
       int  db_end_i64( name code, name scope, name table );
 
+      /**
+       * Copy up to max_rows consecutive rows of a table, starting at iterator, into buffer. Each row is written as
+       * its primary key (8 bytes), value size (4 bytes) and value. Stops early before a row that does not fit.
+       * @return iterator of the first row not copied, the end iterator of the table if all remaining rows were copied
+       */
+      int  db_get_i64_batch( int iterator, uint32_t max_rows, char* buffer, size_t buffer_size, uint32_t& rows_read );
+      /**
+       * Store every row of buffer, laid out as for db_get_i64_batch, into the table of the receiver.
+       * @return number of rows stored
+       */
+      int  db_store_i64_batch( name scope, name table, const account_name& payer, const char* buffer, size_t buffer_size );
+
    private:
 
       const table_id_object* find_table( name code, name scope, name table );
@@ -529,6 +618,23 @@ class apply_context {
 
       int  db_store_i64( name code, name scope, name table, const account_name& payer, uint64_t id, const char* buffer, size_t buffer_size );
 
+      /// access_set recording, no-ops unless the controller tracks access sets; also feeds sampled table access counts
+      void record_read( const table_id_object& t, uint64_t primary ) {
+         if( accesses ) accesses->read( t.code, t.scope, t.table, primary );
+         if( sample_table_accesses ) control.record_table_access( t.code, t.table, false );
+      }
+      void record_write( const table_id_object& t, uint64_t primary ) {
+         if( accesses ) accesses->write( t.code, t.scope, t.table, primary );
+         if( sample_table_accesses ) control.record_table_access( t.code, t.table, true );
+      }
+      void record_scan( name code, name scope, name table ) {
+         if( accesses ) accesses->scan( code, scope, table );
+         if( sample_table_accesses ) control.record_table_access( code, table, false );
+      }
+      void record_scan( const table_id_object& t ) {
+         record_scan( t.code, t.scope, t.table );
+      }
+
 
    /// Misc methods:
    public:
@@ -553,12 +659,19 @@ class apply_context {
 
       action_name get_sender() const;
 
+      /// memory resource for bookkeeping that does not outlive the transaction
+      boost::container::pmr::memory_resource* arena()const;
+
+      /// cpu breakdown of the executing action, null unless the transaction trace records cpu breakdowns
+      action_cpu_breakdown* cpu_breakdown() { return _cpu_breakdown ? &*_cpu_breakdown : nullptr; }
+
    /// Fields:
    public:
 
       controller&                   control;
       chainbase::database&          db;  ///< database where state is stored
       transaction_context&          trx_context; ///< transaction context in which the action is running
+      uint64_t                      host_calls = 0; ///< intrinsic calls made by this context, sampled for profiled accounts
 
    private:
       const action*                 act = nullptr; ///< action being applied
@@ -569,6 +682,9 @@ class apply_context {
       uint32_t                      action_ordinal = 0;
       bool                          privileged   = false;
       bool                          context_free = false;
+      access_set*                   accesses = nullptr; ///< in the transaction trace, set when access sets are tracked
+      bool                          sample_table_accesses = false; ///< controller counts sampled table accesses
+      fc::optional<action_cpu_breakdown> _cpu_breakdown; ///< of the executing action, moved to its trace by finalize_trace
 
    public:
       generic_index<index64_object>                                  idx64;
@@ -580,9 +696,11 @@ class apply_context {
    private:
 
       iterator_cache<key_value_object>    keyval_cache;
-      vector< std::pair<account_name, uint32_t> > _notified; ///< keeps track of new accounts to be notifed of current message
-      vector<uint32_t>                    _inline_actions; ///< action_ordinals of queued inline actions
-      vector<uint32_t>                    _cfa_inline_actions; ///< action_ordinals of queued inline context-free actions
+      boost::container::pmr::vector< std::pair<account_name, uint32_t> > _notified; ///< keeps track of new accounts to be notifed of current message
+      static constexpr size_t             max_scanned_recipients = 16;
+      std::unordered_set<account_name>    _notified_index; ///< the accounts of _notified, once there are more than max_scanned_recipients
+      boost::container::pmr::vector<uint32_t> _inline_actions; ///< action_ordinals of queued inline actions
+      boost::container::pmr::vector<uint32_t> _cfa_inline_actions; ///< action_ordinals of queued inline context-free actions
       std::string                         _pending_console_output;
       flat_set<account_delta>             _account_ram_deltas; ///< flat_set of account_delta so json is an array of objects
 
@@ -3,13 +3,12 @@
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/exceptions.hpp>
-#include <eosio/chain/parallel_markers.hpp>
 
 #include <fc/scoped_exit.hpp>
 
-#include <boost/range/algorithm/find.hpp>
-#include <boost/algorithm/cxx11/all_of.hpp>
+#include <boost/container/small_vector.hpp>
 
+#include <cstring>
 #include <functional>
 
 namespace eosio { namespace chain {
@@ -19,6 +18,35 @@ namespace detail {
    using meta_permission_value = std::function<uint32_t()>;
    using meta_permission_map = boost::container::flat_multimap<meta_permission_key, meta_permission_value, std::greater<>>;
 
+   /**
+    * 64 bits of a key to compare before the key itself: bytes of the point of a k1 or r1 key past its parity prefix and
+    * the key type. Equal keys have equal fingerprints; webauthn keys fingerprint to their type only, as their data needs
+    * unpacking, and are always compared in full.
+    */
+   template<typename Shim>
+   inline uint64_t key_fingerprint( const Shim& k, int which ) {
+      uint64_t f = 0;
+      static_assert( sizeof(k._data) > sizeof(f), "key shorter than its fingerprint" );
+      std::memcpy( &f, k._data.begin() + 1, sizeof(f) );
+      return f ^ static_cast<uint64_t>( which );
+   }
+
+   inline uint64_t key_fingerprint( const public_key_type& k ) {
+      const int which = k._storage.which();
+      return k._storage.visit<uint64_t>( overloaded {
+         [&]( const fc::crypto::webauthn::public_key& ) { return static_cast<uint64_t>( which ); },
+         [&]( const auto& k1r1 ) { return key_fingerprint( k1r1, which ); }
+      } );
+   }
+
+   inline uint64_t key_fingerprint( const shared_public_key& k ) {
+      const int which = k.pubkey.which();
+      return k.pubkey.visit<uint64_t>( overloaded {
+         [&]( const shared_string& ) { return static_cast<uint64_t>( which ); },
+         [&]( const auto& k1r1 ) { return key_fingerprint( k1r1, which ); }
+      } );
+   }
+
 } /// namespace detail
 
    /**
@@ -36,9 +64,11 @@ namespace detail {
       private:
          PermissionToAuthorityFunc            permission_to_authority;
          const std::function<void()>&         checktime;
-         vector<public_key_type>              provided_keys; // Making this a flat_set<public_key_type> causes runtime problems with utilities::filter_data_by_marker for some reason. TODO: Figure out why.
+         vector<public_key_type>              provided_keys;
+         vector<uint64_t>                     provided_fingerprints; // detail::key_fingerprint of provided_keys, in order
          flat_set<permission_level>           provided_permissions;
-         vector<bool>                         _used_keys;
+         // one bit per provided key, inline for up to 128 keys as it is copied for every authority evaluated
+         boost::container::small_vector<uint64_t, 2> _used_keys;
          fc::microseconds                     provided_delay;
          uint16_t                             recursion_depth_limit;
 
@@ -54,11 +84,14 @@ namespace detail {
          ,checktime( checktime )
          ,provided_keys(provided_keys.begin(), provided_keys.end())
          ,provided_permissions(provided_permissions)
-         ,_used_keys(provided_keys.size(), false)
+         ,_used_keys((provided_keys.size() + 63) / 64, 0)
          ,provided_delay(provided_delay)
          ,recursion_depth_limit(recursion_depth_limit)
          {
             EOS_ASSERT( static_cast<bool>(checktime), authorization_exception, "checktime cannot be empty" );
+            provided_fingerprints.reserve( provided_keys.size() );
+            for( const auto& k : provided_keys )
+               provided_fingerprints.push_back( detail::key_fingerprint( k ) );
          }
 
          enum permission_cache_status {
@@ -118,17 +151,15 @@ namespace detail {
             return satisfied( authority, *cached_perms, 0 );
          }
 
-         bool all_keys_used() const { return boost::algorithm::all_of_equal(_used_keys, true); }
-
-         flat_set<public_key_type> used_keys() const {
-            auto range = filter_data_by_marker(provided_keys, _used_keys, true);
-            return {range.begin(), range.end()};
-         }
-         flat_set<public_key_type> unused_keys() const {
-            auto range = filter_data_by_marker(provided_keys, _used_keys, false);
-            return {range.begin(), range.end()};
+         bool all_keys_used() const {
+            for( size_t i = 0; i < provided_keys.size(); ++i )
+               if( !is_used( i ) ) return false;
+            return true;
          }
 
+         flat_set<public_key_type> used_keys() const { return keys_marked( true ); }
+         flat_set<public_key_type> unused_keys() const { return keys_marked( false ); }
+
          static optional<permission_cache_status>
          permission_status_in_cache( const permission_cache_type& permissions,
                                      const permission_level& level )
@@ -145,6 +176,29 @@ namespace detail {
          }
 
       private:
+         bool is_used( size_t i ) const { return ( _used_keys[i / 64] >> ( i % 64 ) ) & 1; }
+         void set_used( size_t i ) { _used_keys[i / 64] |= uint64_t(1) << ( i % 64 ); }
+
+         flat_set<public_key_type> keys_marked( bool used ) const {
+            flat_set<public_key_type> keys;
+            for( size_t i = 0; i < provided_keys.size(); ++i )
+               if( is_used( i ) == used )
+                  keys.insert( keys.end(), provided_keys[i] ); // provided_keys is sorted
+            return keys;
+         }
+
+         /// index of key in provided_keys, or provided_keys.size()
+         template<typename Key>
+         size_t find_provided_key( const Key& key ) const {
+            const uint64_t f = detail::key_fingerprint( key );
+            const size_t n = provided_fingerprints.size();
+            for( size_t i = 0; i < n; ++i ) {
+               if( provided_fingerprints[i] == f && provided_keys[i] == key )
+                  return i;
+            }
+            return n;
+         }
+
          permission_cache_type* initialize_permission_cache( permission_cache_type& cached_permissions ) {
             for( const auto& p : provided_permissions ) {
                cached_permissions.emplace_hint( cached_permissions.end(), p, permission_satisfied );
@@ -210,9 +264,9 @@ namespace detail {
 
             template<typename KeyWeight, typename = std::enable_if_t<detail::is_any_of_v<KeyWeight, shared_key_weight, key_weight>>>
             uint32_t operator()(const KeyWeight& permission) {
-               auto itr = boost::find( checker.provided_keys, permission.key );
-               if( itr != checker.provided_keys.end() ) {
-                  checker._used_keys[itr - checker.provided_keys.begin()] = true;
+               const auto i = checker.find_provided_key( permission.key );
+               if( i != checker.provided_keys.size() ) {
+                  checker.set_used( i );
                   total_weight += permission.weight;
                }
                return total_weight;
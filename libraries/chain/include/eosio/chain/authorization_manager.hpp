@@ -6,6 +6,8 @@
 
 #include <utility>
 #include <functional>
+#include <map>
+#include <tuple>
 
 namespace eosio { namespace chain {
 
@@ -73,6 +75,8 @@ namespace eosio { namespace chain {
           *  @param provided_delay - the delay satisfied by the transaction
           *  @param checktime - the function that can be called to track CPU usage and time during the process of checking authorization
           *  @param allow_unused_keys - true if method should not assert on unused keys
+          *  @param use_satisfied_cache - true to reuse and record permissions already satisfied by the same keys in this
+          *                               block; only valid for checks made before a transaction executes any action
           */
          void
          check_authorization( const vector<action>&                actions,
@@ -81,7 +85,8 @@ namespace eosio { namespace chain {
                               fc::microseconds                     provided_delay = fc::microseconds(0),
                               const std::function<void()>&         checktime = std::function<void()>(),
                               bool                                 allow_unused_keys = false,
-                              const flat_set<permission_level>&    satisfied_authorizations = flat_set<permission_level>()
+                              const flat_set<permission_level>&    satisfied_authorizations = flat_set<permission_level>(),
+                              bool                                 use_satisfied_cache = false
                             )const;
 
 
@@ -112,12 +117,20 @@ namespace eosio { namespace chain {
                                                     )const;
 
 
+         /// forget cached satisfied permissions; called whenever state may revert or permissions change
+         void clear_satisfied_cache()const { _satisfied_cache.clear(); }
+
          static std::function<void()> _noop_checktime;
 
       private:
          const controller&    _control;
          chainbase::database& _db;
 
+         /// (provided keys digest, permission, delay, max authority depth) -> keys used to satisfy the permission
+         using satisfied_cache_key = std::tuple<digest_type, permission_level, int64_t, uint16_t>;
+         static constexpr size_t max_satisfied_cache_size = 16*1024;
+         mutable std::map<satisfied_cache_key, flat_set<public_key_type>> _satisfied_cache;
+
          void             check_updateauth_authorization( const updateauth& update, const vector<permission_level>& auths )const;
          void             check_deleteauth_authorization( const deleteauth& del, const vector<permission_level>& auths )const;
          void             check_linkauth_authorization( const linkauth& link, const vector<permission_level>& auths )const;
@@ -7,6 +7,13 @@ namespace eosio { namespace chain {
 
    namespace detail { class block_log_impl; }
 
+   /// rolling of the block log into fixed size ranges, disabled while stride is 0
+   struct block_log_stride_config {
+      uint32_t   stride = 0;              ///< blocks per range, every range ends with a multiple of stride
+      uint32_t   max_retained_files = 0;  ///< ranges kept next to blocks.log, older ones are archived or removed; 0 keeps all
+      fc::path   archive_dir;             ///< where ranges past max_retained_files are moved, removed when empty
+   };
+
    /* The block log is an external append only log of the blocks with a header. Blocks should only
     * be written to the log after they irreverisble as the log is append only. The log is a doubly
     * linked list of blocks. There is a secondary index file of only block positions that enables
@@ -30,15 +37,34 @@ namespace eosio { namespace chain {
     *
     * The main file is the only file that needs to persist. The index file can be reconstructed during a
     * linear scan of the main file.
+    *
+    * Reads can optionally be served from a read-only memory mapping of both files instead of seeking through
+    * the cfile, and recently decoded blocks can be retained in a bounded, sharded LRU cache. Both are disabled
+    * by default.
+    *
+    * Blocks before the first block of the log are read from a block_log_archive in the same directory, if any.
+    *
+    * With a stride, the log is renamed to blocks-<first>-<last>.log/.index once its last block is a multiple of the
+    * stride, and a new log starting at the next block takes its place. Reads of earlier blocks map the range holding
+    * them on demand. Only max_retained_files ranges are kept, so pruning removes (or archives) whole files instead of
+    * rewriting the log with trim_blocklog_front.
     */
 
    class block_log {
       public:
-         block_log(const fc::path& data_dir);
+         /**
+          * @param mmap_reads  serve read_block/get_block_pos from a read-only mapping of blocks.log/blocks.index
+          * @param cache_size  number of decoded blocks retained for read_block_by_num, 0 disables the cache
+          * @param stride      rolling of the log into ranges
+          */
+         block_log(const fc::path& data_dir, bool mmap_reads = false, uint32_t cache_size = 0,
+                   const block_log_stride_config& stride = block_log_stride_config());
          block_log(block_log&& other);
          ~block_log();
 
          uint64_t append(const signed_block_ptr& b);
+         /// appends b from packed_block, which must be fc::raw::pack(*b), e.g. as held by the reversible block database
+         uint64_t append(const signed_block_ptr& b, const char* packed_block, size_t size);
          void flush();
          void reset( const genesis_state& gs, const signed_block_ptr& genesis_block );
          void reset( const chain_id_type& chain_id, uint32_t first_block_num );
@@ -47,6 +73,12 @@ namespace eosio { namespace chain {
          void             read_block_header(block_header& bh, uint64_t file_pos)const;
          signed_block_ptr read_block_by_num(uint32_t block_num)const;
          block_id_type    read_block_id_by_num(uint32_t block_num)const;
+         /**
+          * The packed block_num as stored in the log, which is its wire serialization, after prefix_size bytes left for
+          * the caller to fill in, e.g. a message header. Empty if the block is not in the log itself, i.e. it is in a
+          * range rolled off by the stride mode or in the archive.
+          */
+         std::vector<char> read_serialized_block_by_num(uint32_t block_num, size_t prefix_size = 0)const;
          signed_block_ptr read_block_by_id(const block_id_type& id)const {
             return read_block_by_num(block_header::num_from_id(id));
          }
@@ -58,6 +90,7 @@ namespace eosio { namespace chain {
          signed_block_ptr        read_head()const;
          const signed_block_ptr& head()const;
          const block_id_type&    head_id()const;
+         /// first block readable, the first of the oldest retained range in stride mode
          uint32_t                first_block_num() const;
 
          static const uint64_t npos = std::numeric_limits<uint64_t>::max();
@@ -71,6 +104,9 @@ namespace eosio { namespace chain {
 
          static chain_id_type extract_chain_id( const fc::path& data_dir );
 
+         /// chain id of the block log file block_file, e.g. a range rolled off in stride mode
+         static chain_id_type extract_chain_id_from_file( const fc::path& block_file );
+
          static void construct_index(const fc::path& block_file_name, const fc::path& index_file_name);
 
          static bool contains_genesis_state(uint32_t version, uint32_t first_block_num);
@@ -88,6 +124,91 @@ namespace eosio { namespace chain {
          std::unique_ptr<detail::block_log_impl> my;
    };
 
+   namespace detail { class block_log_prefetcher_impl; }
+
+   /**
+    * Reads the blocks [start_block_num, end_block_num] of the block log in data_dir, and of the ranges rolled off
+    * it, in order on a thread of its own and through file handles of its own, keeping up to read_ahead decoded blocks
+    * ahead of the consumer. The log must not be appended to while it is read.
+    */
+   class block_log_prefetcher {
+      public:
+         block_log_prefetcher(const fc::path& data_dir, uint32_t start_block_num, uint32_t end_block_num,
+                              uint32_t read_ahead);
+         ~block_log_prefetcher();
+
+         /// the next block in order, empty once end_block_num has been returned; rethrows a failure to read the log
+         signed_block_ptr next();
+
+      private:
+         std::unique_ptr<detail::block_log_prefetcher_impl> my;
+   };
+
+   namespace detail { class block_log_reader_impl; }
+
+   /**
+    * Read-only view of the block log in data_dir, and of the ranges rolled off it, that another process appends to,
+    * e.g. the primary of a state replica. It never writes to data_dir. The files are mapped as they were at the last
+    * refresh(), which must not race an append; blocks appended or rolled off since are read after the next one.
+    */
+   class block_log_reader {
+      public:
+         explicit block_log_reader(const fc::path& data_dir);
+         ~block_log_reader();
+
+         void             refresh();
+         /// empty if block_num was not in the log at the last refresh
+         signed_block_ptr read_block_by_num(uint32_t block_num)const;
+
+      private:
+         std::unique_ptr<detail::block_log_reader_impl> my;
+   };
+
+   namespace detail { class block_log_archive_impl; }
+
+   /**
+    * Read-only compressed archive of the blocks trimmed off the front of the block log, kept next to it as
+    * blocks.zlog and blocks.zindex. Runs of consecutive blocks are compressed together as independent frames, so
+    * reading a block decompresses only its frame; the most recently used frames are cached.
+    *
+    * +-------+---------+-----------------+----------+---------+---------+-----+
+    * | Magic | Version | First Block Num | Chain Id | Frame 1 | Frame 2 | ... |
+    * +-------+---------+-----------------+----------+---------+---------+-----+
+    *
+    * A frame is its compressed size and uncompressed size (uint32_t each) followed by the zlib compressed packed
+    * blocks. blocks.zindex holds, for every block, the position of its frame (uint64_t) and the offset of the block
+    * within the uncompressed frame (uint32_t).
+    *
+    * block_log serves read_block_by_num for the blocks before its first block from an archive in its directory.
+    */
+   class block_log_archive {
+      public:
+         explicit block_log_archive(const fc::path& block_dir, uint32_t frame_cache_size = default_frame_cache_size);
+         ~block_log_archive();
+
+         signed_block_ptr     read_block_by_num(uint32_t block_num)const;
+         uint32_t             first_block_num()const;
+         uint32_t             last_block_num()const;
+         const chain_id_type& chain_id()const;
+
+         static bool exists(const fc::path& block_dir);
+
+         /**
+          * Appends the blocks before truncate_at_block of blocks.log in block_dir to its archive, in frames of
+          * blocks_per_frame blocks, then removes them from blocks.log with block_log::trim_blocklog_front.
+          */
+         static bool archive_blocklog_front(const fc::path& block_dir, const fc::path& temp_dir, uint32_t truncate_at_block,
+                                            uint32_t blocks_per_frame = default_blocks_per_frame);
+
+         static const uint32_t magic_number = 0x676f6c7a; // "zlog"
+         static const uint32_t version = 1;
+         static const uint32_t default_blocks_per_frame = 64;
+         static const uint32_t default_frame_cache_size = 8;
+
+      private:
+         std::unique_ptr<detail::block_log_archive_impl> my;
+   };
+
 //to derive blknum_offset==14 see block_header.hpp and note on disk struct is packed
 //   block_timestamp_type timestamp;                  //bytes 0:3
 //   account_name         producer;                   //bytes 4:11
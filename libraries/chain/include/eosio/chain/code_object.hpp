@@ -1,11 +1,29 @@
 #pragma once
 #include <eosio/chain/database_utils.hpp>
+#include <eosio/chain/snapshot.hpp>
 #include <boost/tuple/tuple_io.hpp>
 
 #include "multi_index_includes.hpp"
 
+#include <string_view>
+
 namespace eosio { namespace chain {
 
+   /**
+    * Contract code may be kept compressed in chainbase, as configured by controller::config::compress_contract_code.
+    * Compressed code starts with "\0eoz" where wasm starts with "\0asm", then the size of the wasm as a little endian
+    * uint32 and the zlib stream of it, so both forms can be told apart and read back whatever the node was configured
+    * with when the code was stored.
+    */
+   namespace code_compression {
+      bool        is_compressed( const char* data, size_t size );
+      /// the size of the wasm the stored code holds
+      size_t      uncompressed_size( const char* data, size_t size );
+      /// the compressed form of wasm, or an empty string when it would not be smaller
+      std::string compress( const char* wasm, size_t size );
+      std::string decompress( const char* data, size_t size );
+   }
+
    class code_object : public chainbase::object<code_object_type, code_object> {
       OBJECT_CTOR(code_object, (code))
 
@@ -16,6 +34,18 @@ namespace eosio { namespace chain {
       uint32_t     first_block_used;
       uint8_t      vm_type = 0; //< vm_type should not be changed within a chainbase modifier lambda
       uint8_t      vm_version = 0; //< vm_version should not be changed within a chainbase modifier lambda
+
+      /// size of the wasm, which may be more than code holds when it is compressed
+      size_t code_size()const { return code_compression::uncompressed_size( code.data(), code.size() ); }
+
+      /// calls f with a std::string_view of the wasm, decompressing it first if it is stored compressed
+      template<typename F>
+      auto with_code( F&& f )const {
+         if( !code_compression::is_compressed( code.data(), code.size() ) )
+            return f( std::string_view( code.data(), code.size() ) );
+         const std::string wasm = code_compression::decompress( code.data(), code.size() );
+         return f( std::string_view( wasm ) );
+      }
    };
 
    struct by_code_hash;
@@ -33,8 +63,42 @@ namespace eosio { namespace chain {
       >
    >;
 
+   /// snapshots hold contract code uncompressed, so they and their integrity hash do not depend on how a node stores it
+   struct snapshot_code_object {
+      digest_type  code_hash;
+      fc::blob     code;
+      uint64_t     code_ref_count;
+      uint32_t     first_block_used;
+      uint8_t      vm_type = 0;
+      uint8_t      vm_version = 0;
+   };
+
+   namespace detail {
+      template<>
+      struct snapshot_row_traits<code_object> {
+         using value_type = code_object;
+         using snapshot_type = snapshot_code_object;
+
+         static snapshot_code_object to_snapshot_row( const code_object& value, const chainbase::database& ) {
+            snapshot_code_object row{value.code_hash, {}, value.code_ref_count, value.first_block_used, value.vm_type, value.vm_version};
+            value.with_code( [&]( std::string_view wasm ) { row.code.data.assign( wasm.begin(), wasm.end() ); } );
+            return row;
+         }
+
+         static void from_snapshot_row( snapshot_code_object&& row, code_object& value, chainbase::database& ) {
+            value.code_hash = row.code_hash;
+            value.code.assign( row.code.data.data(), row.code.data.size() );
+            value.code_ref_count = row.code_ref_count;
+            value.first_block_used = row.first_block_used;
+            value.vm_type = row.vm_type;
+            value.vm_version = row.vm_version;
+         }
+      };
+   }
+
 } } // eosio::chain
 
 CHAINBASE_SET_INDEX_TYPE(eosio::chain::code_object, eosio::chain::code_index)
 
 FC_REFLECT(eosio::chain::code_object, (code_hash)(code)(code_ref_count)(first_block_used)(vm_type)(vm_version))
+FC_REFLECT(eosio::chain::snapshot_code_object, (code_hash)(code)(code_ref_count)(first_block_used)(vm_type)(vm_version))
@@ -123,18 +123,50 @@ namespace eosio { namespace chain {
    typedef secondary_index<uint128_t,index128_object_type>::index_index  index128_index;
 
    typedef std::array<uint128_t, 2> key256_t;
-   typedef secondary_index<key256_t,index256_object_type>::index_object index256_object;
-   typedef secondary_index<key256_t,index256_object_type>::index_index  index256_index;
 
+   /// the order of std::less<key256_t>, two native 128 bit compares instead of std::lexicographical_compare
+   struct key256_less {
+      bool operator()( const key256_t& lhs, const key256_t& rhs ) const {
+         return lhs[0] < rhs[0] || ( lhs[0] == rhs[0] && lhs[1] < rhs[1] );
+      }
+   };
+
+   typedef secondary_index<key256_t,index256_object_type,key256_less>::index_object index256_object;
+   typedef secondary_index<key256_t,index256_object_type,key256_less>::index_index  index256_index;
+
+   /**
+    * The float comparators order exactly as f64_lt and f128_lt, which the existing indices are sorted by, using integer
+    * compares of the bits: a sign and magnitude float orders as the signed integer of its magnitude negated when the
+    * sign is set, which also makes -0 and +0 equivalent. The database API rejects NaN keys; NaN is still unordered here.
+    */
    struct soft_double_less {
       bool operator()( const float64_t& lhs, const float64_t& rhs ) const {
-         return f64_lt( lhs, rhs );
+         constexpr uint64_t sign = uint64_t(1) << 63;
+         constexpr uint64_t inf  = 0x7ff0000000000000ull;
+         const uint64_t lmag = lhs.v & ~sign;
+         const uint64_t rmag = rhs.v & ~sign;
+         if( lmag > inf || rmag > inf )
+            return false;
+         const int64_t l = ( lhs.v & sign ) ? -static_cast<int64_t>( lmag ) : static_cast<int64_t>( lmag );
+         const int64_t r = ( rhs.v & sign ) ? -static_cast<int64_t>( rmag ) : static_cast<int64_t>( rmag );
+         return l < r;
       }
    };
 
    struct soft_long_double_less {
       bool operator()( const float128_t& lhs, const float128_t& rhs ) const {
-         return f128_lt( lhs, rhs );
+         constexpr uint128_t sign = uint128_t(1) << 127;
+         constexpr uint128_t inf  = uint128_t(0x7fff000000000000ull) << 64;
+         // v[1] holds the sign, exponent and high mantissa bits
+         const uint128_t lbits = ( uint128_t(lhs.v[1]) << 64 ) | lhs.v[0];
+         const uint128_t rbits = ( uint128_t(rhs.v[1]) << 64 ) | rhs.v[0];
+         const uint128_t lmag = lbits & ~sign;
+         const uint128_t rmag = rbits & ~sign;
+         if( lmag > inf || rmag > inf )
+            return false;
+         const __int128 l = ( lbits & sign ) ? -static_cast<__int128>( lmag ) : static_cast<__int128>( lmag );
+         const __int128 r = ( rbits & sign ) ? -static_cast<__int128>( rmag ) : static_cast<__int128>( rmag );
+         return l < r;
       }
    };
 
@@ -4,6 +4,8 @@
 #include <eosio/chain/genesis_state.hpp>
 #include <chainbase/pinnable_mapped_file.hpp>
 #include <boost/signals2/signal.hpp>
+#include <map>
+#include <tuple>
 
 #include <eosio/chain/abi_serializer.hpp>
 #include <eosio/chain/account_object.hpp>
@@ -42,6 +44,8 @@ namespace eosio { namespace chain {
    using trx_meta_cache_lookup = std::function<transaction_metadata_ptr( const transaction_id_type&)>;
 
    class fork_database;
+   class recovered_keys_cache;
+   class transaction_metadata_pool;
 
    enum class db_read_mode {
       SPECULATIVE,
@@ -66,24 +70,42 @@ namespace eosio { namespace chain {
             flat_set< pair<account_name, action_name> > action_blacklist;
             flat_set<public_key_type> key_blacklist;
             path                     blocks_dir             =  chain::config::default_blocks_dir_name;
+            bool                     blocks_log_mmap        =  false;
+            uint32_t                 blocks_log_cache_size  =  0;
+            uint32_t                 blocks_log_stride      =  0; //< blocks per block log range, 0 for a single blocks.log
+            uint32_t                 max_retained_block_files = 10; //< block log ranges kept in blocks_dir, 0 keeps all
+            path                     blocks_archive_dir;    //< where block log ranges past max_retained_block_files are moved, removed if empty
             path                     state_dir              =  chain::config::default_state_dir_name;
             uint64_t                 state_size             =  chain::config::default_state_size;
             uint64_t                 state_guard_size       =  chain::config::default_state_guard_size;
             uint64_t                 reversible_cache_size  =  chain::config::default_reversible_cache_size;
             uint64_t                 reversible_guard_size  =  chain::config::default_reversible_guard_size;
             uint32_t                 sig_cpu_bill_pct       =  chain::config::default_sig_cpu_bill_pct;
+            uint32_t                 sig_recovery_cache_size = 0;
+            uint32_t                 trx_metadata_pool_size = 0; //< transactions whose recovered keys block validation reuses, 0 to disable
             uint16_t                 thread_pool_size       =  chain::config::default_controller_thread_pool_size;
+            uint32_t                 replay_read_ahead_blocks = 0; //< blocks read and prepared ahead of the one applied on replay, 0 to replay one block at a time
             bool                     read_only              =  false;
+            bool                     publish_replica_head   =  false; //< publish the head of state_dir to its read-only replicas, see replica_head_marker
+            bool                     state_replica          =  false; //< map state_dir of a primary publishing its head read-only and follow that head
+            path                     replica_blocks_dir;    //< state replica: blocks_dir of the primary, read-only, for the blocks it serves
+            flat_set<account_name>   snapshot_contracts;    //< load only the contract tables of these accounts from a snapshot, leaving a partial state that applies no blocks
             bool                     force_all_checks       =  false;
             bool                     disable_replay_opts    =  false;
             bool                     contracts_console      =  false;
             bool                     allow_ram_billing_in_notify = false;
             uint32_t                 maximum_variable_signature_length = chain::config::default_max_variable_signature_length;
             bool                     disable_all_subjective_mitigations = false; //< for testing purposes only
+            bool                     report_trx_conflict_groups = false; //< log transaction_conflict_groups of each validated block
+            bool                     track_access_sets      =  false; //< record the access_set of every transaction in its trace
+            bool                     trace_cpu_breakdown    =  false; //< record where the time of every action and transaction went in its trace
 
             wasm_interface::vm_type  wasm_runtime = chain::config::default_wasm_runtime;
             eosvmoc::config          eosvmoc_config;
             bool                     eosvmoc_tierup         = false;
+            uint64_t                 wasm_instantiation_cache_size = chain::config::default_wasm_instantiation_cache_size;
+            bool                     compress_contract_code = false; //< keep contract code zlib compressed in the state database
+            bool                     native_contracts       = false; //< run the native_contracts.hpp handlers of vetted contract builds in place of their wasm
 
             db_read_mode             read_mode              = db_read_mode::SPECULATIVE;
             validation_mode          block_validation_mode  = validation_mode::FULL;
@@ -93,6 +115,8 @@ namespace eosio { namespace chain {
 
             flat_set<account_name>   resource_greylist;
             flat_set<account_name>   trusted_producers;
+            flat_set<account_name>   profile_accounts; ///< receivers whose actions are recorded in the action profile
+            uint32_t                 table_access_sample_rate = 0; ///< one of every that many contract table accesses is counted, 0 counts none
             uint32_t                 greylist_limit         = chain::config::maximum_elastic_resource_multiplier;
          };
 
@@ -169,6 +193,12 @@ namespace eosio { namespace chain {
 
          boost::asio::io_context& get_thread_pool();
 
+         /// shared cache of recovered signature keys, thread safe, disabled when sig_recovery_cache_size is 0
+         recovered_keys_cache& get_recovered_keys_cache();
+
+         /// shared pool of transactions with recovered keys, thread safe, disabled when trx_metadata_pool_size is 0
+         transaction_metadata_pool& get_transaction_metadata_pool();
+
          const chainbase::database& db()const;
 
          const fork_database& fork_db()const;
@@ -230,9 +260,13 @@ namespace eosio { namespace chain {
 
          signed_block_ptr fetch_block_by_number( uint32_t block_num )const;
          signed_block_ptr fetch_block_by_id( block_id_type id )const;
+         /// fc::raw::pack of the block after prefix_size bytes, copied as stored without unpacking it; empty if not stored
+         std::vector<char> fetch_serialized_block_by_number( uint32_t block_num, size_t prefix_size = 0 )const;
 
          block_state_ptr fetch_block_state_by_number( uint32_t block_num )const;
          block_state_ptr fetch_block_state_by_id( block_id_type id )const;
+         /// transactions of a fork_db block off the best branch whose key recovery was started before it is applied
+         size_t prepared_trx_count( const block_id_type& id )const;
 
          block_id_type get_block_id_for_num( uint32_t block_num )const;
 
@@ -254,6 +288,69 @@ namespace eosio { namespace chain {
          // producing a block
          uint32_t configured_subjective_signature_length_limit()const;
 
+         /// accumulated cost of actions run by a profiled receiver, keyed by (receiver, code, action)
+         struct action_profile {
+            uint64_t         executions = 0;
+            fc::microseconds elapsed;
+            uint64_t         host_calls = 0;
+         };
+         using action_profile_map = std::map<std::tuple<account_name, account_name, action_name>, action_profile>;
+
+         bool is_profiled_account(const account_name& receiver) const;
+         void record_action_profile(const account_name& receiver, const account_name& code, const action_name& act,
+                                    const fc::microseconds& elapsed, uint64_t host_calls);
+         const action_profile_map& get_action_profiles() const;
+
+         /// estimated shared memory taken by the rows of a chainbase index: its nodes with the links of every ordering,
+         /// allocation headers and the dynamically sized members of the rows
+         struct index_memory_usage {
+            std::string index;
+            uint64_t    row_count       = 0;
+            uint64_t    estimated_bytes = 0;
+            bool        extrapolated    = false; ///< rows were left unvisited at the deadline, scaled from those visited
+         };
+         /// visits the rows of indices with dynamically sized members until deadline, the rest are extrapolated
+         std::vector<index_memory_usage> get_index_memory_usage( const fc::time_point& deadline ) const;
+
+         /// rows and estimated memory of a contract table summed over its scopes
+         struct table_usage {
+            account_name code;
+            table_name   table;
+            uint64_t     scopes          = 0;
+            uint64_t     primary_rows    = 0;
+            uint64_t     secondary_rows  = 0;
+            uint64_t     estimated_bytes = 0;
+         };
+         /// position of a table_id_object in code, scope, table order
+         struct table_usage_cursor {
+            account_name code;
+            scope_name   scope;
+            table_name   table;
+         };
+         struct table_usage_page {
+            std::vector<table_usage>     tables; ///< largest first
+            optional<table_usage_cursor> more;   ///< where the next page starts, unset when the walk is complete
+         };
+         /**
+          * Walks the tables of code, or of every code when code is empty, in code, scope, table order from `from`. The
+          * walk stops before the table of a scope that would report more than limit tables, or once deadline passes.
+          * A table whose scopes continue on the next page is reported on both with the scopes each walked.
+          */
+         table_usage_page get_table_usage( const account_name& code, const optional<table_usage_cursor>& from,
+                                           uint32_t limit, const fc::time_point& deadline ) const;
+
+         /// sampled accesses of contract tables by actions, keyed by (code, table) over all scopes. Lookups and iteration
+         /// are reads; stores, updates and removes are writes
+         struct table_access {
+            uint64_t reads  = 0;
+            uint64_t writes = 0;
+         };
+         using table_access_map = std::map<std::pair<account_name, table_name>, table_access>;
+
+         uint32_t table_access_sample_rate() const;
+         void record_table_access(const account_name& code, const table_name& table, bool write);
+         table_access_map get_table_accesses() const;
+
          void add_resource_greylist(const account_name &name);
          void remove_resource_greylist(const account_name &name);
          bool is_resource_greylisted(const account_name &name) const;
@@ -279,12 +376,52 @@ namespace eosio { namespace chain {
          bool is_trusted_producer( const account_name& producer) const;
 
          bool contracts_console()const;
+         bool track_access_sets()const;
+         bool trace_cpu_breakdown()const;
+         bool compress_contract_code()const;
+         /// code stored by setcode in the pending block, compressed when the block is finalized rather than while the
+         /// transaction runs, so compression time never counts against a transaction deadline
+         void queue_code_compression( const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version );
 
          chain_id_type get_chain_id()const;
 
          db_read_mode get_read_mode()const;
          validation_mode get_validation_mode()const;
 
+         bool is_state_replica()const;
+         /// the state was loaded from a snapshot with config::snapshot_contracts, and serves reads only
+         bool is_partial_state()const;
+         /// in state_dir of a partial state, lists the contracts it holds
+         static constexpr const char* partial_state_file_name = "partial_state.json";
+         /// state replica: follows the head the primary published last, true if the head changed
+         bool refresh_replica_head();
+         /**
+          * Every read of the state from outside the thread applying blocks goes through here. On a state replica the
+          * state is that of the primary, which changes it without waiting on readers, so read is only accepted if
+          * the state was that of the followed head all along; otherwise replica_state_exception is thrown, also in
+          * place of whatever read threw on the torn state. Anywhere else read runs as is.
+          */
+         template<typename F>
+         auto read_state( F&& read )const -> decltype( read() ) {
+            if( !is_state_replica() )
+               return read();
+            const uint64_t sequence = begin_replica_read();
+            auto result = [&]() {
+               try {
+                  return read();
+               } catch( ... ) {
+                  end_replica_read( sequence );
+                  throw;
+               }
+            }();
+            end_replica_read( sequence );
+            return result;
+         }
+         /// state replica: the sequence the state of the followed head is at, throws replica_state_exception if it moved on
+         uint64_t begin_replica_read()const;
+         /// state replica: throws replica_state_exception if the state changed since begin_replica_read returned sequence
+         void end_replica_read( uint64_t sequence )const;
+
          void set_subjective_cpu_leeway(fc::microseconds leeway);
          fc::optional<fc::microseconds> get_subjective_cpu_leeway() const;
          void set_greylist_limit( uint32_t limit );
@@ -303,6 +440,8 @@ namespace eosio { namespace chain {
          signal<void(const block_state_ptr&)>          accepted_block_header;
          signal<void(const block_state_ptr&)>          accepted_block;
          signal<void(const block_state_ptr&)>          irreversible_block;
+         /// the block became the head and no block is pending, the state is exactly that of the block
+         signal<void(const block_state_ptr&)>          committed_block;
          signal<void(const transaction_metadata_ptr&)> accepted_transaction;
          signal<void(std::tuple<const transaction_trace_ptr&, const signed_transaction&>)> applied_transaction;
          signal<void(const int&)>                      bad_alloc;
@@ -318,6 +457,8 @@ namespace eosio { namespace chain {
          */
 
          const apply_handler* find_apply_handler( account_name contract, scope_name scope, action_name act )const;
+         /// the native handler standing in for the wasm of code_hash for act, if native_contracts is configured
+         const apply_handler* find_native_contract_handler( const digest_type& code_hash, action_name act )const;
          wasm_interface& get_wasm_interface();
 
 
@@ -343,7 +484,7 @@ namespace eosio { namespace chain {
 
       static chain_id_type extract_chain_id(snapshot_reader& snapshot);
 
-      static fc::optional<chain_id_type> extract_chain_id_from_db( const path& state_dir );
+      static fc::optional<chain_id_type> extract_chain_id_from_db( const path& state_dir, bool allow_dirty = false );
 
       private:
          friend class apply_context;
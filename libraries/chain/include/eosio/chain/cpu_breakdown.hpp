@@ -0,0 +1,75 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+
+#include <chrono>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Where the wall time of an action went, in nanoseconds, recorded by apply_context when the controller is
+    * configured to trace cpu breakdowns. Host function time never counts as wasm time, so wasm, host and ram time add
+    * up to the part of the action's elapsed time spent executing it.
+    */
+   struct action_cpu_breakdown {
+      enum class host_category { db, crypto, console, auth, other };
+
+      uint64_t wasm_baseline_ns = 0; ///< executing wasm on the configured runtime
+      uint64_t wasm_oc_ns       = 0; ///< executing wasm compiled by the EOS VM OC tier-up
+      uint64_t host_db_ns       = 0; ///< contract table host functions
+      uint64_t host_crypto_ns   = 0; ///< hashing and signature recovery host functions
+      uint64_t host_console_ns  = 0; ///< print host functions
+      uint64_t host_auth_ns     = 0; ///< require_auth, has_auth and permission host functions
+      uint64_t host_other_ns    = 0; ///< every other host function
+      uint64_t ram_ns           = 0; ///< checking the action's RAM usage changes against ram_restrictions
+
+      uint64_t& host_ns( host_category c ) {
+         switch( c ) {
+            case host_category::db:      return host_db_ns;
+            case host_category::crypto:  return host_crypto_ns;
+            case host_category::console: return host_console_ns;
+            case host_category::auth:    return host_auth_ns;
+            case host_category::other:   break;
+         }
+         return host_other_ns;
+      }
+
+      uint64_t host_ns()const {
+         return host_db_ns + host_crypto_ns + host_console_ns + host_auth_ns + host_other_ns;
+      }
+   };
+
+   /// transaction wide parts of a transaction's wall time, recorded along with the action_cpu_breakdown of its actions
+   struct transaction_cpu_breakdown {
+      uint64_t authorization_ns = 0; ///< checking the declared authorizations against the signing keys
+      uint64_t ram_ns           = 0; ///< verifying the RAM usage of the accounts whose usage changed
+   };
+
+   /// adds the wall time of its scope to *counter, does nothing when counter is null
+   class scoped_cpu_timer {
+   public:
+      using clock = std::chrono::steady_clock;
+
+      explicit scoped_cpu_timer( uint64_t* counter )
+      :_counter(counter) {
+         if( _counter )
+            _start = clock::now();
+      }
+
+      ~scoped_cpu_timer() {
+         if( _counter )
+            *_counter += std::chrono::duration_cast<std::chrono::nanoseconds>( clock::now() - _start ).count();
+      }
+
+      scoped_cpu_timer( const scoped_cpu_timer& ) = delete;
+      scoped_cpu_timer& operator=( const scoped_cpu_timer& ) = delete;
+
+   private:
+      uint64_t*         _counter;
+      clock::time_point _start;
+   };
+
+} } /// namespace eosio::chain
+
+FC_REFLECT( eosio::chain::action_cpu_breakdown, (wasm_baseline_ns)(wasm_oc_ns)(host_db_ns)(host_crypto_ns)(host_console_ns)
+                                                (host_auth_ns)(host_other_ns)(ram_ns) )
+FC_REFLECT( eosio::chain::transaction_cpu_breakdown, (authorization_ns)(ram_ns) )
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /// instruction set extensions of the host that crypto backends can make use of
+   struct cpu_features {
+      bool sse41  = false;
+      bool avx2   = false;
+      bool bmi2   = false;
+      bool adx    = false;
+      bool sha_ni = false;
+
+      /// detected once, by cpuid on x86_64; none elsewhere
+      static const cpu_features& host();
+
+      /// space separated names of the features present, "none" when there are none
+      std::string to_string()const;
+   };
+
+   /**
+    * The implementations the hashes and signature recovery of transactions and crypto intrinsics run on here.
+    * They live in fc's backends, which choose their kernels themselves: OpenSSL by cpuid at startup, libsecp256k1 at
+    * build time. One line per primitive, for logging at startup.
+    */
+   std::vector<std::string> crypto_kernel_report();
+
+} } // eosio::chain
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <eosio/chain/action.hpp>
+#include <eosio/chain/block_timestamp.hpp>
+#include <eosio/chain/name.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <type_traits>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * True for types whose fc::raw encoding is their object representation on a little-endian host: trivially copyable,
+    * without padding and with every field a fixed width integer. Such values pack with a single write instead of a
+    * visit of their reflected fields, and vectors of them with a single write of all elements.
+    *
+    * Types opt in explicitly; a struct with a varint, an enum, an optional or a container anywhere in it must not.
+    */
+   template<typename T>
+   struct is_fixed_layout : std::integral_constant<bool, std::is_integral<T>::value && !std::is_same<T, bool>::value> {};
+
+   template<> struct is_fixed_layout<name> : std::true_type {};
+   template<> struct is_fixed_layout<permission_level> : std::true_type {};
+   template<> struct is_fixed_layout<block_timestamp_type> : std::true_type {};
+
+   static_assert( sizeof(name) == sizeof(uint64_t), "name packs as its uint64_t value" );
+   static_assert( sizeof(permission_level) == 2 * sizeof(name), "permission_level packs as actor and permission" );
+   static_assert( sizeof(block_timestamp_type) == sizeof(uint32_t), "block_timestamp_type packs as its slot" );
+
+   namespace raw_fixed {
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+      constexpr bool native_layout = true;
+#else
+      constexpr bool native_layout = false; ///< the field by field fc::raw encoding is used instead
+#endif
+
+      template<typename Stream, typename T>
+      inline void pack( Stream& ds, const T& v ) {
+         static_assert( is_fixed_layout<T>::value && std::is_trivially_copyable<T>::value, "not a fixed layout type" );
+         if constexpr( native_layout ) {
+            ds.write( reinterpret_cast<const char*>( &v ), sizeof(T) );
+         } else {
+            fc::raw::pack( ds, v );
+         }
+      }
+
+      template<typename Stream, typename T>
+      inline void unpack( Stream& ds, T& v ) {
+         static_assert( is_fixed_layout<T>::value && std::is_trivially_copyable<T>::value, "not a fixed layout type" );
+         if constexpr( native_layout ) {
+            ds.read( reinterpret_cast<char*>( &v ), sizeof(T) );
+         } else {
+            fc::raw::unpack( ds, v );
+         }
+      }
+
+      /// same encoding as fc::raw::pack of the vector
+      template<typename Stream, typename T>
+      inline void pack( Stream& ds, const std::vector<T>& v ) {
+         static_assert( is_fixed_layout<T>::value && std::is_trivially_copyable<T>::value, "not a fixed layout type" );
+         if constexpr( native_layout ) {
+            FC_ASSERT( v.size() <= MAX_NUM_ARRAY_ELEMENTS );
+            fc::raw::pack( ds, fc::unsigned_int( (uint32_t)v.size() ) );
+            if( !v.empty() )
+               ds.write( reinterpret_cast<const char*>( v.data() ), v.size() * sizeof(T) );
+         } else {
+            fc::raw::pack( ds, v );
+         }
+      }
+
+      /// same decoding as fc::raw::unpack of the vector, the size is checked once for all elements by the read
+      template<typename Stream, typename T>
+      inline void unpack( Stream& ds, std::vector<T>& v ) {
+         static_assert( is_fixed_layout<T>::value && std::is_trivially_copyable<T>::value, "not a fixed layout type" );
+         if constexpr( native_layout ) {
+            fc::unsigned_int size;
+            fc::raw::unpack( ds, size );
+            FC_ASSERT( size.value <= MAX_NUM_ARRAY_ELEMENTS );
+            v.resize( size.value );
+            if( !v.empty() )
+               ds.read( reinterpret_cast<char*>( v.data() ), v.size() * sizeof(T) );
+         } else {
+            fc::raw::unpack( ds, v );
+         }
+      }
+
+   } // namespace raw_fixed
+
+} } // eosio::chain
@@ -20,9 +20,21 @@ namespace eosio { namespace chain {
    class fork_database {
       public:
 
+         /**
+          *  Blocks persisted elsewhere, e.g. the reversible block database. close() writes only a reference to the
+          *  blocks it holds, which open() then fetches back from it.
+          */
+         struct block_store {
+            std::function<bool( uint32_t block_num, const block_id_type& id )> contains;
+            std::function<signed_block_ptr( uint32_t block_num )>            fetch;
+         };
+
          explicit fork_database( const fc::path& data_dir );
          ~fork_database();
 
+         /// must be set before open and stay valid until close
+         void set_block_store( block_store store );
+
          void open( const std::function<void( block_timestamp_type,
                                               const flat_set<digest_type>&,
                                               const vector<digest_type>& )>& validator );
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <softfloat.hpp>
+
+#include <cstdint>
+
+namespace eosio { namespace chain {
+
+   /**
+    * The hardware fast path of the add, sub, mul, div and sqrt softfloat intrinsics. IEEE-754 fixes these results bit
+    * for bit once the rounding mode is, and SSE2 on x86_64 and the FPU on aarch64 compute them to the letter when
+    * rounding to nearest with subnormals neither flushed nor read as zero. What the standard leaves to the hardware is
+    * the NaN a result carries, so every NaN result is computed again by softfloat, which keeps the payload and sign
+    * rules identical to what every node computes without the fast path.
+    *
+    * Each call checks the floating point control register of its thread, including that no exception traps, and falls
+    * back to softfloat when it is set up otherwise; the results are also checked against softfloat on a table of hard cases once per process. Any other
+    * intrinsic, such as the conversions, min, max and the rounding functions, stays on softfloat.
+    */
+   namespace hardware_float {
+
+#if defined(__x86_64__) || defined(__aarch64__)
+      constexpr bool compiled = true;
+#else
+      constexpr bool compiled = false;
+#endif
+
+      /// the fast path is off unless turned on, as by nodeos --wasm-hardware-float=true
+      void set_enabled( bool enabled );
+      bool enabled();
+
+      /// whether the calling thread takes the fast path now: enabled, verified, and the control register as required
+      bool usable();
+
+      /// runs the table of hard cases against softfloat; the result of the first call is kept
+      bool verified();
+
+      float32_t f32_add( float32_t a, float32_t b );
+      float32_t f32_sub( float32_t a, float32_t b );
+      float32_t f32_mul( float32_t a, float32_t b );
+      float32_t f32_div( float32_t a, float32_t b );
+      float32_t f32_sqrt( float32_t a );
+
+      float64_t f64_add( float64_t a, float64_t b );
+      float64_t f64_sub( float64_t a, float64_t b );
+      float64_t f64_mul( float64_t a, float64_t b );
+      float64_t f64_div( float64_t a, float64_t b );
+      float64_t f64_sqrt( float64_t a );
+
+   }
+
+} } // eosio::chain
@@ -1,7 +1,7 @@
 #pragma once
 #include <string>
 #include <fc/reflect/reflect.hpp>
-#include <iosfwd>
+#include <ostream>
 
 namespace eosio::chain {
   struct name;
@@ -23,8 +23,8 @@ namespace eosio::chain {
 
    static constexpr uint64_t string_to_uint64_t( std::string_view str ) {
       uint64_t n = 0;
-      int i = 0;
-      for ( ; str[i] && i < 12; ++i) {
+      size_t i = 0;
+      for ( ; i < 12 && i < str.size() && str[i]; ++i) {
          // NOTE: char_to_symbol() returns char type, and without this explicit
          // expansion to uint64 type, the compilation fails at the point of usage
          // of string_to_name(), where the usage requires constant (compile time) expression.
@@ -34,7 +34,7 @@ namespace eosio::chain {
       // The for-loop encoded up to 60 high bits into uint64 'name' variable,
       // if (strlen(str) > 12) then encode str[12] into the low (remaining)
       // 4 bits of 'name'
-      if (i == 12)
+      if (i == 12 && str.size() > 12)
          n |= char_to_symbol(str[12]) & 0x0F;
       return n;
    }
@@ -58,10 +58,13 @@ namespace eosio::chain {
       constexpr name() = default;
 
       std::string to_string()const;
+      /// writes the name to the 13 chars at begin without allocating, returns the end of what was written
+      char* write_as_string( char* begin )const;
       constexpr uint64_t to_uint64_t()const { return value; }
 
       friend std::ostream& operator << ( std::ostream& out, const name& n ) {
-         return out << n.to_string();
+         char buffer[13];
+         return out.write( buffer, n.write_as_string( buffer ) - buffer );
       }
 
       friend constexpr bool operator < ( const name& a, const name& b ) { return a.value < b.value; }
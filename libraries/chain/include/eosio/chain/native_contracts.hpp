@@ -0,0 +1,33 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   class apply_context;
+
+   /**
+    * @defgroup native_contract_handlers Native Contract Handlers
+    *
+    * C++ implementations of actions of specific contract builds, run in place of their wasm when
+    * controller::config::native_contracts is set. Each stands in for the build whose sha256 it is registered with and
+    * must leave the same state, RAM usage, notifications and assertion messages as that wasm does for any action data;
+    * native_contract_tests runs each against its wasm. A handler runs for an action sent to the contract itself,
+    * notifications and any other action still run the wasm.
+    */
+   ///@{
+   void apply_eosio_token_transfer(apply_context&);
+   ///@}
+
+   struct native_contract_handler {
+      digest_type  code_hash;
+      action_name  action;
+      void       (*handler)(apply_context&);
+   };
+
+   /// the contract builds vetted against their native handlers so far
+   const std::vector<native_contract_handler>& vetted_native_contract_handlers();
+
+} } /// namespace eosio::chain
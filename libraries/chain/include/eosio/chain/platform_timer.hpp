@@ -38,7 +38,7 @@ struct platform_timer {
 
 private:
    struct impl;
-   constexpr static size_t fwd_size = 8;
+   constexpr static size_t fwd_size = 24;
    fc::fwd<impl,fwd_size> my;
 
    void call_expiration_callback() {
@@ -5,6 +5,8 @@
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/snapshot.hpp>
 
+#include <memory>
+
 namespace eosio { namespace chain {
 
    namespace legacy {
@@ -303,6 +305,41 @@ namespace eosio { namespace chain {
       :producer_authority_schedule(sched) {}
    };
 
+   /**
+    * An immutable, reference counted producer_authority_schedule.
+    *
+    * Block header states hold their schedules in these so that a state and the states built on it share one copy of a
+    * schedule until it changes. Reads go through -> or the conversion to a const reference; assigning a schedule
+    * replaces the shared copy instead of modifying it. An empty schedule allocates nothing. Packs, unpacks and
+    * converts to and from a variant exactly as the schedule it holds.
+    */
+   class producer_schedule_ref {
+   public:
+      producer_schedule_ref() = default;
+      producer_schedule_ref( producer_authority_schedule s )
+      :_schedule( std::make_shared<const producer_authority_schedule>( std::move(s) ) ) {}
+
+      const producer_authority_schedule& get()const        { return _schedule ? *_schedule : empty(); }
+      const producer_authority_schedule* operator->()const { return &get(); }
+      operator const producer_authority_schedule&()const   { return get(); }
+
+      /// true when both refer to the same copy of the schedule
+      bool shares_with( const producer_schedule_ref& other )const { return _schedule == other._schedule; }
+
+      friend bool operator == ( const producer_schedule_ref& a, const producer_schedule_ref& b ) {
+         return a._schedule == b._schedule || a.get() == b.get();
+      }
+      friend bool operator != ( const producer_schedule_ref& a, const producer_schedule_ref& b ) { return !(a == b); }
+
+   private:
+      static const producer_authority_schedule& empty() {
+         static const producer_authority_schedule empty_schedule;
+         return empty_schedule;
+      }
+
+      std::shared_ptr<const producer_authority_schedule> _schedule;
+   };
+
 
    inline bool operator == ( const producer_authority& pa, const shared_producer_authority& pb )
    {
@@ -333,3 +370,30 @@ FC_REFLECT( eosio::chain::shared_block_signing_authority_v0, (threshold)(keys))
 FC_REFLECT( eosio::chain::shared_producer_authority, (producer_name)(authority) )
 FC_REFLECT( eosio::chain::shared_producer_authority_schedule, (version)(producers) )
 
+namespace fc {
+
+template<typename ST>
+datastream<ST>& operator << (datastream<ST>& s, const eosio::chain::producer_schedule_ref& v) {
+   raw::pack(s, v.get());
+   return s;
+}
+
+template<typename ST>
+datastream<ST>& operator >> (datastream<ST>& s, eosio::chain::producer_schedule_ref& v) {
+   eosio::chain::producer_authority_schedule schedule;
+   raw::unpack(s, schedule);
+   v = std::move(schedule);
+   return s;
+}
+
+inline void to_variant(const eosio::chain::producer_schedule_ref& s, fc::variant& v) {
+   to_variant( s.get(), v );
+}
+
+inline void from_variant(const fc::variant& v, eosio::chain::producer_schedule_ref& s) {
+   eosio::chain::producer_authority_schedule schedule;
+   from_variant( v, schedule );
+   s = std::move(schedule);
+}
+
+} // namespace fc
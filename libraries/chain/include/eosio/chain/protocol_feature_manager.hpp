@@ -23,6 +23,7 @@ enum class builtin_protocol_feature_t : uint32_t {
    ram_restrictions,
    webauthn_key,
    wtmsig_block_signatures,
+   batched_db_intrinsics,
 };
 
 struct protocol_feature_subjective_restrictions {
@@ -308,6 +309,8 @@ public:
    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
 
    void init( chainbase::database& db );
+   /// init with the (digest, activation block number) of the features activated in the state, oldest first
+   void init( const vector<std::pair<digest_type, uint32_t>>& activated );
 
    bool is_initialized()const { return _initialized; }
 
@@ -338,7 +341,13 @@ public:
    const_iterator upper_bound( uint32_t block_num )const;
 
 
-   bool is_builtin_activated( builtin_protocol_feature_t feature_codename, uint32_t current_block_num )const;
+   /// every activated builtin was activated at or before the latest activation, so from that block on a bit answers
+   bool is_builtin_activated( builtin_protocol_feature_t feature_codename, uint32_t current_block_num )const {
+      const uint32_t indx = static_cast<uint32_t>( feature_codename );
+      if( indx < 64 && current_block_num >= _latest_activation_block_num )
+         return (_activated_builtins >> indx) & 1;
+      return is_builtin_activated_at( indx, current_block_num );
+   }
 
    void activate_feature( const digest_type& feature_digest, uint32_t current_block_num );
    void popped_blocks_to( uint32_t block_num );
@@ -358,11 +367,16 @@ protected:
       uint32_t                             activation_block_num = not_active;
    };
 
+   bool is_builtin_activated_at( uint32_t indx, uint32_t current_block_num )const;
+   void update_activated_builtins();
+
 protected:
    protocol_feature_set                   _protocol_feature_set;
    vector<protocol_feature_entry>         _activated_protocol_features;
    vector<builtin_protocol_feature_entry> _builtin_protocol_features;
    size_t                                 _head_of_builtin_activation_list = builtin_protocol_feature_entry::no_previous;
+   uint64_t                               _activated_builtins = 0;  ///< bit per activated builtin below 64
+   uint32_t                               _latest_activation_block_num = 0;
    bool                                   _initialized = false;
 };
 
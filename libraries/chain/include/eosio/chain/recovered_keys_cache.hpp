@@ -0,0 +1,61 @@
+#pragma once
+#include <eosio/chain/types.hpp>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Thread safe, bounded cache of public keys recovered from (digest, signature) pairs.
+    *
+    * The same transaction commonly arrives from several peers, over the API, and again inside a block. Caching
+    * by the signed digest and the signature means each signature is recovered once no matter which path it took.
+    * Entries are spread over independently locked shards so that the chain thread pool does not contend on a
+    * single mutex; each shard evicts its oldest entry once full.
+    */
+   class recovered_keys_cache {
+      public:
+         /// @param capacity maximum number of cached keys, 0 disables the cache
+         explicit recovered_keys_cache( uint32_t capacity );
+
+         bool enabled()const { return _shard_capacity > 0; }
+
+         /// @returns the key recovered from sig over digest, recovering and caching it on a miss
+         public_key_type recover( const signature_type& sig, const digest_type& digest );
+
+         size_t size()const;
+         uint64_t hits()const   { return _hits; }
+         uint64_t misses()const { return _misses; }
+
+      private:
+         struct key_type {
+            digest_type   digest;
+            vector<char>  packed_sig;
+
+            friend bool operator==( const key_type& a, const key_type& b ) {
+               return a.digest == b.digest && a.packed_sig == b.packed_sig;
+            }
+         };
+
+         struct key_hash {
+            size_t operator()( const key_type& k )const;
+         };
+
+         struct shard {
+            mutable std::mutex                                        mtx;
+            std::unordered_map<key_type, public_key_type, key_hash>   keys;
+            std::deque<key_type>                                      insertion_order;
+         };
+
+         static constexpr uint32_t num_shards = 16;
+
+         const size_t                      _shard_capacity;
+         std::array<shard, num_shards>     _shards;
+         std::atomic<uint64_t>             _hits{0};
+         std::atomic<uint64_t>             _misses{0};
+   };
+
+} } /// eosio::chain
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <eosio/chain/block_header_state.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstdint>
+#include <utility>
+
+namespace eosio { namespace chain {
+
+   /// the head a primary node last published for the read-only replicas of its state database
+   struct replica_head {
+      block_header_state     head;
+      uint32_t               irreversible_block_num = 0;
+      block_id_type          irreversible_block_id;
+      block_timestamp_type   irreversible_block_time;
+   };
+
+   /**
+    * replica_head.bin in the state directory, through which a primary node tells the processes mapping its state
+    * database read-only which block that state is at.
+    *
+    * The file holds a sequence number next to the packed replica_head, in the manner of a seqlock: the primary makes
+    * the sequence odd before it changes the state database and even again once the state is that of a complete block
+    * whose replica_head it has written. The primary never waits on a replica.
+    *
+    * A replica reads the head, and the state, only while the sequence is even and checks afterwards that it is
+    * unchanged; a read that overlapped a change of the primary may have seen nodes freed or reused under it and its
+    * result is discarded. See controller::read_replica_state.
+    */
+   class replica_head_marker {
+   public:
+      static constexpr const char* file_name = "replica_head.bin";
+
+      enum class mode {
+         publish,  ///< primary, creates the file if need be and starts out writing
+         follow    ///< replica, requires the file
+      };
+
+      replica_head_marker( const fc::path& state_dir, mode m );
+
+      replica_head_marker( const replica_head_marker& ) = delete;
+      replica_head_marker& operator=( const replica_head_marker& ) = delete;
+
+      /// primary: the state database is about to change; a no-op while already changing
+      void begin_write();
+      /// primary: the state database is that of h.head
+      void publish( const replica_head& h );
+
+      /// replica: the head last published with the sequence it was published at, empty while the primary writes
+      fc::optional<std::pair<uint64_t, replica_head>> read()const;
+      uint64_t sequence()const;
+      /// replica: true if everything read of the state since sequence was read is of the state published at sequence
+      bool unchanged_since( uint64_t sequence )const;
+
+   private:
+      struct layout;
+
+      layout& get()const { return *static_cast<layout*>( _region.get_address() ); }
+
+      boost::interprocess::file_mapping  _file;
+      boost::interprocess::mapped_region _region;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::replica_head, (head)(irreversible_block_num)(irreversible_block_id)(irreversible_block_time) )
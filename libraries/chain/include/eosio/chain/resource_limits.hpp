@@ -53,6 +53,13 @@ namespace eosio { namespace chain { namespace resource_limits {
       int64_t max = 0; ///< max per window under current congestion
    };
 
+   struct account_bandwidth_limits {
+      account_resource_limit net;
+      account_resource_limit cpu;
+      bool                   net_greylisted = false;
+      bool                   cpu_greylisted = false;
+   };
+
    class resource_limits_manager {
       public:
          explicit resource_limits_manager(chainbase::database& db)
@@ -93,6 +100,8 @@ namespace eosio { namespace chain { namespace resource_limits {
 
          std::pair<account_resource_limit, bool> get_account_cpu_limit_ex( const account_name& name, uint32_t greylist_limit = config::maximum_elastic_resource_multiplier ) const;
          std::pair<account_resource_limit, bool> get_account_net_limit_ex( const account_name& name, uint32_t greylist_limit = config::maximum_elastic_resource_multiplier ) const;
+         /// same as get_account_net_limit_ex and get_account_cpu_limit_ex but looks up the account and shared state once
+         account_bandwidth_limits get_account_bandwidth_limits( const account_name& name, uint32_t greylist_limit = config::maximum_elastic_resource_multiplier ) const;
 
          int64_t get_account_ram_usage( const account_name& name ) const;
 
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <signal.h>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Statistical profiler sampling the call stacks of the threads of this process that are using cpu, at the given
+    * frequency of process cpu time, by way of SIGPROF. Samples go to a buffer allocated up front and are only
+    * symbolized once sampling stops, so the signal handler neither allocates nor locks.
+    * Instructions executing EOS VM OC compiled code are recorded by their offset in to the code cache for the caller
+    * to name. That code has no unwind information so a stack sampled in it, or in a host function it called, ends at
+    * the innermost compiled frame.
+    * Only one profiler can be sampling at a time.
+    */
+   class sampling_profiler {
+   public:
+      static constexpr uint32_t max_depth = 32;
+
+      /// max_samples is the size of the sample buffer, samples taken once it is full are only counted as dropped
+      sampling_profiler( uint32_t frequency, uint32_t max_samples );
+      /// stops sampling if still running
+      ~sampling_profiler();
+
+      /// throws if another profiler is sampling
+      void start();
+      void stop();
+
+      uint32_t samples()const;
+      uint32_t dropped()const { return _dropped.load(); }
+
+      /**
+       * Sampled stacks in folded form, root first with frames separated by ';', each mapped to the number of
+       * samples of it. Native frames are named by their demangled symbol and EOS VM OC frames by oc_name, which is
+       * given the offset in to the code cache. Call once sampling has stopped.
+       */
+      std::map<std::string, uint64_t> folded( const std::function<std::string(size_t)>& oc_name )const;
+
+   private:
+      struct sample {
+         uint32_t  depth = 0;
+         uint32_t  oc_frames = 0; ///< bit i is set when frames[i] is an offset in to the EOS VM OC code cache
+         uintptr_t frames[max_depth]; ///< leaf first
+      };
+
+      static void handle_signal( int sig, siginfo_t* info, void* ucontext );
+      void record( void* ucontext );
+
+      const uint32_t           _frequency;
+      std::vector<sample>      _samples;
+      std::atomic<uint32_t>    _next{0};
+      std::atomic<uint32_t>    _dropped{0};
+      bool                     _running = false;
+
+      static std::atomic<sampling_profiler*> _active;
+      static std::atomic<uint32_t>           _handlers_running;
+   };
+
+} } // eosio::chain
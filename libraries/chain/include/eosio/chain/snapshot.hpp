@@ -3,8 +3,13 @@
 #include <eosio/chain/database_utils.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <fc/variant_object.hpp>
+#include <fc/filesystem.hpp>
 #include <boost/core/demangle.hpp>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 #include <ostream>
+#include <sstream>
 
 namespace eosio { namespace chain {
    /**
@@ -110,6 +115,25 @@ namespace eosio { namespace chain {
       snapshot_row_writer<T> make_row_writer( const T& data) {
          return snapshot_row_writer<T>(data);
       }
+
+      /**
+       * Packs rows into a buffer exactly as ostream_snapshot_writer would write them. Offers the same add_row
+       * interface as snapshot_writer::section_writer so rows can be serialized away from the writer (e.g. on a
+       * worker thread) and later appended in order with section_writer::add_packed_rows.
+       */
+      struct packed_rows_buffer {
+         template<typename T>
+         void add_row( const T& row, const chainbase::database& db ) {
+            make_row_writer(snapshot_row_traits<T>::to_snapshot_row(row, db)).write(out);
+            ++row_count;
+         }
+
+         std::string data()const { return buf.str(); }
+
+         std::ostringstream   buf;
+         ostream_wrapper      out{buf};
+         uint64_t             row_count = 0;
+      };
    }
 
    class snapshot_writer {
@@ -121,6 +145,11 @@ namespace eosio { namespace chain {
                   _writer.write_row(detail::make_row_writer(detail::snapshot_row_traits<T>::to_snapshot_row(row, db)));
                }
 
+               /// append row_count rows already packed by detail::packed_rows_buffer, requires supports_packed_rows()
+               void add_packed_rows( const std::string& data, uint64_t row_count ) {
+                  _writer.write_packed_rows(data, row_count);
+               }
+
             private:
                friend class snapshot_writer;
                section_writer(snapshot_writer& writer)
@@ -144,11 +173,17 @@ namespace eosio { namespace chain {
             write_section(detail::snapshot_section_traits<T>::section_name(), f);
          }
 
+         /// true if the writer consumes the binary row encoding, allowing rows to be packed ahead of time
+         virtual bool supports_packed_rows() const { return false; }
+
       virtual ~snapshot_writer(){};
 
       protected:
          virtual void write_start_section( const std::string& section_name ) = 0;
          virtual void write_row( const detail::abstract_snapshot_row_writer& row_writer ) = 0;
+         virtual void write_packed_rows( const std::string& data, uint64_t row_count ) {
+            EOS_THROW(snapshot_exception, "snapshot writer does not support pre-packed rows");
+         }
          virtual void write_end_section() = 0;
    };
 
@@ -332,8 +367,10 @@ namespace eosio { namespace chain {
 
          void write_start_section( const std::string& section_name ) override;
          void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_packed_rows( const std::string& data, uint64_t row_count ) override;
          void write_end_section( ) override;
          void finalize();
+         bool supports_packed_rows() const override { return true; }
 
          static const uint32_t magic_number = 0x30510550;
 
@@ -345,6 +382,51 @@ namespace eosio { namespace chain {
 
    };
 
+   /**
+    * Stream buffer handing what is written to it, in chunks tagged with their offset, to another thread writing them
+    * to a file with write_to, so a snapshot is written to disk while it is serialized without ever being held in memory
+    * whole or twice. Seeking, as ostream_snapshot_writer does to patch section headers, starts a new chunk at the new
+    * offset. Only as much of the snapshot as the disk lags behind is held in memory.
+    */
+   class snapshot_chunk_queue : public std::streambuf {
+      public:
+         explicit snapshot_chunk_queue( size_t chunk_size = 1024*1024 );
+
+         /// everything is written: write_to returns once the last chunk is on its stream
+         void close();
+         /// the snapshot could not be serialized: write_to returns false without writing the rest
+         void abort();
+         /// writes the chunks to out, at their offsets, as they are handed off, until close() or abort()
+         /// @return false if aborted or out failed
+         bool write_to( std::ostream& out );
+         /// bytes written to the buffer so far
+         uint64_t size() const;
+
+      protected:
+         int_type overflow( int_type c ) override;
+         pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) override;
+         pos_type seekpos( pos_type pos, std::ios_base::openmode which ) override;
+
+      private:
+         struct chunk {
+            uint64_t          offset = 0;
+            std::vector<char> data;
+         };
+
+         uint64_t position() const { return current.offset + (pptr() - pbase()); }
+         /// queues the current chunk and starts the next one at offset
+         void hand_off( uint64_t offset );
+
+         const size_t            chunk_size;
+         chunk                   current;          ///< being written, only by the serializing thread
+         uint64_t                end = 0;          ///< furthest offset written
+         std::mutex              mtx;
+         std::condition_variable cv;
+         std::deque<chunk>       chunks;           // guarded by mtx
+         bool                    closed = false;   // guarded by mtx
+         bool                    aborted = false;  // guarded by mtx
+   };
+
    class istream_snapshot_reader : public snapshot_reader {
       public:
          explicit istream_snapshot_reader(std::istream& snapshot);
@@ -366,14 +448,128 @@ namespace eosio { namespace chain {
          uint64_t       cur_row;
    };
 
+   namespace detail {
+      /// one independently compressed run of whole rows of an indexed snapshot section
+      struct indexed_snapshot_chunk {
+         uint64_t       offset = 0;          ///< from the start of the snapshot
+         uint32_t       compressed_size = 0;
+         uint32_t       size = 0;            ///< uncompressed
+         fc::sha256     digest;              ///< of the compressed bytes
+      };
+
+      struct indexed_snapshot_section {
+         std::string                          name;
+         uint64_t                             row_count = 0;
+         std::vector<indexed_snapshot_chunk>  chunks;
+      };
+
+      struct indexed_snapshot_toc {
+         uint8_t                                 compression = 0;
+         std::vector<indexed_snapshot_section>   sections;
+      };
+   }
+
+   /**
+    * Writes the rows of every section, encoded as by ostream_snapshot_writer, in independently compressed chunks
+    * followed by a table of contents locating every section and holding the checksum of every chunk:
+    *
+    *    magic_number | version | chunk... | toc | toc offset (uint64_t) | magic_number
+    *
+    * A reader finds a section without scanning the snapshot, and can verify all chunks in parallel without
+    * decompressing them.
+    */
+   class indexed_snapshot_writer : public snapshot_writer {
+      public:
+         enum class compression_type : uint8_t {
+            none = 0,
+            zlib = 1
+         };
+
+         explicit indexed_snapshot_writer(std::ostream& snapshot, compression_type compression = compression_type::zlib,
+                                          uint32_t chunk_size = default_chunk_size);
+
+         void write_start_section( const std::string& section_name ) override;
+         void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_packed_rows( const std::string& data, uint64_t row_count ) override;
+         void write_end_section( ) override;
+         void finalize();
+         bool supports_packed_rows() const override { return true; }
+
+         static const uint32_t magic_number = 0x30510551;
+         static const uint32_t default_chunk_size = 4 * 1024 * 1024;
+
+      private:
+         void flush_chunk();
+
+         std::ostream&                                    snapshot;
+         std::streampos                                   header_pos;
+         compression_type                                 compression;
+         uint32_t                                         chunk_size;
+         std::ostringstream                               chunk;
+         detail::ostream_wrapper                          chunk_out{chunk};
+         detail::indexed_snapshot_toc                     toc;
+         fc::optional<detail::indexed_snapshot_section>   section;
+   };
+
+   /**
+    * Reads a snapshot written by indexed_snapshot_writer, either memory mapped from a file or from a buffer.
+    * validate() checks the chunk checksums on all hardware threads; rows are decompressed one chunk at a time as
+    * they are read.
+    */
+   class indexed_snapshot_reader : public snapshot_reader {
+      public:
+         /// memory maps the snapshot file at p
+         explicit indexed_snapshot_reader(const fc::path& p);
+         /// reads a snapshot held in memory, which must outlive the reader
+         indexed_snapshot_reader(const char* data, size_t size);
+
+         void validate() const override;
+         bool has_section( const string& section_name ) override;
+         void set_section( const string& section_name ) override;
+         bool read_row( detail::abstract_snapshot_row_reader& row_reader ) override;
+         bool empty ( ) override;
+         void clear_section() override;
+         void return_to_header() override;
+
+      private:
+         struct chunk_streambuf : std::streambuf {
+            explicit chunk_streambuf(indexed_snapshot_reader& reader)
+            :reader(reader) {}
+
+            int_type underflow() override;
+            void reset() { setg(nullptr, nullptr, nullptr); }
+
+            indexed_snapshot_reader& reader;
+         };
+
+         void load_toc();
+         bool next_chunk();
+
+         std::shared_ptr<void>                       mapping; ///< keeps a memory mapped file mapped
+         const char*                                 data;
+         size_t                                      size;
+         detail::indexed_snapshot_toc                toc;
+         const detail::indexed_snapshot_section*     cur_section = nullptr;
+         size_t                                      cur_chunk = 0;
+         uint64_t                                    cur_row = 0;
+         std::vector<char>                           chunk_data;
+         chunk_streambuf                             rows_buf{*this};
+         std::istream                                rows{&rows_buf};
+   };
+
+   /// opens the snapshot file at p with the reader of its format, indexed or plain binary
+   snapshot_reader_ptr open_snapshot_file(const fc::path& p);
+
    class integrity_hash_snapshot_writer : public snapshot_writer {
       public:
          explicit integrity_hash_snapshot_writer(fc::sha256::encoder&  enc);
 
          void write_start_section( const std::string& section_name ) override;
          void write_row( const detail::abstract_snapshot_row_writer& row_writer ) override;
+         void write_packed_rows( const std::string& data, uint64_t row_count ) override;
          void write_end_section( ) override;
          void finalize();
+         bool supports_packed_rows() const override { return true; }
 
       private:
          fc::sha256::encoder&  enc;
@@ -381,3 +577,7 @@ namespace eosio { namespace chain {
    };
 
 }}
+
+FC_REFLECT(eosio::chain::detail::indexed_snapshot_chunk, (offset)(compressed_size)(size)(digest))
+FC_REFLECT(eosio::chain::detail::indexed_snapshot_section, (name)(row_count)(chunks))
+FC_REFLECT(eosio::chain::detail::indexed_snapshot_toc, (compression)(sections))
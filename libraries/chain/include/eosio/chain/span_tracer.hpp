@@ -0,0 +1,110 @@
+#pragma once
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/time.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+#ifdef EOSIO_SPAN_TRACING_ENABLED
+   constexpr bool span_tracing_compiled = true;
+#else
+   constexpr bool span_tracing_compiled = false;
+#endif
+
+   /**
+    * Process wide ring buffer of timed spans of the hot paths, built in with cmake -DENABLE_SPAN_TRACING=ON.
+    * Recording a span claims a slot with one atomic add and publishes it with a sequence number, so it neither
+    * locks nor allocates; once the buffer wraps the oldest spans are overwritten. Spans sharing a trace id form a
+    * chain across threads, such as a transaction received on a net thread, its keys recovered on the chain thread
+    * pool and then applied on the main thread.
+    */
+   class span_tracer {
+   public:
+      struct span {
+         const char* category = nullptr;  ///< string literals, or names from intern()
+         const char* name = nullptr;
+         uint64_t    trace_id = 0;        ///< 0 when the span is not part of a chain
+         uint32_t    thread = 0;          ///< numbered in the order threads first record
+         int64_t     start_us = 0;        ///< since the epoch
+         int64_t     duration_us = 0;
+      };
+
+      /// allocates the buffer and starts recording; call once, before any thread records
+      static void initialize( uint32_t capacity );
+      static bool initialized() { return _capacity != 0; }
+      static void set_enabled( bool enabled ) { _enabled.store( enabled && initialized(), std::memory_order_relaxed ); }
+      static bool enabled() { return _enabled.load( std::memory_order_relaxed ); }
+
+      static void record( span s );
+
+      /// a copy of name that lives as long as the process, for span names that are not literals
+      static const char* intern( const std::string& name );
+
+      /// the spans in the buffer, oldest first; skips those being overwritten
+      static std::vector<span> spans();
+
+      /// Chrome trace event format, with flow events joining the spans of each trace across threads
+      static std::string chrome_trace_json();
+      /// OTLP/JSON ExportTraceServiceRequest; spans without a trace id each get their own trace
+      static std::string otlp_json( const std::string& service_name );
+
+   private:
+      struct slot;
+
+      static slot*                  _slots;
+      static uint32_t               _capacity;
+      static std::atomic<uint64_t>  _next;
+      static std::atomic<bool>      _enabled;
+   };
+
+   /// times the scope it lives in as a span, when recording is enabled at runtime
+   template<bool Compiled>
+   class basic_scoped_span {
+   public:
+      basic_scoped_span( const char* category, const char* name, uint64_t trace_id = 0 ) {
+         if( span_tracer::enabled() ) {
+            _span.category = category;
+            _span.name     = name;
+            _span.trace_id = trace_id;
+            _span.start_us = fc::time_point::now().time_since_epoch().count();
+         }
+      }
+      ~basic_scoped_span() {
+         if( _span.name ) {
+            _span.duration_us = fc::time_point::now().time_since_epoch().count() - _span.start_us;
+            span_tracer::record( _span );
+         }
+      }
+      basic_scoped_span( const basic_scoped_span& ) = delete;
+      basic_scoped_span& operator=( const basic_scoped_span& ) = delete;
+
+      void set_trace_id( uint64_t trace_id ) { _span.trace_id = trace_id; }
+
+   private:
+      span_tracer::span _span;
+   };
+
+   /// built without span tracing, a span is an empty object calls to which compile away
+   template<>
+   class basic_scoped_span<false> {
+   public:
+      basic_scoped_span( const char*, const char*, uint64_t = 0 ) {}
+      basic_scoped_span( const basic_scoped_span& ) = delete;
+      basic_scoped_span& operator=( const basic_scoped_span& ) = delete;
+
+      void set_trace_id( uint64_t ) {}
+   };
+
+   using scoped_span = basic_scoped_span<span_tracing_compiled>;
+
+   /// trace id of the chain of spans handling the transaction or block of the given id
+   inline uint64_t span_trace_id( const fc::sha256& id ) {
+      return id._hash[0];
+   }
+
+} } // eosio::chain
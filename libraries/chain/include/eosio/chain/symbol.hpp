@@ -82,13 +82,22 @@ namespace eosio {
             uint64_t value() const { return m_value; }
             bool valid() const
             {
-               const auto& s = name();
-               return decimals() <= max_precision && valid_name(s);
+               return decimals() <= max_precision && valid_code(m_value >> 8);
             }
             static bool valid_name(const string& name)
             {
                return all_of(name.begin(), name.end(), [](char c)->bool { return (c >= 'A' && c <= 'Z'); });
             }
+            /// as valid_name(name()), on the bytes of the name without building it
+            static bool valid_code(uint64_t code)
+            {
+               for( ; code; code >>= 8 ) {
+                  const char c = code & 0xFF;
+                  if( c < 'A' || c > 'Z' )
+                     return false;
+               }
+               return true;
+            }
 
             uint8_t decimals() const { return m_value & 0xFF; }
             uint64_t precision() const
@@ -106,6 +115,7 @@ namespace eosio {
                uint64_t v = m_value;
                v >>= 8;
                string result;
+               result.reserve(7);
                while (v > 0) {
                   char c = v & 0xFF;
                   result += c;
@@ -135,7 +145,7 @@ namespace eosio {
 
             void reflector_init()const {
                EOS_ASSERT( decimals() <= max_precision, symbol_type_exception, "precision ${p} should be <= 18", ("p", decimals()) );
-               EOS_ASSERT( valid_name(name()), symbol_type_exception, "invalid symbol: ${name}", ("name",name()));
+               EOS_ASSERT( valid_code(m_value >> 8), symbol_type_exception, "invalid symbol: ${name}", ("name",name()));
             }
 
          private:
@@ -4,8 +4,17 @@
 #include <boost/asio/io_context.hpp>
 #include <boost/asio/thread_pool.hpp>
 #include <boost/asio/post.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
 #include <future>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <tuple>
+#include <vector>
 
 namespace eosio { namespace chain {
 
@@ -27,14 +36,93 @@ namespace eosio { namespace chain {
       // destroy work guard, stop io_context, join thread_pool, and stop thread_pool
       void stop();
 
+      /**
+       * Runs a on the calling thread and b on whichever thread gets to it first, returning when both have; the first
+       * exception either throws is rethrown. Each thread of the pool has a deque of forked tasks: a thread of the pool
+       * forks to the back of its own and takes its forks back from there, idle threads steal from the front, and other
+       * threads fork to the deques in turn. A forked task lives on the stack of fork_join, so forking allocates
+       * nothing, and a thread waiting for a fork another thread took runs other queued tasks meanwhile.
+       */
+      template<typename A, typename B>
+      void fork_join( A&& a, B&& b );
+
+      /// calls f(i) for every i in [0, n), halving the range with fork_join until a part has at most grain indices
+      template<typename F>
+      void parallel_for( size_t n, F&& f, size_t grain = 1 ) {
+         for_range( 0, n, grain ? grain : 1, f );
+      }
+
    private:
+      struct task {
+         void            (*run)( task& ) = nullptr;
+         std::atomic<bool> done{false};
+      };
+      struct task_deque {
+         std::mutex          mtx;
+         std::deque<task*>   tasks;
+      };
+
+      void fork( task& t );
+      void join( task& t );
+      /// runs one forked task, the newest of the calling thread's own deque or else the oldest of another
+      bool run_one();
+
+      template<typename F>
+      void for_range( size_t begin, size_t end, size_t grain, F& f ) {
+         if( end - begin <= grain ) {
+            for( size_t i = begin; i < end; ++i )
+               f( i );
+            return;
+         }
+         const size_t mid = begin + (end - begin) / 2;
+         fork_join( [&]() { for_range( begin, mid, grain, f ); }, [&]() { for_range( mid, end, grain, f ); } );
+      }
+
       using ioc_work_t = boost::asio::executor_work_guard<boost::asio::io_context::executor_type>;
 
+      std::vector<std::unique_ptr<task_deque>> _deques;
+      std::atomic<size_t>            _next_deque{0};
+      std::atomic<bool>              _running{true};
       boost::asio::thread_pool       _thread_pool;
       boost::asio::io_context        _ioc;
       fc::optional<ioc_work_t>       _ioc_work;
    };
 
+   template<typename A, typename B>
+   void named_thread_pool::fork_join( A&& a, B&& b ) {
+      if( _deques.empty() || !_running.load( std::memory_order_relaxed ) ) {
+         a();
+         b();
+         return;
+      }
+      struct forked : task {
+         std::remove_reference_t<B>* f = nullptr;
+         std::exception_ptr          error;
+      } t;
+      t.f = &b;
+      t.run = []( task& base ) {
+         auto& self = static_cast<forked&>( base );
+         try {
+            (*self.f)();
+         } catch( ... ) {
+            self.error = std::current_exception();
+         }
+         self.done.store( true, std::memory_order_release );
+      };
+      fork( t );
+      std::exception_ptr error;
+      try {
+         a();
+      } catch( ... ) {
+         error = std::current_exception();
+      }
+      join( t );
+      if( error )
+         std::rethrow_exception( error );
+      if( t.error )
+         std::rethrow_exception( t.error );
+   }
+
 
    // async on thread_pool and return future
    template<typename F>
@@ -44,6 +132,60 @@ namespace eosio { namespace chain {
       return task->get_future();
    }
 
+   /**
+    * Delivers controller signals to one subscriber, either on the emitting thread or in order on a thread of the
+    * subscriber's own, so that its work does not add to block application. Asynchronous delivery holds copies of the
+    * signal arguments, block_state_ptr and transaction_trace_ptr are shared and the transaction of applied_transaction
+    * is copied, and the emitter waits only while max_queued deliveries are pending. A subscriber delivered to
+    * asynchronously must not read chain state, which has moved on by the time it runs; exceptions it throws are logged.
+    */
+   class signal_worker {
+   public:
+      /// max_queued of 0 delivers on the emitting thread
+      signal_worker( std::string name, size_t max_queued );
+
+      // calls stop()
+      ~signal_worker();
+
+      bool is_async()const { return _max_queued > 0; }
+
+      /// a slot to connect to a controller signal with argument Arg that delivers it to f
+      template<typename Arg, typename F>
+      std::function<void(Arg)> slot( F&& f ) {
+         if( !is_async() )
+            return std::forward<F>( f );
+         auto fn = std::make_shared<std::decay_t<F>>( std::forward<F>( f ) );
+         return [this, fn]( Arg a ) {
+            post( [fn, a = owned( a )]() { (*fn)( a ); } );
+         };
+      }
+
+      /// waits until every delivery queued so far has run
+      void drain();
+
+      /// runs what is queued and joins the thread, deliveries posted afterwards are dropped
+      void stop();
+
+   private:
+      template<typename T>
+      static T owned( const T& v ) { return v; }
+      /// applied_transaction passes a tuple of references
+      template<typename... Ts>
+      static std::tuple<std::decay_t<Ts>...> owned( const std::tuple<Ts...>& t ) { return t; }
+
+      void post( std::function<void()> task );
+      void run();
+
+      std::string                        _name;
+      size_t                             _max_queued;
+      std::mutex                         _mtx;
+      std::condition_variable            _cv;
+      std::deque<std::function<void()>>  _queue;
+      size_t                             _running = 0;
+      bool                               _stopped = false;
+      std::thread                        _thread;
+   };
+
 } } // eosio::chain
 
 
@@ -3,6 +3,8 @@
 #include <eosio/chain/action.hpp>
 #include <eosio/chain/action_receipt.hpp>
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/access_set.hpp>
+#include <eosio/chain/cpu_breakdown.hpp>
 
 namespace eosio { namespace chain {
 
@@ -44,6 +46,7 @@ namespace eosio { namespace chain {
       flat_set<account_delta>         account_ram_deltas;
       fc::optional<fc::exception>     except;
       fc::optional<uint64_t>          error_code;
+      fc::optional<action_cpu_breakdown> cpu_breakdown; ///< set when the controller traces cpu breakdowns
    };
 
    struct transaction_trace {
@@ -57,6 +60,8 @@ namespace eosio { namespace chain {
       bool                                       scheduled = false;
       vector<action_trace>                       action_traces;
       fc::optional<account_delta>                account_ram_delta;
+      fc::optional<access_set>                   accesses; ///< contract rows read and written, when the controller tracks access sets
+      fc::optional<transaction_cpu_breakdown>    cpu_breakdown; ///< set when the controller traces cpu breakdowns
 
       transaction_trace_ptr                      failed_dtrx_trace;
       fc::optional<fc::exception>                except;
@@ -72,8 +77,8 @@ FC_REFLECT( eosio::chain::account_delta,
 FC_REFLECT( eosio::chain::action_trace,
                (action_ordinal)(creator_action_ordinal)(closest_unnotified_ancestor_action_ordinal)(receipt)
                (receiver)(act)(context_free)(elapsed)(console)(trx_id)(block_num)(block_time)
-               (producer_block_id)(account_ram_deltas)(except)(error_code) )
+               (producer_block_id)(account_ram_deltas)(except)(error_code)(cpu_breakdown) )
 
 FC_REFLECT( eosio::chain::transaction_trace, (id)(block_num)(block_time)(producer_block_id)
                                              (receipt)(elapsed)(net_usage)(scheduled)
-                                             (action_traces)(account_ram_delta)(failed_dtrx_trace)(except)(error_code) )
+                                             (action_traces)(account_ram_delta)(accesses)(cpu_breakdown)(failed_dtrx_trace)(except)(error_code) )
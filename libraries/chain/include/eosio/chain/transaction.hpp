@@ -1,10 +1,13 @@
 #pragma once
 
 #include <eosio/chain/action.hpp>
+#include <memory>
 #include <numeric>
 
 namespace eosio { namespace chain {
 
+   class recovered_keys_cache;
+
    struct deferred_transaction_generation_context : fc::reflect_init {
       static constexpr uint16_t extension_id() { return 0; }
       static constexpr bool     enforce_unique() { return true; }
@@ -92,7 +95,8 @@ namespace eosio { namespace chain {
                                                      fc::time_point deadline,
                                                      const vector<bytes>& cfd,
                                                      flat_set<public_key_type>& recovered_pub_keys,
-                                                     bool allow_duplicate_keys = false) const;
+                                                     bool allow_duplicate_keys = false,
+                                                     recovered_keys_cache* cache = nullptr) const;
 
       uint32_t total_actions()const { return context_free_actions.size() + actions.size(); }
 
@@ -130,9 +134,16 @@ namespace eosio { namespace chain {
       signature_type            sign(const private_key_type& key, const chain_id_type& chain_id)const;
       fc::microseconds          get_signature_keys( const chain_id_type& chain_id, fc::time_point deadline,
                                                     flat_set<public_key_type>& recovered_pub_keys,
-                                                    bool allow_duplicate_keys = false )const;
+                                                    bool allow_duplicate_keys = false,
+                                                    recovered_keys_cache* cache = nullptr )const;
    };
 
+   /**
+    * A transaction as it travels the network and is stored in blocks. The id, expiration and signing digest come
+    * straight from the packed bytes; the signed_transaction, with its actions and context free data, is unpacked
+    * the first time it is asked for, so a transaction that is only relayed is never unpacked. Immutable once
+    * constructed, safe to share between threads.
+    */
    struct packed_transaction : fc::reflect_init {
       enum class compression_type {
          none = 0,
@@ -141,19 +152,21 @@ namespace eosio { namespace chain {
 
       packed_transaction() = default;
       packed_transaction(packed_transaction&&) = default;
-      explicit packed_transaction(const packed_transaction&) = default;
+      explicit packed_transaction(const packed_transaction&);
       packed_transaction& operator=(const packed_transaction&) = delete;
       packed_transaction& operator=(packed_transaction&&) = default;
 
       explicit packed_transaction(const signed_transaction& t, compression_type _compression = compression_type::none)
-      :signatures(t.signatures), compression(_compression), unpacked_trx(t), trx_id(unpacked_trx.id())
+      :signatures(t.signatures), compression(_compression), trx_id(t.id()), trx_expiration(t.expiration), canonical_trx(true)
+      ,unpacked_trx(std::make_shared<const signed_transaction>(t))
       {
          local_pack_transaction();
          local_pack_context_free_data();
       }
 
       explicit packed_transaction(signed_transaction&& t, compression_type _compression = compression_type::none)
-      :signatures(t.signatures), compression(_compression), unpacked_trx(std::move(t)), trx_id(unpacked_trx.id())
+      :signatures(t.signatures), compression(_compression), trx_id(t.id()), trx_expiration(t.expiration), canonical_trx(true)
+      ,unpacked_trx(std::make_shared<const signed_transaction>(std::move(t)))
       {
          local_pack_transaction();
          local_pack_context_free_data();
@@ -169,21 +182,38 @@ namespace eosio { namespace chain {
 
       digest_type packed_digest()const;
 
+      /// the same packed bytes, signatures and context free data; an equal id alone allows other signatures
+      bool operator==( const packed_transaction& rhs )const;
+      bool operator!=( const packed_transaction& rhs )const { return !(*this == rhs); }
+
       const transaction_id_type& id()const { return trx_id; }
       bytes               get_raw_transaction()const;
 
-      time_point_sec                expiration()const { return unpacked_trx.expiration; }
-      const vector<bytes>&          get_context_free_data()const { return unpacked_trx.context_free_data; }
-      const transaction&            get_transaction()const { return unpacked_trx; }
-      const signed_transaction&     get_signed_transaction()const { return unpacked_trx; }
+      /// the digest the signatures sign, kept for the last chain id asked for
+      digest_type         sig_digest( const chain_id_type& chain_id )const;
+      /// as signed_transaction::get_signature_keys, without unpacking the transaction
+      fc::microseconds    get_signature_keys( const chain_id_type& chain_id, fc::time_point deadline,
+                                              flat_set<public_key_type>& recovered_pub_keys,
+                                              bool allow_duplicate_keys = false,
+                                              recovered_keys_cache* cache = nullptr )const;
+
+      /// true once the signed_transaction has been unpacked
+      bool                          is_unpacked()const { return (bool)std::atomic_load( &unpacked_trx ); }
+
+      time_point_sec                expiration()const { return trx_expiration; }
+      const vector<bytes>&          get_context_free_data()const { return unpacked().context_free_data; }
+      const transaction&            get_transaction()const { return unpacked(); }
+      const signed_transaction&     get_signed_transaction()const { return unpacked(); }
       const vector<signature_type>& get_signatures()const { return signatures; }
       const fc::enum_type<uint8_t,compression_type>& get_compression()const { return compression; }
       const bytes&                  get_packed_context_free_data()const { return packed_context_free_data; }
       const bytes&                  get_packed_transaction()const { return packed_trx; }
 
    private:
-      void local_unpack_transaction(vector<bytes>&& context_free_data);
-      void local_unpack_context_free_data();
+      const signed_transaction& unpacked()const;
+      void local_init_from_packed();
+      signed_transaction local_unpack_transaction(vector<bytes>&& context_free_data)const;
+      vector<bytes> local_unpack_context_free_data()const;
       void local_pack_transaction();
       void local_pack_context_free_data();
 
@@ -198,9 +228,19 @@ namespace eosio { namespace chain {
       bytes                                   packed_trx;
 
    private:
-      // cache unpacked trx, for thread safety do not modify after construction
-      signed_transaction                      unpacked_trx;
+      struct cached_sig_digest {
+         chain_id_type chain_id;
+         digest_type   digest;
+      };
+
+      // derived from the packed bytes, for thread safety do not modify after construction
       transaction_id_type                     trx_id;
+      time_point_sec                          trx_expiration;
+      bool                                    canonical_trx = false; ///< packed_trx decompresses to exactly what fc::raw::pack writes
+
+      // set at most once, on first use; only accessed through std::atomic_load and std::atomic_compare_exchange_strong
+      mutable std::shared_ptr<const signed_transaction> unpacked_trx;
+      mutable std::shared_ptr<const cached_sig_digest>  sig_digest_cache;
    };
 
    using packed_transaction_ptr = std::shared_ptr<packed_transaction>;
@@ -215,5 +255,5 @@ FC_REFLECT( eosio::chain::transaction_header, (expiration)(ref_block_num)(ref_bl
 FC_REFLECT_DERIVED( eosio::chain::transaction, (eosio::chain::transaction_header), (context_free_actions)(actions)(transaction_extensions) )
 FC_REFLECT_DERIVED( eosio::chain::signed_transaction, (eosio::chain::transaction), (signatures)(context_free_data) )
 FC_REFLECT_ENUM( eosio::chain::packed_transaction::compression_type, (none)(zlib))
-// @ignore unpacked_trx
+// @ignore trx_id trx_expiration canonical_trx unpacked_trx sig_digest_cache
 FC_REFLECT( eosio::chain::packed_transaction, (signatures)(compression)(packed_context_free_data)(packed_trx) )
@@ -0,0 +1,30 @@
+#pragma once
+#include <eosio/chain/block.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Partition of the transactions of a block into groups that declare no common account.
+    *
+    * Two input transactions conflict when any of their actions share an account, either as the action's
+    * `account` or as one of its authorizers. Transactions are grouped with union-find over those accounts, so
+    * every pair of transactions in different groups is disjoint in what they declare.
+    *
+    * Declared accounts are only a lower bound on what a transaction touches: notifications, inline actions and
+    * RAM payers are only known after execution. Scheduled (deferred) transactions are not carried in the block,
+    * so they are reported separately in `scheduled` and must be treated as conflicting with every group.
+    */
+   struct transaction_conflict_groups {
+      /// indices into signed_block::transactions, each group in block order, groups ordered by their first index
+      vector<vector<uint32_t>>   groups;
+      /// indices of receipts referencing scheduled transactions by id
+      vector<uint32_t>           scheduled;
+
+      size_t largest_group()const;
+   };
+
+   transaction_conflict_groups compute_transaction_conflict_groups( const signed_block& b );
+
+} } /// eosio::chain
+
+FC_REFLECT( eosio::chain::transaction_conflict_groups, (groups)(scheduled) )
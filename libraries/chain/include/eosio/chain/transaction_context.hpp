@@ -2,10 +2,15 @@
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain/platform_timer.hpp>
+#include <boost/container/pmr/monotonic_buffer_resource.hpp>
 #include <signal.h>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace eosio { namespace chain {
 
+   class account_metadata_object;
+
    struct transaction_checktime_timer {
       public:
          transaction_checktime_timer() = delete;
@@ -101,6 +106,12 @@ namespace eosio { namespace chain {
 
          void disallow_transaction_extensions( const char* error_msg )const;
 
+         /// the metadata of an account the transaction has used, looked up once per transaction; it stays valid because
+         /// chainbase does not move an object when its fields change and accounts are never removed
+         const account_metadata_object& get_account_metadata( account_name account );
+         /// whether account exists; only existing accounts are remembered, as one may be created later in the transaction
+         bool is_account( account_name account )const;
+
       /// Fields:
       public:
 
@@ -133,6 +144,10 @@ namespace eosio { namespace chain {
 
          transaction_checktime_timer   transaction_timer;
 
+         /// backs the short lived bookkeeping containers of the apply_contexts of this transaction,
+         /// grows monotonically and is released in finalize()
+         boost::container::pmr::monotonic_buffer_resource  action_arena{ 16*1024 };
+
       private:
          bool                          is_initialized = false;
 
@@ -153,6 +168,15 @@ namespace eosio { namespace chain {
          fc::time_point                pseudo_start;
          fc::microseconds              billed_time;
          fc::microseconds              billing_timer_duration_limit;
+
+         std::unordered_map<account_name, const account_metadata_object*> account_metadata_cache;
+         mutable std::unordered_set<account_name>                        known_accounts;
+
+         struct pending_ram_usage_entry {
+            uint64_t ram_usage = 0;  ///< of the account when the transaction first changed it
+            int64_t  delta = 0;      ///< changes of the transaction, applied in finalize()
+         };
+         flat_map<account_name, pending_ram_usage_entry> pending_ram_usage;
    };
 
 } }
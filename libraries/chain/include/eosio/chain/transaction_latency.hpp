@@ -0,0 +1,74 @@
+#pragma once
+
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Process wide, optional record of how long each transaction received from a peer or over the API spends in each
+    * stage from receipt to irreversibility, tallied into one latency histogram per stage once its block is irreversible.
+    *
+    * Records are kept by transaction id rather than on transaction_metadata: a transaction is received before its
+    * metadata exists and its metadata is recreated when it is applied again after a fork. At most the enabled number
+    * of transactions is tracked, the oldest record is dropped for a new one, so transactions that expire or fail never
+    * hold memory for long. Stamps of untracked transactions return after one relaxed load when disabled, and after a
+    * lookup under a mutex otherwise.
+    */
+   class transaction_latency {
+   public:
+      enum class stage {
+         key_recovery,     ///< receipt to keys recovered
+         queue,            ///< keys recovered to the start of the last speculative execution
+         execution,        ///< start to end of that execution
+         inclusion,        ///< executed to included in an accepted block
+         irreversibility,  ///< included to irreversible
+         total,            ///< receipt to irreversible
+         count
+      };
+
+      /// inclusive upper bounds of the histogram buckets, one more bucket counts the longer latencies
+      static constexpr std::array<uint32_t, 12> bounds_us = { 1000, 5000, 20000, 100000, 250000, 500000, 1000000, 3000000,
+                                                              10000000, 30000000, 100000000, 300000000 };
+
+      struct stage_stats {
+         std::string           stage;
+         uint64_t              count = 0;
+         uint64_t              sum_us = 0;
+         uint64_t              max_us = 0;
+         uint64_t              p50_us = 0;   ///< upper bound of the bucket holding the percentile, max_us in the last
+         uint64_t              p90_us = 0;
+         uint64_t              p99_us = 0;
+         std::vector<uint64_t> buckets;      ///< bounds_us.size() + 1 counts, not cumulative
+      };
+
+      /// tracks up to max_tracked transactions at once, 0 disables tracking and drops every record
+      static void enable( uint32_t max_tracked );
+      static bool enabled() { return _enabled.load( std::memory_order_relaxed ); }
+
+      /// starts tracking id unless it already is
+      static void received( const transaction_id_type& id );
+      static void keys_recovered( const transaction_id_type& id );
+      /// a speculative execution starts or ends; the last one before inclusion counts
+      static void execution_started( const transaction_id_type& id );
+      static void executed( const transaction_id_type& id );
+      static void included( const signed_block& b );
+      /// tallies and drops the records of the transactions of b
+      static void irreversible( const signed_block& b );
+
+      static const char* stage_name( stage s );
+      static std::vector<stage_stats> all();
+
+   private:
+      static std::atomic<bool> _enabled;
+   };
+
+} } // eosio::chain
+
+FC_REFLECT( eosio::chain::transaction_latency::stage_stats, (stage)(count)(sum_us)(max_us)(p50_us)(p90_us)(p99_us)(buckets) )
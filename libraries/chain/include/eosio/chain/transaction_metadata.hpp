@@ -23,7 +23,8 @@ class transaction_metadata {
       enum class trx_type {
          input,
          implicit,
-         scheduled
+         scheduled,
+         read_only ///< executed against the pending block state and always rolled back
       };
 
    private:
@@ -34,6 +35,7 @@ class transaction_metadata {
    public:
       const bool                                                 implicit;
       const bool                                                 scheduled;
+      const bool                                                 read_only;
       bool                                                       accepted = false;       // not thread safe
       uint32_t                                                   billed_cpu_time_us = 0; // not thread safe
 
@@ -41,7 +43,7 @@ class transaction_metadata {
       struct private_type{};
 
       static void check_variable_sig_size(const packed_transaction_ptr& trx, uint32_t max) {
-         for(const signature_type& sig : trx->get_signed_transaction().signatures)
+         for(const signature_type& sig : trx->get_signatures())
             EOS_ASSERT(sig.variable_size() <= max, sig_variable_size_limit_exception,
                   "signature variable length component size (${s}) greater than subjective maximum (${m})", ("s", sig.variable_size())("m", max));
       }
@@ -50,12 +52,13 @@ class transaction_metadata {
       // creation of tranaction_metadata restricted to start_recover_keys and create_no_recover_keys below, public for make_shared
       explicit transaction_metadata( const private_type& pt, packed_transaction_ptr ptrx,
                                      fc::microseconds sig_cpu_usage, flat_set<public_key_type> recovered_pub_keys,
-                                     bool _implicit = false, bool _scheduled = false)
+                                     bool _implicit = false, bool _scheduled = false, bool _read_only = false)
          : _packed_trx( std::move( ptrx ) )
          , _sig_cpu_usage( sig_cpu_usage )
          , _recovered_pub_keys( std::move( recovered_pub_keys ) )
          , implicit( _implicit )
-         , scheduled( _scheduled ) {
+         , scheduled( _scheduled )
+         , read_only( _read_only ) {
       }
 
       transaction_metadata() = delete;
@@ -71,18 +74,27 @@ class transaction_metadata {
       const flat_set<public_key_type>& recovered_keys()const { return _recovered_pub_keys; }
 
       /// Thread safe.
+      /// @param cache if provided, recovered keys are looked up in and added to it, must outlive the future
       /// @returns transaction_metadata_ptr or exception via future
       static recover_keys_future
       start_recover_keys( packed_transaction_ptr trx, boost::asio::io_context& thread_pool,
                           const chain_id_type& chain_id, fc::microseconds time_limit,
-                          uint32_t max_variable_sig_size = UINT32_MAX );
+                          uint32_t max_variable_sig_size = UINT32_MAX,
+                          recovered_keys_cache* cache = nullptr );
 
       /// @returns constructed transaction_metadata with no key recovery (sig_cpu_usage=0, recovered_pub_keys=empty)
       static transaction_metadata_ptr
       create_no_recover_keys( const packed_transaction& trx, trx_type t ) {
          return std::make_shared<transaction_metadata>( private_type(),
                std::make_shared<packed_transaction>( trx ), fc::microseconds(), flat_set<public_key_type>(),
-                     t == trx_type::implicit, t == trx_type::scheduled );
+                     t == trx_type::implicit, t == trx_type::scheduled, t == trx_type::read_only );
+      }
+
+      static transaction_metadata_ptr
+      create_no_recover_keys( packed_transaction&& trx, trx_type t ) {
+         return std::make_shared<transaction_metadata>( private_type(),
+               std::make_shared<packed_transaction>( std::move( trx ) ), fc::microseconds(), flat_set<public_key_type>(),
+                     t == trx_type::implicit, t == trx_type::scheduled, t == trx_type::read_only );
       }
 
 };
@@ -0,0 +1,58 @@
+#pragma once
+#include <eosio/chain/transaction_metadata.hpp>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio { namespace chain {
+
+   /**
+    * Thread safe, bounded pool of the metadata of transactions whose keys have been recovered, by transaction id.
+    *
+    * A transaction received from a peer or over the API is unpacked and its keys recovered before it is applied; when
+    * it then arrives inside a block, validation takes its metadata from here instead of doing both again. Only the
+    * metadata of exactly the packed transaction of the block is used, as the same id may come with other signatures
+    * or context free data. Entries are spread over independently locked shards like recovered_keys_cache; each shard
+    * evicts its oldest entry once full.
+    */
+   class transaction_metadata_pool {
+      public:
+         /// @param capacity maximum number of pooled transactions, 0 disables the pool
+         explicit transaction_metadata_pool( uint32_t capacity );
+
+         bool enabled()const { return _shard_capacity > 0; }
+
+         /// pools trx, replacing the metadata of another packing of the same transaction; ignored without recovered keys
+         void add( const transaction_metadata_ptr& trx );
+
+         /// @returns the pooled metadata of exactly pt, or null
+         transaction_metadata_ptr find( const packed_transaction& pt );
+
+         size_t size()const;
+         uint64_t hits()const   { return _hits; }
+         uint64_t misses()const { return _misses; }
+
+      private:
+         struct id_hash {
+            size_t operator()( const transaction_id_type& id )const { return id._hash[0]; }
+         };
+
+         struct shard {
+            mutable std::mutex                                                      mtx;
+            std::unordered_map<transaction_id_type, transaction_metadata_ptr, id_hash> trxs;
+            std::deque<transaction_id_type>                                         insertion_order;
+         };
+
+         static constexpr uint32_t num_shards = 16;
+
+         shard& shard_of( const transaction_id_type& id ) { return _shards[id._hash[1] % num_shards]; }
+
+         const size_t                      _shard_capacity;
+         std::array<shard, num_shards>     _shards;
+         std::atomic<uint64_t>             _hits{0};
+         std::atomic<uint64_t>             _misses{0};
+   };
+
+} } /// eosio::chain
@@ -7,6 +7,8 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
 
+#include <random>
+
 #include "multi_index_includes.hpp"
 
 namespace eosio { namespace chain {
@@ -16,6 +18,9 @@ namespace eosio { namespace chain {
     * The purpose of this object is to enable the detection of duplicate transactions. When a transaction is included
     * in a block a transaction_object is added. At the end of block processing all transaction_objects that have
     * expired can be removed from the index.
+    *
+    * Lookups by id are on every incoming transaction, so by_trx_id is hashed; by_id and by_expiration stay ordered,
+    * which keeps snapshots and expiry in a deterministic order.
     */
    class transaction_object : public chainbase::object<transaction_object_type, transaction_object>
    {
@@ -26,13 +31,41 @@ namespace eosio { namespace chain {
          transaction_id_type trx_id; //< trx_id should not be changed within a chainbase modifier lambda
    };
 
+   /**
+    * Transaction ids are chosen by their senders, who can grind them into the same buckets, so the id is mixed with a
+    * random seed picked when the index is created. The hasher is stored with the index in the state file, so the seed
+    * stays the same for as long as the index does.
+    */
+   struct transaction_id_hash {
+      uint64_t seed = random_seed();
+
+      size_t operator()( const transaction_id_type& id )const {
+         uint64_t h = seed;
+         for( uint64_t w : id._hash )
+            h = mix( h ^ w );
+         return h;
+      }
+
+      /// splitmix64 finalizer
+      static uint64_t mix( uint64_t x ) {
+         x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ull;
+         x = (x ^ (x >> 27)) * 0x94d049bb133111ebull;
+         return x ^ (x >> 31);
+      }
+
+      static uint64_t random_seed() {
+         std::random_device rd;
+         return (uint64_t(rd()) << 32) | rd();
+      }
+   };
+
    struct by_expiration;
    struct by_trx_id;
    using transaction_multi_index = chainbase::shared_multi_index_container<
       transaction_object,
       indexed_by<
          ordered_unique< tag<by_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_object::id_type, id)>,
-         ordered_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id)>,
+         hashed_unique< tag<by_trx_id>, BOOST_MULTI_INDEX_MEMBER(transaction_object, transaction_id_type, trx_id), transaction_id_hash>,
          ordered_unique< tag<by_expiration>,
             composite_key< transaction_object,
                BOOST_MULTI_INDEX_MEMBER( transaction_object, time_point_sec, expiration ),
@@ -0,0 +1,62 @@
+#pragma once
+#include <eosio/chain/transaction.hpp>
+#include <fc/io/raw.hpp>
+
+namespace eosio { namespace chain {
+
+   /**
+    * A transaction packed once, for senders of many transactions that differ only in a few fixed size fields.
+    *
+    * The template records where the header and chosen slots of action data sit in the packed bytes, so each copy
+    * costs a memcpy and a few patches rather than a serialization of the whole transaction. A slot must keep its
+    * size, which rules out variable length fields such as strings; these belong in the template itself, or in a
+    * fixed size field such as a nonce.
+    */
+   class transaction_template {
+      public:
+         /// @param trx the transaction copies start from, without signatures; its context free data is empty
+         explicit transaction_template( const transaction& trx );
+
+         /**
+          * @param context_free whether action_index counts context free actions or actions
+          * @param data_offset where the slot starts within the action's data
+          * @returns the index set_slot takes
+          */
+         uint32_t add_data_slot( bool context_free, uint32_t action_index, uint32_t data_offset, uint32_t size );
+
+         const bytes& packed()const { return _packed; }
+
+         /// patches the tapos and expiration of packed, a copy of packed()
+         void set_header( bytes& packed, fc::time_point_sec expiration, const block_id_type& reference_block )const;
+
+         /// patches the slot of packed, a copy of packed(), with v, which must pack to the slot's size
+         template<typename T>
+         void set_slot( bytes& packed, uint32_t slot, const T& v )const {
+            EOS_ASSERT( slot < _slots.size(), transaction_exception, "transaction template has no slot ${s}", ("s", slot) );
+            EOS_ASSERT( fc::raw::pack_size( v ) == _slots[slot].size, transaction_exception,
+                        "value packs to ${n} bytes, slot ${s} holds ${m}", ("n", fc::raw::pack_size( v ))("s", slot)("m", _slots[slot].size) );
+            fc::datastream<char*> ds( packed.data() + _slots[slot].offset, _slots[slot].size );
+            fc::raw::pack( ds, v );
+         }
+
+         /// the digest signatures of packed sign, as transaction::sig_digest gives it for the unpacked transaction
+         static digest_type sig_digest( const bytes& packed, const chain_id_type& chain_id );
+
+         /// packed and its signatures as a packed_transaction, which unpacks the bytes only when asked to
+         static packed_transaction make_packed( bytes&& packed, vector<signature_type>&& sigs );
+
+      private:
+         struct slot {
+            uint32_t offset = 0;
+            uint32_t size = 0;
+         };
+
+         bytes          _packed;
+         vector<slot>   _slots;
+         vector<size_t> _context_free_action_data; ///< offset of each context free action's data
+         vector<size_t> _action_data;              ///< offset of each action's data
+         vector<size_t> _context_free_action_data_size;
+         vector<size_t> _action_data_size;
+   };
+
+} } /// namespace eosio::chain
@@ -8,6 +8,9 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/member.hpp>
+#include <boost/multi_index/composite_key.hpp>
+
+#include <array>
 
 namespace fc {
   inline std::size_t hash_value( const fc::sha256& v ) {
@@ -30,6 +33,8 @@ struct unapplied_transaction {
    const transaction_metadata_ptr trx_meta;
    const fc::time_point           expiry;
    trx_enum_type                  trx_type = trx_enum_type::unknown;
+   int64_t                        priority = 0; ///< higher is applied first within a trx_type
+   uint64_t                       bytes = 0;    ///< approximate memory held by trx_meta, see bytes_of
 
    const transaction_id_type& id()const { return trx_meta->id(); }
 
@@ -42,6 +47,10 @@ struct unapplied_transaction {
 /**
  * Track unapplied transactions for persisted, forked blocks, and aborted blocks.
  * Persisted are first so that they can be applied in each block until expired.
+ * Within a type, transactions are ordered by the priority assigned by the priority function, if any, then FIFO.
+ * The memory held by each type is accounted and may be bounded by set_max_bytes; a type over its bound evicts its
+ * lowest priority and, among those, most recently added transactions, so a flood displaces itself rather than the
+ * transactions queued before it.
  */
 class unapplied_transaction_queue {
 public:
@@ -51,6 +60,8 @@ public:
       speculative_producer       // can produce
    };
 
+   using priority_function = std::function<int64_t(const transaction_metadata_ptr&)>;
+
 private:
    struct by_trx_id;
    struct by_type;
@@ -61,16 +72,90 @@ private:
          hashed_unique< tag<by_trx_id>,
                const_mem_fun<unapplied_transaction, const transaction_id_type&, &unapplied_transaction::id>
          >,
-         ordered_non_unique< tag<by_type>, member<unapplied_transaction, trx_enum_type, &unapplied_transaction::trx_type> >,
+         ordered_non_unique< tag<by_type>,
+               composite_key< unapplied_transaction,
+                  member<unapplied_transaction, trx_enum_type, &unapplied_transaction::trx_type>,
+                  member<unapplied_transaction, int64_t, &unapplied_transaction::priority>
+               >,
+               composite_key_compare< std::less<trx_enum_type>, std::greater<int64_t> >
+         >,
          ordered_non_unique< tag<by_expiry>, member<unapplied_transaction, const fc::time_point, &unapplied_transaction::expiry> >
       >
    > unapplied_trx_queue_type;
 
+   static constexpr size_t num_types = static_cast<size_t>( trx_enum_type::aborted ) + 1;
+
    unapplied_trx_queue_type queue;
    process_mode mode = process_mode::speculative_producer;
+   priority_function priority_of;
+   std::array<uint64_t, num_types> bytes_by_type{};
+   std::array<uint64_t, num_types> max_bytes_by_type{};
+   uint64_t num_evicted = 0;
+
+   int64_t priority( const transaction_metadata_ptr& trx ) const {
+      return priority_of ? priority_of( trx ) : 0;
+   }
+
+   uint64_t& bytes_in( trx_enum_type t ) { return bytes_by_type[static_cast<size_t>( t )]; }
+
+   bool insert( const transaction_metadata_ptr& trx, trx_enum_type t ) {
+      const uint64_t b = bytes_of( trx );
+      auto r = queue.insert( { trx, trx->packed_trx()->expiration(), t, priority( trx ), b } );
+      if( r.second ) bytes_in( t ) += b;
+      return r.second;
+   }
+
+   template<typename Index>
+   typename Index::iterator erase( Index& idx, typename Index::iterator itr ) {
+      bytes_in( itr->trx_type ) -= itr->bytes;
+      return idx.erase( itr );
+   }
+
+   void evict( trx_enum_type t ) {
+      const uint64_t max = max_bytes_by_type[static_cast<size_t>( t )];
+      if( max == 0 ) return;
+      auto& idx = queue.get<by_type>();
+      while( bytes_in( t ) > max ) {
+         // the last of the type is its lowest priority, newest transaction
+         auto itr = idx.upper_bound( boost::make_tuple( t ) );
+         if( itr == idx.begin() ) break;
+         --itr;
+         if( itr->trx_type != t ) break;
+         erase( idx, itr );
+         ++num_evicted;
+      }
+   }
 
 public:
 
+   /// scores transactions as they are added, only affects transactions added afterwards
+   void set_priority_function( priority_function f ) {
+      priority_of = std::move( f );
+   }
+
+   /// bounds the bytes_of the forked or aborted transactions queued, 0 for unbounded; persisted are never evicted
+   void set_max_bytes( trx_enum_type t, uint64_t max ) {
+      FC_ASSERT( t == trx_enum_type::forked || t == trx_enum_type::aborted, "set_max_bytes, only forked or aborted are bounded" );
+      max_bytes_by_type[static_cast<size_t>( t )] = max;
+      evict( t );
+   }
+
+   /// approximation of the memory a queued transaction holds: packed and unpacked transaction, signatures and keys
+   static uint64_t bytes_of( const transaction_metadata_ptr& trx ) {
+      const auto& pt = *trx->packed_trx();
+      return sizeof( unapplied_transaction ) + sizeof( transaction_metadata ) + sizeof( packed_transaction ) +
+             pt.get_packed_transaction().size() * 2 + sizeof( signed_transaction ) +
+             pt.get_packed_context_free_data().size() * 2 +
+             pt.get_signatures().size() * sizeof( signature_type ) +
+             trx->recovered_keys().size() * sizeof( public_key_type );
+   }
+
+   /// bytes_of all transactions queued as t
+   uint64_t bytes( trx_enum_type t ) const { return bytes_by_type[static_cast<size_t>( t )]; }
+
+   /// transactions dropped for exceeding set_max_bytes since construction
+   uint64_t evicted() const { return num_evicted; }
+
    void set_mode( process_mode new_mode ) {
       if( new_mode != mode ) {
          FC_ASSERT( empty(), "set_mode, queue required to be empty" );
@@ -88,10 +173,11 @@ public:
 
    void clear() {
       queue.clear();
+      bytes_by_type.fill( 0 );
    }
 
    bool contains_persisted()const {
-      return queue.get<by_type>().find( trx_enum_type::persisted ) != queue.get<by_type>().end();
+      return queue.get<by_type>().find( boost::make_tuple( trx_enum_type::persisted ) ) != queue.get<by_type>().end();
    }
 
    bool is_persisted(const transaction_metadata_ptr& trx)const {
@@ -114,7 +200,7 @@ public:
             return false;
          }
          callback( persisted_by_expiry.begin()->id(), persisted_by_expiry.begin()->trx_type );
-         persisted_by_expiry.erase( persisted_by_expiry.begin() );
+         erase( persisted_by_expiry, persisted_by_expiry.begin() );
       }
       return true;
    }
@@ -125,10 +211,10 @@ public:
       for( const auto& receipt : bs->block->transactions ) {
          if( receipt.trx.contains<packed_transaction>() ) {
             const auto& pt = receipt.trx.get<packed_transaction>();
-            auto itr = queue.get<by_trx_id>().find( pt.id() );
-            if( itr != queue.get<by_trx_id>().end() ) {
+            auto itr = idx.find( pt.id() );
+            if( itr != idx.end() ) {
                if( itr->trx_type != trx_enum_type::persisted ) {
-                  idx.erase( pt.id() );
+                  erase( idx, itr );
                }
             }
          }
@@ -141,28 +227,28 @@ public:
       for( auto ritr = forked_branch.rbegin(), rend = forked_branch.rend(); ritr != rend; ++ritr ) {
          const block_state_ptr& bsptr = *ritr;
          for( auto itr = bsptr->trxs_metas().begin(), end = bsptr->trxs_metas().end(); itr != end; ++itr ) {
-            const auto& trx = *itr;
-            fc::time_point expiry = trx->packed_trx()->expiration();
-            queue.insert( { trx, expiry, trx_enum_type::forked } );
+            insert( *itr, trx_enum_type::forked );
          }
       }
+      evict( trx_enum_type::forked );
    }
 
    void add_aborted( std::vector<transaction_metadata_ptr> aborted_trxs ) {
       if( mode == process_mode::non_speculative || mode == process_mode::speculative_non_producer ) return;
-      for( auto& trx : aborted_trxs ) {
-         fc::time_point expiry = trx->packed_trx()->expiration();
-         queue.insert( { std::move( trx ), expiry, trx_enum_type::aborted } );
+      for( const auto& trx : aborted_trxs ) {
+         insert( trx, trx_enum_type::aborted );
       }
+      evict( trx_enum_type::aborted );
    }
 
    void add_persisted( const transaction_metadata_ptr& trx ) {
       if( mode == process_mode::non_speculative ) return;
       auto itr = queue.get<by_trx_id>().find( trx->id() );
       if( itr == queue.get<by_trx_id>().end() ) {
-         fc::time_point expiry = trx->packed_trx()->expiration();
-         queue.insert( { trx, expiry, trx_enum_type::persisted } );
+         insert( trx, trx_enum_type::persisted );
       } else if( itr->trx_type != trx_enum_type::persisted ) {
+         bytes_in( itr->trx_type ) -= itr->bytes;
+         bytes_in( trx_enum_type::persisted ) += itr->bytes;
          queue.get<by_trx_id>().modify( itr, [](auto& un){
             un.trx_type = trx_enum_type::persisted;
          } );
@@ -174,10 +260,10 @@ public:
    iterator begin() { return queue.get<by_type>().begin(); }
    iterator end() { return queue.get<by_type>().end(); }
 
-   iterator persisted_begin() { return queue.get<by_type>().lower_bound( trx_enum_type::persisted ); }
-   iterator persisted_end() { return queue.get<by_type>().upper_bound( trx_enum_type::persisted ); }
+   iterator persisted_begin() { return queue.get<by_type>().lower_bound( boost::make_tuple( trx_enum_type::persisted ) ); }
+   iterator persisted_end() { return queue.get<by_type>().upper_bound( boost::make_tuple( trx_enum_type::persisted ) ); }
 
-   iterator erase( iterator itr ) { return queue.get<by_type>().erase( itr ); }
+   iterator erase( iterator itr ) { return erase( queue.get<by_type>(), itr ); }
 
 };
 
@@ -82,7 +82,28 @@ namespace eosio { namespace chain {
             eos_vm_oc
          };
 
-         wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config);
+         //per code execution counters split by the tier that served each apply
+         struct code_execution_stats {
+            digest_type                    code_hash;
+            uint8_t                        vm_version = 0;
+            uint64_t                       baseline_executions = 0;
+            fc::microseconds               baseline_time;
+            uint64_t                       oc_executions = 0;
+            fc::microseconds               oc_time;
+            //time from the first tier-up request to the compiled code being available, if it has been compiled
+            fc::optional<fc::microseconds> oc_compile_latency;
+         };
+
+         struct execution_stats {
+            std::vector<code_execution_stats> codes;
+            uint64_t                          oc_cache_hits = 0;
+            uint64_t                          oc_cache_misses = 0;
+            uint64_t                          oc_cache_evictions = 0;
+         };
+
+         //instantiation_cache_size bounds the wasm code bytes of modules kept instantiated, least recently used are dropped first
+         wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config,
+                        uint64_t instantiation_cache_size);
          ~wasm_interface();
 
          //call before dtor to skip what can be minutes of dtor overhead with some runtimes; can cause leaks
@@ -90,6 +111,12 @@ namespace eosio { namespace chain {
 
          //validates code -- does a WASM validation pass and checks the wasm against EOSIO specific constraints
          static void validate(const controller& control, const bytes& code);
+         //as above, for code already hashed; a code that validated before under the same conditions is not validated again
+         static void validate(const controller& control, const digest_type& code_hash, const bytes& code);
+         //how many validations the validated code cache has answered, process wide
+         static uint64_t validation_cache_hits();
+         //as above, and keeps the module parsed for validating a new code for its first instantiation, which then does not parse it again
+         void validate_new_code(const controller& control, const digest_type& code_hash, const bytes& code);
 
          //indicate that a particular code probably won't be used after given block_num
          void code_block_num_last_used(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, const uint32_t& block_num);
@@ -97,12 +124,22 @@ namespace eosio { namespace chain {
          //indicate the current LIB. evicts old cache entries
          void current_lib(const uint32_t lib);
 
+         //compile the contracts that were used the most on previous runs ahead of time. no-op unless EOS VM OC tier-up is enabled
+         void warm_up_code_cache();
+
          //Calls apply or error on a given code
          void apply(const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, apply_context& context);
 
          //Immediately exits currently running wasm. UB is called when no wasm running
          void exit();
 
+         //execution counters for every code applied since startup along with EOS VM OC code cache counters
+         execution_stats get_execution_stats() const;
+
+         //name of the EOS VM OC compiled code at the given offset in to the code cache as "eosvmoc:<code hash>:<function index>",
+         // the function index being absent when not known. Empty if the offset is not in any cached code
+         std::string eosvmoc_function_name(size_t cache_offset) const;
+
       private:
          unique_ptr<struct wasm_interface_impl> my;
          friend class eosio::chain::webassembly::common::intrinsics_accessor;
@@ -115,3 +152,6 @@ namespace eosio{ namespace chain {
 }}
 
 FC_REFLECT_ENUM( eosio::chain::wasm_interface::vm_type, (wabt)(eos_vm)(eos_vm_jit)(eos_vm_oc) )
+FC_REFLECT( eosio::chain::wasm_interface::code_execution_stats, (code_hash)(vm_version)(baseline_executions)(baseline_time)
+                                                                (oc_executions)(oc_time)(oc_compile_latency) )
+FC_REFLECT( eosio::chain::wasm_interface::execution_stats, (codes)(oc_cache_hits)(oc_cache_misses)(oc_cache_evictions) )
@@ -15,6 +15,10 @@
 #include <eosio/chain/exceptions.hpp>
 #include <fc/scoped_exit.hpp>
 
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <map>
+
 #include "IR/Module.h"
 #include "Runtime/Intrinsics.h"
 #include "Platform/Platform.h"
@@ -40,6 +44,14 @@ namespace eosio { namespace chain {
    namespace eosvmoc { struct config; }
 
    struct wasm_interface_impl {
+      //a code parsed, injected and serialized again, ready to instantiate
+      struct prepared_code {
+         std::vector<U8>      bytes;
+         std::vector<uint8_t> initial_memory;
+
+         size_t size() const { return bytes.size() + initial_memory.size(); }
+      };
+
       struct wasm_cache_entry {
          digest_type                                          code_hash;
          uint32_t                                             first_block_num_used;
@@ -47,21 +59,34 @@ namespace eosio { namespace chain {
          std::unique_ptr<wasm_instantiated_module_interface>  module;
          uint8_t                                              vm_type = 0;
          uint8_t                                              vm_version = 0;
+         size_t                                               code_size = 0;   //size of the wasm behind module, 0 while not instantiated
+         //kept after module is dropped so instantiating it again skips parsing and injection
+         std::unique_ptr<const prepared_code>                 prepared;
       };
       struct by_hash;
       struct by_first_block_num;
       struct by_last_block_num;
+      struct by_recent_use;
+
+      struct code_tier_counters {
+         uint8_t          vm_type = 0;
+         uint64_t         baseline_executions = 0;
+         fc::microseconds baseline_time;
+         uint64_t         oc_executions = 0;
+         fc::microseconds oc_time;
+      };
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       struct eosvmoc_tier {
          eosvmoc_tier(const boost::filesystem::path& d, const eosvmoc::config& c, const chainbase::database& db) : cc(d, c, db), exec(cc) {}
          eosvmoc::code_cache_async cc;
-         eosvmoc::executor exec;
-         eosvmoc::memory mem;
+         eosvmoc::executor_pool exec;
       };
 #endif
 
-      wasm_interface_impl(wasm_interface::vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config) : db(d), wasm_runtime_time(vm) {
+      wasm_interface_impl(wasm_interface::vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config,
+                          uint64_t instantiation_cache_size)
+         : db(d), wasm_runtime_time(vm), instantiation_cache_size(instantiation_cache_size) {
          if(vm == wasm_interface::vm_type::wabt)
             runtime_interface = std::make_unique<webassembly::wabt_runtime::wabt_runtime>();
 #ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
@@ -122,14 +147,121 @@ namespace eosio { namespace chain {
       }
 
       void current_lib(uint32_t lib) {
-         //anything last used before or on the LIB can be evicted
-         const auto first_it = wasm_instantiation_cache.get<by_last_block_num>().begin();
-         const auto last_it  = wasm_instantiation_cache.get<by_last_block_num>().upper_bound(lib);
+         //anything last used before or on the LIB can be evicted, unless the code is still deployed. That happens when the
+         // block replacing the code was forked out, or when another account runs the same code
+         auto& by_last_block = wasm_instantiation_cache.get<by_last_block_num>();
+         for(auto it = by_last_block.begin(); it != by_last_block.end() && it->last_block_num_used <= lib;) {
+            if(db.find<code_object,by_code_hash>(boost::make_tuple(it->code_hash, it->vm_type, it->vm_version))) {
+               auto next = std::next(it);
+               by_last_block.modify(it, [](wasm_cache_entry& e) {
+                  e.last_block_num_used = UINT32_MAX;
+               });
+               it = next;
+               continue;
+            }
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
-         if(eosvmoc) for(auto it = first_it; it != last_it; it++)
-            eosvmoc->cc.free_code(it->code_hash, it->vm_version);
+            if(eosvmoc)
+               eosvmoc->cc.free_code(it->code_hash, it->vm_version);
 #endif
-         wasm_instantiation_cache.get<by_last_block_num>().erase(first_it, last_it);
+            code_tier_stats.erase(std::make_pair(it->code_hash, it->vm_version));
+            instantiated_code_bytes -= it->code_size;
+            prepared_code_bytes -= it->prepared ? it->prepared->size() : 0;
+            it = by_last_block.erase(it);
+         }
+      }
+
+      //counters for code only run by EOS VM OC never pass through the instantiation cache, so a full map is swept for
+      // code that is no longer deployed before a new code is counted
+      code_tier_counters* find_or_add_code_tier_counters(const digest_type& code_hash, uint8_t vm_type, uint8_t vm_version) {
+         const auto key = std::make_pair(code_hash, vm_version);
+         auto it = code_tier_stats.find(key);
+         if(it != code_tier_stats.end())
+            return &it->second;
+         if(code_tier_stats.size() >= max_code_tier_stats) {
+            for(auto i = code_tier_stats.begin(); i != code_tier_stats.end();) {
+               if(db.find<code_object,by_code_hash>(boost::make_tuple(i->first.first, i->second.vm_type, i->first.second)))
+                  ++i;
+               else
+                  i = code_tier_stats.erase(i);
+            }
+            if(code_tier_stats.size() >= max_code_tier_stats)
+               return nullptr;
+         }
+         code_tier_counters& counters = code_tier_stats[key];
+         counters.vm_type = vm_type;
+         return &counters;
+      }
+
+      //drops the least recently used instantiated modules until the cache is back within its budget, never the one at keep;
+      //prepared codes have a budget of the same size of their own
+      void trim_instantiation_cache(const wasm_cache_entry& keep) {
+         auto& by_use = wasm_instantiation_cache.get<by_recent_use>();
+         for(auto it = by_use.rbegin(); it != by_use.rend() && instantiated_code_bytes > instantiation_cache_size; ++it) {
+            if(!it->module || &*it == &keep)
+               continue;
+            instantiated_code_bytes -= it->code_size;
+            by_use.modify(std::prev(it.base()), [](wasm_cache_entry& e) {
+               e.module.reset();
+               e.code_size = 0;
+            });
+         }
+         for(auto it = by_use.rbegin(); it != by_use.rend() && prepared_code_bytes > instantiation_cache_size; ++it) {
+            if(!it->prepared || &*it == &keep)
+               continue;
+            prepared_code_bytes -= it->prepared->size();
+            by_use.modify(std::prev(it.base()), [](wasm_cache_entry& e) {
+               e.prepared.reset();
+            });
+         }
+      }
+
+      //keeps a module setcode validated until its code is first instantiated; a code set but never run is pushed out by later ones
+      void keep_parsed(const digest_type& code_hash, IR::Module&& module) {
+         for(const auto& p : parsed_codes)
+            if(p.first == code_hash)
+               return;
+         if(parsed_codes.size() >= max_parsed_codes)
+            parsed_codes.erase(parsed_codes.begin());
+         parsed_codes.emplace_back(code_hash, std::move(module));
+      }
+
+      std::unique_ptr<const prepared_code> prepare_code(const code_object& codeobject) {
+         auto prepared = std::make_unique<prepared_code>();
+         IR::Module module;
+         codeobject.with_code([&](std::string_view wasm) {
+            prepared->bytes = {(const U8*)wasm.data(), (const U8*)wasm.data() + wasm.size()};
+         });
+         auto parsed = std::find_if(parsed_codes.begin(), parsed_codes.end(), [&](const auto& p) { return p.first == codeobject.code_hash; });
+         if(parsed != parsed_codes.end()) {
+            module = std::move(parsed->second);
+            parsed_codes.erase(parsed);
+         } else {
+            try {
+               Serialization::MemoryInputStream stream((const U8*)prepared->bytes.data(),
+                                                       prepared->bytes.size());
+               WASM::serialize(stream, module);
+            } catch (const Serialization::FatalSerializationException& e) {
+               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+            } catch (const IR::ValidationException& e) {
+               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+            }
+         }
+         module.userSections.clear();
+         if (runtime_interface->inject_module(module)) {
+            try {
+               Serialization::ArrayOutputStream outstream;
+               WASM::serialize(outstream, module);
+               prepared->bytes = outstream.getBytes();
+            } catch (const Serialization::FatalSerializationException& e) {
+               EOS_ASSERT(false, wasm_serialization_error,
+                          e.message.c_str());
+            } catch (const IR::ValidationException& e) {
+               EOS_ASSERT(false, wasm_serialization_error,
+                          e.message.c_str());
+            }
+         }
+         prepared->initial_memory = parse_initial_memory(module);
+         return prepared;
       }
 
       const std::unique_ptr<wasm_instantiated_module_interface>& get_instantiated_module( const digest_type& code_hash, const uint8_t& vm_type,
@@ -150,6 +282,8 @@ namespace eosio { namespace chain {
                                                       .vm_version = vm_version
                                                    } ).first;
          }
+         auto& by_use = wasm_instantiation_cache.get<by_recent_use>();
+         by_use.relocate(by_use.begin(), wasm_instantiation_cache.project<by_recent_use>(it));
 
          if(!it->module) {
             if(!codeobject)
@@ -159,37 +293,21 @@ namespace eosio { namespace chain {
                trx_context.resume_billing_timer();
             });
             trx_context.pause_billing_timer();
-            IR::Module module;
-            std::vector<U8> bytes = {
-                (const U8*)codeobject->code.data(),
-                (const U8*)codeobject->code.data() + codeobject->code.size()};
-            try {
-               Serialization::MemoryInputStream stream((const U8*)bytes.data(),
-                                                       bytes.size());
-               WASM::serialize(stream, module);
-               module.userSections.clear();
-            } catch (const Serialization::FatalSerializationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            } catch (const IR::ValidationException& e) {
-               EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-            }
-            if (runtime_interface->inject_module(module)) {
-               try {
-                  Serialization::ArrayOutputStream outstream;
-                  WASM::serialize(outstream, module);
-                  bytes = outstream.getBytes();
-               } catch (const Serialization::FatalSerializationException& e) {
-                  EOS_ASSERT(false, wasm_serialization_error,
-                             e.message.c_str());
-               } catch (const IR::ValidationException& e) {
-                  EOS_ASSERT(false, wasm_serialization_error,
-                             e.message.c_str());
-               }
+            if(!it->prepared) {
+               auto prepared = prepare_code(*codeobject);
+               prepared_code_bytes += prepared->size();
+               wasm_instantiation_cache.modify(it, [&](auto& c) {
+                  c.prepared = std::move(prepared);
+               });
             }
 
+            const prepared_code& prepared = *it->prepared;
             wasm_instantiation_cache.modify(it, [&](auto& c) {
-               c.module = runtime_interface->instantiate_module((const char*)bytes.data(), bytes.size(), parse_initial_memory(module), code_hash, vm_type, vm_version);
+               c.module = runtime_interface->instantiate_module((const char*)prepared.bytes.data(), prepared.bytes.size(), prepared.initial_memory, code_hash, vm_type, vm_version);
+               c.code_size = codeobject->code_size();
             });
+            instantiated_code_bytes += it->code_size;
+            trim_instantiation_cache(*it);
          }
          return it->module;
       }
@@ -208,14 +326,24 @@ namespace eosio { namespace chain {
                >
             >,
             ordered_non_unique<tag<by_first_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::first_block_num_used>>,
-            ordered_non_unique<tag<by_last_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::last_block_num_used>>
+            ordered_non_unique<tag<by_last_block_num>, member<wasm_cache_entry, uint32_t, &wasm_cache_entry::last_block_num_used>>,
+            sequenced<tag<by_recent_use>>
          >
       > wasm_cache_index;
       wasm_cache_index wasm_instantiation_cache;
+      const uint64_t   instantiation_cache_size;
+      uint64_t         instantiated_code_bytes = 0;
+      uint64_t         prepared_code_bytes = 0;
+
+      static constexpr size_t max_parsed_codes = 4;
+      std::vector<std::pair<digest_type, IR::Module>> parsed_codes;
 
       const chainbase::database& db;
       const wasm_interface::vm_type wasm_runtime_time;
 
+      static constexpr size_t max_code_tier_stats = 4096;
+      std::map<std::pair<digest_type, uint8_t>, code_tier_counters> code_tier_stats;
+
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
       fc::optional<eosvmoc_tier> eosvmoc;
 #endif
@@ -16,6 +16,9 @@
 
 #include <boost/hana/equal.hpp>
 
+#include <algorithm>
+#include <utility>
+
 namespace eosio { namespace chain { namespace webassembly { namespace eosvmoc {
 
 using namespace IR;
@@ -39,8 +42,7 @@ class eosvmoc_runtime : public eosio::chain::wasm_runtime_interface {
 
       friend eosvmoc_instantiated_module;
       eosvmoc::code_cache_sync cc;
-      eosvmoc::executor exec;
-      eosvmoc::memory mem;
+      eosvmoc::executor_pool exec;
 };
 
 /**
@@ -75,6 +77,37 @@ inline array_ptr<T> array_ptr_impl (size_t ptr, size_t length)
    return array_ptr<T>((T*)ptr);
 }
 
+/**
+ * validates two in-wasm-memory arrays that share a length with a single range check: both arrays are in bounds
+ * exactly when the one starting higher up in linear memory is
+ */
+template<typename T, typename U>
+inline std::pair<array_ptr<T>, array_ptr<U>> array_ptr_pair_impl (size_t ptr_t, size_t ptr_u, size_t length)
+{
+   static_assert(sizeof(T) == sizeof(U), "arrays sharing a length must have the same element size");
+   constexpr int cb_full_linear_memory_start_segment_offset = OFFSET_OF_CONTROL_BLOCK_MEMBER(full_linear_memory_start);
+   constexpr int cb_first_invalid_memory_address_segment_offset = OFFSET_OF_CONTROL_BLOCK_MEMBER(first_invalid_memory_address);
+
+   size_t end = std::max(ptr_t, ptr_u) + length*sizeof(T);
+
+   asm volatile("cmp %%gs:%c[firstInvalidMemory], %[End]\n"
+                "jle 1f\n"
+                "mov %%gs:%c[maximumEosioWasmMemory], %[PtrT]\n"     //always invalid address
+                "1:\n"
+                "add %%gs:%c[linearMemoryStart], %[PtrT]\n"
+                "add %%gs:%c[linearMemoryStart], %[PtrU]\n"
+                : [PtrT] "+r" (ptr_t),
+                  [PtrU] "+r" (ptr_u),
+                  [End] "+r" (end)
+                : [linearMemoryStart] "i" (cb_full_linear_memory_start_segment_offset),
+                  [firstInvalidMemory] "i" (cb_first_invalid_memory_address_segment_offset),
+                  [maximumEosioWasmMemory] "i" (wasm_constraints::maximum_linear_memory)
+                : "cc"
+               );
+
+   return {array_ptr<T>((T*)ptr_t), array_ptr<U>((U*)ptr_u)};
+}
+
 /**
  * class to represent an in-wasm-memory char array that must be null terminated
  */
@@ -536,7 +569,8 @@ struct intrinsic_invoker_impl<is_injected, Ret, std::tuple<array_ptr<T>, array_p
    static Ret translate_one(Inputs... rest, Translated... translated, I32 ptr_t, I32 ptr_u, I32 size) {
       static_assert(std::is_same<std::remove_const_t<T>, char>::value && std::is_same<std::remove_const_t<U>, char>::value, "Currently only support array of (const)chars");
       const auto length = size_t((U32)size);
-      return Then(array_ptr_impl<T>((U32)ptr_t, length), array_ptr_impl<U>((U32)ptr_u, length), length, rest..., translated...);
+      const auto [array_t, array_u] = array_ptr_pair_impl<T, U>((U32)ptr_t, (U32)ptr_u, length);
+      return Then(array_t, array_u, length, rest..., translated...);
    };
 
    template<then_type Then>
@@ -14,7 +14,11 @@
 #include <boost/asio/local/datagram_protocol.hpp>
 
 
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <thread>
+#include <unordered_map>
 
 namespace std {
     template<> struct hash<eosio::chain::eosvmoc::code_tuple> {
@@ -43,8 +47,56 @@ class code_cache_base {
 
       const int& fd() const { return _cache_fd; }
 
+      //True when running code from a cache another process owns and shares; such a cache never compiles
+      bool is_shared_follower() const { return _follower; }
+
+      //Changes whenever fd() refers to another file: a follower re-attaches once the owner has recreated the cache file,
+      // and mappings of the previous file must not be used for code looked up since
+      uint64_t mapping_instance() const { return _mapping_instance; }
+
+      //Held across looking up and executing code. In a follower it holds the cache file shared flock()ed, which the owner
+      // takes exclusively to deallocate code, so the code can't be evicted and overwritten while it runs
+      class execution_lock {
+         public:
+            execution_lock() = default;
+            execution_lock(execution_lock&& o) : _cc(o._cc) { o._cc = nullptr; }
+            execution_lock& operator=(execution_lock&& o);
+            ~execution_lock();
+         private:
+            friend class code_cache_base;
+            explicit execution_lock(code_cache_base& cc) : _cc(&cc) { cc._follower_locked = true; }
+            code_cache_base* _cc = nullptr;
+      };
+      //A follower does not wait for the lock: while an eviction is announced or under way it gets no lock, and so no code
+      // from the cache, and runs on the base runtime instead. Readers therefore never hold off an eviction indefinitely
+      execution_lock lock_for_execution();
+
+      //Every deallocation of code in a shared cache is done between these, with the cache file exclusively flock()ed in
+      // between. begin announces the eviction so followers stop taking the lock; end moves the eviction generation
+      // before the lock is released, so followers know to reload the index
+      static void begin_eviction(char* cache_mapping);
+      static void end_eviction(char* cache_mapping);
+
       void free_code(const digest_type& code_id, const uint8_t& vm_version);
 
+      struct cache_stats {
+         uint64_t hits = 0;
+         uint64_t misses = 0;
+         uint64_t evictions = 0;
+      };
+      const cache_stats& stats() const { return _stats; }
+
+      //time from first request to compiled code for each code compiled since startup that is still in use
+      const std::unordered_map<code_tuple, fc::microseconds>& compile_latencies() const { return _compile_latencies; }
+
+      struct code_function {
+         digest_type code_hash;
+         uint8_t vm_version;
+         fc::optional<uint32_t> function_index; //unknown for code compiled before a restart
+      };
+      //the cached code, and the wasm function in it when known, that the given offset in to the cache file falls in
+      fc::optional<code_function> function_at(size_t cache_offset) const;
+
    protected:
       struct by_hash;
 
@@ -73,9 +125,17 @@ class code_cache_base {
 
       //these are really only useful to the async code cache, but keep them here so
       //free_code can be shared
-      std::unordered_set<code_tuple> _queued_compiles;
+      //queued compiles map to their priority: baseline cpu time (us) spent on the code while it waited, plus one per use
+      std::unordered_map<code_tuple, uint64_t> _queued_compiles;
       std::unordered_map<code_tuple, bool> _outstanding_compiles_and_poison;
 
+      cache_stats _stats;
+      std::unordered_map<code_tuple, fc::time_point>   _compile_requested;
+      std::unordered_map<code_tuple, fc::microseconds> _compile_latencies;
+      //function tables of the codes compiled since startup, ordered by offset. Not persisted with the cache index
+      std::unordered_map<code_tuple, std::vector<compiled_function>> _function_tables;
+      void add_function_table(const code_tuple& code, std::vector<compiled_function> functions);
+
       size_t _free_bytes_eviction_threshold;
       void check_eviction_threshold(size_t free_bytes);
       void run_eviction_round();
@@ -84,6 +144,72 @@ class code_cache_base {
 
       template <typename T>
       void serialize_cache_index(fc::datastream<T>& ds);
+
+      //index of the cache as published by an owner for followers, next to the cache file. An owner (re)writes it before
+      // code leaves the cache; a follower reloads it whenever the eviction generation moves, and checks for new code
+      // at most once a second
+      bfs::path _shared_index_path;
+      bool _share = false;
+      void publish_index();
+
+      bool _follower = false;
+      uint64_t _mapping_instance = 0;
+      uint64_t _follower_dev = 0;
+      uint64_t _follower_ino = 0;
+      size_t _follower_mapping_size = 0;
+      const char* _follower_header = nullptr;
+      uint64_t _follower_generation = 0;
+      bool _follower_locked = false;
+      fc::time_point _follower_last_check;
+      int64_t _follower_index_mtime = 0;
+      void attach_to_shared_cache(const bfs::path& dir);
+      //switches to the cache file now at the shared path if it is the one the index is for, dev and ino
+      bool reattach_to_shared_cache(uint64_t dev, uint64_t ino);
+      void load_shared_index();
+      const code_descriptor* get_shared_descriptor(const digest_type& code_id, const uint8_t& vm_version);
+};
+
+//How often each code was used, to pick the contracts to warm up. Holds at most max_entries codes: past that every count
+// is halved and the codes it takes to zero are forgotten, so usage decays and codes no longer used make room.
+class usage_counts {
+   public:
+      explicit usage_counts(size_t max_entries) : _max_entries(std::max<size_t>(max_entries, 1)) {}
+
+      void add(const code_tuple& ct, uint64_t count = 1) {
+         _counts[ct] += count;
+         while(_counts.size() > _max_entries)
+            decay();
+      }
+
+      //halves every count, forgetting the codes whose count reaches zero
+      void decay() {
+         for(auto it = _counts.begin(); it != _counts.end();) {
+            it->second /= 2;
+            if(it->second)
+               ++it;
+            else
+               it = _counts.erase(it);
+         }
+      }
+
+      //at most n codes with their counts, most used first
+      std::vector<std::pair<code_tuple, uint64_t>> hottest(size_t n) const {
+         std::vector<std::pair<code_tuple, uint64_t>> entries(_counts.begin(), _counts.end());
+         n = std::min(n, entries.size());
+         std::partial_sort(entries.begin(), entries.begin() + n, entries.end(), [](const auto& a, const auto& b) {
+            return a.second > b.second;
+         });
+         entries.resize(n);
+         return entries;
+      }
+
+      size_t size() const { return _counts.size(); }
+      bool empty() const { return _counts.empty(); }
+      void clear() { _counts.clear(); }
+
+   private:
+      size_t _max_entries;
+      std::unordered_map<code_tuple, uint64_t> _counts;
 };
 
 class code_cache_async : public code_cache_base {
@@ -96,13 +222,40 @@ class code_cache_async : public code_cache_base {
       //otherwise: return nullptr
       const code_descriptor* const get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version);
 
+      //Records cpu time spent running code on the baseline runtime; raises its priority if it is waiting to be compiled
+      void record_baseline_execution(const digest_type& code_id, const uint8_t& vm_version, const fc::microseconds& elapsed);
+
+      //Compiles the most used contracts recorded on previous runs that are not already in the cache, most used first.
+      // Blocks until those compiles complete. Does nothing unless warmup_contracts is configured.
+      void warm_up();
+
+      //Compiles each listed code that is still deployed and not already in the cache, in order, stopping once
+      // max_codes of them are cached. Blocks until those compiles complete. Returns the number of listed codes cached or
+      // sent for compilation and how many of those were compiled
+      std::tuple<size_t, size_t> compile_blocking(const std::vector<code_tuple>& codes, size_t max_codes);
+
    private:
       std::thread _monitor_reply_thread;
-      boost::lockfree::spsc_queue<wasm_compilation_result_message> _result_queue;
+      struct compile_result {
+         wasm_compilation_result_message message;
+         std::vector<compiled_function> functions;
+      };
+      boost::lockfree::spsc_queue<compile_result> _result_queue;
+      //signaled when a result is queued or the compile monitor went away, for compile_blocking() to wait on
+      std::mutex _result_mtx;
+      std::condition_variable _result_cv;
+      void notify_result();
       void wait_on_compile_monitor_message();
       std::tuple<size_t, size_t> consume_compile_thread_queue();
       std::unordered_set<code_tuple> _blacklist;
       size_t _threads;
+
+      //usage statistics persisted across restarts to drive warm_up()
+      bfs::path _usage_file_path;
+      size_t _warmup_contracts;
+      usage_counts _usage_counts;
+      void load_usage_counts();
+      void save_usage_counts();
 };
 
 class code_cache_sync : public code_cache_base {
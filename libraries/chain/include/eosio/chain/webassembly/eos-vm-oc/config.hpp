@@ -13,6 +13,9 @@ namespace eosio { namespace chain { namespace eosvmoc {
 struct config {
    uint64_t cache_size = 1024u*1024u*1024u;
    uint64_t threads    = 1u;
+   uint64_t warmup_contracts = 0u; ///< number of most used contracts, as recorded on the previous run, to compile at startup
+   bool     share_cache = false;   ///< publish the cache index so other processes can run code from this cache
+   boost::filesystem::path shared_cache_dir; ///< when set, run code from the cache another process shares from here, compiling nothing
 };
 
 }}}
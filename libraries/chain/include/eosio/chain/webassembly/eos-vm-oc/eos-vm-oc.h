@@ -35,4 +35,7 @@ struct eos_vm_oc_control_block {
    uintptr_t running_code_base;
    int64_t  first_invalid_memory_address;
    unsigned is_running;
+   //values of the running action read directly by compiled code in place of the intrinsics of the same name
+   uint64_t current_receiver;
+   uint32_t action_data_size;
 };
\ No newline at end of file
@@ -7,6 +7,8 @@
 
 #include <list>
 #include <vector>
+#include <memory>
+#include <mutex>
 #include <cstddef>
 
 namespace eosio { namespace chain {
@@ -19,6 +21,10 @@ class code_cache_base;
 class memory;
 struct code_descriptor;
 
+//Async signal safe, for profilers. True if EOS VM OC code is running on the calling thread and pc is in the code cache
+// mapping of the executor running it, in which case cache_offset is set to the offset of pc in to the code cache file
+bool executing_code_cache_offset(uintptr_t pc, size_t& cache_offset) noexcept;
+
 class executor {
    public:
       executor(const code_cache_base& cc);
@@ -26,8 +32,12 @@ class executor {
 
       void execute(const code_descriptor& code, const memory& mem, apply_context& context);
 
+      //the code_cache_base::mapping_instance() of the cache file this executor mapped
+      uint64_t cache_instance() const { return code_mapping_instance; }
+
    private:
       uint8_t* code_mapping;
+      uint64_t code_mapping_instance;
       size_t code_mapping_size;
       bool mapping_is_executable;
 
@@ -36,4 +46,27 @@ class executor {
       std::list<std::vector<std::byte>> executors_bounce_buffers;
 };
 
+/**
+ * A set of executor and memory pairs allowing actions to execute on several threads at once. Each execution borrows
+ * an idle pair for its duration; pairs are created on first demand and kept for reuse, so a caller that only ever
+ * executes from one thread at a time keeps using a single pair.
+ */
+class executor_pool {
+   public:
+      executor_pool(const code_cache_base& cc);
+      ~executor_pool();
+
+      void execute(const code_descriptor& code, apply_context& context);
+
+   private:
+      struct execution_context;
+
+      std::unique_ptr<execution_context> acquire();
+      void release(std::unique_ptr<execution_context>&& ctx);
+
+      const code_cache_base&                          _cc;
+      std::mutex                                      _idle_mtx;
+      std::vector<std::unique_ptr<execution_context>> _idle;
+};
+
 }}}
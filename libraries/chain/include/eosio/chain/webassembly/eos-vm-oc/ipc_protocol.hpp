@@ -34,7 +34,13 @@ struct code_compilation_result_message {
    unsigned apply_offset;
    int starting_memory_pages;
    unsigned initdata_prologue_size;
-   //Two sent fds: 1) wasm code, 2) initial memory snapshot
+   //Three sent fds: 1) wasm code, 2) initial memory snapshot, 3) packed vector<compiled_function> of the code
+};
+
+//where the code of a function defined by the wasm starts, relative to the code's beginning; index counts imports too
+struct compiled_function {
+   uint32_t index;
+   uint32_t offset;
 };
 
 
@@ -49,6 +55,7 @@ struct wasm_compilation_result_message {
    code_tuple code;
    wasm_compilation_result result;
    size_t cache_free_bytes;
+   //A successful compile sends one fd: the compiled_function table from the compile
 };
 
 using eosvmoc_message = fc::static_variant<initialize_message,
@@ -66,6 +73,7 @@ FC_REFLECT(eosio::chain::eosvmoc::code_tuple, (code_id)(vm_version))
 FC_REFLECT(eosio::chain::eosvmoc::compile_wasm_message, (code))
 FC_REFLECT(eosio::chain::eosvmoc::evict_wasms_message, (codes))
 FC_REFLECT(eosio::chain::eosvmoc::code_compilation_result_message, (start)(apply_offset)(starting_memory_pages)(initdata_prologue_size))
+FC_REFLECT(eosio::chain::eosvmoc::compiled_function, (index)(offset))
 FC_REFLECT(eosio::chain::eosvmoc::compilation_result_unknownfailure, )
 FC_REFLECT(eosio::chain::eosvmoc::compilation_result_toofull, )
 FC_REFLECT(eosio::chain::eosvmoc::wasm_compilation_result_message, (code)(result)(cache_free_bytes))
\ No newline at end of file
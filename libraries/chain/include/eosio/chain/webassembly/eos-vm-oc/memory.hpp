@@ -26,6 +26,10 @@ class memory {
 
       static constexpr uint64_t number_slices = wasm_memory_size/(64u*1024u)+1u;
 
+      //wasm pages at the start of linear memory that reset() zeros in place, pages above are released back to the
+      // kernel so that pages an action never touched cost nothing to reset
+      static constexpr uint64_t memset_reset_pages = 16u;
+
    public:
       memory();
       ~memory();
@@ -35,6 +39,9 @@ class memory {
 
       control_block* const get_control_block() const { return reinterpret_cast<control_block* const>(zeropage_base - cb_offset);}
 
+      //zero the first `pages` wasm pages of linear memory; linear memory is all zero between executions
+      void reset(uint64_t pages) const;
+
       //these two are really only inteded for SEGV handling
       uint8_t* const start_of_memory_slices() const { return mapbase; }
       size_t size_of_memory_slice_mapping() const { return mapsize; }
@@ -52,6 +59,7 @@ class memory {
       static_assert(stride == EOS_VM_OC_MEMORY_STRIDE, "EOS VM OC memory stride has slid out of place somehow");
 
    private:
+      int      fd;
       uint8_t* mapbase;
       uint64_t mapsize;
 
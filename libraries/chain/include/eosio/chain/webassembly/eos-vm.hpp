@@ -129,7 +129,8 @@ class eos_vm_runtime : public eosio::chain::wasm_runtime_interface {
       // todo: managing this will get more complicated with sync calls;
       //       immediately_exit_currently_running_module() should probably
       //       move from wasm_runtime_interface to wasm_instantiated_module_interface.
-      backend<apply_context, Backend>* _bkend = nullptr;  // non owning pointer to allow for immediate exit
+      // thread local so that modules applying concurrently on different threads each track their own backend
+      static thread_local backend<apply_context, Backend>* _bkend;  // non owning pointer to allow for immediate exit
 
    template<typename Impl>
    friend class eos_vm_instantiated_module;
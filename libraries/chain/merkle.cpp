@@ -32,6 +32,19 @@ bool is_canonical_right(const digest_type& val) {
 }
 
 
+/**
+ * same result as digest_type::hash(make_canonical_pair(l, r)), feeding both
+ * halves straight into the encoder instead of packing a temporary pair
+ */
+static digest_type hash_canonical_pair(const digest_type& l, const digest_type& r) {
+   const digest_type canonical_l = make_canonical_left(l);
+   const digest_type canonical_r = make_canonical_right(r);
+   digest_type::encoder enc;
+   enc.write(canonical_l.data(), canonical_l.data_size());
+   enc.write(canonical_r.data(), canonical_r.data_size());
+   return enc.result();
+}
+
 digest_type merkle(vector<digest_type> ids) {
    if( 0 == ids.size() ) { return digest_type(); }
 
@@ -40,7 +53,7 @@ digest_type merkle(vector<digest_type> ids) {
          ids.push_back(ids.back());
 
       for (size_t i = 0; i < ids.size() / 2; i++) {
-         ids[i] = digest_type::hash(make_canonical_pair(ids[2 * i], ids[(2 * i) + 1]));
+         ids[i] = hash_canonical_pair(ids[2 * i], ids[(2 * i) + 1]);
       }
 
       ids.resize(ids.size() / 2);
@@ -1,35 +1,56 @@
 #include <eosio/chain/name.hpp>
 #include <fc/variant.hpp>
-#include <boost/algorithm/string.hpp>
 #include <fc/exception/exception.hpp>
 #include <eosio/chain/exceptions.hpp>
 
+#include <array>
+
 namespace eosio::chain {
 
+   namespace {
+      // characters a name can hold, in the order of their 5 bit values
+      constexpr char charmap[] = ".12345abcdefghijklmnopqrstuvwxyz";
+
+      // 5 bit value of each character a name can hold, 0xff for the rest
+      constexpr auto symbol_table = []() {
+         std::array<uint8_t, 256> table{};
+         for( auto& v : table )
+            v = 0xff;
+         for( uint8_t i = 0; i < 32; ++i )
+            table[uint8_t(charmap[i])] = i;
+         return table;
+      }();
+   }
+
    void name::set( std::string_view str ) {
       const auto len = str.size();
       EOS_ASSERT(len <= 13, name_type_exception, "Name is longer than 13 characters (${name}) ", ("name", std::string(str)));
       value = string_to_uint64_t(str);
-      EOS_ASSERT(to_string() == str, name_type_exception,
+      // str is what to_string() gives back when every character is one a name holds -- the 13th from the first 16 --
+      // and it does not end in the '.' that to_string() trims
+      bool normalized = len == 0 || str[len - 1] != '.';
+      for( size_t i = 0; i < len; ++i )
+         normalized &= symbol_table[uint8_t(str[i])] < (i == 12 ? 0x10 : 0x20);
+      EOS_ASSERT(normalized, name_type_exception,
                  "Name not properly normalized (name: ${name}, normalized: ${normalized}) ",
                  ("name", std::string(str))("normalized", to_string()));
    }
 
-   // keep in sync with name::to_string() in contract definition for name
-   std::string name::to_string()const {
-     static const char* charmap = ".12345abcdefghijklmnopqrstuvwxyz";
-
-      std::string str(13,'.');
-
+   char* name::write_as_string( char* begin )const {
       uint64_t tmp = value;
       for( uint32_t i = 0; i <= 12; ++i ) {
-         char c = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
-         str[12-i] = c;
+         begin[12-i] = charmap[tmp & (i == 0 ? 0x0f : 0x1f)];
          tmp >>= (i == 0 ? 4 : 5);
       }
+      // the trailing '.' of a name are the zero chunks below its lowest set bit
+      const int trailing = value ? (__builtin_ctzll( value ) < 4 ? 0 : (__builtin_ctzll( value ) - 4) / 5 + 1) : 13;
+      return begin + 13 - trailing;
+   }
 
-      boost::algorithm::trim_right_if( str, []( char c ){ return c == '.'; } );
-      return str;
+   // keep in sync with name::to_string() in contract definition for name
+   std::string name::to_string()const {
+      char buffer[13];
+      return std::string( buffer, write_as_string( buffer ) );
    }
 
 } // eosio::chain
@@ -0,0 +1,199 @@
+#include <eosio/chain/native_contracts.hpp>
+#include <eosio/chain/apply_context.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <cstring>
+
+namespace eosio { namespace chain {
+
+namespace {
+
+   /// as the eosio_assert intrinsic fails an assertion of a contract
+   void check( bool condition, const char* msg ) {
+      if( BOOST_UNLIKELY( !condition ) )
+         EOS_THROW( eosio_assert_message_exception, "assertion failure with message: ${s}", ("s", std::string(msg)) );
+   }
+
+   /// eosio::datastream of the CDT, with its checks and their messages
+   struct cdt_datastream {
+      const char* pos;
+      const char* end;
+
+      void read( void* d, size_t s ) {
+         check( size_t(end - pos) >= s, "read" );
+         memcpy( d, pos, s );
+         pos += s;
+      }
+
+      void skip( size_t s ) {
+         check( size_t(end - pos) >= s, "read" );
+         pos += s;
+      }
+
+      template<typename T>
+      T read() {
+         T v;
+         read( &v, sizeof(v) );
+         return v;
+      }
+
+      uint32_t read_unsigned_int() {
+         uint32_t v = 0;
+         uint8_t  by = 0;
+         char     b;
+         do {
+            check( pos < end, "get" );
+            b = *pos++;
+            // wasm shifts by the count modulo 32
+            v |= uint32_t(uint8_t(b) & 0x7f) << (by & 31);
+            by += 7;
+         } while( uint8_t(b) & 0x80 );
+         return v;
+      }
+   };
+
+   /// eosio::asset and eosio::symbol_code of the CDT, whose rules differ from chain::asset and chain::symbol
+   struct cdt_asset {
+      static constexpr int64_t max_amount = (1LL << 62) - 1;
+
+      int64_t  amount = 0;
+      uint64_t symbol = 0;
+
+      static cdt_asset unpack( cdt_datastream& ds ) {
+         cdt_asset a;
+         a.amount = ds.read<int64_t>();
+         a.symbol = ds.read<uint64_t>();
+         return a;
+      }
+
+      void pack( char* out )const {
+         memcpy( out, &amount, sizeof(amount) );
+         memcpy( out + sizeof(amount), &symbol, sizeof(symbol) );
+      }
+
+      uint64_t code()const { return symbol >> 8; }
+
+      bool is_valid()const {
+         if( !(-max_amount <= amount && amount <= max_amount) )
+            return false;
+         uint64_t sym = code();
+         for( int i = 0; i < 7; i++ ) {
+            const char c = char(sym & 0xFF);
+            if( !('A' <= c && c <= 'Z') )
+               return false;
+            sym >>= 8;
+            if( !(sym & 0xFF) ) {
+               do {
+                  sym >>= 8;
+                  if( (sym & 0xFF) )
+                     return false;
+                  i++;
+               } while( i < 7 );
+            }
+         }
+         return true;
+      }
+
+      // wasm arithmetic wraps, as these do
+      void operator-=( const cdt_asset& a ) {
+         check( a.symbol == symbol, "attempt to subtract asset with different symbol" );
+         amount = int64_t(uint64_t(amount) - uint64_t(a.amount));
+         check( -max_amount <= amount, "subtraction underflow" );
+         check( amount <= max_amount, "subtraction overflow" );
+      }
+
+      void operator+=( const cdt_asset& a ) {
+         check( a.symbol == symbol, "attempt to add asset with different symbol" );
+         amount = int64_t(uint64_t(amount) + uint64_t(a.amount));
+         check( -max_amount <= amount, "addition underflow" );
+         check( amount <= max_amount, "addition overflow" );
+      }
+   };
+
+   constexpr size_t packed_asset_size = sizeof(int64_t) + sizeof(uint64_t);
+
+   /// the first asset of a row, as eosio::multi_index loads the account and currency_stats rows
+   cdt_asset load_asset( apply_context& context, int itr ) {
+      const int size = context.db_get_i64( itr, nullptr, 0 );
+      check( size >= 0, "error reading iterator" );
+      std::vector<char> row( size );
+      if( size )
+         context.db_get_i64( itr, row.data(), row.size() );
+      cdt_datastream ds{ row.data(), row.data() + row.size() };
+      return cdt_asset::unpack( ds );
+   }
+
+   /// accounts::modify of eosio.token, given the iterator of the row and its balance
+   void update_balance( apply_context& context, int itr, const cdt_asset& balance, account_name payer ) {
+      char buffer[packed_asset_size];
+      balance.pack( buffer );
+      context.db_update_i64( itr, payer, buffer, sizeof(buffer) );
+   }
+
+}
+
+/**
+ * token::transfer of eosio.contracts, with sub_balance and add_balance, as its eosio.multi_index calls reach the
+ * database: the same rows are read and written in the same order with the same payers.
+ */
+void apply_eosio_token_transfer( apply_context& context ) {
+   const auto& data = context.get_action().data;
+   cdt_datastream ds{ data.data(), data.data() + data.size() };
+   const account_name from{ ds.read<uint64_t>() };
+   const account_name to{ ds.read<uint64_t>() };
+   const cdt_asset quantity = cdt_asset::unpack( ds );
+   const uint32_t memo_size = ds.read_unsigned_int();
+   ds.skip( memo_size );
+
+   const account_name self = context.get_receiver();
+   const name stat_table = N(stat);
+   const name accounts_table = N(accounts);
+
+   check( from != to, "cannot transfer to self" );
+   context.require_authorization( from );
+   check( context.is_account( to ), "to account does not exist" );
+   const uint64_t sym = quantity.code();
+   const int stat_itr = context.db_find_i64( self, name(sym), stat_table, sym );
+   check( stat_itr >= 0, "unable to find key" );
+   const cdt_asset supply = load_asset( context, stat_itr );
+
+   context.require_recipient( from );
+   context.require_recipient( to );
+
+   check( quantity.is_valid(), "invalid quantity" );
+   check( quantity.amount > 0, "must transfer positive quantity" );
+   check( quantity.symbol == supply.symbol, "symbol precision mismatch" );
+   check( memo_size <= 256, "memo has more than 256 bytes" );
+
+   const account_name payer = context.has_authorization( to ) ? to : from;
+
+   // sub_balance( from, quantity )
+   const int from_itr = context.db_find_i64( self, from, accounts_table, sym );
+   check( from_itr >= 0, "no balance object found" );
+   cdt_asset from_balance = load_asset( context, from_itr );
+   check( from_balance.amount >= quantity.amount, "overdrawn balance" );
+   from_balance -= quantity;
+   update_balance( context, from_itr, from_balance, from );
+
+   // add_balance( to, quantity, payer )
+   const int to_itr = context.db_find_i64( self, to, accounts_table, sym );
+   if( to_itr < 0 ) {
+      char buffer[packed_asset_size];
+      quantity.pack( buffer );
+      context.db_store_i64( to, accounts_table, payer, sym, buffer, sizeof(buffer) );
+   } else {
+      cdt_asset to_balance = load_asset( context, to_itr );
+      to_balance += quantity;
+      update_balance( context, to_itr, to_balance, account_name() );
+   }
+}
+
+const std::vector<native_contract_handler>& vetted_native_contract_handlers() {
+   static const std::vector<native_contract_handler> handlers = {
+      // eosio.token of eosio.contracts as unittests/contracts/eosio.token carries it
+      { digest_type( "a3b0abd7150c6da5500dad7d9b519e59edd19ac57e12d59819251653ddc6ed57" ), N(transfer), &apply_eosio_token_transfer },
+   };
+   return handlers;
+}
+
+} } /// namespace eosio::chain
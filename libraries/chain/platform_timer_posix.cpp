@@ -5,6 +5,7 @@
 #include <fc/fwd_impl.hpp>
 #include <fc/exception/exception.hpp>
 
+#include <limits>
 #include <mutex>
 
 #include <signal.h>
@@ -16,9 +17,41 @@ static_assert(std::atomic_bool::is_always_lock_free, "Only lock-free atomics AS-
 
 struct platform_timer::impl {
    timer_t timerid;
+   /* The kernel timer is left armed when a transaction stops. The next transaction's deadline is nearly always
+      later, so the still armed timer fires in time for it and the handler arms it again for the deadline then
+      running. Transactions much shorter than their deadline so cost no system call to start or stop. */
+   std::atomic<int64_t> armed_us = 0;                 //deadline the kernel timer is armed for, 0 when it is not
+   std::atomic<int64_t> deadline_us = no_deadline;    //deadline of the running timer
+
+   constexpr static int64_t no_deadline = std::numeric_limits<int64_t>::max();
+
+   static int64_t now_us() {
+      struct timespec ts;
+      clock_gettime(CLOCK_REALTIME, &ts);
+      return int64_t(ts.tv_sec)*1000000 + ts.tv_nsec/1000;
+   }
+
+   bool arm(int64_t deadline) {
+      armed_us = deadline;
+      struct itimerspec enable = {{0, 0}, {deadline/1000000, (deadline%1000000)*1000}};
+      if(timer_settime(timerid, TIMER_ABSTIME, &enable, NULL) != 0) {
+         armed_us = 0;
+         return false;
+      }
+      return true;
+   }
 
    static void sig_handler(int, siginfo_t* si, void*) {
       platform_timer* self = (platform_timer*)si->si_value.sival_ptr;
+      impl& me = *self->my;
+      me.armed_us = 0;
+      const int64_t deadline = me.deadline_us;
+      if(deadline == no_deadline)
+         return; //armed for a timer since stopped
+      if(now_us() < deadline) {
+         me.arm(deadline); //armed for an earlier deadline, timer_settime is async-signal-safe
+         return;
+      }
       self->expired = 1;
       self->call_expiration_callback();
    }
@@ -55,16 +88,23 @@ platform_timer::~platform_timer() {
 
 void platform_timer::start(fc::time_point tp) {
    if(tp == fc::time_point::maximum()) {
+      my->deadline_us = impl::no_deadline;
       expired = 0;
       return;
    }
-   fc::microseconds x = tp.time_since_epoch() - fc::time_point::now().time_since_epoch();
-   if(x.count() <= 0)
+   const int64_t deadline = tp.time_since_epoch().count();
+   if(deadline <= impl::now_us()) {
+      my->deadline_us = impl::no_deadline;
       expired = 1;
-   else {
-      struct itimerspec enable = {{0, 0}, {0, (int)x.count()*1000}};
-      expired = 0;
-      if(timer_settime(my->timerid, 0, &enable, NULL) != 0)
+      return;
+   }
+   //expired is cleared before the deadline is published so a handler run for the new deadline cannot be undone
+   expired = 0;
+   my->deadline_us = deadline;
+   //the handler clears armed_us before reading deadline_us, so either it sees this deadline or this sees it disarmed
+   const int64_t armed = my->armed_us;
+   if(armed == 0 || armed > deadline) {
+      if(!my->arm(deadline))
          expired = 1;
    }
 }
@@ -72,8 +112,7 @@ void platform_timer::start(fc::time_point tp) {
 void platform_timer::stop() {
    if(expired)
       return;
-   struct itimerspec disable = {{0, 0}, {0, 0}};
-   timer_settime(my->timerid, 0, &disable, NULL);
+   my->deadline_us = impl::no_deadline;
    expired = 1;
 }
 
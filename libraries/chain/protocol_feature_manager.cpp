@@ -183,6 +183,23 @@ and may have additional signatures in a block extension with ID `2`.
 Privileged Contracts:
 may continue to use `set_proposed_producers` as they have;
 may use a new `set_proposed_producers_ex` intrinsic to access extended features.
+*/
+            {}
+         } )
+         (  builtin_protocol_feature_t::batched_db_intrinsics, builtin_protocol_feature_spec{
+            "BATCHED_DB_INTRINSICS",
+            fc::variant("9bb81ac47429a4603322eb57cc908c54b76b157477d4bdd5cfdd534324ecb47b").as<digest_type>(),
+            // SHA256 hash of the raw message below within the comment delimiters (do not modify message below).
+/*
+Builtin protocol feature: BATCHED_DB_INTRINSICS
+
+Adds intrinsics that read or store several consecutive primary index rows in a single host call.
+
+db_get_i64_batch copies up to a given number of consecutive rows, starting at an iterator, into one buffer and
+returns the iterator of the first row that was not copied.
+db_store_i64_batch stores every row contained in one buffer into a table.
+
+Rows in a buffer are packed back to back as an 8 byte primary key, a 4 byte value size and the value bytes.
 */
             {}
          } )
@@ -499,14 +516,22 @@ may use a new `set_proposed_producers_ex` intrinsic to access extended features.
    }
 
    void protocol_feature_manager::init( chainbase::database& db ) {
+      vector<std::pair<digest_type, uint32_t>> activated;
+      for( const auto& f : db.get<protocol_state_object>().activated_protocol_features ) {
+         activated.emplace_back( f.feature_digest, f.activation_block_num );
+      }
+      init( activated );
+   }
+
+   void protocol_feature_manager::init( const vector<std::pair<digest_type, uint32_t>>& activated ) {
       EOS_ASSERT( !is_initialized(), protocol_feature_exception, "cannot initialize protocol_feature_manager twice" );
 
 
       auto reset_initialized = fc::make_scoped_exit( [this]() { _initialized = false; } );
       _initialized = true;
 
-      for( const auto& f : db.get<protocol_state_object>().activated_protocol_features ) {
-         activate_feature( f.feature_digest, f.activation_block_num );
+      for( const auto& f : activated ) {
+         activate_feature( f.first, f.second );
       }
 
       reset_initialized.cancel();
@@ -621,11 +646,8 @@ may use a new `set_proposed_producers_ex` intrinsic to access extended features.
       return const_iterator{this, static_cast<std::size_t>(itr - begin)};
    }
 
-   bool protocol_feature_manager::is_builtin_activated( builtin_protocol_feature_t feature_codename,
-                                                        uint32_t current_block_num )const
+   bool protocol_feature_manager::is_builtin_activated_at( uint32_t indx, uint32_t current_block_num )const
    {
-      uint32_t indx = static_cast<uint32_t>( feature_codename );
-
       if( indx >= _builtin_protocol_features.size() ) return false;
 
       return (_builtin_protocol_features[indx].activation_block_num <= current_block_num);
@@ -677,6 +699,19 @@ may use a new `set_proposed_producers_ex` intrinsic to access extended features.
       _builtin_protocol_features[indx].previous = _head_of_builtin_activation_list;
       _builtin_protocol_features[indx].activation_block_num = current_block_num;
       _head_of_builtin_activation_list = indx;
+      update_activated_builtins();
+   }
+
+   void protocol_feature_manager::update_activated_builtins() {
+      _activated_builtins = 0;
+      _latest_activation_block_num = 0;
+      if( _head_of_builtin_activation_list == builtin_protocol_feature_entry::no_previous )
+         return;
+      _latest_activation_block_num = _builtin_protocol_features[_head_of_builtin_activation_list].activation_block_num;
+      for( size_t i = _head_of_builtin_activation_list; i != builtin_protocol_feature_entry::no_previous; i = _builtin_protocol_features[i].previous ) {
+         if( i < 64 )
+            _activated_builtins |= uint64_t(1) << i;
+      }
    }
 
    void protocol_feature_manager::popped_blocks_to( uint32_t block_num ) {
@@ -696,6 +731,8 @@ may use a new `set_proposed_producers_ex` intrinsic to access extended features.
       {
          _activated_protocol_features.pop_back();
       }
+
+      update_activated_builtins();
    }
 
 } }  // eosio::chain
@@ -0,0 +1,54 @@
+#include <eosio/chain/recovered_keys_cache.hpp>
+#include <fc/io/raw.hpp>
+#include <string_view>
+
+namespace eosio { namespace chain {
+
+   recovered_keys_cache::recovered_keys_cache( uint32_t capacity )
+   :_shard_capacity( (capacity + num_shards - 1) / num_shards )
+   {}
+
+   size_t recovered_keys_cache::key_hash::operator()( const key_type& k )const {
+      return k.digest._hash[0] ^ std::hash<std::string_view>{}( std::string_view( k.packed_sig.data(), k.packed_sig.size() ) );
+   }
+
+   public_key_type recovered_keys_cache::recover( const signature_type& sig, const digest_type& digest ) {
+      if( !enabled() )
+         return public_key_type( sig, digest );
+
+      key_type k{ digest, fc::raw::pack( sig ) };
+      auto& s = _shards[key_hash{}( k ) % num_shards];
+      {
+         std::lock_guard<std::mutex> g( s.mtx );
+         auto itr = s.keys.find( k );
+         if( itr != s.keys.end() ) {
+            ++_hits;
+            return itr->second;
+         }
+      }
+
+      // recover outside of the lock; a concurrent miss on the same key just recovers it twice
+      ++_misses;
+      public_key_type key( sig, digest );
+
+      std::lock_guard<std::mutex> g( s.mtx );
+      if( s.keys.emplace( k, key ).second ) {
+         s.insertion_order.emplace_back( std::move( k ) );
+         if( s.insertion_order.size() > _shard_capacity ) {
+            s.keys.erase( s.insertion_order.front() );
+            s.insertion_order.pop_front();
+         }
+      }
+      return key;
+   }
+
+   size_t recovered_keys_cache::size()const {
+      size_t total = 0;
+      for( const auto& s : _shards ) {
+         std::lock_guard<std::mutex> g( s.mtx );
+         total += s.keys.size();
+      }
+      return total;
+   }
+
+} } /// eosio::chain
@@ -0,0 +1,106 @@
+#include <eosio/chain/replica_head.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace eosio { namespace chain {
+
+namespace bip = boost::interprocess;
+
+namespace {
+   constexpr uint32_t magic_number   = 0x52504c48; // "RPLH"
+   constexpr uint32_t format_version = 1;
+   constexpr size_t   head_capacity  = 1024 * 1024; ///< ample for a block_header_state with the largest schedules
+}
+
+struct replica_head_marker::layout {
+   uint32_t              magic;
+   uint32_t              version;
+   std::atomic<uint64_t> sequence;   ///< odd while the primary changes the state database
+   uint32_t              size;       ///< bytes of the packed replica_head in data
+   char                  data[head_capacity];
+};
+
+static_assert( std::atomic<uint64_t>::is_always_lock_free, "the sequence of replica_head.bin is shared between processes" );
+
+replica_head_marker::replica_head_marker( const fc::path& state_dir, mode m ) {
+   const auto path = state_dir / file_name;
+   if( m == mode::publish ) {
+      if( !fc::exists( path ) ) {
+         std::ofstream out( path.generic_string(), std::ios::binary | std::ios::trunc );
+         out.seekp( sizeof(layout) - 1 );
+         out.put( 0 );
+         EOS_ASSERT( out.good(), database_exception, "unable to create ${p}", ("p", path.generic_string()) );
+      }
+      _file = bip::file_mapping( path.generic_string().c_str(), bip::read_write );
+      _region = bip::mapped_region( _file, bip::read_write );
+      EOS_ASSERT( _region.get_size() >= sizeof(layout), database_exception, "${p} is truncated", ("p", path.generic_string()) );
+      auto& l = get();
+      if( l.magic != magic_number || l.version != format_version ) {
+         l.magic = magic_number;
+         l.version = format_version;
+         l.size = 0;
+         l.sequence.store( 1, std::memory_order_release );
+      }
+      begin_write();
+   } else {
+      EOS_ASSERT( fc::exists( path ), database_exception,
+                  "${p} does not exist, the primary must run with publish-replica-head", ("p", path.generic_string()) );
+      _file = bip::file_mapping( path.generic_string().c_str(), bip::read_only );
+      _region = bip::mapped_region( _file, bip::read_only );
+      EOS_ASSERT( _region.get_size() >= sizeof(layout) && get().magic == magic_number && get().version == format_version,
+                  database_exception, "${p} is not a replica head of a supported version", ("p", path.generic_string()) );
+   }
+}
+
+void replica_head_marker::begin_write() {
+   auto& l = get();
+   const auto s = l.sequence.load( std::memory_order_relaxed );
+   if( s % 2 == 0 ) {
+      l.sequence.store( s + 1, std::memory_order_relaxed );
+      // replicas that read s must see it change before any change made after it
+      std::atomic_thread_fence( std::memory_order_release );
+   }
+}
+
+void replica_head_marker::publish( const replica_head& h ) {
+   begin_write();
+   auto& l = get();
+   const auto packed = fc::raw::pack( h );
+   EOS_ASSERT( packed.size() <= head_capacity, database_exception, "replica head of ${s} bytes does not fit", ("s", packed.size()) );
+   memcpy( l.data, packed.data(), packed.size() );
+   l.size = packed.size();
+   l.sequence.store( l.sequence.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+}
+
+fc::optional<std::pair<uint64_t, replica_head>> replica_head_marker::read()const {
+   const auto& l = get();
+   const auto s = l.sequence.load( std::memory_order_acquire );
+   if( s % 2 == 1 )
+      return {};
+   const uint32_t size = std::min<uint32_t>( l.size, head_capacity );
+   std::vector<char> packed( l.data, l.data + size );
+   std::atomic_thread_fence( std::memory_order_acquire );
+   if( l.sequence.load( std::memory_order_relaxed ) != s || size == 0 )
+      return {};
+   std::pair<uint64_t, replica_head> result{ s, {} };
+   fc::raw::unpack( packed, result.second );
+   return result;
+}
+
+uint64_t replica_head_marker::sequence()const {
+   return get().sequence.load( std::memory_order_acquire );
+}
+
+bool replica_head_marker::unchanged_since( uint64_t sequence )const {
+   // the reads of the state are ordered before the load of the sequence that validates them
+   std::atomic_thread_fence( std::memory_order_acquire );
+   return sequence % 2 == 0 && get().sequence.load( std::memory_order_relaxed ) == sequence;
+}
+
+} } // eosio::chain
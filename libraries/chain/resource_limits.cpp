@@ -114,6 +114,9 @@ void resource_limits_manager::update_account_usage(const flat_set<account_name>&
    const auto& config = _db.get<resource_limits_config_object>();
    for( const auto& a : accounts ) {
       const auto& usage = _db.get<resource_usage_object,by_owner>( a );
+      // adding nothing in the slot already accounted for is a no-op, skip the modify and its undo state copy
+      if( usage.net_usage.last_ordinal == time_slot && usage.cpu_usage.last_ordinal == time_slot )
+         continue;
       _db.modify( usage, [&]( auto& bu ){
           bu.net_usage.add( 0, time_slot, config.account_net_usage_average_window );
           bu.cpu_usage.add( 0, time_slot, config.account_cpu_usage_average_window );
@@ -370,51 +373,67 @@ std::pair<int64_t, bool> resource_limits_manager::get_account_cpu_limit( const a
    return {arl.available, greylisted};
 }
 
-std::pair<account_resource_limit, bool> resource_limits_manager::get_account_cpu_limit_ex( const account_name& name, uint32_t greylist_limit ) const {
+namespace {
+   /**
+    * Elastic limit of one resource (cpu or net) for an account, optionally capped by the greylist limit
+    * @param virtual_limit current virtual block limit of the resource
+    * @param max_limit configured (non-elastic) block limit of the resource
+    * @param value_ex usage accumulator of the account, pre-multiplied by the rate limiting precision
+    */
+   std::pair<account_resource_limit, bool> calculate_account_limit( int64_t weight, uint64_t total_weight,
+                                                                    uint64_t virtual_limit, uint64_t max_limit,
+                                                                    uint32_t average_window, uint64_t value_ex,
+                                                                    uint32_t greylist_limit ) {
+      if( weight < 0 || total_weight == 0 ) {
+         return {{ -1, -1, -1 }, false};
+      }
 
-   const auto& state = _db.get<resource_limits_state_object>();
-   const auto& usage = _db.get<resource_usage_object, by_owner>(name);
-   const auto& config = _db.get<resource_limits_config_object>();
+      account_resource_limit arl;
 
-   int64_t cpu_weight, x, y;
-   get_account_limits( name, x, y, cpu_weight );
+      uint128_t window_size = average_window;
 
-   if( cpu_weight < 0 || state.total_cpu_weight == 0 ) {
-      return {{ -1, -1, -1 }, false};
-   }
+      bool greylisted = false;
+      uint128_t virtual_capacity_in_window = window_size;
+      if( greylist_limit < config::maximum_elastic_resource_multiplier ) {
+         uint64_t greylisted_virtual_limit = max_limit * greylist_limit;
+         if( greylisted_virtual_limit < virtual_limit ) {
+            virtual_capacity_in_window *= greylisted_virtual_limit;
+            greylisted = true;
+         } else {
+            virtual_capacity_in_window *= virtual_limit;
+         }
+      } else {
+         virtual_capacity_in_window *= virtual_limit;
+      }
 
-   account_resource_limit arl;
+      uint128_t user_weight     = (uint128_t)weight;
+      uint128_t all_user_weight = (uint128_t)total_weight;
 
-   uint128_t window_size = config.account_cpu_usage_average_window;
+      auto max_user_use_in_window = (virtual_capacity_in_window * user_weight) / all_user_weight;
+      auto used_in_window  = impl::integer_divide_ceil((uint128_t)value_ex * window_size, (uint128_t)config::rate_limiting_precision);
 
-   bool greylisted = false;
-   uint128_t virtual_cpu_capacity_in_window = window_size;
-   if( greylist_limit < config::maximum_elastic_resource_multiplier ) {
-      uint64_t greylisted_virtual_cpu_limit = config.cpu_limit_parameters.max * greylist_limit;
-      if( greylisted_virtual_cpu_limit < state.virtual_cpu_limit ) {
-         virtual_cpu_capacity_in_window *= greylisted_virtual_cpu_limit;
-         greylisted = true;
-      } else {
-         virtual_cpu_capacity_in_window *= state.virtual_cpu_limit;
-      }
-   } else {
-      virtual_cpu_capacity_in_window *= state.virtual_cpu_limit;
+      if( max_user_use_in_window <= used_in_window )
+         arl.available = 0;
+      else
+         arl.available = impl::downgrade_cast<int64_t>(max_user_use_in_window - used_in_window);
+
+      arl.used = impl::downgrade_cast<int64_t>(used_in_window);
+      arl.max = impl::downgrade_cast<int64_t>(max_user_use_in_window);
+      return {arl, greylisted};
    }
+}
 
-   uint128_t user_weight     = (uint128_t)cpu_weight;
-   uint128_t all_user_weight = (uint128_t)state.total_cpu_weight;
+std::pair<account_resource_limit, bool> resource_limits_manager::get_account_cpu_limit_ex( const account_name& name, uint32_t greylist_limit ) const {
 
-   auto max_user_use_in_window = (virtual_cpu_capacity_in_window * user_weight) / all_user_weight;
-   auto cpu_used_in_window  = impl::integer_divide_ceil((uint128_t)usage.cpu_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
+   const auto& state = _db.get<resource_limits_state_object>();
+   const auto& usage = _db.get<resource_usage_object, by_owner>(name);
+   const auto& config = _db.get<resource_limits_config_object>();
 
-   if( max_user_use_in_window <= cpu_used_in_window )
-      arl.available = 0;
-   else
-      arl.available = impl::downgrade_cast<int64_t>(max_user_use_in_window - cpu_used_in_window);
+   int64_t cpu_weight, x, y;
+   get_account_limits( name, x, y, cpu_weight );
 
-   arl.used = impl::downgrade_cast<int64_t>(cpu_used_in_window);
-   arl.max = impl::downgrade_cast<int64_t>(max_user_use_in_window);
-   return {arl, greylisted};
+   return calculate_account_limit( cpu_weight, state.total_cpu_weight, state.virtual_cpu_limit, config.cpu_limit_parameters.max,
+                                   config.account_cpu_usage_average_window, usage.cpu_usage.value_ex, greylist_limit );
 }
 
 std::pair<int64_t, bool> resource_limits_manager::get_account_net_limit( const account_name& name, uint32_t greylist_limit ) const {
@@ -430,42 +449,26 @@ std::pair<account_resource_limit, bool> resource_limits_manager::get_account_net
    int64_t net_weight, x, y;
    get_account_limits( name, x, net_weight, y );
 
-   if( net_weight < 0 || state.total_net_weight == 0) {
-      return {{ -1, -1, -1 }, false};
-   }
-
-   account_resource_limit arl;
-
-   uint128_t window_size = config.account_net_usage_average_window;
-
-   bool greylisted = false;
-   uint128_t virtual_network_capacity_in_window = window_size;
-   if( greylist_limit < config::maximum_elastic_resource_multiplier ) {
-      uint64_t greylisted_virtual_net_limit = config.net_limit_parameters.max * greylist_limit;
-      if( greylisted_virtual_net_limit < state.virtual_net_limit ) {
-         virtual_network_capacity_in_window *= greylisted_virtual_net_limit;
-         greylisted = true;
-      } else {
-         virtual_network_capacity_in_window *= state.virtual_net_limit;
-      }
-   } else {
-      virtual_network_capacity_in_window *= state.virtual_net_limit;
-   }
-
-   uint128_t user_weight     = (uint128_t)net_weight;
-   uint128_t all_user_weight = (uint128_t)state.total_net_weight;
-
-   auto max_user_use_in_window = (virtual_network_capacity_in_window * user_weight) / all_user_weight;
-   auto net_used_in_window  = impl::integer_divide_ceil((uint128_t)usage.net_usage.value_ex * window_size, (uint128_t)config::rate_limiting_precision);
+   return calculate_account_limit( net_weight, state.total_net_weight, state.virtual_net_limit, config.net_limit_parameters.max,
+                                   config.account_net_usage_average_window, usage.net_usage.value_ex, greylist_limit );
+}
 
-   if( max_user_use_in_window <= net_used_in_window )
-      arl.available = 0;
-   else
-      arl.available = impl::downgrade_cast<int64_t>(max_user_use_in_window - net_used_in_window);
+account_bandwidth_limits resource_limits_manager::get_account_bandwidth_limits( const account_name& name, uint32_t greylist_limit ) const {
+   const auto& config = _db.get<resource_limits_config_object>();
+   const auto& state  = _db.get<resource_limits_state_object>();
+   const auto& usage  = _db.get<resource_usage_object, by_owner>(name);
 
-   arl.used = impl::downgrade_cast<int64_t>(net_used_in_window);
-   arl.max = impl::downgrade_cast<int64_t>(max_user_use_in_window);
-   return {arl, greylisted};
+   int64_t ram_bytes, net_weight, cpu_weight;
+   get_account_limits( name, ram_bytes, net_weight, cpu_weight );
+
+   account_bandwidth_limits result;
+   std::tie( result.net, result.net_greylisted ) =
+         calculate_account_limit( net_weight, state.total_net_weight, state.virtual_net_limit, config.net_limit_parameters.max,
+                                  config.account_net_usage_average_window, usage.net_usage.value_ex, greylist_limit );
+   std::tie( result.cpu, result.cpu_greylisted ) =
+         calculate_account_limit( cpu_weight, state.total_cpu_weight, state.virtual_cpu_limit, config.cpu_limit_parameters.max,
+                                  config.account_cpu_usage_average_window, usage.cpu_usage.value_ex, greylist_limit );
+   return result;
 }
 
 } } } /// eosio::chain::resource_limits
@@ -0,0 +1,201 @@
+#include <eosio/chain/sampling_profiler.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/executor.hpp>
+#endif
+
+#include <cxxabi.h>
+#include <dlfcn.h>
+#include <execinfo.h>
+#include <sys/time.h>
+#include <ucontext.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <unordered_map>
+
+namespace eosio { namespace chain {
+
+std::atomic<sampling_profiler*> sampling_profiler::_active{nullptr};
+std::atomic<uint32_t>           sampling_profiler::_handlers_running{0};
+
+namespace {
+
+   std::string native_frame_name( uintptr_t pc ) {
+      Dl_info info;
+      if( dladdr( reinterpret_cast<void*>(pc), &info ) ) {
+         if( info.dli_sname ) {
+            int status = 0;
+            char* demangled = abi::__cxa_demangle( info.dli_sname, nullptr, nullptr, &status );
+            std::string name = status == 0 && demangled ? demangled : info.dli_sname;
+            free( demangled );
+            return name;
+         }
+         // symbols of the executable are only visible when it is linked with -rdynamic; leave it to addr2line
+         if( info.dli_fname ) {
+            const char* file = strrchr( info.dli_fname, '/' );
+            char offset[32];
+            snprintf( offset, sizeof(offset), "+0x%" PRIxPTR, pc - reinterpret_cast<uintptr_t>(info.dli_fbase) );
+            return std::string( file ? file + 1 : info.dli_fname ) + offset;
+         }
+      }
+      char address[32];
+      snprintf( address, sizeof(address), "0x%" PRIxPTR, pc );
+      return address;
+   }
+
+   struct signal_handler_init {
+      explicit signal_handler_init( void(*handler)(int, siginfo_t*, void*) ) {
+         // the first backtrace() loads the unwinder, which must not happen inside the signal handler
+         void* prime[1];
+         backtrace( prime, 1 );
+
+         // left installed for good: a SIGPROF still pending after the timer is disarmed would otherwise terminate
+         struct sigaction action;
+         memset( &action, 0, sizeof(action) );
+         action.sa_sigaction = handler;
+         sigemptyset( &action.sa_mask );
+         action.sa_flags = SA_SIGINFO | SA_RESTART;
+         sigaction( SIGPROF, &action, nullptr );
+      }
+   };
+
+}
+
+sampling_profiler::sampling_profiler( uint32_t frequency, uint32_t max_samples )
+: _frequency( frequency )
+, _samples( max_samples )
+{
+   EOS_ASSERT( frequency > 0 && frequency <= 10000, misc_exception, "sampling frequency must be between 1 and 10000 Hz" );
+}
+
+sampling_profiler::~sampling_profiler() {
+   stop();
+}
+
+void sampling_profiler::start() {
+   static signal_handler_init the_signal_handler_init( &sampling_profiler::handle_signal );
+
+   sampling_profiler* expected = nullptr;
+   EOS_ASSERT( _active.compare_exchange_strong( expected, this ), misc_exception, "a profile is already being sampled" );
+   _running = true;
+
+   const long interval_us = 1000000 / _frequency;
+   struct itimerval timer;
+   timer.it_interval.tv_sec  = interval_us / 1000000;
+   timer.it_interval.tv_usec = interval_us % 1000000;
+   timer.it_value = timer.it_interval;
+   setitimer( ITIMER_PROF, &timer, nullptr );
+}
+
+void sampling_profiler::stop() {
+   if( !_running )
+      return;
+   struct itimerval timer;
+   memset( &timer, 0, sizeof(timer) );
+   setitimer( ITIMER_PROF, &timer, nullptr );
+
+   _active = nullptr;
+   while( _handlers_running.load() )
+      std::this_thread::yield();
+   _running = false;
+}
+
+uint32_t sampling_profiler::samples()const {
+   return std::min<uint32_t>( _next.load(), _samples.size() );
+}
+
+void sampling_profiler::handle_signal( int, siginfo_t*, void* ucontext ) {
+   const int saved_errno = errno;
+   ++_handlers_running;
+   if( sampling_profiler* p = _active.load() )
+      p->record( ucontext );
+   --_handlers_running;
+   errno = saved_errno;
+}
+
+void sampling_profiler::record( void* ucontext ) {
+   const uint32_t i = _next.fetch_add( 1, std::memory_order_relaxed );
+   if( i >= _samples.size() ) {
+      _dropped.fetch_add( 1, std::memory_order_relaxed );
+      return;
+   }
+   sample& s = _samples[i];
+
+   // the stack starts with the frames of this handler, the interrupted instruction is where the sampled stack begins
+   void* stack[max_depth + 8];
+   const int n = backtrace( stack, max_depth + 8 );
+   int first = 0;
+#if defined(__linux__) && defined(__x86_64__)
+   const uintptr_t pc = static_cast<ucontext_t*>(ucontext)->uc_mcontext.gregs[REG_RIP];
+   while( first < n && reinterpret_cast<uintptr_t>(stack[first]) != pc )
+      ++first;
+   if( first == n ) {
+      // the unwinder did not make it through the signal frame, keep the leaf alone
+      stack[0] = reinterpret_cast<void*>(pc);
+      first = 0;
+      s.depth = 1;
+   } else {
+      s.depth = std::min<int>( n - first, max_depth );
+   }
+#else
+   // handle_signal, record and the signal trampoline
+   first = std::min( n, 3 );
+   s.depth = std::min<int>( n - first, max_depth );
+#endif
+
+   s.oc_frames = 0;
+   for( uint32_t d = 0; d < s.depth; ++d ) {
+      s.frames[d] = reinterpret_cast<uintptr_t>(stack[first + d]);
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      size_t offset;
+      if( eosvmoc::executing_code_cache_offset( s.frames[d], offset ) ) {
+         s.frames[d] = offset;
+         s.oc_frames |= 1u << d;
+      }
+#endif
+   }
+}
+
+std::map<std::string, uint64_t> sampling_profiler::folded( const std::function<std::string(size_t)>& oc_name )const {
+   std::unordered_map<uintptr_t, std::string> native_names;
+   std::unordered_map<size_t, std::string>    oc_names;
+   std::map<std::string, uint64_t> stacks;
+
+   const uint32_t count = samples();
+   for( uint32_t i = 0; i < count; ++i ) {
+      const sample& s = _samples[i];
+      std::string stack;
+      for( uint32_t d = s.depth; d-- > 0; ) {
+         const std::string* name;
+         // return addresses point past the call, which may already be the next function
+         const uintptr_t pc = d ? s.frames[d] - 1 : s.frames[d];
+         if( s.oc_frames & (1u << d) ) {
+            auto it = oc_names.find( pc );
+            if( it == oc_names.end() ) {
+               std::string n = oc_name( pc );
+               it = oc_names.emplace( pc, n.empty() ? "eosvmoc" : std::move(n) ).first;
+            }
+            name = &it->second;
+         } else {
+            auto it = native_names.find( pc );
+            if( it == native_names.end() )
+               it = native_names.emplace( pc, native_frame_name( pc ) ).first;
+            name = &it->second;
+         }
+         if( !stack.empty() )
+            stack += ';';
+         stack += *name;
+      }
+      if( !stack.empty() )
+         ++stacks[stack];
+   }
+   return stacks;
+}
+
+} } // eosio::chain
@@ -1,6 +1,18 @@
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <fc/scoped_exit.hpp>
+#include <fc/io/raw.hpp>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <thread>
 
 namespace eosio { namespace chain {
 
@@ -164,6 +176,12 @@ void ostream_snapshot_writer::write_row( const detail::abstract_snapshot_row_wri
    row_count++;
 }
 
+void ostream_snapshot_writer::write_packed_rows( const std::string& data, uint64_t count ) {
+   EOS_ASSERT(section_pos != std::streampos(-1), snapshot_exception, "Attempting to write rows outside of a section");
+   snapshot.write(data.data(), data.size());
+   row_count += count;
+}
+
 void ostream_snapshot_writer::write_end_section( ) {
    auto restore = snapshot.tellp();
 
@@ -190,6 +208,103 @@ void ostream_snapshot_writer::finalize() {
    snapshot.write((char*)&end_marker, sizeof(end_marker));
 }
 
+snapshot_chunk_queue::snapshot_chunk_queue( size_t chunk_size )
+:chunk_size(chunk_size)
+{
+   current.data.resize(chunk_size);
+   setp(current.data.data(), current.data.data() + current.data.size());
+}
+
+void snapshot_chunk_queue::hand_off( uint64_t offset ) {
+   const size_t n = pptr() - pbase();
+   end = std::max(end, current.offset + n);
+   if (n > 0) {
+      current.data.resize(n);
+      {
+         std::lock_guard<std::mutex> g(mtx);
+         if (!aborted)
+            chunks.emplace_back(std::move(current));
+      }
+      cv.notify_one();
+      current.data.assign(chunk_size, 0);
+   }
+   current.offset = offset;
+   setp(current.data.data(), current.data.data() + current.data.size());
+}
+
+snapshot_chunk_queue::int_type snapshot_chunk_queue::overflow( int_type c ) {
+   hand_off(position());
+   if (!traits_type::eq_int_type(c, traits_type::eof())) {
+      *pptr() = traits_type::to_char_type(c);
+      pbump(1);
+   }
+   return traits_type::not_eof(c);
+}
+
+snapshot_chunk_queue::pos_type snapshot_chunk_queue::seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) {
+   const uint64_t cur = position();
+   if (dir == std::ios_base::cur && off == 0) // tellp, once per row
+      return pos_type(cur);
+   const uint64_t base = dir == std::ios_base::beg ? 0 : dir == std::ios_base::cur ? cur : std::max(end, cur);
+   return seekpos(pos_type(base + off), which);
+}
+
+snapshot_chunk_queue::pos_type snapshot_chunk_queue::seekpos( pos_type pos, std::ios_base::openmode which ) {
+   if (!(which & std::ios_base::out) || pos < 0)
+      return pos_type(off_type(-1));
+   if (uint64_t(pos) != position())
+      hand_off(pos);
+   return pos;
+}
+
+uint64_t snapshot_chunk_queue::size() const {
+   return std::max(end, position());
+}
+
+void snapshot_chunk_queue::close() {
+   hand_off(position());
+   {
+      std::lock_guard<std::mutex> g(mtx);
+      closed = true;
+   }
+   cv.notify_one();
+}
+
+void snapshot_chunk_queue::abort() {
+   {
+      std::lock_guard<std::mutex> g(mtx);
+      aborted = true;
+      chunks.clear();
+   }
+   cv.notify_one();
+}
+
+bool snapshot_chunk_queue::write_to( std::ostream& out ) {
+   uint64_t out_pos = out.tellp();
+   for (;;) {
+      chunk c;
+      {
+         std::unique_lock<std::mutex> lock(mtx);
+         cv.wait(lock, [this]() { return aborted || closed || !chunks.empty(); });
+         if (aborted)
+            return false;
+         if (chunks.empty())
+            return true;
+         c = std::move(chunks.front());
+         chunks.pop_front();
+      }
+      if (c.offset != out_pos)
+         out.seekp(c.offset);
+      out.write(c.data.data(), c.data.size());
+      out_pos = c.offset + c.data.size();
+      if (!out) {
+         // drop whatever is still serialized
+         abort();
+         return false;
+      }
+   }
+}
+
 istream_snapshot_reader::istream_snapshot_reader(std::istream& snapshot)
 :snapshot(snapshot)
 ,header_pos(snapshot.tellg())
@@ -346,6 +461,278 @@ void istream_snapshot_reader::return_to_header() {
    clear_section();
 }
 
+namespace bio = boost::iostreams;
+
+indexed_snapshot_writer::indexed_snapshot_writer(std::ostream& snapshot, compression_type compression, uint32_t chunk_size)
+:snapshot(snapshot)
+,header_pos(snapshot.tellp())
+,compression(compression)
+,chunk_size(chunk_size)
+{
+   auto totem = magic_number;
+   snapshot.write((char*)&totem, sizeof(totem));
+
+   auto version = current_snapshot_version;
+   snapshot.write((char*)&version, sizeof(version));
+
+   toc.compression = static_cast<uint8_t>(compression);
+}
+
+void indexed_snapshot_writer::write_start_section( const std::string& section_name ) {
+   EOS_ASSERT(!section, snapshot_exception, "Attempting to write a new section without closing the previous section");
+   section.emplace();
+   section->name = section_name;
+}
+
+void indexed_snapshot_writer::write_row( const detail::abstract_snapshot_row_writer& row_writer ) {
+   auto restore = chunk.tellp();
+   try {
+      row_writer.write(chunk_out);
+   } catch (...) {
+      chunk.seekp(restore);
+      throw;
+   }
+   ++section->row_count;
+   if (chunk.tellp() >= std::streamoff(chunk_size))
+      flush_chunk();
+}
+
+void indexed_snapshot_writer::write_packed_rows( const std::string& data, uint64_t count ) {
+   EOS_ASSERT(section, snapshot_exception, "Attempting to write rows outside of a section");
+   chunk.write(data.data(), data.size());
+   section->row_count += count;
+   if (chunk.tellp() >= std::streamoff(chunk_size))
+      flush_chunk();
+}
+
+void indexed_snapshot_writer::flush_chunk() {
+   const std::string raw = chunk.str().substr(0, chunk.tellp());
+   chunk.str(std::string());
+   if (raw.empty())
+      return;
+   EOS_ASSERT(raw.size() <= std::numeric_limits<uint32_t>::max(), snapshot_exception,
+              "Indexed snapshot chunk of section ${s} is too large", ("s", section->name));
+
+   std::string compressed;
+   if (compression == compression_type::zlib) {
+      bio::filtering_ostream comp;
+      comp.push(bio::zlib_compressor(bio::zlib::default_compression));
+      comp.push(bio::back_inserter(compressed));
+      comp.write(raw.data(), raw.size());
+      bio::close(comp);
+   } else {
+      compressed = raw;
+   }
+
+   detail::indexed_snapshot_chunk c;
+   c.offset = snapshot.tellp() - header_pos;
+   c.compressed_size = compressed.size();
+   c.size = raw.size();
+   c.digest = fc::sha256::hash(compressed.data(), compressed.size());
+   snapshot.write(compressed.data(), compressed.size());
+   section->chunks.emplace_back(c);
+}
+
+void indexed_snapshot_writer::write_end_section( ) {
+   EOS_ASSERT(section, snapshot_exception, "Attempting to end a section that was not started");
+   // sections start on a chunk boundary so each can be read on its own
+   flush_chunk();
+   toc.sections.emplace_back(std::move(*section));
+   section.reset();
+}
+
+void indexed_snapshot_writer::finalize() {
+   EOS_ASSERT(!section, snapshot_exception, "Attempting to finalize a snapshot with an open section");
+   uint64_t toc_offset = snapshot.tellp() - header_pos;
+   auto packed = fc::raw::pack(toc);
+   snapshot.write(packed.data(), packed.size());
+   snapshot.write((char*)&toc_offset, sizeof(toc_offset));
+   auto totem = magic_number;
+   snapshot.write((char*)&totem, sizeof(totem));
+}
+
+indexed_snapshot_reader::indexed_snapshot_reader(const fc::path& p)
+{
+   namespace bip = boost::interprocess;
+   try {
+      bip::file_mapping file(p.generic_string().c_str(), bip::read_only);
+      auto region = std::make_shared<bip::mapped_region>(file, bip::read_only);
+      data = static_cast<const char*>(region->get_address());
+      size = region->get_size();
+      mapping = region;
+   } catch( const bip::interprocess_exception& e ) {
+      EOS_THROW(snapshot_exception, "Unable to map snapshot ${p}: ${e}", ("p", p.generic_string())("e", e.what()));
+   }
+   load_toc();
+}
+
+indexed_snapshot_reader::indexed_snapshot_reader(const char* data, size_t size)
+:data(data)
+,size(size)
+{
+   load_toc();
+}
+
+void indexed_snapshot_reader::load_toc() {
+   const size_t header_size = sizeof(indexed_snapshot_writer::magic_number) + sizeof(current_snapshot_version);
+   const size_t trailer_size = sizeof(uint64_t) + sizeof(indexed_snapshot_writer::magic_number);
+   EOS_ASSERT(size >= header_size + trailer_size, snapshot_exception, "Indexed snapshot is truncated");
+
+   uint32_t totem = 0;
+   memcpy(&totem, data, sizeof(totem));
+   EOS_ASSERT(totem == indexed_snapshot_writer::magic_number, snapshot_exception,
+              "Indexed snapshot has unexpected magic number!");
+   memcpy(&totem, data + size - sizeof(totem), sizeof(totem));
+   EOS_ASSERT(totem == indexed_snapshot_writer::magic_number, snapshot_exception,
+              "Indexed snapshot is truncated, it has no table of contents");
+
+   uint64_t toc_offset = 0;
+   memcpy(&toc_offset, data + size - trailer_size, sizeof(toc_offset));
+   EOS_ASSERT(toc_offset >= header_size && toc_offset <= size - trailer_size, snapshot_exception,
+              "Indexed snapshot table of contents is out of bounds");
+   try {
+      fc::datastream<const char*> ds(data + toc_offset, size - trailer_size - toc_offset);
+      fc::raw::unpack(ds, toc);
+   } FC_RETHROW_EXCEPTIONS(warn, "Indexed snapshot table of contents is corrupt")
+
+   EOS_ASSERT(toc.compression <= static_cast<uint8_t>(indexed_snapshot_writer::compression_type::zlib), snapshot_exception,
+              "Indexed snapshot uses unknown compression ${c}", ("c", toc.compression));
+   for (const auto& section : toc.sections) {
+      for (const auto& c : section.chunks) {
+         EOS_ASSERT(c.offset >= header_size && c.offset + c.compressed_size <= toc_offset, snapshot_exception,
+                    "Indexed snapshot section ${s} has a chunk out of bounds", ("s", section.name));
+      }
+   }
+}
+
+void indexed_snapshot_reader::validate() const {
+   auto expected_version = current_snapshot_version;
+   decltype(expected_version) actual_version;
+   memcpy(&actual_version, data + sizeof(indexed_snapshot_writer::magic_number), sizeof(actual_version));
+   EOS_ASSERT(actual_version == expected_version, snapshot_exception,
+              "Indexed snapshot is an unsuppored version.  Expected : ${expected}, Got: ${actual}",
+              ("expected", expected_version)("actual", actual_version));
+
+   std::vector<const detail::indexed_snapshot_chunk*> chunks;
+   for (const auto& section : toc.sections) {
+      for (const auto& c : section.chunks)
+         chunks.push_back(&c);
+   }
+
+   std::atomic<size_t> next{0};
+   auto verify = [&]() {
+      for (size_t i = next++; i < chunks.size(); i = next++) {
+         const auto& c = *chunks[i];
+         EOS_ASSERT(fc::sha256::hash(data + c.offset, c.compressed_size) == c.digest, snapshot_exception,
+                    "Indexed snapshot chunk at offset ${o} fails its checksum", ("o", c.offset));
+      }
+   };
+   std::vector<std::future<void>> workers;
+   const auto threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), chunks.size());
+   for (size_t t = 0; t < threads; ++t)
+      workers.emplace_back(std::async(std::launch::async, verify));
+   for (auto& w : workers)
+      w.get();
+}
+
+bool indexed_snapshot_reader::has_section( const string& section_name ) {
+   return std::any_of(toc.sections.begin(), toc.sections.end(), [&](const auto& s) { return s.name == section_name; });
+}
+
+void indexed_snapshot_reader::set_section( const string& section_name ) {
+   auto itr = std::find_if(toc.sections.begin(), toc.sections.end(), [&](const auto& s) { return s.name == section_name; });
+   EOS_ASSERT(itr != toc.sections.end(), snapshot_exception, "Indexed snapshot has no section named ${n}", ("n", section_name));
+   clear_section();
+   cur_section = &*itr;
+}
+
+bool indexed_snapshot_reader::next_chunk() {
+   if (!cur_section || cur_chunk >= cur_section->chunks.size())
+      return false;
+   const auto& c = cur_section->chunks[cur_chunk++];
+   chunk_data.clear();
+   if (toc.compression == static_cast<uint8_t>(indexed_snapshot_writer::compression_type::zlib)) {
+      chunk_data.reserve(c.size);
+      try {
+         bio::filtering_ostream decomp;
+         decomp.push(bio::zlib_decompressor());
+         decomp.push(bio::back_inserter(chunk_data));
+         decomp.write(data + c.offset, c.compressed_size);
+         bio::close(decomp);
+      } catch( const bio::zlib_error& e ) {
+         EOS_THROW(snapshot_exception, "Indexed snapshot chunk at offset ${o} does not decompress: ${e}",
+                   ("o", c.offset)("e", e.what()));
+      }
+   } else {
+      chunk_data.assign(data + c.offset, data + c.offset + c.compressed_size);
+   }
+   EOS_ASSERT(chunk_data.size() == c.size, snapshot_exception,
+              "Indexed snapshot chunk at offset ${o} has ${a} bytes, expected ${e}",
+              ("o", c.offset)("a", chunk_data.size())("e", c.size));
+   return true;
+}
+
+indexed_snapshot_reader::chunk_streambuf::int_type indexed_snapshot_reader::chunk_streambuf::underflow() {
+   if (gptr() < egptr())
+      return traits_type::to_int_type(*gptr());
+   if (!reader.next_chunk())
+      return traits_type::eof();
+   auto* begin = reader.chunk_data.data();
+   setg(begin, begin, begin + reader.chunk_data.size());
+   return traits_type::to_int_type(*gptr());
+}
+
+bool indexed_snapshot_reader::read_row( detail::abstract_snapshot_row_reader& row_reader ) {
+   row_reader.provide(rows);
+   return ++cur_row < cur_section->row_count;
+}
+
+bool indexed_snapshot_reader::empty ( ) {
+   return cur_section->row_count == 0;
+}
+
+void indexed_snapshot_reader::clear_section() {
+   cur_section = nullptr;
+   cur_chunk = 0;
+   cur_row = 0;
+   chunk_data.clear();
+   rows_buf.reset();
+   rows.clear();
+   rows.exceptions(std::istream::failbit|std::istream::eofbit);
+}
+
+void indexed_snapshot_reader::return_to_header() {
+   clear_section();
+}
+
+namespace {
+   /// an istream_snapshot_reader owning the file it reads
+   struct snapshot_ifstream {
+      explicit snapshot_ifstream(const fc::path& p)
+      :file(p.generic_string(), std::ios::in | std::ios::binary) {}
+
+      std::ifstream file;
+   };
+
+   struct ifstream_snapshot_reader : private snapshot_ifstream, public istream_snapshot_reader {
+      explicit ifstream_snapshot_reader(const fc::path& p)
+      :snapshot_ifstream(p)
+      ,istream_snapshot_reader(file) {}
+   };
+}
+
+snapshot_reader_ptr open_snapshot_file(const fc::path& p) {
+   uint32_t totem = 0;
+   {
+      std::ifstream in(p.generic_string(), std::ios::in | std::ios::binary);
+      EOS_ASSERT(in.good(), snapshot_exception, "Unable to open snapshot ${p}", ("p", p.generic_string()));
+      in.read((char*)&totem, sizeof(totem));
+   }
+   if (totem == indexed_snapshot_writer::magic_number)
+      return std::make_shared<indexed_snapshot_reader>(p);
+   return std::make_shared<ifstream_snapshot_reader>(p);
+}
+
 integrity_hash_snapshot_writer::integrity_hash_snapshot_writer(fc::sha256::encoder& enc)
 :enc(enc)
 {
@@ -360,6 +747,11 @@ void integrity_hash_snapshot_writer::write_row( const detail::abstract_snapshot_
    row_writer.write(enc);
 }
 
+void integrity_hash_snapshot_writer::write_packed_rows( const std::string& data, uint64_t ) {
+   // hashing the concatenated encoding is identical to hashing row by row
+   enc.write(data.data(), data.size());
+}
+
 void integrity_hash_snapshot_writer::write_end_section( ) {
    // no-op for structural details
 }
@@ -0,0 +1,193 @@
+#include <eosio/chain/span_tracer.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <pthread.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <set>
+
+namespace eosio { namespace chain {
+
+/// sequence is 0 while empty or being written, else the index of the span it holds plus one
+struct span_tracer::slot {
+   std::atomic<uint64_t> sequence{0};
+   span                  s;
+};
+
+span_tracer::slot*    span_tracer::_slots = nullptr;
+uint32_t              span_tracer::_capacity = 0;
+std::atomic<uint64_t> span_tracer::_next{0};
+std::atomic<bool>     span_tracer::_enabled{false};
+
+namespace {
+
+   std::mutex                                 names_mtx;
+   std::set<std::string>                      interned_names;
+   std::map<uint32_t, std::string>            thread_names;
+   std::atomic<uint32_t>                      next_thread{0};
+
+   uint32_t this_thread() {
+      thread_local const uint32_t id = []() {
+         const uint32_t id = ++next_thread;
+         char name[64] = {};
+         pthread_getname_np( pthread_self(), name, sizeof(name) );
+         std::lock_guard<std::mutex> g( names_mtx );
+         thread_names[id] = name;
+         return id;
+      }();
+      return id;
+   }
+
+   void append_quoted( std::string& out, const char* s ) {
+      out += '"';
+      for( ; s && *s; ++s ) {
+         const unsigned char c = *s;
+         if( c == '"' || c == '\\' ) {
+            out += '\\';
+            out += c;
+         } else if( c < 0x20 ) {
+            char escaped[8];
+            snprintf( escaped, sizeof(escaped), "\\u%04x", c );
+            out += escaped;
+         } else {
+            out += c;
+         }
+      }
+      out += '"';
+   }
+
+   std::string hex( uint64_t v, int width ) {
+      char buf[40];
+      snprintf( buf, sizeof(buf), "%0*" PRIx64, width, v );
+      return buf;
+   }
+
+}
+
+void span_tracer::initialize( uint32_t capacity ) {
+   EOS_ASSERT( !initialized(), misc_exception, "span tracer is already initialized" );
+   EOS_ASSERT( capacity > 0, misc_exception, "span tracer needs a buffer" );
+   _slots = new slot[capacity];
+   _capacity = capacity;
+   set_enabled( true );
+}
+
+void span_tracer::record( span s ) {
+   s.thread = this_thread();
+   const uint64_t i = _next.fetch_add( 1, std::memory_order_relaxed );
+   slot& sl = _slots[i % _capacity];
+   sl.sequence.store( 0, std::memory_order_relaxed );
+   std::atomic_thread_fence( std::memory_order_release );
+   sl.s = s;
+   sl.sequence.store( i + 1, std::memory_order_release );
+}
+
+const char* span_tracer::intern( const std::string& name ) {
+   std::lock_guard<std::mutex> g( names_mtx );
+   return interned_names.insert( name ).first->c_str();
+}
+
+std::vector<span_tracer::span> span_tracer::spans() {
+   std::vector<span> result;
+   if( !initialized() )
+      return result;
+   const uint64_t end = _next.load( std::memory_order_acquire );
+   const uint64_t begin = end > _capacity ? end - _capacity : 0;
+   result.reserve( end - begin );
+   for( uint64_t i = begin; i < end; ++i ) {
+      const slot& sl = _slots[i % _capacity];
+      if( sl.sequence.load( std::memory_order_acquire ) != i + 1 )
+         continue;
+      span s = sl.s;
+      std::atomic_thread_fence( std::memory_order_acquire );
+      if( sl.sequence.load( std::memory_order_relaxed ) != i + 1 )
+         continue;
+      result.push_back( s );
+   }
+   return result;
+}
+
+std::string span_tracer::chrome_trace_json() {
+   auto recorded = spans();
+   std::stable_sort( recorded.begin(), recorded.end(), []( const span& a, const span& b ) { return a.start_us < b.start_us; } );
+
+   std::string out = "{\"traceEvents\":[";
+   bool first = true;
+   const auto event = [&]( const char* phase, const span& s, const std::string& extra ) {
+      if( !first )
+         out += ',';
+      first = false;
+      out += "{\"ph\":\"";
+      out += phase;
+      out += "\",\"cat\":";
+      append_quoted( out, s.category );
+      out += ",\"name\":";
+      append_quoted( out, s.name );
+      out += ",\"pid\":1,\"tid\":" + std::to_string( s.thread ) + ",\"ts\":" + std::to_string( s.start_us );
+      out += extra;
+      out += '}';
+   };
+
+   {
+      std::lock_guard<std::mutex> g( names_mtx );
+      for( const auto& t : thread_names ) {
+         if( !first )
+            out += ',';
+         first = false;
+         out += "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" + std::to_string( t.first ) + ",\"args\":{\"name\":";
+         append_quoted( out, t.second.c_str() );
+         out += "}}";
+      }
+   }
+
+   // a flow starts at the first span of a trace and steps through the rest in time order
+   std::map<uint64_t, size_t> trace_spans;
+   for( const auto& s : recorded ) {
+      if( s.trace_id )
+         ++trace_spans[s.trace_id];
+   }
+   std::map<uint64_t, size_t> trace_seen;
+   for( const auto& s : recorded ) {
+      std::string args = ",\"dur\":" + std::to_string( s.duration_us );
+      if( s.trace_id )
+         args += ",\"args\":{\"trace\":\"" + hex( s.trace_id, 16 ) + "\"}";
+      event( "X", s, args );
+      if( !s.trace_id || trace_spans[s.trace_id] < 2 )
+         continue;
+      const size_t n = ++trace_seen[s.trace_id];
+      const char* phase = n == 1 ? "s" : n == trace_spans[s.trace_id] ? "f" : "t";
+      event( phase, s, ",\"id\":\"0x" + hex( s.trace_id, 1 ) + "\"" + (n == 1 ? "" : ",\"bp\":\"e\"") );
+   }
+   out += "]}";
+   return out;
+}
+
+std::string span_tracer::otlp_json( const std::string& service_name ) {
+   const auto recorded = spans();
+   std::string out = "{\"resourceSpans\":[{\"resource\":{\"attributes\":[{\"key\":\"service.name\",\"value\":{\"stringValue\":";
+   append_quoted( out, service_name.c_str() );
+   out += "}}]},\"scopeSpans\":[{\"scope\":{\"name\":\"eosio\"},\"spans\":[";
+   for( size_t i = 0; i < recorded.size(); ++i ) {
+      const span& s = recorded[i];
+      if( i )
+         out += ',';
+      const uint64_t span_id = i + 1;
+      // trace ids are 128 bits; spans without one get a trace of their own, told apart from real ones by the high bits
+      out += "{\"traceId\":\"" + ( s.trace_id ? hex( 0, 16 ) + hex( s.trace_id, 16 ) : hex( 1, 16 ) + hex( span_id, 16 ) ) + "\"";
+      out += ",\"spanId\":\"" + hex( span_id, 16 ) + "\",\"name\":";
+      append_quoted( out, s.name );
+      out += ",\"kind\":1,\"startTimeUnixNano\":\"" + std::to_string( uint64_t(s.start_us) * 1000 ) + "\"";
+      out += ",\"endTimeUnixNano\":\"" + std::to_string( uint64_t(s.start_us + s.duration_us) * 1000 ) + "\"";
+      out += ",\"attributes\":[{\"key\":\"category\",\"value\":{\"stringValue\":";
+      append_quoted( out, s.category );
+      out += "}},{\"key\":\"thread.id\",\"value\":{\"intValue\":\"" + std::to_string( s.thread ) + "\"}}]}";
+   }
+   out += "]}]}]}";
+   return out;
+}
+
+} } // eosio::chain
@@ -1,5 +1,7 @@
 #include <eosio/chain/thread_utils.hpp>
 #include <fc/log/logger_config.hpp>
+#include <fc/log/logger.hpp>
+#include <fc/exception/exception.hpp>
 
 namespace eosio { namespace chain {
 
@@ -7,16 +9,26 @@ namespace eosio { namespace chain {
 //
 // named_thread_pool
 //
+namespace {
+   // the pool and the deque of the calling thread, if it is a thread of a pool
+   thread_local const named_thread_pool* this_pool = nullptr;
+   thread_local size_t                   this_deque = 0;
+}
+
 named_thread_pool::named_thread_pool( std::string name_prefix, size_t num_threads )
 : _thread_pool( num_threads )
 , _ioc( num_threads )
 {
+   for( size_t i = 0; i < num_threads; ++i )
+      _deques.emplace_back( std::make_unique<task_deque>() );
    _ioc_work.emplace( boost::asio::make_work_guard( _ioc ) );
    for( size_t i = 0; i < num_threads; ++i ) {
-      boost::asio::post( _thread_pool, [&ioc = _ioc, name_prefix, i]() {
+      boost::asio::post( _thread_pool, [this, name_prefix, i]() {
          std::string tn = name_prefix + "-" + std::to_string( i );
          fc::set_os_thread_name( tn );
-         ioc.run();
+         this_pool = this;
+         this_deque = i;
+         _ioc.run();
       } );
    }
 }
@@ -25,7 +37,51 @@ named_thread_pool::~named_thread_pool() {
    stop();
 }
 
+void named_thread_pool::fork( task& t ) {
+   const size_t d = this_pool == this ? this_deque : _next_deque++ % _deques.size();
+   {
+      std::lock_guard<std::mutex> g( _deques[d]->mtx );
+      _deques[d]->tasks.push_back( &t );
+   }
+   // wakes an idle thread to steal it; if the forking thread takes it back first this finds nothing
+   boost::asio::post( _ioc, [this]() { run_one(); } );
+}
+
+void named_thread_pool::join( task& t ) {
+   while( !t.done.load( std::memory_order_acquire ) ) {
+      if( !run_one() )
+         std::this_thread::yield();
+   }
+}
+
+bool named_thread_pool::run_one() {
+   task* t = nullptr;
+   const bool own = this_pool == this;
+   if( own ) {
+      auto& d = *_deques[this_deque];
+      std::lock_guard<std::mutex> g( d.mtx );
+      if( !d.tasks.empty() ) {
+         t = d.tasks.back();
+         d.tasks.pop_back();
+      }
+   }
+   const size_t start = own ? this_deque + 1 : 0;
+   for( size_t i = 0; !t && i < _deques.size(); ++i ) {
+      auto& d = *_deques[(start + i) % _deques.size()];
+      std::lock_guard<std::mutex> g( d.mtx );
+      if( !d.tasks.empty() ) {
+         t = d.tasks.front();
+         d.tasks.pop_front();
+      }
+   }
+   if( !t )
+      return false;
+   t->run( *t );
+   return true;
+}
+
 void named_thread_pool::stop() {
+   _running = false;
    _ioc_work.reset();
    _ioc.stop();
    _thread_pool.join();
@@ -33,4 +89,72 @@ void named_thread_pool::stop() {
 }
 
 
+//
+// signal_worker
+//
+signal_worker::signal_worker( std::string name, size_t max_queued )
+: _name( std::move( name ) )
+, _max_queued( max_queued )
+{
+   if( is_async() )
+      _thread = std::thread( [this]() { run(); } );
+}
+
+signal_worker::~signal_worker() {
+   stop();
+}
+
+void signal_worker::post( std::function<void()> task ) {
+   std::unique_lock<std::mutex> g( _mtx );
+   _cv.wait( g, [&]() { return _stopped || _queue.size() < _max_queued; } );
+   if( _stopped )
+      return;
+   _queue.emplace_back( std::move( task ) );
+   _cv.notify_all();
+}
+
+void signal_worker::drain() {
+   std::unique_lock<std::mutex> g( _mtx );
+   _cv.wait( g, [&]() { return _queue.empty() && _running == 0; } );
+}
+
+void signal_worker::stop() {
+   {
+      std::lock_guard<std::mutex> g( _mtx );
+      if( _stopped )
+         return;
+      _stopped = true;
+      _cv.notify_all();
+   }
+   if( _thread.joinable() )
+      _thread.join();
+}
+
+void signal_worker::run() {
+   fc::set_os_thread_name( _name );
+   std::unique_lock<std::mutex> g( _mtx );
+   while( true ) {
+      _cv.wait( g, [&]() { return _stopped || !_queue.empty(); } );
+      if( _queue.empty() )
+         return;
+      auto task = std::move( _queue.front() );
+      _queue.pop_front();
+      ++_running;
+      _cv.notify_all();
+      g.unlock();
+      try {
+         task();
+      } catch( const fc::exception& e ) {
+         elog( "${n} signal subscriber threw: ${e}", ("n", _name)("e", e.to_detail_string()) );
+      } catch( const std::exception& e ) {
+         elog( "${n} signal subscriber threw: ${e}", ("n", _name)("e", e.what()) );
+      } catch( ... ) {
+         elog( "${n} signal subscriber threw", ("n", _name) );
+      }
+      g.lock();
+      --_running;
+      _cv.notify_all();
+   }
+}
+
 } } // eosio::chain
\ No newline at end of file
@@ -1,6 +1,7 @@
 #include <fc/io/raw.hpp>
 #include <fc/bitutil.hpp>
 #include <algorithm>
+#include <cstring>
 
 #include <boost/range/adaptor/transformed.hpp>
 #include <boost/iostreams/filtering_stream.hpp>
@@ -10,6 +11,7 @@
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/transaction.hpp>
+#include <eosio/chain/recovered_keys_cache.hpp>
 
 namespace eosio { namespace chain {
 
@@ -56,25 +58,34 @@ digest_type transaction::sig_digest( const chain_id_type& chain_id, const vector
    return enc.result();
 }
 
-fc::microseconds transaction::get_signature_keys( const vector<signature_type>& signatures,
-      const chain_id_type& chain_id, fc::time_point deadline, const vector<bytes>& cfd,
-      flat_set<public_key_type>& recovered_pub_keys, bool allow_duplicate_keys)const
-{ try {
-   auto start = fc::time_point::now();
+static fc::microseconds recover_signature_keys( const vector<signature_type>& signatures, const digest_type& digest,
+                                                fc::time_point start, fc::time_point deadline,
+                                                flat_set<public_key_type>& recovered_pub_keys, bool allow_duplicate_keys,
+                                                recovered_keys_cache* cache )
+{
    recovered_pub_keys.clear();
-   const digest_type digest = sig_digest(chain_id, cfd);
 
    for(const signature_type& sig : signatures) {
       auto now = fc::time_point::now();
       EOS_ASSERT( now < deadline, tx_cpu_usage_exceeded, "transaction signature verification executed for too long ${time}us",
                   ("time", now - start)("now", now)("deadline", deadline)("start", start) );
-      auto[ itr, successful_insertion ] = recovered_pub_keys.emplace( sig, digest );
+      auto[ itr, successful_insertion ] = cache ? recovered_pub_keys.emplace( cache->recover( sig, digest ) )
+                                                : recovered_pub_keys.emplace( sig, digest );
       EOS_ASSERT( allow_duplicate_keys || successful_insertion, tx_duplicate_sig,
                   "transaction includes more than one signature signed using the same key associated with public key: ${key}",
                   ("key", *itr ) );
    }
 
    return fc::time_point::now() - start;
+}
+
+fc::microseconds transaction::get_signature_keys( const vector<signature_type>& signatures,
+      const chain_id_type& chain_id, fc::time_point deadline, const vector<bytes>& cfd,
+      flat_set<public_key_type>& recovered_pub_keys, bool allow_duplicate_keys,
+      recovered_keys_cache* cache)const
+{ try {
+   auto start = fc::time_point::now();
+   return recover_signature_keys( signatures, sig_digest(chain_id, cfd), start, deadline, recovered_pub_keys, allow_duplicate_keys, cache );
 } FC_CAPTURE_AND_RETHROW() }
 
 flat_multimap<uint16_t, transaction_extension> transaction::validate_and_extract_extensions()const {
@@ -128,9 +139,10 @@ signature_type signed_transaction::sign(const private_key_type& key, const chain
 fc::microseconds
 signed_transaction::get_signature_keys( const chain_id_type& chain_id, fc::time_point deadline,
                                         flat_set<public_key_type>& recovered_pub_keys,
-                                        bool allow_duplicate_keys)const
+                                        bool allow_duplicate_keys,
+                                        recovered_keys_cache* cache)const
 {
-   return transaction::get_signature_keys(signatures, chain_id, deadline, context_free_data, recovered_pub_keys, allow_duplicate_keys);
+   return transaction::get_signature_keys(signatures, chain_id, deadline, context_free_data, recovered_pub_keys, allow_duplicate_keys, cache);
 }
 
 uint32_t packed_transaction::get_unprunable_size()const {
@@ -160,6 +172,13 @@ digest_type packed_transaction::packed_digest()const {
    return enc.result();
 }
 
+bool packed_transaction::operator==( const packed_transaction& rhs )const {
+   return compression_type( compression ) == compression_type( rhs.compression )
+          && packed_trx == rhs.packed_trx
+          && signatures == rhs.signatures
+          && packed_context_free_data == rhs.packed_context_free_data;
+}
+
 namespace bio = boost::iostreams;
 
 template<size_t Limit>
@@ -256,6 +275,130 @@ static bytes zlib_compress_transaction(const transaction& t) {
    return out;
 }
 
+/// the packed bytes decompressed, or the packed bytes themselves when they are not compressed
+static const bytes& raw_bytes( packed_transaction::compression_type compression, const bytes& packed, bytes& decompressed ) {
+   switch( compression ) {
+      case packed_transaction::compression_type::none:
+         return packed;
+      case packed_transaction::compression_type::zlib:
+         decompressed = zlib_decompress( packed );
+         return decompressed;
+      default:
+         EOS_THROW( unknown_transaction_compression, "Unknown transaction compression algorithm" );
+   }
+}
+
+/**
+ * Reads packed bytes the way fc::raw::unpack does, without allocating anything. Every read fails unless the bytes
+ * read are exactly what fc::raw::pack would write for the value read, so bytes that read through to the end are
+ * what packing their unpacked value gives back, and hashing them is hashing the value.
+ */
+class canonical_reader {
+public:
+   explicit canonical_reader( const bytes& b ) : pos( b.data() ), end( b.data() + b.size() ) {}
+
+   bool skip( size_t n ) {
+      if( size_t(end - pos) < n )
+         return false;
+      pos += n;
+      return true;
+   }
+
+   template<typename T>
+   bool read( T& v ) {
+      if( size_t(end - pos) < sizeof(T) )
+         return false;
+      memcpy( &v, pos, sizeof(T) );
+      pos += sizeof(T);
+      return true;
+   }
+
+   bool read_varint( uint32_t& v ) {
+      // as fc::raw::unpack of an fc::unsigned_int
+      const char* start = pos;
+      uint32_t value = 0;
+      uint8_t b = 0;
+      uint8_t by = 0;
+      do {
+         if( pos == end )
+            return false;
+         b = uint8_t(*pos++);
+         value |= uint32_t(b & 0x7f) << by;
+         by += 7;
+      } while( (b & 0x80) && by < 32 );
+      v = value;
+
+      // as fc::raw::pack of an fc::unsigned_int
+      char packed[5];
+      size_t len = 0;
+      uint64_t val = value;
+      do {
+         uint8_t c = uint8_t(val) & 0x7f;
+         val >>= 7;
+         c |= ((val > 0) << 7);
+         packed[len++] = c;
+      } while( val );
+      return len == size_t(pos - start) && memcmp( packed, start, len ) == 0;
+   }
+
+   bool skip_bytes() {
+      uint32_t size = 0;
+      return read_varint( size ) && skip( size );
+   }
+
+   bool at_end()const { return pos == end; }
+
+private:
+   const char* pos;
+   const char* end;
+};
+
+/// whether raw is a transaction exactly as fc::raw::pack writes it
+static bool scan_transaction( const bytes& raw, time_point_sec& expiration ) {
+   canonical_reader r( raw );
+   uint32_t exp = 0;
+   uint32_t n = 0;
+   // transaction_header: expiration, ref_block_num, ref_block_prefix, max_net_usage_words, max_cpu_usage_ms, delay_sec
+   if( !r.read( exp ) || !r.skip( sizeof(uint16_t) + sizeof(uint32_t) ) || !r.read_varint( n ) ||
+       !r.skip( sizeof(uint8_t) ) || !r.read_varint( n ) )
+      return false;
+   // context_free_actions then actions: account, name, authorization, data
+   for( int i = 0; i < 2; ++i ) {
+      uint32_t actions = 0;
+      if( !r.read_varint( actions ) )
+         return false;
+      for( uint32_t a = 0; a < actions; ++a ) {
+         uint32_t authorizations = 0;
+         if( !r.skip( 2 * sizeof(uint64_t) ) || !r.read_varint( authorizations ) ||
+             !r.skip( size_t(authorizations) * 2 * sizeof(uint64_t) ) || !r.skip_bytes() )
+            return false;
+      }
+   }
+   uint32_t extensions = 0;
+   if( !r.read_varint( extensions ) )
+      return false;
+   for( uint32_t e = 0; e < extensions; ++e ) {
+      if( !r.skip( sizeof(uint16_t) ) || !r.skip_bytes() )
+         return false;
+   }
+   if( !r.at_end() )
+      return false;
+   expiration = time_point_sec( exp );
+   return true;
+}
+
+/// whether raw is context free data exactly as fc::raw::pack writes it
+static bool scan_context_free_data( const bytes& raw, uint32_t& count ) {
+   canonical_reader r( raw );
+   if( !r.read_varint( count ) )
+      return false;
+   for( uint32_t i = 0; i < count; ++i ) {
+      if( !r.skip_bytes() )
+         return false;
+   }
+   return r.at_end();
+}
+
 bytes packed_transaction::get_raw_transaction() const
 {
    try {
@@ -270,16 +413,27 @@ bytes packed_transaction::get_raw_transaction() const
    } FC_CAPTURE_AND_RETHROW((compression)(packed_trx))
 }
 
+packed_transaction::packed_transaction( const packed_transaction& other )
+:fc::reflect_init(other)
+,signatures(other.signatures)
+,compression(other.compression)
+,packed_context_free_data(other.packed_context_free_data)
+,packed_trx(other.packed_trx)
+,trx_id(other.trx_id)
+,trx_expiration(other.trx_expiration)
+,canonical_trx(other.canonical_trx)
+,unpacked_trx(std::atomic_load(&other.unpacked_trx))
+,sig_digest_cache(std::atomic_load(&other.sig_digest_cache))
+{
+}
+
 packed_transaction::packed_transaction( bytes&& packed_txn, vector<signature_type>&& sigs, bytes&& packed_cfd, compression_type _compression )
 :signatures(std::move(sigs))
 ,compression(_compression)
 ,packed_context_free_data(std::move(packed_cfd))
 ,packed_trx(std::move(packed_txn))
 {
-   local_unpack_transaction({});
-   if( !packed_context_free_data.empty() ) {
-      local_unpack_context_free_data();
-   }
+   local_init_from_packed();
 }
 
 packed_transaction::packed_transaction( bytes&& packed_txn, vector<signature_type>&& sigs, vector<bytes>&& cfd, compression_type _compression )
@@ -287,8 +441,12 @@ packed_transaction::packed_transaction( bytes&& packed_txn, vector<signature_typ
 ,compression(_compression)
 ,packed_trx(std::move(packed_txn))
 {
-   local_unpack_transaction( std::move( cfd ) );
-   if( !unpacked_trx.context_free_data.empty() ) {
+   // the caller has the context free data unpacked already, so keep the transaction unpacked with it
+   signed_transaction trx = local_unpack_transaction( std::move( cfd ) );
+   trx_id = trx.id();
+   trx_expiration = trx.expiration;
+   unpacked_trx = std::make_shared<const signed_transaction>( std::move( trx ) );
+   if( !unpacked_trx->context_free_data.empty() ) {
       local_pack_context_free_data();
    }
 }
@@ -297,53 +455,124 @@ packed_transaction::packed_transaction( transaction&& t, vector<signature_type>&
 :signatures(std::move(sigs))
 ,compression(_compression)
 ,packed_context_free_data(std::move(packed_cfd))
-,unpacked_trx(std::move(t), signatures, {})
-,trx_id(unpacked_trx.id())
+,trx_id(t.id())
+,trx_expiration(t.expiration)
+,canonical_trx(true)
 {
+   unpacked_trx = std::make_shared<const signed_transaction>( std::move( t ), signatures, local_unpack_context_free_data() );
    local_pack_transaction();
-   if( !packed_context_free_data.empty() ) {
-      local_unpack_context_free_data();
-   }
 }
 
 void packed_transaction::reflector_init()
 {
    // called after construction, but always on the same thread and before packed_transaction passed to any other threads
    static_assert(fc::raw::has_feature_reflector_init_on_unpacked_reflected_types,
-                 "FC unpack needs to call reflector_init otherwise unpacked_trx will not be initialized");
-   EOS_ASSERT( unpacked_trx.expiration == time_point_sec(), tx_decompression_error, "packed_transaction already unpacked" );
-   local_unpack_transaction({});
-   local_unpack_context_free_data();
+                 "FC unpack needs to call reflector_init otherwise trx_id will not be initialized");
+   EOS_ASSERT( !unpacked_trx, tx_decompression_error, "packed_transaction already unpacked" );
+   local_init_from_packed();
 }
 
-void packed_transaction::local_unpack_transaction(vector<bytes>&& context_free_data)
+void packed_transaction::local_init_from_packed()
+{
+   try {
+      bytes decompressed;
+      const bytes& raw = raw_bytes( compression, packed_trx, decompressed );
+      canonical_trx = scan_transaction( raw, trx_expiration );
+      if( canonical_trx ) {
+         trx_id = digest_type::hash( raw.data(), raw.size() );
+      } else {
+         // packed by something other than fc, the id is of the transaction as fc packs it; unpacking also rejects malformed bytes
+         auto trx = std::make_shared<const signed_transaction>( local_unpack_transaction( local_unpack_context_free_data() ) );
+         trx_id = trx->id();
+         trx_expiration = trx->expiration;
+         unpacked_trx = std::move( trx );
+      }
+   } FC_CAPTURE_AND_RETHROW( (compression) )
+}
+
+const signed_transaction& packed_transaction::unpacked()const
+{
+   auto trx = std::atomic_load( &unpacked_trx );
+   if( trx )
+      return *trx;
+   std::shared_ptr<const signed_transaction> result =
+         std::make_shared<const signed_transaction>( local_unpack_transaction( local_unpack_context_free_data() ) );
+   // threads racing on the first use each unpack, the first to finish publishes its copy and the others use it
+   if( std::atomic_compare_exchange_strong( &unpacked_trx, &trx, result ) )
+      return *result;
+   return *trx;
+}
+
+digest_type packed_transaction::sig_digest( const chain_id_type& chain_id )const
+{
+   auto cached = std::atomic_load( &sig_digest_cache );
+   if( cached && cached->chain_id == chain_id )
+      return cached->digest;
+
+   digest_type digest;
+   if( canonical_trx ) {
+      try {
+         // as transaction::sig_digest, hashing the packed bytes in place of packing the transaction again
+         digest_type cfd_digest;
+         if( !packed_context_free_data.empty() ) {
+            bytes decompressed;
+            const bytes& raw_cfd = raw_bytes( compression, packed_context_free_data, decompressed );
+            uint32_t count = 0;
+            if( scan_context_free_data( raw_cfd, count ) ) {
+               if( count )
+                  cfd_digest = digest_type::hash( raw_cfd.data(), raw_cfd.size() );
+            } else if( !get_context_free_data().empty() ) {
+               cfd_digest = digest_type::hash( get_context_free_data() );
+            }
+         }
+
+         digest_type::encoder enc;
+         fc::raw::pack( enc, chain_id );
+         bytes decompressed;
+         const bytes& raw = raw_bytes( compression, packed_trx, decompressed );
+         enc.write( raw.data(), raw.size() );
+         fc::raw::pack( enc, cfd_digest );
+         digest = enc.result();
+      } FC_CAPTURE_AND_RETHROW( (compression) )
+   } else {
+      digest = get_transaction().sig_digest( chain_id, get_context_free_data() );
+   }
+
+   std::atomic_store( &sig_digest_cache, std::make_shared<const cached_sig_digest>( cached_sig_digest{ chain_id, digest } ) );
+   return digest;
+}
+
+fc::microseconds packed_transaction::get_signature_keys( const chain_id_type& chain_id, fc::time_point deadline,
+                                                         flat_set<public_key_type>& recovered_pub_keys,
+                                                         bool allow_duplicate_keys,
+                                                         recovered_keys_cache* cache )const
+{ try {
+   auto start = fc::time_point::now();
+   return recover_signature_keys( signatures, sig_digest( chain_id ), start, deadline, recovered_pub_keys, allow_duplicate_keys, cache );
+} FC_CAPTURE_AND_RETHROW() }
+
+signed_transaction packed_transaction::local_unpack_transaction(vector<bytes>&& context_free_data)const
 {
    try {
       switch( compression ) {
          case compression_type::none:
-            unpacked_trx = signed_transaction( unpack_transaction( packed_trx ), signatures, std::move(context_free_data) );
-            break;
+            return signed_transaction( unpack_transaction( packed_trx ), signatures, std::move(context_free_data) );
          case compression_type::zlib:
-            unpacked_trx = signed_transaction( zlib_decompress_transaction( packed_trx ), signatures, std::move(context_free_data) );
-            break;
+            return signed_transaction( zlib_decompress_transaction( packed_trx ), signatures, std::move(context_free_data) );
          default:
             EOS_THROW( unknown_transaction_compression, "Unknown transaction compression algorithm" );
       }
-      trx_id = unpacked_trx.id();
    } FC_CAPTURE_AND_RETHROW( (compression) )
 }
 
-void packed_transaction::local_unpack_context_free_data()
+vector<bytes> packed_transaction::local_unpack_context_free_data()const
 {
    try {
-      EOS_ASSERT(unpacked_trx.context_free_data.empty(), tx_decompression_error, "packed_transaction.context_free_data not empty");
       switch( compression ) {
          case compression_type::none:
-            unpacked_trx.context_free_data = unpack_context_free_data( packed_context_free_data );
-            break;
+            return unpack_context_free_data( packed_context_free_data );
          case compression_type::zlib:
-            unpacked_trx.context_free_data = zlib_decompress_context_free_data( packed_context_free_data );
-            break;
+            return zlib_decompress_context_free_data( packed_context_free_data );
          default:
             EOS_THROW( unknown_transaction_compression, "Unknown transaction compression algorithm" );
       }
@@ -355,10 +584,10 @@ void packed_transaction::local_pack_transaction()
    try {
       switch(compression) {
          case compression_type::none:
-            packed_trx = pack_transaction(unpacked_trx);
+            packed_trx = pack_transaction(*unpacked_trx);
             break;
          case compression_type::zlib:
-            packed_trx = zlib_compress_transaction(unpacked_trx);
+            packed_trx = zlib_compress_transaction(*unpacked_trx);
             break;
          default:
             EOS_THROW(unknown_transaction_compression, "Unknown transaction compression algorithm");
@@ -371,10 +600,10 @@ void packed_transaction::local_pack_context_free_data()
    try {
       switch(compression) {
          case compression_type::none:
-            packed_context_free_data = pack_context_free_data(unpacked_trx.context_free_data);
+            packed_context_free_data = pack_context_free_data(unpacked_trx->context_free_data);
             break;
          case compression_type::zlib:
-            packed_context_free_data = zlib_compress_context_free_data(unpacked_trx.context_free_data);
+            packed_context_free_data = zlib_compress_context_free_data(unpacked_trx->context_free_data);
             break;
          default:
             EOS_THROW(unknown_transaction_compression, "Unknown transaction compression algorithm");
@@ -0,0 +1,83 @@
+#include <eosio/chain/transaction_conflict_groups.hpp>
+
+namespace eosio { namespace chain {
+
+   size_t transaction_conflict_groups::largest_group()const {
+      size_t largest = 0;
+      for( const auto& g : groups )
+         largest = std::max( largest, g.size() );
+      return largest;
+   }
+
+   namespace {
+      struct disjoint_sets {
+         explicit disjoint_sets( size_t n ) : parent( n ) {
+            for( size_t i = 0; i < n; ++i ) parent[i] = i;
+         }
+
+         uint32_t find( uint32_t i ) {
+            while( parent[i] != i ) {
+               parent[i] = parent[parent[i]];
+               i = parent[i];
+            }
+            return i;
+         }
+
+         void join( uint32_t a, uint32_t b ) {
+            a = find( a );
+            b = find( b );
+            if( a != b )
+               parent[std::max( a, b )] = std::min( a, b );
+         }
+
+         vector<uint32_t> parent;
+      };
+   }
+
+   transaction_conflict_groups compute_transaction_conflict_groups( const signed_block& b ) {
+      transaction_conflict_groups result;
+
+      const uint32_t num_receipts = b.transactions.size();
+      disjoint_sets sets( num_receipts );
+      flat_map<account_name, uint32_t> first_user; // account -> first receipt index declaring it
+      first_user.reserve( num_receipts * 2 );
+
+      auto declare = [&]( account_name a, uint32_t idx ) {
+         auto res = first_user.emplace( a, idx );
+         if( !res.second )
+            sets.join( res.first->second, idx );
+      };
+
+      vector<bool> is_input( num_receipts, false );
+      for( uint32_t i = 0; i < num_receipts; ++i ) {
+         const auto& receipt = b.transactions[i];
+         if( !receipt.trx.contains<packed_transaction>() ) {
+            result.scheduled.push_back( i );
+            continue;
+         }
+         is_input[i] = true;
+         const transaction& trx = receipt.trx.get<packed_transaction>().get_transaction();
+         for( const auto& act : trx.context_free_actions ) {
+            declare( act.account, i );
+         }
+         for( const auto& act : trx.actions ) {
+            declare( act.account, i );
+            for( const auto& auth : act.authorization ) {
+               declare( auth.actor, i );
+            }
+         }
+      }
+
+      flat_map<uint32_t, uint32_t> group_of_root;
+      for( uint32_t i = 0; i < num_receipts; ++i ) {
+         if( !is_input[i] ) continue;
+         auto res = group_of_root.emplace( sets.find( i ), result.groups.size() );
+         if( res.second )
+            result.groups.emplace_back();
+         result.groups[res.first->second].push_back( i );
+      }
+
+      return result;
+   }
+
+} } /// eosio::chain
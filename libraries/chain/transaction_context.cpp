@@ -1,11 +1,13 @@
 #include <eosio/chain/apply_context.hpp>
 #include <eosio/chain/transaction_context.hpp>
+#include <eosio/chain/account_object.hpp>
 #include <eosio/chain/authorization_manager.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
+#include <eosio/chain/span_tracer.hpp>
 
 #pragma push_macro("N")
 #undef N
@@ -65,7 +67,12 @@ namespace eosio { namespace chain {
       trace->block_num = c.head_block_num() + 1;
       trace->block_time = c.pending_block_time();
       trace->producer_block_id = c.pending_producer_block_id();
+      if( c.track_access_sets() )
+         trace->accesses.emplace();
+      if( c.trace_cpu_breakdown() )
+         trace->cpu_breakdown.emplace();
       executed.reserve( trx.total_actions() );
+      trace->action_traces.reserve( trx.total_actions() );
    }
 
    void transaction_context::disallow_transaction_extensions( const char* error_msg )const {
@@ -262,6 +269,7 @@ namespace eosio { namespace chain {
 
    void transaction_context::exec() {
       EOS_ASSERT( is_initialized, transaction_exception, "must first initialize" );
+      scoped_span span( "chain", "exec", span_trace_id( id ) );
 
       if( apply_context_free ) {
          for( const auto& act : trx.context_free_actions ) {
@@ -299,8 +307,15 @@ namespace eosio { namespace chain {
       }
 
       auto& rl = control.get_mutable_resource_limits_manager();
-      for( auto a : validate_ram_usage ) {
-         rl.verify_account_ram_usage( a );
+      {
+         scoped_cpu_timer ram_timer( trace->cpu_breakdown ? &trace->cpu_breakdown->ram_ns : nullptr );
+         for( const auto& p : pending_ram_usage ) {
+            rl.add_pending_ram_usage( p.first, p.second.delta );
+         }
+         pending_ram_usage.clear();
+         for( auto a : validate_ram_usage ) {
+            rl.verify_account_ram_usage( a );
+         }
       }
 
       // Calculate the new highest network usage and CPU time that all of the billed accounts can afford to be billed
@@ -339,6 +354,9 @@ namespace eosio { namespace chain {
 
       rl.add_transaction_usage( bill_to_accounts, static_cast<uint64_t>(billed_cpu_time_us), net_usage,
                                 block_timestamp_type(control.pending_block_time()).slot ); // Should never fail
+
+      // no apply_context outlives exec()
+      action_arena.release();
    }
 
    void transaction_context::squash() {
@@ -469,9 +487,26 @@ namespace eosio { namespace chain {
       }
    }
 
+   // the usage rows are modified once per account in finalize(), with the same overflow checks on the running total here
    void transaction_context::add_ram_usage( account_name account, int64_t ram_delta ) {
-      auto& rl = control.get_mutable_resource_limits_manager();
-      rl.add_pending_ram_usage( account, ram_delta );
+      if( ram_delta == 0 ) {
+         return;
+      }
+
+      auto itr = pending_ram_usage.find( account );
+      if( itr == pending_ram_usage.end() ) {
+         const uint64_t ram_usage = control.get_resource_limits_manager().get_account_ram_usage( account );
+         itr = pending_ram_usage.emplace( account, pending_ram_usage_entry{ ram_usage, 0 } ).first;
+      }
+      auto& pending = itr->second;
+      const uint64_t usage = pending.ram_usage + pending.delta;
+
+      EOS_ASSERT( ram_delta <= 0 || UINT64_MAX - usage >= (uint64_t)ram_delta, transaction_exception,
+                  "Ram usage delta would overflow UINT64_MAX");
+      EOS_ASSERT( ram_delta >= 0 || usage >= (uint64_t)(-ram_delta), transaction_exception,
+                  "Ram usage delta would underflow UINT64_MAX");
+
+      pending.delta += ram_delta;
       if( ram_delta > 0 ) {
          validate_ram_usage.insert( account );
       }
@@ -507,15 +542,14 @@ namespace eosio { namespace chain {
                greylist_limit = specified_greylist_limit;
             }
          }
-         auto [net_limit, net_was_greylisted] = rl.get_account_net_limit(a, greylist_limit);
-         if( net_limit >= 0 ) {
-            account_net_limit = std::min( account_net_limit, net_limit );
-            greylisted_net |= net_was_greylisted;
+         const auto limits = rl.get_account_bandwidth_limits(a, greylist_limit);
+         if( limits.net.available >= 0 ) {
+            account_net_limit = std::min( account_net_limit, limits.net.available );
+            greylisted_net |= limits.net_greylisted;
          }
-         auto [cpu_limit, cpu_was_greylisted] = rl.get_account_cpu_limit(a, greylist_limit);
-         if( cpu_limit >= 0 ) {
-            account_cpu_limit = std::min( account_cpu_limit, cpu_limit );
-            greylisted_cpu |= cpu_was_greylisted;
+         if( limits.cpu.available >= 0 ) {
+            account_cpu_limit = std::min( account_cpu_limit, limits.cpu.available );
+            greylisted_cpu |= limits.cpu_greylisted;
          }
       }
 
@@ -575,7 +609,8 @@ namespace eosio { namespace chain {
    {
       uint32_t new_action_ordinal = trace->action_traces.size() + 1;
 
-      trace->action_traces.reserve( new_action_ordinal );
+      if( trace->action_traces.capacity() < new_action_ordinal )
+         trace->action_traces.reserve( std::max<size_t>( new_action_ordinal, 2 * trace->action_traces.size() ) );
 
       const action& provided_action = get_action_trace( action_ordinal ).act;
 
@@ -637,12 +672,10 @@ namespace eosio { namespace chain {
    } /// record_transaction
 
    void transaction_context::validate_referenced_accounts( const transaction& trx, bool enforce_actor_whitelist_blacklist )const {
-      const auto& db = control.db();
       const auto& auth_manager = control.get_authorization_manager();
 
       for( const auto& a : trx.context_free_actions ) {
-         auto* code = db.find<account_object, by_name>(a.account);
-         EOS_ASSERT( code != nullptr, transaction_exception,
+         EOS_ASSERT( is_account( a.account ), transaction_exception,
                      "action's code account '${account}' does not exist", ("account", a.account) );
          EOS_ASSERT( a.authorization.size() == 0, transaction_exception,
                      "context-free actions cannot have authorizations" );
@@ -652,13 +685,11 @@ namespace eosio { namespace chain {
 
       bool one_auth = false;
       for( const auto& a : trx.actions ) {
-         auto* code = db.find<account_object, by_name>(a.account);
-         EOS_ASSERT( code != nullptr, transaction_exception,
+         EOS_ASSERT( is_account( a.account ), transaction_exception,
                      "action's code account '${account}' does not exist", ("account", a.account) );
          for( const auto& auth : a.authorization ) {
             one_auth = true;
-            auto* actor = db.find<account_object, by_name>(auth.actor);
-            EOS_ASSERT( actor  != nullptr, transaction_exception,
+            EOS_ASSERT( is_account( auth.actor ), transaction_exception,
                         "action's authorizing actor '${account}' does not exist", ("account", auth.actor) );
             EOS_ASSERT( auth_manager.find_permission(auth) != nullptr, transaction_exception,
                         "action's authorizations include a non-existent permission: ${permission}",
@@ -674,5 +705,20 @@ namespace eosio { namespace chain {
       }
    }
 
+   const account_metadata_object& transaction_context::get_account_metadata( account_name account ) {
+      auto itr = account_metadata_cache.find( account );
+      if( itr == account_metadata_cache.end() )
+         itr = account_metadata_cache.emplace( account, &control.db().get<account_metadata_object,by_name>( account ) ).first;
+      return *itr->second;
+   }
+
+   bool transaction_context::is_account( account_name account )const {
+      if( known_accounts.count( account ) )
+         return true;
+      if( !control.db().find<account_object,by_name>( account ) )
+         return false;
+      known_accounts.insert( account );
+      return true;
+   }
 
 } } /// eosio::chain
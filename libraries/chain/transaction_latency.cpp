@@ -0,0 +1,183 @@
+#include <eosio/chain/transaction_latency.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace eosio { namespace chain {
+
+constexpr std::array<uint32_t, 12> transaction_latency::bounds_us;
+
+std::atomic<bool> transaction_latency::_enabled{false};
+
+namespace {
+   enum stamp { received_at, recovered_at, started_at, executed_at, included_at, num_stamps };
+
+   using record = std::array<fc::time_point, num_stamps>;
+
+   struct id_hash {
+      size_t operator()( const transaction_id_type& id )const { return id._hash[0]; }
+   };
+
+   struct tally {
+      uint64_t count = 0;
+      uint64_t sum_us = 0;
+      uint64_t max_us = 0;
+      std::array<uint64_t, transaction_latency::bounds_us.size() + 1> buckets{};
+
+      void observe( fc::microseconds d ) {
+         const uint64_t us = std::max<int64_t>( d.count(), 0 );
+         ++count;
+         sum_us += us;
+         max_us = std::max( max_us, us );
+         const auto& bounds = transaction_latency::bounds_us;
+         ++buckets[std::lower_bound( bounds.begin(), bounds.end(), us ) - bounds.begin()];
+      }
+
+      uint64_t percentile( double p )const {
+         if( count == 0 ) return 0;
+         const uint64_t target = std::max<uint64_t>( 1, static_cast<uint64_t>( p * count + 0.5 ) );
+         uint64_t seen = 0;
+         for( size_t b = 0; b < buckets.size(); ++b ) {
+            seen += buckets[b];
+            if( seen >= target )
+               return b < transaction_latency::bounds_us.size() ? std::min<uint64_t>( transaction_latency::bounds_us[b], max_us ) : max_us;
+         }
+         return max_us;
+      }
+   };
+
+   // all guarded by mtx
+   std::mutex                                                 mtx;
+   uint32_t                                                   max_records = 0;
+   std::unordered_map<transaction_id_type, record, id_hash>   records;
+   std::deque<transaction_id_type>                            insertion_order; // a superset of the ids of records
+   std::array<tally, static_cast<size_t>( transaction_latency::stage::count )> tallies;
+
+   /// sets stamp s of the record of id, if tracked, when unset or when overwrite allows it
+   template<typename Overwrite>
+   void stamp_record( const transaction_id_type& id, stamp s, Overwrite&& overwrite ) {
+      if( !transaction_latency::enabled() ) return;
+      const auto now = fc::time_point::now();
+      std::lock_guard<std::mutex> g( mtx );
+      auto itr = records.find( id );
+      if( itr == records.end() ) return;
+      auto& r = itr->second;
+      if( r[s] == fc::time_point() || overwrite( r ) )
+         r[s] = now;
+   }
+
+   const auto first_only = []( const record& ) { return false; };
+   const auto until_included = []( const record& r ) { return r[included_at] == fc::time_point(); };
+
+   template<typename F>
+   void for_each_input_trx( const signed_block& b, F&& f ) {
+      for( const auto& receipt : b.transactions ) {
+         if( receipt.trx.contains<packed_transaction>() )
+            f( receipt.trx.get<packed_transaction>().id() );
+      }
+   }
+
+   void observe( transaction_latency::stage s, const record& r, stamp from, stamp to ) {
+      if( r[from] != fc::time_point() && r[to] != fc::time_point() )
+         tallies[static_cast<size_t>( s )].observe( r[to] - r[from] );
+   }
+}
+
+void transaction_latency::enable( uint32_t max_tracked ) {
+   std::lock_guard<std::mutex> g( mtx );
+   max_records = max_tracked;
+   if( max_tracked == 0 ) {
+      records.clear();
+      insertion_order.clear();
+   }
+   _enabled.store( max_tracked > 0, std::memory_order_relaxed );
+}
+
+void transaction_latency::received( const transaction_id_type& id ) {
+   if( !enabled() ) return;
+   const auto now = fc::time_point::now();
+   std::lock_guard<std::mutex> g( mtx );
+   if( max_records == 0 ) return;
+   auto r = records.emplace( id, record{} );
+   if( !r.second ) return;
+   r.first->second[received_at] = now;
+   insertion_order.push_back( id );
+   while( insertion_order.size() > max_records ) {
+      records.erase( insertion_order.front() );
+      insertion_order.pop_front();
+   }
+}
+
+void transaction_latency::keys_recovered( const transaction_id_type& id ) {
+   stamp_record( id, recovered_at, first_only );
+}
+
+void transaction_latency::execution_started( const transaction_id_type& id ) {
+   stamp_record( id, started_at, until_included );
+}
+
+void transaction_latency::executed( const transaction_id_type& id ) {
+   stamp_record( id, executed_at, until_included );
+}
+
+void transaction_latency::included( const signed_block& b ) {
+   if( !enabled() ) return;
+   for_each_input_trx( b, []( const transaction_id_type& id ) {
+      stamp_record( id, included_at, first_only );
+   } );
+}
+
+void transaction_latency::irreversible( const signed_block& b ) {
+   if( !enabled() ) return;
+   const auto now = fc::time_point::now();
+   std::lock_guard<std::mutex> g( mtx );
+   for_each_input_trx( b, [now]( const transaction_id_type& id ) {
+      auto itr = records.find( id );
+      if( itr == records.end() ) return;
+      const auto& r = itr->second;
+      observe( stage::key_recovery, r, received_at, recovered_at );
+      observe( stage::queue,        r, recovered_at, started_at );
+      observe( stage::execution,    r, started_at, executed_at );
+      observe( stage::inclusion,    r, executed_at, included_at );
+      if( r[included_at] != fc::time_point() )
+         tallies[static_cast<size_t>( stage::irreversibility )].observe( now - r[included_at] );
+      tallies[static_cast<size_t>( stage::total )].observe( now - r[received_at] );
+      records.erase( itr );
+   } );
+}
+
+const char* transaction_latency::stage_name( stage s ) {
+   switch( s ) {
+      case stage::key_recovery:    return "key_recovery";
+      case stage::queue:           return "queue";
+      case stage::execution:       return "execution";
+      case stage::inclusion:       return "inclusion";
+      case stage::irreversibility: return "irreversibility";
+      case stage::total:           return "total";
+      case stage::count:           break;
+   }
+   return "unknown";
+}
+
+std::vector<transaction_latency::stage_stats> transaction_latency::all() {
+   std::vector<stage_stats> result;
+   std::lock_guard<std::mutex> g( mtx );
+   for( size_t i = 0; i < tallies.size(); ++i ) {
+      const auto& t = tallies[i];
+      stage_stats s;
+      s.stage  = stage_name( static_cast<stage>( i ) );
+      s.count  = t.count;
+      s.sum_us = t.sum_us;
+      s.max_us = t.max_us;
+      s.p50_us = t.percentile( 0.50 );
+      s.p90_us = t.percentile( 0.90 );
+      s.p99_us = t.percentile( 0.99 );
+      s.buckets.assign( t.buckets.begin(), t.buckets.end() );
+      result.push_back( std::move( s ) );
+   }
+   return result;
+}
+
+} } // eosio::chain
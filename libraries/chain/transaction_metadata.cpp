@@ -1,5 +1,6 @@
 #include <eosio/chain/transaction_metadata.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/span_tracer.hpp>
 #include <boost/asio/thread_pool.hpp>
 
 namespace eosio { namespace chain {
@@ -8,15 +9,19 @@ recover_keys_future transaction_metadata::start_recover_keys( packed_transaction
                                                               boost::asio::io_context& thread_pool,
                                                               const chain_id_type& chain_id,
                                                               fc::microseconds time_limit,
-                                                              uint32_t max_variable_sig_size )
+                                                              uint32_t max_variable_sig_size,
+                                                              recovered_keys_cache* cache )
 {
-   return async_thread_pool( thread_pool, [trx{std::move(trx)}, chain_id, time_limit, max_variable_sig_size]() mutable {
+   return async_thread_pool( thread_pool, [trx{std::move(trx)}, chain_id, time_limit, max_variable_sig_size, cache]() mutable {
+         scoped_span span( "chain", "recover_keys", span_trace_id( trx->id() ) );
          fc::time_point deadline = time_limit == fc::microseconds::maximum() ?
                                    fc::time_point::maximum() : fc::time_point::now() + time_limit;
          check_variable_sig_size( trx, max_variable_sig_size );
-         const signed_transaction& trn = trx->get_signed_transaction();
          flat_set<public_key_type> recovered_pub_keys;
-         fc::microseconds cpu_usage = trn.get_signature_keys( chain_id, deadline, recovered_pub_keys );
+         fc::microseconds cpu_usage = trx->get_signature_keys( chain_id, deadline, recovered_pub_keys, false, cache );
+         // keys are recovered from the packed bytes, but every caller is about to apply the transaction, so unpack it
+         // here rather than on the main thread; transactions that are only relayed never come through here
+         trx->get_signed_transaction();
          return std::make_shared<transaction_metadata>( private_type(), std::move( trx ), cpu_usage, std::move( recovered_pub_keys ) );
       }
    );
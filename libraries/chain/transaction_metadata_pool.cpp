@@ -0,0 +1,57 @@
+#include <eosio/chain/transaction_metadata_pool.hpp>
+
+namespace eosio { namespace chain {
+
+   transaction_metadata_pool::transaction_metadata_pool( uint32_t capacity )
+   :_shard_capacity( (capacity + num_shards - 1) / num_shards )
+   {}
+
+   void transaction_metadata_pool::add( const transaction_metadata_ptr& trx ) {
+      if( !enabled() || !trx || trx->recovered_keys().empty() || trx->implicit || trx->scheduled || trx->read_only )
+         return;
+
+      const auto& id = trx->id();
+      auto& s = shard_of( id );
+      std::lock_guard<std::mutex> g( s.mtx );
+      auto r = s.trxs.emplace( id, trx );
+      if( !r.second ) {
+         r.first->second = trx;
+         return;
+      }
+      s.insertion_order.emplace_back( id );
+      if( s.insertion_order.size() > _shard_capacity ) {
+         s.trxs.erase( s.insertion_order.front() );
+         s.insertion_order.pop_front();
+      }
+   }
+
+   transaction_metadata_ptr transaction_metadata_pool::find( const packed_transaction& pt ) {
+      if( !enabled() )
+         return {};
+
+      transaction_metadata_ptr trx;
+      {
+         auto& s = shard_of( pt.id() );
+         std::lock_guard<std::mutex> g( s.mtx );
+         auto itr = s.trxs.find( pt.id() );
+         if( itr != s.trxs.end() )
+            trx = itr->second;
+      }
+      if( !trx || *trx->packed_trx() != pt ) {
+         ++_misses;
+         return {};
+      }
+      ++_hits;
+      return trx;
+   }
+
+   size_t transaction_metadata_pool::size()const {
+      size_t total = 0;
+      for( const auto& s : _shards ) {
+         std::lock_guard<std::mutex> g( s.mtx );
+         total += s.trxs.size();
+      }
+      return total;
+   }
+
+} } /// eosio::chain
@@ -0,0 +1,65 @@
+#include <eosio/chain/transaction_template.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+namespace eosio { namespace chain {
+
+   namespace {
+      /// records where the data of each action starts as the actions pack one after another from offset
+      size_t locate_action_data( const vector<action>& actions, size_t offset, vector<size_t>& data_offsets, vector<size_t>& data_sizes ) {
+         offset += fc::raw::pack_size( fc::unsigned_int( actions.size() ) );
+         for( const auto& a : actions ) {
+            const size_t data_offset = offset + sizeof(a.account) + sizeof(a.name) + fc::raw::pack_size( a.authorization )
+                                     + fc::raw::pack_size( fc::unsigned_int( a.data.size() ) );
+            data_offsets.push_back( data_offset );
+            data_sizes.push_back( a.data.size() );
+            offset = data_offset + a.data.size();
+         }
+         return offset;
+      }
+   }
+
+   transaction_template::transaction_template( const transaction& trx )
+   :_packed( fc::raw::pack( trx ) )
+   {
+      size_t offset = fc::raw::pack_size( static_cast<const transaction_header&>( trx ) );
+      offset = locate_action_data( trx.context_free_actions, offset, _context_free_action_data, _context_free_action_data_size );
+      offset = locate_action_data( trx.actions, offset, _action_data, _action_data_size );
+      EOS_ASSERT( offset + fc::raw::pack_size( trx.transaction_extensions ) == _packed.size(), transaction_exception,
+                  "transaction template layout does not match its packed size" );
+   }
+
+   uint32_t transaction_template::add_data_slot( bool context_free, uint32_t action_index, uint32_t data_offset, uint32_t size ) {
+      const auto& offsets = context_free ? _context_free_action_data : _action_data;
+      const auto& sizes = context_free ? _context_free_action_data_size : _action_data_size;
+      EOS_ASSERT( action_index < offsets.size(), transaction_exception, "transaction template has no action ${i}", ("i", action_index) );
+      EOS_ASSERT( data_offset <= sizes[action_index] && size <= sizes[action_index] - data_offset, transaction_exception,
+                  "slot of ${n} bytes at ${o} is outside the ${s} bytes of action data",
+                  ("n", size)("o", data_offset)("s", sizes[action_index]) );
+      _slots.push_back( slot{ static_cast<uint32_t>( offsets[action_index] + data_offset ), size } );
+      return _slots.size() - 1;
+   }
+
+   void transaction_template::set_header( bytes& packed, fc::time_point_sec expiration, const block_id_type& reference_block )const {
+      transaction_header header;
+      header.expiration = expiration;
+      header.set_reference_block( reference_block );
+      // expiration, ref_block_num and ref_block_prefix lead the packed header, at fixed sizes
+      fc::datastream<char*> ds( packed.data(), sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t) );
+      fc::raw::pack( ds, header.expiration );
+      fc::raw::pack( ds, header.ref_block_num );
+      fc::raw::pack( ds, header.ref_block_prefix );
+   }
+
+   digest_type transaction_template::sig_digest( const bytes& packed, const chain_id_type& chain_id ) {
+      digest_type::encoder enc;
+      fc::raw::pack( enc, chain_id );
+      enc.write( packed.data(), packed.size() );
+      fc::raw::pack( enc, digest_type() );
+      return enc.result();
+   }
+
+   packed_transaction transaction_template::make_packed( bytes&& packed, vector<signature_type>&& sigs ) {
+      return packed_transaction( std::move( packed ), std::move( sigs ), bytes(), packed_transaction::compression_type::none );
+   }
+
+} } /// namespace eosio::chain
@@ -13,6 +13,7 @@
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/protocol_state_object.hpp>
 #include <eosio/chain/account_object.hpp>
+#include <eosio/chain/hardware_float.hpp>
 #include <fc/exception/exception.hpp>
 #include <fc/crypto/sha256.hpp>
 #include <fc/crypto/sha1.hpp>
@@ -22,7 +23,10 @@
 #include <compiler_builtins.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include <deque>
 #include <fstream>
+#include <mutex>
+#include <set>
 #include <string.h>
 
 #if defined(EOSIO_EOS_VM_RUNTIME_ENABLED) || defined(EOSIO_EOS_VM_JIT_RUNTIME_ENABLED)
@@ -32,34 +36,110 @@
 namespace eosio { namespace chain {
    using namespace webassembly::common;
 
-   wasm_interface::wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config)
-     : my( new wasm_interface_impl(vm, eosvmoc_tierup, d, data_dir, eosvmoc_config) ) {}
+   wasm_interface::wasm_interface(vm_type vm, bool eosvmoc_tierup, const chainbase::database& d, const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config,
+                                  uint64_t instantiation_cache_size)
+     : my( new wasm_interface_impl(vm, eosvmoc_tierup, d, data_dir, eosvmoc_config, instantiation_cache_size) ) {}
 
    wasm_interface::~wasm_interface() {}
 
-   void wasm_interface::validate(const controller& control, const bytes& code) {
-      Module module;
-      try {
-         Serialization::MemoryInputStream stream((U8*)code.data(), code.size());
-         WASM::serialize(stream, module);
-      } catch(const Serialization::FatalSerializationException& e) {
-         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
-      } catch(const IR::ValidationException& e) {
-         EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+   namespace {
+      //codes that passed validate, keyed by everything validation depends on: the code, whether a block was being
+      //produced (it relaxes nesting limits otherwise) and the whitelisted intrinsics it was linked against. The same
+      //code is often set on many accounts; only successes are kept so a failure always reports afresh
+      class validated_code_cache {
+      public:
+         using key_type = std::tuple<digest_type, bool, digest_type>;
+
+         bool contains(const key_type& key) {
+            std::lock_guard<std::mutex> g(mtx);
+            const bool found = keys.count(key);
+            hits += found;
+            return found;
+         }
+
+         void insert(const key_type& key) {
+            std::lock_guard<std::mutex> g(mtx);
+            if(!keys.insert(key).second)
+               return;
+            order.push_back(key);
+            if(order.size() > max_entries) {
+               keys.erase(order.front());
+               order.pop_front();
+            }
+         }
+
+         uint64_t hit_count() {
+            std::lock_guard<std::mutex> g(mtx);
+            return hits;
+         }
+
+      private:
+         static constexpr size_t max_entries = 1024;
+         uint64_t                hits = 0;
+         std::mutex              mtx;
+         std::set<key_type>      keys;
+         std::deque<key_type>    order;
+      };
+
+      validated_code_cache validated_codes;
+
+      digest_type whitelisted_intrinsics_digest(const whitelisted_intrinsics_type& whitelisted_intrinsics) {
+         digest_type::encoder enc;
+         for(const auto& intrinsic : whitelisted_intrinsics) {
+            fc::raw::pack(enc, static_cast<uint32_t>(intrinsic.second.size()));
+            enc.write(intrinsic.second.data(), intrinsic.second.size());
+         }
+         return enc.result();
       }
+   }
 
-      wasm_validations::wasm_binary_validation validator(control, module);
-      validator.validate();
+   uint64_t wasm_interface::validation_cache_hits() {
+      return validated_codes.hit_count();
+   }
 
-      const auto& pso = control.db().get<protocol_state_object>();
+   void wasm_interface::validate(const controller& control, const bytes& code) {
+      validate(control, fc::sha256::hash(code.data(), (uint32_t)code.size()), code);
+   }
 
-      root_resolver resolver( pso.whitelisted_intrinsics );
-      LinkResult link_result = linkModule(module, resolver);
+   namespace {
+      //validates code into module; false when it validated before and was not parsed
+      bool validate_module(const controller& control, const digest_type& code_hash, const bytes& code, Module& module) {
+         const auto& pso = control.db().get<protocol_state_object>();
+         const validated_code_cache::key_type key{code_hash, control.is_producing_block(), whitelisted_intrinsics_digest(pso.whitelisted_intrinsics)};
+         if(validated_codes.contains(key))
+            return false;
+
+         try {
+            Serialization::MemoryInputStream stream((U8*)code.data(), code.size());
+            WASM::serialize(stream, module);
+         } catch(const Serialization::FatalSerializationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         } catch(const IR::ValidationException& e) {
+            EOS_ASSERT(false, wasm_serialization_error, e.message.c_str());
+         }
+
+         wasm_validations::wasm_binary_validation validator(control, module);
+         validator.validate();
+
+         root_resolver resolver( pso.whitelisted_intrinsics );
+         LinkResult link_result = linkModule(module, resolver);
+
+         validated_codes.insert(key);
+         return true;
+      }
+   }
+
+   void wasm_interface::validate(const controller& control, const digest_type& code_hash, const bytes& code) {
+      Module module;
+      validate_module(control, code_hash, code, module);
+   }
 
-      //there are a couple opportunties for improvement here--
-      //Easy: Cache the Module created here so it can be reused for instantiaion
+   void wasm_interface::validate_new_code(const controller& control, const digest_type& code_hash, const bytes& code) {
+      Module module;
+      if(validate_module(control, code_hash, code, module))
+         my->keep_parsed(code_hash, std::move(module));
       //Hard: Kick off instantiation in a separate thread at this location
-	 }
+   }
 
    void wasm_interface::indicate_shutting_down() {
       my->is_shutting_down = true;
@@ -73,11 +153,22 @@ namespace eosio { namespace chain {
       my->current_lib(lib);
    }
 
+   void wasm_interface::warm_up_code_cache() {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(my->eosvmoc)
+         my->eosvmoc->cc.warm_up();
+#endif
+   }
+
    void wasm_interface::apply( const digest_type& code_hash, const uint8_t& vm_type, const uint8_t& vm_version, apply_context& context ) {
+      bool oc_tier = my->wasm_runtime_time == wasm_interface::vm_type::eos_vm_oc;
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      const chain::eosvmoc::code_descriptor* cd = nullptr;
+      //held until the code has run, a process sharing its code cache with this one can't evict the code meanwhile
+      chain::eosvmoc::code_cache_base::execution_lock oc_lock;
       if(my->eosvmoc) {
-         const chain::eosvmoc::code_descriptor* cd = nullptr;
          try {
+            oc_lock = my->eosvmoc->cc.lock_for_execution();
             cd = my->eosvmoc->cc.get_descriptor_for_code(code_hash, vm_version);
          }
          catch(...) {
@@ -88,15 +179,92 @@ namespace eosio { namespace chain {
                elog("EOS VM OC has encountered an unexpected failure");
             once_is_enough = true;
          }
-         if(cd) {
-            my->eosvmoc->exec.execute(*cd, my->eosvmoc->mem, context);
-            return;
+         oc_tier = cd != nullptr;
+      }
+#endif
+
+      action_cpu_breakdown* breakdown = context.cpu_breakdown();
+      // the tier is only known here; apply_context takes the host function time back out when it finalizes the trace
+      scoped_cpu_timer wasm_timer( breakdown ? (oc_tier ? &breakdown->wasm_oc_ns : &breakdown->wasm_baseline_ns) : nullptr );
+      const fc::time_point start = fc::time_point::now();
+      auto record = fc::make_scoped_exit([&]() {
+         const fc::microseconds elapsed = fc::time_point::now() - start;
+         if(wasm_interface_impl::code_tier_counters* counters = my->find_or_add_code_tier_counters(code_hash, vm_type, vm_version)) {
+            if(oc_tier) {
+               ++counters->oc_executions;
+               counters->oc_time += elapsed;
+            }
+            else {
+               ++counters->baseline_executions;
+               counters->baseline_time += elapsed;
+            }
          }
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+         //code waiting on tier-up is compiled in order of how much it is costing on the baseline runtime
+         if(!oc_tier && my->eosvmoc)
+            my->eosvmoc->cc.record_baseline_execution(code_hash, vm_version, elapsed);
+#endif
+      });
+
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if(cd) {
+         my->eosvmoc->exec.execute(*cd, context);
+         return;
       }
 #endif
       my->get_instantiated_module(code_hash, vm_type, vm_version, context.trx_context)->apply(context);
    }
 
+   wasm_interface::execution_stats wasm_interface::get_execution_stats() const {
+      execution_stats stats;
+      stats.codes.reserve(my->code_tier_stats.size());
+      for(const auto& [key, counters] : my->code_tier_stats) {
+         code_execution_stats& cs = stats.codes.emplace_back();
+         cs.code_hash           = key.first;
+         cs.vm_version          = key.second;
+         cs.baseline_executions = counters.baseline_executions;
+         cs.baseline_time       = counters.baseline_time;
+         cs.oc_executions       = counters.oc_executions;
+         cs.oc_time             = counters.oc_time;
+      }
+
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      const chain::eosvmoc::code_cache_base* cc = nullptr;
+      if(my->eosvmoc)
+         cc = &my->eosvmoc->cc;
+      else if(auto* oc_runtime = dynamic_cast<webassembly::eosvmoc::eosvmoc_runtime*>(my->runtime_interface.get()))
+         cc = &oc_runtime->cc;
+      if(cc) {
+         stats.oc_cache_hits      = cc->stats().hits;
+         stats.oc_cache_misses    = cc->stats().misses;
+         stats.oc_cache_evictions = cc->stats().evictions;
+         for(code_execution_stats& cs : stats.codes)
+            if(auto it = cc->compile_latencies().find(chain::eosvmoc::code_tuple{cs.code_hash, cs.vm_version}); it != cc->compile_latencies().end())
+               cs.oc_compile_latency = it->second;
+      }
+#endif
+      return stats;
+   }
+
+   std::string wasm_interface::eosvmoc_function_name(size_t cache_offset) const {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      const chain::eosvmoc::code_cache_base* cc = nullptr;
+      if(my->eosvmoc)
+         cc = &my->eosvmoc->cc;
+      else if(auto* oc_runtime = dynamic_cast<webassembly::eosvmoc::eosvmoc_runtime*>(my->runtime_interface.get()))
+         cc = &oc_runtime->cc;
+      if(cc) {
+         if(auto f = cc->function_at(cache_offset)) {
+            std::string name = "eosvmoc:" + f->code_hash.str();
+            if(f->function_index)
+               name += ":" + std::to_string(*f->function_index);
+            return name;
+         }
+      }
+#endif
+      return std::string();
+   }
+
    void wasm_interface::exit() {
       my->runtime_interface->immediately_exit_currently_running_module();
    }
@@ -113,8 +281,18 @@ class context_aware_api {
       context_aware_api(apply_context& ctx, bool context_free = false )
       :context(ctx)
       {
+         ++context.host_calls;
          if( context.is_context_free() )
             EOS_ASSERT( context_free, unaccessible_api, "only context free api's can be used in this context" );
+         if( context.cpu_breakdown() )
+            host_call_start = scoped_cpu_timer::clock::now();
+      }
+
+      // every intrinsic call constructs its api object for the duration of the call
+      ~context_aware_api() {
+         if( auto* breakdown = context.cpu_breakdown() )
+            breakdown->host_ns( host_category ) +=
+               std::chrono::duration_cast<std::chrono::nanoseconds>( scoped_cpu_timer::clock::now() - host_call_start ).count();
       }
 
       void checktime() {
@@ -122,8 +300,11 @@ class context_aware_api {
       }
 
    protected:
-      apply_context&             context;
+      apply_context&                        context;
+      action_cpu_breakdown::host_category   host_category = action_cpu_breakdown::host_category::other;
 
+   private:
+      scoped_cpu_timer::clock::time_point   host_call_start;
 };
 
 class context_free_api : public context_aware_api {
@@ -326,19 +507,19 @@ class softfloat_api : public context_aware_api {
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
       // float binops
       float _eosio_f32_add( float a, float b ) {
-         float32_t ret = ::f32_add( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_add( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_sub( float a, float b ) {
-         float32_t ret = ::f32_sub( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_sub( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_div( float a, float b ) {
-         float32_t ret = ::f32_div( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_div( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
       float _eosio_f32_mul( float a, float b ) {
-         float32_t ret = ::f32_mul( to_softfloat32(a), to_softfloat32(b) );
+         float32_t ret = hardware_float::f32_mul( to_softfloat32(a), to_softfloat32(b) );
          return *reinterpret_cast<float*>(&ret);
       }
 #pragma GCC diagnostic pop
@@ -392,7 +573,7 @@ class softfloat_api : public context_aware_api {
          return from_softfloat32(a);
       }
       float _eosio_f32_sqrt( float a ) {
-         float32_t ret = ::f32_sqrt( to_softfloat32(a) );
+         float32_t ret = hardware_float::f32_sqrt( to_softfloat32(a) );
          return from_softfloat32(ret);
       }
       // ceil, floor, trunc and nearest are lifted from libc
@@ -495,19 +676,19 @@ class softfloat_api : public context_aware_api {
 
       // double binops
       double _eosio_f64_add( double a, double b ) {
-         float64_t ret = ::f64_add( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_add( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_sub( double a, double b ) {
-         float64_t ret = ::f64_sub( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_sub( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_div( double a, double b ) {
-         float64_t ret = ::f64_div( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_div( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_mul( double a, double b ) {
-         float64_t ret = ::f64_mul( to_softfloat64(a), to_softfloat64(b) );
+         float64_t ret = hardware_float::f64_mul( to_softfloat64(a), to_softfloat64(b) );
          return from_softfloat64(ret);
       }
       double _eosio_f64_min( double af, double bf ) {
@@ -555,7 +736,7 @@ class softfloat_api : public context_aware_api {
          return from_softfloat64(a);
       }
       double _eosio_f64_sqrt( double a ) {
-         float64_t ret = ::f64_sqrt( to_softfloat64(a) );
+         float64_t ret = hardware_float::f64_sqrt( to_softfloat64(a) );
          return from_softfloat64(ret);
       }
       // ceil, floor, trunc and nearest are lifted from libc
@@ -796,7 +977,7 @@ class producer_api : public context_aware_api {
 class crypto_api : public context_aware_api {
    public:
       explicit crypto_api( apply_context& ctx )
-      :context_aware_api(ctx,true){}
+      :context_aware_api(ctx,true){ host_category = action_cpu_breakdown::host_category::crypto; }
       /**
        * This method can be optimized out during replay as it has
        * no possible side effects other than "passing".
@@ -913,7 +1094,8 @@ class crypto_api : public context_aware_api {
 
 class permission_api : public context_aware_api {
    public:
-      using context_aware_api::context_aware_api;
+      permission_api( apply_context& ctx )
+      :context_aware_api(ctx){ host_category = action_cpu_breakdown::host_category::auth; }
 
       bool check_transaction_authorization( array_ptr<char> trx_data,     uint32_t trx_size,
                                             array_ptr<char> pubkeys_data, uint32_t pubkeys_size,
@@ -1007,7 +1189,8 @@ class permission_api : public context_aware_api {
 
 class authorization_api : public context_aware_api {
    public:
-      using context_aware_api::context_aware_api;
+      authorization_api( apply_context& ctx )
+      :context_aware_api(ctx){ host_category = action_cpu_breakdown::host_category::auth; }
 
    void require_auth( account_name account ) {
       context.require_authorization( account );
@@ -1140,7 +1323,7 @@ class console_api : public context_aware_api {
    public:
       console_api( apply_context& ctx )
       : context_aware_api(ctx,true)
-      , ignore(!ctx.control.contracts_console()) {}
+      , ignore(!ctx.control.contracts_console()) { host_category = action_cpu_breakdown::host_category::console; }
 
       // Kept as intrinsic rather than implementing on WASM side (using prints_l and strlen) because strlen is faster on native side.
       void prints(null_terminated_ptr str) {
@@ -1399,7 +1582,8 @@ class console_api : public context_aware_api {
 
 class database_api : public context_aware_api {
    public:
-      using context_aware_api::context_aware_api;
+      database_api( apply_context& ctx )
+      :context_aware_api(ctx){ host_category = action_cpu_breakdown::host_category::db; }
 
       int db_store_i64( uint64_t scope, uint64_t table, uint64_t payer, uint64_t id, array_ptr<const char> buffer, uint32_t buffer_size ) {
          return context.db_store_i64( name(scope), name(table), account_name(payer), id, buffer, buffer_size );
@@ -1431,6 +1615,12 @@ class database_api : public context_aware_api {
       int db_end_i64( uint64_t code, uint64_t scope, uint64_t table ) {
          return context.db_end_i64( name(code), name(scope), name(table) );
       }
+      int db_get_i64_batch( int itr, uint32_t max_rows, array_ptr<char> buffer, uint32_t buffer_size, uint32_t& rows_read ) {
+         return context.db_get_i64_batch( itr, max_rows, buffer, buffer_size, rows_read );
+      }
+      int db_store_i64_batch( uint64_t scope, uint64_t table, uint64_t payer, array_ptr<const char> buffer, uint32_t buffer_size ) {
+         return context.db_store_i64_batch( name(scope), name(table), account_name(payer), buffer, buffer_size );
+      }
 
       DB_API_METHOD_WRAPPERS_SIMPLE_SECONDARY(idx64,  uint64_t)
       DB_API_METHOD_WRAPPERS_SIMPLE_SECONDARY(idx128, uint128_t)
@@ -1915,6 +2105,8 @@ REGISTER_INTRINSICS( database_api,
    (db_lowerbound_i64,   int(int64_t,int64_t,int64_t,int64_t)         )
    (db_upperbound_i64,   int(int64_t,int64_t,int64_t,int64_t)         )
    (db_end_i64,          int(int64_t,int64_t,int64_t)                 )
+   (db_get_i64_batch,    int(int,int,int,int,int)                     )
+   (db_store_i64_batch,  int(int64_t,int64_t,int64_t,int,int)         )
 
    DB_SECONDARY_INDEX_METHODS_SIMPLE(idx64)
    DB_SECONDARY_INDEX_METHODS_SIMPLE(idx128)
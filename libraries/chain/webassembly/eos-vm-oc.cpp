@@ -27,7 +27,7 @@ class eosvmoc_instantiated_module : public wasm_instantiated_module_interface {
          const code_descriptor* const cd = _eosvmoc_runtime.cc.get_descriptor_for_code_sync(_code_hash, _vm_version);
          EOS_ASSERT(cd, wasm_execution_error, "EOS VM OC instantiation failed");
 
-         _eosvmoc_runtime.exec.execute(*cd, _eosvmoc_runtime.mem, context);
+         _eosvmoc_runtime.exec.execute(*cd, context);
       }
 
       const digest_type              _code_hash;
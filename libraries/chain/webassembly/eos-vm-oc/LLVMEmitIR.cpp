@@ -694,6 +694,10 @@ namespace LLVMJIT
 				llvm::Value* ic = irBuilder.CreateLoad( emitLiteralPointer((void*)(OFFSET_OF_FIRST_INTRINSIC-moduleContext.importedFunctionOffsets[imm.functionIndex]*8), llvmI64Type->getPointerTo(256)) );
 				callee = irBuilder.CreateIntToPtr(ic, asLLVMType(calleeType)->getPointerTo());
 				isExit = module.functions.imports[imm.functionIndex].moduleName == "env" && module.functions.imports[imm.functionIndex].exportName == "eosio_exit";
+				if(module.functions.imports[imm.functionIndex].moduleName == "env" && tryEmitInlineMemoryIntrinsic(module.functions.imports[imm.functionIndex].exportName,callee))
+					return;
+				if(module.functions.imports[imm.functionIndex].moduleName == "env" && tryEmitInlineContextIntrinsic(module.functions.imports[imm.functionIndex].exportName,calleeType))
+					return;
 			}
 			else
 			{
@@ -904,6 +908,98 @@ namespace LLVMJIT
    #define LOAD_STORE_ALIGNMENT_PARAM llvm::MaybeAlign(1)
 #endif
 
+		// Calls to memcpy, memmove and memset with a small power of two constant length are emitted as a single load
+		// (or splatted value) and store through linear memory instead of an intrinsic call. An out of bounds access faults
+		// in the guard region just as the intrinsic's own bounds check does, and all bytes are loaded before any are stored
+		// so a faulting copy leaves memory untouched. A memcpy whose ranges alias is still handed to the intrinsic so it
+		// fails with the same error.
+		static constexpr U64 maxInlineMemoryIntrinsicBytes = 32;
+
+		bool tryEmitInlineMemoryIntrinsic(const std::string& exportName,llvm::Value* intrinsic)
+		{
+			const bool isMemcpy = exportName == "memcpy";
+			const bool isMemset = exportName == "memset";
+			if(!isMemcpy && !isMemset && exportName != "memmove")
+				return false;
+
+			auto length = llvm::dyn_cast<llvm::ConstantInt>(getTopValue());
+			if(!length)
+				return false;
+			const U64 numBytes = length->getZExtValue();
+			if(numBytes == 0 || numBytes > maxInlineMemoryIntrinsicBytes || (numBytes & (numBytes - 1)))
+				return false;
+
+			llvm::Value* args[3];
+			popMultiple(args,3);
+			llvm::Type* chunkType = llvm::Type::getIntNTy(context,numBytes*8);
+
+			if(isMemcpy)
+			{
+				auto dest = irBuilder.CreateZExt(args[0],llvmI64Type);
+				auto src = irBuilder.CreateZExt(args[1],llvmI64Type);
+				auto overlaps = irBuilder.CreateAnd(
+					irBuilder.CreateICmpULT(dest,irBuilder.CreateAdd(src,emitLiteral(numBytes))),
+					irBuilder.CreateICmpULT(src,irBuilder.CreateAdd(dest,emitLiteral(numBytes))));
+
+				auto overlapBlock = llvm::BasicBlock::Create(context,"memcpyOverlap",llvmFunction);
+				auto inlineBlock = llvm::BasicBlock::Create(context,"memcpyInline",llvmFunction);
+				irBuilder.CreateCondBr(overlaps,overlapBlock,inlineBlock,moduleContext.likelyFalseBranchWeights);
+
+				irBuilder.SetInsertPoint(overlapBlock);
+				irBuilder.CreateCall(intrinsic,llvm::ArrayRef<llvm::Value*>(args,3));
+				irBuilder.CreateUnreachable();
+
+				irBuilder.SetInsertPoint(inlineBlock);
+			}
+
+			llvm::Value* value;
+			if(isMemset)
+				value = irBuilder.CreateBitCast(irBuilder.CreateVectorSplat(numBytes,irBuilder.CreateTrunc(args[1],llvmI8Type)),chunkType);
+			else
+			{
+				auto load = irBuilder.CreateLoad(coerceByteIndexToPointer(args[1],0,chunkType));
+				load->setAlignment(LOAD_STORE_ALIGNMENT_PARAM);
+				load->setVolatile(true);
+				value = load;
+			}
+			auto store = irBuilder.CreateStore(value,coerceByteIndexToPointer(args[0],0,chunkType));
+			store->setVolatile(true);
+			store->setAlignment(LOAD_STORE_ALIGNMENT_PARAM);
+
+			// all three intrinsics return the destination
+			push(args[0]);
+			return true;
+		}
+
+		// current_receiver and action_data_size only return a value of the running action, which the executor places in
+		// the control block before apply is called, so they are emitted as a load from it instead of an intrinsic call.
+		bool tryEmitInlineContextIntrinsic(const std::string& exportName,const FunctionType* calleeType)
+		{
+			int offset;
+			llvm::Type* valueType;
+			ResultType resultType;
+			if(exportName == "current_receiver")
+			{
+				offset = OFFSET_OF_CONTROL_BLOCK_MEMBER(current_receiver);
+				valueType = llvmI64Type;
+				resultType = ResultType::i64;
+			}
+			else if(exportName == "action_data_size")
+			{
+				offset = OFFSET_OF_CONTROL_BLOCK_MEMBER(action_data_size);
+				valueType = llvmI32Type;
+				resultType = ResultType::i32;
+			}
+			else
+				return false;
+			if(calleeType->ret != resultType || calleeType->parameters.size())
+				return false;
+
+			auto bytePointer = CreateInBoundsGEPWAR(irBuilder, moduleContext.defaultMemoryBase, emitLiteral((I32)offset));
+			push(irBuilder.CreateLoad(irBuilder.CreatePointerCast(bytePointer,valueType->getPointerTo(256))));
+			return true;
+		}
+
 		EMIT_LOAD_OP(i32,load8_s,llvmI8Type,0,irBuilder.CreateSExt,LOAD_STORE_ALIGNMENT_PARAM)  EMIT_LOAD_OP(i32,load8_u,llvmI8Type,0,irBuilder.CreateZExt,LOAD_STORE_ALIGNMENT_PARAM)
 		EMIT_LOAD_OP(i32,load16_s,llvmI16Type,1,irBuilder.CreateSExt,LOAD_STORE_ALIGNMENT_PARAM) EMIT_LOAD_OP(i32,load16_u,llvmI16Type,1,irBuilder.CreateZExt,LOAD_STORE_ALIGNMENT_PARAM)
 		EMIT_LOAD_OP(i64,load8_s,llvmI8Type,0,irBuilder.CreateSExt,LOAD_STORE_ALIGNMENT_PARAM)  EMIT_LOAD_OP(i64,load8_u,llvmI8Type,0,irBuilder.CreateZExt,LOAD_STORE_ALIGNMENT_PARAM)
@@ -46,6 +46,7 @@ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
 #include "llvm/Transforms/Scalar.h"
 #include "llvm/IR/DIBuilder.h"
 #include "llvm/Transforms/InstCombine/InstCombine.h"
+#include "llvm/Transforms/IPO.h"
 #include "llvm/Transforms/Utils.h"
 #include <memory>
 
@@ -68,6 +69,10 @@ namespace llvm { namespace orc {
 #define DUMP_OPTIMIZED_MODULE 0
 #define PRINT_DISASSEMBLY 0
 
+// Functions whose cost is under this are inlined into their callers. Every function, inlined or not, keeps the
+// volatile depth counter updates of its prologue and epilogue, so the call depth a contract observes is unchanged.
+#define INLINE_THRESHOLD 50
+
 #if PRINT_DISASSEMBLY
 #include "llvm-c/Disassembler.h"
 static void disassembleFunction(U8* bytes,Uptr numBytes)
@@ -251,10 +256,26 @@ namespace LLVMJIT
 		fpm->add(llvm::createCFGSimplificationPass());
 		fpm->add(llvm::createJumpThreadingPass());
 		fpm->add(llvm::createConstantPropagationPass());
+		// Linear memory accesses are volatile and stay in place, but the zero extension and offset addition of an
+		// address that does not change in a loop are hoisted out of it
+		fpm->add(llvm::createEarlyCSEPass());
+		fpm->add(llvm::createLICMPass());
+		fpm->add(llvm::createInstructionCombiningPass());
+		fpm->add(llvm::createCFGSimplificationPass());
 		fpm->doInitialization();
 
 		for(auto functionIt = llvmModule->begin();functionIt != llvmModule->end();++functionIt)
 		{ fpm->run(*functionIt); }
+
+		// Inline small functions once their own code has been simplified, then clean up the callers. Every function
+		// has external linkage so each one is still emitted, with the stack size the checks below look for.
+		llvm::legacy::PassManager mpm;
+		mpm.add(llvm::createFunctionInliningPass(INLINE_THRESHOLD));
+		mpm.run(*llvmModule);
+
+		for(auto functionIt = llvmModule->begin();functionIt != llvmModule->end();++functionIt)
+		{ fpm->run(*functionIt); }
+		fpm->doFinalization();
 		delete fpm;
 
 		if(DUMP_OPTIMIZED_MODULE) { printModule(llvmModule,"llvmOptimizedDump"); }
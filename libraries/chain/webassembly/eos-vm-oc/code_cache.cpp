@@ -9,9 +9,14 @@
 #include <eosio/chain/webassembly/eos-vm-oc/compile_monitor.hpp>
 #include <eosio/chain/exceptions.hpp>
 
+#include <algorithm>
+#include <fstream>
+
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
+#include <sys/file.h>
+#include <sys/stat.h>
 #include <linux/memfd.h>
 
 #include "IR/Module.h"
@@ -27,7 +32,7 @@ namespace eosio { namespace chain { namespace eosvmoc {
 static constexpr size_t header_offset = 512u;
 static constexpr size_t header_size = 512u;
 static constexpr size_t total_header_size = header_offset + header_size;
-static constexpr uint64_t header_id = 0x32434f4d56534f45ULL; //"EOSVMOC2" little endian
+static constexpr uint64_t header_id = 0x33434f4d56534f45ULL; //"EOSVMOC3" little endian
 
 struct code_cache_header {
    uint64_t id = header_id;
@@ -39,25 +44,186 @@ static constexpr size_t descriptor_ptr_from_file_start = header_offset + offseto
 
 static_assert(sizeof(code_cache_header) <= header_size, "code_cache_header too big");
 
+//in the unused part of the header, aligned for atomic access from every process that maps the cache
+static constexpr size_t eviction_generation_offset_from_file_start = header_offset + 256u;
+//number of evictions announced and not yet done
+static constexpr size_t evictions_pending_offset_from_file_start = header_offset + 264u;
+static_assert(sizeof(code_cache_header) <= 256u, "code_cache_header overlaps the eviction generation");
+
+//followed by the st_dev and st_ino of the cache file the index is for
+static constexpr uint64_t shared_index_file_id = 0x32584449434f4d56ULL; //"VMOCIDX2" little endian
+
+static constexpr uint64_t usage_file_id = 0x31475355434f4d56ULL; //"VMOCUSG1" little endian
+//codes counted in memory for each contract warmed up, more are forgotten as the counts decay
+static constexpr size_t usage_entries_per_warmup_contract = 16u;
+
 code_cache_async::code_cache_async(const bfs::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db) :
    code_cache_base(data_dir, eosvmoc_config, db),
    _result_queue(eosvmoc_config.threads * 2),
-   _threads(eosvmoc_config.threads)
+   _threads(eosvmoc_config.threads),
+   _usage_file_path(data_dir/"code_cache_usage.bin"),
+   _warmup_contracts(eosvmoc_config.warmup_contracts),
+   _usage_counts(eosvmoc_config.warmup_contracts * usage_entries_per_warmup_contract)
 {
    FC_ASSERT(_threads, "EOS VM OC requires at least 1 compile thread");
 
+   if(_follower)
+      return;
+
+   if(_warmup_contracts)
+      load_usage_counts();
+
    wait_on_compile_monitor_message();
 
    _monitor_reply_thread = std::thread([this]() {
       fc::set_os_thread_name("oc-monitor");
       _ctx.run();
+      notify_result();
    });
 }
 
 code_cache_async::~code_cache_async() {
+   if(_follower)
+      return;
    _compile_monitor_write_socket.shutdown(local::datagram_protocol::socket::shutdown_send);
    _monitor_reply_thread.join();
    consume_compile_thread_queue();
+   if(_warmup_contracts)
+      save_usage_counts();
+}
+
+void code_cache_async::load_usage_counts() {
+   if(!bfs::exists(_usage_file_path))
+      return;
+   try {
+      std::ifstream ifs(_usage_file_path.generic_string(), std::ifstream::binary);
+      std::string contents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+      fc::datastream<const char*> ds(contents.data(), contents.size());
+      uint64_t id;
+      fc::raw::unpack(ds, id);
+      if(id != usage_file_id) {
+         wlog("ignoring incompatible EOS VM OC usage statistics in ${f}", ("f", _usage_file_path.generic_string()));
+         return;
+      }
+      unsigned number_entries;
+      fc::raw::unpack(ds, number_entries);
+      for(unsigned i = 0; i < number_entries; ++i) {
+         code_tuple ct;
+         uint64_t count;
+         fc::raw::unpack(ds, ct.code_id);
+         fc::raw::unpack(ds, ct.vm_version);
+         fc::raw::unpack(ds, count);
+         _usage_counts.add(ct, count);
+      }
+      //counts carried over from previous runs are halved so stale contracts age out
+      _usage_counts.decay();
+   }
+   catch(const fc::exception& e) {
+      wlog("failed to read EOS VM OC usage statistics: ${e}", ("e", e.to_detail_string()));
+      _usage_counts.clear();
+   }
+}
+
+void code_cache_async::save_usage_counts() {
+   //keep a few times more entries than are warmed up so contracts that are replaced can be backfilled next time
+   const auto entries = _usage_counts.hottest(_warmup_contracts * 4);
+
+   try {
+      const unsigned number_entries = entries.size();
+      auto serialize_entries = [&](auto& ds) {
+         fc::raw::pack(ds, usage_file_id);
+         fc::raw::pack(ds, number_entries);
+         for(const auto& [ct, count] : entries) {
+            fc::raw::pack(ds, ct.code_id);
+            fc::raw::pack(ds, ct.vm_version);
+            fc::raw::pack(ds, count);
+         }
+      };
+
+      fc::datastream<size_t> dssz;
+      serialize_entries(dssz);
+      std::vector<char> buff(dssz.tellp());
+      fc::datastream<char*> ds(buff.data(), buff.size());
+      serialize_entries(ds);
+
+      std::ofstream ofs(_usage_file_path.generic_string(), std::ofstream::binary | std::ofstream::trunc);
+      ofs.write(buff.data(), buff.size());
+      if(!ofs.good())
+         elog("failed to write EOS VM OC usage statistics to ${f}", ("f", _usage_file_path.generic_string()));
+   }
+   catch(const fc::exception& e) {
+      elog("failed to write EOS VM OC usage statistics: ${e}", ("e", e.to_detail_string()));
+   }
+}
+
+void code_cache_async::warm_up() {
+   if(_follower || !_warmup_contracts || _usage_counts.empty())
+      return;
+
+   const auto hottest = _usage_counts.hottest(_usage_counts.size());
+   std::vector<code_tuple> codes;
+   codes.reserve(hottest.size());
+   for(const auto& [ct, count] : hottest)
+      codes.emplace_back(ct);
+
+   const fc::time_point start = fc::time_point::now();
+   const auto [hot, compiling] = compile_blocking(codes, _warmup_contracts);
+   ilog("EOS VM Optimized Compiler warm-up compiled ${c} of the ${h} most used contracts in ${t} ms",
+        ("c", compiling)("h", hot)("t", (fc::time_point::now() - start).count() / 1000));
+}
+
+std::tuple<size_t, size_t> code_cache_async::compile_blocking(const std::vector<code_tuple>& codes, size_t max_codes) {
+   if(_follower)
+      return {0, 0};
+
+   //waits for at least one outstanding compile to finish; false if the compile monitor went away
+   auto wait_for_results = [&]() {
+      while(true) {
+         auto [count_processed, bytes_remaining] = consume_compile_thread_queue();
+         if(count_processed) {
+            check_eviction_threshold(bytes_remaining);
+            return true;
+         }
+         std::unique_lock<std::mutex> g(_result_mtx);
+         _result_cv.wait(g, [&]() { return _result_queue.read_available() || _ctx.stopped(); });
+         if(!_result_queue.read_available())
+            return false;
+      }
+   };
+
+   size_t cached = 0, compiling = 0;
+   for(const code_tuple& ct : codes) {
+      if(cached == max_codes)
+         break;
+      if(_blacklist.count(ct))
+         continue;
+      if(_cache_index.get<by_hash>().count(boost::make_tuple(ct.code_id, ct.vm_version))) {
+         ++cached;
+         continue;
+      }
+      //code may have been replaced since it was listed
+      const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(ct.code_id, 0, ct.vm_version));
+      if(!codeobject)
+         continue;
+
+      while(_outstanding_compiles_and_poison.size() >= _threads)
+         if(!wait_for_results())
+            return {cached, compiling};
+
+      _outstanding_compiles_and_poison.emplace(ct, false);
+      _compile_requested.emplace(ct, fc::time_point::now());
+      std::vector<wrapped_fd> fds_to_pass;
+      codeobject->with_code([&](std::string_view wasm) { fds_to_pass.emplace_back(memfd_for_bytearray(wasm)); });
+      FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+      ++cached;
+      ++compiling;
+   }
+
+   while(_outstanding_compiles_and_poison.size())
+      if(!wait_for_results())
+         break;
+
+   return {cached, compiling};
 }
 
 //remember again: wait_on_compile_monitor_message's callback is non-main thread!
@@ -74,21 +240,37 @@ void code_cache_async::wait_on_compile_monitor_message() {
          return;
       }
 
-      _result_queue.push(message.get<wasm_compilation_result_message>());
+      compile_result result{message.get<wasm_compilation_result_message>()};
+      if(fds.size() == 1)
+         result.functions = fc::raw::unpack<std::vector<compiled_function>>(vector_for_memfd(fds[0]));
+      _result_queue.push(std::move(result));
+      notify_result();
 
       wait_on_compile_monitor_message();
    });
 }
 
+void code_cache_async::notify_result() {
+   //taking the lock orders the notify after a waiter's check of the queue, so the wakeup is not lost
+   { std::lock_guard<std::mutex> g(_result_mtx); }
+   _result_cv.notify_all();
+}
+
 
 //number processed, bytes available (only if number processed > 0)
 std::tuple<size_t, size_t> code_cache_async::consume_compile_thread_queue() {
    size_t bytes_remaining = 0;
-   size_t gotsome = _result_queue.consume_all([&](const wasm_compilation_result_message& result) {
+   bool added = false;
+   size_t gotsome = _result_queue.consume_all([&](const compile_result& queued) {
+      const wasm_compilation_result_message& result = queued.message;
       if(_outstanding_compiles_and_poison[result.code] == false) {
          result.result.visit(overloaded {
             [&](const code_descriptor& cd) {
                _cache_index.push_front(cd);
+               added = true;
+               add_function_table(result.code, queued.functions);
+               if(auto it = _compile_requested.find(result.code); it != _compile_requested.end())
+                  _compile_latencies[result.code] = fc::time_point::now() - it->second;
             },
             [&](const compilation_result_unknownfailure&) {
                wlog("code ${c} failed to tier-up with EOS VM OC", ("c", result.code.code_id));
@@ -100,13 +282,24 @@ std::tuple<size_t, size_t> code_cache_async::consume_compile_thread_queue() {
          });
       }
       _outstanding_compiles_and_poison.erase(result.code);
+      //a too full result leaves the code to be requested again, keep timing from the original request
+      if(!result.result.contains<compilation_result_toofull>())
+         _compile_requested.erase(result.code);
       bytes_remaining = result.cache_free_bytes;
    });
+   if(added)
+      publish_index();
 
    return {gotsome, bytes_remaining};
 }
 
 const code_descriptor* const code_cache_async::get_descriptor_for_code(const digest_type& code_id, const uint8_t& vm_version) {
+   if(_follower)
+      return get_shared_descriptor(code_id, vm_version);
+
+   if(_warmup_contracts)
+      _usage_counts.add(code_tuple{code_id, vm_version});
+
    //if there are any outstanding compiles, process the result queue now
    if(_outstanding_compiles_and_poison.size()) {
       auto [count_processed, bytes_remaining] = consume_compile_thread_queue();
@@ -115,16 +308,19 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
          check_eviction_threshold(bytes_remaining);
 
       while(count_processed && _queued_compiles.size()) {
-         auto nextup = _queued_compiles.begin();
+         //the hottest waiting code goes first so a flood of rarely used contracts can't hold back one that matters
+         auto nextup = std::max_element(_queued_compiles.begin(), _queued_compiles.end(), [](const auto& a, const auto& b) {
+            return a.second < b.second;
+         });
 
          //it's not clear this check is required: if apply() was called for code then it existed in the code_index; and then
          // if we got notification of it no longer existing we would have removed it from queued_compiles
-         const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(nextup->code_id, 0, nextup->vm_version));
+         const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(nextup->first.code_id, 0, nextup->first.vm_version));
          if(codeobject) {
-            _outstanding_compiles_and_poison.emplace(*nextup, false);
+            _outstanding_compiles_and_poison.emplace(nextup->first, false);
             std::vector<wrapped_fd> fds_to_pass;
-            fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
-            FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ *nextup }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
+            codeobject->with_code([&](std::string_view wasm) { fds_to_pass.emplace_back(memfd_for_bytearray(wasm)); });
+            FC_ASSERT(write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ nextup->first }, fds_to_pass), "EOS VM failed to communicate to OOP manager");
             --count_processed;
          }
          _queued_compiles.erase(nextup);
@@ -134,9 +330,11 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
    //check for entry in cache
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
    if(it != _cache_index.get<by_hash>().end()) {
+      ++_stats.hits;
       _cache_index.relocate(_cache_index.begin(), _cache_index.project<0>(it));
       return &*it;
    }
+   ++_stats.misses;
 
    const code_tuple ct = code_tuple{code_id, vm_version};
 
@@ -146,11 +344,14 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
       it->second = false;
       return nullptr;
    }
-   if(_queued_compiles.find(ct) != _queued_compiles.end())
+   if(auto it = _queued_compiles.find(ct); it != _queued_compiles.end()) {
+      ++it->second;
       return nullptr;
+   }
 
+   _compile_requested.emplace(ct, fc::time_point::now());
    if(_outstanding_compiles_and_poison.size() >= _threads) {
-      _queued_compiles.emplace(ct);
+      _queued_compiles.emplace(ct, 1u);
       return nullptr;
    }
 
@@ -160,11 +361,16 @@ const code_descriptor* const code_cache_async::get_descriptor_for_code(const dig
 
    _outstanding_compiles_and_poison.emplace(ct, false);
    std::vector<wrapped_fd> fds_to_pass;
-   fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
+   codeobject->with_code([&](std::string_view wasm) { fds_to_pass.emplace_back(memfd_for_bytearray(wasm)); });
    write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ ct }, fds_to_pass);
    return nullptr;
 }
 
+void code_cache_async::record_baseline_execution(const digest_type& code_id, const uint8_t& vm_version, const fc::microseconds& elapsed) {
+   if(auto it = _queued_compiles.find(code_tuple{code_id, vm_version}); it != _queued_compiles.end())
+      it->second += std::max<int64_t>(elapsed.count(), 0);
+}
+
 code_cache_sync::~code_cache_sync() {
    //it's exceedingly critical that we wait for the compile monitor to be done with all its work
    //This is easy in the sync case
@@ -178,16 +384,19 @@ const code_descriptor* const code_cache_sync::get_descriptor_for_code_sync(const
    //check for entry in cache
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
    if(it != _cache_index.get<by_hash>().end()) {
+      ++_stats.hits;
       _cache_index.relocate(_cache_index.begin(), _cache_index.project<0>(it));
       return &*it;
    }
+   ++_stats.misses;
 
    const code_object* const codeobject = _db.find<code_object,by_code_hash>(boost::make_tuple(code_id, 0, vm_version));
    if(!codeobject) //should be impossible right?
       return nullptr;
 
+   const fc::time_point compile_start = fc::time_point::now();
    std::vector<wrapped_fd> fds_to_pass;
-   fds_to_pass.emplace_back(memfd_for_bytearray(codeobject->code));
+   codeobject->with_code([&](std::string_view wasm) { fds_to_pass.emplace_back(memfd_for_bytearray(wasm)); });
 
    write_message_with_fds(_compile_monitor_write_socket, compile_wasm_message{ {code_id, vm_version} }, fds_to_pass);
    auto [success, message, fds] = read_message_with_fds(_compile_monitor_read_socket);
@@ -196,10 +405,15 @@ const code_descriptor* const code_cache_sync::get_descriptor_for_code_sync(const
 
    wasm_compilation_result_message result = message.get<wasm_compilation_result_message>();
    EOS_ASSERT(result.result.contains<code_descriptor>(), wasm_execution_error, "failed to compile wasm");
+   _compile_latencies[code_tuple{code_id, vm_version}] = fc::time_point::now() - compile_start;
+   if(fds.size() == 1)
+      add_function_table(code_tuple{code_id, vm_version}, fc::raw::unpack<std::vector<compiled_function>>(vector_for_memfd(fds[0])));
 
    check_eviction_threshold(result.cache_free_bytes);
 
-   return &*_cache_index.push_front(std::move(result.result.get<code_descriptor>())).first;
+   const code_descriptor* cd = &*_cache_index.push_front(std::move(result.result.get<code_descriptor>())).first;
+   publish_index();
+   return cd;
 }
 
 code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const eosvmoc::config& eosvmoc_config, const chainbase::database& db) :
@@ -208,6 +422,13 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
 {
    static_assert(sizeof(allocator_t) <= header_offset, "header offset intersects with allocator");
 
+   if(!eosvmoc_config.shared_cache_dir.empty()) {
+      attach_to_shared_cache(eosvmoc_config.shared_cache_dir);
+      return;
+   }
+   _share = eosvmoc_config.share_cache;
+   _shared_index_path = data_dir/"code_cache_index.bin";
+
    bfs::create_directories(data_dir);
 
    if(!bfs::exists(_cache_file_path)) {
@@ -255,6 +476,12 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
 
    allocator_t* allocator = reinterpret_cast<allocator_t*>(code_mapping);
 
+   //followers of the previous run may still be running code from this cache
+   if(_share) {
+      begin_eviction(code_mapping);
+      flock(_cache_fd, LOCK_EX);
+   }
+
    if(cache_header.serialized_descriptor_index) {
       fc::datastream<const char*> ds(code_mapping + cache_header.serialized_descriptor_index, eosvmoc_config.cache_size - cache_header.serialized_descriptor_index);
       unsigned number_entries;
@@ -273,6 +500,11 @@ code_cache_base::code_cache_base(const boost::filesystem::path data_dir, const e
 
       ilog("EOS VM Optimized Compiler code cache loaded with ${c} entries; ${f} of ${t} bytes free", ("c", number_entries)("f", allocator->get_free_memory())("t", allocator->get_size()));
    }
+   if(_share) {
+      publish_index();
+      end_eviction(code_mapping);
+      flock(_cache_fd, LOCK_UN);
+   }
    munmap(code_mapping, eosvmoc_config.cache_size);
 
    _free_bytes_eviction_threshold = eosvmoc_config.cache_size * .1;
@@ -304,6 +536,12 @@ void code_cache_base::serialize_cache_index(fc::datastream<T>& ds) {
 }
 
 code_cache_base::~code_cache_base() {
+   if(_follower) {
+      munmap((void*)_follower_header, total_header_size);
+      close(_cache_fd);
+      return;
+   }
+
    //reopen the code cache in our process
    struct stat st;
    if(fstat(_cache_fd, &st))
@@ -314,6 +552,12 @@ code_cache_base::~code_cache_base() {
 
    allocator_t* allocator = reinterpret_cast<allocator_t*>(code_mapping);
 
+   if(_share) {
+      begin_eviction(code_mapping);
+      flock(_cache_fd, LOCK_EX);
+   }
+   bool evicted = false;
+
    //serialize out the cache index
    fc::datastream<size_t> dssz;
    serialize_cache_index(dssz);
@@ -330,8 +574,13 @@ code_cache_base::~code_cache_base() {
          allocator->deallocate(code_mapping + _cache_index.back().code_begin);
          allocator->deallocate(code_mapping + _cache_index.back().initdata_begin);
          _cache_index.pop_back();
+         evicted = true;
       }
    }
+   if(_share && evicted)
+      publish_index();
+   if(_share)
+      end_eviction(code_mapping);
 
    if(p) {
       fc::datastream<char*> ds(p, sz);
@@ -345,20 +594,58 @@ code_cache_base::~code_cache_base() {
 
    msync(code_mapping, allocator->get_size(), MS_SYNC);
    munmap(code_mapping, allocator->get_size());
+   if(_share)
+      flock(_cache_fd, LOCK_UN);
    close(_cache_fd);
    set_on_disk_region_dirty(false);
 
 }
 
+void code_cache_base::add_function_table(const code_tuple& code, std::vector<compiled_function> functions) {
+   if(functions.empty())
+      return;
+   std::vector<compiled_function>& table = _function_tables[code] = std::move(functions);
+   std::sort(table.begin(), table.end(), [](const auto& a, const auto& b) { return a.offset < b.offset; });
+}
+
+fc::optional<code_cache_base::code_function> code_cache_base::function_at(size_t cache_offset) const {
+   const code_descriptor* containing = nullptr;
+   for(const code_descriptor& cd : _cache_index) {
+      if(cd.code_begin <= cache_offset && (!containing || cd.code_begin > containing->code_begin))
+         containing = &cd;
+   }
+   if(!containing)
+      return fc::optional<code_function>();
+
+   code_function ret{containing->code_hash, containing->vm_version};
+   const auto table = _function_tables.find(code_tuple{containing->code_hash, containing->vm_version});
+   if(table != _function_tables.end() && table->second.size()) {
+      const size_t offset = cache_offset - containing->code_begin;
+      auto next = std::upper_bound(table->second.begin(), table->second.end(), offset, [](size_t o, const compiled_function& f) {
+         return o < f.offset;
+      });
+      if(next != table->second.begin())
+         ret.function_index = std::prev(next)->index;
+   }
+   return ret;
+}
+
 void code_cache_base::free_code(const digest_type& code_id, const uint8_t& vm_version) {
    code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
    if(it != _cache_index.get<by_hash>().end()) {
-      write_message_with_fds(_compile_monitor_write_socket, evict_wasms_message{ {*it} });
+      evict_wasms_message evict_msg{ {*it} };
       _cache_index.get<by_hash>().erase(it);
+      if(!_follower) {
+         publish_index();
+         write_message_with_fds(_compile_monitor_write_socket, evict_msg);
+      }
    }
 
    //if it's in the queued list, erase it
    _queued_compiles.erase({code_id, vm_version});
+   _compile_requested.erase({code_id, vm_version});
+   _compile_latencies.erase({code_id, vm_version});
+   _function_tables.erase({code_id, vm_version});
 
    //however, if it's currently being compiled there is no way to cancel the compile,
    //so instead set a poison boolean that indicates not to insert the code in to the cache
@@ -372,8 +659,11 @@ void code_cache_base::run_eviction_round() {
    evict_wasms_message evict_msg;
    for(unsigned int i = 0; i < 25 && _cache_index.size() > 1; ++i) {
       evict_msg.codes.emplace_back(_cache_index.back());
+      _function_tables.erase(code_tuple{_cache_index.back().code_hash, _cache_index.back().vm_version});
       _cache_index.pop_back();
    }
+   _stats.evictions += evict_msg.codes.size();
+   publish_index();
    write_message_with_fds(_compile_monitor_write_socket, evict_msg);
 }
 
@@ -382,4 +672,220 @@ void code_cache_base::check_eviction_threshold(size_t free_bytes) {
       run_eviction_round();
 }
 
+void code_cache_base::begin_eviction(char* cache_mapping) {
+   __atomic_add_fetch((uint64_t*)(cache_mapping + evictions_pending_offset_from_file_start), 1u, __ATOMIC_SEQ_CST);
+}
+
+void code_cache_base::end_eviction(char* cache_mapping) {
+   __atomic_add_fetch((uint64_t*)(cache_mapping + eviction_generation_offset_from_file_start), 1u, __ATOMIC_RELEASE);
+   __atomic_sub_fetch((uint64_t*)(cache_mapping + evictions_pending_offset_from_file_start), 1u, __ATOMIC_RELEASE);
+}
+
+code_cache_base::execution_lock& code_cache_base::execution_lock::operator=(execution_lock&& o) {
+   std::swap(_cc, o._cc);
+   return *this;
+}
+
+code_cache_base::execution_lock::~execution_lock() {
+   if(!_cc)
+      return;
+   _cc->_follower_locked = false;
+   flock(_cc->_cache_fd, LOCK_UN);
+}
+
+code_cache_base::execution_lock code_cache_base::lock_for_execution() {
+   if(!_follower)
+      return execution_lock();
+   //shared locks taken one after another by several followers could keep the owner's exclusive lock waiting for ever
+   if(__atomic_load_n((const uint64_t*)(_follower_header + evictions_pending_offset_from_file_start), __ATOMIC_ACQUIRE))
+      return execution_lock();
+   if(flock(_cache_fd, LOCK_SH | LOCK_NB))
+      return execution_lock();
+   return execution_lock(*this);
+}
+
+void code_cache_base::publish_index() {
+   if(!_share)
+      return;
+
+   //written aside and renamed in to place so a follower never reads a partial index
+   const bfs::path tmp_path = _shared_index_path.generic_string() + ".tmp";
+   std::string error;
+   try {
+      //a follower must not apply the index to another file that was at the same path before
+      struct stat st;
+      EOS_ASSERT(fstat(_cache_fd, &st) == 0, database_exception, "failed to stat the code cache");
+      const uint64_t dev = st.st_dev, ino = st.st_ino;
+
+      fc::datastream<size_t> dssz;
+      fc::raw::pack(dssz, shared_index_file_id);
+      fc::raw::pack(dssz, dev);
+      fc::raw::pack(dssz, ino);
+      serialize_cache_index(dssz);
+      std::vector<char> buff(dssz.tellp());
+      fc::datastream<char*> ds(buff.data(), buff.size());
+      fc::raw::pack(ds, shared_index_file_id);
+      fc::raw::pack(ds, dev);
+      fc::raw::pack(ds, ino);
+      serialize_cache_index(ds);
+
+      {
+         std::ofstream ofs(tmp_path.generic_string(), std::ofstream::binary | std::ofstream::trunc);
+         ofs.write(buff.data(), buff.size());
+         ofs.close();
+         EOS_ASSERT(ofs.good(), database_exception, "failed to write ${f}", ("f", tmp_path.generic_string()));
+      }
+      bfs::rename(tmp_path, _shared_index_path);
+      return;
+   }
+   catch(const fc::exception& e) {
+      error = e.to_detail_string();
+   }
+   catch(const std::exception& e) {
+      error = e.what();
+   }
+   //an out of date index could list code about to be evicted; without one, followers run nothing from the cache
+   elog("failed to publish the EOS VM OC code cache index, followers stop using the cache: ${e}", ("e", error));
+   boost::system::error_code ec;
+   bfs::remove(_shared_index_path, ec);
+}
+
+void code_cache_base::attach_to_shared_cache(const bfs::path& dir) {
+   _follower = true;
+   _cache_file_path = dir/"code_cache.bin";
+   _shared_index_path = dir/"code_cache_index.bin";
+
+   _cache_fd = ::open(_cache_file_path.generic_string().c_str(), O_RDONLY | O_CLOEXEC);
+   EOS_ASSERT(_cache_fd >= 0, database_exception, "failure to open shared EOS VM OC code cache ${f}", ("f", _cache_file_path.generic_string()));
+
+   struct stat st;
+   EOS_ASSERT(fstat(_cache_fd, &st) == 0 && (size_t)st.st_size >= total_header_size, database_exception,
+              "shared EOS VM OC code cache ${f} is not valid", ("f", _cache_file_path.generic_string()));
+   _follower_dev = st.st_dev;
+   _follower_ino = st.st_ino;
+   _follower_mapping_size = st.st_size;
+
+   void* header = mmap(nullptr, total_header_size, PROT_READ, MAP_SHARED, _cache_fd, 0);
+   EOS_ASSERT(header != MAP_FAILED, database_exception, "failure to mmap shared EOS VM OC code cache");
+   _follower_header = (const char*)header;
+
+   code_cache_header cache_header;
+   memcpy((char*)&cache_header, _follower_header + header_offset, sizeof(cache_header));
+   EOS_ASSERT(cache_header.id == header_id, bad_database_version_exception, "shared EOS VM OC code cache not compatible with this version");
+
+   {
+      execution_lock l = lock_for_execution();
+      load_shared_index();
+   }
+   ilog("running code from the shared EOS VM Optimized Compiler code cache in ${d}, ${c} entries", ("d", dir.generic_string())("c", _cache_index.size()));
+}
+
+bool code_cache_base::reattach_to_shared_cache(uint64_t dev, uint64_t ino) {
+   const int fd = ::open(_cache_file_path.generic_string().c_str(), O_RDONLY | O_CLOEXEC);
+   if(fd < 0)
+      return false;
+   struct stat st;
+   void* header = MAP_FAILED;
+   if(fstat(fd, &st) == 0 && (uint64_t)st.st_dev == dev && (uint64_t)st.st_ino == ino && (size_t)st.st_size >= total_header_size)
+      header = mmap(nullptr, total_header_size, PROT_READ, MAP_SHARED, fd, 0);
+   bool usable = header != MAP_FAILED;
+   if(usable) {
+      code_cache_header cache_header;
+      memcpy((char*)&cache_header, (const char*)header + header_offset, sizeof(cache_header));
+      usable = cache_header.id == header_id;
+   }
+   //the lock held on the previous file moves to this one; closing the previous file releases it there
+   if(usable && _follower_locked)
+      usable = flock(fd, LOCK_SH | LOCK_NB) == 0;
+   if(!usable) {
+      if(header != MAP_FAILED)
+         munmap(header, total_header_size);
+      close(fd);
+      return false;
+   }
+
+   munmap((void*)_follower_header, total_header_size);
+   close(_cache_fd);
+   _cache_fd = fd;
+   _follower_header = (const char*)header;
+   _follower_dev = dev;
+   _follower_ino = ino;
+   _follower_mapping_size = st.st_size;
+   _follower_generation = __atomic_load_n((const uint64_t*)(_follower_header + eviction_generation_offset_from_file_start), __ATOMIC_ACQUIRE);
+   ++_mapping_instance;
+   ilog("re-attached to the recreated shared EOS VM Optimized Compiler code cache ${f}", ("f", _cache_file_path.generic_string()));
+   return true;
+}
+
+void code_cache_base::load_shared_index() {
+   _follower_generation = __atomic_load_n((const uint64_t*)(_follower_header + eviction_generation_offset_from_file_start), __ATOMIC_ACQUIRE);
+   _follower_last_check = fc::time_point::now();
+   _cache_index.clear();
+
+   struct stat st;
+   if(stat(_shared_index_path.generic_string().c_str(), &st)) {
+      _follower_index_mtime = 0;
+      return;
+   }
+   _follower_index_mtime = st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+
+   try {
+      std::ifstream ifs(_shared_index_path.generic_string(), std::ifstream::binary);
+      std::string contents((std::istreambuf_iterator<char>(ifs)), std::istreambuf_iterator<char>());
+      fc::datastream<const char*> ds(contents.data(), contents.size());
+      uint64_t id, dev, ino;
+      fc::raw::unpack(ds, id);
+      if(id != shared_index_file_id)
+         return;
+      fc::raw::unpack(ds, dev);
+      fc::raw::unpack(ds, ino);
+      //the owner recreated the cache file, the index is for the new one
+      if((dev != _follower_dev || ino != _follower_ino) && !reattach_to_shared_cache(dev, ino)) {
+         _follower_index_mtime = 0; //tried again on a later miss
+         return;
+      }
+      unsigned number_entries;
+      fc::raw::unpack(ds, number_entries);
+      for(unsigned i = 0; i < number_entries; ++i) {
+         code_descriptor cd;
+         fc::raw::unpack(ds, cd);
+         //an owner restarted with a larger cache can place code beyond what this process has mapped
+         if(cd.codegen_version == 0 && cd.code_begin < _follower_mapping_size && cd.initdata_begin + cd.initdata_size <= _follower_mapping_size)
+            _cache_index.push_back(std::move(cd));
+      }
+   }
+   catch(const fc::exception& e) {
+      wlog("failed to read the shared EOS VM OC code cache index: ${e}", ("e", e.to_detail_string()));
+      _cache_index.clear();
+   }
+}
+
+const code_descriptor* code_cache_base::get_shared_descriptor(const digest_type& code_id, const uint8_t& vm_version) {
+   //without the lock the owner may be evicting the code
+   if(!_follower_locked)
+      return nullptr;
+
+   const uint64_t generation = __atomic_load_n((const uint64_t*)(_follower_header + eviction_generation_offset_from_file_start), __ATOMIC_ACQUIRE);
+   bool reload = generation != _follower_generation;
+   code_cache_index::index<by_hash>::type::iterator it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
+   if(!reload && it == _cache_index.get<by_hash>().end() && fc::time_point::now() - _follower_last_check >= fc::seconds(1)) {
+      _follower_last_check = fc::time_point::now();
+      struct stat st;
+      const int64_t mtime = stat(_shared_index_path.generic_string().c_str(), &st) ? 0 : st.st_mtim.tv_sec * 1000000000ll + st.st_mtim.tv_nsec;
+      reload = mtime != _follower_index_mtime;
+   }
+   if(reload) {
+      load_shared_index();
+      it = _cache_index.get<by_hash>().find(boost::make_tuple(code_id, vm_version));
+   }
+
+   if(it == _cache_index.get<by_hash>().end()) {
+      ++_stats.misses;
+      return nullptr;
+   }
+   ++_stats.hits;
+   _cache_index.relocate(_cache_index.begin(), _cache_index.project<0>(it));
+   return &*it;
+}
+
 }}}
\ No newline at end of file
@@ -1,5 +1,6 @@
 #include <signal.h>
 #include <sys/prctl.h>
+#include <sys/file.h>
 
 #include <eosio/chain/webassembly/eos-vm-oc/ipc_protocol.hpp>
 #include <eosio/chain/webassembly/eos-vm-oc/compile_monitor.hpp>
@@ -75,10 +76,15 @@ struct compile_monitor_session {
                kick_compile_off(compile.code, std::move(fds[0]));
             },
             [&](const evict_wasms_message& evict) {
+               //another process following a shared cache may be running this code, wait for it to finish first
+               code_cache_base::begin_eviction(_code_mapping);
+               flock(_cache_fd, LOCK_EX);
                for(const code_descriptor& cd : evict.codes) {
                   _allocator->deallocate(_code_mapping + cd.code_begin);
                   _allocator->deallocate(_code_mapping + cd.initdata_begin);
                }
+               code_cache_base::end_eviction(_code_mapping);
+               flock(_cache_fd, LOCK_UN);
             },
             [&](const auto&) {
                //anything else is an error
@@ -121,10 +127,11 @@ struct compile_monitor_session {
          
          wasm_compilation_result_message reply{code, compilation_result_unknownfailure{}, _allocator->get_free_memory()};
          
+         std::vector<wrapped_fd> function_table;
          void* code_ptr = nullptr;
          void* mem_ptr = nullptr;
          try {
-            if(success && message.contains<code_compilation_result_message>() && fds.size() == 2) {
+            if(success && message.contains<code_compilation_result_message>() && fds.size() == 3) {
                code_compilation_result_message& result = message.get<code_compilation_result_message>();
                code_ptr = _allocator->allocate(get_size_of_fd(fds[0]));
                mem_ptr = _allocator->allocate(get_size_of_fd(fds[1]));
@@ -150,15 +157,18 @@ struct compile_monitor_session {
                      (unsigned)get_size_of_fd(fds[1]),
                      result.initdata_prologue_size
                   };
+                  function_table.emplace_back(std::move(fds[2]));
                }
             }
          }
          catch(...) {
             _allocator->deallocate(code_ptr);
             _allocator->deallocate(mem_ptr);
+            reply.result = compilation_result_unknownfailure();
+            function_table.clear();
          }
 
-         write_message_with_fds(_nodeos_instance_socket, reply);
+         write_message_with_fds(_nodeos_instance_socket, reply, function_table);
 
          //either way, we are done
          _ctx.post([this, current_compile_it]() {
@@ -123,15 +123,26 @@ void run_compile(wrapped_fd&& response_sock, wrapped_fd&& wasm_code) noexcept {
          initial_mem.resize(base_offset + data_segment.data.size(), 0x00);
       memcpy(initial_mem.data() + base_offset, data_segment.data.data(), data_segment.data.size());
    }
+   //linear memory is already zero when an execution starts, so zero filled tails of the data segments never need
+   // to be copied in; the initdata image is the only thing restored per action
+   while(initial_mem.size() && initial_mem.back() == 0x00)
+      initial_mem.pop_back();
 
    result_message.initdata_prologue_size = prologue.end() - prologue_it;
    std::vector<uint8_t> initdata_prep;
    std::move(prologue_it, prologue.end(), std::back_inserter(initdata_prep));
    std::move(initial_mem.begin(), initial_mem.end(), std::back_inserter(initdata_prep));
 
+   //lets profilers name the wasm function a sampled instruction of the code belongs to
+   std::vector<compiled_function> functions;
+   functions.reserve(function_to_offsets.size());
+   for(const auto& [defined_index, offset] : function_to_offsets)
+      functions.push_back(compiled_function{(uint32_t)(defined_index + module.functions.imports.size()), (uint32_t)offset});
+
    std::vector<wrapped_fd> fds_to_send;
    fds_to_send.emplace_back(memfd_for_bytearray(code.code));
    fds_to_send.emplace_back(memfd_for_bytearray(initdata_prep));
+   fds_to_send.emplace_back(memfd_for_bytearray(fc::raw::pack(functions)));
    write_message_with_fds(response_sock, result_message, fds_to_send);
 }
 
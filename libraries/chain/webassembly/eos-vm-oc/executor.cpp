@@ -70,6 +70,23 @@ notus:
    __builtin_unreachable();
 }
 
+bool executing_code_cache_offset(uintptr_t pc, size_t& cache_offset) noexcept {
+   //same checks as the SEGV handler uses to decide whether a fault is ours
+   uint64_t current_gs;
+   syscall(SYS_arch_prctl, ARCH_GET_GS, &current_gs);
+   if(current_gs == 0)
+      return false;
+
+   const control_block* const cb = reinterpret_cast<control_block*>(current_gs - memory::cb_offset);
+   if(cb->magic != signal_sentinel || cb->is_running == false)
+      return false;
+   if(pc < cb->execution_thread_code_start || pc >= cb->execution_thread_code_start+cb->execution_thread_code_length)
+      return false;
+
+   cache_offset = pc - cb->execution_thread_code_start;
+   return true;
+}
+
 static intrinsic grow_memory_intrinsic EOSVMOC_INTRINSIC_INIT_PRIORITY("eosvmoc_internal.grow_memory", IR::FunctionType::get(IR::ResultType::i32,{IR::ValueType::i32,IR::ValueType::i32}),
   (void*)&eos_vm_oc_grow_memory,
   boost::hana::index_if(intrinsic_table, ::boost::hana::equal.to(BOOST_HANA_STRING("eosvmoc_internal.grow_memory"))).value()
@@ -144,6 +161,7 @@ executor::executor(const code_cache_base& cc) {
    code_mapping = (uint8_t*)mmap(nullptr, s.st_size, PROT_EXEC|PROT_READ, MAP_SHARED, cc.fd(), 0);
    FC_ASSERT(code_mapping != MAP_FAILED, "failed to map code cache in to executor");
    code_mapping_size = s.st_size;
+   code_mapping_instance = cc.mapping_instance();
    mapping_is_executable = true;
 }
 
@@ -153,16 +171,21 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
       mapping_is_executable = true;
    }
 
+   control_block* const cb = mem.get_control_block();
+   cb->current_linear_memory_pages = code.starting_memory_pages;
+   //from here on the memory is dirty; reset it on every way out so that the next action never sees this one's data
+   auto reset_memory = fc::make_scoped_exit([cb, &mem](){
+      mem.reset(cb->current_linear_memory_pages);
+   });
+
    //prepare initial memory, mutable globals, and table data
-   if(code.starting_memory_pages > 0 ) {
+   //linear memory is already zero, the previous execution reset the pages it used on the way out
+   if(code.starting_memory_pages > 0 )
       arch_prctl(ARCH_SET_GS, (unsigned long*)(mem.zero_page_memory_base()+code.starting_memory_pages*memory::stride));
-      memset(mem.full_page_memory_base(), 0, 64u*1024u*code.starting_memory_pages);
-   }
    else
       arch_prctl(ARCH_SET_GS, (unsigned long*)mem.zero_page_memory_base());
    memcpy(mem.full_page_memory_base() - code.initdata_prologue_size, code_mapping + code.initdata_begin, code.initdata_size);
 
-   control_block* const cb = mem.get_control_block();
    cb->magic = signal_sentinel;
    cb->execution_thread_code_start = (uintptr_t)code_mapping;
    cb->execution_thread_code_length = code_mapping_size;
@@ -172,26 +195,26 @@ void executor::execute(const code_descriptor& code, const memory& mem, apply_con
    executors_exception_ptr = nullptr;
    cb->eptr = &executors_exception_ptr;
    cb->current_call_depth_remaining = eosio::chain::wasm_constraints::maximum_call_depth+2;
-   cb->current_linear_memory_pages = code.starting_memory_pages;
    cb->first_invalid_memory_address = code.starting_memory_pages*64*1024;
    cb->full_linear_memory_start = (char*)mem.full_page_memory_base();
    cb->jmp = &executors_sigjmp_buf;
    cb->bounce_buffers = &executors_bounce_buffers;
    cb->running_code_base = (uintptr_t)(code_mapping + code.code_begin);
    cb->is_running = true;
+   cb->current_receiver = context.get_receiver().to_uint64_t();
+   cb->action_data_size = context.get_action().data.size();
 
    context.trx_context.transaction_timer.set_expiration_callback([](void* user) {
       executor* self = (executor*)user;
       syscall(SYS_mprotect, self->code_mapping, self->code_mapping_size, PROT_NONE);
       self->mapping_is_executable = false;
    }, this);
-   context.trx_context.checktime(); //catch any expiration that might have occurred before setting up callback
-
    auto cleanup = fc::make_scoped_exit([cb, &tt=context.trx_context.transaction_timer](){
       cb->is_running = false;
       cb->bounce_buffers->clear();
       tt.set_expiration_callback(nullptr, nullptr);
    });
+   context.trx_context.checktime(); //catch any expiration that might have occurred before setting up callback
 
    void(*apply_func)(uint64_t, uint64_t, uint64_t) = (void(*)(uint64_t, uint64_t, uint64_t))(cb->running_code_base + code.apply_offset);
 
@@ -227,4 +250,45 @@ executor::~executor() {
    arch_prctl(ARCH_SET_GS, nullptr);
 }
 
+struct executor_pool::execution_context {
+   execution_context(const code_cache_base& cc) : exec(cc) {}
+
+   executor exec;
+   memory   mem;
+};
+
+executor_pool::executor_pool(const code_cache_base& cc) : _cc(cc) {
+   //create the first pair up front so that setup failures surface at startup rather than on the first action
+   _idle.emplace_back(std::make_unique<execution_context>(_cc));
+}
+
+executor_pool::~executor_pool() {}
+
+std::unique_ptr<executor_pool::execution_context> executor_pool::acquire() {
+   {
+      std::lock_guard<std::mutex> g(_idle_mtx);
+      while(!_idle.empty()) {
+         std::unique_ptr<execution_context> ctx = std::move(_idle.back());
+         _idle.pop_back();
+         //one mapping a cache file the cache has since moved away from is dropped
+         if(ctx->exec.cache_instance() == _cc.mapping_instance())
+            return ctx;
+      }
+   }
+   return std::make_unique<execution_context>(_cc);
+}
+
+void executor_pool::release(std::unique_ptr<execution_context>&& ctx) {
+   std::lock_guard<std::mutex> g(_idle_mtx);
+   _idle.emplace_back(std::move(ctx));
+}
+
+void executor_pool::execute(const code_descriptor& code, apply_context& context) {
+   std::unique_ptr<execution_context> ctx = acquire();
+   auto give_back = fc::make_scoped_exit([&]() {
+      release(std::move(ctx));
+   });
+   ctx->exec.execute(code, ctx->mem, context);
+}
+
 }}}
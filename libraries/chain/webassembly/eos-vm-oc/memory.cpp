@@ -3,17 +3,21 @@
 
 #include <fc/scoped_exit.hpp>
 
+#include <algorithm>
+
 #include <unistd.h>
+#include <fcntl.h>
 #include <sys/syscall.h>
 #include <sys/mman.h>
 #include <linux/memfd.h>
+#include <linux/falloc.h>
 
 namespace eosio { namespace chain { namespace eosvmoc {
 
 memory::memory() {
-   int fd = syscall(SYS_memfd_create, "eosvmoc_mem", MFD_CLOEXEC);
+   fd = syscall(SYS_memfd_create, "eosvmoc_mem", MFD_CLOEXEC);
    FC_ASSERT(fd >= 0, "Failed to create memory memfd");
-   auto cleanup_fd = fc::make_scoped_exit([&fd](){close(fd);});
+   auto cleanup_fd = fc::make_scoped_exit([this](){close(fd);});
    int ret = ftruncate(fd, wasm_memory_size+memory_prologue_size);
    FC_ASSERT(!ret, "Failed to grow memory memfd");
 
@@ -38,10 +42,27 @@ memory::memory() {
    const intrinsic_map_t& intrinsics = get_intrinsic_map();
    for(const auto& intrinsic : intrinsics)
       intrinsic_jump_table[-intrinsic.second.ordinal] = (uintptr_t)intrinsic.second.function_ptr;
+
+   cleanup_fd.cancel(); //kept open for reset()
+}
+
+void memory::reset(uint64_t pages) const {
+   const uint64_t memset_pages = std::min(pages, memset_reset_pages);
+   memset(fullpage_base, 0, memset_pages*64u*1024u);
+   if(pages == memset_pages)
+      return;
+
+   //punching a hole frees only the pages that were touched, untouched ones are already holes. Every slice maps the
+   // same memfd so all of them read back zero afterwards
+   const uint64_t offset = memory_prologue_size + memset_pages*64u*1024u;
+   const uint64_t length = (pages - memset_pages)*64u*1024u;
+   if(fallocate(fd, FALLOC_FL_PUNCH_HOLE|FALLOC_FL_KEEP_SIZE, offset, length))
+      memset(fullpage_base + memset_pages*64u*1024u, 0, length);
 }
 
 memory::~memory() {
    munmap(mapbase, mapsize);
+   close(fd);
 }
 
 }}}
\ No newline at end of file
@@ -81,6 +81,9 @@ class eos_vm_instantiated_module : public wasm_instantiated_module_interface {
       std::unique_ptr<backend_t> _instantiated_module;
 };
 
+template<typename Impl>
+thread_local backend<apply_context, Impl>* eos_vm_runtime<Impl>::_bkend = nullptr;
+
 template<typename Impl>
 eos_vm_runtime<Impl>::eos_vm_runtime() {}
 
@@ -19,8 +19,8 @@ namespace wasm_constraints = eosio::chain::wasm_constraints;
 
 class wabt_instantiated_module : public wasm_instantiated_module_interface {
    public:
-      wabt_instantiated_module(std::unique_ptr<interp::Environment> e, std::vector<uint8_t> initial_mem, interp::DefinedModule* mod) :
-         _env(move(e)), _instatiated_module(mod), _initial_memory(initial_mem),
+      wabt_instantiated_module(std::unique_ptr<interp::Environment> e, const std::vector<uint8_t>& initial_mem, interp::DefinedModule* mod) :
+         _env(move(e)), _instatiated_module(mod), _apply_export(mod->GetExport("apply")),
          _executor(_env.get(), nullptr, Thread::Options(64*1024,
                                                         wasm_constraints::maximum_call_depth+2))
       {
@@ -30,8 +30,13 @@ class wabt_instantiated_module : public wasm_instantiated_module_interface {
             _initial_globals.emplace_back(_env->GetGlobal(i), _env->GetGlobal(i)->typed_value);
          }
 
-         if(_env->GetMemoryCount())
+         if(_env->GetMemoryCount()) {
             _initial_memory_configuration = _env->GetMemory(0)->page_limits;
+            //the initial pages as every action starts with them, so a reset is a single copy
+            _reset_image.resize(_initial_memory_configuration.initial * WABT_PAGE_SIZE);
+            EOS_ASSERT( initial_mem.size() <= _reset_image.size(), wasm_execution_error, "initial data exceeds the initial memory" );
+            memcpy(_reset_image.data(), initial_mem.data(), initial_mem.size());
+         }
       }
 
       void apply(apply_context& context) override {
@@ -42,13 +47,12 @@ class wabt_instantiated_module : public wasm_instantiated_module_interface {
          wabt_apply_instance_vars this_run_vars{nullptr, context};
          static_wabt_vars = &this_run_vars;
 
-         //reset memory to inital size & copy back in initial data
+         //reset memory to inital size & copy back in initial data; memory only grows, so the resize never reallocates
          if(_env->GetMemoryCount()) {
             Memory* memory = this_run_vars.memory = _env->GetMemory(0);
             memory->page_limits = _initial_memory_configuration;
-            memory->data.resize(_initial_memory_configuration.initial * WABT_PAGE_SIZE);
-            memcpy(memory->data.data(), _initial_memory.data(), _initial_memory.size());
-            memset(memory->data.data() + _initial_memory.size(), 0, memory->data.size() - _initial_memory.size());
+            memory->data.resize(_reset_image.size());
+            memcpy(memory->data.data(), _reset_image.data(), _reset_image.size());
          }
 
          _params[0].set_i64(context.get_receiver().to_uint64_t());
@@ -58,14 +62,16 @@ class wabt_instantiated_module : public wasm_instantiated_module_interface {
          ExecResult res = _executor.RunStartFunction(_instatiated_module);
          EOS_ASSERT( res.result == interp::Result::Ok, wasm_execution_error, "wabt start function failure (${s})", ("s", ResultToString(res.result)) );
 
-         res = _executor.RunExportByName(_instatiated_module, "apply", _params);
+         EOS_ASSERT( _apply_export, wasm_execution_error, "wabt execution failure (${s})", ("s", ResultToString(interp::Result::UnknownExport)) );
+         res = _executor.RunExport(_apply_export, _params);
          EOS_ASSERT( res.result == interp::Result::Ok, wasm_execution_error, "wabt execution failure (${s})", ("s", ResultToString(res.result)) );
       }
 
    private:
       std::unique_ptr<interp::Environment>              _env;
       DefinedModule*                                    _instatiated_module;  //this is owned by the Environment
-      std::vector<uint8_t>                              _initial_memory;
+      Export*                                           _apply_export;  //also owned by the Environment, null when not exported
+      std::vector<char>                                 _reset_image;
       TypedValues                                       _params{3, TypedValue(Type::I64)};
       std::vector<std::pair<Global*, TypedValue>>       _initial_globals;
       Limits                                            _initial_memory_configuration;
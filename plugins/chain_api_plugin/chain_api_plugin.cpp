@@ -1,5 +1,6 @@
 #include <eosio/chain_api_plugin/chain_api_plugin.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/app_thread_executor.hpp>
 
 #include <fc/io/json.hpp>
 
@@ -24,6 +25,12 @@ chain_api_plugin::~chain_api_plugin(){}
 void chain_api_plugin::set_program_options(options_description&, options_description&) {}
 void chain_api_plugin::plugin_initialize(const variables_map&) {}
 
+// read-only calls read the state through read_only::read_state, which discards what a state replica read torn
+template<typename F>
+static auto read_state( const chain_apis::read_only& api, F&& f ) { return api.read_state( std::forward<F>(f) ); }
+template<typename F>
+static auto read_state( const chain_apis::read_write&, F&& f ) { return f(); }
+
 struct async_result_visitor : public fc::visitor<fc::variant> {
    template<typename T>
    fc::variant operator()(const T& v) const {
@@ -37,37 +44,149 @@ struct async_result_visitor : public fc::visitor<fc::variant> {
           api_handle.validate(); \
           try { \
              if (body.empty()) body = "{}"; \
-             fc::variant result( api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>()) ); \
+             auto params = fc::json::from_string(body).as<api_namespace::call_name ## _params>(); \
+             fc::variant result( read_state(api_handle, [&]() { return api_handle.call_name(std::move(params)); }) ); \
              cb(http_response_code, std::move(result)); \
           } catch (...) { \
              http_plugin::handle_exception(#api_name, #call_name, body, cb); \
           } \
        }}
 
+// same as CALL, but the api renders the JSON response itself via call_name##_json
+#define CALL_JSON(api_name, api_handle, api_namespace, call_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+          api_handle.validate(); \
+          try { \
+             if (body.empty()) body = "{}"; \
+             auto params = fc::json::from_string(body).as<api_namespace::call_name ## _params>(); \
+             auto json = read_state(api_handle, [&]() { return api_handle.call_name ## _json(std::move(params)); }); \
+             cb(http_response_code, url_response_body::from_json(std::move(json))); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
+// binary variant of CALL, served to requests that Accept application/octet-stream
+#define CALL_BINARY(api_name, api_handle, api_namespace, call_name, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle](string, string body, url_response_callback cb) mutable { \
+          api_handle.validate(); \
+          try { \
+             if (body.empty()) body = "{}"; \
+             auto params = fc::json::from_string(body).as<api_namespace::call_name ## _params>(); \
+             auto bytes = read_state(api_handle, [&]() { return api_handle.call_name ## _binary(std::move(params)); }); \
+             cb(http_response_code, url_response_body::from_binary(std::move(bytes))); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
+#define ASYNC_RESULT_HANDLER(api_name, call_name, call_result, http_response_code) \
+   [cb, body](const fc::static_variant<fc::exception_ptr, call_result>& result){\
+      if (result.contains<fc::exception_ptr>()) {\
+         try {\
+            result.get<fc::exception_ptr>()->dynamic_rethrow_exception();\
+         } catch (...) {\
+            http_plugin::handle_exception(#api_name, #call_name, body, cb);\
+         }\
+      } else {\
+         cb(http_response_code, result.visit(async_result_visitor()));\
+      }\
+   }
+
 #define CALL_ASYNC(api_name, api_handle, api_namespace, call_name, call_result, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
    [api_handle](string, string body, url_response_callback cb) mutable { \
       if (body.empty()) body = "{}"; \
       api_handle.validate(); \
       api_handle.call_name(fc::json::from_string(body).as<api_namespace::call_name ## _params>(),\
-         [cb, body](const fc::static_variant<fc::exception_ptr, call_result>& result){\
-            if (result.contains<fc::exception_ptr>()) {\
-               try {\
-                  result.get<fc::exception_ptr>()->dynamic_rethrow_exception();\
-               } catch (...) {\
-                  http_plugin::handle_exception(#api_name, #call_name, body, cb);\
-               }\
-            } else {\
-               cb(http_response_code, result.visit(async_result_visitor()));\
-            }\
-         });\
+         ASYNC_RESULT_HANDLER(api_name, call_name, call_result, http_response_code));\
+   }\
+}
+
+// same as CALL_ASYNC, but the transaction is parsed and its ABIs resolved in a chain_plugin read-only window, so only
+// the push itself is posted to the main thread. Register with add_async_handler.
+#define CALL_ASYNC_PACKED(api_name, api_handle, api_namespace, call_name, call_result, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [api_handle, &_chain_plugin](string, string body, url_response_callback cb) mutable { \
+      _chain_plugin.post_read_only( [api_handle, body=std::move(body), cb=std::move(cb)]() mutable { \
+         chain::packed_transaction_ptr trx; \
+         try { \
+            if (body.empty()) body = "{}"; \
+            api_handle.validate(); \
+            trx = api_handle.to_packed_transaction(fc::json::from_string(body).as<api_namespace::call_name ## _params>()); \
+         } catch (...) { \
+            http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+            return; \
+         } \
+         static auto& origin = chain::app_thread_stats::origin( "chain_api:" #call_name, appbase::priority::medium ); \
+         chain::app_thread_post( origin, [api_handle, trx=std::move(trx), body=std::move(body), cb=std::move(cb)]() mutable { \
+            api_handle.call_name(trx, ASYNC_RESULT_HANDLER(api_name, call_name, call_result, http_response_code)); \
+         } ); \
+      } ); \
    }\
 }
 
+using batch_call = std::function<fc::variant(const fc::variant&)>;
+
+#define BATCH_CALL(api_handle, api_namespace, call_name) \
+{std::string(#call_name), [api_handle](const fc::variant& params) mutable { \
+   api_handle.validate(); \
+   return fc::variant( api_handle.call_name(params.as<api_namespace::call_name ## _params>()) ); \
+}}
+
+/// most sub-requests accepted in one /v1/chain/batch request
+static constexpr size_t max_batch_size = 100;
+
+/**
+ * Handler for /v1/chain/batch. The body is an array of {"method": <call name>, "params": <call params>}; the
+ * sub-requests run in order within one handler invocation, so they see the same chain state and cost one slot on
+ * the executing thread. The response is an array with {"code", "result"} or {"code", "error"} per sub-request.
+ */
+static url_handler make_batch_handler( chain_apis::read_only ro_api, std::map<string, batch_call> calls ) {
+   return [ro_api=std::move(ro_api), calls=std::move(calls)]( string, string body, url_response_callback cb ) mutable {
+      try {
+         if (body.empty()) body = "[]";
+         const auto requests = fc::json::from_string(body).get_array();
+         EOS_ASSERT( requests.size() <= max_batch_size, chain::invalid_http_request,
+                     "Batch of ${n} requests exceeds the limit of ${m}", ("n", requests.size())("m", max_batch_size) );
+         // the sub-requests see one state, on a state replica the whole batch is discarded if that state was read torn
+         auto results = ro_api.read_state( [&]() {
+            fc::variants results;
+            results.reserve( requests.size() );
+            for( const auto& request : requests ) {
+               string method;
+               try {
+                  const auto& obj = request.get_object();
+                  method = obj["method"].as_string();
+                  auto itr = calls.find( method );
+                  EOS_ASSERT( itr != calls.end(), chain::invalid_http_request, "Unknown batch method: ${m}", ("m", method) );
+                  const auto params = obj.contains( "params" ) ? obj["params"] : fc::variant( fc::variant_object() );
+                  results.emplace_back( fc::mutable_variant_object( "code", 200 )( "result", itr->second( params ) ) );
+               } catch (...) {
+                  http_plugin::handle_exception( "chain", method.empty() ? "batch" : method.c_str(), body,
+                        [&results]( int code, url_response_body error ) {
+                           results.emplace_back( fc::mutable_variant_object( "code", code )( "error", std::move(error.value) ) );
+                        } );
+               }
+            }
+            return results;
+         } );
+         cb( 200, fc::variant( std::move(results) ) );
+      } catch (...) {
+         http_plugin::handle_exception( "chain", "batch", body, cb );
+      }
+   };
+}
+
 #define CHAIN_RO_CALL(call_name, http_response_code) CALL(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
 #define CHAIN_RW_CALL(call_name, http_response_code) CALL(chain, rw_api, chain_apis::read_write, call_name, http_response_code)
+#define CHAIN_RO_CALL_JSON(call_name, http_response_code) CALL_JSON(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
+#define CHAIN_RO_CALL_BINARY(call_name, http_response_code) CALL_BINARY(chain, ro_api, chain_apis::read_only, call_name, http_response_code)
 #define CHAIN_RO_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, ro_api, chain_apis::read_only, call_name, call_result, http_response_code)
 #define CHAIN_RW_CALL_ASYNC(call_name, call_result, http_response_code) CALL_ASYNC(chain, rw_api, chain_apis::read_write, call_name, call_result, http_response_code)
+#define CHAIN_RW_CALL_ASYNC_PACKED(call_name, call_result, http_response_code) CALL_ASYNC_PACKED(chain, rw_api, chain_apis::read_write, call_name, call_result, http_response_code)
 
 void chain_api_plugin::plugin_startup() {
    ilog( "starting chain_api_plugin" );
@@ -76,7 +195,9 @@ void chain_api_plugin::plugin_startup() {
    auto rw_api = app().get_plugin<chain_plugin>().get_read_write_api();
 
    auto& _http_plugin = app().get_plugin<http_plugin>();
+   auto& _chain_plugin = app().get_plugin<chain_plugin>();
    ro_api.set_shorten_abi_errors( !_http_plugin.verbose_errors() );
+   ro_api.set_parallel_for( [&_http_plugin]( size_t n, const std::function<void(size_t)>& f ) { _http_plugin.parallel_for( n, f ); } );
 
    _http_plugin.add_api({
       CHAIN_RO_CALL(get_info, 200)}, appbase::priority::medium_high);
@@ -84,28 +205,83 @@ void chain_api_plugin::plugin_startup() {
       CHAIN_RO_CALL(get_activated_protocol_features, 200),
       CHAIN_RO_CALL(get_block, 200),
       CHAIN_RO_CALL(get_block_header_state, 200),
+      CHAIN_RO_CALL(get_producer_schedule, 200),
+      CHAIN_RO_CALL(get_scheduled_transactions, 200),
+      CHAIN_RO_CALL(get_transaction_id, 200)
+   });
+   // transactions and blocks are queued ahead of queries so query storms cannot starve them on the main thread
+   _http_plugin.add_api({
+      CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
+      CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202),
+      CHAIN_RW_CALL_ASYNC(push_ro_transaction, chain_apis::read_write::push_ro_transaction_results, 200)
+   }, appbase::priority::medium);
+   if( _chain_plugin.read_only_threads_enabled() ) {
+      _http_plugin.add_async_api({
+         CHAIN_RW_CALL_ASYNC_PACKED(push_transaction, chain_apis::read_write::push_transaction_results, 202),
+         CHAIN_RW_CALL_ASYNC_PACKED(send_transaction, chain_apis::read_write::send_transaction_results, 202)
+      });
+   } else {
+      _http_plugin.add_api({
+         CHAIN_RW_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
+         CHAIN_RW_CALL_ASYNC(send_transaction, chain_apis::read_write::send_transaction_results, 202)
+      }, appbase::priority::medium);
+   }
+
+   _http_plugin.add_binary_api({
+      CHAIN_RO_CALL_BINARY(get_block, 200),
+      CHAIN_RO_CALL_BINARY(get_block_header_state, 200)
+   });
+
+   // calls that only read chainbase, these may execute on the chain_plugin read-only threads
+   api_description read_only_apis = {
+      CHAIN_RO_CALL(abi_json_to_bin, 200),
+      CHAIN_RO_CALL(abi_bin_to_json, 200),
+      CHAIN_RO_CALL(get_required_keys, 200),
       CHAIN_RO_CALL(get_account, 200),
       CHAIN_RO_CALL(get_code, 200),
       CHAIN_RO_CALL(get_code_hash, 200),
       CHAIN_RO_CALL(get_abi, 200),
       CHAIN_RO_CALL(get_raw_code_and_abi, 200),
       CHAIN_RO_CALL(get_raw_abi, 200),
-      CHAIN_RO_CALL(get_table_rows, 200),
+      CHAIN_RO_CALL_JSON(get_table_rows, 200),
       CHAIN_RO_CALL(get_table_by_scope, 200),
       CHAIN_RO_CALL(get_currency_balance, 200),
       CHAIN_RO_CALL(get_currency_stats, 200),
-      CHAIN_RO_CALL(get_producers, 200),
-      CHAIN_RO_CALL(get_producer_schedule, 200),
-      CHAIN_RO_CALL(get_scheduled_transactions, 200),
-      CHAIN_RO_CALL(abi_json_to_bin, 200),
-      CHAIN_RO_CALL(abi_bin_to_json, 200),
-      CHAIN_RO_CALL(get_required_keys, 200),
-      CHAIN_RO_CALL(get_transaction_id, 200),
-      CHAIN_RW_CALL_ASYNC(push_block, chain_apis::read_write::push_block_results, 202),
-      CHAIN_RW_CALL_ASYNC(push_transaction, chain_apis::read_write::push_transaction_results, 202),
-      CHAIN_RW_CALL_ASYNC(push_transactions, chain_apis::read_write::push_transactions_results, 202),
-      CHAIN_RW_CALL_ASYNC(send_transaction, chain_apis::read_write::send_transaction_results, 202)
-   });
+      CHAIN_RO_CALL(get_producers, 200)
+   };
+   read_only_apis.emplace( "/v1/chain/batch", make_batch_handler( ro_api, {
+      BATCH_CALL(ro_api, chain_apis::read_only, get_account),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_code_hash),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_abi),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_raw_abi),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_table_rows),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_table_by_scope),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_currency_balance),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_currency_stats),
+      BATCH_CALL(ro_api, chain_apis::read_only, get_producers)
+   } ) );
+   api_description read_only_binary_apis = {
+      CHAIN_RO_CALL_BINARY(get_raw_abi, 200),
+      CHAIN_RO_CALL_BINARY(get_table_rows, 200)
+   };
+   if( _chain_plugin.read_only_threads_enabled() ) {
+      auto on_read_only_thread = [&_chain_plugin]( url_handler handler ) {
+         return [&_chain_plugin, handler=std::move(handler)]( string url, string body, url_response_callback cb ) {
+            _chain_plugin.post_read_only( [handler, url=std::move(url), body=std::move(body), cb=std::move(cb)]() mutable {
+               handler( std::move(url), std::move(body), std::move(cb) );
+            } );
+         };
+      };
+      for( const auto& call : read_only_apis ) {
+         _http_plugin.add_async_handler( call.first, on_read_only_thread( call.second ) );
+      }
+      for( const auto& call : read_only_binary_apis ) {
+         _http_plugin.add_async_binary_handler( call.first, on_read_only_thread( call.second ) );
+      }
+   } else {
+      _http_plugin.add_api( read_only_apis );
+      _http_plugin.add_binary_api( read_only_binary_apis );
+   }
 }
 
 void chain_api_plugin::plugin_shutdown() {}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <eosio/chain/app_thread_stats.hpp>
+
+#include <appbase/application.hpp>
+#include <fc/scoped_exit.hpp>
+
+#include <utility>
+
+namespace eosio { namespace chain {
+
+   /// app().post at the priority of origin, counting the wait and run time of f against it
+   template<typename F>
+   void app_thread_post( app_thread_origin& origin, F&& f ) {
+      origin.posted();
+      appbase::app().post( origin.priority(), [&origin, f{std::forward<F>( f )}, queued = fc::time_point::now()]() mutable {
+         const auto start = fc::time_point::now();
+         origin.started( start - queued );
+         auto done = fc::make_scoped_exit( [&origin, start]() { origin.finished( fc::time_point::now() - start ); } );
+         f();
+      } );
+   }
+
+   /**
+    * app_thread_post for a read that is not worth delaying a block for: once it has waited longer than deadline it is
+    * dropped by calling shed instead of f if a block is waiting for the application thread or took it while the read
+    * waited. A deadline of zero never sheds.
+    */
+   template<typename F, typename S>
+   void app_thread_post_read( app_thread_origin& origin, fc::microseconds deadline, F&& f, S&& shed ) {
+      if( deadline.count() == 0 ) {
+         app_thread_post( origin, std::forward<F>( f ) );
+         return;
+      }
+      origin.posted();
+      appbase::app().post( origin.priority(), [&origin, deadline, f{std::forward<F>( f )}, shed{std::forward<S>( shed )},
+                                               queued = fc::time_point::now()]() mutable {
+         const auto start = fc::time_point::now();
+         if( app_thread_stats::should_shed( queued, start, deadline ) ) {
+            origin.shed( start - queued );
+            shed();
+            return;
+         }
+         origin.started( start - queued );
+         auto done = fc::make_scoped_exit( [&origin, start]() { origin.finished( fc::time_point::now() - start ); } );
+         f();
+      } );
+   }
+
+} } // eosio::chain
@@ -1,4 +1,5 @@
 #include <eosio/chain_plugin/chain_plugin.hpp>
+#include <eosio/chain_plugin/state_checkpoints.hpp>
 #include <eosio/chain/fork_database.hpp>
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/exceptions.hpp>
@@ -12,19 +13,40 @@
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/app_thread_executor.hpp>
+#include <eosio/chain/span_tracer.hpp>
+#include <eosio/chain/hardware_float.hpp>
+#include <eosio/chain/cpu_features.hpp>
 
 #include <eosio/chain/eosio_contract.hpp>
 
 #include <chainbase/environment.hpp>
 
+#include <boost/asio/steady_timer.hpp>
 #include <boost/signals2/connection.hpp>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp>
 
 #include <fc/io/json.hpp>
+#include <fc/crypto/hex.hpp>
 #include <fc/variant.hpp>
+#include <fc/log/logger_config.hpp>
 #include <signal.h>
+#include <atomic>
 #include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <future>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
 
 // reflect chainbase::environment for --print-build-info option
 FC_REFLECT_ENUM( chainbase::environment::os_t,
@@ -142,6 +164,7 @@ public:
    flat_map<uint32_t,block_id_type> loaded_checkpoints;
    bool                             accept_transactions = false;
    bool                             api_accept_transactions = true;
+   bool                             transactions_disabled = false; ///< enable_accept_transactions has no effect, e.g. on a state replica
 
 
    fc::optional<fork_database>      fork_db;
@@ -152,8 +175,23 @@ public:
    //txn_msg_rate_limits              rate_limits;
    fc::optional<vm_type>            wasm_runtime;
    fc::microseconds                 abi_serializer_max_time_us;
+   std::shared_ptr<chain_apis::abi_cache> abis_cache = std::make_shared<chain_apis::abi_cache>();
+   std::shared_ptr<chain_apis::decoded_row_cache> rows_cache = std::make_shared<chain_apis::decoded_row_cache>();
+   std::shared_ptr<chain_apis::decoded_row_cache> account_rows_cache = std::make_shared<chain_apis::decoded_row_cache>( 64 * 1024 );
    fc::optional<bfs::path>          snapshot_path;
 
+   // periodic snapshots of the state, resumed from when the state database is found dirty at startup
+   uint32_t                         state_checkpoint_interval = 0;
+   uint32_t                         state_checkpoints_to_keep = 2;
+   bfs::path                        state_checkpoints_dir;
+   bool                             verify_state_checkpoints = false;
+   fc::optional<state_checkpoints>  checkpoints;
+   std::future<void>                state_checkpoint_write; ///< the background write of the last checkpoint
+
+   void check_state_checkpoint_hash( const block_state_ptr& blk );
+   void compact_state_database( const fc::path& protocol_features_dir, const chain_id_type& chain_id );
+   uint64_t                         compacted_state_used_bytes = 0; ///< in use before compact-state-database, 0 if not compacted
+   void write_state_checkpoint( const block_state_ptr& blk );
 
    // retained references to channels for easy publication
    channels::pre_accepted_block::channel_type&     pre_accepted_block_channel;
@@ -178,10 +216,35 @@ public:
    fc::optional<scoped_connection>                                   pre_accepted_block_connection;
    fc::optional<scoped_connection>                                   accepted_block_header_connection;
    fc::optional<scoped_connection>                                   accepted_block_connection;
+   fc::optional<scoped_connection>                                   committed_block_connection;
    fc::optional<scoped_connection>                                   irreversible_block_connection;
    fc::optional<scoped_connection>                                   accepted_transaction_connection;
    fc::optional<scoped_connection>                                   applied_transaction_connection;
 
+   // read-only api calls executed in parallel while the main thread is paused
+   uint16_t                                    read_only_threads = 0;
+   fc::optional<named_thread_pool>             read_only_thread_pool;
+   std::mutex                                  read_only_mtx;
+   std::deque<std::function<void()>>           read_only_queue; // guarded by read_only_mtx
+   bool                                        read_only_window_posted = false; // guarded by read_only_mtx
+
+   void execute_read_only_window();
+
+   // state replica of a primary publishing its head, see controller::config::state_replica
+   std::chrono::milliseconds                   replica_refresh_interval{100};
+   fc::optional<boost::asio::steady_timer>     replica_refresh_timer;
+
+   void schedule_replica_refresh();
+
+   // state database placement and background prefault, linux only
+   std::string                                 db_numa_policy = "none";
+   bool                                        db_warmup = false;
+   std::atomic<bool>                           db_warmup_stop{false};
+   std::thread                                 db_warmup_thread;
+
+   void apply_db_numa_policy();
+   void start_db_warmup();
+   void stop_db_warmup();
 };
 
 chain_plugin::chain_plugin()
@@ -198,6 +261,18 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
    cfg.add_options()
          ("blocks-dir", bpo::value<bfs::path>()->default_value("blocks"),
           "the location of the blocks directory (absolute path or relative to application data dir)")
+         ("blocks-log-mmap", bpo::bool_switch()->default_value(false),
+          "serve block log reads from a read-only memory mapping of blocks.log and blocks.index instead of file reads")
+         ("blocks-log-cache-size", bpo::value<uint32_t>()->default_value(0),
+          "number of recently read irreversible blocks to keep decoded in memory, 0 to disable")
+         ("blocks-log-stride", bpo::value<uint32_t>()->default_value(0),
+          "split the block log into files of this many blocks, named blocks-<first>-<last>.log/.index, "
+          "0 keeps a single blocks.log")
+         ("max-retained-block-files", bpo::value<uint32_t>()->default_value(10),
+          "number of block log files split off by blocks-log-stride kept in the blocks directory, 0 keeps all")
+         ("blocks-archive-dir", bpo::value<bfs::path>()->default_value(""),
+          "the location of the directory older block log files past max-retained-block-files are moved to "
+          "(absolute path or relative to the blocks dir); if empty they are deleted")
          ("protocol-features-dir", bpo::value<bfs::path>()->default_value("protocol_features"),
           "the location of the protocol_features directory (absolute path or relative to application config dir)")
          ("checkpoint", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
@@ -210,6 +285,12 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
             }
 #endif
          }), "Override default WASM runtime")
+         ("wasm-instantiation-cache-size-mb", bpo::value<uint64_t>()->default_value(config::default_wasm_instantiation_cache_size / (1024 * 1024)),
+          "Maximum size (in MiB) of contract code kept instantiated by the WASM runtime, least recently used contracts are dropped first")
+         ("native-contracts", bpo::bool_switch()->default_value(false),
+          "Run built in native implementations of the actions of vetted contract builds, such as eosio.token transfer, in place of their WASM")
+         ("contract-code-compression", bpo::bool_switch()->default_value(false),
+          "Keep contract code zlib compressed in the chain state database, it is decompressed when a contract is instantiated. Existing code is converted on startup either way")
          ("abi-serializer-max-time-ms", bpo::value<uint32_t>()->default_value(config::default_abi_serializer_max_time_us / 1000),
           "Override default maximum ABI serialization time allowed in ms")
          ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(config::default_state_size / (1024  * 1024)), "Maximum size (in MiB) of the chain state database")
@@ -218,8 +299,29 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("reversible-blocks-db-guard-size-mb", bpo::value<uint64_t>()->default_value(config::default_reversible_guard_size / (1024  * 1024)), "Safely shut down node when free space remaining in the reverseible blocks database drops below this size (in MiB).")
          ("signature-cpu-billable-pct", bpo::value<uint32_t>()->default_value(config::default_sig_cpu_bill_pct / config::percent_1),
           "Percentage of actual signature recovery cpu to bill. Whole number percentages, e.g. 50 for 50%")
+         ("signature-recovery-cache-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of recovered signature keys to cache so a transaction seen from several peers or again in a block is only recovered once, 0 to disable")
+         ("transaction-metadata-pool-size", bpo::value<uint32_t>()->default_value(0),
+          "Number of received transactions to keep unpacked with their recovered keys so that validating a block including them skips both, 0 to disable")
          ("chain-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in controller thread pool")
+         ("replay-read-ahead-blocks", bpo::value<uint32_t>()->default_value(0),
+          "Number of blocks read from the block log and prepared on the controller thread pool ahead of the one applied "
+          "when replaying irreversible blocks, 0 to read and prepare each block when it is applied")
+         ("read-only-threads", bpo::value<uint16_t>()->default_value(0),
+          "Number of worker threads used to execute read-only chain api calls in parallel while the main thread is paused, 0 to execute them on the main thread")
+         ("publish-replica-head", bpo::bool_switch()->default_value(false),
+          "Publish the block the chain state database is at to replica_head.bin in the state directory whenever it is at a block boundary, "
+          "so that nodes started with state-replica-of this state directory serve read-only api calls from it. The node then accepts no transactions, "
+          "its state has to be at a block boundary for replicas to answer. Requires database-map-mode = mapped")
+         ("state-replica-of", bpo::value<bfs::path>(),
+          "Map the state directory (absolute path or relative to application data dir) of a primary node running with publish-replica-head read-only, "
+          "and serve read-only api calls from it at the head the primary published, without replaying or applying any block")
+         ("replica-blocks-dir", bpo::value<bfs::path>(),
+          "The blocks directory (absolute path or relative to application data dir) of the primary of a state replica, "
+          "from which it serves blocks; by default the blocks directory next to the state directory given with state-replica-of")
+         ("replica-refresh-ms", bpo::value<uint32_t>()->default_value(100),
+          "Interval (in ms) at which a state replica follows the head published by its primary")
          ("contracts-console", bpo::bool_switch()->default_value(false),
           "print contract's output to console")
          ("actor-whitelist", boost::program_options::value<vector<string>>()->composing()->multitoken(),
@@ -253,6 +355,24 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          ("maximum-variable-signature-length", bpo::value<uint32_t>()->default_value(16384u),
           "Subjectively limit the maximum length of variable components in a variable legnth signature to this size in bytes")
          ("trusted-producer", bpo::value<vector<string>>()->composing(), "Indicate a producer whose blocks headers signed by it will be fully validated, but transactions in those validated blocks will be trusted.")
+         ("profile-account", bpo::value<vector<string>>()->composing(),
+          "Account whose actions are profiled (executions, wall time and host function calls). "
+          "Folded-stack profiles are written to the 'profiles' directory under the data directory on shutdown. (may specify multiple times)")
+         ("table-access-sample-rate", bpo::value<uint32_t>()->default_value(0),
+          "Count one of every this many contract table reads and writes by actions, per code and table, for the db_size API. 0 disables the counting.")
+         ("span-trace-buffer-size", bpo::value<uint32_t>()->default_value(0),
+          "Spans of transaction, block, net message and http handling kept for /v1/producer/get_spans, the oldest overwritten first. "
+          "0 disables the tracing, which is only built in with cmake -DENABLE_SPAN_TRACING=ON.")
+         ("wasm-hardware-float", bpo::value<bool>()->default_value(false),
+          "Compute the add, sub, mul, div and sqrt float intrinsics with the FPU where it gives softfloat's results bit for bit, "
+          "falling back to softfloat for NaN results and on hosts or threads set up otherwise")
+         ("report-trx-conflict-groups", bpo::bool_switch()->default_value(false),
+          "Log, for every validated block, how many groups of transactions declare no common account and could be applied independently")
+         ("track-access-sets", bpo::bool_switch()->default_value(false),
+          "Record in every transaction trace the contract table rows it read and wrote")
+         ("trace-cpu-breakdown", bpo::bool_switch()->default_value(false),
+          "Record in every transaction and action trace how its time divides into wasm execution per tier, host functions "
+          "by category, authorization checks and RAM accounting")
          ("database-map-mode", bpo::value<chainbase::pinnable_mapped_file::map_mode>()->default_value(chainbase::pinnable_mapped_file::map_mode::mapped),
           "Database map mode (\"mapped\", \"heap\", or \"locked\").\n"
           "In \"mapped\" mode database is memory mapped as a file.\n"
@@ -265,6 +385,12 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
          )
 #ifdef __linux__
          ("database-hugepage-path", bpo::value<vector<string>>()->composing(), "Optional path for database hugepages when in \"locked\" mode (may specify multiple times)")
+         ("database-numa-policy", bpo::value<string>()->default_value("none"),
+          "NUMA memory policy of the database when in \"heap\" or \"locked\" mode (\"none\" or \"interleave\").\n"
+          "In \"interleave\" mode the database pages are spread, and already loaded pages migrated, across all online NUMA nodes.")
+         ("database-warmup", bpo::bool_switch()->default_value(false),
+          "Prefault every page of the database on a background thread after startup, logging progress, so that the first "
+          "accesses to cold state do not stall block production or validation")
 #endif
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
@@ -275,7 +401,16 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
                   EOS_ASSERT(false, plugin_exception, "");
                }
          }), "Number of threads to use for EOS VM OC tier-up")
+         ("eos-vm-oc-warmup-contracts", bpo::value<uint64_t>()->default_value(0u),
+          "Number of most used contracts, as recorded on previous runs, to compile with EOS VM OC on startup before applying blocks (0 disables)")
          ("eos-vm-oc-enable", bpo::bool_switch(), "Enable EOS VM OC tier-up runtime")
+         ("eos-vm-oc-share-cache", bpo::bool_switch(),
+          "Publish the index of this node's EOS VM OC code cache so other nodeos processes on this host can run the code "
+          "it compiles, see eos-vm-oc-shared-cache-dir")
+         ("eos-vm-oc-shared-cache-dir", bpo::value<bfs::path>(),
+          "Run EOS VM OC code from the code cache in this directory, the state directory of another nodeos on this host "
+          "running with eos-vm-oc-share-cache, instead of compiling in this process. The code pages are shared with it. "
+          "Code not yet compiled there runs on the base WASM runtime")
 #endif
          ;
 
@@ -318,7 +453,25 @@ void chain_plugin::set_program_options(options_description& cli, options_descrip
           "replace reversible block database with blocks imported from specified file and then exit")
          ("export-reversible-blocks", bpo::value<bfs::path>(),
            "export reversible block database in portable format into specified file and then exit")
+         ("compact-state-database", bpo::bool_switch()->default_value(false),
+          "rewrite the state database at startup through a snapshot of its last irreversible block, reclaiming the space "
+          "fragmented by freed objects, and replay the reversible blocks on top of it. Needs room for the snapshot in the state directory")
          ("snapshot", bpo::value<bfs::path>(), "File to read Snapshot State from")
+         ("snapshot-contracts", bpo::value<vector<string>>()->composing(),
+          "Load only the contract tables of this account from --snapshot, along with every other section of it. The node "
+          "then serves read-only api calls on the state as of the snapshot and applies no blocks, also after restarts. "
+          "May be used multiple times")
+         ("state-checkpoint-interval", bpo::value<uint32_t>()->default_value(0),
+          "Write a snapshot of the state every this many blocks, kept once the block is irreversible. When the state "
+          "database is found dirty at startup, the newest one within the block log is loaded and only the blocks after it "
+          "are replayed. 0 disables state checkpoints")
+         ("state-checkpoints-to-keep", bpo::value<uint32_t>()->default_value(2),
+          "Number of irreversible state checkpoints to keep")
+         ("state-checkpoints-dir", bpo::value<bfs::path>()->default_value("state-checkpoints"),
+          "the location of the state checkpoints directory (absolute path or relative to application data dir)")
+         ("verify-state-checkpoints", bpo::bool_switch()->default_value(false),
+          "Record the integrity hash of the state with every state checkpoint, and check the state against it when a "
+          "replay reaches the block of a checkpoint, stopping on a mismatch")
          ;
 
 }
@@ -370,6 +523,17 @@ void clear_chainbase_files( const fc::path& p ) {
    fc::remove( p / "shared_memory.meta" );
 }
 
+bool state_database_is_dirty( const fc::path& state_dir ) {
+   if( !fc::is_regular_file( state_dir / "shared_memory.bin" ) )
+      return false;
+   try {
+      chainbase::database db( state_dir, database::read_only );
+   } catch( const std::exception& e ) {
+      return std::string( e.what() ).find( "database dirty flag set" ) != std::string::npos;
+   }
+   return false;
+}
+
 optional<builtin_protocol_feature> read_builtin_protocol_feature( const fc::path& p  ) {
    try {
       return fc::json::from_file<builtin_protocol_feature>( p );
@@ -633,6 +797,27 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       LOAD_VALUE_SET( options, "contract-blacklist", my->chain_config->contract_blacklist );
 
       LOAD_VALUE_SET( options, "trusted-producer", my->chain_config->trusted_producers );
+      LOAD_VALUE_SET( options, "profile-account", my->chain_config->profile_accounts );
+      LOAD_VALUE_SET( options, "snapshot-contracts", my->chain_config->snapshot_contracts );
+      EOS_ASSERT( my->chain_config->snapshot_contracts.empty() || options.count( "snapshot" ), plugin_config_exception,
+                  "snapshot-contracts requires --snapshot" );
+      my->chain_config->table_access_sample_rate = options.at( "table-access-sample-rate" ).as<uint32_t>();
+
+      if( const uint32_t span_trace_buffer_size = options.at( "span-trace-buffer-size" ).as<uint32_t>() ) {
+         if( span_tracing_compiled )
+            span_tracer::initialize( span_trace_buffer_size );
+         else
+            wlog( "span-trace-buffer-size ignored, this nodeos was built without ENABLE_SPAN_TRACING" );
+      }
+
+      hardware_float::set_enabled( options.at( "wasm-hardware-float" ).as<bool>() );
+      if( hardware_float::enabled() ) {
+         // run once here rather than on the first float intrinsic of some transaction
+         if( hardware_float::verified() )
+            ilog( "float intrinsics computed in hardware where exact" );
+         else
+            ilog( "float intrinsics computed by softfloat, the hardware here is not verified as exact" );
+      }
 
       if( options.count( "action-blacklist" )) {
          const std::vector<std::string>& acts = options["action-blacklist"].as<std::vector<std::string>>();
@@ -663,8 +848,8 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       }
 
       protocol_feature_set pfs;
+      fc::path protocol_features_dir;
       {
-         fc::path protocol_features_dir;
          auto pfd = options.at( "protocol-features-dir" ).as<bfs::path>();
          if( pfd.is_relative())
             protocol_features_dir = app().config_dir() / pfd;
@@ -699,8 +884,37 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->abi_serializer_max_time_us = fc::microseconds(options.at("abi-serializer-max-time-ms").as<uint32_t>() * 1000);
 
       my->chain_config->blocks_dir = my->blocks_dir;
+      my->chain_config->blocks_log_mmap = options.at( "blocks-log-mmap" ).as<bool>();
+      my->chain_config->blocks_log_cache_size = options.at( "blocks-log-cache-size" ).as<uint32_t>();
+      my->chain_config->blocks_log_stride = options.at( "blocks-log-stride" ).as<uint32_t>();
+      my->chain_config->max_retained_block_files = options.at( "max-retained-block-files" ).as<uint32_t>();
+      const auto archive_dir = options.at( "blocks-archive-dir" ).as<bfs::path>();
+      if( !archive_dir.empty() )
+         my->chain_config->blocks_archive_dir = archive_dir.is_relative() ? my->blocks_dir / archive_dir : archive_dir;
       my->chain_config->state_dir = app().data_dir() / config::default_state_dir_name;
       my->chain_config->read_only = my->readonly;
+      my->chain_config->publish_replica_head = options.at( "publish-replica-head" ).as<bool>();
+      if( options.count( "state-replica-of" ) ) {
+         auto primary_state_dir = options.at( "state-replica-of" ).as<bfs::path>();
+         if( primary_state_dir.is_relative() )
+            primary_state_dir = app().data_dir() / primary_state_dir;
+         EOS_ASSERT( !my->chain_config->publish_replica_head, plugin_config_exception,
+                     "state-replica-of is incompatible with publish-replica-head" );
+         for( const char* opt : { "snapshot", "genesis-json", "genesis-timestamp" } )
+            EOS_ASSERT( !options.count( opt ), plugin_config_exception, "state-replica-of is incompatible with --${o}", ("o", opt) );
+         for( const char* opt : { "delete-all-blocks", "hard-replay-blockchain", "replay-blockchain" } )
+            EOS_ASSERT( !options.at( opt ).as<bool>(), plugin_config_exception, "state-replica-of is incompatible with --${o}", ("o", opt) );
+         auto primary_blocks_dir = options.count( "replica-blocks-dir" ) ? options.at( "replica-blocks-dir" ).as<bfs::path>()
+                                                                         : primary_state_dir.parent_path() / config::default_blocks_dir_name;
+         if( primary_blocks_dir.is_relative() )
+            primary_blocks_dir = app().data_dir() / primary_blocks_dir;
+         EOS_ASSERT( fc::is_directory( primary_blocks_dir / config::reversible_blocks_dir_name ), plugin_config_exception,
+                     "${d} is not the blocks directory of the primary, set replica-blocks-dir", ("d", primary_blocks_dir.generic_string()) );
+         my->chain_config->state_dir = primary_state_dir;
+         my->chain_config->replica_blocks_dir = primary_blocks_dir;
+         my->chain_config->state_replica = true;
+         my->replica_refresh_interval = std::chrono::milliseconds( options.at( "replica-refresh-ms" ).as<uint32_t>() );
+      }
 
       if( options.count( "chain-state-db-size-mb" ))
          my->chain_config->state_size = options.at( "chain-state-db-size-mb" ).as<uint64_t>() * 1024 * 1024;
@@ -725,15 +939,24 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
       EOS_ASSERT( my->chain_config->sig_cpu_bill_pct >= 0 && my->chain_config->sig_cpu_bill_pct <= 100, plugin_config_exception,
                   "signature-cpu-billable-pct must be 0 - 100, ${pct}", ("pct", my->chain_config->sig_cpu_bill_pct) );
       my->chain_config->sig_cpu_bill_pct *= config::percent_1;
+      my->chain_config->sig_recovery_cache_size = options.at( "signature-recovery-cache-size" ).as<uint32_t>();
+      my->chain_config->trx_metadata_pool_size = options.at( "transaction-metadata-pool-size" ).as<uint32_t>();
+      my->chain_config->replay_read_ahead_blocks = options.at( "replay-read-ahead-blocks" ).as<uint32_t>();
 
       if( my->wasm_runtime )
          my->chain_config->wasm_runtime = *my->wasm_runtime;
+      my->chain_config->wasm_instantiation_cache_size = options.at( "wasm-instantiation-cache-size-mb" ).as<uint64_t>() * 1024 * 1024;
+      my->chain_config->compress_contract_code = options.at( "contract-code-compression" ).as<bool>();
+      my->chain_config->native_contracts = options.at( "native-contracts" ).as<bool>();
 
       my->chain_config->force_all_checks = options.at( "force-all-checks" ).as<bool>();
       my->chain_config->disable_replay_opts = options.at( "disable-replay-opts" ).as<bool>();
       my->chain_config->contracts_console = options.at( "contracts-console" ).as<bool>();
       my->chain_config->allow_ram_billing_in_notify = options.at( "disable-ram-billing-notify-checks" ).as<bool>();
       my->chain_config->maximum_variable_signature_length = options.at( "maximum-variable-signature-length" ).as<uint32_t>();
+      my->chain_config->report_trx_conflict_groups = options.at( "report-trx-conflict-groups" ).as<bool>();
+      my->chain_config->track_access_sets = options.at( "track-access-sets" ).as<bool>();
+      my->chain_config->trace_cpu_breakdown = options.at( "trace-cpu-breakdown" ).as<bool>();
 
       if( options.count( "extract-genesis-json" ) || options.at( "print-genesis-json" ).as<bool>()) {
          fc::optional<genesis_state> gs;
@@ -835,24 +1058,53 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          wlog("The --import-reversible-blocks option should be used by itself.");
       }
 
+      my->state_checkpoint_interval = options.at( "state-checkpoint-interval" ).as<uint32_t>();
+      my->state_checkpoints_to_keep = options.at( "state-checkpoints-to-keep" ).as<uint32_t>();
+      EOS_ASSERT( my->state_checkpoint_interval == 0 || my->state_checkpoints_to_keep > 0, plugin_config_exception,
+                  "state-checkpoints-to-keep must be greater than 0" );
+      my->state_checkpoints_dir = options.at( "state-checkpoints-dir" ).as<bfs::path>();
+      my->verify_state_checkpoints = options.at( "verify-state-checkpoints" ).as<bool>();
+      if( my->state_checkpoints_dir.is_relative() )
+         my->state_checkpoints_dir = app().data_dir() / my->state_checkpoints_dir;
+      if( my->state_checkpoint_interval > 0 && !my->chain_config->state_replica ) {
+         my->checkpoints.emplace( my->state_checkpoints_dir, my->state_checkpoints_to_keep );
+         my->checkpoints->remove_incomplete();
+      }
+
+      fc::optional<bfs::path> state_checkpoint;
+      if( my->state_checkpoint_interval > 0 && !options.count( "snapshot" ) && !my->chain_config->state_replica &&
+          state_database_is_dirty( my->chain_config->state_dir ) ) {
+         state_checkpoint = state_checkpoints::newest_usable( my->state_checkpoints_dir, my->blocks_dir );
+         if( state_checkpoint ) {
+            wlog( "database dirty flag set (likely due to unclean shutdown): resuming from state checkpoint ${c} and "
+                  "replaying the block log from there", ("c", state_checkpoint->generic_string()) );
+            clear_chainbase_files( my->chain_config->state_dir );
+            // left dirty by the same shutdown, most likely
+            recover_reversible_blocks( my->chain_config->blocks_dir / config::reversible_blocks_dir_name,
+                                       my->chain_config->reversible_cache_size );
+         }
+      }
+
       fc::optional<chain_id_type> chain_id;
-      if (options.count( "snapshot" )) {
-         my->snapshot_path = options.at( "snapshot" ).as<bfs::path>();
+      if( my->chain_config->state_replica ) {
+         // the primary holds the state database dirty for as long as it runs
+         chain_id = controller::extract_chain_id_from_db( my->chain_config->state_dir, true );
+         EOS_ASSERT( chain_id, plugin_config_exception, "no chain state found in ${d}", ("d", my->chain_config->state_dir.generic_string()) );
+      } else if (options.count( "snapshot" ) || state_checkpoint) {
+         my->snapshot_path = state_checkpoint ? *state_checkpoint : options.at( "snapshot" ).as<bfs::path>();
          EOS_ASSERT( fc::exists(*my->snapshot_path), plugin_config_exception,
                      "Cannot load snapshot, ${name} does not exist", ("name", my->snapshot_path->generic_string()) );
 
          // recover genesis information from the snapshot
          // used for validation code below
-         auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         istream_snapshot_reader reader(infile);
-         reader.validate();
-         chain_id = controller::extract_chain_id(reader);
-         infile.close();
+         auto reader = open_snapshot_file(*my->snapshot_path);
+         reader->validate();
+         chain_id = controller::extract_chain_id(*reader);
 
-         EOS_ASSERT( options.count( "genesis-timestamp" ) == 0,
+         EOS_ASSERT( state_checkpoint || options.count( "genesis-timestamp" ) == 0,
                  plugin_config_exception,
                  "--snapshot is incompatible with --genesis-timestamp as the snapshot contains genesis information");
-         EOS_ASSERT( options.count( "genesis-json" ) == 0,
+         EOS_ASSERT( state_checkpoint || options.count( "genesis-json" ) == 0,
                      plugin_config_exception,
                      "--snapshot is incompatible with --genesis-json as the snapshot contains genesis information");
 
@@ -1011,6 +1263,8 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          enable_accept_transactions();
       }
 
+      my->read_only_threads = options.at( "read-only-threads" ).as<uint16_t>();
+
       if ( options.count("validation-mode") ) {
          my->chain_config->block_validation_mode = options.at("validation-mode").as<validation_mode>();
       }
@@ -1019,6 +1273,10 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 #ifdef __linux__
       if( options.count("database-hugepage-path") )
          my->chain_config->db_hugepage_paths = options.at("database-hugepage-path").as<std::vector<std::string>>();
+      my->db_numa_policy = options.at("database-numa-policy").as<string>();
+      EOS_ASSERT( my->db_numa_policy == "none" || my->db_numa_policy == "interleave", plugin_config_exception,
+                  "database-numa-policy must be \"none\" or \"interleave\", not \"${p}\"", ("p", my->db_numa_policy) );
+      my->db_warmup = options.at("database-warmup").as<bool>();
 #endif
 
 #ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
@@ -1026,10 +1284,63 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->chain_config->eosvmoc_config.cache_size = options.at( "eos-vm-oc-cache-size-mb" ).as<uint64_t>() * 1024u * 1024u;
       if( options.count("eos-vm-oc-compile-threads") )
          my->chain_config->eosvmoc_config.threads = options.at("eos-vm-oc-compile-threads").as<uint64_t>();
+      if( options.count("eos-vm-oc-warmup-contracts") )
+         my->chain_config->eosvmoc_config.warmup_contracts = options.at("eos-vm-oc-warmup-contracts").as<uint64_t>();
       if( options["eos-vm-oc-enable"].as<bool>() )
          my->chain_config->eosvmoc_tierup = true;
+      my->chain_config->eosvmoc_config.share_cache = options.at( "eos-vm-oc-share-cache" ).as<bool>();
+      if( options.count( "eos-vm-oc-shared-cache-dir" ) ) {
+         auto dir = options.at( "eos-vm-oc-shared-cache-dir" ).as<bfs::path>();
+         if( dir.is_relative() )
+            dir = app().data_dir() / dir;
+         EOS_ASSERT( !my->chain_config->eosvmoc_config.share_cache, plugin_config_exception,
+                     "eos-vm-oc-share-cache and eos-vm-oc-shared-cache-dir can not both be set" );
+         EOS_ASSERT( my->chain_config->eosvmoc_tierup, plugin_config_exception,
+                     "eos-vm-oc-shared-cache-dir requires eos-vm-oc-enable" );
+         my->chain_config->eosvmoc_config.shared_cache_dir = dir;
+      }
 #endif
 
+      // replicas see the state through the mapping of state/shared_memory.bin only
+      EOS_ASSERT( !(my->chain_config->publish_replica_head || my->chain_config->state_replica)
+                  || my->chain_config->db_map_mode == pinnable_mapped_file::map_mode::mapped, plugin_config_exception,
+                  "publish-replica-head and state-replica-of require database-map-mode = mapped" );
+      if( my->chain_config->state_replica ) {
+         // the eos-vm-oc code cache lives next to the state database and belongs to the primary
+         EOS_ASSERT( !my->chain_config->eosvmoc_tierup, plugin_config_exception, "state-replica-of is incompatible with eos-vm-oc-enable" );
+         if( my->api_accept_transactions ) {
+            my->api_accept_transactions = false;
+            wlog( "api-accept-transactions set to false for a state replica" );
+         }
+         my->accept_transactions = false;
+         my->transactions_disabled = true;
+      }
+      if( my->chain_config->publish_replica_head ) {
+         // a pending block holds the state off the head for as long as it is open, replicas answer nothing meanwhile
+         if( my->api_accept_transactions ) {
+            my->api_accept_transactions = false;
+            wlog( "api-accept-transactions set to false for a node publishing its replica head" );
+         }
+         my->accept_transactions = false;
+         my->transactions_disabled = true;
+      }
+      // a partial state lacks the tables that executing transactions of other contracts would read
+      if( !my->chain_config->snapshot_contracts.empty() ||
+          (!options.count( "snapshot" ) && fc::exists( my->chain_config->state_dir / controller::partial_state_file_name )) ) {
+         if( my->api_accept_transactions ) {
+            my->api_accept_transactions = false;
+            wlog( "api-accept-transactions set to false for a partial state" );
+         }
+         my->accept_transactions = false;
+         my->transactions_disabled = true;
+      }
+
+      if( options.at( "compact-state-database" ).as<bool>() ) {
+         EOS_ASSERT( !my->snapshot_path && !my->genesis && !my->chain_config->state_replica && chain_id, plugin_config_exception,
+                     "compact-state-database requires an existing state database and is incompatible with --snapshot and state-replica-of" );
+         my->compact_state_database( protocol_features_dir, *chain_id );
+      }
+
       my->chain.emplace( *my->chain_config, std::move(pfs), *chain_id );
 
       // set up method providers
@@ -1075,7 +1386,17 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
          my->accepted_block_channel.publish( priority::high, blk );
       } );
 
+      if( my->checkpoints ) {
+         // accepted_block and irreversible_block are emitted while the block is still pending, which snapshots refuse
+         my->committed_block_connection = my->chain->committed_block.connect( [this]( const block_state_ptr& blk ) {
+            if( blk->block_num % my->state_checkpoint_interval == 0 )
+               my->write_state_checkpoint( blk );
+         } );
+      }
+
       my->irreversible_block_connection = my->chain->irreversible_block.connect( [this]( const block_state_ptr& blk ) {
+         if( my->checkpoints )
+            my->checkpoints->on_irreversible( blk->id );
          my->irreversible_block_channel.publish( priority::low, blk );
       } );
 
@@ -1094,17 +1415,137 @@ void chain_plugin::plugin_initialize(const variables_map& options) {
 
 }
 
+/// Rewrites the state database through a snapshot of its last irreversible block, which inserts every object anew in
+/// index order into a fresh shared_memory.bin. The reversible blocks are set aside meanwhile and are replayed on top of
+/// the snapshot when the chain starts from it.
+void chain_plugin_impl::compact_state_database( const fc::path& protocol_features_dir, const chain_id_type& chain_id ) {
+   EOS_ASSERT( !state_database_is_dirty( chain_config->state_dir ), plugin_config_exception,
+               "compact-state-database requires a state database that was shut down cleanly" );
+   const auto reversible_dir  = chain_config->blocks_dir / config::reversible_blocks_dir_name;
+   const auto reversible_file = chain_config->state_dir / "compaction-reversible.bin";
+   const auto snapshot_file   = chain_config->state_dir / "compaction-snapshot.bin";
+   const bool has_reversible  = fc::exists( reversible_dir / "shared_memory.bin" );
+   if( has_reversible )
+      chain_plugin::export_reversible_blocks( reversible_dir, reversible_file );
+
+   {
+      // in irreversible mode the state is undone to the last irreversible block, the only one a snapshot loads at
+      auto cfg = *chain_config;
+      cfg.read_mode = db_read_mode::IRREVERSIBLE;
+      controller chain( cfg, initialize_protocol_features( protocol_features_dir, false ), chain_id );
+      chain.add_indices();
+      chain.startup( []() { return app().is_quiting(); } );
+      const auto* sm = chain.db().get_segment_manager();
+      compacted_state_used_bytes = sm->get_size() - sm->get_free_memory();
+      ilog( "compacting the state database at block ${n}, ${u} MiB in use",
+            ("n", chain.head_block_num())("u", compacted_state_used_bytes >> 20) );
+
+      std::ofstream out( snapshot_file.generic_string(), std::ios::out | std::ios::binary );
+      auto writer = std::make_shared<ostream_snapshot_writer>( out );
+      chain.write_snapshot( writer );
+      writer->finalize();
+      out.flush();
+      EOS_ASSERT( out.good(), snapshot_exception, "Unable to write ${p}", ("p", snapshot_file.generic_string()) );
+   }
+
+   clear_chainbase_files( chain_config->state_dir );
+   if( has_reversible ) {
+      fc::remove_all( reversible_dir );
+      chain_plugin::import_reversible_blocks( reversible_dir, chain_config->reversible_cache_size, reversible_file );
+      fc::remove( reversible_file );
+   }
+   snapshot_path = snapshot_file;
+}
+
+/**
+ * Serializes the state at blk, the head with no block pending, on the main thread while another thread writes it to
+ * its .pending file as it is serialized, so the main thread never waits for the disk and the checkpoint is held in
+ * memory at most once. A checkpoint due before the previous one is on disk waits for it.
+ */
+void chain_plugin_impl::write_state_checkpoint( const block_state_ptr& blk ) {
+   if( checkpoints->is_pending( blk->id ) )
+      return;
+   if( fc::is_regular_file( checkpoints->path( blk->id ) ) ) {
+      // replayed past a checkpoint written before
+      check_state_checkpoint_hash( blk );
+      return;
+   }
+   if( state_checkpoint_write.valid() )
+      state_checkpoint_write.wait();
+   try {
+      const auto start = fc::time_point::now();
+      auto chunks = std::make_shared<snapshot_chunk_queue>();
+      // set before chunks is closed, read by the writer once it is
+      auto integrity_hash = std::make_shared<fc::optional<fc::sha256>>();
+
+      const auto path = checkpoints->start_write( blk->id );
+      state_checkpoint_write = std::async( std::launch::async, [this, id = blk->id, path, chunks, integrity_hash]() {
+         fc::set_os_thread_name( "checkpoint" );
+         bool succeeded = false;
+         try {
+            std::ofstream out( path.generic_string(), std::ios::out | std::ios::binary );
+            EOS_ASSERT( chunks->write_to( out ) && out.flush().good(), snapshot_exception,
+                        "Unable to write state checkpoint ${p}", ("p", path.generic_string()) );
+            if( *integrity_hash )
+               checkpoints->record_integrity_hash( id, **integrity_hash );
+            succeeded = true;
+         } FC_LOG_AND_DROP()
+         checkpoints->write_finished( id, succeeded );
+      } );
+
+      try {
+         std::ostream out( chunks.get() );
+         auto writer = std::make_shared<ostream_snapshot_writer>( out );
+         chain->write_snapshot( writer );
+         writer->finalize();
+         EOS_ASSERT( out.flush().good(), snapshot_exception, "Unable to serialize state checkpoint of block ${n}", ("n", blk->block_num) );
+         if( verify_state_checkpoints )
+            *integrity_hash = chain->calculate_integrity_hash();
+      } catch( ... ) {
+         chunks->abort();
+         throw;
+      }
+      chunks->close();
+      ilog( "Serialized state checkpoint of block ${n}, ${s} bytes in ${t}ms, writing it in the background",
+            ("n", blk->block_num)("s", chunks->size())("t", (fc::time_point::now() - start).count() / 1000) );
+   } FC_LOG_AND_DROP()
+}
+
+/**
+ * Replaying past a checkpoint whose write recorded the integrity hash of its state, checks that the replayed state
+ * has the same hash and stops the node if it does not. This is a check of the hashes only, the checkpoint is not read.
+ */
+void chain_plugin_impl::check_state_checkpoint_hash( const block_state_ptr& blk ) {
+   if( !verify_state_checkpoints || chain->head_block_id() != blk->id || !fc::is_regular_file( checkpoints->integrity_path( blk->id ) ) )
+      return;
+   try {
+      const auto actual = chain->calculate_integrity_hash();
+      switch( checkpoints->check_integrity_hash( blk->id, actual ) ) {
+         case state_checkpoints::hash_check::unrecorded:
+            return;
+         case state_checkpoints::hash_check::differs:
+            elog( "State at block ${n} does not match the integrity hash recorded with state checkpoint ${p}, its hash is ${a}",
+                  ("n", blk->block_num)("p", checkpoints->path( blk->id ).generic_string())("a", actual) );
+            app().quit();
+            return;
+         case state_checkpoints::hash_check::matches:
+            ilog( "State at block ${n} matches the integrity hash of its state checkpoint", ("n", blk->block_num) );
+            return;
+      }
+   } FC_LOG_AND_DROP()
+}
+
 void chain_plugin::plugin_startup()
 { try {
    EOS_ASSERT( my->chain_config->read_mode != db_read_mode::IRREVERSIBLE || !accept_transactions(), plugin_config_exception,
                "read-mode = irreversible. transactions should not be enabled by enable_accept_transactions" );
+   for( const auto& line : crypto_kernel_report() )
+      ilog( "crypto ${line}", ("line", line) );
+
    try {
       auto shutdown = [](){ return app().is_quiting(); };
       if (my->snapshot_path) {
-         auto infile = std::ifstream(my->snapshot_path->generic_string(), (std::ios::in | std::ios::binary));
-         auto reader = std::make_shared<istream_snapshot_reader>(infile);
-         my->chain->startup(shutdown, reader);
-         infile.close();
+         my->chain->startup(shutdown, open_snapshot_file(*my->snapshot_path));
       } else if( my->genesis ) {
          my->chain->startup(shutdown, *my->genesis);
       } else {
@@ -1117,6 +1558,13 @@ void chain_plugin::plugin_startup()
       throw;
    }
 
+   if( my->compacted_state_used_bytes > 0 ) {
+      fc::remove( *my->snapshot_path );
+      const auto* sm = my->chain->db().get_segment_manager();
+      ilog( "compacted the state database from ${b} MiB to ${a} MiB in use",
+            ("b", my->compacted_state_used_bytes >> 20)("a", (sm->get_size() - sm->get_free_memory()) >> 20) );
+   }
+
    if(!my->readonly) {
       ilog("starting chain in read/write mode");
    }
@@ -1129,21 +1577,229 @@ void chain_plugin::plugin_startup()
       ilog("Blockchain started; head block is #${num}", ("num", my->chain->head_block_num()));
    }
 
+   my->apply_db_numa_policy();
+   my->start_db_warmup();
+
+   if( my->chain->is_state_replica() ) {
+      ilog( "serving read-only api calls as a replica of ${d}", ("d", my->chain_config->state_dir.generic_string()) );
+      my->replica_refresh_timer.emplace( app().get_io_service() );
+      my->schedule_replica_refresh();
+   }
+
+   if( my->read_only_threads > 0 ) {
+      my->read_only_thread_pool.emplace( "chain_ro", my->read_only_threads );
+      ilog( "executing read-only api calls on ${n} threads", ("n", my->read_only_threads) );
+   }
+
    my->chain_config.reset();
 } FC_CAPTURE_AND_RETHROW() }
 
+// Writes the accumulated action profile in folded-stack format ("receiver;code::action value" per line), which
+// flamegraph.pl, speedscope and similar tools consume directly.
+static void write_action_profiles( const controller& chain, const bfs::path& dir ) {
+   const auto& profiles = chain.get_action_profiles();
+   if( profiles.empty() )
+      return;
+   try {
+      fc::create_directories( dir );
+      std::ofstream wall( (dir / "actions-wall-us.folded").generic_string(), std::ios::trunc );
+      std::ofstream calls( (dir / "actions-host-calls.folded").generic_string(), std::ios::trunc );
+      for( const auto& p : profiles ) {
+         const std::string frame = std::get<0>(p.first).to_string() + ";" +
+                                   std::get<1>(p.first).to_string() + "::" + std::get<2>(p.first).to_string();
+         wall  << frame << ' ' << p.second.elapsed.count() << '\n';
+         calls << frame << ' ' << p.second.host_calls << '\n';
+      }
+      ilog( "wrote profile of ${n} actions to ${d}", ("n", profiles.size())("d", dir.generic_string()) );
+   } catch( const std::exception& e ) {
+      elog( "unable to write action profiles to ${d}: ${e}", ("d", dir.generic_string())("e", e.what()) );
+   }
+}
+
 void chain_plugin::plugin_shutdown() {
    my->pre_accepted_block_connection.reset();
    my->accepted_block_header_connection.reset();
    my->accepted_block_connection.reset();
+   my->committed_block_connection.reset();
    my->irreversible_block_connection.reset();
+   if( my->state_checkpoint_write.valid() )
+      my->state_checkpoint_write.wait();
    my->accepted_transaction_connection.reset();
    my->applied_transaction_connection.reset();
+   my->read_only_thread_pool.reset();
+   if( my->replica_refresh_timer )
+      my->replica_refresh_timer->cancel();
+   my->stop_db_warmup();
+   if( my->chain )
+      write_action_profiles( *my->chain, app().data_dir() / "profiles" );
    if(app().is_quiting())
       my->chain->get_wasm_interface().indicate_shutting_down();
    my->chain.reset();
 }
 
+bool chain_plugin::read_only_threads_enabled() const {
+   return my->read_only_threads > 0;
+}
+
+void chain_plugin::post_read_only( std::function<void()> task ) {
+   std::lock_guard<std::mutex> g( my->read_only_mtx );
+   my->read_only_queue.emplace_back( std::move( task ) );
+   if( !my->read_only_window_posted ) {
+      my->read_only_window_posted = true;
+      static auto& origin = app_thread_stats::origin( "chain:read_only_window", priority::medium_low );
+      app_thread_post( origin, [this]() {
+         my->execute_read_only_window();
+      } );
+   }
+}
+
+void chain_plugin_impl::schedule_replica_refresh() {
+   replica_refresh_timer->expires_from_now( replica_refresh_interval );
+   replica_refresh_timer->async_wait( app().get_priority_queue().wrap( priority::high, [this]( const boost::system::error_code& ec ) {
+      if( ec == boost::asio::error::operation_aborted || !chain )
+         return;
+      try {
+         chain->refresh_replica_head();
+      } FC_LOG_AND_DROP()
+      schedule_replica_refresh();
+   } ) );
+}
+
+// Runs on the main thread. Every read-only call queued so far is executed on the read-only thread pool while the
+// main thread waits, so no block or transaction can modify chainbase under them and all of them observe the same state.
+void chain_plugin_impl::execute_read_only_window() {
+   std::deque<std::function<void()>> tasks;
+   {
+      std::lock_guard<std::mutex> g( read_only_mtx );
+      tasks.swap( read_only_queue );
+      read_only_window_posted = false;
+   }
+   if( !read_only_thread_pool ) { // shutting down, run what is left in place
+      for( auto& t : tasks ) t();
+      return;
+   }
+
+   std::vector<std::future<void>> futures;
+   futures.reserve( tasks.size() );
+   for( auto& t : tasks ) {
+      futures.emplace_back( async_thread_pool( read_only_thread_pool->get_executor(), std::move( t ) ) );
+   }
+   for( auto& f : futures ) {
+      try {
+         f.get();
+      } FC_LOG_AND_DROP()
+   }
+}
+
+#ifdef __linux__
+namespace {
+   // page aligned extent of the mapped state database
+   std::pair<char*, size_t> db_mapping( const controller& chain ) {
+      const auto* sm = chain.db().get_segment_manager();
+      const auto page = static_cast<uintptr_t>( sysconf( _SC_PAGESIZE ) );
+      auto begin = reinterpret_cast<uintptr_t>( sm ) & ~(page - 1);
+      auto end   = reinterpret_cast<uintptr_t>( sm ) + sm->get_size();
+      return { reinterpret_cast<char*>( begin ), end - begin };
+   }
+
+   /// nodes listed in /sys/devices/system/node/online, e.g. "0-1,3", as an mbind node mask
+   std::vector<unsigned long> online_numa_nodes( size_t& count ) {
+      std::vector<unsigned long> mask;
+      count = 0;
+      std::ifstream in( "/sys/devices/system/node/online" );
+      std::string list;
+      if( !std::getline( in, list ) )
+         return mask;
+      std::vector<std::string> ranges;
+      boost::split( ranges, list, boost::is_any_of( "," ) );
+      constexpr size_t bits = sizeof(unsigned long) * 8;
+      for( const auto& r : ranges ) {
+         if( r.empty() ) continue;
+         auto dash = r.find( '-' );
+         auto first = std::stoul( r.substr( 0, dash ) );
+         auto last  = dash == std::string::npos ? first : std::stoul( r.substr( dash + 1 ) );
+         for( auto n = first; n <= last; ++n ) {
+            if( mask.size() <= n / bits ) mask.resize( n / bits + 1 );
+            mask[n / bits] |= 1ul << (n % bits);
+            ++count;
+         }
+      }
+      return mask;
+   }
+}
+#endif
+
+void chain_plugin_impl::apply_db_numa_policy() {
+#ifdef __linux__
+   if( db_numa_policy == "none" )
+      return;
+   if( chain_config->db_map_mode == pinnable_mapped_file::map_mode::mapped ) {
+      wlog( "database-numa-policy only applies to the \"heap\" and \"locked\" database map modes, ignored" );
+      return;
+   }
+   size_t nodes = 0;
+   auto mask = online_numa_nodes( nodes );
+   if( nodes < 2 ) {
+      ilog( "single NUMA node, database-numa-policy ${p} has no effect", ("p", db_numa_policy) );
+      return;
+   }
+   constexpr int mpol_interleave = 3;    // MPOL_INTERLEAVE, <numaif.h> is part of libnuma and not required
+   constexpr unsigned mpol_mf_move = 2;  // MPOL_MF_MOVE
+   auto [addr, len] = db_mapping( *chain );
+   if( syscall( SYS_mbind, addr, len, mpol_interleave, mask.data(), mask.size() * sizeof(unsigned long) * 8 + 1,
+                mpol_mf_move ) != 0 ) {
+      wlog( "unable to interleave the database across ${n} NUMA nodes: ${e}", ("n", nodes)("e", strerror( errno )) );
+      return;
+   }
+   ilog( "database interleaved across ${n} NUMA nodes", ("n", nodes) );
+#endif
+}
+
+// Faults the mapping in chunks so that it can be stopped promptly on shutdown. MADV_POPULATE_READ (linux 5.14) reads
+// the pages in without copying them; older kernels fall back to touching a byte of every page. Read faults never
+// dirty a page, so warming a "mapped" database does not cause writeback.
+void chain_plugin_impl::start_db_warmup() {
+#ifdef __linux__
+   if( !db_warmup )
+      return;
+   auto [addr, len] = db_mapping( *chain );
+   db_warmup_stop = false;
+   db_warmup_thread = std::thread( [this, addr = addr, len = len]() {
+      fc::set_os_thread_name( "chain_warmup" );
+      constexpr size_t chunk = 64 * 1024 * 1024;
+      constexpr int madv_populate_read = 22; // MADV_POPULATE_READ, missing from older headers
+      const size_t page = sysconf( _SC_PAGESIZE );
+      const auto start = fc::time_point::now();
+      bool populate = true;
+      size_t done = 0;
+      uint32_t reported = 0;
+      ilog( "warming up ${mb} MiB of database", ("mb", len / (1024 * 1024)) );
+      while( done < len && !db_warmup_stop ) {
+         const size_t n = std::min( chunk, len - done );
+         if( !populate || madvise( addr + done, n, madv_populate_read ) != 0 ) {
+            populate = false;
+            for( size_t off = 0; off < n; off += page )
+               (void)*static_cast<volatile const char*>( addr + done + off );
+         }
+         done += n;
+         const uint32_t pct = done * 100 / len;
+         if( pct / 10 > reported / 10 ) {
+            reported = pct;
+            ilog( "database warm-up ${pct}% (${mb} MiB)", ("pct", pct)("mb", done / (1024 * 1024)) );
+         }
+      }
+      if( done == len )
+         ilog( "database warm-up finished in ${s} seconds", ("s", (fc::time_point::now() - start).count() / 1000000) );
+   } );
+#endif
+}
+
+void chain_plugin_impl::stop_db_warmup() {
+   db_warmup_stop = true;
+   if( db_warmup_thread.joinable() )
+      db_warmup_thread.join();
+}
+
 chain_apis::read_write::read_write(controller& db, const fc::microseconds& abi_serializer_max_time, bool api_accept_transactions)
 : db(db)
 , abi_serializer_max_time(abi_serializer_max_time)
@@ -1385,6 +2041,10 @@ chain::chain_id_type chain_plugin::get_chain_id()const {
    return my->chain->get_chain_id();
 }
 
+chain_apis::read_only chain_plugin::get_read_only_api() const {
+   return chain_apis::read_only( chain(), get_abi_serializer_max_time(), my->abis_cache, my->rows_cache, my->account_rows_cache );
+}
+
 fc::microseconds chain_plugin::get_abi_serializer_max_time() const {
    return my->abi_serializer_max_time_us;
 }
@@ -1398,7 +2058,8 @@ bool chain_plugin::accept_transactions() const {
 }
 
 void chain_plugin::enable_accept_transactions() {
-   my->accept_transactions = true;
+   if( !my->transactions_disabled )
+      my->accept_transactions = true;
 }
 
 
@@ -1673,6 +2334,76 @@ abi_def get_abi( const controller& db, const name& account ) {
    return abi;
 }
 
+abi_cache::entry_ptr abi_cache::get( const controller& db, const name& account, const fc::microseconds& abi_serializer_max_time ) {
+   const auto* code_accnt = db.db().find<account_object, by_name>( account );
+   EOS_ASSERT( code_accnt != nullptr, chain::account_query_exception, "Fail to retrieve account for ${account}", ("account", account) );
+   const auto& raw = code_accnt->abi;
+   auto matches = [&raw]( const cached& c ) {
+      return c.raw_abi.size() == raw.size() && std::equal( c.raw_abi.begin(), c.raw_abi.end(), raw.data() );
+   };
+
+   {
+      std::lock_guard<std::mutex> g( mtx );
+      auto itr = entries.find( account );
+      if( itr != entries.end() && matches( itr->second ) ) {
+         by_recency.splice( by_recency.begin(), by_recency, itr->second.recency );
+         return itr->second.value;
+      }
+   }
+
+   // build outside the lock, concurrent misses on the same account just race to insert equivalent entries
+   abi_def abi;
+   abi_serializer::to_abi( raw, abi );
+   auto value = std::make_shared<const entry>( std::move(abi), abi_serializer::create_yield_function( abi_serializer_max_time ) );
+
+   std::lock_guard<std::mutex> g( mtx );
+   auto itr = entries.find( account );
+   if( itr == entries.end() ) {
+      if( entries.size() >= max_entries && !by_recency.empty() ) {
+         entries.erase( by_recency.back() );
+         by_recency.pop_back();
+      }
+      by_recency.push_front( account );
+      itr = entries.emplace( account, cached{ {}, {}, by_recency.begin() } ).first;
+   } else {
+      by_recency.splice( by_recency.begin(), by_recency, itr->second.recency );
+   }
+   itr->second.raw_abi.assign( raw.data(), raw.data() + raw.size() );
+   itr->second.value = value;
+   return value;
+}
+
+fc::variant decoded_row_cache::get( const abi_cache::entry_ptr& abi_entry, const name& code, const name& scope, const name& table,
+                                    uint64_t primary_key, const std::vector<char>& data,
+                                    const fc::microseconds& abi_serializer_max_time, bool shorten_abi_errors, const string& row_type ) {
+   const auto key = std::make_tuple( code, scope, table, primary_key );
+   {
+      std::lock_guard<std::mutex> g( mtx );
+      auto itr = entries.find( key );
+      if( itr != entries.end() && itr->second.abi == abi_entry && itr->second.raw == data )
+         return itr->second.value;
+   }
+
+   // decode outside the lock, as abi_cache::get builds its entries
+   const auto& abis = abi_entry->serializer;
+   cached c{ abi_entry, data, abis.binary_to_variant( row_type.empty() ? abis.get_table_type( table ) : row_type, data,
+                                                   abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors ) };
+   auto value = c.value;
+
+   std::lock_guard<std::mutex> g( mtx );
+   auto itr = entries.find( key );
+   if( itr == entries.end() && entries.size() >= max_entries )
+      entries.erase( entries.begin() );
+   entries[key] = std::move( c );
+   return value;
+}
+
+abi_cache::entry_ptr read_only::get_abi_entry( const name& account )const {
+   if( abis_cache )
+      return abis_cache->get( db, account, abi_serializer_max_time );
+   return std::make_shared<const abi_cache::entry>( get_abi( db, account ), abi_serializer::create_yield_function( abi_serializer_max_time ) );
+}
+
 string get_table_type( const abi_def& abi, const name& table_name ) {
    for( const auto& t : abi.tables ) {
       if( t.name == table_name ){
@@ -1682,8 +2413,9 @@ string get_table_type( const abi_def& abi, const name& table_name ) {
    EOS_ASSERT( false, chain::contract_table_query_exception, "Table ${table} is not specified in the ABI", ("table",table_name) );
 }
 
-read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p )const {
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
+read_only::get_table_rows_result read_only::get_table_rows_impl( const read_only::get_table_rows_params& p, table_row_format format )const {
+   const auto abi_entry = get_abi_entry( p.code );
+   const abi_def& abi = abi_entry->abi;
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wstrict-aliasing"
    bool primary = false;
@@ -1692,43 +2424,43 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
       EOS_ASSERT( p.table == table_with_index, chain::contract_table_query_exception, "Invalid table name ${t}", ( "t", p.table ));
       auto table_type = get_table_type( abi, p.table );
       if( table_type == KEYi64 || p.key_type == "i64" || p.key_type == "name" ) {
-         return get_table_rows_ex<key_value_index>(p,abi);
+         return get_table_rows_ex<key_value_index>(p, *abi_entry, format);
       }
       EOS_ASSERT( false, chain::contract_table_query_exception,  "Invalid table type ${type}", ("type",table_type)("abi",abi));
    } else {
       EOS_ASSERT( !p.key_type.empty(), chain::contract_table_query_exception, "key type required for non-primary index" );
 
       if (p.key_type == chain_apis::i64 || p.key_type == "name") {
-         return get_table_rows_by_seckey<index64_index, uint64_t>(p, abi, [](uint64_t v)->uint64_t {
+         return get_table_rows_by_seckey<index64_index, uint64_t>(p, *abi_entry, format, [](uint64_t v)->uint64_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i128) {
-         return get_table_rows_by_seckey<index128_index, uint128_t>(p, abi, [](uint128_t v)->uint128_t {
+         return get_table_rows_by_seckey<index128_index, uint128_t>(p, *abi_entry, format, [](uint128_t v)->uint128_t {
             return v;
          });
       }
       else if (p.key_type == chain_apis::i256) {
          if ( p.encode_type == chain_apis::hex) {
             using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+            return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *abi_entry, format, conv::function());
          }
          using  conv = keytype_converter<chain_apis::i256>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *abi_entry, format, conv::function());
       }
       else if (p.key_type == chain_apis::float64) {
-         return get_table_rows_by_seckey<index_double_index, double>(p, abi, [](double v)->float64_t {
+         return get_table_rows_by_seckey<index_double_index, double>(p, *abi_entry, format, [](double v)->float64_t {
             float64_t f = *(float64_t *)&v;
             return f;
          });
       }
       else if (p.key_type == chain_apis::float128) {
          if ( p.encode_type == chain_apis::hex) {
-            return get_table_rows_by_seckey<index_long_double_index, uint128_t>(p, abi, [](uint128_t v)->float128_t{
+            return get_table_rows_by_seckey<index_long_double_index, uint128_t>(p, *abi_entry, format, [](uint128_t v)->float128_t{
                return *reinterpret_cast<float128_t *>(&v);
             });
          }
-         return get_table_rows_by_seckey<index_long_double_index, double>(p, abi, [](double v)->float128_t{
+         return get_table_rows_by_seckey<index_long_double_index, double>(p, *abi_entry, format, [](double v)->float128_t{
             float64_t f = *(float64_t *)&v;
             float128_t f128;
             f64_to_f128M(f, &f128);
@@ -1737,17 +2469,115 @@ read_only::get_table_rows_result read_only::get_table_rows( const read_only::get
       }
       else if (p.key_type == chain_apis::sha256) {
          using  conv = keytype_converter<chain_apis::sha256,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *abi_entry, format, conv::function());
       }
       else if(p.key_type == chain_apis::ripemd160) {
          using  conv = keytype_converter<chain_apis::ripemd160,chain_apis::hex>;
-         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, abi, conv::function());
+         return get_table_rows_by_seckey<conv::index_type, conv::input_type>(p, *abi_entry, format, conv::function());
       }
       EOS_ASSERT(false, chain::contract_table_query_exception,  "Unsupported secondary index type: ${t}", ("t", p.key_type));
    }
 #pragma GCC diagnostic pop
 }
 
+read_only::get_table_rows_result read_only::get_table_rows( const read_only::get_table_rows_params& p )const {
+   return get_table_rows_impl( p, table_row_format::variant );
+}
+
+string read_only::get_table_rows_json( const read_only::get_table_rows_params& p )const {
+   const auto result = get_table_rows_impl( p, table_row_format::json );
+   size_t size = 64 + result.next_key.size();
+   for( const auto& r : result.json_rows )
+      size += r.size() + 1;
+
+   string json;
+   json.reserve( size );
+   json += "{\"rows\":[";
+   for( size_t i = 0; i < result.json_rows.size(); ++i ) {
+      if( i ) json += ',';
+      json += result.json_rows[i];
+   }
+   json += "],\"more\":";
+   json += result.more ? "true" : "false";
+   json += ",\"next_key\":";
+   json += fc::json::to_string( fc::variant( result.next_key ), fc::time_point::maximum() );
+   json += ",\"next_cursor\":";
+   json += fc::json::to_string( fc::variant( result.next_cursor ), fc::time_point::maximum() );
+   json += '}';
+   return json;
+}
+
+string read_only::encode_table_cursor( const read_only::get_table_rows_params& p, uint64_t scope, uint64_t index,
+                                       const char* secondary_key, size_t secondary_key_size, uint64_t primary_key )const {
+   table_rows_cursor c;
+   c.code           = p.code;
+   c.scope          = scope;
+   c.index          = index;
+   c.reverse        = p.reverse && *p.reverse;
+   c.secondary_key.assign( secondary_key, secondary_key + secondary_key_size );
+   c.primary_key    = primary_key;
+   c.head_block_num = db.head_block_num();
+   const auto packed = fc::raw::pack( c );
+   return fc::to_hex( packed.data(), packed.size() );
+}
+
+read_only::table_rows_cursor read_only::decode_table_cursor( const read_only::get_table_rows_params& p, uint64_t scope, uint64_t index )const {
+   table_rows_cursor c;
+   try {
+      vector<char> packed( p.cursor->size() / 2 );
+      EOS_ASSERT( fc::from_hex( *p.cursor, packed.data(), packed.size() ) == packed.size(), chain::contract_table_query_exception, "Invalid cursor" );
+      fc::raw::unpack( packed, c );
+   } EOS_RETHROW_EXCEPTIONS( chain::contract_table_query_exception, "Invalid cursor: ${c}", ("c", *p.cursor) )
+   EOS_ASSERT( c.code == p.code && c.scope == scope && c.index == index && c.reverse == (p.reverse && *p.reverse),
+               chain::contract_table_query_exception, "Cursor was issued for a different query" );
+   return c;
+}
+
+string read_only::get_table_rows_binary( const read_only::get_table_rows_params& p )const {
+   auto result = get_table_rows_impl( p, table_row_format::binary );
+   get_table_rows_binary_result bin{ std::move(result.binary_rows), result.more, std::move(result.next_key), std::move(result.next_cursor) };
+   const auto packed = fc::raw::pack( bin );
+   return string( packed.begin(), packed.end() );
+}
+
+void read_only::add_table_row( get_table_rows_result& result, const get_table_rows_params& p, const abi_serializer& abis,
+                               const vector<char>& data, uint64_t primary_key, const name& payer, table_row_format format )const {
+   if( format == table_row_format::binary ) {
+      result.binary_rows.emplace_back( binary_table_row{ primary_key, payer, data } );
+      return;
+   }
+   const bool show_payer = p.show_payer && *p.show_payer;
+   if( format == table_row_format::json ) {
+      string row;
+      if( show_payer ) row += "{\"data\":";
+      if( p.json ) {
+         abis.binary_to_json( abis.get_table_type(p.table), data, row, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+      } else {
+         row += fc::json::to_string( fc::variant( data ), fc::time_point::maximum() );
+      }
+      if( show_payer ) {
+         row += ",\"payer\":";
+         row += fc::json::to_string( fc::variant( payer ), fc::time_point::maximum() );
+         row += '}';
+      }
+      result.json_rows.emplace_back( std::move(row) );
+      return;
+   }
+
+   fc::variant data_var;
+   if( p.json ) {
+      data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+   } else {
+      data_var = fc::variant( data );
+   }
+
+   if( show_payer ) {
+      result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", payer) );
+   } else {
+      result.rows.emplace_back( std::move(data_var) );
+   }
+}
+
 read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_only::get_table_by_scope_params& p )const {
    read_only::get_table_by_scope_result result;
    const auto& d = db.db();
@@ -1798,8 +2628,7 @@ read_only::get_table_by_scope_result read_only::get_table_by_scope( const read_o
 
 vector<asset> read_only::get_currency_balance( const read_only::get_currency_balance_params& p )const {
 
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
-   (void)get_table_type( abi, name("accounts") );
+   (void)get_table_type( get_abi_entry( p.code )->abi, name("accounts") );
 
    vector<asset> results;
    walk_key_value_table(p.code, p.account, N(accounts), [&](const key_value_object& obj){
@@ -1825,8 +2654,7 @@ vector<asset> read_only::get_currency_balance( const read_only::get_currency_bal
 fc::variant read_only::get_currency_stats( const read_only::get_currency_stats_params& p )const {
    fc::mutable_variant_object results;
 
-   const abi_def abi = eosio::chain_apis::get_abi( db, p.code );
-   (void)get_table_type( abi, name("stat") );
+   (void)get_table_type( get_abi_entry( p.code )->abi, name("stat") );
 
    uint64_t scope = ( eosio::chain::string_to_symbol( 0, boost::algorithm::to_upper_copy(p.symbol).c_str() ) >> 8 );
 
@@ -1847,7 +2675,10 @@ fc::variant read_only::get_currency_stats( const read_only::get_currency_stats_p
    return results;
 }
 
-fc::variant get_global_row( const database& db, const abi_def& abi, const abi_serializer& abis, const fc::microseconds& abi_serializer_max_time_us, bool shorten_abi_errors ) {
+fc::variant get_global_row( const database& db, const abi_cache::entry_ptr& abi_entry, decoded_row_cache* rows_cache,
+                            const fc::microseconds& abi_serializer_max_time_us, bool shorten_abi_errors ) {
+   const abi_def& abi = abi_entry->abi;
+   const abi_serializer& abis = abi_entry->serializer;
    const auto table_type = get_table_type(abi, N(global));
    EOS_ASSERT(table_type == read_only::KEYi64, chain::contract_table_query_exception, "Invalid table type ${type} for table global", ("type",table_type));
 
@@ -1860,13 +2691,17 @@ fc::variant get_global_row( const database& db, const abi_def& abi, const abi_se
 
    vector<char> data;
    read_only::copy_inline_row(*it, data);
+   if( rows_cache )
+      return rows_cache->get( abi_entry, config::system_account_name, config::system_account_name, N(global), N(global).to_uint64_t(),
+                              data, abi_serializer_max_time_us, shorten_abi_errors );
    return abis.binary_to_variant(abis.get_table_type(N(global)), data, abi_serializer::create_yield_function( abi_serializer_max_time_us ), shorten_abi_errors );
 }
 
 read_only::get_producers_result read_only::get_producers( const read_only::get_producers_params& p ) const try {
-   const abi_def abi = eosio::chain_apis::get_abi(db, config::system_account_name);
+   const auto abi_entry = get_abi_entry( config::system_account_name );
+   const abi_def& abi = abi_entry->abi;
    const auto table_type = get_table_type(abi, N(producers));
-   const abi_serializer abis{ abi, abi_serializer::create_yield_function( abi_serializer_max_time ) };
+   const abi_serializer& abis = abi_entry->serializer;
    EOS_ASSERT(table_type == KEYi64, chain::contract_table_query_exception, "Invalid table type ${type} for table producers", ("type",table_type));
 
    const auto& d = db.db();
@@ -1904,13 +2739,16 @@ read_only::get_producers_result read_only::get_producers( const read_only::get_p
          break;
       }
       copy_inline_row(*kv_index.find(boost::make_tuple(table_id->id, it->primary_key)), data);
-      if (p.json)
+      if (p.json && rows_cache)
+         result.rows.emplace_back( rows_cache->get( abi_entry, config::system_account_name, config::system_account_name, N(producers),
+                                                    it->primary_key, data, abi_serializer_max_time, shorten_abi_errors ) );
+      else if (p.json)
          result.rows.emplace_back( abis.binary_to_variant( abis.get_table_type(N(producers)), data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors ) );
       else
          result.rows.emplace_back(fc::variant(data));
    }
 
-   result.total_producer_vote_weight = get_global_row(d, abi, abis, abi_serializer_max_time, shorten_abi_errors)["total_producer_vote_weight"].as_double();
+   result.total_producer_vote_weight = get_global_row(d, abi_entry, rows_cache.get(), abi_serializer_max_time, shorten_abi_errors)["total_producer_vote_weight"].as_double();
    return result;
 } catch (...) {
    read_only::get_producers_result result;
@@ -2043,7 +2881,7 @@ read_only::get_scheduled_transactions( const read_only::get_scheduled_transactio
    return result;
 }
 
-fc::variant read_only::get_block(const read_only::get_block_params& params) const {
+signed_block_ptr read_only::fetch_block(const read_only::get_block_params& params) const {
    signed_block_ptr block;
    optional<uint64_t> block_num;
 
@@ -2065,10 +2903,47 @@ fc::variant read_only::get_block(const read_only::get_block_params& params) cons
    }
 
    EOS_ASSERT( block, unknown_block_exception, "Could not find block: ${block}", ("block", params.block_num_or_id));
+   return block;
+}
+
+fc::variant read_only::get_block(const read_only::get_block_params& params) const {
+   const auto block = fetch_block( params );
+   const auto yield = abi_serializer::create_yield_function( abi_serializer_max_time );
 
    fc::variant pretty_output;
-   abi_serializer::to_variant(*block, pretty_output, make_resolver(this, abi_serializer::create_yield_function( abi_serializer_max_time )),
-                              abi_serializer::create_yield_function( abi_serializer_max_time ));
+   if( !parallel_for || block->transactions.size() < 2 ) {
+      abi_serializer::to_variant(*block, pretty_output, make_resolver(this, yield), yield);
+   } else {
+      // every abi is resolved here, where chainbase may be read, and then only read by the threads decoding actions
+      std::map<account_name, optional<abi_serializer>> abis;
+      auto resolver = make_resolver(this, yield);
+      for( const auto& receipt : block->transactions ) {
+         if( !receipt.trx.contains<packed_transaction>() )
+            continue;
+         const auto& trx = receipt.trx.get<packed_transaction>().get_transaction();
+         for( const auto* actions : { &trx.context_free_actions, &trx.actions } ) {
+            for( const auto& a : *actions ) {
+               if( !abis.count( a.account ) )
+                  abis.emplace( a.account, resolver( a.account ) );
+            }
+         }
+      }
+      const auto resolved = [&abis]( const account_name& account ) -> const optional<abi_serializer>& {
+         return abis.at( account );
+      };
+
+      // the header and extensions as usual, then the transactions decoded side by side in place of the empty list
+      signed_block header_only;
+      static_cast<signed_block_header&>(header_only) = *block;
+      header_only.block_extensions = block->block_extensions;
+      abi_serializer::to_variant(header_only, pretty_output, resolved, yield);
+
+      fc::variants transactions( block->transactions.size() );
+      parallel_for( transactions.size(), [&]( size_t i ) {
+         abi_serializer::to_variant(block->transactions[i], transactions[i], resolved, yield);
+      } );
+      pretty_output = fc::mutable_variant_object(pretty_output.get_object())("transactions", std::move(transactions));
+   }
 
    uint32_t ref_block_prefix = block->id()._hash[1];
 
@@ -2078,7 +2953,12 @@ fc::variant read_only::get_block(const read_only::get_block_params& params) cons
            ("ref_block_prefix", ref_block_prefix);
 }
 
-fc::variant read_only::get_block_header_state(const get_block_header_state_params& params) const {
+string read_only::get_block_binary(const read_only::get_block_params& params) const {
+   const auto packed = fc::raw::pack( *fetch_block( params ) );
+   return string( packed.begin(), packed.end() );
+}
+
+block_state_ptr read_only::fetch_block_state(const get_block_header_state_params& params) const {
    block_state_ptr b;
    optional<uint64_t> block_num;
    std::exception_ptr e;
@@ -2095,12 +2975,22 @@ fc::variant read_only::get_block_header_state(const get_block_header_state_param
    }
 
    EOS_ASSERT( b, unknown_block_exception, "Could not find reversible block: ${block}", ("block", params.block_num_or_id));
+   return b;
+}
+
+fc::variant read_only::get_block_header_state(const get_block_header_state_params& params) const {
+   const auto b = fetch_block_state( params );
 
    fc::variant vo;
    fc::to_variant( static_cast<const block_header_state&>(*b), vo );
    return vo;
 }
 
+string read_only::get_block_header_state_binary(const get_block_header_state_params& params) const {
+   const auto packed = fc::raw::pack( static_cast<const block_header_state&>(*fetch_block_state( params )) );
+   return string( packed.begin(), packed.end() );
+}
+
 void read_write::push_block(read_write::push_block_params&& params, next_function<read_write::push_block_results> next) {
    try {
       app().get_method<incoming::methods::block_sync>()(std::make_shared<signed_block>(std::move(params)), {});
@@ -2112,15 +3002,28 @@ void read_write::push_block(read_write::push_block_params&& params, next_functio
    } CATCH_AND_CALL(next);
 }
 
+packed_transaction_ptr read_write::to_packed_transaction(const read_write::push_transaction_params& params) const {
+   auto pretty_input = std::make_shared<packed_transaction>();
+   auto resolver = make_resolver(this, abi_serializer::create_yield_function( abi_serializer_max_time ));
+   try {
+      abi_serializer::from_variant(params, *pretty_input, std::move( resolver ), abi_serializer::create_yield_function( abi_serializer_max_time ));
+   } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+   return pretty_input;
+}
+
 void read_write::push_transaction(const read_write::push_transaction_params& params, next_function<read_write::push_transaction_results> next) {
    try {
-      auto pretty_input = std::make_shared<packed_transaction>();
-      auto resolver = make_resolver(this, abi_serializer::create_yield_function( abi_serializer_max_time ));
-      try {
-         abi_serializer::from_variant(params, *pretty_input, std::move( resolver ), abi_serializer::create_yield_function( abi_serializer_max_time ));
-      } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+      push_transaction(to_packed_transaction(params), std::move(next));
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
 
-      app().get_method<incoming::methods::transaction_async>()(pretty_input, true,
+void read_write::push_transaction(const packed_transaction_ptr& trx, next_function<read_write::push_transaction_results> next) {
+   try {
+      app().get_method<incoming::methods::transaction_async>()(trx, true,
             [this, next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
          if (result.contains<fc::exception_ptr>()) {
             next(result.get<fc::exception_ptr>());
@@ -2231,15 +3134,18 @@ void read_write::push_transactions(const read_write::push_transactions_params& p
 }
 
 void read_write::send_transaction(const read_write::send_transaction_params& params, next_function<read_write::send_transaction_results> next) {
-
    try {
-      auto pretty_input = std::make_shared<packed_transaction>();
-      auto resolver = make_resolver(this, abi_serializer::create_yield_function( abi_serializer_max_time ));
-      try {
-         abi_serializer::from_variant(params, *pretty_input, resolver, abi_serializer::create_yield_function( abi_serializer_max_time ));
-      } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+      send_transaction(to_packed_transaction(params), std::move(next));
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
 
-      app().get_method<incoming::methods::transaction_async>()(pretty_input, true,
+void read_write::send_transaction(const packed_transaction_ptr& trx, next_function<read_write::send_transaction_results> next) {
+   try {
+      app().get_method<incoming::methods::transaction_async>()(trx, true,
             [this, next](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result) -> void {
          if (result.contains<fc::exception_ptr>()) {
             next(result.get<fc::exception_ptr>());
@@ -2266,6 +3172,37 @@ void read_write::send_transaction(const read_write::send_transaction_params& par
    } CATCH_AND_CALL(next);
 }
 
+void read_write::push_ro_transaction(const read_write::push_ro_transaction_params& params, next_function<read_write::push_ro_transaction_results> next) {
+   try {
+      packed_transaction pretty_input;
+      auto resolver = make_resolver(this, abi_serializer::create_yield_function( abi_serializer_max_time ));
+      try {
+         abi_serializer::from_variant(params, pretty_input, resolver, abi_serializer::create_yield_function( abi_serializer_max_time ));
+      } EOS_RETHROW_EXCEPTIONS(chain::packed_transaction_type_exception, "Invalid packed transaction")
+
+      EOS_ASSERT( db.is_building_block(), missing_pending_block_state, "No pending block to execute read-only transaction against" );
+
+      auto trx_meta = transaction_metadata::create_no_recover_keys( pretty_input, transaction_metadata::trx_type::read_only );
+      const auto& cfg = db.get_global_properties().configuration;
+      auto deadline = fc::time_point::now() + fc::microseconds( cfg.max_transaction_cpu_usage );
+      auto trx_trace_ptr = db.push_transaction( trx_meta, deadline, 0, false );
+
+      fc::variant output;
+      try {
+         output = db.to_variant_with_abi( *trx_trace_ptr, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+      } catch( chain::abi_exception& ) {
+         output = *trx_trace_ptr;
+      }
+
+      const chain::transaction_id_type& id = trx_trace_ptr->id;
+      next(read_write::push_ro_transaction_results{id, output});
+   } catch ( boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch ( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } CATCH_AND_CALL(next);
+}
+
 read_only::get_abi_results read_only::get_abi( const get_abi_params& params )const {
    get_abi_results result;
    result.account_name = params.account_name;
@@ -2291,7 +3228,7 @@ read_only::get_code_results read_only::get_code( const get_code_params& params )
 
    if( accnt_metadata_obj.code_hash != digest_type() ) {
       const auto& code_obj = d.get<code_object, by_code_hash>(accnt_metadata_obj.code_hash);
-      result.wasm = string(code_obj.code.begin(), code_obj.code.end());
+      result.wasm = code_obj.with_code([](std::string_view wasm) { return string(wasm); });
       result.code_hash = code_obj.code_hash;
    }
 
@@ -2324,7 +3261,7 @@ read_only::get_raw_code_and_abi_results read_only::get_raw_code_and_abi( const g
    const auto& accnt_metadata_obj = d.get<account_metadata_object,by_name>(params.account_name);
    if( accnt_metadata_obj.code_hash != digest_type() ) {
       const auto& code_obj = d.get<code_object, by_code_hash>(accnt_metadata_obj.code_hash);
-      result.wasm = blob{{code_obj.code.begin(), code_obj.code.end()}};
+      result.wasm = code_obj.with_code([](std::string_view wasm) { return blob{{wasm.begin(), wasm.end()}}; });
    }
    result.abi = blob{{accnt_obj.abi.begin(), accnt_obj.abi.end()}};
 
@@ -2347,6 +3284,11 @@ read_only::get_raw_abi_results read_only::get_raw_abi( const get_raw_abi_params&
    return result;
 }
 
+string read_only::get_raw_abi_binary( const get_raw_abi_params& params )const {
+   const auto packed = fc::raw::pack( get_raw_abi( params ) );
+   return string( packed.begin(), packed.end() );
+}
+
 read_only::get_account_results read_only::get_account( const get_account_params& params )const {
    get_account_results result;
    result.account_name = params.account_name;
@@ -2392,9 +3334,18 @@ read_only::get_account_results read_only::get_account( const get_account_params&
 
    const auto& code_account = db.db().get<account_object,by_name>( config::system_account_name );
 
-   abi_def abi;
-   if( abi_serializer::to_abi(code_account.abi, abi) ) {
-      abi_serializer abis( abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+   if( code_account.abi.size() > 0 ) {
+      // the resource limits above change with every block, the system contract rows below only when the account acts,
+      // so those are decoded again only when their raw bytes or the system contract ABI differ
+      const auto abi_entry = get_abi_entry( config::system_account_name );
+      auto decode_row = [&]( const chain::table_id_object& table, const key_value_object& row, const char* type ) {
+         vector<char> data;
+         copy_inline_row( row, data );
+         if( account_rows_cache )
+            return account_rows_cache->get( abi_entry, table.code, table.scope, table.table, row.primary_key, data,
+                                            abi_serializer_max_time, shorten_abi_errors, type );
+         return abi_entry->serializer.binary_to_variant( type, data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+      };
 
       const auto token_code = N(eosio.token);
 
@@ -2423,9 +3374,7 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
          auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
          if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.total_resources = abis.binary_to_variant( "user_resources", data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+            result.total_resources = decode_row( *t_id, *it, "user_resources" );
          }
       }
 
@@ -2434,9 +3383,7 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
          auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
          if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.self_delegated_bandwidth = abis.binary_to_variant( "delegated_bandwidth", data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+            result.self_delegated_bandwidth = decode_row( *t_id, *it, "delegated_bandwidth" );
          }
       }
 
@@ -2445,9 +3392,7 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
          auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
          if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.refund_request = abis.binary_to_variant( "refund_request", data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+            result.refund_request = decode_row( *t_id, *it, "refund_request" );
          }
       }
 
@@ -2456,9 +3401,7 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
          auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
          if ( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.voter_info = abis.binary_to_variant( "voter_info", data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+            result.voter_info = decode_row( *t_id, *it, "voter_info" );
          }
       }
 
@@ -2467,9 +3410,7 @@ read_only::get_account_results read_only::get_account( const get_account_params&
          const auto &idx = d.get_index<key_value_index, by_scope_primary>();
          auto it = idx.find(boost::make_tuple( t_id->id, params.account_name.to_uint64_t() ));
          if( it != idx.end() ) {
-            vector<char> data;
-            copy_inline_row(*it, data);
-            result.rex_info = abis.binary_to_variant( "rex_balance", data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
+            result.rex_info = decode_row( *t_id, *it, "rex_balance" );
          }
       }
    }
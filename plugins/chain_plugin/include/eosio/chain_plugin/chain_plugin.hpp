@@ -16,6 +16,12 @@
 #include <boost/container/flat_set.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 
+#include <algorithm>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+
 #include <fc/static_variant.hpp>
 
 namespace fc { class variant; }
@@ -76,20 +82,101 @@ template<>
 string convert_to_string(const float128_t& source, const string& key_type, const string& encode_type, const string& desc);
 
 
+/**
+ * Deserialized contract ABIs shared by read_only api instances, so table queries against hot contracts do not unpack
+ * the abi_def and rebuild an abi_serializer on every request. An entry is checked against the account's current raw
+ * ABI on every lookup, so a setabi (or a fork switch undoing one) is picked up by the next request. Safe to use from
+ * the read-only thread pool.
+ */
+class abi_cache {
+public:
+   struct entry {
+      entry( abi_def&& a, const abi_serializer::yield_function_t& yield )
+         : abi( std::move(a) ), serializer( abi, yield ) {}
+
+      abi_def        abi;
+      abi_serializer serializer;
+   };
+   using entry_ptr = std::shared_ptr<const entry>;
+
+   static constexpr size_t default_max_entries = 1024;
+
+   explicit abi_cache( size_t max_entries = default_max_entries ) : max_entries( max_entries ) {}
+
+   /// @throws account_query_exception if the account does not exist
+   entry_ptr get( const controller& db, const name& account, const fc::microseconds& abi_serializer_max_time );
+
+private:
+   struct cached {
+      std::vector<char>          raw_abi;
+      entry_ptr                  value;
+      std::list<name>::iterator  recency;
+   };
+
+   std::mutex             mtx;
+   std::map<name, cached> entries;
+   std::list<name>        by_recency; ///< most recently used first, the last is evicted when full
+   const size_t           max_entries;
+};
+
+/**
+ * Contract table rows decoded to variants, for get_producers which wallets and explorers call constantly against
+ * tables that change only as votes are cast. A row is decoded again only when its raw bytes or the ABI differ from
+ * those it was decoded with, so serving the top producers costs a comparison of raw bytes per row instead of an ABI
+ * decode. Safe to use from the read-only thread pool.
+ */
+class decoded_row_cache {
+public:
+   static constexpr size_t default_max_entries = 4096;
+
+   explicit decoded_row_cache( size_t max_entries = default_max_entries ) : max_entries( max_entries ) {}
+
+   /// data, the row of code's table in scope at primary_key, decoded with abi_entry as row_type, or as the type of table
+   /// when empty; decodes it on a miss
+   fc::variant get( const abi_cache::entry_ptr& abi_entry, const name& code, const name& scope, const name& table,
+                    uint64_t primary_key, const std::vector<char>& data,
+                    const fc::microseconds& abi_serializer_max_time, bool shorten_abi_errors, const string& row_type = string() );
+
+private:
+   struct cached {
+      abi_cache::entry_ptr abi;
+      std::vector<char>    raw;
+      fc::variant          value;
+   };
+
+   std::mutex                                               mtx;
+   std::map<std::tuple<name, name, name, uint64_t>, cached> entries; ///< by code, scope, table and primary key
+   const size_t                                             max_entries;
+};
+
 class read_only {
    const controller& db;
    const fc::microseconds abi_serializer_max_time;
    bool  shorten_abi_errors = true;
+   std::shared_ptr<abi_cache> abis_cache;
+   std::shared_ptr<decoded_row_cache> rows_cache;
+   std::shared_ptr<decoded_row_cache> account_rows_cache; ///< system contract rows of get_account, apart from rows_cache so lookups of many accounts do not evict the producers
+   std::function<void(size_t, const std::function<void(size_t)>&)> parallel_for;
+
+   abi_cache::entry_ptr get_abi_entry( const name& account )const;
 
 public:
    static const string KEYi64;
 
-   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time)
-      : db(db), abi_serializer_max_time(abi_serializer_max_time) {}
+   read_only(const controller& db, const fc::microseconds& abi_serializer_max_time, std::shared_ptr<abi_cache> abis_cache = {},
+             std::shared_ptr<decoded_row_cache> rows_cache = {}, std::shared_ptr<decoded_row_cache> account_rows_cache = {})
+      : db(db), abi_serializer_max_time(abi_serializer_max_time), abis_cache(std::move(abis_cache)), rows_cache(std::move(rows_cache)),
+        account_rows_cache(std::move(account_rows_cache)) {}
 
    void validate() const {}
 
+   /// runs read, a call of this api, through controller::read_state; every caller reading the state must go through here
+   template<typename F>
+   auto read_state( F&& read ) const { return db.read_state( std::forward<F>(read) ); }
+
    void set_shorten_abi_errors( bool f ) { shorten_abi_errors = f; }
+   /// fans out the decoding of the transactions of get_block, as http_plugin::parallel_for does; serial when unset
+   void set_parallel_for( std::function<void(size_t, const std::function<void(size_t)>&)> f ) { parallel_for = std::move( f ); }
 
    using get_info_params = empty;
 
@@ -232,6 +319,8 @@ public:
    get_abi_results get_abi( const get_abi_params& params )const;
    get_raw_code_and_abi_results get_raw_code_and_abi( const get_raw_code_and_abi_params& params)const;
    get_raw_abi_results get_raw_abi( const get_raw_abi_params& params)const;
+   /// fc::raw packed get_raw_abi_results
+   string get_raw_abi_binary( const get_raw_abi_params& params)const;
 
 
 
@@ -279,12 +368,16 @@ public:
    };
 
    fc::variant get_block(const get_block_params& params) const;
+   /// packed signed_block, as stored in the block log
+   string get_block_binary(const get_block_params& params) const;
 
    struct get_block_header_state_params {
       string block_num_or_id;
    };
 
    fc::variant get_block_header_state(const get_block_header_state_params& params) const;
+   /// packed block_header_state
+   string get_block_header_state_binary(const get_block_header_state_params& params) const;
 
    struct get_table_rows_params {
       bool        json = false;
@@ -300,15 +393,47 @@ public:
       string      encode_type{"dec"}; //dec, hex , default=dec
       optional<bool>  reverse;
       optional<bool>  show_payer; // show RAM pyer
+      optional<string> cursor; ///< next_cursor of the previous page, resumes right after it instead of at lower_bound (upper_bound when reverse)
     };
 
+   /// position of the next row of a get_table_rows query, handed to clients as an opaque hex next_cursor
+   struct table_rows_cursor {
+      name              code;
+      uint64_t          scope = 0;
+      uint64_t          index = 0; ///< table name of the index walked
+      bool              reverse = false;
+      vector<char>      secondary_key; ///< raw bytes of the secondary key, empty when walking the primary index
+      uint64_t          primary_key = 0;
+      uint32_t          head_block_num = 0; ///< head block when the cursor was issued
+   };
+
+   struct binary_table_row {
+      uint64_t            primary_key = 0;
+      name                payer;
+      vector<char>        data; ///< row bytes as stored by the contract
+   };
+
+   struct get_table_rows_binary_result {
+      vector<binary_table_row> rows;
+      bool                     more = false;
+      string                   next_key;
+      string                   next_cursor;
+   };
+
    struct get_table_rows_result {
       vector<fc::variant> rows; ///< one row per item, either encoded as hex String or JSON object
       bool                more = false; ///< true if last element in data is not the end and sizeof data() < limit
       string              next_key; ///< fill lower_bound with this value to fetch more rows
+      string              next_cursor; ///< pass as cursor to fetch more rows, exact even when secondary keys repeat
+      vector<string>      json_rows; ///< rows already rendered as JSON text, used instead of rows by get_table_rows_json
+      vector<binary_table_row> binary_rows; ///< used instead of rows by get_table_rows_binary
    };
 
    get_table_rows_result get_table_rows( const get_table_rows_params& params )const;
+   /// Same response as get_table_rows, but rendered straight to JSON text without building a variant per row
+   string get_table_rows_json( const get_table_rows_params& params )const;
+   /// fc::raw packed get_table_rows_binary_result; the json parameter is ignored
+   string get_table_rows_binary( const get_table_rows_params& params )const;
 
    struct get_table_by_scope_params {
       name        code; // mandatory
@@ -418,15 +543,24 @@ public:
 
    static uint64_t get_table_index_name(const read_only::get_table_rows_params& p, bool& primary);
 
+   enum class table_row_format { variant, json, binary };
+
+   get_table_rows_result get_table_rows_impl( const get_table_rows_params& p, table_row_format format )const;
+   void add_table_row( get_table_rows_result& result, const get_table_rows_params& p, const abi_serializer& abis,
+                       const vector<char>& data, uint64_t primary_key, const name& payer, table_row_format format )const;
+   string encode_table_cursor( const get_table_rows_params& p, uint64_t scope, uint64_t index,
+                               const char* secondary_key, size_t secondary_key_size, uint64_t primary_key )const;
+   /// @throws contract_table_query_exception if p.cursor is malformed or was issued for a different query
+   table_rows_cursor decode_table_cursor( const get_table_rows_params& p, uint64_t scope, uint64_t index )const;
+
    template <typename IndexType, typename SecKeyType, typename ConvFn>
-   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_def& abi, ConvFn conv )const {
+   read_only::get_table_rows_result get_table_rows_by_seckey( const read_only::get_table_rows_params& p, const abi_cache::entry& abi_entry, table_row_format format, ConvFn conv )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       name scope{ convert_to_type<uint64_t>(p.scope, "scope") };
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+      const abi_serializer& abis = abi_entry.serializer;
       bool primary = false;
       const uint64_t table_with_index = get_table_index_name(p, primary);
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, scope, p.table));
@@ -465,36 +599,77 @@ public:
             }
          }
 
+         static_assert( std::is_trivially_copyable<secondary_key_type>::value, "secondary keys are stored in cursors as raw bytes" );
+         if( p.cursor && !p.cursor->empty() ) {
+            const auto c = decode_table_cursor( p, scope.to_uint64_t(), table_with_index );
+            EOS_ASSERT( c.secondary_key.size() == sizeof(secondary_key_type), chain::contract_table_query_exception, "Invalid cursor for key type ${t}", ("t", p.key_type) );
+            secondary_key_type k;
+            memcpy( &k, c.secondary_key.data(), sizeof(k) );
+            auto& bound = p.reverse && *p.reverse ? upper_bound_lookup_tuple : lower_bound_lookup_tuple;
+            std::get<1>(bound) = k;
+            std::get<2>(bound) = c.primary_key;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple )
             return result;
 
          auto walk_table_row_range = [&]( auto itr, auto end_itr ) {
             auto cur_time = fc::time_point::now();
             auto end_time = cur_time + fc::microseconds(1000 * 10); /// 10ms max time
-            vector<char> data;
-            for( unsigned int count = 0; cur_time <= end_time && count < p.limit && itr != end_itr; ++itr, cur_time = fc::time_point::now() ) {
-               const auto* itr2 = d.find<chain::key_value_object, chain::by_scope_primary>( boost::make_tuple(t_id->id, itr->primary_key) );
-               if( itr2 == nullptr ) continue;
-               copy_inline_row(*itr2, data);
-
-               fc::variant data_var;
-               if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
-               } else {
-                  data_var = fc::variant( data );
-               }
-
-               if( p.show_payer && *p.show_payer ) {
-                  result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", itr->payer) );
-               } else {
-                  result.rows.emplace_back( std::move(data_var) );
-               }
 
-               ++count;
+            // collect the page from the secondary index first
+            struct page_row {
+               secondary_key_type                secondary_key;
+               uint64_t                          primary_key;
+               account_name                      payer;
+               const chain::key_value_object*    row = nullptr;
+            };
+            auto set_next = [&]( const secondary_key_type& next_secondary, uint64_t next_primary ) {
+               result.more = true;
+               result.next_key = convert_to_string(next_secondary, p.key_type, p.encode_type, "next_key - next lower bound");
+               result.next_cursor = encode_table_cursor( p, scope.to_uint64_t(), table_with_index, reinterpret_cast<const char*>(&next_secondary),
+                                                         sizeof(next_secondary), next_primary );
+            };
+            vector<page_row> page;
+            page.reserve( std::min<uint32_t>( p.limit, 1024 ) );
+            for( ; cur_time <= end_time && page.size() < p.limit && itr != end_itr; ++itr, cur_time = fc::time_point::now() ) {
+               page.push_back( page_row{ itr->secondary_key, itr->primary_key, itr->payer } );
             }
             if( itr != end_itr ) {
-               result.more = true;
-               result.next_key = convert_to_string(itr->secondary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               set_next( itr->secondary_key, itr->primary_key );
+            }
+
+            // then resolve the primary rows in one ascending pass; nearby keys are reached by stepping the
+            // iterator instead of a fresh lookup
+            vector<page_row*> by_primary( page.size() );
+            std::transform( page.begin(), page.end(), by_primary.begin(), []( auto& r ) { return &r; } );
+            std::sort( by_primary.begin(), by_primary.end(), []( const page_row* a, const page_row* b ) { return a->primary_key < b->primary_key; } );
+            const auto& kv_idx = d.get_index<chain::key_value_index, chain::by_scope_primary>();
+            auto kv_itr = kv_idx.end();
+            for( auto* r : by_primary ) {
+               constexpr int max_steps = 8;
+               int steps = 0;
+               while( kv_itr != kv_idx.end() && kv_itr->t_id == t_id->id && kv_itr->primary_key < r->primary_key && steps++ < max_steps )
+                  ++kv_itr;
+               if( kv_itr == kv_idx.end() || kv_itr->t_id != t_id->id || kv_itr->primary_key < r->primary_key )
+                  kv_itr = kv_idx.lower_bound( boost::make_tuple( t_id->id, r->primary_key ) );
+               if( kv_itr != kv_idx.end() && kv_itr->t_id == t_id->id && kv_itr->primary_key == r->primary_key )
+                  r->row = &*kv_itr;
+            }
+
+            // finally decode in secondary index order, within the same deadline; at least one row is decoded so
+            // that a client following the cursor always makes progress
+            vector<char> data;
+            for( size_t i = 0; i < page.size(); ++i ) {
+               const auto& r = page[i];
+               if( i > 0 && fc::time_point::now() > end_time ) {
+                  set_next( r.secondary_key, r.primary_key );
+                  break;
+               }
+               if( r.row == nullptr ) continue;
+               copy_inline_row(*r.row, data);
+
+               add_table_row( result, p, abis, data, r.primary_key, r.payer, format );
             }
          };
 
@@ -510,14 +685,13 @@ public:
    }
 
    template <typename IndexType>
-   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const abi_def& abi )const {
+   read_only::get_table_rows_result get_table_rows_ex( const read_only::get_table_rows_params& p, const abi_cache::entry& abi_entry, table_row_format format )const {
       read_only::get_table_rows_result result;
       const auto& d = db.db();
 
       uint64_t scope = convert_to_type<uint64_t>(p.scope, "scope");
 
-      abi_serializer abis;
-      abis.set_abi(abi, abi_serializer::create_yield_function( abi_serializer_max_time ));
+      const abi_serializer& abis = abi_entry.serializer;
       const auto* t_id = d.find<chain::table_id_object, chain::by_code_scope_table>(boost::make_tuple(p.code, name(scope), p.table));
       if( t_id != nullptr ) {
          const auto& idx = d.get_index<IndexType, chain::by_scope_primary>();
@@ -544,6 +718,13 @@ public:
             }
          }
 
+         if( p.cursor && !p.cursor->empty() ) {
+            const auto c = decode_table_cursor( p, scope, p.table.to_uint64_t() );
+            EOS_ASSERT( c.secondary_key.empty(), chain::contract_table_query_exception, "Invalid cursor for primary index" );
+            auto& bound = p.reverse && *p.reverse ? upper_bound_lookup_tuple : lower_bound_lookup_tuple;
+            std::get<1>(bound) = c.primary_key;
+         }
+
          if( upper_bound_lookup_tuple < lower_bound_lookup_tuple  )
             return result;
 
@@ -554,22 +735,12 @@ public:
             for( unsigned int count = 0; cur_time <= end_time && count < p.limit && itr != end_itr; ++count, ++itr, cur_time = fc::time_point::now() ) {
                copy_inline_row(*itr, data);
 
-               fc::variant data_var;
-               if( p.json ) {
-                  data_var = abis.binary_to_variant( abis.get_table_type(p.table), data, abi_serializer::create_yield_function( abi_serializer_max_time ), shorten_abi_errors );
-               } else {
-                  data_var = fc::variant( data );
-               }
-
-               if( p.show_payer && *p.show_payer ) {
-                  result.rows.emplace_back( fc::mutable_variant_object("data", std::move(data_var))("payer", itr->payer) );
-               } else {
-                  result.rows.emplace_back( std::move(data_var) );
-               }
+               add_table_row( result, p, abis, data, itr->primary_key, itr->payer, format );
             }
             if( itr != end_itr ) {
                result.more = true;
                result.next_key = convert_to_string(itr->primary_key, p.key_type, p.encode_type, "next_key - next lower bound");
+               result.next_cursor = encode_table_cursor( p, scope, p.table.to_uint64_t(), nullptr, 0, itr->primary_key );
             }
          };
 
@@ -586,6 +757,9 @@ public:
 
    chain::symbol extract_core_symbol()const;
 
+   chain::signed_block_ptr fetch_block( const get_block_params& params )const;
+   chain::block_state_ptr  fetch_block_state( const get_block_header_state_params& params )const;
+
    friend struct resolver_factory<read_only>;
 };
 
@@ -607,6 +781,11 @@ public:
       fc::variant                 processed;
    };
    void push_transaction(const push_transaction_params& params, chain::plugin_interface::next_function<push_transaction_results> next);
+   void push_transaction(const chain::packed_transaction_ptr& trx, chain::plugin_interface::next_function<push_transaction_results> next);
+
+   /// Resolve the ABIs of the actions in params and pack them. Only reads chainbase, so it is safe to call from the
+   /// read-only threads ahead of the push itself.
+   chain::packed_transaction_ptr to_packed_transaction(const push_transaction_params& params) const;
 
 
    using push_transactions_params  = vector<push_transaction_params>;
@@ -616,6 +795,13 @@ public:
    using send_transaction_params = push_transaction_params;
    using send_transaction_results = push_transaction_results;
    void send_transaction(const send_transaction_params& params, chain::plugin_interface::next_function<send_transaction_results> next);
+   void send_transaction(const chain::packed_transaction_ptr& trx, chain::plugin_interface::next_function<send_transaction_results> next);
+
+   /// Execute the transaction against the pending block state and discard all of its changes. Authorization is not
+   /// checked so unsigned transactions may be used to query contracts. Nothing is relayed or included in a block.
+   using push_ro_transaction_params = push_transaction_params;
+   using push_ro_transaction_results = push_transaction_results;
+   void push_ro_transaction(const push_ro_transaction_params& params, chain::plugin_interface::next_function<push_ro_transaction_results> next);
 
    friend resolver_factory<read_write>;
 };
@@ -704,7 +890,7 @@ public:
    void plugin_startup();
    void plugin_shutdown();
 
-   chain_apis::read_only get_read_only_api() const { return chain_apis::read_only(chain(), get_abi_serializer_max_time()); }
+   chain_apis::read_only get_read_only_api() const;
    chain_apis::read_write get_read_write_api() { return chain_apis::read_write(chain(), get_abi_serializer_max_time(), api_accept_transactions()); }
 
    bool accept_block( const chain::signed_block_ptr& block, const chain::block_id_type& id );
@@ -739,6 +925,14 @@ public:
    bool accept_transactions() const;
    void enable_accept_transactions();
 
+   bool read_only_threads_enabled() const;
+   /**
+    * Queue a read-only api call. Queued calls are executed together on the read-only thread pool while the main
+    * thread is paused, therefore the task must only read chain state and must handle its own exceptions.
+    * Only valid when read_only_threads_enabled().
+    */
+   void post_read_only( std::function<void()> task );
+
    static void handle_guard_exception(const chain::guard_exception& e);
    void do_hard_replay(const variables_map& options);
 
@@ -766,8 +960,11 @@ FC_REFLECT(eosio::chain_apis::read_only::get_block_header_state_params, (block_n
 
 FC_REFLECT( eosio::chain_apis::read_write::push_transaction_results, (transaction_id)(processed) )
 
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer) )
-FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_params, (json)(code)(scope)(table)(table_key)(lower_bound)(upper_bound)(limit)(key_type)(index_position)(encode_type)(reverse)(show_payer)(cursor) )
+FC_REFLECT( eosio::chain_apis::read_only::table_rows_cursor, (code)(scope)(index)(reverse)(secondary_key)(primary_key)(head_block_num) )
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_result, (rows)(more)(next_key)(next_cursor) );
+FC_REFLECT( eosio::chain_apis::read_only::binary_table_row, (primary_key)(payer)(data) );
+FC_REFLECT( eosio::chain_apis::read_only::get_table_rows_binary_result, (rows)(more)(next_key)(next_cursor) );
 
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_params, (code)(table)(lower_bound)(upper_bound)(limit)(reverse) )
 FC_REFLECT( eosio::chain_apis::read_only::get_table_by_scope_result_row, (code)(scope)(table)(payer)(count));
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <eosio/chain/types.hpp>
+
+#include <fc/optional.hpp>
+
+#include <boost/filesystem/path.hpp>
+
+#include <map>
+#include <mutex>
+
+namespace eosio {
+   using chain::block_id_type;
+   namespace bfs = boost::filesystem;
+
+   /**
+    * The files of the periodic state checkpoints in a directory. A checkpoint is written as a .pending file; it becomes
+    * a .bin file, the only kind loaded at startup, once both its write has finished and its block has become
+    * irreversible. A checkpoint whose write failed or whose block was forked out is removed, and only the newest
+    * to_keep .bin files are retained. Writes may finish on another thread than the one the blocks become irreversible on.
+    */
+   class state_checkpoints {
+   public:
+      state_checkpoints( const bfs::path& dir, uint32_t to_keep );
+
+      bfs::path path( const block_id_type& id ) const;
+      bfs::path integrity_path( const block_id_type& id ) const;
+
+      /// checkpoints in dir by block number
+      static std::map<uint32_t, bfs::path> list( const bfs::path& dir );
+      /// the newest checkpoint in dir the block log in blocks_dir can be replayed from
+      static fc::optional<bfs::path> newest_usable( const bfs::path& dir, const bfs::path& blocks_dir );
+
+      /// removes the .pending files of a previous run, which were never completed
+      void remove_incomplete();
+
+      bool is_pending( const block_id_type& id ) const;
+
+      /// registers the write of the checkpoint of block id and returns the .pending path to write it to
+      bfs::path start_write( const block_id_type& id );
+      /// called once the write started for block id has finished, the files are removed unless it succeeded
+      void write_finished( const block_id_type& id, bool succeeded );
+
+      /// keeps the checkpoint of block id and drops those of the blocks it forked out
+      void on_irreversible( const block_id_type& id );
+
+      /// records the integrity hash of the state at block id next to its checkpoint, throws if it cannot
+      void record_integrity_hash( const block_id_type& id, const fc::sha256& hash ) const;
+
+      enum class hash_check { unrecorded, matches, differs };
+      /**
+       * Compares the integrity hash of a state at block id with the one recorded with its checkpoint. Only the hashes
+       * are compared, the checkpoint is not read: this finds a replay that diverged from the run that wrote the
+       * checkpoint, not a checkpoint file damaged since. A record that cannot be read differs.
+       */
+      hash_check check_integrity_hash( const block_id_type& id, const fc::sha256& actual ) const;
+
+   private:
+      struct pending_checkpoint {
+         bfs::path path;                 ///< the .pending file
+         bool      writing = true;
+         bool      irreversible = false; ///< its block became irreversible while it was being written
+      };
+
+      void keep( const block_id_type& id, const bfs::path& pending_path );
+      void drop( const block_id_type& id, const bfs::path& pending_path );
+      void rotate();
+
+      bfs::path                                   dir;
+      uint32_t                                    to_keep;
+      mutable std::mutex                          mtx;
+      std::map<block_id_type, pending_checkpoint> pending;                    // guarded by mtx
+      uint32_t                                    irreversible_block_num = 0; // guarded by mtx
+   };
+
+}
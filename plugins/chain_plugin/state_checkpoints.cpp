@@ -0,0 +1,188 @@
+#include <eosio/chain_plugin/state_checkpoints.hpp>
+#include <eosio/chain/block_header.hpp>
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/exceptions.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace eosio {
+
+using chain::block_header;
+using chain::block_log;
+
+namespace {
+   const std::string checkpoint_prefix = "state-checkpoint-";
+}
+
+state_checkpoints::state_checkpoints( const bfs::path& dir, uint32_t to_keep )
+:dir( dir )
+,to_keep( to_keep )
+{}
+
+bfs::path state_checkpoints::path( const block_id_type& id ) const {
+   return dir / (checkpoint_prefix + id.str() + ".bin");
+}
+
+bfs::path state_checkpoints::integrity_path( const block_id_type& id ) const {
+   return dir / (checkpoint_prefix + id.str() + ".integrity");
+}
+
+std::map<uint32_t, bfs::path> state_checkpoints::list( const bfs::path& dir ) {
+   std::map<uint32_t, bfs::path> result;
+   if( !bfs::is_directory( dir ) )
+      return result;
+   for( bfs::directory_iterator enditr, itr{dir}; itr != enditr; ++itr ) {
+      const auto name = itr->path().filename().string();
+      if( name.compare( 0, checkpoint_prefix.size(), checkpoint_prefix ) != 0 || itr->path().extension() != ".bin" )
+         continue;
+      try {
+         const block_id_type id( name.substr( checkpoint_prefix.size(), name.size() - checkpoint_prefix.size() - 4 ) );
+         result.emplace( block_header::num_from_id( id ), itr->path() );
+      } catch( ... ) {}
+   }
+   return result;
+}
+
+fc::optional<bfs::path> state_checkpoints::newest_usable( const bfs::path& dir, const bfs::path& blocks_dir ) {
+   if( !bfs::is_regular_file( blocks_dir / "blocks.log" ) )
+      return {};
+   block_log blog( blocks_dir );
+   if( !blog.head() )
+      return {};
+   const auto checkpoints = list( dir );
+   for( auto itr = checkpoints.rbegin(); itr != checkpoints.rend(); ++itr ) {
+      if( itr->first <= blog.head()->block_num() && itr->first + 1 >= blog.first_block_num() )
+         return itr->second;
+   }
+   return {};
+}
+
+void state_checkpoints::remove_incomplete() {
+   if( !bfs::is_directory( dir ) )
+      return;
+   std::vector<bfs::path> incomplete;
+   for( bfs::directory_iterator enditr, itr{dir}; itr != enditr; ++itr ) {
+      const auto name = itr->path().filename().string();
+      if( name.compare( 0, checkpoint_prefix.size(), checkpoint_prefix ) == 0 && itr->path().extension() == ".pending" )
+         incomplete.push_back( itr->path() );
+   }
+   for( const auto& p : incomplete ) {
+      boost::system::error_code ec;
+      bfs::remove( p, ec );
+      bfs::remove( bfs::path( p ).replace_extension().replace_extension( ".integrity" ), ec );
+   }
+}
+
+bool state_checkpoints::is_pending( const block_id_type& id ) const {
+   std::lock_guard<std::mutex> g( mtx );
+   return pending.count( id ) > 0;
+}
+
+bfs::path state_checkpoints::start_write( const block_id_type& id ) {
+   bfs::create_directories( dir );
+   std::lock_guard<std::mutex> g( mtx );
+   auto& p = pending[id];
+   p.path = path( id ).generic_string() + ".pending";
+   p.writing = true;
+   p.irreversible = false;
+   return p.path;
+}
+
+void state_checkpoints::write_finished( const block_id_type& id, bool succeeded ) {
+   std::lock_guard<std::mutex> g( mtx );
+   auto itr = pending.find( id );
+   if( itr == pending.end() )
+      return;
+   const auto p = itr->second;
+   if( !succeeded ) {
+      pending.erase( itr );
+      drop( id, p.path );
+   } else if( p.irreversible ) {
+      pending.erase( itr );
+      keep( id, p.path );
+   } else if( block_header::num_from_id( id ) <= irreversible_block_num ) {
+      // another block of its number became irreversible while it was being written
+      pending.erase( itr );
+      drop( id, p.path );
+   } else {
+      itr->second.writing = false;
+   }
+}
+
+void state_checkpoints::on_irreversible( const block_id_type& id ) {
+   const uint32_t block_num = block_header::num_from_id( id );
+   std::lock_guard<std::mutex> g( mtx );
+   irreversible_block_num = std::max( irreversible_block_num, block_num );
+   for( auto itr = pending.begin(); itr != pending.end(); ) {
+      if( block_header::num_from_id( itr->first ) > block_num ) {
+         ++itr;
+         continue;
+      }
+      if( itr->second.writing ) {
+         // decided by write_finished
+         if( itr->first == id )
+            itr->second.irreversible = true;
+         ++itr;
+         continue;
+      }
+      const auto p = itr->second;
+      const auto pid = itr->first;
+      itr = pending.erase( itr );
+      if( pid == id )
+         keep( pid, p.path );
+      else
+         drop( pid, p.path );
+   }
+}
+
+void state_checkpoints::record_integrity_hash( const block_id_type& id, const fc::sha256& hash ) const {
+   EOS_ASSERT( fc::json::save_to_file( hash, integrity_path( id ) ), chain::snapshot_exception,
+               "Unable to write the integrity hash of state checkpoint ${p}", ("p", path( id ).generic_string()) );
+}
+
+state_checkpoints::hash_check state_checkpoints::check_integrity_hash( const block_id_type& id, const fc::sha256& actual ) const {
+   const auto p = integrity_path( id );
+   if( !bfs::is_regular_file( p ) )
+      return hash_check::unrecorded;
+   try {
+      return fc::json::from_file( p ).as<fc::sha256>() == actual ? hash_check::matches : hash_check::differs;
+   } catch( const fc::exception& e ) {
+      elog( "Unable to read ${p}: ${e}", ("p", p.generic_string())("e", e.to_detail_string()) );
+   }
+   return hash_check::differs;
+}
+
+void state_checkpoints::keep( const block_id_type& id, const bfs::path& pending_path ) {
+   boost::system::error_code ec;
+   bfs::rename( pending_path, path( id ), ec );
+   if( ec ) {
+      elog( "Unable to keep state checkpoint ${p}: ${m}", ("p", pending_path.generic_string())("m", ec.message()) );
+      drop( id, pending_path );
+      return;
+   }
+   rotate();
+}
+
+void state_checkpoints::drop( const block_id_type& id, const bfs::path& pending_path ) {
+   boost::system::error_code ec;
+   bfs::remove( pending_path, ec );
+   bfs::remove( integrity_path( id ), ec );
+}
+
+void state_checkpoints::rotate() {
+   auto checkpoints = list( dir );
+   while( checkpoints.size() > to_keep ) {
+      boost::system::error_code ec;
+      bfs::remove( checkpoints.begin()->second, ec );
+      bfs::remove( bfs::path( checkpoints.begin()->second ).replace_extension( ".integrity" ), ec );
+      checkpoints.erase( checkpoints.begin() );
+   }
+}
+
+}
@@ -1,5 +1,7 @@
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
+#include <algorithm>
+#include <set>
 #include <eosio/db_size_api_plugin/db_size_api_plugin.hpp>
 
 namespace eosio {
@@ -20,6 +22,9 @@ using namespace eosio;
           } \
        }}
 
+#define INVOKE_R_R(api_handle, call_name, in_param) \
+     auto result = api_handle->call_name(fc::json::from_string(body).as<in_param>());
+
 #define INVOKE_R_V(api_handle, call_name) \
      auto result = api_handle->call_name();
 
@@ -28,6 +33,10 @@ void db_size_api_plugin::plugin_startup() {
    app().get_plugin<http_plugin>().add_api({
        CALL(db_size, this, get,
             INVOKE_R_V(this, get), 200),
+       CALL(db_size, this, get_tables,
+            INVOKE_R_R(this, get_tables, db_size_get_tables_params), 200),
+       CALL(db_size, this, get_table_accesses,
+            INVOKE_R_R(this, get_table_accesses, db_size_get_table_accesses_params), 200),
    });
 }
 
@@ -39,13 +48,61 @@ db_size_stats db_size_api_plugin::get() {
    ret.size = db.get_segment_manager()->get_size();
    ret.used_bytes = ret.size - ret.free_bytes;
 
+   std::map<string, uint64_t> estimated_bytes;
+   std::set<string> extrapolated;
+   const auto deadline = fc::time_point::now() + fc::milliseconds(max_walk_time_ms);
+   for(const auto& u : app().get_plugin<chain_plugin>().chain().get_index_memory_usage(deadline)) {
+      estimated_bytes[u.index] = u.estimated_bytes;
+      if(u.extrapolated)
+         extrapolated.insert(u.index);
+   }
+
    chainbase::database::database_index_row_count_multiset indices = db.row_count_per_index();
-   for(const auto& i : indices)
-      ret.indices.emplace_back(db_size_index_count{i.second, i.first});
+   for(const auto& i : indices) {
+      auto itr = estimated_bytes.find(i.second);
+      ret.indices.emplace_back(db_size_index_count{i.second, i.first, itr != estimated_bytes.end() ? itr->second : 0,
+                                                   extrapolated.count(i.second) > 0});
+   }
+
+   return ret;
+}
+
+db_size_tables db_size_api_plugin::get_tables(const db_size_get_tables_params& params) {
+   optional<chain::controller::table_usage_cursor> from;
+   if(params.lower_bound)
+      from = chain::controller::table_usage_cursor{params.lower_bound->code, params.lower_bound->scope, params.lower_bound->table};
+   const auto deadline = fc::time_point::now() + fc::milliseconds(std::min(params.time_limit_ms, max_walk_time_ms));
+   auto page = app().get_plugin<chain_plugin>().chain().get_table_usage(params.code, from, params.limit, deadline);
 
+   db_size_tables ret;
+   for(const auto& u : page.tables)
+      ret.tables.emplace_back(db_size_table{u.code, u.table, u.scopes, u.primary_rows, u.secondary_rows, u.estimated_bytes});
+   if(page.more) {
+      ret.more = true;
+      ret.next = db_size_table_cursor{page.more->code, page.more->scope, page.more->table};
+   }
+   return ret;
+}
+
+db_size_table_accesses db_size_api_plugin::get_table_accesses(const db_size_get_table_accesses_params& params) {
+   const chain::controller& chain = app().get_plugin<chain_plugin>().chain();
+   db_size_table_accesses ret;
+   ret.sample_rate = chain.table_access_sample_rate();
+
+   vector<db_size_table_access> tables;
+   for(const auto& a : chain.get_table_accesses())
+      tables.emplace_back(db_size_table_access{a.first.first, a.first.second, a.second.reads, a.second.writes});
+   const size_t n = std::min<size_t>(tables.size(), params.limit);
+   std::partial_sort(tables.begin(), tables.begin() + n, tables.end(), [](const auto& a, const auto& b) {
+      return a.reads + a.writes > b.reads + b.writes;
+   });
+   ret.more = tables.size() > n;
+   tables.resize(n);
+   ret.tables = std::move(tables);
    return ret;
 }
 
+#undef INVOKE_R_R
 #undef INVOKE_R_V
 #undef CALL
 
@@ -12,6 +12,8 @@ using namespace appbase;
 struct db_size_index_count {
    string   index;
    uint64_t row_count;
+   uint64_t estimated_bytes = 0; ///< rows, their links in every ordering and their dynamically sized members
+   bool     extrapolated = false; ///< from the rows visited within max_walk_time
 };
 
 struct db_size_stats {
@@ -21,6 +23,51 @@ struct db_size_stats {
    vector<db_size_index_count> indices;
 };
 
+struct db_size_table_cursor {
+   chain::account_name code;
+   chain::name         scope;
+   chain::name         table;
+};
+
+struct db_size_get_tables_params {
+   chain::account_name                  code;        ///< all codes when empty
+   optional<db_size_table_cursor>       lower_bound; ///< next of the previous page
+   uint32_t                             limit = 100;
+   uint32_t                             time_limit_ms = 10; ///< at most max_walk_time
+};
+
+struct db_size_table {
+   chain::account_name code;
+   chain::name         table;
+   uint64_t            scopes;
+   uint64_t            primary_rows;
+   uint64_t            secondary_rows;
+   uint64_t            estimated_bytes;
+};
+
+struct db_size_tables {
+   vector<db_size_table>          tables; ///< largest first, a table continued on the next page has the scopes of this one
+   bool                           more = false;
+   optional<db_size_table_cursor> next; ///< lower_bound of the next page when more
+};
+
+struct db_size_get_table_accesses_params {
+   uint32_t limit = 100;
+};
+
+struct db_size_table_access {
+   chain::account_name code;
+   chain::name         table;
+   uint64_t            reads;  ///< sampled
+   uint64_t            writes; ///< sampled
+};
+
+struct db_size_table_accesses {
+   uint32_t                     sample_rate; ///< one of every sample_rate accesses was counted, 0 when not counting
+   vector<db_size_table_access> tables;      ///< most accessed first
+   bool                         more = false;
+};
+
 class db_size_api_plugin : public plugin<db_size_api_plugin> {
 public:
    APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
@@ -38,11 +85,23 @@ public:
    void plugin_shutdown() {}
 
    db_size_stats get();
+   db_size_tables get_tables(const db_size_get_tables_params& params);
+   db_size_table_accesses get_table_accesses(const db_size_get_table_accesses_params& params);
+
+   /// longest a request walks rows on the main thread
+   static constexpr uint32_t max_walk_time_ms = 100;
 
 private:
 };
 
 }
 
-FC_REFLECT( eosio::db_size_index_count, (index)(row_count) )
-FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
\ No newline at end of file
+FC_REFLECT( eosio::db_size_index_count, (index)(row_count)(estimated_bytes)(extrapolated) )
+FC_REFLECT( eosio::db_size_stats, (free_bytes)(used_bytes)(size)(indices) )
+FC_REFLECT( eosio::db_size_table_cursor, (code)(scope)(table) )
+FC_REFLECT( eosio::db_size_get_tables_params, (code)(lower_bound)(limit)(time_limit_ms) )
+FC_REFLECT( eosio::db_size_table, (code)(table)(scopes)(primary_rows)(secondary_rows)(estimated_bytes) )
+FC_REFLECT( eosio::db_size_tables, (tables)(more)(next) )
+FC_REFLECT( eosio::db_size_get_table_accesses_params, (limit) )
+FC_REFLECT( eosio::db_size_table_access, (code)(table)(reads)(writes) )
+FC_REFLECT( eosio::db_size_table_accesses, (sample_rate)(tables)(more) )
@@ -1,7 +1,10 @@
 #include <eosio/history_plugin/history_plugin.hpp>
 #include <eosio/history_plugin/account_control_history_object.hpp>
+#include <eosio/history_plugin/action_history_object.hpp>
 #include <eosio/history_plugin/public_key_history_object.hpp>
+#include <eosio/chain/action_filter.hpp>
 #include <eosio/chain/controller.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/trace.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
@@ -10,76 +13,15 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <deque>
+#include <mutex>
+
 namespace eosio {
    using namespace chain;
    using boost::signals2::scoped_connection;
 
    static appbase::abstract_plugin& _history_plugin = app().register_plugin<history_plugin>();
 
-
-   struct account_history_object : public chainbase::object<account_history_object_type, account_history_object>  {
-      OBJECT_CTOR( account_history_object );
-
-      id_type      id;
-      account_name account; ///< the name of the account which has this action in its history
-      uint64_t     action_sequence_num = 0; ///< the sequence number of the relevant action (global)
-      int32_t      account_sequence_num = 0; ///< the sequence number for this account (per-account)
-   };
-
-   struct action_history_object : public chainbase::object<action_history_object_type, action_history_object> {
-
-      OBJECT_CTOR( action_history_object, (packed_action_trace) );
-
-      id_type      id;
-      uint64_t     action_sequence_num; ///< the sequence number of the relevant action
-
-      shared_string        packed_action_trace;
-      uint32_t             block_num;
-      block_timestamp_type block_time;
-      transaction_id_type  trx_id;
-   };
-   using account_history_id_type = account_history_object::id_type;
-   using action_history_id_type  = action_history_object::id_type;
-
-
-   struct by_action_sequence_num;
-   struct by_account_action_seq;
-   struct by_trx_id;
-
-   using action_history_index = chainbase::shared_multi_index_container<
-      action_history_object,
-      indexed_by<
-         ordered_unique<tag<by_id>, member<action_history_object, action_history_object::id_type, &action_history_object::id>>,
-         ordered_unique<tag<by_action_sequence_num>, member<action_history_object, uint64_t, &action_history_object::action_sequence_num>>,
-         ordered_unique<tag<by_trx_id>,
-            composite_key< action_history_object,
-               member<action_history_object, transaction_id_type, &action_history_object::trx_id>,
-               member<action_history_object, uint64_t, &action_history_object::action_sequence_num >
-            >
-         >
-      >
-   >;
-
-   using account_history_index = chainbase::shared_multi_index_container<
-      account_history_object,
-      indexed_by<
-         ordered_unique<tag<by_id>, member<account_history_object, account_history_object::id_type, &account_history_object::id>>,
-         ordered_unique<tag<by_account_action_seq>,
-            composite_key< account_history_object,
-               member<account_history_object, account_name, &account_history_object::account >,
-               member<account_history_object, int32_t, &account_history_object::account_sequence_num >
-            >
-         >
-      >
-   >;
-
-} /// namespace eosio
-
-CHAINBASE_SET_INDEX_TYPE(eosio::account_history_object, eosio::account_history_index)
-CHAINBASE_SET_INDEX_TYPE(eosio::action_history_object, eosio::action_history_index)
-
-namespace eosio {
-
    template<typename MultiIndex, typename LookupType>
    static void remove(chainbase::database& db, const account_name& account_name, const permission_name& permission)
    {
@@ -121,108 +63,44 @@ namespace eosio {
       }
    }
 
-   struct filter_entry {
-      name receiver;
-      name action;
-      name actor;
-
-      std::tuple<name, name, name> key() const {
-         return std::make_tuple(receiver, action, actor);
-      }
-
-      friend bool operator<( const filter_entry& a, const filter_entry& b ) {
-         return a.key() < b.key();
-      }
-   };
-
    class history_plugin_impl {
       public:
          bool bypass_filter = false;
-         std::set<filter_entry> filter_on;
-         std::set<filter_entry> filter_out;
+         action_filter          filter_on;
+         action_filter          filter_out;
          chain_plugin*          chain_plug = nullptr;
          fc::optional<scoped_connection> applied_transaction_connection;
+         fc::optional<scoped_connection> accepted_block_connection;
+
+         /// account and action history live in their own database, written by history_thread a block at a time
+         fc::optional<chainbase::database> history_db;
+         mutable std::mutex                history_mtx;   ///< guards history_db between history_thread and the apis
+         fc::optional<named_thread_pool>   history_thread;
+         std::deque<std::future<void>>     queued_blocks; ///< blocks posted to history_thread, oldest first
+         uint32_t                          max_queued_blocks = 1000;
+
+         std::map<transaction_id_type, transaction_trace_ptr> cached_traces;
+         transaction_trace_ptr                                onblock_trace;
+
+         bool filter(const action_trace& act) const {
+            if (!bypass_filter && !filter_on.match(act.receiver, act.act.name, act.act.authorization))
+               return false;
+            return !filter_out.match(act.receiver, act.act.name, act.act.authorization);
+         }
 
-          bool filter(const action_trace& act) {
-            bool pass_on = false;
-            if (bypass_filter) {
-              pass_on = true;
-            }
-            if (filter_on.find({ act.receiver, {}, {} }) != filter_on.end()) {
-              pass_on = true;
-            }
-            if (filter_on.find({ act.receiver, act.act.name, {} }) != filter_on.end()) {
-              pass_on = true;
-            }
-            for (const auto& a : act.act.authorization) {
-              if (filter_on.find({ act.receiver, {}, a.actor }) != filter_on.end()) {
-                pass_on = true;
-              }
-              if (filter_on.find({ act.receiver, act.act.name, a.actor }) != filter_on.end()) {
-                pass_on = true;
-              }
-            }
-
-            if (!pass_on) {  return false;  }
-
-            if (filter_out.find({ act.receiver, {}, {} }) != filter_out.end()) {
-              return false;
-            }
-            if (filter_out.find({ act.receiver, act.act.name, {} }) != filter_out.end()) {
-              return false;
-            }
-            for (const auto& a : act.act.authorization) {
-              if (filter_out.find({ act.receiver, {}, a.actor }) != filter_out.end()) {
-                return false;
-              }
-              if (filter_out.find({ act.receiver, act.act.name, a.actor }) != filter_out.end()) {
-                return false;
-              }
-            }
-
-            return true;
-          }
-
-         set<account_name> account_set( const action_trace& act ) {
+         set<account_name> account_set( const action_trace& act ) const {
             set<account_name> result;
 
             result.insert( act.receiver );
             for( const auto& a : act.act.authorization ) {
-               if( bypass_filter ||
-                   filter_on.find({ act.receiver, {}, {}}) != filter_on.end() ||
-                   filter_on.find({ act.receiver, {}, a.actor}) != filter_on.end() ||
-                   filter_on.find({ act.receiver, act.act.name, {}}) != filter_on.end() ||
-                   filter_on.find({ act.receiver, act.act.name, a.actor }) != filter_on.end() ) {
-                 if ((filter_out.find({ act.receiver, {}, {} }) == filter_out.end()) &&
-                     (filter_out.find({ act.receiver, {}, a.actor }) == filter_out.end()) &&
-                     (filter_out.find({ act.receiver, act.act.name, {} }) == filter_out.end()) &&
-                     (filter_out.find({ act.receiver, act.act.name, a.actor }) == filter_out.end())) {
-                   result.insert( a.actor );
-                 }
+               if( (bypass_filter || filter_on.match( act.receiver, act.act.name, a.actor )) &&
+                   !filter_out.match( act.receiver, act.act.name, a.actor ) ) {
+                  result.insert( a.actor );
                }
             }
             return result;
          }
 
-         void record_account_action( account_name n, const action_trace& act ) {
-            auto& chain = chain_plug->chain();
-            chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
-
-            const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
-            auto itr = idx.lower_bound( boost::make_tuple( name(n.to_uint64_t()+1), 0 ) );
-
-            uint64_t asn = 0;
-            if( itr != idx.begin() ) --itr;
-            if( itr->account == n )
-               asn = itr->account_sequence_num + 1;
-
-            const auto& a = db.create<account_history_object>( [&]( auto& aho ) {
-              aho.account = n;
-              aho.action_sequence_num = act.receipt->global_sequence;
-              aho.account_sequence_num = asn;
-            });
-         }
-
          void on_system_action( const action_trace& at ) {
             auto& chain = chain_plug->chain();
             chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
@@ -250,39 +128,93 @@ namespace eosio {
             }
          }
 
-         void on_action_trace( const action_trace& at ) {
+         /// runs on history_thread
+         void on_action_trace( const action_trace& at, uint32_t block_num, block_timestamp_type block_time ) {
             if( filter( at ) ) {
                //idump((fc::json::to_pretty_string(at)));
-               auto& chain = chain_plug->chain();
-               chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
-
-               db.create<action_history_object>( [&]( auto& aho ) {
-                  auto ps = fc::raw::pack_size( at );
-                  aho.packed_action_trace.resize(ps);
-                  datastream<char*> ds( aho.packed_action_trace.data(), ps );
-                  fc::raw::pack( ds, at );
-                  aho.action_sequence_num = at.receipt->global_sequence;
-                  aho.block_num = chain.head_block_num() + 1;
-                  aho.block_time = chain.pending_block_time();
-                  aho.trx_id     = at.trx_id;
-               });
-
-               auto aset = account_set( at );
-               for( auto a : aset ) {
-                  record_account_action( a, at );
-               }
+               record_action_history( *history_db, at, account_set( at ), block_num, block_time );
             }
-            if( at.receiver == chain::config::system_account_name )
-               on_system_action( at );
          }
 
+         static bool is_recorded( const transaction_trace_ptr& trace ) {
+            return trace->receipt && (trace->receipt->status == transaction_receipt_header::executed ||
+                                      trace->receipt->status == transaction_receipt_header::soft_fail);
+         }
+
+         static bool is_onblock( const transaction_trace_ptr& p ) {
+            if( p->action_traces.size() != 1 )
+               return false;
+            const auto& act = p->action_traces[0].act;
+            return act.account == chain::config::system_account_name && act.name == N(onblock) &&
+                   act.authorization.size() == 1 && act.authorization[0].actor == chain::config::system_account_name &&
+                   act.authorization[0].permission == chain::config::active_name;
+         }
+
+         /// key and controlling account history stays in the state database so that it follows forks with it
          void on_applied_transaction( const transaction_trace_ptr& trace ) {
-            if( !trace->receipt || (trace->receipt->status != transaction_receipt_header::executed &&
-                  trace->receipt->status != transaction_receipt_header::soft_fail) )
+            if( !is_recorded( trace ) )
                return;
             for( const auto& atrace : trace->action_traces ) {
-               if( !atrace.receipt ) continue;
-               on_action_trace( atrace );
+               if( atrace.receipt && atrace.receiver == chain::config::system_account_name )
+                  on_system_action( atrace );
+            }
+            if( is_onblock( trace ) )
+               onblock_trace = trace;
+            else if( trace->failed_dtrx_trace )
+               cached_traces[trace->failed_dtrx_trace->id] = trace;
+            else
+               cached_traces[trace->id] = trace;
+         }
+
+         /// hands the traces of the block, in block order, to history_thread
+         void on_accepted_block( const block_state_ptr& bs ) {
+            std::vector<transaction_trace_ptr> traces;
+            if( onblock_trace )
+               traces.push_back( onblock_trace );
+            for( const auto& r : bs->block->transactions ) {
+               const auto id = r.trx.contains<transaction_id_type>() ? r.trx.get<transaction_id_type>()
+                                                                     : r.trx.get<packed_transaction>().id();
+               auto it = cached_traces.find( id );
+               if( it != cached_traces.end() )
+                  traces.push_back( it->second );
+            }
+            cached_traces.clear();
+            onblock_trace.reset();
+
+            // the queue is bounded by making the main thread wait for the oldest block once it is full
+            while( queued_blocks.size() >= max_queued_blocks ) {
+               queued_blocks.front().get();
+               queued_blocks.pop_front();
+            }
+            while( !queued_blocks.empty() && queued_blocks.front().wait_for( std::chrono::seconds(0) ) == std::future_status::ready ) {
+               queued_blocks.front().get();
+               queued_blocks.pop_front();
+            }
+            queued_blocks.emplace_back( async_thread_pool( history_thread->get_executor(),
+                  [this, block_num = bs->block_num, block_time = bs->header.timestamp, traces = std::move(traces)]() {
+               try {
+                  std::lock_guard<std::mutex> g( history_mtx );
+                  remove_action_history_from_block( *history_db, block_num );
+                  for( const auto& trace : traces ) {
+                     if( !is_recorded( trace ) )
+                        continue;
+                     for( const auto& atrace : trace->action_traces ) {
+                        if( atrace.receipt )
+                           on_action_trace( atrace, block_num, block_time );
+                     }
+                  }
+               } catch( const boost::interprocess::bad_alloc& ) {
+                  elog( "history database is full, increase history-db-size-mb" );
+                  app().post( priority::high, []() { app().quit(); } );
+               } FC_LOG_AND_DROP()
+            } ) );
+         }
+
+         /// waits for the blocks queued so far to be written
+         void drain_history_thread() {
+            while( !queued_blocks.empty() ) {
+               queued_blocks.front().wait();
+               queued_blocks.pop_front();
             }
          }
    };
@@ -305,6 +237,14 @@ namespace eosio {
             ("filter-out,F", bpo::value<vector<string>>()->composing(),
              "Do not track actions which match receiver:action:actor. Action and Actor both blank excludes all from Reciever. Actor blank excludes all from reciever:action. Receiver may not be blank.")
             ;
+      cfg.add_options()
+            ("history-dir", bpo::value<boost::filesystem::path>()->default_value("history"),
+             "the location of the account and action history database (absolute path or relative to application data dir)")
+            ("history-db-size-mb", bpo::value<uint64_t>()->default_value(1024),
+             "Maximum size (in MiB) of the account and action history database")
+            ("history-queue-size", bpo::value<uint32_t>()->default_value(my->max_queued_blocks),
+             "Maximum number of blocks waiting to be written to the history database; applying blocks waits while it is full")
+            ;
    }
 
    void history_plugin::plugin_initialize(const variables_map& options) {
@@ -320,10 +260,10 @@ namespace eosio {
                std::vector<std::string> v;
                boost::split( v, s, boost::is_any_of( ":" ));
                EOS_ASSERT( v.size() == 3, fc::invalid_arg_exception, "Invalid value ${s} for --filter-on", ("s", s));
-               filter_entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
+               action_filter::entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
                EOS_ASSERT( fe.receiver.to_uint64_t(), fc::invalid_arg_exception,
                            "Invalid value ${s} for --filter-on", ("s", s));
-               my->filter_on.insert( fe );
+               my->filter_on.add( fe );
             }
          }
          if( options.count( "filter-out" )) {
@@ -332,10 +272,10 @@ namespace eosio {
                std::vector<std::string> v;
                boost::split( v, s, boost::is_any_of( ":" ));
                EOS_ASSERT( v.size() == 3, fc::invalid_arg_exception, "Invalid value ${s} for --filter-out", ("s", s));
-               filter_entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
+               action_filter::entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
                EOS_ASSERT( fe.receiver.to_uint64_t(), fc::invalid_arg_exception,
                            "Invalid value ${s} for --filter-out", ("s", s));
-               my->filter_out.insert( fe );
+               my->filter_out.add( fe );
             }
          }
 
@@ -344,16 +284,28 @@ namespace eosio {
          auto& chain = my->chain_plug->chain();
 
          chainbase::database& db = const_cast<chainbase::database&>( chain.db() ); // Override read-only access to state DB (highly unrecommended practice!)
-         // TODO: Use separate chainbase database for managing the state of the history_plugin (or remove deprecated history_plugin entirely)
-         db.add_index<account_history_index>();
-         db.add_index<action_history_index>();
          db.add_index<account_control_history_multi_index>();
          db.add_index<public_key_history_multi_index>();
 
+         auto dir = options.at( "history-dir" ).as<boost::filesystem::path>();
+         if( dir.is_relative() )
+            dir = app().data_dir() / dir;
+         my->history_db.emplace( dir, chainbase::database::read_write, options.at( "history-db-size-mb" ).as<uint64_t>() * 1024 * 1024 );
+         my->history_db->add_index<account_history_index>();
+         my->history_db->add_index<action_history_index>();
+         my->max_queued_blocks = options.at( "history-queue-size" ).as<uint32_t>();
+         EOS_ASSERT( my->max_queued_blocks > 0, chain::plugin_config_exception, "history-queue-size must be greater than 0" );
+         // replay from chain_plugin startup already accepts blocks
+         my->history_thread.emplace( "hist", 1 );
+
          my->applied_transaction_connection.emplace(
                chain.applied_transaction.connect( [&]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
                   my->on_applied_transaction( std::get<0>(t) );
                } ));
+         my->accepted_block_connection.emplace(
+               chain.accepted_block.connect( [&]( const block_state_ptr& bs ) {
+                  my->on_accepted_block( bs );
+               } ));
       } FC_LOG_AND_RETHROW()
    }
 
@@ -362,6 +314,11 @@ namespace eosio {
 
    void history_plugin::plugin_shutdown() {
       my->applied_transaction_connection.reset();
+      my->accepted_block_connection.reset();
+      my->drain_history_thread();
+      if( my->history_thread )
+         my->history_thread->stop();
+      my->history_db.reset();
    }
 
 
@@ -371,7 +328,8 @@ namespace eosio {
       read_only::get_actions_result read_only::get_actions( const read_only::get_actions_params& params )const {
          edump((params));
         auto& chain = history->chain_plug->chain();
-        const auto& db = chain.db();
+        std::lock_guard<std::mutex> g( history->history_mtx );
+        const chainbase::database& db = *history->history_db;
         const auto abi_serializer_max_time = history->chain_plug->get_abi_serializer_max_time();
 
         const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
@@ -461,7 +419,8 @@ namespace eosio {
             return (*(input_id.data() + input_id_size) & 0xF0) == (*(id.data() + input_id_size) & 0xF0);
          };
 
-         const auto& db = chain.db();
+         std::unique_lock<std::mutex> g( history->history_mtx );
+         const chainbase::database& db = *history->history_db;
          const auto& idx = db.get_index<action_history_index, by_trx_id>();
          auto itr = idx.lower_bound( boost::make_tuple( input_id ) );
 
@@ -488,6 +447,7 @@ namespace eosio {
 
               ++itr;
             }
+            g.unlock();
 
             auto blk = chain.fetch_block_by_number( result.block_num );
             if( blk || chain.is_building_block() ) {
@@ -512,6 +472,7 @@ namespace eosio {
                }
             }
          } else {
+            g.unlock();
             auto blk = chain.fetch_block_by_number(*p.block_num_hint);
             bool found = false;
             if (blk) {
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <chainbase/chainbase.hpp>
+#include <eosio/chain/trace.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <set>
+
+namespace eosio {
+using chain::account_name;
+using chain::transaction_id_type;
+using namespace boost::multi_index;
+
+struct account_history_object : public chainbase::object<chain::account_history_object_type, account_history_object>  {
+   OBJECT_CTOR( account_history_object );
+
+   id_type      id;
+   account_name account; ///< the name of the account which has this action in its history
+   uint64_t     action_sequence_num = 0; ///< the sequence number of the relevant action (global)
+   int32_t      account_sequence_num = 0; ///< the sequence number for this account (per-account)
+};
+
+struct action_history_object : public chainbase::object<chain::action_history_object_type, action_history_object> {
+
+   OBJECT_CTOR( action_history_object, (packed_action_trace) );
+
+   id_type      id;
+   uint64_t     action_sequence_num; ///< the sequence number of the relevant action
+
+   chain::shared_string        packed_action_trace;
+   uint32_t                    block_num;
+   chain::block_timestamp_type block_time;
+   transaction_id_type         trx_id;
+};
+using account_history_id_type = account_history_object::id_type;
+using action_history_id_type  = action_history_object::id_type;
+
+
+struct by_id;
+struct by_action_sequence_num;
+struct by_account_action_seq;
+struct by_trx_id;
+
+using action_history_index = chainbase::shared_multi_index_container<
+   action_history_object,
+   indexed_by<
+      ordered_unique<tag<by_id>, member<action_history_object, action_history_object::id_type, &action_history_object::id>>,
+      ordered_unique<tag<by_action_sequence_num>, member<action_history_object, uint64_t, &action_history_object::action_sequence_num>>,
+      ordered_unique<tag<by_trx_id>,
+         composite_key< action_history_object,
+            member<action_history_object, transaction_id_type, &action_history_object::trx_id>,
+            member<action_history_object, uint64_t, &action_history_object::action_sequence_num >
+         >
+      >
+   >
+>;
+
+using account_history_index = chainbase::shared_multi_index_container<
+   account_history_object,
+   indexed_by<
+      ordered_unique<tag<by_id>, member<account_history_object, account_history_object::id_type, &account_history_object::id>>,
+      ordered_unique<tag<by_account_action_seq>,
+         composite_key< account_history_object,
+            member<account_history_object, account_name, &account_history_object::account >,
+            member<account_history_object, int32_t, &account_history_object::account_sequence_num >
+         >
+      >,
+      ordered_non_unique<tag<by_action_sequence_num>, member<account_history_object, uint64_t, &account_history_object::action_sequence_num>>
+   >
+>;
+
+/// records a receipted action in the history of each of accounts, which continues where the last recorded action left off
+inline void record_action_history( chainbase::database& db, const chain::action_trace& at, const std::set<account_name>& accounts,
+                                   uint32_t block_num, chain::block_timestamp_type block_time ) {
+   db.create<action_history_object>( [&]( auto& aho ) {
+      auto ps = fc::raw::pack_size( at );
+      aho.packed_action_trace.resize(ps);
+      fc::datastream<char*> ds( aho.packed_action_trace.data(), ps );
+      fc::raw::pack( ds, at );
+      aho.action_sequence_num = at.receipt->global_sequence;
+      aho.block_num = block_num;
+      aho.block_time = block_time;
+      aho.trx_id     = at.trx_id;
+   });
+
+   const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
+   for( auto n : accounts ) {
+      auto itr = idx.lower_bound( boost::make_tuple( account_name(n.to_uint64_t()+1), 0 ) );
+
+      int32_t asn = 0;
+      if( itr != idx.begin() ) --itr;
+      if( itr != idx.end() && itr->account == n )
+         asn = itr->account_sequence_num + 1;
+
+      db.create<account_history_object>( [&]( auto& aho ) {
+        aho.account = n;
+        aho.action_sequence_num = at.receipt->global_sequence;
+        aho.account_sequence_num = asn;
+      });
+   }
+}
+
+/// drops the history of block_num and later, which was recorded for blocks that have been forked out
+inline void remove_action_history_from_block( chainbase::database& db, uint32_t block_num ) {
+   auto& actions = db.get_index<action_history_index, by_action_sequence_num>();
+   const auto& accounts = db.get_index<account_history_index, by_action_sequence_num>();
+   while( !actions.empty() ) {
+      const auto& a = *actions.rbegin();
+      if( a.block_num < block_num )
+         break;
+      auto range = accounts.equal_range( a.action_sequence_num );
+      while( range.first != range.second )
+         db.remove( *range.first++ );
+      db.remove( a );
+   }
+}
+
+}
+
+CHAINBASE_SET_INDEX_TYPE(eosio::account_history_object, eosio::account_history_index)
+CHAINBASE_SET_INDEX_TYPE(eosio::action_history_object, eosio::action_history_index)
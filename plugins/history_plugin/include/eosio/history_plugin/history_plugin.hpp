@@ -111,6 +111,10 @@ class read_only {
  *     - any account named in auth list
  *
  *  A key will be linked to an account if the key is referneced in authorities of updateauth or newaccount
+ *
+ *  Account and action history is kept in its own database (history-dir) rather than in the chain state. The traces
+ *  of each accepted block are written to it by a dedicated thread, and history recorded for a block that is later
+ *  forked out is dropped when its replacement is written.
  */
 class history_plugin : public plugin<history_plugin> {
    public:
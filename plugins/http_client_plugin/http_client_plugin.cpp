@@ -40,16 +40,26 @@ void http_client_plugin::plugin_initialize(const variables_map& options) {
 
             try {
                my->add_cert( pem_str );
+               root_certs.push_back( pem_str );
             } catch ( const fc::exception& e ) {
                elog( "Failed to read PEM : ${e} \n${pem}\n", ("pem", pem_str)( "e", e.to_detail_string()));
             }
          }
       }
 
-      my->set_verify_peers( options.at( "https-client-validate-peers" ).as<bool>());
+      validate_peers = options.at( "https-client-validate-peers" ).as<bool>();
+      my->set_verify_peers( validate_peers );
    } FC_LOG_AND_RETHROW()
 }
 
+std::unique_ptr<http_client> http_client_plugin::make_client()const {
+   auto client = std::make_unique<http_client>();
+   for( const auto& pem : root_certs )
+      client->add_cert( pem );
+   client->set_verify_peers( validate_peers );
+   return client;
+}
+
 void http_client_plugin::plugin_startup() {
 
 }
@@ -2,6 +2,9 @@
 #include <appbase/application.hpp>
 #include <fc/network/http/http_client.hpp>
 
+#include <string>
+#include <vector>
+
 namespace eosio {
    using namespace appbase;
    using fc::http_client;
@@ -23,8 +26,14 @@ namespace eosio {
            return *my;
         }
 
+        /// a client of its own, trusting the same certificates and validating peers as get_client() does, for a
+        /// user posting from another thread; call after plugin_initialize
+        std::unique_ptr<http_client> make_client()const;
+
       private:
         std::unique_ptr<http_client> my;
+        std::vector<std::string>     root_certs;       ///< PEMs added to my
+        bool                         validate_peers = true;
    };
 
 }
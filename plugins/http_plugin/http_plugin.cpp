@@ -4,6 +4,8 @@
 #endif
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/app_thread_executor.hpp>
+#include <eosio/chain/span_tracer.hpp>
 
 #include <fc/network/ip.hpp>
 #include <fc/log/logger_config.hpp>
@@ -14,6 +16,10 @@
 
 #include <boost/asio.hpp>
 #include <boost/optional.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/gzip.hpp>
 
 #include <websocketpp/config/asio_client.hpp>
 #include <websocketpp/config/asio.hpp>
@@ -22,6 +28,7 @@
 #include <websocketpp/client.hpp>
 #include <websocketpp/logger/stub.hpp>
 
+#include <array>
 #include <thread>
 #include <memory>
 #include <regex>
@@ -168,6 +175,46 @@ namespace eosio {
          } catch(...) {}
          return 0;
       }
+
+      static size_t in_flight_sizeof( const url_response_body& b ) {
+         return b.is_serialized ? in_flight_sizeof( b.serialized ) : in_flight_sizeof( b.value );
+      }
+
+      /**
+       * @param accept_encoding - value of the request's Accept-Encoding header
+       * @return true if gzip (or *) is listed without q=0
+       */
+      static bool accepts_gzip( const string& accept_encoding ) {
+         vector<string> codings;
+         boost::split( codings, accept_encoding, boost::is_any_of( "," ) );
+         for( auto& c : codings ) {
+            vector<string> params;
+            boost::split( params, c, boost::is_any_of( ";" ) );
+            boost::trim( params[0] );
+            if( params[0] != "gzip" && params[0] != "*" )
+               continue;
+            bool rejected = false;
+            for( size_t i = 1; i < params.size(); ++i ) {
+               boost::trim( params[i] );
+               if( boost::starts_with( params[i], "q=" ) )
+                  rejected = std::strtod( params[i].c_str() + 2, nullptr ) == 0.0;
+            }
+            if( !rejected )
+               return true;
+         }
+         return false;
+      }
+
+      static string gzip_compress( const string& s ) {
+         namespace bio = boost::iostreams;
+         string out;
+         bio::filtering_ostream comp;
+         comp.push( bio::gzip_compressor( bio::gzip_params( bio::gzip::best_speed ) ) );
+         comp.push( bio::back_inserter( out ) );
+         bio::write( comp, s.data(), s.size() );
+         bio::close( comp );
+         return out;
+      }
    }
 
    using websocket_server_type = websocketpp::server<detail::asio_with_stub_log<websocketpp::transport::asio::basic_socket::endpoint>>;
@@ -183,6 +230,7 @@ namespace eosio {
       public:
          // key -> priority, url_handler
          map<string,detail::internal_url_handler>  url_handlers;
+         map<string,detail::internal_url_handler>  binary_url_handlers;
          optional<tcp::endpoint>  listen_endpoint;
          string                   access_control_allow_origin;
          string                   access_control_allow_headers;
@@ -197,6 +245,14 @@ namespace eosio {
          std::atomic<size_t>                         bytes_in_flight{0};
          size_t                                      max_bytes_in_flight = 0;
          fc::microseconds                            max_response_time{30*1000};
+         size_t                                      compress_min_size = 0; ///< 0 disables response compression
+         uint32_t                                    max_requests_per_endpoint = 0; ///< 0 is unlimited
+         fc::microseconds                            max_queue_time; ///< 0 disables shedding of stale app thread requests
+         fc::microseconds                            read_deadline; ///< 0 disables shedding of reads queued behind a block
+
+         std::atomic<uint64_t>                       requests{0};
+         std::atomic<uint64_t>                       rejected_requests{0};
+         std::array<std::atomic<uint64_t>, 6>        responses_by_class{}; ///< indexed by status code / 100
 
          optional<tcp::endpoint>  https_listen_endpoint;
          string                   https_cert_chain;
@@ -267,10 +323,15 @@ namespace eosio {
             return ctx;
          }
 
+         void count_response( int code ) {
+            responses_by_class[code > 0 && code < 600 ? code / 100 : 0].fetch_add( 1, std::memory_order_relaxed );
+         }
+
          template<class T>
-         static void handle_exception(detail::connection_ptr<T> con) {
+         void handle_exception(detail::connection_ptr<T> con) {
             string err = "Internal Service error, http: ";
             const auto deadline = fc::time_point::now() + fc::exception::format_time_limit;
+            count_response( websocketpp::http::status_code::internal_server_error );
             try {
                con->set_status( websocketpp::http::status_code::internal_server_error );
                try {
@@ -335,6 +396,8 @@ namespace eosio {
                con->set_body( fc::json::to_string( results, fc::time_point::maximum() ));
                con->set_status( websocketpp::http::status_code::too_many_requests );
                con->send_http_response();
+               rejected_requests.fetch_add( 1, std::memory_order_relaxed );
+               count_response( websocketpp::http::status_code::too_many_requests );
                return false;
             }
             return true;
@@ -362,7 +425,7 @@ namespace eosio {
             }
 
             void handle_exception()override {
-               http_plugin_impl::handle_exception<T>(_conn);
+               _impl.handle_exception<T>(_conn);
             }
 
             detail::connection_ptr<T> _conn;
@@ -451,33 +514,88 @@ namespace eosio {
             return in_flight<T>(std::forward<T>(object), impl);
          }
 
+         static fc::variant service_unavailable( const string& what ) {
+            error_results::error_info ei;
+            ei.code = websocketpp::http::status_code::service_unavailable;
+            ei.name = "Busy";
+            ei.what = what;
+            return fc::variant( error_results{websocketpp::http::status_code::service_unavailable, "Service Unavailable", ei} );
+         }
+
+         /**
+          * Wrap an internal_url_handler so that at most max_requests_per_endpoint requests for its url are
+          * queued or executing at once. Requests over the budget get a 503 without reaching the handler.
+          */
+         detail::internal_url_handler make_admission_controlled_url_handler( const string& url, detail::internal_url_handler next ) {
+            auto active = std::make_shared<std::atomic<uint32_t>>( 0 );
+            return [this, url, active, next=std::move(next)]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) {
+               if( !max_requests_per_endpoint ) {
+                  next( std::move(conn), std::move(r), std::move(b), std::move(then) );
+                  return;
+               }
+               if( active->fetch_add( 1 ) >= max_requests_per_endpoint ) {
+                  active->fetch_sub( 1 );
+                  fc_dlog( logger, "503 - too many requests in flight for ${u}", ("u", url) );
+                  rejected_requests.fetch_add( 1, std::memory_order_relaxed );
+                  then( websocketpp::http::status_code::service_unavailable, service_unavailable( "Too many requests in flight for " + url ) );
+                  return;
+               }
+               // the slot is released when the last copy of the response callback goes away
+               std::shared_ptr<void> release( nullptr, [active]( void* ) { active->fetch_sub( 1 ); } );
+               next( std::move(conn), std::move(r), std::move(b),
+                     [then=std::move(then), release=std::move(release)]( int code, url_response_body body ) {
+                        then( code, std::move(body) );
+                     } );
+            };
+         }
+
          /**
           * Make an internal_url_handler that will run the url_handler on the app() thread and then
           * return to the http thread pool for response processing
           *
           * @pre b.size() has been added to bytes_in_flight by caller
-          * @param priority - priority to post to the app thread at
+          * @param url - the url handled, which names its spans and its app thread statistics
+          * @param priority - priority to post to the app thread at; below medium it is a read that may be shed
           * @param next - the next handler for responses
           * @return the constructed internal_url_handler
           */
-         detail::internal_url_handler make_app_thread_url_handler( int priority, url_handler next ) {
+         detail::internal_url_handler make_app_thread_url_handler( const string& url, int priority, url_handler next ) {
             auto next_ptr = std::make_shared<url_handler>(std::move(next));
-            return [this, priority, next_ptr=std::move(next_ptr)]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) mutable {
+            const char* span_name = chain::span_tracing_compiled ? chain::span_tracer::intern( url ) : nullptr;
+            auto* origin = &chain::app_thread_stats::origin( "http:" + url, priority );
+            return [this, priority, next_ptr=std::move(next_ptr), span_name, origin]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) mutable {
                auto tracked_b = make_in_flight(std::move(b), *this);
                if (!conn->verify_max_bytes_in_flight()) {
                   return;
                }
 
+               // reads below medium priority give way to a block waiting behind them once past read_deadline
+               const fc::microseconds deadline = priority < appbase::priority::medium ? read_deadline : fc::microseconds();
+               auto shed = [this, then]() {
+                  fc_dlog( logger, "503 - read shed for a pending block" );
+                  rejected_requests.fetch_add( 1, std::memory_order_relaxed );
+                  then( websocketpp::http::status_code::service_unavailable, service_unavailable( "Request shed for a pending block" ) );
+               };
+
                // post to the app thread taking shared ownership of next (via std::shared_ptr),
                // sole ownership of the tracked body and the passed in parameters
-               app().post( priority, [next_ptr, conn=std::move(conn), r=std::move(r), tracked_b=std::move(tracked_b), then=std::move(then)]() mutable {
+               chain::app_thread_post_read( *origin, deadline, [this, next_ptr, span_name, conn=std::move(conn), r=std::move(r), tracked_b=std::move(tracked_b), then=std::move(then),
+                                      queued=fc::time_point::now()]() mutable {
+                  chain::scoped_span span( "http", span_name );
                   try {
+                     // the client has likely given up on a request that sat in the queue this long, do not spend the app thread on it
+                     if( max_queue_time.count() && fc::time_point::now() - queued > max_queue_time ) {
+                        fc_dlog( logger, "503 - request queued too long: ${r}", ("r", r) );
+                        rejected_requests.fetch_add( 1, std::memory_order_relaxed );
+                        then( websocketpp::http::status_code::service_unavailable, service_unavailable( "Request queued too long" ) );
+                        return;
+                     }
                      // call the `next` url_handler and wrap the response handler
                      (*next_ptr)( std::move( r ), std::move( *tracked_b ), std::move(then)) ;
                   } catch( ... ) {
                      conn->handle_exception();
                   }
-               } );
+               }, std::move(shed) );
             };
          }
 
@@ -485,11 +603,14 @@ namespace eosio {
           * Make an internal_url_handler that will run the url_handler directly
           *
           * @pre b.size() has been added to bytes_in_flight by caller
+          * @param url - the url handled, which names its spans
           * @param next - the next handler for responses
           * @return the constructed internal_url_handler
           */
-         detail::internal_url_handler make_http_thread_url_handler(url_handler next) {
-            return [next=std::move(next)]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) {
+         detail::internal_url_handler make_http_thread_url_handler(const string& url, url_handler next) {
+            const char* span_name = chain::span_tracing_compiled ? chain::span_tracer::intern( url ) : nullptr;
+            return [next=std::move(next), span_name]( detail::abstract_conn_ptr conn, string r, string b, url_response_callback then ) {
+               chain::scoped_span span( "http", span_name );
                try {
                   next(std::move(r), std::move(b), std::move(then));
                } catch( ... ) {
@@ -507,20 +628,33 @@ namespace eosio {
           */
          template<typename T>
          auto make_http_response_handler( detail::connection_ptr<T> con ) {
-            return [this, con]( int code, fc::variant response ) {
+            return [this, con]( int code, url_response_body response ) {
                auto tracked_response = make_in_flight(std::move(response), *this);
                if (!verify_max_bytes_in_flight(con)) {
                   return;
                }
 
                // post  back to an HTTP thread to to allow the response handler to be called from any thread
-               boost::asio::post( thread_pool->get_executor(), [this, con, code, tracked_response=std::move(tracked_response)]() {
+               boost::asio::post( thread_pool->get_executor(), [this, con, code, tracked_response=std::move(tracked_response)]() mutable {
                   try {
-                     std::string json = fc::json::to_string( *tracked_response, fc::time_point::now() + max_response_time );
+                     auto& response = *tracked_response;
+                     std::string json = response.is_serialized
+                                           ? std::move( response.serialized )
+                                           : fc::json::to_string( response.value, fc::time_point::now() + max_response_time );
+                     if( compress_min_size ) {
+                        con->append_header( "Vary", "Accept-Encoding" );
+                        if( json.size() >= compress_min_size && detail::accepts_gzip( con->get_request_header( "Accept-Encoding" ) ) ) {
+                           json = detail::gzip_compress( json );
+                           con->append_header( "Content-Encoding", "gzip" );
+                        }
+                     }
                      auto tracked_json = make_in_flight(std::move(json), *this);
+                     if( response.is_serialized )
+                        con->replace_header( "Content-type", response.content_type );
                      con->set_body( std::move( *tracked_json ) );
                      con->set_status( websocketpp::http::status_code::value( code ) );
                      con->send_http_response();
+                     count_response( code );
                   } catch( ... ) {
                      handle_exception<T>( con );
                   }
@@ -556,14 +690,26 @@ namespace eosio {
 
                con->append_header( "Content-type", "application/json" );
                con->defer_http_response();
+               requests.fetch_add( 1, std::memory_order_relaxed );
 
                if( !verify_max_bytes_in_flight( con ) ) return;
 
                std::string resource = con->get_uri()->get_resource();
-               auto handler_itr = url_handlers.find( resource );
-               if( handler_itr != url_handlers.end()) {
+               const detail::internal_url_handler* handler = nullptr;
+               if( !binary_url_handlers.empty() &&
+                   req.get_header( "Accept" ).find( "application/octet-stream" ) != std::string::npos ) {
+                  auto itr = binary_url_handlers.find( resource );
+                  if( itr != binary_url_handlers.end() )
+                     handler = &itr->second;
+               }
+               if( !handler ) {
+                  auto itr = url_handlers.find( resource );
+                  if( itr != url_handlers.end() )
+                     handler = &itr->second;
+               }
+               if( handler ) {
                   std::string body = con->get_request_body();
-                  handler_itr->second( make_abstract_conn_ptr<T>(con, *this), std::move( resource ), std::move( body ), make_http_response_handler<T>(con) );
+                  (*handler)( make_abstract_conn_ptr<T>(con, *this), std::move( resource ), std::move( body ), make_http_response_handler<T>(con) );
                } else {
                   fc_dlog( logger, "404 - not found: ${ep}", ("ep", resource) );
                   error_results results{websocketpp::http::status_code::not_found,
@@ -571,6 +717,7 @@ namespace eosio {
                   con->set_body( fc::json::to_string( results, fc::time_point::now() + max_response_time ));
                   con->set_status( websocketpp::http::status_code::not_found );
                   con->send_http_response();
+                  count_response( websocketpp::http::status_code::not_found );
                }
             } catch( ... ) {
                handle_exception<T>( con );
@@ -685,6 +832,14 @@ namespace eosio {
              "Maximum size in megabytes http_plugin should use for processing http requests. 503 error response when exceeded." )
             ("http-max-response-time-ms", bpo::value<uint32_t>()->default_value(30),
              "Maximum time for processing a request.")
+            ("http-max-in-flight-requests-per-endpoint", bpo::value<uint32_t>()->default_value(0),
+             "Maximum number of requests for a single endpoint that may be queued or executing at once. 503 error response when exceeded. 0 is unlimited.")
+            ("http-max-queue-time-ms", bpo::value<uint32_t>()->default_value(0),
+             "Requests that waited longer than this for the main thread get a 503 error response instead of being executed. 0 disables.")
+            ("http-read-deadline-ms", bpo::value<uint32_t>()->default_value(0),
+             "Requests below medium priority that waited longer than this for the main thread while a received block waits for it too get a 503 error response. 0 disables.")
+            ("http-compress-min-bytes", bpo::value<uint32_t>()->default_value(0),
+             "Gzip compress responses of at least this many bytes for clients that send \"Accept-Encoding: gzip\". 0 disables compression.")
             ("verbose-http-errors", bpo::bool_switch()->default_value(false),
              "Append the error log to HTTP responses")
             ("http-validate-host", boost::program_options::value<bool>()->default_value(true),
@@ -775,6 +930,10 @@ namespace eosio {
 
          my->max_bytes_in_flight = options.at( "http-max-bytes-in-flight-mb" ).as<uint32_t>() * 1024 * 1024;
          my->max_response_time = fc::microseconds( options.at("http-max-response-time-ms").as<uint32_t>() * 1000 );
+         my->compress_min_size = options.at( "http-compress-min-bytes" ).as<uint32_t>();
+         my->max_requests_per_endpoint = options.at( "http-max-in-flight-requests-per-endpoint" ).as<uint32_t>();
+         my->max_queue_time = fc::milliseconds( options.at( "http-max-queue-time-ms" ).as<uint32_t>() );
+         my->read_deadline = fc::milliseconds( options.at( "http-read-deadline-ms" ).as<uint32_t>() );
 
          //watch out for the returns above when adding new code here
       } FC_LOG_AND_RETHROW()
@@ -888,12 +1047,22 @@ namespace eosio {
 
    void http_plugin::add_handler(const string& url, const url_handler& handler, int priority) {
       fc_ilog( logger, "add api url: ${c}", ("c", url) );
-      my->url_handlers[url] = my->make_app_thread_url_handler(priority, handler);
+      my->url_handlers[url] = my->make_admission_controlled_url_handler(url, my->make_app_thread_url_handler(url, priority, handler));
    }
 
    void http_plugin::add_async_handler(const string& url, const url_handler& handler) {
       fc_ilog( logger, "add api url: ${c}", ("c", url) );
-      my->url_handlers[url] = my->make_http_thread_url_handler(handler);
+      my->url_handlers[url] = my->make_admission_controlled_url_handler(url, my->make_http_thread_url_handler(url, handler));
+   }
+
+   void http_plugin::add_binary_handler(const string& url, const url_handler& handler, int priority) {
+      fc_ilog( logger, "add binary api url: ${c}", ("c", url) );
+      my->binary_url_handlers[url] = my->make_admission_controlled_url_handler(url, my->make_app_thread_url_handler(url, priority, handler));
+   }
+
+   void http_plugin::add_async_binary_handler(const string& url, const url_handler& handler) {
+      fc_ilog( logger, "add binary api url: ${c}", ("c", url) );
+      my->binary_url_handlers[url] = my->make_admission_controlled_url_handler(url, my->make_http_thread_url_handler(url, handler));
    }
 
    void http_plugin::handle_exception( const char *api_name, const char *call_name, const string& body, url_response_callback cb ) {
@@ -969,6 +1138,25 @@ namespace eosio {
       return my->max_response_time;
    }
 
+   void http_plugin::parallel_for( size_t n, const std::function<void(size_t)>& f ) {
+      if( !my->thread_pool || n < 2 ) {
+         for( size_t i = 0; i < n; ++i )
+            f( i );
+         return;
+      }
+      my->thread_pool->parallel_for( n, f );
+   }
+
+   http_plugin::request_stats http_plugin::get_request_stats()const {
+      request_stats result;
+      result.requests        = my->requests.load( std::memory_order_relaxed );
+      result.rejected        = my->rejected_requests.load( std::memory_order_relaxed );
+      result.bytes_in_flight = my->bytes_in_flight.load( std::memory_order_relaxed );
+      for( size_t i = 0; i < result.responses_by_class.size(); ++i )
+         result.responses_by_class[i] = my->responses_by_class[i].load( std::memory_order_relaxed );
+      return result;
+   }
+
    std::istream& operator>>(std::istream& in, https_ecdh_curve_t& curve) {
       std::string s;
       in >> s;
@@ -1,19 +1,52 @@
 #pragma once
 #include <appbase/application.hpp>
 #include <fc/exception/exception.hpp>
+#include <fc/variant.hpp>
 
 #include <fc/reflect/reflect.hpp>
 
+#include <array>
+
 namespace eosio {
    using namespace appbase;
 
+   /**
+    * @brief Body of a URL handler response
+    *
+    * Either a value that http_plugin serializes to JSON, or a body the handler has already
+    * serialized: JSON text, which lets large responses skip building an fc::variant tree, or
+    * packed bytes from a binary handler.
+    */
+   struct url_response_body {
+      url_response_body() = default;
+      url_response_body( fc::variant v ) : value( std::move(v) ) {}
+
+      static url_response_body from_json( std::string json ) {
+         url_response_body b;
+         b.serialized = std::move(json);
+         b.is_serialized = true;
+         return b;
+      }
+
+      static url_response_body from_binary( std::string bytes ) {
+         url_response_body b = from_json( std::move(bytes) );
+         b.content_type = "application/octet-stream";
+         return b;
+      }
+
+      fc::variant value;
+      std::string serialized;
+      bool        is_serialized = false;
+      std::string content_type = "application/json";
+   };
+
    /**
     * @brief A callback function provided to a URL handler to
     * allow it to specify the HTTP response code and body
     *
     * Arguments: response_code, response_body
     */
-   using url_response_callback = std::function<void(int,fc::variant)>;
+   using url_response_callback = std::function<void(int,url_response_body)>;
 
    /**
     * @brief Callback type for a URL handler
@@ -89,6 +122,18 @@ namespace eosio {
               add_handler(call.first, call.second);
         }
 
+        /**
+         * Binary handlers serve the same url as a JSON handler to requests whose Accept header asks for
+         * application/octet-stream, and respond with url_response_body::from_binary. Requests that do
+         * not ask for it, and urls with no binary handler, go to the JSON handler as before.
+         */
+        void add_binary_handler(const string& url, const url_handler&, int priority = appbase::priority::medium_low);
+        void add_binary_api(const api_description& api, int priority = appbase::priority::medium_low) {
+           for (const auto& call : api)
+              add_binary_handler(call.first, call.second, priority);
+        }
+        void add_async_binary_handler(const string& url, const url_handler& handler);
+
         // standard exception handling for api handlers
         static void handle_exception( const char *api_name, const char *call_name, const string& body, url_response_callback cb );
 
@@ -106,6 +151,23 @@ namespace eosio {
         /// @return the configured http-max-response-time-ms
         fc::microseconds get_max_response_time()const;
 
+        /**
+         * Calls f(i) for every i in [0, n) on the calling thread and the http thread pool, returning when all calls
+         * have; the first exception thrown is rethrown. For fanning out the formatting of large responses, and safe
+         * to call from a handler running on the pool. Before startup everything runs on the calling thread.
+         */
+        void parallel_for( size_t n, const std::function<void(size_t)>& f );
+
+        /// counters since startup, kept in atomics so they can be read from any thread
+        struct request_stats {
+           uint64_t                requests = 0;
+           uint64_t                rejected = 0; ///< 429 or 503 for the in flight limits or for queueing too long
+           uint64_t                bytes_in_flight = 0;
+           std::array<uint64_t, 6> responses_by_class{}; ///< indexed by status code / 100, 0 for invalid codes
+        };
+
+        request_stats get_request_stats()const;
+
    private:
         std::shared_ptr<class http_plugin_impl> my;
    };
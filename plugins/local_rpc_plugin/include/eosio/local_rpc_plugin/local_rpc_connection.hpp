@@ -0,0 +1,62 @@
+#pragma once
+
+#include <eosio/local_rpc_plugin/local_rpc_plugin.hpp>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/io_context_strand.hpp>
+#include <boost/asio/local/stream_protocol.hpp>
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace eosio {
+
+/**
+ * One client of the local RPC socket: reads request frames and writes response frames, on a strand. Every request
+ * is handed to the handler, which must answer it with exactly one send, from any thread. Requests are pipelined up
+ * to max_in_flight unanswered ones and while less than max_queued_bytes of responses wait to be written; past
+ * either limit the connection stops reading until a response has been written.
+ */
+class local_rpc_connection : public std::enable_shared_from_this<local_rpc_connection> {
+public:
+   using socket_type = boost::asio::local::stream_protocol::socket;
+   using handler     = std::function<void( const std::shared_ptr<local_rpc_connection>&, local_rpc_request )>;
+
+   struct limits {
+      uint32_t max_frame_bytes  = 8 * 1024 * 1024;
+      uint32_t max_in_flight    = 32;
+      uint64_t max_queued_bytes = 32 * 1024 * 1024;
+   };
+
+   local_rpc_connection( socket_type s, boost::asio::io_context& ioc, const limits& l, handler h );
+
+   void start();
+
+   /// thread safe, may be called from any thread
+   void send( local_rpc_response res );
+   void send_result( uint32_t id, chain::bytes result );
+   void send_error( uint32_t id, std::string error );
+
+   void close();
+
+private:
+   void start_read();
+   /// reads the next request unless a limit is reached
+   void read_next();
+   void do_write();
+
+   socket_type                     socket;
+   boost::asio::io_context::strand strand;
+   const limits                    lim;
+   const handler                   handle;
+   uint32_t                        frame_size = 0;
+   std::vector<char>               frame;
+   std::deque<std::vector<char>>   write_queue;
+   uint32_t                        in_flight = 0;    ///< requests read and not answered on the socket yet
+   uint64_t                        queued_bytes = 0; ///< of write_queue
+   bool                            reading = false;
+};
+
+}
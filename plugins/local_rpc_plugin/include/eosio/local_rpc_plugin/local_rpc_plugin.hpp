@@ -0,0 +1,69 @@
+#pragma once
+
+#include <eosio/chain_plugin/chain_plugin.hpp>
+
+#include <appbase/application.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+/**
+ * Methods of the local RPC protocol. Every frame on the socket is a little-endian uint32 byte count followed by an
+ * fc::raw packed local_rpc_request (client to node) or local_rpc_response (node to client).
+ */
+enum class local_rpc_method : uint8_t {
+   get_block        = 0, ///< params: get_block_params, result: packed signed_block
+   get_table_rows   = 1, ///< params: get_table_rows_params, result: packed get_table_rows_binary_result
+   push_transaction = 2  ///< params: packed_transaction, result: local_rpc_push_result
+};
+
+struct local_rpc_request {
+   uint32_t     id     = 0; ///< echoed in the response; responses may arrive out of order
+   uint8_t      method = 0; ///< a local_rpc_method
+   chain::bytes params;
+};
+
+struct local_rpc_response {
+   uint32_t     id = 0;
+   bool         ok = false;
+   chain::bytes result; ///< set when ok
+   std::string  error;  ///< set when !ok
+};
+
+struct local_rpc_push_result {
+   chain::transaction_id_type                        id;
+   fc::optional<chain::transaction_receipt_header> receipt;
+   fc::microseconds                                  elapsed;
+};
+
+/**
+ * Serves a length-prefixed binary RPC on a unix domain socket for services running on the same host. Requests skip
+ * the HTTP framing and JSON handling of http_plugin; reads use the chain_plugin read-only threads when they are
+ * enabled and transactions are posted to the main thread like push_transaction.
+ */
+class local_rpc_plugin : public plugin<local_rpc_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((chain_plugin))
+
+   local_rpc_plugin();
+   local_rpc_plugin(const local_rpc_plugin&) = delete;
+   local_rpc_plugin(local_rpc_plugin&&) = delete;
+   local_rpc_plugin& operator=(const local_rpc_plugin&) = delete;
+   local_rpc_plugin& operator=(local_rpc_plugin&&) = delete;
+   virtual ~local_rpc_plugin() override;
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override;
+   void plugin_initialize(const variables_map& options);
+   void plugin_startup();
+   void plugin_shutdown();
+
+private:
+   std::shared_ptr<class local_rpc_plugin_impl> my;
+};
+
+}
+
+FC_REFLECT( eosio::local_rpc_request, (id)(method)(params) )
+FC_REFLECT( eosio::local_rpc_response, (id)(ok)(result)(error) )
+FC_REFLECT( eosio::local_rpc_push_result, (id)(receipt)(elapsed) )
@@ -0,0 +1,97 @@
+#include <eosio/local_rpc_plugin/local_rpc_connection.hpp>
+
+#include <fc/io/raw.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/asio/bind_executor.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <cstring>
+
+namespace eosio {
+
+local_rpc_connection::local_rpc_connection( socket_type s, boost::asio::io_context& ioc, const limits& l, handler h )
+: socket( std::move(s) ), strand( ioc ), lim( l ), handle( std::move(h) ) {}
+
+void local_rpc_connection::start() {
+   boost::asio::post( strand, [self = shared_from_this()]() { self->read_next(); } );
+}
+
+void local_rpc_connection::read_next() {
+   reading = in_flight < lim.max_in_flight && queued_bytes < lim.max_queued_bytes;
+   if( reading )
+      start_read();
+}
+
+void local_rpc_connection::start_read() {
+   boost::asio::async_read( socket, boost::asio::buffer( &frame_size, sizeof(frame_size) ),
+         boost::asio::bind_executor( strand, [self = shared_from_this()]( boost::system::error_code ec, size_t ) {
+      if( ec ) return self->close();
+      // frames are little-endian, as are all supported hosts
+      if( self->frame_size > self->lim.max_frame_bytes ) {
+         elog( "local rpc frame of ${n} bytes exceeds the limit, closing connection", ("n", self->frame_size) );
+         return self->close();
+      }
+      self->frame.resize( self->frame_size );
+      boost::asio::async_read( self->socket, boost::asio::buffer( self->frame ),
+            boost::asio::bind_executor( self->strand, [self]( boost::system::error_code ec, size_t ) {
+         if( ec ) return self->close();
+         local_rpc_request req;
+         try {
+            req = fc::raw::unpack<local_rpc_request>( self->frame );
+         } catch( const fc::exception& e ) {
+            elog( "invalid local rpc request, closing connection: ${e}", ("e", e.to_string()) );
+            return self->close();
+         }
+         ++self->in_flight;
+         self->handle( self, std::move(req) );
+         self->read_next();
+      } ) );
+   } ) );
+}
+
+void local_rpc_connection::send( local_rpc_response res ) {
+   auto packed = fc::raw::pack( res );
+   std::vector<char> out( sizeof(uint32_t) + packed.size() );
+   uint32_t size = packed.size();
+   memcpy( out.data(), &size, sizeof(size) );
+   memcpy( out.data() + sizeof(size), packed.data(), packed.size() );
+   boost::asio::post( strand, [self = shared_from_this(), out = std::move(out)]() mutable {
+      self->queued_bytes += out.size();
+      self->write_queue.emplace_back( std::move(out) );
+      if( self->write_queue.size() == 1 )
+         self->do_write();
+   } );
+}
+
+void local_rpc_connection::send_result( uint32_t id, chain::bytes result ) {
+   send( local_rpc_response{ id, true, std::move(result), {} } );
+}
+
+void local_rpc_connection::send_error( uint32_t id, std::string error ) {
+   send( local_rpc_response{ id, false, {}, std::move(error) } );
+}
+
+void local_rpc_connection::do_write() {
+   boost::asio::async_write( socket, boost::asio::buffer( write_queue.front() ),
+         boost::asio::bind_executor( strand, [self = shared_from_this()]( boost::system::error_code ec, size_t ) {
+      if( ec ) return self->close();
+      self->queued_bytes -= self->write_queue.front().size();
+      self->write_queue.pop_front();
+      if( self->in_flight > 0 )
+         --self->in_flight;
+      if( !self->write_queue.empty() )
+         self->do_write();
+      if( !self->reading )
+         self->read_next();
+   } ) );
+}
+
+void local_rpc_connection::close() {
+   boost::system::error_code ec;
+   socket.close( ec );
+}
+
+}
@@ -0,0 +1,206 @@
+#include <eosio/local_rpc_plugin/local_rpc_plugin.hpp>
+#include <eosio/local_rpc_plugin/local_rpc_connection.hpp>
+#include <eosio/chain/thread_utils.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/interprocess/exceptions.hpp>
+
+namespace eosio {
+
+static appbase::abstract_plugin& _local_rpc_plugin = app().register_plugin<local_rpc_plugin>();
+
+using namespace eosio::chain;
+using local_protocol = boost::asio::local::stream_protocol;
+
+class local_rpc_plugin_impl : public std::enable_shared_from_this<local_rpc_plugin_impl> {
+public:
+   using connection = local_rpc_connection;
+
+   chain_plugin*                           chain_plug = nullptr;
+   fc::optional<chain_apis::read_only>     ro_api;
+   boost::filesystem::path                 socket_path;
+   local_rpc_connection::limits            limits;
+   uint16_t                                thread_pool_size = 1;
+   fc::optional<named_thread_pool>         thread_pool;
+   std::unique_ptr<local_protocol::acceptor> acceptor;
+
+   void listen();
+   void do_accept();
+   void dispatch( const std::shared_ptr<connection>& conn, local_rpc_request req );
+   void push_transaction( const std::shared_ptr<connection>& conn, uint32_t id, const bytes& params );
+};
+
+/// runs f and reports its failure to the client instead of throwing
+template<typename F>
+static void call_and_report( const std::shared_ptr<local_rpc_connection>& conn, uint32_t id, F&& f ) {
+   try {
+      f();
+   } catch( const boost::interprocess::bad_alloc& ) {
+      chain_plugin::handle_db_exhaustion();
+   } catch( const std::bad_alloc& ) {
+      chain_plugin::handle_bad_alloc();
+   } catch( const fc::exception& e ) {
+      conn->send_error( id, e.to_string() );
+   } catch( const std::exception& e ) {
+      conn->send_error( id, e.what() );
+   } catch( ... ) {
+      conn->send_error( id, "unknown exception" );
+   }
+}
+
+void local_rpc_plugin_impl::dispatch( const std::shared_ptr<connection>& conn, local_rpc_request req ) {
+   std::function<bytes()> read;
+   switch( static_cast<local_rpc_method>( req.method ) ) {
+   case local_rpc_method::get_block:
+      read = [this, params = std::move(req.params)]() {
+         auto block = ro_api->get_block_binary( fc::raw::unpack<chain_apis::read_only::get_block_params>( params ) );
+         return bytes( block.begin(), block.end() );
+      };
+      break;
+   case local_rpc_method::get_table_rows:
+      read = [this, params = std::move(req.params)]() {
+         auto rows = ro_api->get_table_rows_binary( fc::raw::unpack<chain_apis::read_only::get_table_rows_params>( params ) );
+         return bytes( rows.begin(), rows.end() );
+      };
+      break;
+   case local_rpc_method::push_transaction:
+      return push_transaction( conn, req.id, req.params );
+   default:
+      return conn->send_error( req.id, "unknown local rpc method " + std::to_string( req.method ) );
+   }
+
+   auto task = [this, conn, id = req.id, read = std::move(read)]() {
+      call_and_report( conn, id, [&]() { conn->send_result( id, ro_api->read_state( read ) ); } );
+   };
+   if( chain_plug->read_only_threads_enabled() )
+      chain_plug->post_read_only( std::move(task) );
+   else
+      app().post( priority::medium_low, std::move(task) );
+}
+
+void local_rpc_plugin_impl::push_transaction( const std::shared_ptr<connection>& conn, uint32_t id, const bytes& params ) {
+   packed_transaction_ptr trx;
+   try {
+      trx = std::make_shared<packed_transaction>( fc::raw::unpack<packed_transaction>( params ) );
+   } catch( const fc::exception& e ) {
+      return conn->send_error( id, e.to_string() );
+   }
+   app().post( priority::medium, [this, conn, id, trx = std::move(trx)]() {
+      call_and_report( conn, id, [&]() {
+         EOS_ASSERT( chain_plug->api_accept_transactions(), missing_chain_api_plugin_exception,
+                     "Not allowed, node has api-accept-transactions = false" );
+         app().get_method<plugin_interface::incoming::methods::transaction_async>()( trx, true,
+               [conn, id]( const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result ) {
+            if( result.contains<fc::exception_ptr>() ) {
+               conn->send_error( id, result.get<fc::exception_ptr>()->to_string() );
+               return;
+            }
+            const auto& trace = result.get<transaction_trace_ptr>();
+            if( trace->except ) {
+               conn->send_error( id, trace->except->to_string() );
+               return;
+            }
+            conn->send_result( id, fc::raw::pack( local_rpc_push_result{ trace->id, trace->receipt, trace->elapsed } ) );
+         } );
+      } );
+   } );
+}
+
+void local_rpc_plugin_impl::listen() {
+   boost::system::error_code ec;
+   boost::filesystem::remove( socket_path, ec ); // stale socket of a previous run
+   local_protocol::endpoint endpoint( socket_path.string() );
+   acceptor = std::make_unique<local_protocol::acceptor>( thread_pool->get_executor() );
+   acceptor->open( endpoint.protocol() );
+   acceptor->bind( endpoint );
+   acceptor->listen();
+   do_accept();
+}
+
+void local_rpc_plugin_impl::do_accept() {
+   acceptor->async_accept( [self = shared_from_this()]( boost::system::error_code ec, local_protocol::socket socket ) {
+      if( ec ) {
+         if( ec == boost::asio::error::operation_aborted )
+            return;
+         elog( "local rpc accept failed: ${m}", ("m", ec.message()) );
+      } else {
+         std::make_shared<connection>( std::move(socket), self->thread_pool->get_executor(), self->limits,
+               [self]( const std::shared_ptr<connection>& conn, local_rpc_request req ) {
+            self->dispatch( conn, std::move(req) );
+         } )->start();
+      }
+      self->do_accept();
+   } );
+}
+
+local_rpc_plugin::local_rpc_plugin()
+: my( std::make_shared<local_rpc_plugin_impl>() ) {}
+
+local_rpc_plugin::~local_rpc_plugin() {}
+
+void local_rpc_plugin::set_program_options( options_description&, options_description& cfg ) {
+   cfg.add_options()
+         ("local-rpc-socket-path", bpo::value<string>()->default_value(""),
+          "The filename (relative to data-dir) of a unix socket serving the binary local RPC protocol for co-located "
+          "services; blank disables it.")
+         ("local-rpc-max-frame-bytes", bpo::value<uint32_t>()->default_value(my->limits.max_frame_bytes),
+          "Largest local RPC request accepted, in bytes")
+         ("local-rpc-max-in-flight", bpo::value<uint32_t>()->default_value(my->limits.max_in_flight),
+          "Most unanswered local RPC requests of one connection; past it the connection is not read until a response "
+          "has been written")
+         ("local-rpc-max-queued-bytes", bpo::value<uint64_t>()->default_value(my->limits.max_queued_bytes),
+          "Most bytes of responses waiting to be written to one local RPC connection; past it the connection is not "
+          "read until they have been written")
+         ("local-rpc-threads", bpo::value<uint16_t>()->default_value(my->thread_pool_size),
+          "Number of worker threads handling local RPC connections")
+         ;
+}
+
+void local_rpc_plugin::plugin_initialize( const variables_map& options ) {
+   try {
+      my->chain_plug = app().find_plugin<chain_plugin>();
+      EOS_ASSERT( my->chain_plug, chain::missing_chain_plugin_exception, "" );
+
+      const auto path = options.at( "local-rpc-socket-path" ).as<string>();
+      if( !path.empty() ) {
+         my->socket_path = path;
+         if( my->socket_path.is_relative() )
+            my->socket_path = app().data_dir() / my->socket_path;
+      }
+      my->limits.max_frame_bytes = options.at( "local-rpc-max-frame-bytes" ).as<uint32_t>();
+      my->limits.max_in_flight = options.at( "local-rpc-max-in-flight" ).as<uint32_t>();
+      my->limits.max_queued_bytes = options.at( "local-rpc-max-queued-bytes" ).as<uint64_t>();
+      EOS_ASSERT( my->limits.max_in_flight > 0, chain::plugin_config_exception,
+                  "local-rpc-max-in-flight must be greater than 0" );
+      my->thread_pool_size = options.at( "local-rpc-threads" ).as<uint16_t>();
+      EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
+                  "local-rpc-threads ${n} must be greater than 0", ("n", my->thread_pool_size) );
+   } FC_LOG_AND_RETHROW()
+}
+
+void local_rpc_plugin::plugin_startup() {
+   if( my->socket_path.empty() )
+      return;
+   try {
+      my->ro_api.emplace( my->chain_plug->get_read_only_api() );
+      my->thread_pool.emplace( "lrpc", my->thread_pool_size );
+      my->listen();
+      ilog( "local rpc listening on ${p}", ("p", my->socket_path.string()) );
+   } FC_LOG_AND_RETHROW()
+}
+
+void local_rpc_plugin::plugin_shutdown() {
+   if( my->acceptor ) {
+      boost::system::error_code ec;
+      my->acceptor->close( ec );
+   }
+   if( my->thread_pool )
+      my->thread_pool->stop();
+   if( !my->socket_path.empty() ) {
+      boost::system::error_code ec;
+      boost::filesystem::remove( my->socket_path, ec );
+   }
+}
+
+}
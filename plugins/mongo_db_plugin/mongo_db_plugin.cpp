@@ -1,13 +1,16 @@
 #include <eosio/mongo_db_plugin/mongo_db_plugin.hpp>
 #include <eosio/mongo_db_plugin/bson.hpp>
+#include <eosio/chain/action_filter.hpp>
 #include <eosio/chain/eosio_contract.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/transaction.hpp>
 #include <eosio/chain/types.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
+#include <fc/scoped_exit.hpp>
 #include <fc/utf8.hpp>
 #include <fc/variant.hpp>
 
@@ -15,6 +18,9 @@
 #include <boost/chrono.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <condition_variable>
+#include <deque>
+#include <map>
 #include <queue>
 #include <thread>
 #include <mutex>
@@ -43,23 +49,6 @@ using chain::packed_transaction;
 
 static appbase::abstract_plugin& _mongo_db_plugin = app().register_plugin<mongo_db_plugin>();
 
-struct filter_entry {
-   name receiver;
-   name action;
-   name actor;
-
-   friend bool operator<( const filter_entry& a, const filter_entry& b ) {
-      return std::tie( a.receiver, a.action, a.actor ) < std::tie( b.receiver, b.action, b.actor );
-   }
-
-   //            receiver          action       actor
-   bool match( const name& rr, const name& an, const name& ar ) const {
-      return (receiver.to_uint64_t() == 0 || receiver == rr) &&
-             (action.to_uint64_t() == 0 || action == an) &&
-             (actor.to_uint64_t() == 0 || actor == ar);
-   }
-};
-
 class mongo_db_plugin_impl {
 public:
    mongo_db_plugin_impl();
@@ -70,7 +59,10 @@ public:
    fc::optional<boost::signals2::scoped_connection> accepted_transaction_connection;
    fc::optional<boost::signals2::scoped_connection> applied_transaction_connection;
 
-   void consume_blocks();
+   struct bulk_inserter;
+   template<typename Entry> struct consumer;
+   template<typename Entry, typename F> void consume( consumer<Entry>& c, const char* name, F&& process );
+   void open_collections( mongocxx::client& mongo_conn );
 
    void accepted_block( const chain::block_state_ptr& );
    void applied_irreversible_block(const chain::block_state_ptr&);
@@ -84,13 +76,40 @@ public:
    void _process_accepted_block( const chain::block_state_ptr& );
    void process_irreversible_block(const chain::block_state_ptr&);
    void _process_irreversible_block(const chain::block_state_ptr&);
+   void process_irreversible_transactions(const chain::block_state_ptr&);
+   void _process_irreversible_transactions(const chain::block_state_ptr&);
 
    optional<abi_serializer> get_abi_serializer( account_name n );
    template<typename T> fc::variant to_variant_with_abi( const T& obj );
+   template<typename T, typename Resolver> fc::variant to_variant_with_abi( const T& obj, Resolver resolver );
+
+   /// abi_serializer of every account in a run of traces, shared read only by the encode threads
+   using abi_map = std::map<account_name, optional<abi_serializer>>;
+   /// resolver result referring into an abi_map, so abi_serializer::to_variant does not copy the serializer
+   struct abi_ref {
+      const abi_serializer* abi = nullptr;
+      bool valid()const { return abi != nullptr; }
+      const abi_serializer& operator*()const { return *abi; }
+      const abi_serializer* operator->()const { return abi; }
+   };
+   /// documents of one transaction trace, encoded on the encode thread pool
+   struct encoded_trace {
+      std::vector<bsoncxx::document::value>  action_traces;
+      fc::optional<bsoncxx::document::value> transaction_trace;
+   };
+   static bool sets_abi( const chain::transaction_trace& t );
+   void collect_abis( const chain::transaction_trace& t, abi_map& abis );
+   encoded_trace encode_applied_transaction( const chain::transaction_trace_ptr& t, const abi_map& abis,
+                                             const std::chrono::milliseconds& now );
+   void process_applied_transactions( const std::deque<chain::transaction_trace_ptr>& traces );
+   bsoncxx::document::value make_action_trace_doc( const chain::transaction_trace& t, const fc::variant& v,
+                                                   const std::chrono::milliseconds& now );
+   bsoncxx::document::value make_transaction_trace_doc( const chain::transaction_trace& t, const fc::variant& v,
+                                                        const std::chrono::milliseconds& now );
 
    void purge_abi_cache();
 
-   bool add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
+   bool add_action_trace( bulk_inserter& bulk_action_traces, const chain::action_trace& atrace,
                           const chain::transaction_trace_ptr& t,
                           bool executed, const std::chrono::milliseconds& now,
                           bool& write_ttrace );
@@ -114,7 +133,7 @@ public:
    void wipe_database();
    void create_expiration_index(mongocxx::collection& collection, uint32_t expire_after_seconds);
 
-   template<typename Queue, typename Entry> void queue(Queue& queue, const Entry& e);
+   template<typename Entry> void queue(consumer<Entry>& c, Entry e);
 
    bool configured{false};
    bool wipe_database_on_startup{false};
@@ -123,8 +142,8 @@ public:
 
    bool is_producer = false;
    bool filter_on_star = true;
-   std::set<filter_entry> filter_on;
-   std::set<filter_entry> filter_out;
+   chain::action_filter filter_on;
+   chain::action_filter filter_out;
    bool update_blocks_via_block_num = false;
    bool store_blocks = true;
    bool store_block_states = true;
@@ -137,32 +156,74 @@ public:
    mongocxx::instance mongo_inst;
    fc::optional<mongocxx::pool> mongo_pool;
 
-   // consum thread
-   mongocxx::collection _accounts;
-   mongocxx::collection _trans;
-   mongocxx::collection _trans_traces;
-   mongocxx::collection _action_traces;
-   mongocxx::collection _block_states;
-   mongocxx::collection _blocks;
-   mongocxx::collection _pub_keys;
-   mongocxx::collection _account_controls;
+   // each consumer thread works with its own client and collections
+   static thread_local mongocxx::collection _accounts;
+   static thread_local mongocxx::collection _trans;
+   static thread_local mongocxx::collection _trans_traces;
+   static thread_local mongocxx::collection _action_traces;
+   static thread_local mongocxx::collection _block_states;
+   static thread_local mongocxx::collection _blocks;
+   static thread_local mongocxx::collection _pub_keys;
+   static thread_local mongocxx::collection _account_controls;
+
+   /// unordered bulk insert into one collection, executed whenever it holds bulk_bytes of documents
+   struct bulk_inserter {
+      mongocxx::collection&              collection;
+      const char* const                  desc;
+      fc::optional<mongocxx::bulk_write> bulk;
+      size_t                             bytes = 0;
+
+      void insert( bsoncxx::document::view doc, size_t max_bytes ) {
+         if( !bulk ) {
+            mongocxx::options::bulk_write bulk_opts;
+            bulk_opts.ordered( false );
+            bulk.emplace( collection.create_bulk_write( bulk_opts ) );
+         }
+         bulk->append( mongocxx::model::insert_one{doc} );
+         bytes += doc.length();
+         if( bytes >= max_bytes )
+            flush();
+      }
+
+      void flush();
+   };
+   static thread_local bulk_inserter _action_traces_bulk;
+   static thread_local bulk_inserter _trans_traces_bulk;
+
+   /// queue drained by one consumer thread, which owns the collections written from its entries
+   template<typename Entry>
+   struct consumer {
+      std::deque<Entry>       queue;
+      std::mutex              mtx;
+      std::condition_variable condition; ///< entries were queued or the plugin is shutting down
+      std::condition_variable space;     ///< the consumer took the queued entries or exited
+      std::thread             thread;
+      bool                    exited = false;   ///< the consumer thread is gone, guarded by mtx
+      bool                    dropping = false; ///< entries queued after the consumer exited are dropped, guarded by mtx
+   };
+
+   /// an accepted transaction, or a block whose transactions became irreversible
+   struct transaction_entry {
+      chain::transaction_metadata_ptr trx;
+      chain::block_state_ptr          irreversible;
+   };
+   /// an accepted block, or one that became irreversible
+   struct block_entry {
+      chain::block_state_ptr block;
+      bool                   irreversible = false;
+   };
 
    size_t max_queue_size = 0;
-   int queue_sleep_time = 0;
+   size_t bulk_bytes = 4 * 1024 * 1024;
+   uint32_t encode_threads = 2;
+   fc::optional<eosio::chain::named_thread_pool> encode_thread_pool;
    size_t abi_cache_size = 0;
-   std::deque<chain::transaction_metadata_ptr> transaction_metadata_queue;
-   std::deque<chain::transaction_metadata_ptr> transaction_metadata_process_queue;
-   std::deque<chain::transaction_trace_ptr> transaction_trace_queue;
-   std::deque<chain::transaction_trace_ptr> transaction_trace_process_queue;
-   std::deque<chain::block_state_ptr> block_state_queue;
-   std::deque<chain::block_state_ptr> block_state_process_queue;
-   std::deque<chain::block_state_ptr> irreversible_block_state_queue;
-   std::deque<chain::block_state_ptr> irreversible_block_state_process_queue;
-   std::mutex mtx;
-   std::condition_variable condition;
-   std::thread consume_thread;
+   consumer<chain::transaction_trace_ptr> trace_consumer;       ///< action_traces, transaction_traces, accounts, pub_keys, account_controls
+   consumer<transaction_entry>            transaction_consumer; ///< transactions
+   consumer<block_entry>                  block_consumer;       ///< blocks, block_states
    std::atomic_bool done{false};
    std::atomic_bool startup{true};
+   std::mutex abi_cache_mtx; ///< guards abi_cache_index, used by every consumer
    fc::optional<chain::chain_id_type> chain_id;
    fc::microseconds abi_serializer_max_time;
 
@@ -220,44 +281,8 @@ const std::string mongo_db_plugin_impl::account_controls_col = "account_controls
 bool mongo_db_plugin_impl::filter_include( const account_name& receiver, const action_name& act_name,
                                            const vector<chain::permission_level>& authorization ) const
 {
-   bool include = false;
-   if( filter_on_star ) {
-      include = true;
-   } else {
-      auto itr = std::find_if( filter_on.cbegin(), filter_on.cend(), [&receiver, &act_name]( const auto& filter ) {
-         return filter.match( receiver, act_name, {} );
-      } );
-      if( itr != filter_on.cend() ) {
-         include = true;
-      } else {
-         for( const auto& a : authorization ) {
-            auto itr = std::find_if( filter_on.cbegin(), filter_on.cend(), [&receiver, &act_name, &a]( const auto& filter ) {
-               return filter.match( receiver, act_name, a.actor );
-            } );
-            if( itr != filter_on.cend() ) {
-               include = true;
-               break;
-            }
-         }
-      }
-   }
-
-   if( !include ) { return false; }
-   if( filter_out.empty() ) { return true; }
-
-   auto itr = std::find_if( filter_out.cbegin(), filter_out.cend(), [&receiver, &act_name]( const auto& filter ) {
-      return filter.match( receiver, act_name, {} );
-   } );
-   if( itr != filter_out.cend() ) { return false; }
-
-   for( const auto& a : authorization ) {
-      auto itr = std::find_if( filter_out.cbegin(), filter_out.cend(), [&receiver, &act_name, &a]( const auto& filter ) {
-         return filter.match( receiver, act_name, a.actor );
-      } );
-      if( itr != filter_out.cend() ) { return false; }
-   }
-
-   return true;
+   if( !filter_on_star && !filter_on.match( receiver, act_name, authorization ) ) { return false; }
+   return !filter_out.match( receiver, act_name, authorization );
 }
 
 bool mongo_db_plugin_impl::filter_include( const transaction& trx ) const
@@ -284,31 +309,45 @@ bool mongo_db_plugin_impl::filter_include( const transaction& trx ) const
 }
 
 
-template<typename Queue, typename Entry>
-void mongo_db_plugin_impl::queue( Queue& queue, const Entry& e ) {
-   std::unique_lock<std::mutex> lock( mtx );
-   auto queue_size = queue.size();
-   if( queue_size > max_queue_size ) {
-      lock.unlock();
-      condition.notify_one();
-      queue_sleep_time += 10;
-      if( queue_sleep_time > 1000 )
-         wlog("queue size: ${q}", ("q", queue_size));
-      std::this_thread::sleep_for( std::chrono::milliseconds( queue_sleep_time ));
-      lock.lock();
-   } else {
-      queue_sleep_time -= 10;
-      if( queue_sleep_time < 0 ) queue_sleep_time = 0;
+thread_local mongocxx::collection mongo_db_plugin_impl::_accounts;
+thread_local mongocxx::collection mongo_db_plugin_impl::_trans;
+thread_local mongocxx::collection mongo_db_plugin_impl::_trans_traces;
+thread_local mongocxx::collection mongo_db_plugin_impl::_action_traces;
+thread_local mongocxx::collection mongo_db_plugin_impl::_block_states;
+thread_local mongocxx::collection mongo_db_plugin_impl::_blocks;
+thread_local mongocxx::collection mongo_db_plugin_impl::_pub_keys;
+thread_local mongocxx::collection mongo_db_plugin_impl::_account_controls;
+thread_local mongo_db_plugin_impl::bulk_inserter mongo_db_plugin_impl::_action_traces_bulk{_action_traces, "action traces"};
+thread_local mongo_db_plugin_impl::bulk_inserter mongo_db_plugin_impl::_trans_traces_bulk{_trans_traces, "transaction traces"};
+
+template<typename Entry>
+void mongo_db_plugin_impl::queue( consumer<Entry>& c, Entry e ) {
+   std::unique_lock<std::mutex> lock( c.mtx );
+   if( c.queue.size() >= max_queue_size ) {
+      // the consumer takes everything queued at once, so this only waits until its current batch is done
+      wlog( "mongo queue size: ${q}", ("q", c.queue.size()) );
+      while( !c.space.wait_for( lock, std::chrono::seconds( 10 ),
+                                [&]() { return c.queue.size() < max_queue_size || done || c.exited; } ) ) {
+         wlog( "mongo queue size: ${q}, still waiting for its consumer", ("q", c.queue.size()) );
+      }
    }
-   queue.emplace_back( e );
+   if( c.exited ) {
+      if( !c.dropping && !done ) {
+         c.dropping = true;
+         elog( "mongo_db_plugin consumer exited, dropping what is queued for it and shutting down" );
+         app().quit();
+      }
+      return;
+   }
+   c.queue.emplace_back( std::move( e ) );
    lock.unlock();
-   condition.notify_one();
+   c.condition.notify_one();
 }
 
 void mongo_db_plugin_impl::accepted_transaction( const chain::transaction_metadata_ptr& t ) {
    try {
       if( store_transactions ) {
-         queue( transaction_metadata_queue, t );
+         queue( transaction_consumer, transaction_entry{t, {}} );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_transaction ${e}", ("e", e.to_string()));
@@ -344,7 +383,7 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
       if( !is_producer && !t->producer_block_id.valid() )
          return;
       // always queue since account information always gathered
-      queue( transaction_trace_queue, t );
+      queue( trace_consumer, chain::transaction_trace_ptr( t ) );
    } catch (fc::exception& e) {
       elog("FC Exception while applied_transaction ${e}", ("e", e.to_string()));
    } catch (std::exception& e) {
@@ -356,8 +395,11 @@ void mongo_db_plugin_impl::applied_transaction( const chain::transaction_trace_p
 
 void mongo_db_plugin_impl::applied_irreversible_block( const chain::block_state_ptr& bs ) {
    try {
-      if( store_blocks || store_block_states || store_transactions ) {
-         queue( irreversible_block_state_queue, bs );
+      if( store_blocks || store_block_states ) {
+         queue( block_consumer, block_entry{bs, true} );
+      }
+      if( store_transactions ) {
+         queue( transaction_consumer, transaction_entry{{}, bs} );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while applied_irreversible_block ${e}", ("e", e.to_string()));
@@ -376,7 +418,7 @@ void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
          }
       }
       if( store_blocks || store_block_states ) {
-         queue( block_state_queue, bs );
+         queue( block_consumer, block_entry{bs, false} );
       }
    } catch (fc::exception& e) {
       elog("FC Exception while accepted_block ${e}", ("e", e.to_string()));
@@ -387,124 +429,68 @@ void mongo_db_plugin_impl::accepted_block( const chain::block_state_ptr& bs ) {
    }
 }
 
-void mongo_db_plugin_impl::consume_blocks() {
+void mongo_db_plugin_impl::open_collections( mongocxx::client& mongo_conn ) {
+   _accounts = mongo_conn[db_name][accounts_col];
+   _trans = mongo_conn[db_name][trans_col];
+   _trans_traces = mongo_conn[db_name][trans_traces_col];
+   _action_traces = mongo_conn[db_name][action_traces_col];
+   _blocks = mongo_conn[db_name][blocks_col];
+   _block_states = mongo_conn[db_name][block_states_col];
+   _pub_keys = mongo_conn[db_name][pub_keys_col];
+   _account_controls = mongo_conn[db_name][account_controls_col];
+}
+
+template<typename Entry, typename F>
+void mongo_db_plugin_impl::consume( consumer<Entry>& c, const char* name, F&& process ) {
+   auto on_exit = fc::make_scoped_exit( [&c]() {
+      {
+         std::lock_guard<std::mutex> g( c.mtx );
+         c.exited = true;
+      }
+      c.space.notify_all();
+   } );
    try {
       auto mongo_client = mongo_pool->acquire();
-      auto& mongo_conn = *mongo_client;
-
-      _accounts = mongo_conn[db_name][accounts_col];
-      _trans = mongo_conn[db_name][trans_col];
-      _trans_traces = mongo_conn[db_name][trans_traces_col];
-      _action_traces = mongo_conn[db_name][action_traces_col];
-      _blocks = mongo_conn[db_name][blocks_col];
-      _block_states = mongo_conn[db_name][block_states_col];
-      _pub_keys = mongo_conn[db_name][pub_keys_col];
-      _account_controls = mongo_conn[db_name][account_controls_col];
+      open_collections( *mongo_client );
 
+      std::deque<Entry> batch;
       while (true) {
-         std::unique_lock<std::mutex> lock(mtx);
-         while ( transaction_metadata_queue.empty() &&
-                 transaction_trace_queue.empty() &&
-                 block_state_queue.empty() &&
-                 irreversible_block_state_queue.empty() &&
-                 !done ) {
-            condition.wait(lock);
-         }
-
-         // capture for processing
-         size_t transaction_metadata_size = transaction_metadata_queue.size();
-         if (transaction_metadata_size > 0) {
-            transaction_metadata_process_queue = move(transaction_metadata_queue);
-            transaction_metadata_queue.clear();
-         }
-         size_t transaction_trace_size = transaction_trace_queue.size();
-         if (transaction_trace_size > 0) {
-            transaction_trace_process_queue = move(transaction_trace_queue);
-            transaction_trace_queue.clear();
-         }
-         size_t block_state_size = block_state_queue.size();
-         if (block_state_size > 0) {
-            block_state_process_queue = move(block_state_queue);
-            block_state_queue.clear();
-         }
-         size_t irreversible_block_size = irreversible_block_state_queue.size();
-         if (irreversible_block_size > 0) {
-            irreversible_block_state_process_queue = move(irreversible_block_state_queue);
-            irreversible_block_state_queue.clear();
-         }
-
+         std::unique_lock<std::mutex> lock( c.mtx );
+         c.condition.wait( lock, [&]() { return !c.queue.empty() || done; } );
+         batch = std::move( c.queue );
+         c.queue.clear();
          lock.unlock();
+         c.space.notify_all();
 
-         if (done) {
-            ilog("draining queue, size: ${q}", ("q", transaction_metadata_size + transaction_trace_size + block_state_size + irreversible_block_size));
-         }
-
-         // process transactions
-         auto start_time = fc::time_point::now();
-         auto size = transaction_trace_process_queue.size();
-         while (!transaction_trace_process_queue.empty()) {
-            const auto& t = transaction_trace_process_queue.front();
-            process_applied_transaction(t);
-            transaction_trace_process_queue.pop_front();
-         }
-         auto time = fc::time_point::now() - start_time;
-         auto per = size > 0 ? time.count()/size : 0;
-         if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_applied_transaction,  time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
-
-         start_time = fc::time_point::now();
-         size = transaction_metadata_process_queue.size();
-         while (!transaction_metadata_process_queue.empty()) {
-            const auto& t = transaction_metadata_process_queue.front();
-            process_accepted_transaction(t);
-            transaction_metadata_process_queue.pop_front();
-         }
-         time = fc::time_point::now() - start_time;
-         per = size > 0 ? time.count()/size : 0;
-         if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_accepted_transaction, time per: ${p}, size: ${s}, time: ${t}", ("s", size)( "t", time )( "p", per ));
-
-         // process blocks
-         start_time = fc::time_point::now();
-         size = block_state_process_queue.size();
-         while (!block_state_process_queue.empty()) {
-            const auto& bs = block_state_process_queue.front();
-            process_accepted_block( bs );
-            block_state_process_queue.pop_front();
-         }
-         time = fc::time_point::now() - start_time;
-         per = size > 0 ? time.count()/size : 0;
-         if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_accepted_block,       time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
-
-         // process irreversible blocks
-         start_time = fc::time_point::now();
-         size = irreversible_block_state_process_queue.size();
-         while (!irreversible_block_state_process_queue.empty()) {
-            const auto& bs = irreversible_block_state_process_queue.front();
-            process_irreversible_block(bs);
-            irreversible_block_state_process_queue.pop_front();
-         }
-         time = fc::time_point::now() - start_time;
-         per = size > 0 ? time.count()/size : 0;
-         if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
-            ilog( "process_irreversible_block,   time per: ${p}, size: ${s}, time: ${t}", ("s", size)("t", time)("p", per) );
-
-         if( transaction_metadata_size == 0 &&
-             transaction_trace_size == 0 &&
-             block_state_size == 0 &&
-             irreversible_block_size == 0 &&
-             done ) {
+         if( batch.empty() && done )
             break;
+         if( done )
+            ilog( "draining ${n} queue, size: ${q}", ("n", name)("q", batch.size()) );
+
+         // a batch that fails is logged and dropped, the next one is written
+         try {
+            auto start_time = fc::time_point::now();
+            process( batch );
+            _action_traces_bulk.flush();
+            _trans_traces_bulk.flush();
+            auto time = fc::time_point::now() - start_time;
+            auto per = time.count() / batch.size();
+            if( time > fc::microseconds(500000) ) // reduce logging, .5 secs
+               ilog( "${n}, time per: ${p}, size: ${s}, time: ${t}", ("n", name)("s", batch.size())("t", time)("p", per) );
+         } catch (fc::exception& e) {
+            elog("FC Exception while consuming ${n}, dropped ${s} entries: ${e}", ("n", name)("s", batch.size())("e", e.to_string()));
+         } catch (std::exception& e) {
+            elog("STD Exception while consuming ${n}, dropped ${s} entries: ${e}", ("n", name)("s", batch.size())("e", e.what()));
          }
+         batch.clear();
       }
-      ilog("mongo_db_plugin consume thread shutdown gracefully");
+      ilog( "mongo_db_plugin ${n} consumer shutdown gracefully", ("n", name) );
    } catch (fc::exception& e) {
-      elog("FC Exception while consuming block ${e}", ("e", e.to_string()));
+      elog("FC Exception while consuming ${n} ${e}", ("n", name)("e", e.to_string()));
    } catch (std::exception& e) {
-      elog("STD Exception while consuming block ${e}", ("e", e.what()));
+      elog("STD Exception while consuming ${n} ${e}", ("n", name)("e", e.what()));
    } catch (...) {
-      elog("Unknown exception while consuming block");
+      elog("Unknown exception while consuming ${n}", ("n", name));
    }
 }
 
@@ -577,6 +563,20 @@ bsoncxx::oid make_custom_oid() {
 
 } // anonymous namespace
 
+void mongo_db_plugin_impl::bulk_inserter::flush() {
+   if( !bulk )
+      return;
+   try {
+      if( !bulk->execute() ) {
+         EOS_ASSERT( false, chain::mongo_db_insert_fail, "Bulk ${desc} insert failed", ("desc", desc) );
+      }
+   } catch( ... ) {
+      handle_mongo_exception( std::string( desc ) + " insert", __LINE__ );
+   }
+   bulk.reset();
+   bytes = 0;
+}
+
 void mongo_db_plugin_impl::purge_abi_cache() {
    if( abi_cache_index.size() < abi_cache_size ) return;
 
@@ -593,7 +593,7 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
    using bsoncxx::builder::basic::make_document;
    if( n.good()) {
       try {
-
+         std::lock_guard<std::mutex> g( abi_cache_mtx );
          auto itr = abi_cache_index.find( n );
          if( itr != abi_cache_index.end() ) {
             abi_cache_index.modify( itr, []( auto& entry ) {
@@ -673,9 +673,13 @@ optional<abi_serializer> mongo_db_plugin_impl::get_abi_serializer( account_name
 
 template<typename T>
 fc::variant mongo_db_plugin_impl::to_variant_with_abi( const T& obj ) {
+   return to_variant_with_abi( obj, [&]( account_name n ) { return get_abi_serializer( n ); } );
+}
+
+template<typename T, typename Resolver>
+fc::variant mongo_db_plugin_impl::to_variant_with_abi( const T& obj, Resolver resolver ) {
    fc::variant pretty_output;
-   abi_serializer::to_variant( obj, pretty_output,
-                               [&]( account_name n ) { return get_abi_serializer( n ); },
+   abi_serializer::to_variant( obj, pretty_output, resolver,
                                abi_serializer::create_yield_function( abi_serializer_max_time ) );
    return pretty_output;
 }
@@ -721,6 +725,20 @@ void mongo_db_plugin_impl::process_irreversible_block(const chain::block_state_p
   }
 }
 
+void mongo_db_plugin_impl::process_irreversible_transactions(const chain::block_state_ptr& bs) {
+  try {
+     if( start_block_reached ) {
+        _process_irreversible_transactions( bs );
+     }
+  } catch (fc::exception& e) {
+     elog("FC Exception while processing irreversible transactions: ${e}", ("e", e.to_detail_string()));
+  } catch (std::exception& e) {
+     elog("STD Exception while processing irreversible transactions: ${e}", ("e", e.what()));
+  } catch (...) {
+     elog("Unknown exception while processing irreversible transactions");
+  }
+}
+
 void mongo_db_plugin_impl::process_accepted_block( const chain::block_state_ptr& bs ) {
    try {
       if( start_block_reached ) {
@@ -813,7 +831,7 @@ void mongo_db_plugin_impl::_process_accepted_transaction( const chain::transacti
 }
 
 bool
-mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces, const chain::action_trace& atrace,
+mongo_db_plugin_impl::add_action_trace( bulk_inserter& bulk_action_traces, const chain::action_trace& atrace,
                                         const chain::transaction_trace_ptr& t,
                                         bool executed, const std::chrono::milliseconds& now,
                                         bool& write_ttrace )
@@ -830,52 +848,70 @@ mongo_db_plugin_impl::add_action_trace( mongocxx::bulk_write& bulk_action_traces
                     filter_include( atrace.receiver, atrace.act.name, atrace.act.authorization );
    write_ttrace |= in_filter;
    if( start_block_reached && store_action_traces && in_filter ) {
-      auto action_traces_doc = bsoncxx::builder::basic::document{};
-      // improve data distributivity when using mongodb sharding
-      action_traces_doc.append( kvp( "_id", make_custom_oid() ) );
-
-      auto v = to_variant_with_abi( atrace );
-      try {
-         action_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
-      } catch( bsoncxx::exception& e ) {
-         elog( "Unable to convert action trace to BSON: ${e}", ("e", e.what()) );
-         try {
-            elog( "  JSON: ${j}", ("j", fc::json::to_string( v, fc::time_point::now() + fc::exception::format_time_limit )) );
-         } catch(...) {}
-      }
-      if( t->receipt.valid() ) {
-         action_traces_doc.append( kvp( "trx_status", std::string( t->receipt->status ) ) );
-      }
-      action_traces_doc.append( kvp( "createdAt", b_date{now} ) );
-
-      mongocxx::model::insert_one insert_op{action_traces_doc.view()};
-      bulk_action_traces.append( insert_op );
+      bulk_action_traces.insert( make_action_trace_doc( *t, to_variant_with_abi( atrace ), now ).view(), bulk_bytes );
       added = true;
    }
 
    return added;
 }
 
+bsoncxx::document::value
+mongo_db_plugin_impl::make_action_trace_doc( const chain::transaction_trace& t, const fc::variant& v,
+                                             const std::chrono::milliseconds& now )
+{
+   using namespace bsoncxx::types;
+   using bsoncxx::builder::basic::kvp;
 
-void mongo_db_plugin_impl::_process_applied_transaction( const chain::transaction_trace_ptr& t ) {
+   auto action_traces_doc = bsoncxx::builder::basic::document{};
+   // improve data distributivity when using mongodb sharding
+   action_traces_doc.append( kvp( "_id", make_custom_oid() ) );
+
+   try {
+      action_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
+   } catch( bsoncxx::exception& e ) {
+      elog( "Unable to convert action trace to BSON: ${e}", ("e", e.what()) );
+      try {
+         elog( "  JSON: ${j}", ("j", fc::json::to_string( v, fc::time_point::now() + fc::exception::format_time_limit )) );
+      } catch(...) {}
+   }
+   if( t.receipt.valid() ) {
+      action_traces_doc.append( kvp( "trx_status", std::string( t.receipt->status ) ) );
+   }
+   action_traces_doc.append( kvp( "createdAt", b_date{now} ) );
+   return action_traces_doc.extract();
+}
+
+bsoncxx::document::value
+mongo_db_plugin_impl::make_transaction_trace_doc( const chain::transaction_trace& t, const fc::variant& v,
+                                                  const std::chrono::milliseconds& now )
+{
    using namespace bsoncxx::types;
    using bsoncxx::builder::basic::kvp;
 
    auto trans_traces_doc = bsoncxx::builder::basic::document{};
+   try {
+      trans_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
+   } catch( bsoncxx::exception& e ) {
+      elog( "Unable to convert transaction to BSON: ${e}", ("e", e.what()) );
+      try {
+         elog( "  JSON: ${j}", ("j", fc::json::to_string( v, fc::time_point::now() + fc::exception::format_time_limit )) );
+      } catch(...) {}
+   }
+   trans_traces_doc.append( kvp( "createdAt", b_date{now} ) );
+   return trans_traces_doc.extract();
+}
 
+
+void mongo_db_plugin_impl::_process_applied_transaction( const chain::transaction_trace_ptr& t ) {
    auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
          std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
-   mongocxx::options::bulk_write bulk_opts;
-   bulk_opts.ordered(false);
-   mongocxx::bulk_write bulk_action_traces = _action_traces.create_bulk_write(bulk_opts);
-   bool write_atraces = false;
    bool write_ttrace = false; // filters apply to transaction_traces as well
    bool executed = t->receipt.valid() && t->receipt->status == chain::transaction_receipt_header::executed;
 
    for( const auto& atrace : t->action_traces ) {
       try {
-         write_atraces |= add_action_trace( bulk_action_traces, atrace, t, executed, now, write_ttrace );
+         add_action_trace( _action_traces_bulk, atrace, t, executed, now, write_ttrace );
       } catch(...) {
          handle_mongo_exception("add action traces", __LINE__);
       }
@@ -887,41 +923,128 @@ void mongo_db_plugin_impl::_process_applied_transaction( const chain::transactio
 
    if( store_transaction_traces && write_ttrace ) {
       try {
-         auto v = to_variant_with_abi( *t );
-         try {
-            trans_traces_doc.append( bsoncxx::builder::concatenate_doc{to_bson( v )} );
-         } catch( bsoncxx::exception& e ) {
-            elog( "Unable to convert transaction to BSON: ${e}", ("e", e.what()) );
-            try {
-               elog( "  JSON: ${j}", ("j", fc::json::to_string( v, fc::time_point::now() + fc::exception::format_time_limit )) );
-            } catch(...) {}
-         }
-         trans_traces_doc.append( kvp( "createdAt", b_date{now} ) );
-
-         try {
-            if( !_trans_traces.insert_one( trans_traces_doc.view() ) ) {
-               EOS_ASSERT( false, chain::mongo_db_insert_fail, "Failed to insert trans ${id}", ("id", t->id) );
-            }
-         } catch( ... ) {
-            handle_mongo_exception( "trans_traces insert: " + t->id.str(), __LINE__ );
-         }
+         _trans_traces_bulk.insert( make_transaction_trace_doc( *t, to_variant_with_abi( *t ), now ).view(), bulk_bytes );
       } catch( ... ) {
          handle_mongo_exception( "trans_traces serialization: " + t->id.str(), __LINE__ );
       }
    }
+}
+
+bool mongo_db_plugin_impl::sets_abi( const chain::transaction_trace& t ) {
+   for( const auto& atrace : t.action_traces ) {
+      if( atrace.receiver == chain::config::system_account_name && atrace.act.account == chain::config::system_account_name &&
+          atrace.act.name == setabi )
+         return true;
+   }
+   return false;
+}
+
+void mongo_db_plugin_impl::collect_abis( const chain::transaction_trace& t, abi_map& abis ) {
+   for( const auto& atrace : t.action_traces ) {
+      if( abis.find( atrace.act.account ) == abis.end() )
+         abis.emplace( atrace.act.account, get_abi_serializer( atrace.act.account ) );
+   }
+   if( t.failed_dtrx_trace )
+      collect_abis( *t.failed_dtrx_trace, abis );
+}
 
-   // insert action_traces
-   if( write_atraces ) {
+mongo_db_plugin_impl::encoded_trace
+mongo_db_plugin_impl::encode_applied_transaction( const chain::transaction_trace_ptr& t, const abi_map& abis,
+                                                  const std::chrono::milliseconds& now )
+{
+   auto resolver = [&abis]( account_name n ) {
+      auto itr = abis.find( n );
+      return abi_ref{ itr != abis.end() && itr->second ? &*itr->second : nullptr };
+   };
+
+   encoded_trace result;
+   bool write_ttrace = false; // filters apply to transaction_traces as well
+   for( const auto& atrace : t->action_traces ) {
       try {
-         if( !bulk_action_traces.execute() ) {
-            EOS_ASSERT( false, chain::mongo_db_insert_fail,
-                        "Bulk action traces insert failed for transaction trace: ${id}", ("id", t->id) );
-         }
+         const bool in_filter = filter_include( atrace.receiver, atrace.act.name, atrace.act.authorization );
+         write_ttrace |= in_filter;
+         if( store_action_traces && in_filter )
+            result.action_traces.emplace_back( make_action_trace_doc( *t, to_variant_with_abi( atrace, resolver ), now ) );
+      } catch(...) {
+         handle_mongo_exception("add action traces", __LINE__);
+      }
+   }
+
+   if( store_transaction_traces && write_ttrace ) {
+      try {
+         result.transaction_trace.emplace( make_transaction_trace_doc( *t, to_variant_with_abi( *t, resolver ), now ) );
       } catch( ... ) {
-         handle_mongo_exception( "action traces insert", __LINE__ );
+         handle_mongo_exception( "trans_traces serialization: " + t->id.str(), __LINE__ );
       }
    }
+   return result;
+}
+
+void mongo_db_plugin_impl::process_applied_transactions( const std::deque<chain::transaction_trace_ptr>& traces ) {
+   if( !encode_thread_pool || !start_block_reached || !(store_action_traces || store_transaction_traces) ) {
+      for( const auto& t : traces )
+         process_applied_transaction( t );
+      return;
+   }
+
+   auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+         std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
+
+   auto itr = traces.begin();
+   while( itr != traces.end() ) {
+      // a setabi changes how the traces after it are encoded, so it ends the run encoded in parallel
+      auto end = std::find_if( itr, traces.end(), []( const auto& t ) { return sets_abi( *t ); } );
+
+      if( itr != end ) {
+         abi_map abis;
+         for( auto i = itr; i != end; ++i )
+            collect_abis( **i, abis );
+
+         const size_t count = std::distance( itr, end );
+         const size_t per_task = std::max<size_t>( 16, (count + encode_threads - 1) / encode_threads );
+         std::vector<std::future<std::vector<encoded_trace>>> tasks;
+         for( auto begin = itr; begin != end; ) {
+            auto last = begin + std::min<size_t>( per_task, std::distance( begin, end ) );
+            tasks.emplace_back( chain::async_thread_pool( encode_thread_pool->get_executor(), [this, begin, last, &abis, &now]() {
+               std::vector<encoded_trace> encoded;
+               encoded.reserve( std::distance( begin, last ) );
+               for( auto i = begin; i != last; ++i )
+                  encoded.emplace_back( encode_applied_transaction( *i, abis, now ) );
+               return encoded;
+            } ) );
+            begin = last;
+         }
 
+         // account updates stay on this thread, in trace order
+         for( auto i = itr; i != end; ++i ) {
+            const auto& t = *i;
+            if( !t->receipt.valid() || t->receipt->status != chain::transaction_receipt_header::executed )
+               continue;
+            for( const auto& atrace : t->action_traces ) {
+               if( atrace.receiver == chain::config::system_account_name ) {
+                  try {
+                     update_account( atrace.act );
+                  } catch(...) {
+                     handle_mongo_exception("add action traces", __LINE__);
+                  }
+               }
+            }
+         }
+
+         for( auto& task : tasks ) {
+            for( auto& e : task.get() ) {
+               for( const auto& doc : e.action_traces )
+                  _action_traces_bulk.insert( doc.view(), bulk_bytes );
+               if( e.transaction_trace )
+                  _trans_traces_bulk.insert( e.transaction_trace->view(), bulk_bytes );
+            }
+         }
+      }
+
+      if( end != traces.end() )
+         process_applied_transaction( *end++ );
+      itr = end;
+   }
 }
 
 void mongo_db_plugin_impl::_process_accepted_block( const chain::block_state_ptr& bs ) {
@@ -1052,6 +1175,19 @@ void mongo_db_plugin_impl::_process_irreversible_block(const chain::block_state_
 
       _block_states.update_one( make_document( kvp( "_id", ir_block->view()["_id"].get_oid() ) ), update_doc.view() );
    }
+}
+
+void mongo_db_plugin_impl::_process_irreversible_transactions(const chain::block_state_ptr& bs)
+{
+   using namespace bsoncxx::types;
+   using bsoncxx::builder::basic::make_document;
+   using bsoncxx::builder::basic::kvp;
+
+   const auto block_id = bs->block->id();
+   const auto block_id_str = block_id.str();
+
+   auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+         std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()});
 
    if( store_transactions ) {
       const auto block_num = bs->block->block_num();
@@ -1273,7 +1409,10 @@ void mongo_db_plugin_impl::update_account(const chain::action& act)
                std::chrono::microseconds{fc::time_point::now().time_since_epoch().count()} );
          auto setabi = act.data_as<chain::setabi>();
 
-         abi_cache_index.erase( setabi.account );
+         {
+            std::lock_guard<std::mutex> g( abi_cache_mtx );
+            abi_cache_index.erase( setabi.account );
+         }
 
          auto account = find_account( _accounts, setabi.account );
          if( !account ) {
@@ -1319,9 +1458,16 @@ mongo_db_plugin_impl::~mongo_db_plugin_impl() {
       try {
          ilog( "mongo_db_plugin shutdown in process please be patient this can take a few minutes" );
          done = true;
-         condition.notify_one();
+         for( auto* c : { &trace_consumer.condition, &transaction_consumer.condition, &block_consumer.condition } )
+            c->notify_all();
+         for( auto* c : { &trace_consumer.space, &transaction_consumer.space, &block_consumer.space } )
+            c->notify_all();
 
-         consume_thread.join();
+         trace_consumer.thread.join();
+         transaction_consumer.thread.join();
+         block_consumer.thread.join();
+         if( encode_thread_pool )
+            encode_thread_pool->stop();
 
          mongo_pool.reset();
       } catch( std::exception& e ) {
@@ -1483,11 +1629,38 @@ void mongo_db_plugin_impl::init() {
       handle_mongo_exception( "mongo init", __LINE__ );
    }
 
-   ilog("starting db plugin thread");
+   ilog("starting db plugin threads");
+
+   if( encode_threads > 0 )
+      encode_thread_pool.emplace( "mongo-enc", encode_threads );
 
-   consume_thread = std::thread( [this] {
-      fc::set_os_thread_name( "mongodb" );
-      consume_blocks();
+   trace_consumer.thread = std::thread( [this] {
+      fc::set_os_thread_name( "mongo-trc" );
+      consume( trace_consumer, "process_applied_transaction", [this]( const std::deque<chain::transaction_trace_ptr>& traces ) {
+         process_applied_transactions( traces );
+      } );
+   } );
+   transaction_consumer.thread = std::thread( [this] {
+      fc::set_os_thread_name( "mongo-trx" );
+      consume( transaction_consumer, "process_accepted_transaction", [this]( const std::deque<transaction_entry>& entries ) {
+         for( const auto& e : entries ) {
+            if( e.trx )
+               process_accepted_transaction( e.trx );
+            else
+               process_irreversible_transactions( e.irreversible );
+         }
+      } );
+   } );
+   block_consumer.thread = std::thread( [this] {
+      fc::set_os_thread_name( "mongo-blk" );
+      consume( block_consumer, "process_accepted_block", [this]( const std::deque<block_entry>& entries ) {
+         for( const auto& e : entries ) {
+            if( e.irreversible )
+               process_irreversible_block( e.block );
+            else
+               process_accepted_block( e.block );
+         }
+      } );
    } );
 
    startup = false;
@@ -1510,7 +1683,11 @@ void mongo_db_plugin::set_program_options(options_description& cli, options_desc
 {
    cfg.add_options()
          ("mongodb-queue-size,q", bpo::value<uint32_t>()->default_value(1024),
-         "The target queue size between nodeos and MongoDB plugin thread.")
+         "The target queue size between nodeos and each MongoDB plugin consumer thread.")
+         ("mongodb-encode-threads", bpo::value<uint32_t>()->default_value(2),
+          "Number of threads encoding action traces and transaction traces to BSON, 0 encodes them on the trace consumer thread.")
+         ("mongodb-bulk-bytes", bpo::value<uint32_t>()->default_value(4 * 1024 * 1024),
+          "The size in bytes at which queued action trace and transaction trace inserts are sent to MongoDB as one unordered bulk write.")
          ("mongodb-abi-cache-size", bpo::value<uint32_t>()->default_value(2048),
           "The maximum size of the abi cache for serializing data.")
          ("mongodb-wipe", bpo::bool_switch()->default_value(false),
@@ -1568,6 +1745,12 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
          if( options.count( "mongodb-queue-size" )) {
             my->max_queue_size = options.at( "mongodb-queue-size" ).as<uint32_t>();
          }
+         if( options.count( "mongodb-encode-threads" )) {
+            my->encode_threads = options.at( "mongodb-encode-threads" ).as<uint32_t>();
+         }
+         if( options.count( "mongodb-bulk-bytes" )) {
+            my->bulk_bytes = options.at( "mongodb-bulk-bytes" ).as<uint32_t>();
+         }
          if( options.count( "mongodb-abi-cache-size" )) {
             my->abi_cache_size = options.at( "mongodb-abi-cache-size" ).as<uint32_t>();
             EOS_ASSERT( my->abi_cache_size > 0, chain::plugin_config_exception, "mongodb-abi-cache-size > 0 required" );
@@ -1607,8 +1790,7 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
                std::vector<std::string> v;
                boost::split( v, s, boost::is_any_of( ":" ));
                EOS_ASSERT( v.size() == 3, fc::invalid_arg_exception, "Invalid value ${s} for --mongodb-filter-on", ("s", s));
-               filter_entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
-               my->filter_on.insert( fe );
+               my->filter_on.add( {eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])} );
             }
          } else {
             my->filter_on_star = true;
@@ -1619,8 +1801,7 @@ void mongo_db_plugin::plugin_initialize(const variables_map& options)
                std::vector<std::string> v;
                boost::split( v, s, boost::is_any_of( ":" ));
                EOS_ASSERT( v.size() == 3, fc::invalid_arg_exception, "Invalid value ${s} for --mongodb-filter-out", ("s", s));
-               filter_entry fe{eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])};
-               my->filter_out.insert( fe );
+               my->filter_out.add( {eosio::chain::name(v[0]), eosio::chain::name(v[1]), eosio::chain::name(v[2])} );
             }
          }
          if( options.count( "producer-name") ) {
@@ -0,0 +1,41 @@
+#pragma once
+#include <eosio/net_plugin/protocol.hpp>
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace eosio {
+
+   /**
+    * Round trip time in microseconds of a time_message exchange: our transmit (org), the peer's receive (rec) and
+    * transmit (xmt) and our receive (dst), in nanoseconds. The time the peer held the message is excluded.
+    */
+   inline int64_t time_message_rtt_us( tstamp org, tstamp rec, tstamp xmt, tstamp dst ) {
+      return std::max<int64_t>( ((dst - org) - (xmt - rec)) / 1000, 0 );
+   }
+
+   /// smoothed round trip time after a new sample, -1 for not yet measured; weights the sample 1/8 like TCP's srtt
+   inline int64_t smoothed_rtt_us( int64_t prev_us, int64_t sample_us ) {
+      return prev_us < 0 ? sample_us : (7 * prev_us + sample_us) / 8;
+   }
+
+   /// relay order of broadcast blocks: producer peers first, then by round trip time, unmeasured last
+   inline std::pair<bool, uint64_t> block_relay_rank( bool producer_peer, int64_t rtt_us ) {
+      return { !producer_peer, rtt_us < 0 ? std::numeric_limits<uint64_t>::max() : uint64_t( rtt_us ) };
+   }
+
+   /**
+    * Sorts peers into relay order by rank_of(peer), a block_relay_rank, and returns how many of the leading peers are
+    * sent a broadcast block in full: every producer peer and then fanout others, or all peers when fanout is 0.
+    */
+   template<typename Peer, typename RankOf>
+   size_t order_block_relay( std::vector<Peer>& peers, uint32_t fanout, RankOf&& rank_of ) {
+      std::stable_sort( peers.begin(), peers.end(), [&]( const Peer& l, const Peer& r ) { return rank_of( l ) < rank_of( r ); } );
+      if( fanout == 0 ) return peers.size();
+      const size_t producer_peers = std::count_if( peers.begin(), peers.end(), [&]( const Peer& p ) { return !rank_of( p ).first; } );
+      return std::min( peers.size(), producer_peers + fanout );
+   }
+
+}
@@ -11,6 +11,37 @@ namespace eosio {
       bool              connecting = false;
       bool              syncing    = false;
       handshake_message last_handshake;
+      uint64_t          write_count = 0; ///< completed socket writes, write_bytes / write_count is the average bytes per write
+      uint64_t          write_bytes = 0;
+   };
+
+   struct latency_histogram_status {
+      vector<uint32_t>  bucket_bounds_ms; ///< upper bound of each bucket, counts has one more entry for larger latencies
+      vector<uint64_t>  counts;
+      uint64_t          count  = 0;
+      uint64_t          sum_us = 0;
+   };
+
+   struct connection_metrics {
+      string            peer;
+      uint32_t          connection_id = 0;
+      uint32_t          write_queue_bytes = 0;
+      vector<uint32_t>  write_lane_bytes;       ///< queued bytes per lane: block, sync, control, trx
+      uint32_t          write_in_flight_bytes = 0;
+      uint64_t          outstanding_read_bytes = 0;
+      uint32_t          trx_in_progress_bytes = 0;
+      uint64_t          write_count = 0;
+      uint64_t          write_bytes = 0;
+      uint64_t          blocks_received = 0;
+      int64_t           rtt_us = -1;            ///< smoothed time_message round trip, -1 until measured
+      bool              producer_peer = false;  ///< receives broadcast blocks ahead of the relay fan-out
+      latency_histogram_status block_propagation;      ///< block timestamp to receipt from this peer
+      latency_histogram_status block_receive_to_apply; ///< receipt to accepted by the chain
+      latency_histogram_status sync_chunk_rtt;         ///< sync request sent to first block received
+   };
+
+   struct net_metrics {
+      vector<connection_metrics> connections;
    };
 
    class net_plugin : public appbase::plugin<net_plugin>
@@ -31,6 +62,7 @@ namespace eosio {
         string                       disconnect( const string& endpoint );
         optional<connection_status>  status( const string& endpoint )const;
         vector<connection_status>    connections()const;
+        net_metrics                  metrics()const;
 
       private:
         std::shared_ptr<class net_plugin_impl> my;
@@ -38,4 +70,9 @@ namespace eosio {
 
 }
 
-FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake) )
+FC_REFLECT( eosio::connection_status, (peer)(connecting)(syncing)(last_handshake)(write_count)(write_bytes) )
+FC_REFLECT( eosio::latency_histogram_status, (bucket_bounds_ms)(counts)(count)(sum_us) )
+FC_REFLECT( eosio::connection_metrics, (peer)(connection_id)(write_queue_bytes)(write_lane_bytes)(write_in_flight_bytes)
+            (outstanding_read_bytes)(trx_in_progress_bytes)(write_count)(write_bytes)(blocks_received)(rtt_us)(producer_peer)
+            (block_propagation)(block_receive_to_apply)(sync_chunk_rtt) )
+FC_REFLECT( eosio::net_metrics, (connections) )
@@ -135,6 +135,24 @@ namespace eosio {
       uint32_t end_block{0};
    };
 
+   /**
+    * zlib compressed packed signed_block, only sent to peers that advertise proto_compressed_blocks
+    */
+   struct compressed_block_message {
+      vector<char> packed_block;
+   };
+
+   /**
+    * signed_block with the packed transactions the receiving peer already has replaced by their ids,
+    * only sent to peers that advertise proto_compact_blocks
+    */
+   struct compact_block_message {
+      signed_block_header           header;
+      vector<transaction_receipt>   transactions;
+      extensions_type               block_extensions;
+      vector<uint32_t>              elided_trxs; ///< indexes into transactions to restore from the receiver's transaction cache
+   };
+
    using net_message = static_variant<handshake_message,
                                       chain_size_message,
                                       go_away_message,
@@ -143,7 +161,9 @@ namespace eosio {
                                       request_message,
                                       sync_request_message,
                                       signed_block,         // which = 7
-                                      packed_transaction>;  // which = 8
+                                      packed_transaction,   // which = 8
+                                      compressed_block_message, // which = 9
+                                      compact_block_message>;   // which = 10
 
 } // namespace eosio
 
@@ -162,6 +182,8 @@ FC_REFLECT( eosio::time_message, (org)(rec)(xmt)(dst) )
 FC_REFLECT( eosio::notice_message, (known_trx)(known_blocks) )
 FC_REFLECT( eosio::request_message, (req_trx)(req_blocks) )
 FC_REFLECT( eosio::sync_request_message, (start_block)(end_block) )
+FC_REFLECT( eosio::compressed_block_message, (packed_block) )
+FC_REFLECT( eosio::compact_block_message, (header)(transactions)(block_extensions)(elided_trxs) )
 
 /**
  *
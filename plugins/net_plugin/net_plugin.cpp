@@ -2,11 +2,16 @@
 
 #include <eosio/net_plugin/net_plugin.hpp>
 #include <eosio/net_plugin/protocol.hpp>
+#include <eosio/net_plugin/block_relay.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/block.hpp>
+#include <eosio/chain/merkle.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/app_thread_executor.hpp>
+#include <eosio/chain/span_tracer.hpp>
+#include <eosio/chain/transaction_latency.hpp>
 #include <eosio/producer_plugin/producer_plugin.hpp>
 #include <eosio/chain/contract_types.hpp>
 
@@ -23,8 +28,15 @@
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/asio/ip/host_name.hpp>
 #include <boost/asio/steady_timer.hpp>
+#include <boost/iostreams/filtering_stream.hpp>
+#include <boost/iostreams/device/back_inserter.hpp>
+#include <boost/iostreams/filter/zlib.hpp>
 
+#include <array>
 #include <atomic>
+#include <deque>
+#include <limits>
+#include <set>
 #include <shared_mutex>
 
 using namespace eosio::chain::plugin_interface;
@@ -43,6 +55,8 @@ namespace eosio {
    using fc::time_point_sec;
    using eosio::chain::transaction_id_type;
    using eosio::chain::sha256_less;
+   using eosio::chain::scoped_span;
+   using eosio::chain::span_trace_id;
 
    class connection;
 
@@ -64,6 +78,8 @@ namespace eosio {
       time_point_sec  expires;        /// time after which this may be purged.
       uint32_t        block_num = 0;  /// block transaction was included in
       uint32_t        connection_id = 0;
+      packed_transaction_ptr trx;     /// transaction itself, used to rebuild compact blocks
+      std::shared_ptr<vector<char>> send_buffer; /// message as received, relayed as is and released on bcast or rejection
    };
 
    struct by_expiry;
@@ -121,6 +137,40 @@ namespace eosio {
       > peer_block_state_index;
 
 
+   /**
+    * Index split into shards by id, each guarded by its own mutex, so connection strands working on different
+    * blocks or transactions do not contend. Single id operations lock only the shard of that id, whole index
+    * operations such as expiry visit the shards one at a time.
+    */
+   template<typename Index, size_t Shards = 16>
+   class sharded_index {
+   public:
+      static_assert( Shards > 0 && (Shards & (Shards - 1)) == 0, "Shards must be a power of 2" );
+
+      struct shard {
+         mutable std::mutex mtx;
+         Index              index;
+      };
+
+      shard& shard_for( const fc::sha256& id ) { return shards[shard_num( id )]; }
+      const shard& shard_for( const fc::sha256& id ) const { return shards[shard_num( id )]; }
+
+      // f( Index& ) called with the shard mutex held
+      template<typename F>
+      void for_each_shard( F&& f ) {
+         for( auto& s : shards ) {
+            std::lock_guard<std::mutex> g( s.mtx );
+            f( s.index );
+         }
+      }
+
+   private:
+      // last word, the first word of a block id holds the block number
+      static size_t shard_num( const fc::sha256& id ) { return id._hash[3] & (Shards - 1); }
+
+      std::array<shard, Shards> shards;
+   };
+
    struct update_block_num {
       uint32_t new_bnum;
       update_block_num(uint32_t bnum) : new_bnum(bnum) {}
@@ -150,6 +200,7 @@ namespace eosio {
       void set_state( stages s );
       bool is_sync_required( uint32_t fork_head_block_num );
       void request_next_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& conn = connection_ptr() );
+      void request_pipelined_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& c );
       void start_sync( const connection_ptr& c, uint32_t target );
       bool verify_catchup( const connection_ptr& c, uint32_t num, const block_id_type& id );
 
@@ -167,10 +218,13 @@ namespace eosio {
    };
 
    class dispatch_manager {
-      mutable std::mutex      blk_state_mtx;
-      peer_block_state_index  blk_state;
-      mutable std::mutex      local_txns_mtx;
-      node_transaction_index  local_txns;
+      sharded_index<peer_block_state_index>  blk_state;
+      sharded_index<node_transaction_index>  local_txns;
+      // recently packed blocks, shared by broadcast and sync/request responses so a block is packed once for all peers
+      // entries are keyed by block id and whether the buffer holds a compressed_block_message
+      std::mutex              blk_buffers_mtx;
+      std::deque<std::tuple<block_id_type, bool, std::shared_ptr<std::vector<char>>>> blk_buffers;
+      static constexpr size_t max_blk_buffers = 64;
 
    public:
       boost::asio::io_context::strand  strand;
@@ -178,9 +232,11 @@ namespace eosio {
       explicit dispatch_manager(boost::asio::io_context& io_context)
       : strand( io_context ) {}
 
-      void bcast_transaction(const packed_transaction& trx);
+      void bcast_transaction(const packed_transaction_ptr& trx);
       void rejected_transaction(const packed_transaction_ptr& trx, uint32_t head_blk_num);
       void bcast_block( const signed_block_ptr& b, const block_id_type& id );
+      std::shared_ptr<std::vector<char>> get_block_send_buffer( const signed_block_ptr& b, const block_id_type& id, bool compressed );
+      std::shared_ptr<std::vector<char>> create_compact_block_send_buffer( const signed_block_ptr& b, const connection_ptr& c ) const;
       void bcast_notice( const block_id_type& id );
       void rejected_block(const block_id_type& id);
 
@@ -189,6 +245,8 @@ namespace eosio {
       void recv_notice(const connection_ptr& conn, const notice_message& msg, bool generated);
 
       void retry_fetch(const connection_ptr& conn);
+      void fetch_noticed_block(const connection_ptr& conn, const block_id_type& id);
+      static constexpr std::chrono::milliseconds noticed_block_fetch_delay{250};
 
       bool add_peer_block( const block_id_type& blkid, uint32_t connection_id );
       bool peer_has_block(const block_id_type& blkid, uint32_t connection_id) const;
@@ -197,14 +255,15 @@ namespace eosio {
       bool add_peer_txn( const node_transaction_state& nts );
       void update_txns_block_num( const signed_block_ptr& sb );
       void update_txns_block_num( const transaction_id_type& id, uint32_t blk_num );
-      bool peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const;
       bool have_txn( const transaction_id_type& tid ) const;
+      packed_transaction_ptr get_txn( const transaction_id_type& tid ) const;
+      std::shared_ptr<vector<char>> take_txn_send_buffer( const transaction_id_type& tid );
       void expire_txns( uint32_t lib_num );
    };
 
    class net_plugin_impl : public std::enable_shared_from_this<net_plugin_impl> {
    public:
-      unique_ptr<tcp::acceptor>        acceptor;
+      vector<unique_ptr<tcp::acceptor>> acceptors; ///< more than one only with SO_REUSEPORT, see p2p-listen-acceptors
       std::atomic<uint32_t>            current_connection_id{0};
 
       unique_ptr< sync_manager >       sync_master;
@@ -238,6 +297,15 @@ namespace eosio {
       uint32_t                              max_client_count = 0;
       uint32_t                              max_nodes_per_host = 1;
       bool                                  p2p_accept_transactions = true;
+      bool                                  p2p_compress_blocks = false;
+      bool                                  p2p_compact_blocks = false;
+      vector<string>                        p2p_producer_peers; ///< addresses of peers full blocks are relayed to first
+      uint32_t                              p2p_block_relay_fanout = 0; ///< other peers sent full blocks, the rest a notice; 0 for all
+      uint16_t                              p2p_listen_acceptors = 1;
+      bool                                  p2p_tcp_nodelay = true;
+      int                                   p2p_socket_send_buffer = 0;    ///< SO_SNDBUF, 0 for OS default
+      int                                   p2p_socket_receive_buffer = 0; ///< SO_RCVBUF, 0 for OS default
+      int                                   p2p_socket_busy_poll_usec = 0; ///< SO_BUSY_POLL, 0 to disable
 
       /// Peer clock may be no more than 1 second skewed from our clock, including network latency.
       const std::chrono::system_clock::duration peer_authentication_interval{std::chrono::seconds{1}};
@@ -285,7 +353,8 @@ namespace eosio {
       //         lib_num, head_block_num, fork_head_blk_num, lib_id, head_blk_id, fork_head_blk_id
       std::tuple<uint32_t, uint32_t, uint32_t, block_id_type, block_id_type, block_id_type> get_chain_info() const;
 
-      void start_listen_loop();
+      void start_listen_loop( tcp::acceptor& acceptor );
+      void set_socket_options( tcp::socket& socket, const string& peer ) const;
 
       void on_accepted_block( const block_state_ptr& bs );
       void on_pre_accepted_block( const signed_block_ptr& bs );
@@ -305,6 +374,9 @@ namespace eosio {
       /** \brief Peer heartbeat ticker.
        */
       void ticker();
+
+      /// addr, a configured peer address or the p2p_address of a handshake, is one of p2p_producer_peers
+      bool is_producer_peer( const string& addr ) const;
       /** @} */
       /** \brief Determine if a peer is allowed to connect.
        *
@@ -379,6 +451,7 @@ namespace eosio {
    constexpr auto     def_send_buffer_size_mb = 4;
    constexpr auto     def_send_buffer_size = 1024*1024*def_send_buffer_size_mb;
    constexpr auto     def_max_write_queue_size = def_send_buffer_size*10;
+   constexpr auto     def_max_trx_lane_backlog = def_send_buffer_size; // stop relaying trxs to peer with this many bytes queued
    constexpr auto     def_max_trx_in_progress_size = 100*1024*1024; // 100 MB
    constexpr auto     def_max_consecutive_rejected_blocks = 13; // num of rejected blocks before disconnect
    constexpr auto     def_max_consecutive_immediate_connection_close = 9; // back off if client keeps closing
@@ -392,6 +465,10 @@ namespace eosio {
    constexpr auto     message_header_size = 4;
    constexpr uint32_t signed_block_which = 7;        // see protocol net_message
    constexpr uint32_t packed_transaction_which = 8;  // see protocol net_message
+   constexpr uint32_t compressed_block_which = 9;    // see protocol net_message
+   constexpr uint32_t compact_block_which = 10;      // see protocol net_message
+   /// header and signed_block_which ahead of a block serialized by controller::fetch_serialized_block_by_number
+   constexpr size_t   serialized_block_prefix_size = message_header_size + 1;
 
    /**
     *  For a while, network version was a 16 bit value equal to the second set of 16 bits
@@ -414,8 +491,11 @@ namespace eosio {
    constexpr uint16_t proto_base = 0;
    constexpr uint16_t proto_explicit_sync = 1;
    constexpr uint16_t block_id_notify = 2; // reserved. feature was removed. next net_version should be 3
+   constexpr uint16_t proto_pipelined_sync = 3; // sync requests contiguous with the one being served extend it
+   constexpr uint16_t proto_compressed_blocks = 4; // accepts compressed_block_message
+   constexpr uint16_t proto_compact_blocks = 5; // accepts compact_block_message
 
-   constexpr uint16_t net_version = proto_explicit_sync;
+   constexpr uint16_t net_version = proto_compact_blocks;
 
    /**
     * Index by start_block_num
@@ -434,10 +514,19 @@ namespace eosio {
    // thread safe
    class queued_buffer : boost::noncopyable {
    public:
+      /// write lanes in priority order, higher priority lanes are always written first
+      enum lane : uint8_t {
+         block_lane,    ///< broadcast and requested blocks
+         sync_lane,     ///< blocks sent to a syncing peer
+         control_lane,  ///< handshake, notice, time and other protocol messages
+         trx_lane,      ///< relayed transactions
+         num_lanes
+      };
+
       void clear_write_queue() {
          std::lock_guard<std::mutex> g( _mtx );
-         _write_queue.clear();
-         _sync_write_queue.clear();
+         for( auto& q : _write_queues ) q.clear();
+         _lane_size.fill( 0 );
          _write_queue_size = 0;
       }
 
@@ -446,6 +535,8 @@ namespace eosio {
          while ( _out_queue.size() > 0 ) {
             _out_queue.pop_front();
          }
+         _coalesced.clear();
+         _out_queue_size = 0;
       }
 
       uint32_t write_queue_size() const {
@@ -453,6 +544,22 @@ namespace eosio {
          return _write_queue_size;
       }
 
+      uint32_t lane_size( lane l ) const {
+         std::lock_guard<std::mutex> g( _mtx );
+         return _lane_size[l];
+      }
+
+      std::array<uint32_t, num_lanes> lane_sizes() const {
+         std::lock_guard<std::mutex> g( _mtx );
+         return _lane_size;
+      }
+
+      /// bytes handed to the async_write in progress
+      uint32_t out_queue_size() const {
+         std::lock_guard<std::mutex> g( _mtx );
+         return _out_queue_size;
+      }
+
       bool is_out_queue_empty() const {
          std::lock_guard<std::mutex> g( _mtx );
          return _out_queue.empty();
@@ -461,19 +568,16 @@ namespace eosio {
       bool ready_to_send() const {
          std::lock_guard<std::mutex> g( _mtx );
          // if out_queue is not empty then async_write is in progress
-         return ((!_sync_write_queue.empty() || !_write_queue.empty()) && _out_queue.empty());
+         return (_write_queue_size > 0 && _out_queue.empty());
       }
 
       // @param callback must not callback into queued_buffer
       bool add_write_queue( const std::shared_ptr<vector<char>>& buff,
                             std::function<void( boost::system::error_code, std::size_t )> callback,
-                            bool to_sync_queue ) {
+                            lane l ) {
          std::lock_guard<std::mutex> g( _mtx );
-         if( to_sync_queue ) {
-            _sync_write_queue.push_back( {buff, callback} );
-         } else {
-            _write_queue.push_back( {buff, callback} );
-         }
+         _write_queues[l].push_back( {buff, callback} );
+         _lane_size[l] += buff->size();
          _write_queue_size += buff->size();
          if( _write_queue_size > 2 * def_max_write_queue_size ) {
             return false;
@@ -481,34 +585,72 @@ namespace eosio {
          return true;
       }
 
+      // lanes are drained in priority order, each up to its per write budget, so a block queued while a write
+      // is in progress waits for at most one budget of transactions
       void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs ) {
          std::lock_guard<std::mutex> g( _mtx );
-         if( _sync_write_queue.size() > 0 ) { // always send msgs from sync_write_queue first
-            fill_out_buffer( bufs, _sync_write_queue );
-         } else { // postpone real_time write_queue if sync queue is not empty
-            fill_out_buffer( bufs, _write_queue );
-            EOS_ASSERT( _write_queue_size == 0, plugin_exception, "write queue size expected to be zero" );
+         for( uint8_t l = 0; l < num_lanes; ++l ) {
+            fill_out_buffer( bufs, static_cast<lane>( l ) );
          }
       }
 
       void out_callback( boost::system::error_code ec, std::size_t w ) {
          std::lock_guard<std::mutex> g( _mtx );
+         ++_write_count;
+         _write_bytes += w;
          for( auto& m : _out_queue ) {
             m.callback( ec, w );
          }
       }
 
+      /// @return number of completed writes and bytes written by them
+      std::pair<uint64_t, uint64_t> write_stats() const {
+         std::lock_guard<std::mutex> g( _mtx );
+         return { _write_count, _write_bytes };
+      }
+
    private:
       struct queued_write;
-      void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs,
-                            deque<queued_write>& w_queue ) {
-         while ( w_queue.size() > 0 ) {
+      // Consecutive small messages (notices, time messages, transactions) are copied into one contiguous buffer
+      // so a write of many of them needs few iovecs. Larger messages such as blocks are referenced in place.
+      void fill_out_buffer( std::vector<boost::asio::const_buffer>& bufs, lane l ) {
+         deque<queued_write>& w_queue = _write_queues[l];
+         uint32_t lane_written = 0;
+         std::vector<const vector<char>*> run;
+         size_t run_size = 0;
+         auto flush_run = [&]() {
+            if( run.size() == 1 ) {
+               bufs.push_back( boost::asio::buffer( *run.front() ));
+            } else if( run.size() > 1 ) {
+               auto coalesced = std::make_shared<vector<char>>();
+               coalesced->reserve( run_size );
+               for( const auto* b : run ) {
+                  coalesced->insert( coalesced->end(), b->begin(), b->end() );
+               }
+               bufs.push_back( boost::asio::buffer( *coalesced ));
+               _coalesced.emplace_back( std::move( coalesced ));
+            }
+            run.clear();
+            run_size = 0;
+         };
+
+         while ( w_queue.size() > 0 && lane_written < lane_write_budget[l] ) {
             auto& m = w_queue.front();
-            bufs.push_back( boost::asio::buffer( *m.buff ));
+            lane_written += m.buff->size();
+            _lane_size[l] -= m.buff->size();
+            if( m.buff->size() <= max_coalesce_msg_size ) {
+               run.push_back( m.buff.get() );
+               run_size += m.buff->size();
+            } else {
+               flush_run();
+               bufs.push_back( boost::asio::buffer( *m.buff ));
+            }
             _write_queue_size -= m.buff->size();
+            _out_queue_size += m.buff->size();
             _out_queue.emplace_back( m );
             w_queue.pop_front();
          }
+         flush_run();
       }
 
    private:
@@ -517,14 +659,111 @@ namespace eosio {
          std::function<void( boost::system::error_code, std::size_t )> callback;
       };
 
+      static constexpr size_t max_coalesce_msg_size = 4*1024;
+      /// bytes taken from each lane per write, a message is never split so a lane may exceed its budget by one message
+      static constexpr std::array<uint32_t, num_lanes> lane_write_budget{
+            {std::numeric_limits<uint32_t>::max(), std::numeric_limits<uint32_t>::max(), 256*1024, 256*1024}};
+
       mutable std::mutex  _mtx;
-      uint32_t            _write_queue_size{0};
-      deque<queued_write> _write_queue;
-      deque<queued_write> _sync_write_queue; // sync_write_queue will be sent first
+      uint32_t            _write_queue_size{0}; // all lanes
+      std::array<deque<queued_write>, num_lanes> _write_queues;
+      std::array<uint32_t, num_lanes>            _lane_size{};
       deque<queued_write> _out_queue;
+      uint32_t            _out_queue_size{0};
+      deque<std::shared_ptr<vector<char>>> _coalesced; // backing storage for coalesced buffers of _out_queue
+      uint64_t            _write_count{0};
+      uint64_t            _write_bytes{0};
 
    }; // queued_buffer
 
+   // thread safe
+   class latency_histogram {
+   public:
+      void add( const fc::microseconds& d ) {
+         const int64_t us = std::max<int64_t>( d.count(), 0 );
+         size_t b = 0;
+         while( b < bucket_bounds_ms.size() && us > int64_t(bucket_bounds_ms[b]) * 1000 ) ++b;
+         ++buckets[b];
+         ++count;
+         sum_us += us;
+      }
+
+      latency_histogram_status status() const {
+         latency_histogram_status s;
+         s.bucket_bounds_ms.assign( bucket_bounds_ms.begin(), bucket_bounds_ms.end() );
+         s.counts.reserve( buckets.size() );
+         for( const auto& b : buckets ) s.counts.push_back( b.load() );
+         s.count = count;
+         s.sum_us = sum_us;
+         return s;
+      }
+
+   private:
+      static constexpr std::array<uint32_t, 10> bucket_bounds_ms{{5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000}};
+
+      std::array<std::atomic<uint64_t>, bucket_bounds_ms.size() + 1> buckets{};
+      std::atomic<uint64_t> count{0};
+      std::atomic<uint64_t> sum_us{0};
+   };
+
+   /**
+    * Rolling bloom filter of transaction ids a peer is known to have, either because it sent or announced them or
+    * because they were sent to it. Inserts go into the current generation and lookups check both. Once the current
+    * generation holds max_entries ids the older one is cleared and becomes current, so an id is remembered for at
+    * least max_entries inserts in a fixed amount of memory. False positives cost a skipped relay to that peer.
+    */
+   // thread safe
+   class known_ids_filter : boost::noncopyable {
+   public:
+      /// @return true if id was not already (possibly falsely) known
+      bool insert( const fc::sha256& id ) {
+         std::lock_guard<std::mutex> g( _mtx );
+         if( contains_locked( id ) ) return false;
+         if( _current_entries >= max_entries ) {
+            _current = 1 - _current;
+            _generations[_current].fill( 0 );
+            _current_entries = 0;
+         }
+         auto& bits = _generations[_current];
+         for( size_t i = 0; i < num_hashes; ++i ) {
+            const uint64_t bit = bit_index( id, i );
+            bits[bit / 64] |= uint64_t(1) << (bit % 64);
+         }
+         ++_current_entries;
+         return true;
+      }
+
+      bool contains( const fc::sha256& id ) const {
+         std::lock_guard<std::mutex> g( _mtx );
+         return contains_locked( id );
+      }
+
+   private:
+      static constexpr size_t   num_bits    = 1 << 20; // per generation, 128 KiB
+      static constexpr size_t   num_hashes  = 4;
+      static constexpr uint32_t max_entries = 64 * 1024;
+
+      // transaction ids are sha256 digests, each 64 bit word is an independent hash of the transaction
+      static uint64_t bit_index( const fc::sha256& id, size_t i ) { return id._hash[i] & (num_bits - 1); }
+
+      bool contains_locked( const fc::sha256& id ) const {
+         for( const auto& bits : _generations ) {
+            bool all = true;
+            for( size_t i = 0; i < num_hashes && all; ++i ) {
+               const uint64_t bit = bit_index( id, i );
+               all = bits[bit / 64] & (uint64_t(1) << (bit % 64));
+            }
+            if( all ) return true;
+         }
+         return false;
+      }
+
+      mutable std::mutex  _mtx;
+      std::array<std::array<uint64_t, num_bits / 64>, 2> _generations{};
+      size_t              _current = 0;
+      uint32_t            _current_entries = 0;
+   };
+
 
    class connection : public std::enable_shared_from_this<connection> {
    public:
@@ -568,6 +807,21 @@ namespace eosio {
       std::atomic<std::size_t>         outstanding_read_bytes{0}; // accessed only from strand threads
 
       queued_buffer           buffer_queue;
+      known_ids_filter        known_trxs;
+      mutable std::mutex      queued_trxs_mtx;
+      std::set<transaction_id_type> queued_trxs; ///< relayed trxs in the trx lane whose write has not completed
+
+      std::atomic<uint64_t>   blocks_received{0};
+      latency_histogram       block_propagation;
+      latency_histogram       block_receive_to_apply;
+      latency_histogram       sync_chunk_rtt;
+      fc::time_point          sync_chunk_requested; // accessed only from strand, zero when no request is outstanding
+      std::atomic<int64_t>    rtt_us{-1};           ///< smoothed round trip time of time_message exchanges, -1 until measured
+      std::atomic<bool>       producer_peer{false}; ///< one of p2p_producer_peers
+
+      std::pair<bool, uint64_t> relay_rank() const {
+         return block_relay_rank( producer_peer.load( std::memory_order_relaxed ), rtt_us.load( std::memory_order_relaxed ) );
+      }
 
       std::atomic<uint32_t>   trx_in_progress_size{0};
       const uint32_t          connection_id;
@@ -597,6 +851,7 @@ namespace eosio {
       string                      local_endpoint_port;
 
       connection_status get_status()const;
+      connection_metrics get_metrics();
 
       /** \name Peer Timestamps
        *  Time message handling
@@ -634,6 +889,15 @@ namespace eosio {
        * encountered unpacking or processing the message.
        */
       bool process_next_message(uint32_t message_length);
+      /**
+       * Common handling of signed_block and compressed_block_message.
+       * @param skip_length bytes of pending_message_buffer to discard if the block is dropped without unpacking
+       * @param unpack_block provides the full signed_block once the header checks pass
+       */
+      bool process_block_message( const block_header& bh, uint32_t skip_length,
+                                  const std::function<signed_block_ptr()>& unpack_block );
+      /** @return nullptr if the block could not be rebuilt, in which case the full block has been requested */
+      signed_block_ptr rebuild_compact_block( compact_block_message& cbm );
 
       void send_handshake( bool force = false );
 
@@ -667,9 +931,23 @@ namespace eosio {
 
       void enqueue( const net_message &msg );
       void enqueue_block( const signed_block_ptr& sb, bool to_sync_queue = false);
+      /// sync lane, serialized as returned by fetch_serialized_block_by_number with serialized_block_prefix_size
+      void enqueue_serialized_block( uint32_t num, std::vector<char>&& serialized );
+      /** @pre called from connection strand, true if blocks should be sent to this peer as compressed_block_message */
+      bool compress_blocks() const { return my_impl->p2p_compress_blocks && protocol_version >= proto_compressed_blocks; }
+      /** @pre called from connection strand, true if broadcast blocks may be sent to this peer as compact_block_message */
+      bool compact_blocks() const { return my_impl->p2p_compact_blocks && protocol_version >= proto_compact_blocks; }
       void enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                            go_away_reason close_after_send,
-                           bool to_sync_queue = false);
+                           queued_buffer::lane lane = queued_buffer::control_lane);
+      /// thread safe, marks id known and queued unless already known, @return true if the trx should be sent
+      bool queue_trx_if_unknown( const transaction_id_type& id );
+      /// thread safe, true if the peer has the trx: known to it and not waiting in the trx lane behind blocks
+      bool peer_has_trx( const transaction_id_type& id ) const;
+      /// trx lane, id is no longer queued once the write completes
+      void enqueue_trx( const transaction_id_type& id, const std::shared_ptr<std::vector<char>>& send_buffer );
+      /// true if relayed transactions are backing up on this connection, new ones are not sent until it drains
+      bool trx_lane_backlogged() const { return buffer_queue.lane_size( queued_buffer::trx_lane ) > def_max_trx_lane_backlog; }
       void cancel_sync(go_away_reason);
       void flush_queues();
       bool enqueue_sync_block();
@@ -683,7 +961,7 @@ namespace eosio {
 
       void queue_write(const std::shared_ptr<vector<char>>& buff,
                        std::function<void(boost::system::error_code, std::size_t)> callback,
-                       bool to_sync_queue = false);
+                       queued_buffer::lane lane);
       void do_queue_write();
 
       static bool is_valid( const handshake_message& msg );
@@ -712,9 +990,9 @@ namespace eosio {
       void handle_message( const signed_block& msg ) = delete; // signed_block_ptr overload used instead
       void handle_message( const block_id_type& id, signed_block_ptr msg );
       void handle_message( const packed_transaction& msg ) = delete; // packed_transaction_ptr overload used instead
-      void handle_message( packed_transaction_ptr msg );
+      void handle_message( packed_transaction_ptr msg, std::shared_ptr<vector<char>> send_buffer );
 
-      void process_signed_block( const block_id_type& id, signed_block_ptr msg );
+      void process_signed_block( const block_id_type& id, signed_block_ptr msg, const fc::time_point& received );
 
       fc::variant_object get_logger_variant()  {
          fc::mutable_variant_object mvo;
@@ -870,18 +1148,43 @@ namespace eosio {
       stat.peer = peer_addr;
       stat.connecting = connecting;
       stat.syncing = syncing;
+      std::tie( stat.write_count, stat.write_bytes ) = buffer_queue.write_stats();
       std::lock_guard<std::mutex> g( conn_mtx );
       stat.last_handshake = last_handshake_recv;
       return stat;
    }
 
+   // thread safe
+   connection_metrics connection::get_metrics() {
+      connection_metrics m;
+      m.peer = peer_name();
+      m.connection_id = connection_id;
+      m.write_queue_bytes = buffer_queue.write_queue_size();
+      const auto lanes = buffer_queue.lane_sizes();
+      m.write_lane_bytes.assign( lanes.begin(), lanes.end() );
+      m.write_in_flight_bytes = buffer_queue.out_queue_size();
+      m.outstanding_read_bytes = outstanding_read_bytes;
+      m.trx_in_progress_bytes = trx_in_progress_size;
+      std::tie( m.write_count, m.write_bytes ) = buffer_queue.write_stats();
+      m.blocks_received = blocks_received;
+      m.rtt_us = rtt_us;
+      m.producer_peer = producer_peer;
+      m.block_propagation = block_propagation.status();
+      m.block_receive_to_apply = block_receive_to_apply.status();
+      m.sync_chunk_rtt = sync_chunk_rtt.status();
+      return m;
+   }
+
    bool connection::start_session() {
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
 
       update_endpoints();
-      boost::asio::ip::tcp::no_delay nodelay( true );
+      boost::asio::ip::tcp::no_delay nodelay( my_impl->p2p_tcp_nodelay );
       boost::system::error_code ec;
       socket->set_option( nodelay, ec );
+      if( !ec ) {
+         my_impl->set_socket_options( *socket, peer_name() );
+      }
       if( ec ) {
          fc_elog( logger, "connection failed (set_option) ${peer}: ${e1}", ("peer", peer_name())( "e1", ec.message() ) );
          close();
@@ -904,6 +1207,8 @@ namespace eosio {
 
    void connection::flush_queues() {
       buffer_queue.clear_write_queue();
+      std::lock_guard<std::mutex> g( queued_trxs_mtx );
+      queued_trxs.clear();
    }
 
    void connection::close( bool reconnect, bool shutdown ) {
@@ -973,7 +1278,8 @@ namespace eosio {
       const auto lib_num = block_header::num_from_id(lib_id);
       if( lib_num == 0 ) return; // if last_irreversible_block_id is null (we have not received handshake or reset)
 
-      app().post( priority::medium, [chain_plug = my_impl->chain_plug, c = shared_from_this(),
+      static auto& origin = app_thread_stats::origin( "net:fork_check", priority::medium );
+      app_thread_post( origin, [chain_plug = my_impl->chain_plug, c = shared_from_this(),
             lib_num, head_num, msg_head_id]() {
          auto msg_head_num = block_header::num_from_id(msg_head_id);
          bool on_fork = msg_head_num == 0;
@@ -1025,7 +1331,8 @@ namespace eosio {
 
    void connection::blk_send( const block_id_type& blkid ) {
       connection_wptr weak = shared_from_this();
-      app().post( priority::medium, [blkid, weak{std::move(weak)}]() {
+      static auto& origin = app_thread_stats::origin( "net:block_send", priority::medium );
+      app_thread_post( origin, [blkid, weak{std::move(weak)}]() {
          connection_ptr c = weak.lock();
          if( !c ) return;
          try {
@@ -1074,8 +1381,10 @@ namespace eosio {
    }
 
    void connection::send_time() {
+      // originate is the transmit time of the last message from the peer, as in NTP symmetric mode; when the peer
+      // receives this before sending its next keepalive, that keepalive completes an exchange for both sides
       time_message xpkt;
-      xpkt.org = rec;
+      xpkt.org = xmt;
       xpkt.rec = dst;
       xpkt.xmt = get_time();
       org = xpkt.xmt;
@@ -1092,8 +1401,8 @@ namespace eosio {
 
    void connection::queue_write(const std::shared_ptr<vector<char>>& buff,
                                 std::function<void(boost::system::error_code, std::size_t)> callback,
-                                bool to_sync_queue) {
-      if( !buffer_queue.add_write_queue( buff, callback, to_sync_queue )) {
+                                queued_buffer::lane lane) {
+      if( !buffer_queue.add_write_queue( buff, callback, lane )) {
          fc_wlog( logger, "write_queue full ${s} bytes, giving up on connection ${p}",
                   ("s", buffer_queue.write_queue_size())("p", peer_name()) );
          close();
@@ -1178,10 +1487,22 @@ namespace eosio {
          fc_ilog( logger, "completing enqueue_sync_block ${num} to ${p}", ("num", num)("p", peer_name()) );
       }
       connection_wptr weak = shared_from_this();
-      app().post( priority::medium, [num, weak{std::move(weak)}]() {
+      static auto& origin = app_thread_stats::origin( "net:sync_block_send", priority::medium );
+      app_thread_post( origin, [num, weak{std::move(weak)}]() {
          connection_ptr c = weak.lock();
          if( !c ) return;
          controller& cc = my_impl->chain_plug->chain();
+         // the stored bytes are the wire serialization already, frame them instead of unpacking and packing again
+         std::vector<char> serialized;
+         try {
+            serialized = cc.fetch_serialized_block_by_number( num, serialized_block_prefix_size );
+         } FC_LOG_AND_DROP();
+         if( !serialized.empty() ) {
+            c->strand.post( [c, num, serialized{std::move(serialized)}]() mutable {
+               c->enqueue_serialized_block( num, std::move( serialized ) );
+            });
+            return;
+         }
          signed_block_ptr sb;
          try {
             sb = cc.fetch_block_by_number( num );
@@ -1250,6 +1571,70 @@ namespace eosio {
       return create_send_buffer( signed_block_which, *sb );
    }
 
+   namespace bio = boost::iostreams;
+
+   template<size_t Limit>
+   struct decompress_limiter {
+      using char_type = char;
+      using category = bio::multichar_output_filter_tag;
+
+      template<typename Sink>
+      size_t write(Sink& sink, const char* s, size_t count) {
+         EOS_ASSERT( total + count <= Limit, plugin_exception, "Exceeded maximum decompressed block size" );
+         total += count;
+         return bio::write(sink, s, count);
+      }
+
+      size_t total = 0;
+   };
+
+   static std::shared_ptr<std::vector<char>> create_compressed_send_buffer( const char* packed, size_t size ) {
+      compressed_block_message cbm;
+      bio::filtering_ostream comp;
+      comp.push( bio::zlib_compressor( bio::zlib::default_compression ) );
+      comp.push( bio::back_inserter( cbm.packed_block ) );
+      bio::write( comp, packed, size );
+      bio::close( comp );
+      return create_send_buffer( compressed_block_which, cbm );
+   }
+
+   static std::shared_ptr<std::vector<char>> create_compressed_send_buffer( const signed_block_ptr& sb ) {
+      fc_dlog( logger, "sending compressed block ${bn}", ("bn", sb->block_num()) );
+      const std::vector<char> packed = fc::raw::pack( *sb );
+      return create_compressed_send_buffer( packed.data(), packed.size() );
+   }
+
+   /// fills in the message header and which of a serialized block in place, the block is not copied
+   static std::shared_ptr<std::vector<char>> create_serialized_send_buffer( std::vector<char>&& serialized ) {
+      static_assert( serialized_block_prefix_size == message_header_size + sizeof(char), "signed_block_which packs to one byte" );
+      const uint32_t payload_size = serialized.size() - message_header_size;
+      memcpy( serialized.data(), &payload_size, message_header_size ); // avoid variable size encoding of uint32_t
+      serialized[message_header_size] = static_cast<char>( signed_block_which );
+      return std::make_shared<std::vector<char>>( std::move( serialized ) );
+   }
+
+   static signed_block_ptr decompress_block( const compressed_block_message& cbm ) {
+      std::vector<char> packed;
+      try {
+         bio::filtering_ostream decomp;
+         decomp.push( bio::zlib_decompressor() );
+         // same bound as the largest accepted uncompressed message, protects against zip bombs
+         decomp.push( decompress_limiter<def_send_buffer_size*2>() );
+         decomp.push( bio::back_inserter( packed ) );
+         bio::write( decomp, cbm.packed_block.data(), cbm.packed_block.size() );
+         bio::close( decomp );
+      } catch( fc::exception& ) {
+         throw;
+      } catch( ... ) {
+         fc::unhandled_exception er( FC_LOG_MESSAGE( warn, "block decompression error" ), std::current_exception() );
+         throw er;
+      }
+      fc::datastream<const char*> ds( packed.data(), packed.size() );
+      signed_block_ptr ptr = std::make_shared<signed_block>();
+      fc::raw::unpack( ds, *ptr );
+      return ptr;
+   }
+
    static std::shared_ptr<std::vector<char>> create_send_buffer( const packed_transaction& trx ) {
       // this implementation is to avoid copy of packed_transaction to net_message
       // matches which of net_message for packed_transaction
@@ -1259,12 +1644,22 @@ namespace eosio {
    void connection::enqueue_block( const signed_block_ptr& sb, bool to_sync_queue) {
       fc_dlog( logger, "enqueue block ${num}", ("num", sb->block_num()) );
       verify_strand_in_this_thread( strand, __func__, __LINE__ );
-      enqueue_buffer( create_send_buffer( sb ), no_reason, to_sync_queue);
+      enqueue_buffer( my_impl->dispatcher->get_block_send_buffer( sb, sb->id(), compress_blocks() ), no_reason,
+                      to_sync_queue ? queued_buffer::sync_lane : queued_buffer::block_lane );
+   }
+
+   void connection::enqueue_serialized_block( uint32_t num, std::vector<char>&& serialized ) {
+      fc_dlog( logger, "enqueue serialized block ${num}", ("num", num) );
+      verify_strand_in_this_thread( strand, __func__, __LINE__ );
+      auto send_buffer = compress_blocks()
+            ? create_compressed_send_buffer( serialized.data() + serialized_block_prefix_size, serialized.size() - serialized_block_prefix_size )
+            : create_serialized_send_buffer( std::move( serialized ) );
+      enqueue_buffer( send_buffer, no_reason, queued_buffer::sync_lane );
    }
 
    void connection::enqueue_buffer( const std::shared_ptr<std::vector<char>>& send_buffer,
                                     go_away_reason close_after_send,
-                                    bool to_sync_queue)
+                                    queued_buffer::lane lane)
    {
       connection_ptr self = shared_from_this();
       queue_write(send_buffer,
@@ -1277,7 +1672,31 @@ namespace eosio {
                            return;
                         }
                   },
-                  to_sync_queue);
+                  lane);
+   }
+
+   void connection::enqueue_trx( const transaction_id_type& id, const std::shared_ptr<std::vector<char>>& send_buffer ) {
+      connection_ptr self = shared_from_this();
+      queue_write( send_buffer,
+            [conn{std::move(self)}, id]( boost::system::error_code ec, std::size_t ) {
+               std::lock_guard<std::mutex> g( conn->queued_trxs_mtx );
+               conn->queued_trxs.erase( id );
+            },
+            queued_buffer::trx_lane );
+   }
+
+   // thread safe, known and queued are updated together so a compact block never sees the trx known but not queued
+   bool connection::queue_trx_if_unknown( const transaction_id_type& id ) {
+      std::lock_guard<std::mutex> g( queued_trxs_mtx );
+      if( !known_trxs.insert( id ) ) return false;
+      queued_trxs.insert( id );
+      return true;
+   }
+
+   // thread safe
+   bool connection::peer_has_trx( const transaction_id_type& id ) const {
+      std::lock_guard<std::mutex> g( queued_trxs_mtx );
+      return known_trxs.contains( id ) && queued_trxs.count( id ) == 0;
    }
 
    // thread safe
@@ -1347,6 +1766,7 @@ namespace eosio {
 
    void connection::request_sync_blocks(uint32_t start, uint32_t end) {
       sync_request_message srm = {start,end};
+      if( sync_chunk_requested == fc::time_point() ) sync_chunk_requested = fc::time_point::now();
       enqueue( net_message(srm) );
       sync_wait();
    }
@@ -1500,6 +1920,20 @@ namespace eosio {
       }
    }
 
+   // request the chunk following the one in flight from the same peer so it has the next range queued before the
+   // current one drains, hiding the request round trip. Peers >= proto_pipelined_sync append it to the range being served.
+   void sync_manager::request_pipelined_chunk( std::unique_lock<std::mutex> g_sync, const connection_ptr& c ) {
+      uint32_t start = sync_last_requested_num + 1;
+      uint32_t end = std::min( sync_last_requested_num + sync_req_span, sync_known_lib_num );
+      if( end < start ) return;
+      sync_last_requested_num = end;
+      g_sync.unlock();
+      c->strand.post( [c, start, end]() {
+         fc_ilog( logger, "requesting pipelined range ${s} to ${e}, from ${n}", ("n", c->peer_name())( "s", start )( "e", end ) );
+         c->request_sync_blocks( start, end );
+      } );
+   }
+
    // static, thread safe
    void sync_manager::send_handshakes() {
       for_each_connection( []( auto& ci ) {
@@ -1646,7 +2080,8 @@ namespace eosio {
             c->enqueue( note );
          }
          c->syncing = false;
-         app().post( priority::medium, [chain_plug = my_impl->chain_plug, c,
+         static auto& origin = app_thread_stats::origin( "net:sync_fork_check", priority::medium );
+         app_thread_post( origin, [chain_plug = my_impl->chain_plug, c,
                                         msg_head_num = msg.head_num, msg_head_id = msg.head_id]() {
             bool on_fork = true;
             try {
@@ -1774,6 +2209,10 @@ namespace eosio {
    // called from connection strand
    void sync_manager::sync_recv_block(const connection_ptr& c, const block_id_type& blk_id, uint32_t blk_num, bool blk_applied) {
       fc_dlog( logger, "got block ${bn} from ${p}", ("bn", blk_num)( "p", c->peer_name() ) );
+      if( c->sync_chunk_requested != fc::time_point() ) {
+         c->sync_chunk_rtt.add( fc::time_point::now() - c->sync_chunk_requested );
+         c->sync_chunk_requested = fc::time_point();
+      }
       if( app().is_quiting() ) {
          c->close( false, true );
          return;
@@ -1821,6 +2260,10 @@ namespace eosio {
             send_handshakes();
          } else if( blk_num == sync_last_requested_num ) {
             request_next_chunk( std::move( g_sync) );
+         } else if( c == sync_source && c->protocol_version >= proto_pipelined_sync &&
+                    sync_last_requested_num < sync_known_lib_num &&
+                    blk_num + sync_req_span / 2 >= sync_last_requested_num ) {
+            request_pipelined_chunk( std::move( g_sync ), c );
          } else {
             g_sync.unlock();
             fc_dlog( logger, "calling sync_wait on connection ${p}", ("p", c->peer_name()) );
@@ -1833,13 +2276,14 @@ namespace eosio {
 
    // thread safe
    bool dispatch_manager::add_peer_block( const block_id_type& blkid, uint32_t connection_id) {
-      std::lock_guard<std::mutex> g( blk_state_mtx );
-      auto bptr = blk_state.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
-      bool added = (bptr == blk_state.end());
+      auto& s = blk_state.shard_for( blkid );
+      std::lock_guard<std::mutex> g( s.mtx );
+      auto bptr = s.index.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
+      bool added = (bptr == s.index.end());
       if( added ) {
-         blk_state.insert( {blkid, block_header::num_from_id( blkid ), connection_id, true} );
+         s.index.insert( {blkid, block_header::num_from_id( blkid ), connection_id, true} );
       } else if( !bptr->have_block ) {
-         blk_state.modify( bptr, []( auto& pb ) {
+         s.index.modify( bptr, []( auto& pb ) {
             pb.have_block = true;
          });
       }
@@ -1847,15 +2291,17 @@ namespace eosio {
    }
 
    bool dispatch_manager::peer_has_block( const block_id_type& blkid, uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
-      const auto blk_itr = blk_state.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
-      return blk_itr != blk_state.end();
+      const auto& s = blk_state.shard_for( blkid );
+      std::lock_guard<std::mutex> g( s.mtx );
+      const auto blk_itr = s.index.get<by_id>().find( std::make_tuple( connection_id, std::ref( blkid )));
+      return blk_itr != s.index.end();
    }
 
    bool dispatch_manager::have_block( const block_id_type& blkid ) const {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
+      const auto& s = blk_state.shard_for( blkid );
+      std::lock_guard<std::mutex> g( s.mtx );
       // by_block_id sorts have_block by greater so have_block == true will be the first one found
-      const auto& index = blk_state.get<by_block_id>();
+      const auto& index = s.index.get<by_block_id>();
       auto blk_itr = index.find( blkid );
       if( blk_itr != index.end() ) {
          return blk_itr->have_block;
@@ -1864,75 +2310,92 @@ namespace eosio {
    }
 
    bool dispatch_manager::add_peer_txn( const node_transaction_state& nts ) {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
-      bool added = (tptr == local_txns.end());
+      auto& s = local_txns.shard_for( nts.id );
+      std::lock_guard<std::mutex> g( s.mtx );
+      auto tptr = s.index.get<by_id>().find( std::make_tuple( std::ref( nts.id ), nts.connection_id ) );
+      bool added = (tptr == s.index.end());
       if( added ) {
-         local_txns.insert( nts );
+         s.index.insert( nts );
       }
       return added;
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const signed_block_ptr& sb ) {
-      update_block_num ubn( sb->block_num() );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
       for( const auto& recpt : sb->transactions ) {
          const transaction_id_type& id = (recpt.trx.which() == 0) ? recpt.trx.get<transaction_id_type>()
                                                                   : recpt.trx.get<packed_transaction>().id();
-         auto range = local_txns.get<by_id>().equal_range( id );
-         for( auto itr = range.first; itr != range.second; ++itr ) {
-            local_txns.modify( itr, ubn );
-         }
+         update_txns_block_num( id, sb->block_num() );
       }
    }
 
    // thread safe
    void dispatch_manager::update_txns_block_num( const transaction_id_type& id, uint32_t blk_num ) {
       update_block_num ubn( blk_num );
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      auto range = local_txns.get<by_id>().equal_range( id );
+      auto& s = local_txns.shard_for( id );
+      std::lock_guard<std::mutex> g( s.mtx );
+      auto range = s.index.get<by_id>().equal_range( id );
       for( auto itr = range.first; itr != range.second; ++itr ) {
-         local_txns.modify( itr, ubn );
+         s.index.modify( itr, ubn );
       }
    }
 
-   bool dispatch_manager::peer_has_txn( const transaction_id_type& tid, uint32_t connection_id ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( std::make_tuple( std::ref( tid ), connection_id ) );
-      return tptr != local_txns.end();
+   bool dispatch_manager::have_txn( const transaction_id_type& tid ) const {
+      const auto& s = local_txns.shard_for( tid );
+      std::lock_guard<std::mutex> g( s.mtx );
+      const auto tptr = s.index.get<by_id>().find( tid );
+      return tptr != s.index.end();
    }
 
-   bool dispatch_manager::have_txn( const transaction_id_type& tid ) const {
-      std::lock_guard<std::mutex> g( local_txns_mtx );
-      const auto tptr = local_txns.get<by_id>().find( tid );
-      return tptr != local_txns.end();
+   packed_transaction_ptr dispatch_manager::get_txn( const transaction_id_type& tid ) const {
+      const auto& s = local_txns.shard_for( tid );
+      std::lock_guard<std::mutex> g( s.mtx );
+      auto range = s.index.get<by_id>().equal_range( tid );
+      for( auto itr = range.first; itr != range.second; ++itr ) {
+         if( itr->trx ) return itr->trx;
+      }
+      return {};
+   }
+
+   std::shared_ptr<vector<char>> dispatch_manager::take_txn_send_buffer( const transaction_id_type& tid ) {
+      auto& s = local_txns.shard_for( tid );
+      std::lock_guard<std::mutex> g( s.mtx );
+      std::shared_ptr<vector<char>> send_buffer;
+      auto range = s.index.get<by_id>().equal_range( tid );
+      for( auto itr = range.first; itr != range.second; ++itr ) {
+         if( itr->send_buffer ) {
+            s.index.modify( itr, [&send_buffer]( auto& nts ) { send_buffer = std::move( nts.send_buffer ); } );
+            break;
+         }
+      }
+      return send_buffer;
    }
 
    void dispatch_manager::expire_txns( uint32_t lib_num ) {
       size_t start_size = 0, end_size = 0;
 
-      std::unique_lock<std::mutex> g( local_txns_mtx );
-      start_size = local_txns.size();
-      auto& old = local_txns.get<by_expiry>();
-      auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
-      auto ex_up = old.upper_bound( time_point::now() );
-      old.erase( ex_lo, ex_up );
-      g.unlock(); // allow other threads opportunity to use local_txns
-
-      g.lock();
-      auto& stale = local_txns.get<by_block_num>();
-      stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
-      end_size = local_txns.size();
-      g.unlock();
+      // one shard locked at a time allows other threads opportunity to use local_txns
+      const auto now = time_point::now();
+      local_txns.for_each_shard( [&]( node_transaction_index& index ) {
+         start_size += index.size();
+         auto& old = index.get<by_expiry>();
+         auto ex_lo = old.lower_bound( fc::time_point_sec( 0 ) );
+         auto ex_up = old.upper_bound( now );
+         old.erase( ex_lo, ex_up );
+
+         auto& stale = index.get<by_block_num>();
+         stale.erase( stale.lower_bound( 1 ), stale.upper_bound( lib_num ) );
+         end_size += index.size();
+      } );
 
       fc_dlog( logger, "expire_local_txns size ${s} removed ${r}", ("s", start_size)( "r", start_size - end_size ) );
    }
 
    void dispatch_manager::expire_blocks( uint32_t lib_num ) {
-      std::lock_guard<std::mutex> g(blk_state_mtx);
-      auto& stale_blk = blk_state.get<by_block_num>();
-      stale_blk.erase( stale_blk.lower_bound(1), stale_blk.upper_bound(lib_num) );
+      blk_state.for_each_shard( [lib_num]( peer_block_state_index& index ) {
+         auto& stale_blk = index.get<by_block_num>();
+         stale_blk.erase( stale_blk.lower_bound(1), stale_blk.upper_bound(lib_num) );
+      } );
    }
 
    // thread safe
@@ -1941,26 +2404,42 @@ namespace eosio {
 
       if( my_impl->sync_master->syncing_with_peer() ) return;
       
-      bool have_connection = false;
-      for_each_block_connection( [&have_connection]( auto& cp ) {
+      std::vector<connection_ptr> peers;
+      for_each_block_connection( [&peers]( auto& cp ) {
          peer_dlog( cp, "socket_is_open ${s}, connecting ${c}, syncing ${ss}",
                     ("s", cp->socket_is_open())("c", cp->connecting.load())("ss", cp->syncing.load()) );
 
-         if( !cp->current() ) {
-            return true;
+         if( cp->current() ) {
+            peers.push_back( cp );
          }
-         have_connection = true;
-         return false;
+         return true;
       } );
 
-      if( !have_connection ) return;
-      std::shared_ptr<std::vector<char>> send_buffer = create_send_buffer( b );
-
-      for_each_block_connection( [this, &id, bnum = b->block_num(), &send_buffer]( auto& cp ) {
-         if( !cp->current() ) {
-            return true;
+      if( peers.empty() ) return;
+      std::shared_ptr<std::vector<char>> send_buffer = get_block_send_buffer( b, id, false );
+
+      // full blocks go out in relay order, past the fan-out peers are only told the block exists and request it
+      // unless it reaches them over another path first, see recv_notice
+      const size_t full = order_block_relay( peers, my_impl->p2p_block_relay_fanout, []( const connection_ptr& c ) { return c->relay_rank(); } );
+      const uint32_t bnum = b->block_num();
+      for( size_t i = 0; i < peers.size(); ++i ) {
+         const connection_ptr& cp = peers[i];
+         if( i >= full ) {
+            cp->strand.post( [cp, id, bnum]() {
+               std::unique_lock<std::mutex> g_conn( cp->conn_mtx );
+               bool has_block = cp->last_handshake_recv.last_irreversible_block_num >= bnum;
+               g_conn.unlock();
+               if( has_block ) return;
+               notice_message note;
+               note.known_trx.mode = none;
+               note.known_blocks.mode = normal;
+               note.known_blocks.pending = bnum;
+               note.known_blocks.ids.push_back( id );
+               cp->enqueue( note );
+            });
+            continue;
          }
-         cp->strand.post( [this, cp, id, bnum, send_buffer]() {
+         cp->strand.post( [this, cp, b, id, bnum, send_buffer]() {
             std::unique_lock<std::mutex> g_conn( cp->conn_mtx );
             bool has_block = cp->last_handshake_recv.last_irreversible_block_num >= bnum;
             g_conn.unlock();
@@ -1970,11 +2449,65 @@ namespace eosio {
                   return;
                }
                fc_dlog( logger, "bcast block ${b} to ${p}", ("b", bnum)("p", cp->peer_name()) );
-               cp->enqueue_buffer( send_buffer, no_reason );
+               std::shared_ptr<std::vector<char>> sb;
+               if( cp->compact_blocks() ) sb = create_compact_block_send_buffer( b, cp );
+               if( !sb ) sb = cp->compress_blocks() ? get_block_send_buffer( b, id, true ) : send_buffer;
+               cp->enqueue_buffer( sb, no_reason, queued_buffer::block_lane );
             }
          });
-         return true;
-      } );
+      }
+   }
+
+   // thread safe, send buffers are immutable once created
+   std::shared_ptr<std::vector<char>> dispatch_manager::get_block_send_buffer(const signed_block_ptr& b, const block_id_type& id, bool compressed) {
+      {
+         std::lock_guard<std::mutex> g( blk_buffers_mtx );
+         for( const auto& e : blk_buffers ) {
+            if( std::get<1>( e ) == compressed && std::get<0>( e ) == id ) return std::get<2>( e );
+         }
+      }
+      // pack outside of the lock, a concurrent miss for the same block only costs a redundant pack
+      std::shared_ptr<std::vector<char>> send_buffer = compressed ? create_compressed_send_buffer( b ) : create_send_buffer( b );
+      std::lock_guard<std::mutex> g( blk_buffers_mtx );
+      blk_buffers.emplace_front( id, compressed, send_buffer );
+      if( blk_buffers.size() > max_blk_buffers ) blk_buffers.pop_back();
+      return send_buffer;
+   }
+
+   // thread safe, nullptr if the peer is not known to have any of the block's transactions
+   std::shared_ptr<std::vector<char>>
+   dispatch_manager::create_compact_block_send_buffer( const signed_block_ptr& b, const connection_ptr& c ) const {
+      vector<uint32_t> elided;
+      for( uint32_t i = 0; i < b->transactions.size(); ++i ) {
+         const auto& trx = b->transactions[i].trx;
+         if( !trx.contains<packed_transaction>() ) continue;
+         // a trx still queued in the trx lane would reach the peer after the block, which is written first
+         if( c->peer_has_trx( trx.get<packed_transaction>().id() ) ) {
+            elided.push_back( i );
+         }
+      }
+      if( elided.empty() ) return {};
+
+      compact_block_message cbm;
+      cbm.header = *b;
+      cbm.transactions.reserve( b->transactions.size() );
+      auto next = elided.cbegin();
+      for( uint32_t i = 0; i < b->transactions.size(); ++i ) {
+         const auto& r = b->transactions[i];
+         if( next != elided.cend() && *next == i ) {
+            ++next;
+            transaction_receipt cr( r.trx.get<packed_transaction>().id() );
+            static_cast<transaction_receipt_header&>( cr ) = r;
+            cbm.transactions.emplace_back( std::move( cr ) );
+         } else {
+            cbm.transactions.emplace_back( r );
+         }
+      }
+      cbm.block_extensions = b->block_extensions;
+      fc_dlog( logger, "sending compact block ${bn}, ${e} of ${t} trxs elided",
+               ("bn", b->block_num())("e", elided.size())("t", b->transactions.size()) );
+      cbm.elided_trxs = std::move( elided );
+      return create_send_buffer( compact_block_which, cbm );
    }
 
    // called from connection strand
@@ -1998,27 +2531,32 @@ namespace eosio {
       fc_dlog( logger, "rejected block ${id}", ("id", id) );
    }
 
-   void dispatch_manager::bcast_transaction(const packed_transaction& trx) {
-      const auto& id = trx.id();
-      time_point_sec trx_expiration = trx.expiration();
-      node_transaction_state nts = {id, trx_expiration, 0, 0};
+   void dispatch_manager::bcast_transaction(const packed_transaction_ptr& trx) {
+      const auto& id = trx->id();
+      time_point_sec trx_expiration = trx->expiration();
+      // a single local entry, which peers have the trx is tracked by their known_trxs filters
+      add_peer_txn( {id, trx_expiration, 0, 0, trx} );
 
-      std::shared_ptr<std::vector<char>> send_buffer;
-      for_each_connection( [this, &trx, &nts, &send_buffer]( auto& cp ) {
+      // relay the message as received from a peer when there is one, otherwise pack it below
+      std::shared_ptr<std::vector<char>> send_buffer = take_txn_send_buffer( id );
+      for_each_connection( [&id, &trx, &send_buffer]( auto& cp ) {
          if( cp->is_blocks_only_connection() || !cp->current() ) {
             return true;
          }
-         nts.connection_id = cp->connection_id;
-         if( !add_peer_txn(nts) ) {
+         if( cp->trx_lane_backlogged() ) { // do not let a slow peer delay its blocks behind transactions
+            fc_dlog( logger, "trx lane backlogged, not sending trx to ${n}", ("n", cp->peer_name()) );
+            return true;
+         }
+         if( !cp->queue_trx_if_unknown( id ) ) {
             return true;
          }
          if( !send_buffer ) {
-            send_buffer = create_send_buffer( trx );
+            send_buffer = create_send_buffer( *trx );
          }
 
-         cp->strand.post( [cp, send_buffer]() {
+         cp->strand.post( [cp, id, send_buffer]() {
             fc_dlog( logger, "sending trx to ${n}", ("n", cp->peer_name()) );
-            cp->enqueue_buffer( send_buffer, no_reason );
+            cp->enqueue_trx( id, send_buffer );
          } );
          return true;
       } );
@@ -2026,6 +2564,7 @@ namespace eosio {
 
    void dispatch_manager::rejected_transaction(const packed_transaction_ptr& trx, uint32_t head_blk_num) {
       fc_dlog( logger, "not sending rejected transaction ${tid}", ("tid", trx->id()) );
+      take_txn_send_buffer( trx->id() );
       // keep rejected transaction around for awhile so we don't broadcast it
       // update its block number so it will be purged when current block number is lib
       if( trx->expiration() > fc::time_point::now() ) { // no need to update blk_num if already expired
@@ -2036,6 +2575,9 @@ namespace eosio {
    // called from connection strand
    void dispatch_manager::recv_notice(const connection_ptr& c, const notice_message& msg, bool generated) {
       if (msg.known_trx.mode == normal) {
+         for( const auto& id : msg.known_trx.ids ) {
+            c->known_trxs.insert( id );
+         }
       } else if (msg.known_trx.mode != none) {
          fc_elog( logger, "passed a notice_message with something other than a normal on none known_trx" );
          return;
@@ -2046,6 +2588,7 @@ namespace eosio {
             if( msg.known_blocks.pending == 1 ) { // block id notify of 2.0.0, ignore
                return;
             }
+            if( !generated ) fetch_noticed_block( c, msg.known_blocks.ids.back() );
          }
       } else if (msg.known_blocks.mode != none) {
          fc_elog( logger, "passed a notice_message with something other than a normal on none known_blocks" );
@@ -2053,6 +2596,27 @@ namespace eosio {
       }
    }
 
+   // thread safe
+   void dispatch_manager::fetch_noticed_block(const connection_ptr& c, const block_id_type& id) {
+      if( have_block( id ) ) return;
+      // a peer past the relay fan-out of the producing side, the block usually arrives in full from another peer first
+      auto timer = std::make_shared<boost::asio::steady_timer>( my_impl->thread_pool->get_executor() );
+      timer->expires_from_now( noticed_block_fetch_delay );
+      timer->async_wait( [timer, weak = std::weak_ptr<connection>( c ), id]( const boost::system::error_code& ec ) {
+         auto c = weak.lock();
+         if( ec || !c || !c->current() || my_impl->sync_master->syncing_with_peer() || my_impl->dispatcher->have_block( id ) ) return;
+         c->strand.post( [c, id]() {
+            fc_dlog( logger, "requesting noticed block ${n} ${id}... from ${p}",
+                     ("n", block_header::num_from_id( id ))("id", id.str().substr( 8, 16 ))("p", c->peer_name()) );
+            request_message req;
+            req.req_trx.mode = none;
+            req.req_blocks.mode = normal;
+            req.req_blocks.ids.push_back( id );
+            c->enqueue( req );
+         } );
+      } );
+   }
+
    void dispatch_manager::retry_fetch(const connection_ptr& c) {
       fc_dlog( logger, "retry fetch" );
       request_message last_req;
@@ -2188,12 +2752,32 @@ namespace eosio {
       } ) );
    }
 
-   void net_plugin_impl::start_listen_loop() {
+   // optional tuning, failures are logged and the connection is kept with the OS defaults
+   void net_plugin_impl::set_socket_options( tcp::socket& socket, const string& peer ) const {
+      boost::system::error_code ec;
+      if( p2p_socket_send_buffer > 0 ) {
+         socket.set_option( boost::asio::socket_base::send_buffer_size( p2p_socket_send_buffer ), ec );
+         if( ec ) fc_wlog( logger, "unable to set SO_SNDBUF for ${p}: ${e}", ("p", peer)("e", ec.message()) );
+      }
+      if( p2p_socket_receive_buffer > 0 ) {
+         socket.set_option( boost::asio::socket_base::receive_buffer_size( p2p_socket_receive_buffer ), ec );
+         if( ec ) fc_wlog( logger, "unable to set SO_RCVBUF for ${p}: ${e}", ("p", peer)("e", ec.message()) );
+      }
+#ifdef SO_BUSY_POLL
+      if( p2p_socket_busy_poll_usec > 0 ) {
+         using busy_poll = boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>;
+         socket.set_option( busy_poll( p2p_socket_busy_poll_usec ), ec );
+         if( ec ) fc_wlog( logger, "unable to set SO_BUSY_POLL for ${p}: ${e}", ("p", peer)("e", ec.message()) );
+      }
+#endif
+   }
+
+   void net_plugin_impl::start_listen_loop( tcp::acceptor& acceptor ) {
       connection_ptr new_connection = std::make_shared<connection>();
       new_connection->connecting = true;
-      new_connection->strand.post( [this, new_connection = std::move( new_connection )](){
-         acceptor->async_accept( *new_connection->socket,
-            boost::asio::bind_executor( new_connection->strand, [new_connection, socket=new_connection->socket, this]( boost::system::error_code ec ) {
+      new_connection->strand.post( [this, &acceptor, new_connection = std::move( new_connection )](){
+         acceptor.async_accept( *new_connection->socket,
+            boost::asio::bind_executor( new_connection->strand, [new_connection, socket=new_connection->socket, this, &acceptor]( boost::system::error_code ec ) {
             if( !ec ) {
                uint32_t visitors = 0;
                uint32_t from_addr = 0;
@@ -2251,7 +2835,7 @@ namespace eosio {
                      return;
                }
             }
-            start_listen_loop();
+            start_listen_loop( acceptor );
          }));
       } );
    }
@@ -2378,6 +2962,7 @@ namespace eosio {
 
    // called from connection strand
    bool connection::process_next_message( uint32_t message_length ) {
+      scoped_span span( "net", "process_next_message" );
       try {
          // if next message is a block we already have, exit early
          auto peek_ds = pending_message_buffer.create_peek_datastream();
@@ -2387,66 +2972,32 @@ namespace eosio {
             block_header bh;
             fc::raw::unpack( peek_ds, bh );
 
-            const block_id_type blk_id = bh.id();
-            const uint32_t blk_num = bh.block_num();
-            if( my_impl->dispatcher->have_block( blk_id ) ) {
-               fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
-                        ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
-               my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
-               cancel_wait();
-
-               pending_message_buffer.advance_read_ptr( message_length );
-               return true;
-            }
-            fc_dlog( logger, "${p} received block ${num}, id ${id}..., latency: ${latency}",
-                     ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16))
-                     ("latency", (fc::time_point::now() - bh.timestamp).count()/1000) );
-            if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
-               uint32_t lib = 0;
-               std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
-               if( blk_num < lib ) {
-                  std::unique_lock<std::mutex> g( conn_mtx );
-                  const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
-                  g.unlock();
-                  if( blk_num < last_sent_lib ) {
-                     fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
-                     close();
-                  } else {
-                     fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
-                     enqueue( (sync_request_message) {0, 0} );
-                     send_handshake();
-                     cancel_wait();
-                  }
-
-                  pending_message_buffer.advance_read_ptr( message_length );
-                  return true;
-               }
-            }
+            return process_block_message( bh, message_length, [this]() {
+               auto ds = pending_message_buffer.create_datastream();
+               unsigned_int which{};
+               fc::raw::unpack( ds, which ); // throw away
+               shared_ptr<signed_block> ptr = std::make_shared<signed_block>();
+               fc::raw::unpack( ds, *ptr );
+               return ptr;
+            } );
 
+         } else if( which == compressed_block_which ) {
+            // header is only available after decompression, so the whole message is consumed up front
             auto ds = pending_message_buffer.create_datastream();
             fc::raw::unpack( ds, which ); // throw away
-            shared_ptr<signed_block> ptr = std::make_shared<signed_block>();
-            fc::raw::unpack( ds, *ptr );
+            compressed_block_message cbm;
+            fc::raw::unpack( ds, cbm );
+            signed_block_ptr ptr = decompress_block( cbm );
 
-            auto is_webauthn_sig = []( const fc::crypto::signature& s ) {
-               return s.which() == fc::crypto::signature::storage_type::position<fc::crypto::webauthn::signature>();
-            };
-            bool has_webauthn_sig = is_webauthn_sig( ptr->producer_signature );
-
-            constexpr auto additional_sigs_eid = additional_block_signatures_extension::extension_id();
-            auto exts = ptr->validate_and_extract_extensions();
-            if( exts.count( additional_sigs_eid ) ) {
-               const auto &additional_sigs = exts.lower_bound( additional_sigs_eid )->second.get<additional_block_signatures_extension>().signatures;
-               has_webauthn_sig |= std::any_of( additional_sigs.begin(), additional_sigs.end(), is_webauthn_sig );
-            }
+            return process_block_message( *ptr, 0, [&ptr]() { return ptr; } );
 
-            if( has_webauthn_sig ) {
-               fc_dlog( logger, "WebAuthn signed block received from ${p}, closing connection", ("p", peer_name()));
-               close();
-               return false;
-            }
+         } else if( which == compact_block_which ) {
+            auto ds = pending_message_buffer.create_datastream();
+            fc::raw::unpack( ds, which ); // throw away
+            compact_block_message cbm;
+            fc::raw::unpack( ds, cbm );
 
-            handle_message( blk_id, std::move( ptr ) );
+            return process_block_message( cbm.header, 0, [this, &cbm]() { return rebuild_compact_block( cbm ); } );
 
          } else if( which == packed_transaction_which ) {
             if( !my_impl->p2p_accept_transactions ) {
@@ -2455,11 +3006,19 @@ namespace eosio {
                return true;
             }
 
-            auto ds = pending_message_buffer.create_datastream();
+            // copy the message out of the receive buffer once, it is unpacked from and later relayed from this copy
+            auto send_buffer = std::make_shared<vector<char>>( message_header_size + message_length );
+            static_assert( sizeof( message_length ) == message_header_size, "invalid message_header_size" );
+            memcpy( send_buffer->data(), &message_length, message_header_size );
+            auto raw_ds = pending_message_buffer.create_peek_datastream();
+            raw_ds.read( send_buffer->data() + message_header_size, message_length );
+            pending_message_buffer.advance_read_ptr( message_length );
+
+            fc::datastream<const char*> ds( send_buffer->data() + message_header_size, message_length );
             fc::raw::unpack( ds, which ); // throw away
             shared_ptr<packed_transaction> ptr = std::make_shared<packed_transaction>();
             fc::raw::unpack( ds, *ptr );
-            handle_message( std::move( ptr ) );
+            handle_message( std::move( ptr ), std::move( send_buffer ) );
 
          } else {
             auto ds = pending_message_buffer.create_datastream();
@@ -2478,6 +3037,111 @@ namespace eosio {
       return true;
    }
 
+   // called from connection strand
+   bool connection::process_block_message( const block_header& bh, uint32_t skip_length,
+                                           const std::function<signed_block_ptr()>& unpack_block ) {
+      const block_id_type blk_id = bh.id();
+      const uint32_t blk_num = bh.block_num();
+      if( my_impl->dispatcher->have_block( blk_id ) ) {
+         fc_dlog( logger, "canceling wait on ${p}, already received block ${num}, id ${id}...",
+                  ("p", peer_name())("num", blk_num)("id", blk_id.str().substr(8,16)) );
+         my_impl->sync_master->sync_recv_block( shared_from_this(), blk_id, blk_num, false );
+         cancel_wait();
+
+         pending_message_buffer.advance_read_ptr( skip_length );
+         return true;
+      }
+      fc_dlog( logger, "${p} received block ${num}, id ${id}..., latency: ${latency}",
+               ("p", peer_name())("num", bh.block_num())("id", blk_id.str().substr(8,16))
+               ("latency", (fc::time_point::now() - bh.timestamp).count()/1000) );
+      if( !my_impl->sync_master->syncing_with_peer() ) { // guard against peer thinking it needs to send us old blocks
+         uint32_t lib = 0;
+         std::tie( lib, std::ignore, std::ignore, std::ignore, std::ignore, std::ignore ) = my_impl->get_chain_info();
+         if( blk_num < lib ) {
+            std::unique_lock<std::mutex> g( conn_mtx );
+            const auto last_sent_lib = last_handshake_sent.last_irreversible_block_num;
+            g.unlock();
+            if( blk_num < last_sent_lib ) {
+               fc_ilog( logger, "received block ${n} less than sent lib ${lib}", ("n", blk_num)("lib", last_sent_lib) );
+               close();
+            } else {
+               fc_ilog( logger, "received block ${n} less than lib ${lib}", ("n", blk_num)("lib", lib) );
+               enqueue( (sync_request_message) {0, 0} );
+               send_handshake();
+               cancel_wait();
+            }
+
+            pending_message_buffer.advance_read_ptr( skip_length );
+            return true;
+         }
+      }
+
+      signed_block_ptr ptr = unpack_block();
+      if( !ptr ) return true; // compact block missing transactions, full block requested
+      ++blocks_received;
+      block_propagation.add( fc::time_point::now() - bh.timestamp );
+
+      auto is_webauthn_sig = []( const fc::crypto::signature& s ) {
+         return s.which() == fc::crypto::signature::storage_type::position<fc::crypto::webauthn::signature>();
+      };
+      bool has_webauthn_sig = is_webauthn_sig( ptr->producer_signature );
+
+      constexpr auto additional_sigs_eid = additional_block_signatures_extension::extension_id();
+      auto exts = ptr->validate_and_extract_extensions();
+      if( exts.count( additional_sigs_eid ) ) {
+         const auto &additional_sigs = exts.lower_bound( additional_sigs_eid )->second.get<additional_block_signatures_extension>().signatures;
+         has_webauthn_sig |= std::any_of( additional_sigs.begin(), additional_sigs.end(), is_webauthn_sig );
+      }
+
+      if( has_webauthn_sig ) {
+         fc_dlog( logger, "WebAuthn signed block received from ${p}, closing connection", ("p", peer_name()));
+         close();
+         return false;
+      }
+
+      handle_message( blk_id, std::move( ptr ) );
+      return true;
+   }
+
+   // called from connection strand
+   signed_block_ptr connection::rebuild_compact_block( compact_block_message& cbm ) {
+      bool missing = false;
+      for( uint32_t i : cbm.elided_trxs ) {
+         EOS_ASSERT( i < cbm.transactions.size() && cbm.transactions[i].trx.contains<transaction_id_type>(), plugin_exception,
+                     "invalid compact block elided transaction index ${i}", ("i", i) );
+         packed_transaction_ptr trx = my_impl->dispatcher->get_txn( cbm.transactions[i].trx.get<transaction_id_type>() );
+         if( !trx ) {
+            missing = true;
+            break;
+         }
+         cbm.transactions[i].trx = *trx;
+      }
+
+      signed_block_ptr ptr = std::make_shared<signed_block>( cbm.header );
+      if( !missing ) {
+         ptr->transactions = std::move( cbm.transactions );
+         ptr->block_extensions = std::move( cbm.block_extensions );
+         // a trx with the same id may carry different signatures than the one the producer included
+         vector<digest_type> trx_digests;
+         trx_digests.reserve( ptr->transactions.size() );
+         for( const auto& r : ptr->transactions ) {
+            trx_digests.emplace_back( r.digest() );
+         }
+         if( merkle( std::move( trx_digests ) ) == ptr->transaction_mroot ) {
+            return ptr;
+         }
+      }
+
+      const block_id_type blk_id = ptr->id();
+      fc_dlog( logger, "unable to rebuild compact block ${num} from ${p}, requesting full block",
+               ("num", ptr->block_num())("p", peer_name()) );
+      request_message req;
+      req.req_blocks.mode = normal;
+      req.req_blocks.ids.push_back( blk_id );
+      enqueue( req );
+      return {};
+   }
+
    // call only from main application thread
    void net_plugin_impl::update_chain_info() {
       controller& cc = chain_plug->chain();
@@ -2560,6 +3224,8 @@ namespace eosio {
             return;
          }
 
+         producer_peer = my_impl->is_producer_peer( peer_address() ) || my_impl->is_producer_peer( msg.p2p_address );
+
          if( peer_address().empty() ) {
             set_connection_type( msg.p2p_address );
          }
@@ -2628,7 +3294,8 @@ namespace eosio {
 
          uint32_t peer_lib = msg.last_irreversible_block_num;
          connection_wptr weak = shared_from_this();
-         app().post( priority::medium, [peer_lib, chain_plug = my_impl->chain_plug, weak{std::move(weak)},
+         static auto& origin = app_thread_stats::origin( "net:handshake", priority::medium );
+         app_thread_post( origin, [peer_lib, chain_plug = my_impl->chain_plug, weak{std::move(weak)},
                                      msg_lib_id = msg.last_irreversible_block_id]() {
             connection_ptr c = weak.lock();
             if( !c ) return;
@@ -2712,6 +3379,10 @@ namespace eosio {
       double offset = (double(rec - org) + double(msg.xmt - dst)) / 2;
       double NsecPerUsec{1000};
 
+      if( msg.org == org ) { // answers our last send_time()
+         rtt_us = smoothed_rtt_us( rtt_us.load( std::memory_order_relaxed ), time_message_rtt_us( org, rec, msg.xmt, dst ) );
+      }
+
       if( logger.is_enabled( fc::log_level::all ) )
          logger.log( FC_LOG_MESSAGE( all, "Clock offset is ${o}ns (${us}us)",
                                      ("o", offset)( "us", offset / NsecPerUsec ) ) );
@@ -2833,6 +3504,9 @@ namespace eosio {
       if( msg.end_block == 0 ) {
          peer_requested.reset();
          flush_queues();
+      } else if( peer_requested && msg.start_block == peer_requested->end_block + 1 ) {
+         // pipelined request, blocks are still being sent so just extend the range
+         peer_requested->end_block = msg.end_block;
       } else {
          peer_requested = peer_sync_state( msg.start_block, msg.end_block, msg.start_block-1);
          enqueue_sync_block();
@@ -2846,9 +3520,11 @@ namespace eosio {
              trx->get_signatures().size() * sizeof(signature_type);
    }
 
-   void connection::handle_message( packed_transaction_ptr trx ) {
+   void connection::handle_message( packed_transaction_ptr trx, std::shared_ptr<vector<char>> send_buffer ) {
       const auto& tid = trx->id();
+      scoped_span span( "net", "receive_transaction", span_trace_id( tid ) );
       peer_dlog( this, "received packed_transaction ${id}", ("id", tid) );
+      known_trxs.insert( tid );
 
       uint32_t trx_in_progress_sz = this->trx_in_progress_size.load();
       if( trx_in_progress_sz > def_max_trx_in_progress_size ) {
@@ -2857,17 +3533,16 @@ namespace eosio {
          return;
       }
 
-      bool have_trx = my_impl->dispatcher->have_txn( tid );
-      node_transaction_state nts = {tid, trx->expiration(), 0, connection_id};
-      my_impl->dispatcher->add_peer_txn( nts );
-
-      if( have_trx ) {
+      if( my_impl->dispatcher->have_txn( tid ) ) {
          fc_dlog( logger, "got a duplicate transaction - dropping ${id}", ("id", tid) );
          return;
       }
+      my_impl->dispatcher->add_peer_txn( {tid, trx->expiration(), 0, connection_id, trx, std::move( send_buffer )} );
+      transaction_latency::received( tid );
 
       trx_in_progress_size += calc_trx_size( trx );
-      app().post( priority::low, [trx{std::move(trx)}, weak = weak_from_this()]() {
+      static auto& origin = app_thread_stats::origin( "net:transaction", priority::low );
+      app_thread_post( origin, [trx{std::move(trx)}, weak = weak_from_this()]() {
          my_impl->chain_plug->accept_transaction( trx,
             [weak, trx](const static_variant<fc::exception_ptr, transaction_trace_ptr>& result) mutable {
          // next (this lambda) called from application thread
@@ -2890,16 +3565,24 @@ namespace eosio {
    }
 
    // called from connection strand
+   /// blocks go to the app thread at medium priority while syncing and at high priority otherwise
+   static app_thread_origin& block_origin( int pri ) {
+      static auto& syncing = app_thread_stats::origin( "net:block", priority::medium, true );
+      static auto& live = app_thread_stats::origin( "net:block", priority::high, true );
+      return pri == priority::high ? live : syncing;
+   }
+
    void connection::handle_message( const block_id_type& id, signed_block_ptr ptr ) {
+      scoped_span span( "net", "receive_block", span_trace_id( id ) );
       peer_dlog( this, "received signed_block ${id}", ("id", ptr->block_num() ) );
       auto priority = my_impl->sync_master->syncing_with_peer() ? priority::medium : priority::high;
-      app().post(priority, [ptr{std::move(ptr)}, id, c = shared_from_this()]() mutable {
-         c->process_signed_block( id, std::move( ptr ) );
+      app_thread_post( block_origin( priority ), [ptr{std::move(ptr)}, id, c = shared_from_this(), received = fc::time_point::now()]() mutable {
+         c->process_signed_block( id, std::move( ptr ), received );
       });
    }
 
    // called from application thread
-   void connection::process_signed_block( const block_id_type& blk_id, signed_block_ptr msg ) {
+   void connection::process_signed_block( const block_id_type& blk_id, signed_block_ptr msg, const fc::time_point& received ) {
       controller& cc = my_impl->chain_plug->chain();
       uint32_t blk_num = msg->block_num();
       // use c in this method instead of this to highlight that all methods called on c-> must be thread safe
@@ -2933,6 +3616,7 @@ namespace eosio {
          my_impl->update_chain_info();
          if( !accepted ) return;
          reason = no_reason;
+         c->block_receive_to_apply.add( fc::time_point::now() - received );
       } catch( const unlinkable_block_exception &ex) {
          peer_elog(c, "unlinkable_block_exception #${n} ${id}...: ${m}", ("n", blk_num)("id", blk_id.str().substr(8,16))("m",ex.to_string()));
          reason = unlinkable;
@@ -3003,6 +3687,14 @@ namespace eosio {
       } );
    }
 
+   bool net_plugin_impl::is_producer_peer( const string& addr ) const {
+      if( addr.empty() ) return false;
+      // a handshake p2p_address may carry " - <id>" or a :trx/:blk suffix after host:port
+      return std::any_of( p2p_producer_peers.begin(), p2p_producer_peers.end(), [&addr]( const string& p ) {
+         return addr.compare( 0, p.size(), p ) == 0 && (addr.size() == p.size() || addr[p.size()] == ' ' || addr[p.size()] == ':');
+      } );
+   }
+
    // thread safe
    void net_plugin_impl::ticker() {
       if( in_shutdown ) return;
@@ -3135,7 +3827,7 @@ namespace eosio {
             dispatcher->rejected_transaction(results.second->packed_trx(), head_blk_num);
          } else {
             fc_dlog( logger, "signaled ACK, trx-id = ${id}", ("id", id) );
-            dispatcher->bcast_transaction(*results.second->packed_trx());
+            dispatcher->bcast_transaction(results.second->packed_trx());
          }
       });
    }
@@ -3280,6 +3972,12 @@ namespace eosio {
            "    p2p.blk.eos.io:9876:blk\n")
          ( "p2p-max-nodes-per-host", bpo::value<int>()->default_value(def_max_nodes_per_host), "Maximum number of client nodes from any single IP address")
          ( "p2p-accept-transactions", bpo::value<bool>()->default_value(true), "Allow transactions received over p2p network to be evaluated and relayed if valid.")
+         ( "p2p-compress-blocks", bpo::value<bool>()->default_value(false), "Send blocks zlib compressed to peers that support compressed block messages. Compressed blocks are always accepted.")
+         ( "p2p-compact-blocks", bpo::value<bool>()->default_value(false), "Broadcast blocks to peers that support compact block messages with the transactions they already have replaced by ids. Compact blocks are always accepted.")
+         ( "p2p-producer-peer", bpo::value<vector<string>>()->composing(),
+           "host:port of a peer on the path to block producers, broadcast blocks are sent to these peers before any other. May be used multiple times.")
+         ( "p2p-block-relay-fanout", bpo::value<uint32_t>()->default_value(0),
+           "Number of other peers, lowest round trip time first, that broadcast blocks are sent to in full. The remaining peers are sent a notice of the block and request it if it has not reached them from another peer shortly after. 0 sends every peer the block.")
          ( "agent-name", bpo::value<string>()->default_value("\"EOS Test Agent\""), "The name supplied to identify this node amongst the peers.")
          ( "allowed-connection", bpo::value<vector<string>>()->multitoken()->default_value({"any"}, "any"), "Can be 'any' or 'producers' or 'specified' or 'none'. If 'specified', peer-key must be specified at least once. If only 'producers', peer-key is not required. 'producers' and 'specified' may be combined.")
          ( "peer-key", bpo::value<vector<string>>()->composing()->multitoken(), "Optional public key of peer allowed to connect.  May be used multiple times.")
@@ -3290,6 +3988,12 @@ namespace eosio {
          ( "max-cleanup-time-msec", bpo::value<int>()->default_value(10), "max connection cleanup time per cleanup call in millisec")
          ( "net-threads", bpo::value<uint16_t>()->default_value(my->thread_pool_size),
            "Number of worker threads in net_plugin thread pool" )
+         ( "p2p-listen-acceptors", bpo::value<uint16_t>()->default_value(my->p2p_listen_acceptors),
+           "Number of acceptors listening on p2p-listen-endpoint. More than 1 requires SO_REUSEPORT and lets incoming connections be accepted concurrently by the net threads.")
+         ( "p2p-tcp-nodelay", bpo::value<bool>()->default_value(my->p2p_tcp_nodelay), "Set TCP_NODELAY on p2p sockets")
+         ( "p2p-socket-send-buffer-bytes", bpo::value<int>()->default_value(0), "SO_SNDBUF for p2p sockets, 0 to use the OS default")
+         ( "p2p-socket-receive-buffer-bytes", bpo::value<int>()->default_value(0), "SO_RCVBUF for p2p sockets, 0 to use the OS default")
+         ( "p2p-socket-busy-poll-usec", bpo::value<int>()->default_value(0), "SO_BUSY_POLL for p2p sockets where supported, 0 to disable")
          ( "sync-fetch-span", bpo::value<uint32_t>()->default_value(def_sync_fetch_span), "number of blocks to retrieve in a chunk from any individual peer during synchronization")
          ( "use-socket-read-watermark", bpo::value<bool>()->default_value(false), "Enable experimental socket read watermark optimization")
          ( "peer-log-format", bpo::value<string>()->default_value( "[\"${_name}\" ${_ip}:${_port}]" ),
@@ -3324,6 +4028,12 @@ namespace eosio {
          my->max_client_count = options.at( "max-clients" ).as<int>();
          my->max_nodes_per_host = options.at( "p2p-max-nodes-per-host" ).as<int>();
          my->p2p_accept_transactions = options.at( "p2p-accept-transactions" ).as<bool>();
+         my->p2p_compress_blocks = options.at( "p2p-compress-blocks" ).as<bool>();
+         my->p2p_compact_blocks = options.at( "p2p-compact-blocks" ).as<bool>();
+         if( options.count( "p2p-producer-peer" ) ) {
+            my->p2p_producer_peers = options.at( "p2p-producer-peer" ).as<vector<string>>();
+         }
+         my->p2p_block_relay_fanout = options.at( "p2p-block-relay-fanout" ).as<uint32_t>();
 
          my->use_socket_read_watermark = options.at( "use-socket-read-watermark" ).as<bool>();
 
@@ -3342,6 +4052,18 @@ namespace eosio {
          EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
                      "net-threads ${num} must be greater than 0", ("num", my->thread_pool_size) );
 
+         my->p2p_listen_acceptors = options.at( "p2p-listen-acceptors" ).as<uint16_t>();
+         EOS_ASSERT( my->p2p_listen_acceptors > 0, chain::plugin_config_exception,
+                     "p2p-listen-acceptors ${num} must be greater than 0", ("num", my->p2p_listen_acceptors) );
+#ifndef SO_REUSEPORT
+         EOS_ASSERT( my->p2p_listen_acceptors == 1, chain::plugin_config_exception,
+                     "p2p-listen-acceptors > 1 requires SO_REUSEPORT which is not supported on this platform" );
+#endif
+         my->p2p_tcp_nodelay = options.at( "p2p-tcp-nodelay" ).as<bool>();
+         my->p2p_socket_send_buffer = options.at( "p2p-socket-send-buffer-bytes" ).as<int>();
+         my->p2p_socket_receive_buffer = options.at( "p2p-socket-receive-buffer-bytes" ).as<int>();
+         my->p2p_socket_busy_poll_usec = options.at( "p2p-socket-busy-poll-usec" ).as<int>();
+
          if( options.count( "p2p-peer-address" )) {
             my->supplied_peers = options.at( "p2p-peer-address" ).as<vector<string> >();
          }
@@ -3401,6 +4123,10 @@ namespace eosio {
          }
          if( my->p2p_accept_transactions ) {
             my->chain_plug->enable_accept_transactions();
+            if( !my->chain_plug->accept_transactions() ) {
+               my->p2p_accept_transactions = false;
+               wlog( "p2p-accept-transactions set to false, the chain plugin does not accept transactions" );
+            }
          }
 
       } FC_LOG_AND_RETHROW()
@@ -3436,7 +4162,9 @@ namespace eosio {
          tcp::resolver resolver( my->thread_pool->get_executor() );
          listen_endpoint = *resolver.resolve( query );
 
-         my->acceptor.reset( new tcp::acceptor( my_impl->thread_pool->get_executor() ) );
+         for( uint16_t i = 0; i < my->p2p_listen_acceptors; ++i ) {
+            my->acceptors.emplace_back( new tcp::acceptor( my_impl->thread_pool->get_executor() ) );
+         }
 
          if( !my->p2p_server_address.empty() ) {
             my->p2p_address = my->p2p_server_address;
@@ -3456,18 +4184,28 @@ namespace eosio {
          }
       }
 
-      if( my->acceptor ) {
-         try {
-           my->acceptor->open(listen_endpoint.protocol());
-           my->acceptor->set_option(tcp::acceptor::reuse_address(true));
-           my->acceptor->bind(listen_endpoint);
-           my->acceptor->listen();
-         } catch (const std::exception& e) {
-           elog( "net_plugin::plugin_startup failed to bind to port ${port}", ("port", listen_endpoint.port()) );
-           throw e;
+      if( !my->acceptors.empty() ) {
+         for( auto& acceptor : my->acceptors ) {
+            try {
+              acceptor->open(listen_endpoint.protocol());
+              acceptor->set_option(tcp::acceptor::reuse_address(true));
+#ifdef SO_REUSEPORT
+              if( my->acceptors.size() > 1 ) {
+                 // kernel load balances incoming connections across the acceptors bound to the same port
+                 acceptor->set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+              }
+#endif
+              acceptor->bind(listen_endpoint);
+              acceptor->listen();
+            } catch (const std::exception& e) {
+              elog( "net_plugin::plugin_startup failed to bind to port ${port}", ("port", listen_endpoint.port()) );
+              throw e;
+            }
+         }
+         fc_ilog( logger, "starting ${n} listener(s), max clients is ${mc}",("n", my->acceptors.size())("mc",my->max_client_count) );
+         for( auto& acceptor : my->acceptors ) {
+            my->start_listen_loop( *acceptor );
          }
-         fc_ilog( logger, "starting listener, max clients is ${mc}",("mc",my->max_client_count) );
-         my->start_listen_loop();
       }
       {
          chain::controller& cc = my->chain_plug->chain();
@@ -3542,10 +4280,10 @@ namespace eosio {
             my->thread_pool->stop();
          }
 
-         if( my->acceptor ) {
+         for( auto& acceptor : my->acceptors ) {
             boost::system::error_code ec;
-            my->acceptor->cancel( ec );
-            my->acceptor->close( ec );
+            acceptor->cancel( ec );
+            acceptor->close( ec );
          }
 
          app().post( 0, [me = my](){} ); // keep my pointer alive until queue is drained
@@ -3602,6 +4340,16 @@ namespace eosio {
       return result;
    }
 
+   net_metrics net_plugin::metrics()const {
+      net_metrics result;
+      std::shared_lock<std::shared_mutex> g( my->connections_mtx );
+      result.connections.reserve( my->connections.size() );
+      for( const auto& c : my->connections ) {
+         result.connections.push_back( c->get_metrics() );
+      }
+      return result;
+   }
+
    // call with connections_mtx
    connection_ptr net_plugin_impl::find_connection( const string& host )const {
       for( const auto& c : connections )
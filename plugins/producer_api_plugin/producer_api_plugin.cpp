@@ -39,6 +39,19 @@ struct async_result_visitor : public fc::visitor<fc::variant> {
           } \
        }}
 
+// for calls whose result is already serialized JSON
+#define CALL_JSON(api_name, api_handle, call_name, INVOKE, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [&api_handle](string, string body, url_response_callback cb) mutable { \
+          try { \
+             if (body.empty()) body = "{}"; \
+             INVOKE \
+             cb(http_response_code, url_response_body::from_json(std::move(result))); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, body, cb); \
+          } \
+       }}
+
 #define CALL_ASYNC(api_name, api_handle, call_name, call_result, INVOKE, http_response_code) \
 {std::string("/v1/" #api_name "/" #call_name), \
    [&api_handle](string, string body, url_response_callback cb) mutable { \
@@ -71,6 +84,9 @@ struct async_result_visitor : public fc::visitor<fc::variant> {
 #define INVOKE_R_V_ASYNC(api_handle, call_name)\
      api_handle.call_name(next);
 
+#define INVOKE_V_R_ASYNC(api_handle, call_name, in_param)\
+     api_handle.call_name(fc::json::from_string(body).as<in_param>(), next);
+
 #define INVOKE_V_R(api_handle, call_name, in_param) \
      api_handle.call_name(fc::json::from_string(body).as<in_param>()); \
      eosio::detail::producer_api_plugin_response result{"ok"};
@@ -124,6 +140,16 @@ void producer_api_plugin::plugin_startup() {
                                  producer_plugin::get_supported_protocol_features_params), 201),
        CALL(producer, producer, get_account_ram_corrections,
             INVOKE_R_R(producer, get_account_ram_corrections, producer_plugin::get_account_ram_corrections_params), 201),
+       CALL(producer, producer, get_wasm_execution_stats,
+            INVOKE_R_V(producer, get_wasm_execution_stats), 201),
+       CALL(producer, producer, get_block_timings,
+            INVOKE_R_R(producer, get_block_timings, producer_plugin::get_block_timings_params), 201),
+       CALL(producer, producer, get_transaction_latency,
+            INVOKE_R_V(producer, get_transaction_latency), 201),
+       CALL_ASYNC(producer, producer, profile, producer_plugin::profile_result,
+            INVOKE_V_R_ASYNC(producer, profile, producer_plugin::profile_params), 201),
+       CALL_JSON(producer, producer, get_spans,
+            INVOKE_R_R(producer, get_spans, producer_plugin::get_spans_params), 201),
    }, appbase::priority::medium);
 }
 
@@ -149,6 +175,7 @@ void producer_api_plugin::plugin_initialize(const variables_map& options) {
 #undef INVOKE_R_R_R_R
 #undef INVOKE_R_V
 #undef INVOKE_V_R
+#undef INVOKE_V_R_ASYNC
 #undef INVOKE_V_R_R
 #undef INVOKE_V_V
 #undef CALL
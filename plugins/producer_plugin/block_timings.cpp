@@ -0,0 +1,66 @@
+#include <eosio/producer_plugin/block_timings.hpp>
+
+#include <algorithm>
+
+namespace eosio {
+
+namespace {
+   bool slower( const producer_plugin::slow_action& a, const producer_plugin::slow_action& b ) {
+      return a.elapsed_us > b.elapsed_us;
+   }
+}
+
+void block_timings::add_action( producer_plugin::block_timing& t, const producer_plugin::slow_action& a ) {
+   auto& slowest = t.slowest_actions;
+   if( slowest.size() == slowest_actions_per_block && a.elapsed_us <= slowest.back().elapsed_us )
+      return;
+   slowest.insert( std::upper_bound( slowest.begin(), slowest.end(), a, slower ), a );
+   if( slowest.size() > slowest_actions_per_block )
+      slowest.pop_back();
+}
+
+void block_timings::record( producer_plugin::block_timing&& t ) {
+   timings.emplace_back( std::move( t ) );
+   while( timings.size() > history )
+      timings.pop_front();
+}
+
+producer_plugin::get_block_timings_result block_timings::summarize( uint32_t limit ) const {
+   using block_timing = producer_plugin::block_timing;
+   using phase_t = int64_t block_timing::*;
+   static const std::vector<std::pair<std::string, phase_t>> phases = {
+      {"start_block", &block_timing::start_block_us}, {"unapplied", &block_timing::unapplied_us},
+      {"scheduled", &block_timing::scheduled_us}, {"incoming", &block_timing::incoming_us},
+      {"finalize", &block_timing::finalize_us}, {"sign", &block_timing::sign_us}, {"commit", &block_timing::commit_us}
+   };
+
+   producer_plugin::get_block_timings_result result;
+   for( auto itr = timings.rbegin(); itr != timings.rend() && result.blocks.size() < limit; ++itr ) {
+      result.blocks.push_back( *itr );
+   }
+
+   for( const auto& phase : phases ) {
+      producer_plugin::phase_histogram h{ phase.first, {} };
+      for( const auto& t : timings ) {
+         const uint64_t us = std::max<int64_t>( t.*phase.second, 0 );
+         size_t bucket = 0;
+         while( (us >> (bucket + 1)) != 0 )
+            ++bucket;
+         if( h.buckets.size() <= bucket )
+            h.buckets.resize( bucket + 1 );
+         ++h.buckets[bucket];
+      }
+      result.histograms.emplace_back( std::move( h ) );
+   }
+
+   for( const auto& t : timings ) {
+      result.slowest_actions.insert( result.slowest_actions.end(), t.slowest_actions.begin(), t.slowest_actions.end() );
+   }
+   const auto n = std::min( result.slowest_actions.size(), slowest_actions_per_block );
+   std::partial_sort( result.slowest_actions.begin(), result.slowest_actions.begin() + n, result.slowest_actions.end(), slower );
+   result.slowest_actions.resize( n );
+
+   return result;
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <eosio/producer_plugin/producer_plugin.hpp>
+
+#include <deque>
+
+namespace eosio {
+
+   /**
+    * The timings of the last blocks produced, as reported by producer_plugin::get_block_timings.
+    */
+   class block_timings {
+   public:
+      static constexpr size_t slowest_actions_per_block = 10;
+
+      explicit block_timings( uint32_t history = 0 ) : history( history ) {}
+
+      /// adds a to the slowest actions of t, unless slowest_actions_per_block slower ones are there already
+      static void add_action( producer_plugin::block_timing& t, const producer_plugin::slow_action& a );
+
+      /// retains t, dropping the oldest timings beyond history
+      void record( producer_plugin::block_timing&& t );
+
+      /// the limit most recent timings, with the phase histograms and the slowest actions of every retained one
+      producer_plugin::get_block_timings_result summarize( uint32_t limit ) const;
+
+   private:
+      uint32_t                                  history;
+      std::deque<producer_plugin::block_timing> timings; ///< oldest first
+   };
+
+}
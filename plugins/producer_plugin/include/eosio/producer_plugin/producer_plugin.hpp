@@ -2,6 +2,7 @@
 
 #include <eosio/chain_plugin/chain_plugin.hpp>
 #include <eosio/http_client_plugin/http_client_plugin.hpp>
+#include <eosio/chain/transaction_latency.hpp>
 
 #include <appbase/application.hpp>
 
@@ -68,6 +69,64 @@ public:
       optional<account_name>   more;
    };
 
+   /// an action executed for a produced block, as reported by get_block_timings
+   struct slow_action {
+      chain::transaction_id_type trx_id;
+      account_name               receiver;
+      account_name               account;
+      chain::action_name         action;
+      int64_t                    elapsed_us = 0;
+   };
+
+   /**
+    * Where the time of producing one block went, in microseconds. start_block_us covers all of start_block, so it
+    * includes unapplied_us, scheduled_us and the incoming transactions drained there; incoming_us also counts those
+    * arriving while the block is pending.
+    */
+   struct block_timing {
+      uint32_t                 block_num = 0;
+      chain::block_id_type     block_id;
+      uint32_t                 transactions = 0;
+      int64_t                  start_block_us = 0;
+      int64_t                  unapplied_us = 0;    ///< re-pushing persisted and unapplied transactions
+      int64_t                  scheduled_us = 0;    ///< scheduled transactions, and the incoming interleaved with them
+      int64_t                  incoming_us = 0;
+      int64_t                  finalize_us = 0;     ///< finalize_block, excluding sign_us
+      int64_t                  sign_us = 0;
+      int64_t                  commit_us = 0;
+      std::vector<slow_action> slowest_actions;     ///< slowest first
+   };
+
+   struct get_block_timings_params {
+      uint32_t limit = 10;
+   };
+
+   struct phase_histogram {
+      std::string           phase;
+      std::vector<uint32_t> buckets; ///< bucket i counts blocks spending [2^i, 2^(i+1)) us in the phase, bucket 0 from 0us
+   };
+
+   struct get_block_timings_result {
+      std::vector<block_timing>    blocks;          ///< most recent first
+      std::vector<phase_histogram> histograms;      ///< over every retained block
+      std::vector<slow_action>     slowest_actions; ///< over every retained block
+   };
+
+   struct profile_params {
+      uint32_t seconds   = 10;
+      uint32_t frequency = 99; ///< samples per second of cpu time
+   };
+
+   struct profile_result {
+      uint32_t    samples = 0;
+      uint32_t    dropped = 0; ///< samples lost to a full sample buffer
+      std::string file;        ///< folded stacks, a "root;...;leaf count" line per distinct stack, for flamegraph.pl
+   };
+
+   struct get_spans_params {
+      std::string format = "chrome"; ///< chrome for the Chrome trace event format, otlp for OTLP/JSON
+   };
+
    template<typename T>
    using next_function = std::function<void(const fc::static_variant<fc::exception_ptr, T>&)>;
 
@@ -110,6 +169,19 @@ public:
 
    get_account_ram_corrections_result  get_account_ram_corrections( const get_account_ram_corrections_params& params ) const;
 
+   chain::wasm_interface::execution_stats get_wasm_execution_stats() const;
+
+   get_block_timings_result get_block_timings( const get_block_timings_params& params ) const;
+
+   // per stage latency of the transactions tracked with transaction-latency-tracking that became irreversible
+   std::vector<chain::transaction_latency::stage_stats> get_transaction_latency() const;
+
+   // samples the stacks of the threads of nodeos for params.seconds and replies with the file the stacks were written to
+   void profile( const profile_params& params, next_function<profile_result> next );
+
+   // the spans recorded with span-trace-buffer-size, serialized as JSON in the requested format
+   std::string get_spans( const get_spans_params& params ) const;
+
 private:
    std::shared_ptr<class producer_plugin_impl> my;
 };
@@ -125,3 +197,12 @@ FC_REFLECT(eosio::producer_plugin::scheduled_protocol_feature_activations, (prot
 FC_REFLECT(eosio::producer_plugin::get_supported_protocol_features_params, (exclude_disabled)(exclude_unactivatable))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_params, (lower_bound)(upper_bound)(limit)(reverse))
 FC_REFLECT(eosio::producer_plugin::get_account_ram_corrections_result, (rows)(more))
+FC_REFLECT(eosio::producer_plugin::slow_action, (trx_id)(receiver)(account)(action)(elapsed_us))
+FC_REFLECT(eosio::producer_plugin::block_timing, (block_num)(block_id)(transactions)(start_block_us)(unapplied_us)(scheduled_us)
+                                                 (incoming_us)(finalize_us)(sign_us)(commit_us)(slowest_actions))
+FC_REFLECT(eosio::producer_plugin::get_block_timings_params, (limit))
+FC_REFLECT(eosio::producer_plugin::phase_histogram, (phase)(buckets))
+FC_REFLECT(eosio::producer_plugin::get_block_timings_result, (blocks)(histograms)(slowest_actions))
+FC_REFLECT(eosio::producer_plugin::profile_params, (seconds)(frequency))
+FC_REFLECT(eosio::producer_plugin::profile_result, (samples)(dropped)(file))
+FC_REFLECT(eosio::producer_plugin::get_spans_params, (format))
@@ -1,11 +1,17 @@
 #include <eosio/producer_plugin/producer_plugin.hpp>
+#include <eosio/producer_plugin/block_timings.hpp>
 #include <eosio/chain/plugin_interface.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/chain/transaction_object.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/app_thread_executor.hpp>
+#include <eosio/chain/sampling_profiler.hpp>
+#include <eosio/chain/span_tracer.hpp>
 #include <eosio/chain/unapplied_transaction_queue.hpp>
+#include <eosio/chain/transaction_metadata_pool.hpp>
+#include <eosio/chain/transaction_latency.hpp>
 
 #include <fc/io/json.hpp>
 #include <fc/log/logger_config.hpp>
@@ -17,6 +23,9 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <thread>
 #include <boost/algorithm/string.hpp>
 #include <boost/range/adaptor/map.hpp>
 #include <boost/function_output_iterator.hpp>
@@ -25,10 +34,12 @@
 #include <boost/multi_index/hashed_index.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/signals2/connection.hpp>
+#include <boost/lockfree/queue.hpp>
 
 namespace bmi = boost::multi_index;
 using bmi::indexed_by;
 using bmi::ordered_non_unique;
+using bmi::ordered_unique;
 using bmi::member;
 using bmi::tag;
 using bmi::hashed_unique;
@@ -190,6 +201,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       bool process_unapplied_trxs( const fc::time_point& deadline );
       void process_scheduled_and_incoming_trxs( const fc::time_point& deadline, size_t& pending_incoming_process_limit );
       bool process_incoming_trxs( const fc::time_point& deadline, size_t& pending_incoming_process_limit );
+      bool process_incoming_trxs_by_priority( const fc::time_point& deadline, size_t& pending_incoming_process_limit, size_t& processed );
 
       boost::program_options::variables_map _options;
       bool     _production_enabled                 = false;
@@ -197,6 +209,15 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       using signature_provider_type = std::function<chain::signature_type(chain::digest_type)>;
       std::map<chain::public_key_type, signature_provider_type> _signature_providers;
+      std::set<chain::public_key_type>                          _local_signature_keys; ///< KEY providers, thread safe and signed in process
+
+      /// providers of the keys of the last signing authority produced with, looked up once per authority change
+      struct signing_providers {
+         block_signing_authority                  authority;
+         std::vector<const signature_provider_type*> local;
+         std::vector<const signature_provider_type*> remote;
+      };
+      std::optional<signing_providers>                          _signing_providers;
       std::set<chain::account_name>                             _producers;
       boost::asio::deadline_timer                               _timer;
       using producer_watermark = std::pair<uint32_t, block_timestamp_type>;
@@ -214,6 +235,8 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       int32_t                                                   _max_scheduled_transaction_time_per_block_ms = 0;
       fc::time_point                                            _irreversible_block_time;
       fc::microseconds                                          _keosd_provider_timeout_us;
+      fc::microseconds                                          _pre_production_window_us;
+      fc::time_point                                            _pre_production_start = fc::time_point::maximum(); // speculative work is held from here until our next slot
 
       std::vector<chain::digest_type>                           _protocol_features_to_activate;
       bool                                                      _protocol_features_signaled = false; // to mark whether it has been signaled in start_block
@@ -230,10 +253,19 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
 
       transaction_id_with_expiry_index                         _blacklisted_transactions;
       pending_snapshot_index                                   _pending_snapshot_index;
+      bool                                                     _snapshot_background_write = false;
+      bool                                                     _snapshot_indexed = false;
+      std::map<block_id_type, pending_snapshot::next_t>        _snapshots_being_written; ///< by background writers, handlers of every request
 
       fc::optional<scoped_connection>                          _accepted_block_connection;
       fc::optional<scoped_connection>                          _accepted_block_header_connection;
       fc::optional<scoped_connection>                          _irreversible_block_connection;
+      fc::optional<scoped_connection>                          _applied_transaction_connection;
+
+      uint32_t                                                 _block_timing_history = 0; ///< produced blocks kept for get_block_timings, 0 disables timing
+      bool                                                     _log_block_timing = false;
+      std::optional<producer_plugin::block_timing>             _block_timing;  ///< of the block being produced
+      block_timings                                            _block_timings; ///< of the last produced blocks
 
       /*
        * HACK ALERT
@@ -253,6 +285,9 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       // path to write the snapshots to
       bfs::path _snapshots_dir;
 
+      std::unique_ptr<chain::sampling_profiler>                _profiler; ///< while a profile is being sampled
+      void finish_profile( const producer_plugin::next_function<producer_plugin::profile_result>& next );
+
       void consider_new_watermark( account_name producer, uint32_t block_num, block_timestamp_type timestamp) {
          auto itr = _producer_watermarks.find( producer );
          if( itr != _producer_watermarks.end() ) {
@@ -275,6 +310,107 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          _unapplied_transactions.clear_applied( bsp );
       }
 
+      /// adds the time since start to a phase of the block being produced, when it is timed
+      void add_block_time( int64_t producer_plugin::block_timing::* phase, const fc::time_point& start ) {
+         if( _block_timing )
+            (*_block_timing).*phase += (fc::time_point::now() - start).count();
+      }
+
+      void on_applied_transaction( const transaction_trace_ptr& trace ) {
+         if( !_block_timing )
+            return;
+         for( const auto& at : trace->action_traces ) {
+            block_timings::add_action( *_block_timing, { trace->id, at.receiver, at.act.account, at.act.name, at.elapsed.count() } );
+         }
+      }
+
+      void record_block_timing( const block_state_ptr& bsp ) {
+         if( !_block_timing )
+            return;
+         producer_plugin::block_timing& t = *_block_timing;
+         t.block_id = bsp->id;
+         t.transactions = bsp->block->transactions.size();
+         if( _log_block_timing ) {
+            ilog( "Block #${n} timing [start: ${s}us, unapplied: ${u}us, scheduled: ${sc}us, incoming: ${i}us, "
+                  "finalize: ${f}us, sign: ${sg}us, commit: ${c}us]",
+                  ("n", t.block_num)("s", t.start_block_us)("u", t.unapplied_us)("sc", t.scheduled_us)("i", t.incoming_us)
+                  ("f", t.finalize_us)("sg", t.sign_us)("c", t.commit_us) );
+         }
+         _block_timings.record( std::move( t ) );
+         _block_timing.reset();
+      }
+
+      /// writes the snapshot of the current state in the configured snapshot-format
+      void write_snapshot( chain::controller& chain, std::ostream& out ) {
+         if( _snapshot_indexed ) {
+            auto writer = std::make_shared<indexed_snapshot_writer>( out );
+            chain.write_snapshot( writer );
+            writer->finalize();
+         } else {
+            auto writer = std::make_shared<ostream_snapshot_writer>( out );
+            chain.write_snapshot( writer );
+            writer->finalize();
+         }
+      }
+
+      /**
+       * Serializes the snapshot of the current state on the main thread while a separate thread writes it to p as it
+       * is serialized, so production and block application wait for the serialization but not for the disk. written
+       * is posted to the main thread, with the handler of every request, once the file is complete.
+       */
+      void write_snapshot_in_background( const block_id_type& head_id, const bfs::path& p, const pending_snapshot::next_t& next,
+                                         std::function<void(const pending_snapshot::next_t&)> written ) {
+         chain::controller& chain = chain_plug->chain();
+         const auto start = fc::time_point::now();
+         auto chunks = std::make_shared<snapshot_chunk_queue>();
+
+         _snapshots_being_written.emplace( head_id, next );
+         std::thread( [weak_this = weak_from_this(), head_id, p, chunks, written = std::move( written )]() mutable {
+            fc::set_os_thread_name( "snapshot" );
+            std::string failure;
+            try {
+               std::ofstream snap_out( p.generic_string(), std::ios::out | std::ios::binary );
+               if( !chunks->write_to( snap_out ) || !snap_out.flush().good() )
+                  failure = "unable to serialize or write " + p.generic_string();
+            } catch( const std::exception& e ) {
+               failure = e.what();
+            }
+            chunks.reset();
+            static auto& origin = app_thread_stats::origin( "producer:snapshot_written", priority::medium );
+            app_thread_post( origin, [weak_this, head_id, p, failure, written]() {
+               auto self = weak_this.lock();
+               if( !self ) return;
+               auto itr = self->_snapshots_being_written.find( head_id );
+               if( itr == self->_snapshots_being_written.end() ) return;
+               auto next = std::move( itr->second );
+               self->_snapshots_being_written.erase( itr );
+               if( failure.empty() ) {
+                  written( next );
+               } else {
+                  boost::system::error_code ec;
+                  bfs::remove( p, ec );
+                  next( snapshot_finalization_exception( FC_LOG_MESSAGE( error, "snapshot writer of block ${id} failed: ${e}",
+                                                                         ("id", head_id)("e", failure) ) ).dynamic_copy_exception() );
+               }
+            } );
+         } ).detach();
+
+         // a failure is reported to the requests by the writer
+         bool serialized = false;
+         try {
+            std::ostream out( chunks.get() );
+            write_snapshot( chain, out );
+            serialized = out.flush().good();
+         } FC_LOG_AND_DROP()
+         if( !serialized ) {
+            chunks->abort();
+            return;
+         }
+         chunks->close();
+         ilog( "Serialized snapshot of block ${id}, ${s} bytes in ${t}us, writing it in the background",
+               ("id", head_id)("s", chunks->size())("t", (fc::time_point::now() - start).count()) );
+      }
+
       void on_block_header( const block_state_ptr& bsp ) {
          consider_new_watermark( bsp->header.producer, bsp->block_num, bsp->block->timestamp );
       }
@@ -415,11 +551,12 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          uint64_t size_in_bytes = 0;
          std::deque<std::tuple<transaction_metadata_ptr, bool, next_function<transaction_trace_ptr>>> _incoming_transactions;
 
-      private:
+      public:
          static uint64_t calc_size( const transaction_metadata_ptr& trx ) {
             return trx->packed_trx()->get_unprunable_size() + trx->packed_trx()->get_prunable_size() + sizeof( *trx );
          }
 
+      private:
          void add_size( const transaction_metadata_ptr& trx ) {
             auto size = calc_size( trx );
             EOS_ASSERT( size_in_bytes + size < max_incoming_transaction_queue_size, tx_resource_exhaustion, "Transaction exceeded producer resource limit" );
@@ -453,20 +590,328 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
       };
 
       incoming_transaction_queue _pending_incoming_transactions;
+      static constexpr size_t    scheduled_trx_batch_size = 64; ///< ready scheduled transactions collected per walk of by_delay
+
+      /**
+       * Per account ledger of the CPU recently spent on transactions first authorized by the account, split by
+       * outcome. Amounts decay with a half-life so that past behaviour is forgotten.
+       */
+      class account_cpu_ledger {
+      public:
+         enum class outcome {
+            succeeded,
+            failed,     // objective failure
+            cpu_failed  // objective failure by running out of time or CPU, also counted as failed
+         };
+
+         struct usage {
+            double         succeeded_us = 0;
+            double         failed_us = 0;
+            double         cpu_failed_us = 0;
+            fc::time_point last_update;
+
+            void decay( fc::time_point now, fc::microseconds half_life ) {
+               if( now > last_update && half_life.count() > 0 ) {
+                  const double factor = std::exp2( -double( (now - last_update).count() ) / half_life.count() );
+                  succeeded_us *= factor;
+                  failed_us *= factor;
+                  cpu_failed_us *= factor;
+               }
+               last_update = now;
+            }
+         };
+
+         static constexpr size_t max_tracked_accounts = 100'000;
+         static constexpr size_t prune_per_record = 2; ///< least recently updated accounts checked for decay per record
+
+         void enable( fc::microseconds half_life ) { _enabled = true; _half_life = half_life; }
+         bool enabled() const { return _enabled; }
+
+         std::optional<usage> get( account_name account, fc::time_point now ) const {
+            auto itr = _usage.find( account );
+            if( itr == _usage.end() ) return {};
+            usage u = *itr;
+            u.decay( now, _half_life );
+            return u;
+         }
+
+         void record( account_name account, int64_t cpu_us, outcome o, fc::time_point now ) {
+            if( !_enabled ) return;
+            auto itr = _usage.find( account );
+            if( itr == _usage.end() )
+               itr = _usage.insert( entry{ {}, account } ).first;
+            _usage.modify( itr, [&]( entry& u ) {
+               u.decay( now, _half_life );
+               if( o == outcome::succeeded ) {
+                  u.succeeded_us += cpu_us;
+               } else {
+                  u.failed_us += cpu_us;
+                  if( o == outcome::cpu_failed )
+                     u.cpu_failed_us += cpu_us;
+               }
+            } );
+            prune( now );
+         }
+
+      private:
+         struct entry : usage {
+            account_name account;
+         };
+         struct by_account;
+         struct by_last_update;
+
+         /// forget the least recently updated accounts once decayed away, and any beyond max_tracked_accounts
+         void prune( fc::time_point now ) {
+            auto& idx = _usage.get<by_last_update>();
+            for( size_t i = 0; i < prune_per_record && !idx.empty(); ++i ) {
+               usage u = *idx.begin();
+               u.decay( now, _half_life );
+               if( u.succeeded_us + u.failed_us >= 1 ) break;
+               idx.erase( idx.begin() );
+            }
+            while( _usage.size() > max_tracked_accounts )
+               idx.erase( idx.begin() );
+         }
+
+         multi_index_container<
+            entry,
+            indexed_by<
+               ordered_unique<tag<by_account>, BOOST_MULTI_INDEX_MEMBER(entry, account_name, account)>,
+               ordered_non_unique<tag<by_last_update>, BOOST_MULTI_INDEX_MEMBER(usage, fc::time_point, last_update)>
+            >
+         >                             _usage;
+         fc::microseconds              _half_life = fc::seconds( 60 );
+         bool                          _enabled = false;
+      };
+
+      account_cpu_ledger _account_cpu_ledger;
+      double             _subjective_failed_cpu_budget_us = 0; // 0 disables pre-rejection
+
+      /**
+       * Online estimate of the CPU a transaction will be billed, keyed by the contract and action of its first action.
+       * Like a TCP retransmission timer, each key keeps an exponentially weighted mean and mean deviation of the CPU
+       * billed to successful executions, and predicts the mean plus four deviations.
+       */
+      class transaction_cost_model {
+      public:
+         struct estimate {
+            double mean_us = 0;
+            double deviation_us = 0;
+
+            void update( double cpu_us ) {
+               constexpr double gain = 1.0 / 8;
+               deviation_us += gain * ( std::abs( cpu_us - mean_us ) - deviation_us );
+               mean_us += gain * ( cpu_us - mean_us );
+            }
+            int64_t predict() const { return std::llround( mean_us + 4 * deviation_us ); }
+         };
+
+         static constexpr size_t max_tracked_actions = 10'000;
+
+         void enable() { _enabled = true; }
+         bool enabled() const { return _enabled; }
+
+         void record( const transaction_metadata_ptr& trx, uint32_t cpu_us ) {
+            if( !_enabled || cpu_us == 0 ) return;
+            if( !_overall ) _overall = estimate{ double( cpu_us ), cpu_us / 2.0 };
+            else _overall->update( cpu_us );
+            auto res = _costs.emplace( key( trx ), estimate{ double( cpu_us ), cpu_us / 2.0 } );
+            if( !res.second ) res.first->second.update( cpu_us );
+            if( _costs.size() > max_tracked_actions ) _costs.clear(); // relearn rather than track an unbounded set
+         }
+
+         /// predicted CPU of trx: its own cost when it already executed, else that of its action, else the typical cost
+         int64_t predict( const transaction_metadata_ptr& trx ) const {
+            if( trx->billed_cpu_time_us > 0 ) return trx->billed_cpu_time_us;
+            auto itr = _costs.find( key( trx ) );
+            if( itr != _costs.end() ) return itr->second.predict();
+            return typical();
+         }
+
+         /// predicted CPU of a transaction of any action, 0 until something is recorded
+         int64_t typical() const { return _overall ? std::llround( _overall->mean_us ) : 0; }
+
+      private:
+         static std::pair<account_name, action_name> key( const transaction_metadata_ptr& trx ) {
+            const auto& actions = trx->packed_trx()->get_transaction().actions;
+            if( actions.empty() ) return {};
+            return { actions.front().account, actions.front().name };
+         }
+
+         std::map<std::pair<account_name, action_name>, estimate> _costs;
+         std::optional<estimate>                                   _overall;
+         bool                                                      _enabled = false;
+      };
+
+      transaction_cost_model _transaction_cost_model;
+
+      /// with the cost model enabled while producing, the time and block CPU left before deadline
+      std::optional<int64_t> remaining_block_cpu_us( const fc::time_point& deadline ) const {
+         if( !_transaction_cost_model.enabled() || _pending_block_mode != pending_block_mode::producing ) return {};
+         const auto& rl = chain_plug->chain().get_resource_limits_manager();
+         return std::min<int64_t>( (deadline - fc::time_point::now()).count(), rl.get_block_cpu_limit() );
+      }
+
+      /// whether not even a transaction of typical cost is predicted to fit before deadline
+      bool predicted_full( const fc::time_point& deadline ) const {
+         auto remaining = remaining_block_cpu_us( deadline );
+         return remaining && *remaining < _transaction_cost_model.typical();
+      }
+
+      void record_cpu( const transaction_metadata_ptr& trx, const transaction_trace_ptr& trace ) {
+         if( !trace->except ) _transaction_cost_model.record( trx, trx->billed_cpu_time_us );
+         if( !_account_cpu_ledger.enabled() ) return;
+         using outcome = account_cpu_ledger::outcome;
+         const int64_t cpu_us = trace->receipt ? int64_t( trace->receipt->cpu_usage_us ) : trace->elapsed.count();
+         outcome o = outcome::succeeded;
+         if( trace->except ) {
+            const auto code = trace->except->code();
+            o = ( code == deadline_exception::code_value || code == tx_cpu_usage_exceeded::code_value ||
+                  code == leeway_deadline_exception::code_value ) ? outcome::cpu_failed : outcome::failed;
+         }
+         _account_cpu_ledger.record( trx->packed_trx()->get_transaction().first_authorizer(), cpu_us, o, fc::time_point::now() );
+      }
+
+      /**
+       * Scores transactions by their first authorizer: the configured boost of the account (its priority tier) plus
+       * up to history_scale for the share of the account's recent CPU spent on transactions which succeeded.
+       */
+      class transaction_priority {
+         std::map<account_name, int64_t> _boosts;
+
+      public:
+         static constexpr int64_t history_scale = 1000;
+
+         void set_boost( account_name account, int64_t boost ) { _boosts[account] = boost; }
+
+         int64_t score( const transaction_metadata_ptr& trx, const account_cpu_ledger& ledger, fc::time_point now ) const {
+            const account_name account = trx->packed_trx()->get_transaction().first_authorizer();
+            int64_t result = history_scale; // accounts without history are not penalized
+            if( auto u = ledger.get( account, now ) ) {
+               result = int64_t( history_scale * (u->succeeded_us + 1) / (u->succeeded_us + u->failed_us + 1) );
+            }
+            auto b = _boosts.find( account );
+            if( b != _boosts.end() )
+               result += b->second;
+            return result;
+         }
+      };
+
+      transaction_priority _transaction_priority;
+      uint32_t             _priority_drain_window = 0; // incoming transactions scored per drain, 0 for FIFO
+
+      /**
+       * Bounded multi-producer queue of transactions whose keys have been recovered, pushed by the thread pool and
+       * drained in batches on the main thread. Byte size is bounded by the same limit as incoming_transaction_queue.
+       */
+      class recovered_transaction_queue {
+         struct entry {
+            transaction_metadata_ptr               trx;
+            bool                                   persist_until_expired = false;
+            next_function<transaction_trace_ptr>   next;
+         };
+
+         boost::lockfree::queue<entry*, boost::lockfree::fixed_sized<true>> _queue{max_entries};
+         std::atomic<uint64_t> _size_in_bytes{0};
+         uint64_t              _max_size_in_bytes = 0;
+
+      public:
+         static constexpr size_t max_entries = 16*1024;
+
+         ~recovered_transaction_queue() {
+            _queue.consume_all( []( entry* e ) { delete e; } );
+         }
+
+         void set_max_size( uint64_t v ) { _max_size_in_bytes = v; }
+
+         /// thread safe, returns false without consuming next if the queue is full
+         bool push( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr>& next ) {
+            const auto size = incoming_transaction_queue::calc_size( trx );
+            if( _size_in_bytes.fetch_add( size ) + size >= _max_size_in_bytes ) {
+               _size_in_bytes -= size;
+               return false;
+            }
+            auto e = std::make_unique<entry>( entry{trx, persist_until_expired, std::move( next )} );
+            if( !_queue.bounded_push( e.get() ) ) {
+               next = std::move( e->next );
+               _size_in_bytes -= size;
+               return false;
+            }
+            e.release();
+            return true;
+         }
+
+         /// single consumer, calls f(trx, persist_until_expired, next) for each queued transaction
+         template<typename F>
+         size_t consume_all( F&& f ) {
+            return _queue.consume_all( [&]( entry* e ) {
+               std::unique_ptr<entry> p( e );
+               _size_in_bytes -= incoming_transaction_queue::calc_size( p->trx );
+               f( p->trx, p->persist_until_expired, std::move( p->next ) );
+            } );
+         }
+      };
+
+      recovered_transaction_queue _recovered_transactions;
+      std::atomic<bool>           _recovered_transactions_drain_posted{false};
 
       void on_incoming_transaction_async(const packed_transaction_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
+         if( _subjective_failed_cpu_budget_us > 0 ) {
+            // reject repeat offenders before spending any time on key recovery or execution
+            const account_name account = trx->get_transaction().first_authorizer();
+            auto u = _account_cpu_ledger.get( account, fc::time_point::now() );
+            if( u && u->cpu_failed_us > _subjective_failed_cpu_budget_us ) {
+               next( std::static_pointer_cast<fc::exception>( std::make_shared<tx_resource_exhaustion>(
+                     FC_LOG_MESSAGE( error, "account ${a} recently spent ${us}us on transactions that ran out of CPU, over the subjective budget of ${b}us",
+                                     ("a", account)("us", int64_t( u->cpu_failed_us ))("b", int64_t( _subjective_failed_cpu_budget_us )) ) ) ) );
+               return;
+            }
+         }
+         transaction_latency::received( trx->id() ); // over the API, peer transactions are tracked from receipt
          chain::controller& chain = chain_plug->chain();
          const auto max_trx_time_ms = _max_transaction_time_ms.load();
          fc::microseconds max_trx_cpu_usage = max_trx_time_ms < 0 ? fc::microseconds::maximum() : fc::milliseconds( max_trx_time_ms );
 
          auto future = transaction_metadata::start_recover_keys( trx, _thread_pool->get_executor(),
-                chain.get_chain_id(), fc::microseconds( max_trx_cpu_usage ), chain.configured_subjective_signature_length_limit() );
+                chain.get_chain_id(), fc::microseconds( max_trx_cpu_usage ), chain.configured_subjective_signature_length_limit(),
+                &chain.get_recovered_keys_cache() );
          boost::asio::post( _thread_pool->get_executor(), [self = this, future{std::move(future)}, persist_until_expired, next{std::move(next)}]() mutable {
             if( future.valid() ) {
                future.wait();
-               app().post( priority::low, [self, future{std::move(future)}, persist_until_expired, next{std::move( next )}]() mutable {
+               transaction_metadata_ptr trx_meta;
+               try {
+                  trx_meta = future.get();
+               } catch( ... ) {
+                  // report key recovery failures on the main thread, as callers expect next to be called there
+                  static auto& origin = app_thread_stats::origin( "producer:key_recovery_failed", priority::low );
+                  app_thread_post( origin, [e = std::current_exception(), next{std::move( next )}]() {
+                     try {
+                        std::rethrow_exception( e );
+                     } CATCH_AND_CALL(next);
+                  } );
+                  return;
+               }
+
+               transaction_latency::keys_recovered( trx_meta->id() );
+               // kept whether or not it applies, a peer may still put it in a block
+               self->chain_plug->chain().get_transaction_metadata_pool().add( trx_meta );
+
+               if( self->_recovered_transactions.push( trx_meta, persist_until_expired, next ) ) {
+                  // coalesce: one main thread post drains everything queued until it runs
+                  if( !self->_recovered_transactions_drain_posted.exchange( true ) ) {
+                     static auto& origin = app_thread_stats::origin( "producer:recovered_transactions", priority::low );
+                     app_thread_post( origin, [self]() {
+                        self->process_recovered_transactions();
+                     } );
+                  }
+                  return;
+               }
+
+               // queue is full, fall back to a post per transaction which applies the incoming queue limit
+               static auto& origin = app_thread_stats::origin( "producer:transaction", priority::low );
+               app_thread_post( origin, [self, trx_meta{std::move(trx_meta)}, persist_until_expired, next{std::move( next )}]() mutable {
                   try {
-                     if( !self->process_incoming_transaction_async( future.get(), persist_until_expired, std::move( next ) ) ) {
+                     if( !self->process_incoming_transaction_async( trx_meta, persist_until_expired, next ) ) {
                         if( self->_pending_block_mode == pending_block_mode::producing ) {
                            self->schedule_maybe_produce_block( true );
                         }
@@ -477,6 +922,32 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
          });
       }
 
+      /// speculating just before one of our slots: anything executed now would be aborted by our first start_block
+      bool in_pre_production_window() const {
+         if( _pending_block_mode != pending_block_mode::speculating )
+            return false;
+         const auto now = fc::time_point::now();
+         return now >= _pre_production_start && now < _pre_production_start + _pre_production_window_us;
+      }
+
+      void process_recovered_transactions() {
+         _recovered_transactions_drain_posted = false;
+         bool exhausted = false;
+         _recovered_transactions.consume_all( [&]( const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next ) {
+            try {
+               if( exhausted ) {
+                  // block is full, hold the rest for the next block as process_incoming_transaction_async would
+                  _pending_incoming_transactions.add( trx, persist_until_expired, next );
+               } else if( !process_incoming_transaction_async( trx, persist_until_expired, next ) ) {
+                  exhausted = true;
+               }
+            } CATCH_AND_CALL(next);
+         } );
+         if( exhausted && _pending_block_mode == pending_block_mode::producing ) {
+            schedule_maybe_produce_block( true );
+         }
+      }
+
       bool process_incoming_transaction_async(const transaction_metadata_ptr& trx, bool persist_until_expired, next_function<transaction_trace_ptr> next) {
          bool exhausted = false;
          chain::controller& chain = chain_plug->chain();
@@ -528,7 +999,7 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                return true;
             }
 
-            if( !chain.is_building_block()) {
+            if( !chain.is_building_block() || in_pre_production_window() ) {
                _pending_incoming_transactions.add( trx, persist_until_expired, next );
                return true;
             }
@@ -542,9 +1013,24 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                deadline = block_deadline;
             }
 
+            auto remaining = remaining_block_cpu_us( block_deadline );
+            if( remaining && _transaction_cost_model.predict( trx ) > *remaining ) {
+               // predicted not to fit, don't spend the rest of the block finding out
+               _pending_incoming_transactions.add( trx, persist_until_expired, next );
+               fc_dlog( _trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} PREDICTS tx: ${txid} WILL NOT FIT, RETRYING ",
+                        ("block_num", chain.head_block_num() + 1)
+                        ("prod", chain.pending_block_producer())
+                        ("txid", trx->id()));
+               return !predicted_full( block_deadline );
+            }
+
+            const auto push_start = fc::time_point::now();
+            transaction_latency::execution_started( trx->id() );
             auto trace = chain.push_transaction( trx, deadline, trx->billed_cpu_time_us, false );
+            add_block_time( &producer_plugin::block_timing::incoming_us, push_start );
             if( trace->except ) {
                if( exception_is_exhausted( *trace->except, deadline_is_subjective )) {
+                  // subjective failure, not held against the account
                   _pending_incoming_transactions.add( trx, persist_until_expired, next );
                   if( _pending_block_mode == pending_block_mode::producing ) {
                      fc_dlog( _trx_trace_log, "[TRX_TRACE] Block ${block_num} for producer ${prod} COULD NOT FIT, tx: ${txid} RETRYING ",
@@ -558,10 +1044,12 @@ class producer_plugin_impl : public std::enable_shared_from_this<producer_plugin
                   if( !exhausted )
                      exhausted = block_is_exhausted();
                } else {
+                  record_cpu( trx, trace );
                   auto e_ptr = trace->except->dynamic_copy_exception();
                   send_response( e_ptr );
                }
             } else {
+               record_cpu( trx, trace );
                if( persist_until_expired ) {
                   // if this trx didnt fail/soft-fail and the persist flag is set, store its ID so that we can
                   // ensure its applied to all future speculative blocks as well.
@@ -694,12 +1182,53 @@ void producer_plugin::set_program_options(
           "Time in microseconds allowed for a transaction that starts with insufficient CPU quota to complete and cover its CPU usage.")
          ("incoming-defer-ratio", bpo::value<double>()->default_value(1.0),
           "ratio between incoming transactions and deferred transactions when both are queued for execution")
+         ("priority-account-boost", boost::program_options::value<vector<string>>()->composing()->multitoken(),
+          "Account=Boost pairs; the boost is added to the priority of transactions first authorized by the account (may specify multiple times). "
+          "Enables priority ordering of unapplied and incoming transactions.")
+         ("priority-drain-window", bpo::value<uint32_t>()->default_value(0),
+          "Number of queued incoming transactions considered at a time when draining them highest priority first; 0 drains in arrival order. "
+          "Enables priority ordering of unapplied and incoming transactions.")
+         ("priority-cpu-history-half-life-ms", bpo::value<uint32_t>()->default_value(60'000),
+          "Half-life, in milliseconds, of the per account record of succeeded and failed CPU used to prioritize transactions "
+          "and to enforce subjective-account-failed-cpu-budget-us")
+         ("subjective-account-failed-cpu-budget-us", bpo::value<uint32_t>()->default_value(0),
+          "Incoming transactions are rejected before execution while the decayed CPU their first authorizer recently spent on "
+          "transactions failing with deadline or CPU usage exceeded is above this budget, in microseconds; 0 disables")
+         ("pre-production-window-ms", bpo::value<uint32_t>()->default_value(0),
+          "Milliseconds before the production window of a local producer during which incoming and unapplied transactions "
+          "are held, keys recovered, instead of being executed speculatively, so that they fill the first block of the round; 0 disables")
+         ("transaction-cost-model", bpo::bool_switch()->default_value(false),
+          "Predict the CPU of queued transactions from the recently billed CPU of their contract action. When producing, "
+          "transactions predicted not to fit in the rest of the block are left queued, and draining stops once a transaction "
+          "of typical cost no longer fits")
          ("incoming-transaction-queue-size-mb", bpo::value<uint16_t>()->default_value( 1024 ),
           "Maximum size (in MiB) of the incoming transaction queue. Exceeding this value will subjectively drop transaction with resource exhaustion.")
+         ("unapplied-aborted-queue-size-mb", bpo::value<uint16_t>()->default_value( 1024 ),
+          "Maximum size (in MiB) of the transactions of aborted blocks queued to be applied again. Exceeding this value drops "
+          "the lowest priority, most recently queued of them; 0 for unbounded.")
+         ("unapplied-forked-queue-size-mb", bpo::value<uint16_t>()->default_value( 1024 ),
+          "Maximum size (in MiB) of the transactions of forked out blocks queued to be applied again. Exceeding this value "
+          "drops the lowest priority, most recently queued of them; 0 for unbounded.")
          ("producer-threads", bpo::value<uint16_t>()->default_value(config::default_controller_thread_pool_size),
           "Number of worker threads in producer thread pool")
          ("snapshots-dir", bpo::value<bfs::path>()->default_value("snapshots"),
           "the location of the snapshots directory (absolute path or relative to application data dir)")
+         ("snapshot-background-write", bpo::bool_switch()->default_value(false),
+          "Write snapshots to disk from a separate thread while the main thread serializes them, so that block production "
+          "and application wait for the serialization of the state but not for the disk. Holds as much of a snapshot in "
+          "memory as the disk lags behind its serialization, at most all of it.")
+         ("snapshot-format", bpo::value<string>()->default_value("binary"),
+          "Format of the snapshots written: \"binary\", or \"indexed\" for compressed sections with a table of contents "
+          "and chunk checksums, which is smaller and faster to load")
+         ("block-timing-history", bpo::value<uint32_t>()->default_value(0),
+          "Number of produced blocks whose per phase timing (start_block, unapplied, scheduled, incoming, finalize, sign, "
+          "commit) and slowest actions are kept for the producer get_block_timings API; 0 disables the timing")
+         ("log-block-timing", bpo::bool_switch()->default_value(false),
+          "Log the per phase timing of every produced block; requires block-timing-history")
+         ("transaction-latency-tracking", bpo::value<uint32_t>()->default_value(0),
+          "Number of transactions received from peers or over the API whose time in each stage from receipt to "
+          "irreversibility is tracked at once, reported as per stage histograms by the producer get_transaction_latency "
+          "API; 0 disables the tracking")
          ;
    config_file_options.add(producer_options);
 }
@@ -755,14 +1284,16 @@ make_keosd_signature_provider(const std::shared_ptr<producer_plugin_impl>& impl,
    else
       keosd_url = fc::url(url_str);
    std::weak_ptr<producer_plugin_impl> weak_impl = impl;
+   // a client, and so a kept alive connection, of its own, as providers sign on the thread pool at the same time
+   std::shared_ptr<http_client> client = app().get_plugin<http_client_plugin>().make_client();
 
-   return [weak_impl, keosd_url, pubkey]( const chain::digest_type& digest ) {
+   return [weak_impl, keosd_url, pubkey, client]( const chain::digest_type& digest ) {
       auto impl = weak_impl.lock();
       if (impl) {
          fc::variant params;
          fc::to_variant(std::make_pair(digest, pubkey), params);
          auto deadline = impl->_keosd_provider_timeout_us.count() >= 0 ? fc::time_point::now() + impl->_keosd_provider_timeout_us : fc::time_point::maximum();
-         return app().get_plugin<http_client_plugin>().get_client().post_sync(keosd_url, params, deadline).as<chain::signature_type>();
+         return client->post_sync(keosd_url, params, deadline).as<chain::signature_type>();
       } else {
          return signature_type();
       }
@@ -791,6 +1322,7 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
          try {
             auto key_id_to_wif_pair = dejsonify<std::pair<public_key_type, private_key_type>>(key_id_to_wif_pair_string);
             my->_signature_providers[key_id_to_wif_pair.first] = make_key_signature_provider(key_id_to_wif_pair.second);
+            my->_local_signature_keys.insert(key_id_to_wif_pair.first);
             auto blanked_privkey = std::string(key_id_to_wif_pair.second.to_string().size(), '*' );
             wlog("\"private-key\" is DEPRECATED, use \"signature-provider=${pub}=KEY:${priv}\"", ("pub",key_id_to_wif_pair.first)("priv", blanked_privkey));
          } catch ( fc::exception& e ) {
@@ -817,8 +1349,10 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
 
             if (spec_type_str == "KEY") {
                my->_signature_providers[pubkey] = make_key_signature_provider(private_key_type(spec_data));
+               my->_local_signature_keys.insert(pubkey);
             } else if (spec_type_str == "KEOSD") {
                my->_signature_providers[pubkey] = make_keosd_signature_provider(my, spec_data, pubkey);
+               my->_local_signature_keys.erase(pubkey);
             }
 
          } catch (...) {
@@ -876,14 +1410,61 @@ void producer_plugin::plugin_initialize(const boost::program_options::variables_
                "incoming-transaction-queue-size-mb ${mb} must be greater than 0", ("mb", max_incoming_transaction_queue_size) );
 
    my->_pending_incoming_transactions.set_max_incoming_transaction_queue_size( max_incoming_transaction_queue_size );
+   my->_recovered_transactions.set_max_size( max_incoming_transaction_queue_size );
+
+   my->_unapplied_transactions.set_max_bytes( trx_enum_type::aborted,
+                                              uint64_t( options.at("unapplied-aborted-queue-size-mb").as<uint16_t>() ) * 1024*1024 );
+   my->_unapplied_transactions.set_max_bytes( trx_enum_type::forked,
+                                              uint64_t( options.at("unapplied-forked-queue-size-mb").as<uint16_t>() ) * 1024*1024 );
 
    my->_incoming_defer_ratio = options.at("incoming-defer-ratio").as<double>();
 
+   if( options.at("transaction-cost-model").as<bool>() )
+      my->_transaction_cost_model.enable();
+
+   my->_pre_production_window_us = fc::milliseconds( options.at("pre-production-window-ms").as<uint32_t>() );
+   EOS_ASSERT( my->_pre_production_window_us.count() < config::block_interval_us * config::producer_repetitions, plugin_config_exception,
+               "pre-production-window-ms ${w} must be less than a production round of ${r}ms",
+               ("w", my->_pre_production_window_us.count() / 1000)("r", config::block_interval_ms * config::producer_repetitions) );
+
+   my->_priority_drain_window = options.at("priority-drain-window").as<uint32_t>();
+   my->_subjective_failed_cpu_budget_us = options.at("subjective-account-failed-cpu-budget-us").as<uint32_t>();
+   const bool priority_ordering = options.count("priority-account-boost") || my->_priority_drain_window > 0;
+   if( priority_ordering || my->_subjective_failed_cpu_budget_us > 0 ) {
+      my->_account_cpu_ledger.enable( fc::milliseconds( options.at("priority-cpu-history-half-life-ms").as<uint32_t>() ) );
+   }
+   if( priority_ordering ) {
+      if( options.count("priority-account-boost") ) {
+         for( const auto& entry : options.at("priority-account-boost").as<std::vector<std::string>>() ) {
+            auto delim = entry.find( '=' );
+            EOS_ASSERT( delim != std::string::npos, plugin_config_exception, "Missing \"=\" in priority-account-boost ${e}", ("e", entry) );
+            my->_transaction_priority.set_boost( account_name( entry.substr( 0, delim ) ), std::stoll( entry.substr( delim + 1 ) ) );
+         }
+      }
+      my->_unapplied_transactions.set_priority_function( [this]( const transaction_metadata_ptr& trx ) {
+         return my->_transaction_priority.score( trx, my->_account_cpu_ledger, fc::time_point::now() );
+      } );
+   }
+
    auto thread_pool_size = options.at( "producer-threads" ).as<uint16_t>();
    EOS_ASSERT( thread_pool_size > 0, plugin_config_exception,
                "producer-threads ${num} must be greater than 0", ("num", thread_pool_size));
    my->_thread_pool.emplace( "prod", thread_pool_size );
 
+   my->_block_timing_history = options.at( "block-timing-history" ).as<uint32_t>();
+   my->_block_timings = block_timings( my->_block_timing_history );
+   my->_log_block_timing = options.at( "log-block-timing" ).as<bool>();
+   transaction_latency::enable( options.at( "transaction-latency-tracking" ).as<uint32_t>() );
+   EOS_ASSERT( !my->_log_block_timing || my->_block_timing_history > 0, plugin_config_exception,
+               "log-block-timing requires block-timing-history greater than 0" );
+
+   my->_snapshot_background_write = options.at( "snapshot-background-write" ).as<bool>();
+
+   const auto snapshot_format = options.at( "snapshot-format" ).as<string>();
+   EOS_ASSERT( snapshot_format == "binary" || snapshot_format == "indexed", plugin_config_exception,
+               "snapshot-format must be \"binary\" or \"indexed\", not \"${f}\"", ("f", snapshot_format) );
+   my->_snapshot_indexed = snapshot_format == "indexed";
+
    if( options.count( "snapshots-dir" )) {
       auto sd = options.at( "snapshots-dir" ).as<bfs::path>();
       if( sd.is_relative()) {
@@ -959,6 +1540,12 @@ void producer_plugin::plugin_startup()
    my->_accepted_block_connection.emplace(chain.accepted_block.connect( [this]( const auto& bsp ){ my->on_block( bsp ); } ));
    my->_accepted_block_header_connection.emplace(chain.accepted_block_header.connect( [this]( const auto& bsp ){ my->on_block_header( bsp ); } ));
    my->_irreversible_block_connection.emplace(chain.irreversible_block.connect( [this]( const auto& bsp ){ my->on_irreversible_block( bsp->block ); } ));
+   if( my->_block_timing_history > 0 ) {
+      my->_applied_transaction_connection.emplace(chain.applied_transaction.connect(
+            [this]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
+               my->on_applied_transaction( std::get<0>(t) );
+            } ));
+   }
 
    const auto lib_num = chain.last_irreversible_block_num();
    const auto lib = chain.fetch_block_by_number(lib_num);
@@ -1167,7 +1754,20 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
       return;
    }
 
-   auto write_snapshot = [&]( const bfs::path& p ) -> void {
+   // a background writer of this block is still running, report its result to this request too
+   auto writing = my->_snapshots_being_written.find(head_id);
+   if( writing != my->_snapshots_being_written.end() ) {
+      writing->second = [prev = writing->second, next](const fc::static_variant<fc::exception_ptr, producer_plugin::snapshot_information>& res){
+         prev(res);
+         next(res);
+      };
+      return;
+   }
+
+   using next_t = producer_plugin::next_function<producer_plugin::snapshot_information>;
+   // calls written, on the main thread, with the handler of every request for this block once the snapshot of the
+   // head block is complete at p
+   auto write_snapshot = [&]( const bfs::path& p, std::function<void(const next_t&)> written ) -> void {
       auto reschedule = fc::make_scoped_exit([this](){
          my->schedule_production_loop();
       });
@@ -1181,29 +1781,39 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
 
       bfs::create_directory( p.parent_path() );
 
+      if( my->_snapshot_background_write ) {
+         my->write_snapshot_in_background( head_id, p, next, std::move(written) );
+         return;
+      }
+
       // create the snapshot
       auto snap_out = std::ofstream(p.generic_string(), (std::ios::out | std::ios::binary));
-      auto writer = std::make_shared<ostream_snapshot_writer>(snap_out);
-      chain.write_snapshot(writer);
-      writer->finalize();
+      my->write_snapshot(chain, snap_out);
       snap_out.flush();
       snap_out.close();
+      written( next );
    };
 
    // If in irreversible mode, create snapshot and return path to snapshot immediately.
    if( chain.get_read_mode() == db_read_mode::IRREVERSIBLE ) {
-      try {
-         write_snapshot( temp_path );
-
+      auto finalize = [head_id, temp_path, snapshot_path]( const next_t& next ) {
+         const auto bn = block_header::num_from_id(head_id);
          boost::system::error_code ec;
          bfs::rename(temp_path, snapshot_path, ec);
          EOS_ASSERT(!ec, snapshot_finalization_exception,
                "Unable to finalize valid snapshot of block number ${bn}: [code: ${ec}] ${message}",
-               ("bn", chain.head_block_num())
+               ("bn", bn)
                ("ec", ec.value())
                ("message", ec.message()));
 
          next( producer_plugin::snapshot_information{head_id, snapshot_path.generic_string()} );
+      };
+      try {
+         write_snapshot( temp_path, [finalize]( const next_t& next ) {
+            try {
+               finalize( next );
+            } CATCH_AND_CALL (next);
+         } );
       } CATCH_AND_CALL (next);
       return;
    }
@@ -1224,18 +1834,25 @@ void producer_plugin::create_snapshot(producer_plugin::next_function<producer_pl
    } else {
       const auto& pending_path = pending_snapshot::get_pending_path(head_id, my->_snapshots_dir);
 
-      try {
-         write_snapshot( temp_path ); // create a new pending snapshot
-
+      auto promote = [this, head_id, temp_path, pending_path, snapshot_path]( const next_t& next ) {
+         const auto bn = block_header::num_from_id(head_id);
          boost::system::error_code ec;
          bfs::rename(temp_path, pending_path, ec);
          EOS_ASSERT(!ec, snapshot_finalization_exception,
                "Unable to promote temp snapshot to pending for block number ${bn}: [code: ${ec}] ${message}",
-               ("bn", chain.head_block_num())
+               ("bn", bn)
                ("ec", ec.value())
                ("message", ec.message()));
 
-         my->_pending_snapshot_index.emplace(head_id, next, pending_path.generic_string(), snapshot_path.generic_string());
+         next_t n = next;
+         my->_pending_snapshot_index.emplace(head_id, n, pending_path.generic_string(), snapshot_path.generic_string());
+      };
+      try {
+         write_snapshot( temp_path, [promote]( const next_t& next ) { // create a new pending snapshot
+            try {
+               promote( next );
+            } CATCH_AND_CALL (next);
+         } );
       } CATCH_AND_CALL (next);
    }
 }
@@ -1345,10 +1962,76 @@ producer_plugin::get_account_ram_corrections( const get_account_ram_corrections_
    return result;
 }
 
+std::vector<chain::transaction_latency::stage_stats> producer_plugin::get_transaction_latency() const {
+   return transaction_latency::all();
+}
+
+chain::wasm_interface::execution_stats producer_plugin::get_wasm_execution_stats() const {
+   return my->chain_plug->chain().get_wasm_interface().get_execution_stats();
+}
+
+producer_plugin::get_block_timings_result producer_plugin::get_block_timings( const get_block_timings_params& params ) const {
+   return my->_block_timings.summarize( params.limit );
+}
+
+std::string producer_plugin::get_spans( const get_spans_params& params ) const {
+   EOS_ASSERT( chain::span_tracer::initialized(), chain::plugin_config_exception,
+               "span tracing is not enabled, see span-trace-buffer-size" );
+   if( params.format == "chrome" )
+      return chain::span_tracer::chrome_trace_json();
+   EOS_ASSERT( params.format == "otlp", chain::invalid_http_request, "unknown span format ${f}", ("f", params.format) );
+   return chain::span_tracer::otlp_json( "nodeos" );
+}
+
+void producer_plugin::profile( const profile_params& params, next_function<profile_result> next ) {
+   bool started = false;
+   try {
+      EOS_ASSERT( !my->_profiler, producer_exception, "a profile is already being sampled" );
+      EOS_ASSERT( params.seconds > 0 && params.seconds <= 600, producer_exception, "profile seconds must be between 1 and 600" );
+      // room for every core sampling the whole time, bounded to keep the buffer around 17MB
+      const uint64_t max_samples = std::min<uint64_t>( uint64_t(params.seconds) * params.frequency * std::max( 1u, std::thread::hardware_concurrency() ),
+                                                       1u << 16 );
+      auto profiler = std::make_unique<chain::sampling_profiler>( params.frequency, max_samples );
+      profiler->start();
+      my->_profiler = std::move( profiler );
+      started = true;
+   } CATCH_AND_CALL( next );
+   if( !started )
+      return;
+
+   auto timer = std::make_shared<boost::asio::deadline_timer>( app().get_io_service() );
+   timer->expires_from_now( boost::posix_time::seconds( params.seconds ) );
+   timer->async_wait( app().get_priority_queue().wrap( priority::medium, [this, timer, next]( const boost::system::error_code& ) {
+      my->finish_profile( next );
+   } ) );
+}
+
+void producer_plugin_impl::finish_profile( const producer_plugin::next_function<producer_plugin::profile_result>& next ) {
+   auto profiler = std::move( _profiler );
+   profiler->stop();
+   try {
+      // symbolized on the main thread, which is the one that maintains the EOS VM OC code cache
+      const chain::wasm_interface& wasm = chain_plug->chain().get_wasm_interface();
+      const auto stacks = profiler->folded( [&wasm]( size_t cache_offset ) { return wasm.eosvmoc_function_name( cache_offset ); } );
+
+      const bfs::path dir = app().data_dir() / "profiles";
+      fc::create_directories( dir );
+      const bfs::path file = dir / ("sampled-" + std::to_string( fc::time_point_sec( fc::time_point::now() ).sec_since_epoch() ) + ".folded");
+      std::ofstream out( file.generic_string(), std::ios::trunc );
+      for( const auto& s : stacks )
+         out << s.first << ' ' << s.second << '\n';
+      out.close();
+      EOS_ASSERT( out.good(), producer_exception, "unable to write profile to ${f}", ("f", file.generic_string()) );
+
+      ilog( "wrote ${n} sampled stacks to ${f}", ("n", profiler->samples())("f", file.generic_string()) );
+      next( producer_plugin::profile_result{ profiler->samples(), profiler->dropped(), file.generic_string() } );
+   } CATCH_AND_CALL( next );
+}
+
 optional<fc::time_point> producer_plugin_impl::calculate_next_block_time(const account_name& producer_name, const block_timestamp_type& current_block_time) const {
    chain::controller& chain = chain_plug->chain();
    const auto& hbs = chain.head_block_state();
-   const auto& active_schedule = hbs->active_schedule.producers;
+   const auto& active_schedule = hbs->active_schedule->producers;
 
    // determine if this producer is in the active schedule and if so, where
    auto itr = std::find_if(active_schedule.begin(), active_schedule.end(), [&](const auto& asp){ return asp.producer_name == producer_name; });
@@ -1430,6 +2113,7 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
    const fc::time_point now = fc::time_point::now();
    const fc::time_point block_time = calculate_pending_block_time();
 
+   _block_timing.reset(); // a block started before is not going to be produced
    const pending_block_mode previous_pending_mode = _pending_block_mode;
    _pending_block_mode = pending_block_mode::producing;
 
@@ -1509,6 +2193,14 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
    fc_dlog(_log, "Starting block #${n} at ${time} producer ${p}",
            ("n", hbs->block_num + 1)("time", now)("p", scheduled_producer.producer_name));
 
+   if( _pending_block_mode == pending_block_mode::producing && _block_timing_history > 0 ) {
+      _block_timing.emplace();
+      _block_timing->block_num = hbs->block_num + 1;
+   }
+   auto time_start_block = fc::make_scoped_exit( [this, now]() {
+      add_block_time( &producer_plugin::block_timing::start_block_us, now );
+   } );
+
    try {
       uint16_t blocks_to_confirm = 0;
 
@@ -1577,6 +2269,7 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
       if (_pending_block_mode == pending_block_mode::producing && pending_block_signing_authority != scheduled_producer.authority) {
          elog("Unexpected block signing authority, reverting to speculative mode! [expected: \"${expected}\", actual: \"${actual\"", ("expected", scheduled_producer.authority)("actual", pending_block_signing_authority));
          _pending_block_mode = pending_block_mode::speculating;
+         _block_timing.reset();
       }
 
       try {
@@ -1585,10 +2278,20 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
          if( !remove_expired_blacklisted_trxs( preprocess_deadline ) )
             return start_block_result::exhausted;
 
+         if( in_pre_production_window() ) {
+            // leave unapplied and incoming queued for our first block rather than executing them only to abort them
+            fc_dlog(_log, "Holding ${u} unapplied and ${i} incoming transactions for production at ${t}",
+                    ("u", _unapplied_transactions.size())("i", _pending_incoming_transactions.size())("t", _pre_production_start + _pre_production_window_us));
+            return start_block_result::succeeded;
+         }
+
          // limit execution of pending incoming to once per block
          size_t pending_incoming_process_limit = _pending_incoming_transactions.size();
 
-         if( !process_unapplied_trxs( preprocess_deadline ) )
+         const auto unapplied_start = fc::time_point::now();
+         const bool unapplied_done = process_unapplied_trxs( preprocess_deadline );
+         add_block_time( &producer_plugin::block_timing::unapplied_us, unapplied_start );
+         if( !unapplied_done )
             return start_block_result::exhausted;
 
          if (_pending_block_mode == pending_block_mode::producing) {
@@ -1600,7 +2303,9 @@ producer_plugin_impl::start_block_result producer_plugin_impl::start_block() {
                );
             }
             // may exhaust scheduled_trx_deadline but not preprocess_deadline, exhausted preprocess_deadline checked below
+            const auto scheduled_start = fc::time_point::now();
             process_scheduled_and_incoming_trxs( scheduled_trx_deadline, pending_incoming_process_limit );
+            add_block_time( &producer_plugin::block_timing::scheduled_us, scheduled_start );
          }
 
          if( app().is_quiting() ) // db guard exception above in LOG_AND_DROP could have called app().quit()
@@ -1703,7 +2408,8 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
    bool exhausted = false;
    if( !_unapplied_transactions.empty() ) {
       chain::controller& chain = chain_plug->chain();
-      int num_applied = 0, num_failed = 0, num_processed = 0;
+      const auto& rl = chain.get_resource_limits_manager();
+      int num_applied = 0, num_failed = 0, num_processed = 0, num_deferred = 0;
       auto unapplied_trxs_size = _unapplied_transactions.size();
       auto itr     = (_pending_block_mode == pending_block_mode::producing) ?
                      _unapplied_transactions.begin() : _unapplied_transactions.persisted_begin();
@@ -1716,6 +2422,16 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
          }
 
          const transaction_metadata_ptr trx = itr->trx_meta;
+         if( _pending_block_mode == pending_block_mode::producing && trx->billed_cpu_time_us > 0 ) {
+            // billed_cpu_time_us is the cost of its last execution, don't start what would be cut off by the
+            // deadline or the block cpu limit only to be thrown away; leave it for the next block
+            const int64_t remaining_us = std::min<int64_t>( (deadline - fc::time_point::now()).count(), rl.get_block_cpu_limit() );
+            if( trx->billed_cpu_time_us > remaining_us ) {
+               ++num_deferred;
+               ++itr;
+               continue;
+            }
+         }
          ++num_processed;
          try {
             auto trx_deadline = fc::time_point::now() + fc::milliseconds( _max_transaction_time_ms );
@@ -1726,6 +2442,7 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
                trx_deadline = deadline;
             }
 
+            transaction_latency::execution_started( trx->id() );
             auto trace = chain.push_transaction( trx, trx_deadline, trx->billed_cpu_time_us, false );
             if( trace->except ) {
                if( exception_is_exhausted( *trace->except, deadline_is_subjective ) ) {
@@ -1736,11 +2453,13 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
                   }
                } else {
                   // this failed our configured maximum transaction time, we don't want to replay it
+                  record_cpu( trx, trace );
                   ++num_failed;
                   itr = _unapplied_transactions.erase( itr );
                   continue;
                }
             } else {
+               _transaction_cost_model.record( trx, trx->billed_cpu_time_us );
                ++num_applied;
                itr = _unapplied_transactions.erase( itr );
                continue;
@@ -1749,8 +2468,8 @@ bool producer_plugin_impl::process_unapplied_trxs( const fc::time_point& deadlin
          ++itr;
       }
 
-      fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}",
-               ("m", num_processed)( "n", unapplied_trxs_size )("applied", num_applied)("failed", num_failed) );
+      fc_dlog( _log, "Processed ${m} of ${n} previously applied transactions, Applied ${applied}, Failed/Dropped ${failed}, Deferred ${deferred}",
+               ("m", num_processed)( "n", unapplied_trxs_size )("applied", num_applied)("failed", num_failed)("deferred", num_deferred) );
    }
    return !exhausted;
 }
@@ -1769,83 +2488,89 @@ void producer_plugin_impl::process_scheduled_and_incoming_trxs( const fc::time_p
    time_point pending_block_time = chain.pending_block_time();
    const auto& sch_idx = chain.db().get_index<generated_transaction_multi_index,by_delay>();
    const auto scheduled_trxs_size = sch_idx.size();
+
+   // Ready transactions are collected a batch at a time in a single walk of by_delay, without rechecking the
+   // deadline or relocating the iterator per entry; executing them invalidates iterators, so each batch resumes
+   // after the (delay_until, id) of the last entry collected.
+   struct ready_trx {
+      transaction_id_type trx_id;
+      fc::time_point      expiration;
+   };
+   std::vector<ready_trx> batch;
+   batch.reserve( scheduled_trx_batch_size );
    auto sch_itr = sch_idx.begin();
-   while( sch_itr != sch_idx.end() ) {
-      if( sch_itr->delay_until > pending_block_time) break;    // not scheduled yet
-      if( exhausted || deadline <= fc::time_point::now() ) {
-         exhausted = true;
-         break;
-      }
-      if( sch_itr->published >= pending_block_time ) {
-         ++sch_itr;
-         continue; // do not allow schedule and execute in same block
+   while( !exhausted && sch_itr != sch_idx.end() ) {
+      batch.clear();
+      for( ; sch_itr != sch_idx.end() && batch.size() < scheduled_trx_batch_size; ++sch_itr ) {
+         if( sch_itr->delay_until > pending_block_time ) break; // not scheduled yet, nor is anything after it
+         if( sch_itr->published >= pending_block_time ) continue; // do not allow schedule and execute in same block
+         if( !blacklist_by_id.empty() && blacklist_by_id.find( sch_itr->trx_id ) != blacklist_by_id.end() ) continue;
+         batch.push_back( ready_trx{ sch_itr->trx_id, sch_itr->expiration } );
       }
+      const bool last_batch = sch_itr == sch_idx.end() || sch_itr->delay_until > pending_block_time;
+      const auto resume_key = last_batch ? boost::make_tuple( time_point(), generated_transaction_object::id_type() )
+                                         : boost::make_tuple( sch_itr->delay_until, sch_itr->id );
 
-      if (blacklist_by_id.find(sch_itr->trx_id) != blacklist_by_id.end()) {
-         ++sch_itr;
-         continue;
-      }
+      for( const auto& r : batch ) {
+         if( exhausted || deadline <= fc::time_point::now() || predicted_full( deadline ) ) {
+            exhausted = true;
+            break;
+         }
 
-      const transaction_id_type trx_id = sch_itr->trx_id; // make copy since reference could be invalidated
-      const auto sch_expiration = sch_itr->expiration;
-      auto sch_itr_next = sch_itr; // save off next since sch_itr may be invalidated by loop
-      ++sch_itr_next;
-      const auto next_delay_until = sch_itr_next != sch_idx.end() ? sch_itr_next->delay_until : sch_itr->delay_until;
-      const auto next_id = sch_itr_next != sch_idx.end() ? sch_itr_next->id : sch_itr->id;
+         num_processed++;
 
-      num_processed++;
+         // configurable ratio of incoming txns vs deferred txns
+         while (incoming_trx_weight >= 1.0 && pending_incoming_process_limit && _pending_incoming_transactions.size()) {
+            if (deadline <= fc::time_point::now()) {
+               exhausted = true;
+               break;
+            }
 
-      // configurable ratio of incoming txns vs deferred txns
-      while (incoming_trx_weight >= 1.0 && pending_incoming_process_limit && _pending_incoming_transactions.size()) {
-         if (deadline <= fc::time_point::now()) {
-            exhausted = true;
-            break;
+            auto e = _pending_incoming_transactions.pop_front();
+            --pending_incoming_process_limit;
+            incoming_trx_weight -= 1.0;
+            if( !process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e)) ) {
+               exhausted = true;
+               break;
+            }
          }
 
-         auto e = _pending_incoming_transactions.pop_front();
-         --pending_incoming_process_limit;
-         incoming_trx_weight -= 1.0;
-         if( !process_incoming_transaction_async(std::get<0>(e), std::get<1>(e), std::get<2>(e)) ) {
+         if (exhausted || deadline <= fc::time_point::now()) {
             exhausted = true;
             break;
          }
-      }
-
-      if (exhausted || deadline <= fc::time_point::now()) {
-         exhausted = true;
-         break;
-      }
 
-      try {
-         auto trx_deadline = fc::time_point::now() + fc::milliseconds(_max_transaction_time_ms);
-         bool deadline_is_subjective = false;
-         if (_max_transaction_time_ms < 0 || (_pending_block_mode == pending_block_mode::producing && deadline < trx_deadline)) {
-            deadline_is_subjective = true;
-            trx_deadline = deadline;
-         }
+         try {
+            auto trx_deadline = fc::time_point::now() + fc::milliseconds(_max_transaction_time_ms);
+            bool deadline_is_subjective = false;
+            if (_max_transaction_time_ms < 0 || (_pending_block_mode == pending_block_mode::producing && deadline < trx_deadline)) {
+               deadline_is_subjective = true;
+               trx_deadline = deadline;
+            }
 
-         auto trace = chain.push_scheduled_transaction(trx_id, trx_deadline, 0, false);
-         if (trace->except) {
-            if (exception_is_exhausted(*trace->except, deadline_is_subjective)) {
-               if( block_is_exhausted() ) {
-                  exhausted = true;
-                  break;
+            auto trace = chain.push_scheduled_transaction(r.trx_id, trx_deadline, 0, false);
+            if (trace->except) {
+               if (exception_is_exhausted(*trace->except, deadline_is_subjective)) {
+                  if( block_is_exhausted() ) {
+                     exhausted = true;
+                     break;
+                  }
+               } else {
+                  // this failed our configured maximum transaction time, we don't want to replay it add it to a blacklist
+                  _blacklisted_transactions.insert(transaction_id_with_expiry{r.trx_id, r.expiration});
+                  num_failed++;
                }
             } else {
-               // this failed our configured maximum transaction time, we don't want to replay it add it to a blacklist
-               _blacklisted_transactions.insert(transaction_id_with_expiry{trx_id, sch_expiration});
-               num_failed++;
+               num_applied++;
             }
-         } else {
-            num_applied++;
-         }
-      } LOG_AND_DROP();
+         } LOG_AND_DROP();
 
-      incoming_trx_weight += _incoming_defer_ratio;
-      if (!pending_incoming_process_limit) incoming_trx_weight = 0.0;
+         incoming_trx_weight += _incoming_defer_ratio;
+         if (!pending_incoming_process_limit) incoming_trx_weight = 0.0;
+      }
 
-      if( sch_itr_next == sch_idx.end() ) break;
-      sch_itr = sch_idx.lower_bound( boost::make_tuple( next_delay_until, next_id ) );
+      if( last_batch ) break;
+      sch_itr = sch_idx.lower_bound( resume_key );
    }
 
    if( scheduled_trxs_size > 0 ) {
@@ -1861,6 +2586,11 @@ bool producer_plugin_impl::process_incoming_trxs( const fc::time_point& deadline
    if (!_pending_incoming_transactions.empty()) {
       size_t processed = 0;
       fc_dlog(_log, "Processing ${n} pending transactions", ("n", pending_incoming_process_limit));
+      if( _priority_drain_window > 0 ) {
+         exhausted = !process_incoming_trxs_by_priority( deadline, pending_incoming_process_limit, processed );
+         fc_dlog(_log, "Processed ${n} pending transactions, ${p} left", ("n", processed)("p", _pending_incoming_transactions.size()));
+         return !exhausted;
+      }
       while (pending_incoming_process_limit && _pending_incoming_transactions.size()) {
          if (deadline <= fc::time_point::now()) {
             exhausted = true;
@@ -1879,6 +2609,49 @@ bool producer_plugin_impl::process_incoming_trxs( const fc::time_point& deadline
    return !exhausted;
 }
 
+bool producer_plugin_impl::process_incoming_trxs_by_priority( const fc::time_point& deadline, size_t& pending_incoming_process_limit, size_t& processed )
+{
+   // bounded heap over the oldest _priority_drain_window transactions, refilled from the queue as they are applied
+   using entry_type = decltype( _pending_incoming_transactions.pop_front() );
+   std::vector<std::pair<int64_t, entry_type>> heap;
+   auto less_priority = []( const auto& lhs, const auto& rhs ) { return lhs.first < rhs.first; };
+   const auto now = fc::time_point::now();
+   auto fill = [&]() {
+      while( heap.size() < _priority_drain_window && heap.size() < pending_incoming_process_limit && _pending_incoming_transactions.size() ) {
+         auto e = _pending_incoming_transactions.pop_front();
+         const auto score = _transaction_priority.score( std::get<0>( e ), _account_cpu_ledger, now );
+         heap.emplace_back( score, std::move( e ) );
+         std::push_heap( heap.begin(), heap.end(), less_priority );
+      }
+   };
+
+   bool exhausted = false;
+   fill();
+   while( !heap.empty() ) {
+      if( deadline <= fc::time_point::now() ) {
+         exhausted = true;
+         break;
+      }
+      std::pop_heap( heap.begin(), heap.end(), less_priority );
+      auto e = std::move( heap.back().second );
+      heap.pop_back();
+      --pending_incoming_process_limit;
+      ++processed;
+      if( !process_incoming_transaction_async( std::get<0>( e ), std::get<1>( e ), std::get<2>( e ) ) ) {
+         exhausted = true;
+         break;
+      }
+      fill();
+   }
+
+   // return what was not applied to the front of the queue, highest priority first
+   std::sort( heap.begin(), heap.end(), less_priority );
+   for( auto& h : heap ) {
+      _pending_incoming_transactions.add_front( std::get<0>( h.second ), std::get<1>( h.second ), std::get<2>( h.second ) );
+   }
+   return !exhausted;
+}
+
 bool producer_plugin_impl::block_is_exhausted() const {
    const chain::controller& chain = chain_plug->chain();
    const auto& rl = chain.get_resource_limits_manager();
@@ -1901,6 +2674,12 @@ void producer_plugin_impl::schedule_production_loop() {
 
    auto result = start_block();
 
+   // the window ends with our slot, whether we produced in it or missed it
+   if (_pending_block_mode == pending_block_mode::producing ||
+       (_pre_production_start != fc::time_point::maximum() &&
+        fc::time_point::now() >= _pre_production_start + _pre_production_window_us))
+      _pre_production_start = fc::time_point::maximum();
+
    if (result == start_block_result::failed) {
       elog("Failed to start a pending block, will try again later");
       _timer.expires_from_now( boost::posix_time::microseconds( config::block_interval_us  / 10 ));
@@ -1932,7 +2711,10 @@ void producer_plugin_impl::schedule_production_loop() {
       chain::controller& chain = chain_plug->chain();
       fc_dlog(_log, "Speculative Block Created; Scheduling Speculative/Production Change");
       EOS_ASSERT( chain.is_building_block(), missing_pending_block_state, "speculating without pending_block_state" );
-      schedule_delayed_production_loop(weak_from_this(), calculate_producer_wake_up_time(chain.pending_block_time()));
+      auto wake_up_time = calculate_producer_wake_up_time(chain.pending_block_time());
+      _pre_production_start = _pre_production_window_us.count() > 0 && wake_up_time ? *wake_up_time - _pre_production_window_us
+                                                                                    : fc::time_point::maximum();
+      schedule_delayed_production_loop(weak_from_this(), wake_up_time);
    } else {
       fc_dlog(_log, "Speculative Block Created");
    }
@@ -2052,18 +2834,19 @@ void producer_plugin_impl::produce_block() {
 
 
    const auto& auth = chain.pending_block_signing_authority();
-   std::vector<std::reference_wrapper<const signature_provider_type>> relevant_providers;
-
-   relevant_providers.reserve(_signature_providers.size());
-
-   producer_authority::for_each_key(auth, [&](const public_key_type& key){
-      const auto& iter = _signature_providers.find(key);
-      if (iter != _signature_providers.end()) {
-         relevant_providers.emplace_back(iter->second);
-      }
-   });
+   if (!_signing_providers || _signing_providers->authority != auth) {
+      _signing_providers.emplace(signing_providers{auth, {}, {}});
+      producer_authority::for_each_key(auth, [&](const public_key_type& key){
+         const auto& iter = _signature_providers.find(key);
+         if (iter != _signature_providers.end()) {
+            auto& providers = _local_signature_keys.count(key) ? _signing_providers->local : _signing_providers->remote;
+            providers.emplace_back(&iter->second);
+         }
+      });
+   }
+   const auto& providers = *_signing_providers;
 
-   EOS_ASSERT(relevant_providers.size() > 0, producer_priv_key_not_found, "Attempting to produce a block for which we don't have any relevant private keys");
+   EOS_ASSERT(providers.local.size() + providers.remote.size() > 0, producer_priv_key_not_found, "Attempting to produce a block for which we don't have any relevant private keys");
 
    if (_protocol_features_signaled) {
       _protocol_features_to_activate.clear(); // clear _protocol_features_to_activate as it is already set in pending_block
@@ -2071,19 +2854,48 @@ void producer_plugin_impl::produce_block() {
    }
 
    //idump( (fc::time_point::now() - chain.pending_block_time()) );
+   const auto finalize_start = fc::time_point::now();
    chain.finalize_block( [&]( const digest_type& d ) {
       auto debug_logger = maybe_make_debug_time_logger();
+      const auto sign_start = fc::time_point::now();
       vector<signature_type> sigs;
-      sigs.reserve(relevant_providers.size());
-
-      // sign with all relevant public keys
-      for (const auto& p : relevant_providers) {
-         sigs.emplace_back(p.get()(d));
+      sigs.reserve(providers.local.size() + providers.remote.size());
+
+      // sign with all relevant public keys; with more than one, they all sign at once on the thread pool, so the
+      // round trips of remote providers (keosd), each with an http client of its own, overlap
+      // each other and the local keys
+      if (providers.local.size() + providers.remote.size() > 1) {
+         std::vector<std::future<signature_type>> pending_sigs;
+         pending_sigs.reserve(providers.local.size() + providers.remote.size());
+         for (const auto& group : {&providers.remote, &providers.local}) {
+            for (const auto* p : *group) {
+               pending_sigs.emplace_back(async_thread_pool(_thread_pool->get_executor(), [p, &d]() { return (*p)(d); }));
+            }
+         }
+         for (auto& f : pending_sigs) {
+            f.wait();
+         }
+         for (auto& f : pending_sigs) {
+            sigs.emplace_back(f.get());
+         }
+      } else {
+         for (const auto& group : {&providers.remote, &providers.local}) {
+            for (const auto* p : *group) {
+               sigs.emplace_back((*p)(d));
+            }
+         }
       }
+      add_block_time(&producer_plugin::block_timing::sign_us, sign_start);
       return sigs;
    } );
+   add_block_time(&producer_plugin::block_timing::finalize_us, finalize_start);
+   if (_block_timing) {
+      _block_timing->finalize_us -= _block_timing->sign_us;
+   }
 
+   const auto commit_start = fc::time_point::now();
    chain.commit_block();
+   add_block_time(&producer_plugin::block_timing::commit_us, commit_start);
 
    block_state_ptr new_bs = chain.head_block_state();
 
@@ -2092,6 +2904,7 @@ void producer_plugin_impl::produce_block() {
         ("n",new_bs->block_num)("t",new_bs->header.timestamp)
         ("count",new_bs->block->transactions.size())("lib",chain.last_irreversible_block_num())("confs", new_bs->header.confirmed));
 
+   record_block_timing(new_bs);
 }
 
 } // namespace eosio
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace eosio { namespace prometheus {
+
+   /// monotonically increasing count, an update is one relaxed atomic add
+   class counter {
+   public:
+      void     inc( uint64_t n = 1 ) { _value.fetch_add( n, std::memory_order_relaxed ); }
+      uint64_t value()const { return _value.load( std::memory_order_relaxed ); }
+
+   private:
+      std::atomic<uint64_t> _value{0};
+   };
+
+   /**
+    * Observations counted in fixed buckets, an update is a binary search of the bounds and two relaxed atomic adds.
+    * Buckets are read one by one at exposition so a scrape racing updates may see a count one observation off its
+    * sum, which the exposition format tolerates.
+    */
+   class histogram {
+   public:
+      /// upper_bounds are inclusive and ascending, one more bucket counts the larger observations
+      explicit histogram( std::vector<uint64_t> upper_bounds );
+
+      void observe( uint64_t v );
+
+      const std::vector<uint64_t>& bounds()const { return _bounds; }
+      /// observations in bucket i alone, not cumulative; i == bounds().size() is the overflow bucket
+      uint64_t bucket( size_t i )const { return _counts[i].load( std::memory_order_relaxed ); }
+      uint64_t sum()const { return _sum.load( std::memory_order_relaxed ); }
+
+   private:
+      const std::vector<uint64_t>              _bounds;
+      std::unique_ptr<std::atomic<uint64_t>[]> _counts;
+      std::atomic<uint64_t>                    _sum{0};
+   };
+
+   using labels = std::vector<std::pair<std::string, std::string>>;
+
+   /// builds a scrape in the Prometheus text exposition format, version 0.0.4
+   class text_writer {
+   public:
+      static constexpr const char* content_type = "text/plain; version=0.0.4; charset=utf-8";
+
+      /// starts a metric family; type is counter, gauge or histogram
+      void family( const std::string& name, const char* type, const char* help );
+
+      void sample( const std::string& name, double value, const labels& l = {} );
+      void sample( const std::string& name, uint64_t value, const labels& l = {} );
+
+      /// name_bucket, name_sum and name_count of h, with bounds and sum divided by scale
+      void write_histogram( const std::string& name, const histogram& h, double scale = 1, const labels& l = {} );
+      /// the same for buckets accumulated elsewhere; counts has one more entry than bounds for the overflow bucket
+      void write_histogram( const std::string& name, const std::vector<uint64_t>& bounds, const std::vector<uint64_t>& counts,
+                            uint64_t sum, double scale = 1, const labels& l = {} );
+
+      std::string release() { return std::move( _out ); }
+
+   private:
+      void write_labels( const labels& l, const char* le = nullptr );
+
+      std::string _out;
+   };
+
+} } // eosio::prometheus
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <eosio/http_plugin/http_plugin.hpp>
+#include <eosio/chain_plugin/chain_plugin.hpp>
+
+#include <appbase/application.hpp>
+
+namespace eosio {
+
+using namespace appbase;
+
+/**
+ * Serves metrics of chain, producer, net and http plugins in the Prometheus text format at /v1/prometheus/metrics.
+ * Controller signals update atomic counters and histograms as blocks and transactions are applied; the state the
+ * other plugins already keep is read when scraped. producer_plugin and net_plugin metrics are left out when those
+ * plugins are not enabled.
+ */
+class prometheus_plugin : public plugin<prometheus_plugin> {
+public:
+   APPBASE_PLUGIN_REQUIRES((http_plugin) (chain_plugin))
+
+   prometheus_plugin();
+   prometheus_plugin(const prometheus_plugin&) = delete;
+   prometheus_plugin(prometheus_plugin&&) = delete;
+   prometheus_plugin& operator=(const prometheus_plugin&) = delete;
+   prometheus_plugin& operator=(prometheus_plugin&&) = delete;
+   virtual ~prometheus_plugin() override;
+
+   virtual void set_program_options(options_description& cli, options_description& cfg) override {}
+   void plugin_initialize(const variables_map& vm);
+   void plugin_startup();
+   void plugin_shutdown();
+
+   /// the current metrics in the text exposition format
+   std::string metrics()const;
+
+private:
+   std::unique_ptr<class prometheus_plugin_impl> my;
+};
+
+}
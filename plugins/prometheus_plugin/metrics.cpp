@@ -0,0 +1,124 @@
+#include <eosio/prometheus_plugin/metrics.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace eosio { namespace prometheus {
+
+namespace {
+
+   std::string format( double v ) {
+      if( std::isinf( v ) )
+         return v > 0 ? "+Inf" : "-Inf";
+      if( std::isnan( v ) )
+         return "NaN";
+      char buf[32];
+      snprintf( buf, sizeof(buf), "%.10g", v );
+      return buf;
+   }
+
+   void append_escaped( std::string& out, const std::string& value ) {
+      for( char c : value ) {
+         switch( c ) {
+            case '\\': out += "\\\\"; break;
+            case '"':  out += "\\\""; break;
+            case '\n': out += "\\n";  break;
+            default:   out += c;
+         }
+      }
+   }
+
+}
+
+histogram::histogram( std::vector<uint64_t> upper_bounds )
+: _bounds( std::move(upper_bounds) )
+, _counts( new std::atomic<uint64_t>[_bounds.size() + 1] )
+{
+   for( size_t i = 0; i <= _bounds.size(); ++i )
+      _counts[i].store( 0, std::memory_order_relaxed );
+}
+
+void histogram::observe( uint64_t v ) {
+   const size_t i = std::lower_bound( _bounds.begin(), _bounds.end(), v ) - _bounds.begin();
+   _counts[i].fetch_add( 1, std::memory_order_relaxed );
+   _sum.fetch_add( v, std::memory_order_relaxed );
+}
+
+void text_writer::family( const std::string& name, const char* type, const char* help ) {
+   _out += "# HELP ";
+   _out += name;
+   _out += ' ';
+   _out += help;
+   _out += "\n# TYPE ";
+   _out += name;
+   _out += ' ';
+   _out += type;
+   _out += '\n';
+}
+
+void text_writer::write_labels( const labels& l, const char* le ) {
+   if( l.empty() && !le )
+      return;
+   _out += '{';
+   bool first = true;
+   for( const auto& label : l ) {
+      if( !first )
+         _out += ',';
+      first = false;
+      _out += label.first;
+      _out += "=\"";
+      append_escaped( _out, label.second );
+      _out += '"';
+   }
+   if( le ) {
+      if( !first )
+         _out += ',';
+      _out += "le=\"";
+      _out += le;
+      _out += '"';
+   }
+   _out += '}';
+}
+
+void text_writer::sample( const std::string& name, double value, const labels& l ) {
+   _out += name;
+   write_labels( l );
+   _out += ' ';
+   _out += format( value );
+   _out += '\n';
+}
+
+void text_writer::sample( const std::string& name, uint64_t value, const labels& l ) {
+   _out += name;
+   write_labels( l );
+   _out += ' ';
+   _out += std::to_string( value );
+   _out += '\n';
+}
+
+void text_writer::write_histogram( const std::string& name, const histogram& h, double scale, const labels& l ) {
+   std::vector<uint64_t> counts( h.bounds().size() + 1 );
+   for( size_t i = 0; i < counts.size(); ++i )
+      counts[i] = h.bucket( i );
+   write_histogram( name, h.bounds(), counts, h.sum(), scale, l );
+}
+
+void text_writer::write_histogram( const std::string& name, const std::vector<uint64_t>& bounds, const std::vector<uint64_t>& counts,
+                                   uint64_t sum, double scale, const labels& l ) {
+   const std::string bucket = name + "_bucket";
+   uint64_t cumulative = 0;
+   for( size_t i = 0; i < counts.size(); ++i ) {
+      cumulative += counts[i];
+      const std::string le = i < bounds.size() ? format( bounds[i] / scale ) : "+Inf";
+      _out += bucket;
+      write_labels( l, le.c_str() );
+      _out += ' ';
+      _out += std::to_string( cumulative );
+      _out += '\n';
+   }
+   sample( name + "_sum", sum / scale, l );
+   sample( name + "_count", cumulative, l );
+}
+
+} } // eosio::prometheus
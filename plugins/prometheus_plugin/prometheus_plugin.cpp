@@ -0,0 +1,337 @@
+#include <eosio/prometheus_plugin/prometheus_plugin.hpp>
+#include <eosio/prometheus_plugin/metrics.hpp>
+#include <eosio/producer_plugin/producer_plugin.hpp>
+#include <eosio/net_plugin/net_plugin.hpp>
+#include <eosio/chain/app_thread_stats.hpp>
+#include <eosio/chain/transaction_latency.hpp>
+
+#include <array>
+
+namespace eosio {
+
+static appbase::abstract_plugin& _prometheus_plugin = app().register_plugin<prometheus_plugin>();
+
+using namespace eosio::chain;
+using boost::signals2::scoped_connection;
+using prometheus::counter;
+using prometheus::histogram;
+using prometheus::text_writer;
+
+namespace {
+
+   constexpr double us_per_second = 1000000;
+
+   /// cpu and wall time of a transaction, in microseconds
+   std::vector<uint64_t> transaction_time_bounds() {
+      return { 50, 100, 250, 500, 1000, 2500, 5000, 10000, 30000, 150000 };
+   }
+
+   const char* status_name( uint32_t status ) {
+      switch( status ) {
+         case transaction_receipt_header::executed:  return "executed";
+         case transaction_receipt_header::soft_fail: return "soft_fail";
+         case transaction_receipt_header::hard_fail: return "hard_fail";
+         case transaction_receipt_header::delayed:   return "delayed";
+         case transaction_receipt_header::expired:   return "expired";
+      }
+      return "unknown";
+   }
+
+   /// sums the histograms of every peer, which all share the bounds of the first
+   void write_net_histogram( text_writer& w, const std::string& name, const char* help, const net_metrics& metrics,
+                             latency_histogram_status connection_metrics::* member ) {
+      std::vector<uint64_t> bounds;
+      std::vector<uint64_t> counts;
+      uint64_t sum_us = 0;
+      for( const auto& c : metrics.connections ) {
+         const latency_histogram_status& h = c.*member;
+         if( counts.empty() ) {
+            for( uint32_t ms : h.bucket_bounds_ms )
+               bounds.push_back( uint64_t(ms) * 1000 );
+            counts.resize( h.counts.size() );
+         }
+         if( h.counts.size() != counts.size() )
+            continue;
+         for( size_t i = 0; i < counts.size(); ++i )
+            counts[i] += h.counts[i];
+         sum_us += h.sum_us;
+      }
+      if( counts.empty() )
+         return;
+      w.family( name, "histogram", help );
+      w.write_histogram( name, bounds, counts, sum_us, us_per_second );
+   }
+
+}
+
+class prometheus_plugin_impl {
+public:
+   counter   blocks_accepted;
+   histogram block_transactions{ { 0, 1, 10, 50, 100, 250, 500, 1000, 2500 } };
+   histogram block_latency_us{ { 100000, 250000, 500000, 1000000, 2000000, 5000000, 10000000, 30000000, 60000000 } };
+
+   std::array<counter, transaction_receipt_header::expired + 1> transactions_by_status;
+   counter   transactions_failed; ///< traces without a receipt
+   histogram transaction_elapsed_us{ transaction_time_bounds() };
+   histogram transaction_cpu_us{ transaction_time_bounds() };
+   histogram transaction_net_bytes{ { 128, 256, 512, 1024, 4096, 16384, 65536 } };
+
+   fc::optional<scoped_connection> accepted_block_connection;
+   fc::optional<scoped_connection> applied_transaction_connection;
+
+   void on_accepted_block( const block_state_ptr& bsp ) {
+      blocks_accepted.inc();
+      block_transactions.observe( bsp->block->transactions.size() );
+      const auto latency = fc::time_point::now() - bsp->header.timestamp.to_time_point();
+      if( latency.count() > 0 )
+         block_latency_us.observe( latency.count() );
+   }
+
+   void on_applied_transaction( const transaction_trace_ptr& trace ) {
+      if( trace->receipt ) {
+         const uint32_t status = trace->receipt->status;
+         if( status < transactions_by_status.size() )
+            transactions_by_status[status].inc();
+         transaction_cpu_us.observe( trace->receipt->cpu_usage_us );
+         transaction_net_bytes.observe( uint64_t(trace->receipt->net_usage_words) * 8 );
+      } else {
+         transactions_failed.inc();
+      }
+      if( trace->elapsed.count() > 0 )
+         transaction_elapsed_us.observe( trace->elapsed.count() );
+   }
+
+   void write_chain( text_writer& w )const {
+      const controller& chain = app().get_plugin<chain_plugin>().chain();
+
+      w.family( "eosio_chain_head_block_num", "gauge", "Number of the head block" );
+      w.sample( "eosio_chain_head_block_num", uint64_t(chain.head_block_num()) );
+      w.family( "eosio_chain_fork_db_head_block_num", "gauge", "Number of the head block of the fork database" );
+      w.sample( "eosio_chain_fork_db_head_block_num", uint64_t(chain.fork_db_head_block_num()) );
+      w.family( "eosio_chain_last_irreversible_block_num", "gauge", "Number of the last irreversible block" );
+      w.sample( "eosio_chain_last_irreversible_block_num", uint64_t(chain.last_irreversible_block_num()) );
+
+      const auto& segment = *chain.db().get_segment_manager();
+      w.family( "eosio_chain_db_size_bytes", "gauge", "Size of the chain state database" );
+      w.sample( "eosio_chain_db_size_bytes", uint64_t(segment.get_size()) );
+      w.family( "eosio_chain_db_free_bytes", "gauge", "Free bytes of the chain state database" );
+      w.sample( "eosio_chain_db_free_bytes", uint64_t(segment.get_free_memory()) );
+
+      w.family( "eosio_chain_blocks_accepted_total", "counter", "Blocks accepted by the controller, produced or received" );
+      w.sample( "eosio_chain_blocks_accepted_total", blocks_accepted.value() );
+      w.family( "eosio_chain_block_transactions", "histogram", "Transactions per accepted block" );
+      w.write_histogram( "eosio_chain_block_transactions", block_transactions );
+      w.family( "eosio_chain_block_latency_seconds", "histogram", "Time from the timestamp of a block to it being accepted" );
+      w.write_histogram( "eosio_chain_block_latency_seconds", block_latency_us, us_per_second );
+
+      w.family( "eosio_chain_transactions_total", "counter",
+                "Transactions applied, speculatively or in blocks, by receipt status; failed when they got no receipt" );
+      for( uint32_t s = 0; s < transactions_by_status.size(); ++s )
+         w.sample( "eosio_chain_transactions_total", transactions_by_status[s].value(), { { "status", status_name( s ) } } );
+      w.sample( "eosio_chain_transactions_total", transactions_failed.value(), { { "status", "failed" } } );
+      w.family( "eosio_chain_transaction_elapsed_seconds", "histogram", "Wall clock time applying a transaction" );
+      w.write_histogram( "eosio_chain_transaction_elapsed_seconds", transaction_elapsed_us, us_per_second );
+      w.family( "eosio_chain_transaction_cpu_seconds", "histogram", "Cpu billed to a transaction with a receipt" );
+      w.write_histogram( "eosio_chain_transaction_cpu_seconds", transaction_cpu_us, us_per_second );
+      w.family( "eosio_chain_transaction_net_bytes", "histogram", "Net billed to a transaction with a receipt" );
+      w.write_histogram( "eosio_chain_transaction_net_bytes", transaction_net_bytes );
+   }
+
+   void write_wasm( text_writer& w )const {
+      const auto stats = app().get_plugin<chain_plugin>().chain().get_wasm_interface().get_execution_stats();
+
+      w.family( "eosio_wasm_oc_cache_hits_total", "counter", "Lookups of EOS VM OC code finding it compiled" );
+      w.sample( "eosio_wasm_oc_cache_hits_total", stats.oc_cache_hits );
+      w.family( "eosio_wasm_oc_cache_misses_total", "counter", "Lookups of EOS VM OC code not finding it compiled" );
+      w.sample( "eosio_wasm_oc_cache_misses_total", stats.oc_cache_misses );
+      w.family( "eosio_wasm_oc_cache_evictions_total", "counter", "Compiled codes evicted from the EOS VM OC code cache" );
+      w.sample( "eosio_wasm_oc_cache_evictions_total", stats.oc_cache_evictions );
+
+      uint64_t baseline_executions = 0, oc_executions = 0;
+      int64_t  baseline_us = 0, oc_us = 0;
+      for( const auto& c : stats.codes ) {
+         baseline_executions += c.baseline_executions;
+         baseline_us         += c.baseline_time.count();
+         oc_executions       += c.oc_executions;
+         oc_us               += c.oc_time.count();
+      }
+      w.family( "eosio_wasm_codes", "gauge", "Contract codes with execution statistics" );
+      w.sample( "eosio_wasm_codes", uint64_t(stats.codes.size()) );
+      w.family( "eosio_wasm_executions_total", "counter", "Actions executed, by the tier running their code" );
+      w.sample( "eosio_wasm_executions_total", baseline_executions, { { "tier", "baseline" } } );
+      w.sample( "eosio_wasm_executions_total", oc_executions, { { "tier", "oc" } } );
+      w.family( "eosio_wasm_execution_seconds_total", "counter", "Time executing actions, by the tier running their code" );
+      w.sample( "eosio_wasm_execution_seconds_total", baseline_us / us_per_second, { { "tier", "baseline" } } );
+      w.sample( "eosio_wasm_execution_seconds_total", oc_us / us_per_second, { { "tier", "oc" } } );
+   }
+
+   void write_producer( text_writer& w )const {
+      const producer_plugin* producer = app().find_plugin<producer_plugin>();
+      if( !producer || producer->get_state() != abstract_plugin::started )
+         return;
+
+      w.family( "eosio_producer_paused", "gauge", "1 when block production is paused" );
+      w.sample( "eosio_producer_paused", uint64_t(producer->paused()) );
+
+      // only kept when block-timing-history is configured
+      const auto timings = producer->get_block_timings( { 1 } );
+      if( timings.blocks.empty() )
+         return;
+      const auto& b = timings.blocks.front();
+      w.family( "eosio_producer_last_block_num", "gauge", "Number of the last block produced" );
+      w.sample( "eosio_producer_last_block_num", uint64_t(b.block_num) );
+      w.family( "eosio_producer_last_block_transactions", "gauge", "Transactions in the last block produced" );
+      w.sample( "eosio_producer_last_block_transactions", uint64_t(b.transactions) );
+      w.family( "eosio_producer_last_block_phase_seconds", "gauge", "Time spent in each phase of producing the last block" );
+      const std::pair<const char*, int64_t> phases[] = {
+         { "start_block", b.start_block_us }, { "unapplied", b.unapplied_us }, { "scheduled", b.scheduled_us },
+         { "incoming", b.incoming_us }, { "finalize", b.finalize_us }, { "sign", b.sign_us }, { "commit", b.commit_us } };
+      for( const auto& p : phases )
+         w.sample( "eosio_producer_last_block_phase_seconds", p.second / us_per_second, { { "phase", p.first } } );
+   }
+
+   void write_net( text_writer& w )const {
+      const net_plugin* net = app().find_plugin<net_plugin>();
+      if( !net || net->get_state() != abstract_plugin::started )
+         return;
+
+      uint64_t connected = 0, connecting = 0, syncing = 0;
+      for( const auto& c : net->connections() ) {
+         if( c.connecting )
+            ++connecting;
+         else
+            ++connected;
+         if( c.syncing )
+            ++syncing;
+      }
+      w.family( "eosio_net_peers", "gauge", "Peer connections by state; syncing counts connected peers being synced from" );
+      w.sample( "eosio_net_peers", connected, { { "state", "connected" } } );
+      w.sample( "eosio_net_peers", connecting, { { "state", "connecting" } } );
+      w.sample( "eosio_net_peers", syncing, { { "state", "syncing" } } );
+
+      // per connection counters, they restart along with the connection
+      const net_metrics metrics = net->metrics();
+      w.family( "eosio_net_write_bytes_total", "counter", "Bytes written to a peer" );
+      for( const auto& c : metrics.connections )
+         w.sample( "eosio_net_write_bytes_total", c.write_bytes, { { "peer", c.peer } } );
+      w.family( "eosio_net_blocks_received_total", "counter", "Blocks received from a peer" );
+      for( const auto& c : metrics.connections )
+         w.sample( "eosio_net_blocks_received_total", c.blocks_received, { { "peer", c.peer } } );
+      w.family( "eosio_net_write_queue_bytes", "gauge", "Bytes queued for writing to a peer" );
+      for( const auto& c : metrics.connections )
+         w.sample( "eosio_net_write_queue_bytes", uint64_t(c.write_queue_bytes), { { "peer", c.peer } } );
+
+      // summed over the current connections, so they drop when a peer goes away
+      write_net_histogram( w, "eosio_net_block_propagation_seconds", "Time from the timestamp of a block to its receipt from a peer",
+                           metrics, &connection_metrics::block_propagation );
+      write_net_histogram( w, "eosio_net_block_receive_to_apply_seconds", "Time from the receipt of a block to it being accepted",
+                           metrics, &connection_metrics::block_receive_to_apply );
+      write_net_histogram( w, "eosio_net_sync_chunk_rtt_seconds", "Time from a sync request to the first block of the range received",
+                           metrics, &connection_metrics::sync_chunk_rtt );
+   }
+
+   void write_http( text_writer& w )const {
+      const auto stats = app().get_plugin<http_plugin>().get_request_stats();
+
+      w.family( "eosio_http_requests_total", "counter", "Requests received, excluding OPTIONS and rejected hosts" );
+      w.sample( "eosio_http_requests_total", stats.requests );
+      w.family( "eosio_http_rejected_requests_total", "counter",
+                "Requests refused for the in flight limits or for queueing too long" );
+      w.sample( "eosio_http_rejected_requests_total", stats.rejected );
+      w.family( "eosio_http_responses_total", "counter", "Responses sent, by status class" );
+      for( size_t i = 1; i < stats.responses_by_class.size(); ++i )
+         w.sample( "eosio_http_responses_total", stats.responses_by_class[i], { { "class", std::to_string( i ) + "xx" } } );
+      w.family( "eosio_http_bytes_in_flight", "gauge", "Bytes of requests and responses being processed" );
+      w.sample( "eosio_http_bytes_in_flight", stats.bytes_in_flight );
+   }
+
+   void write_app_thread( text_writer& w )const {
+      const auto origins = app_thread_stats::all();
+      const std::vector<uint64_t> bounds( app_thread_origin::wait_bounds_us.begin(), app_thread_origin::wait_bounds_us.end() );
+      auto labels_of = []( const app_thread_origin::stats& o ) {
+         return prometheus::labels{ { "origin", o.name }, { "priority", std::to_string( o.priority ) } };
+      };
+
+      w.family( "eosio_app_thread_blocks_pending", "gauge", "Received blocks posted to the main thread and not started yet" );
+      w.sample( "eosio_app_thread_blocks_pending", app_thread_stats::blocks_pending() );
+      w.family( "eosio_app_thread_queued", "gauge", "Work posted to the main thread and not started yet, by origin and priority" );
+      for( const auto& o : origins )
+         w.sample( "eosio_app_thread_queued", o.queued, labels_of( o ) );
+      w.family( "eosio_app_thread_shed_total", "counter", "Reads dropped instead of run for waiting past their deadline behind a block" );
+      for( const auto& o : origins )
+         w.sample( "eosio_app_thread_shed_total", o.shed, labels_of( o ) );
+      w.family( "eosio_app_thread_run_seconds_total", "counter", "Time work held the main thread, by origin and priority" );
+      for( const auto& o : origins )
+         w.sample( "eosio_app_thread_run_seconds_total", o.run_us / us_per_second, labels_of( o ) );
+      w.family( "eosio_app_thread_max_wait_seconds", "gauge", "Longest wait from posting to the main thread to starting" );
+      for( const auto& o : origins )
+         w.sample( "eosio_app_thread_max_wait_seconds", o.max_wait_us / us_per_second, labels_of( o ) );
+      w.family( "eosio_app_thread_wait_seconds", "histogram", "Wait from posting to the main thread to starting or being shed" );
+      for( const auto& o : origins )
+         w.write_histogram( "eosio_app_thread_wait_seconds", bounds, o.wait_buckets, o.wait_us, us_per_second, labels_of( o ) );
+   }
+
+   void write_transaction_latency( text_writer& w )const {
+      if( !transaction_latency::enabled() )
+         return;
+      const std::vector<uint64_t> bounds( transaction_latency::bounds_us.begin(), transaction_latency::bounds_us.end() );
+      w.family( "eosio_transaction_latency_seconds", "histogram",
+                "Time tracked transactions spent in each stage from receipt to irreversibility, tallied once irreversible" );
+      for( const auto& s : transaction_latency::all() )
+         w.write_histogram( "eosio_transaction_latency_seconds", bounds, s.buckets, s.sum_us, us_per_second, { { "stage", s.stage } } );
+   }
+};
+
+prometheus_plugin::prometheus_plugin()
+: my( new prometheus_plugin_impl() )
+{
+}
+
+prometheus_plugin::~prometheus_plugin() = default;
+
+void prometheus_plugin::plugin_initialize(const variables_map& vm) {
+   try {
+      controller& chain = app().get_plugin<chain_plugin>().chain();
+      my->accepted_block_connection.emplace( chain.accepted_block.connect( [this]( const block_state_ptr& bsp ) {
+         my->on_accepted_block( bsp );
+      } ) );
+      my->applied_transaction_connection.emplace( chain.applied_transaction.connect(
+            [this]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
+         my->on_applied_transaction( std::get<0>( t ) );
+      } ) );
+   } FC_LOG_AND_RETHROW()
+}
+
+void prometheus_plugin::plugin_startup() {
+   app().get_plugin<http_plugin>().add_api({
+      { std::string( "/v1/prometheus/metrics" ),
+        [this]( string, string, url_response_callback cb ) {
+           try {
+              url_response_body body = url_response_body::from_json( metrics() );
+              body.content_type = text_writer::content_type;
+              cb( 200, std::move( body ) );
+           } catch( ... ) {
+              http_plugin::handle_exception( "prometheus", "metrics", "", cb );
+           }
+        } }
+   });
+}
+
+void prometheus_plugin::plugin_shutdown() {
+   my->accepted_block_connection.reset();
+   my->applied_transaction_connection.reset();
+}
+
+std::string prometheus_plugin::metrics()const {
+   text_writer w;
+   my->write_chain( w );
+   my->write_wasm( w );
+   my->write_producer( w );
+   my->write_net( w );
+   my->write_http( w );
+   my->write_app_thread( w );
+   my->write_transaction_latency( w );
+   return w.release();
+}
+
+}
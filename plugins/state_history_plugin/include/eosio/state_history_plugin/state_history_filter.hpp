@@ -0,0 +1,282 @@
+#pragma once
+
+#include <eosio/chain/block.hpp>
+#include <eosio/chain/transaction.hpp>
+#include <eosio/chain/types.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <map>
+
+namespace eosio {
+
+/**
+ * Walks serialized trace_history entries field by field. Callers read the few fields they need and skip the rest,
+ * so an entry can be filtered or rewritten without unpacking it.
+ */
+struct history_trace_reader {
+   using stream = fc::datastream<const char*>;
+
+   template <typename T>
+   static void append(chain::bytes& out, const T& v) {
+      auto packed = fc::raw::pack(v);
+      out.insert(out.end(), packed.begin(), packed.end());
+   }
+
+   template <typename T>
+   static T read(stream& ds) {
+      T v;
+      fc::raw::unpack(ds, v);
+      return v;
+   }
+
+   static void skip_bytes(stream& ds) { ds.skip(read<fc::unsigned_int>(ds).value); }
+
+   template <typename T>
+   static void skip_optional(stream& ds) {
+      if (read<bool>(ds))
+         read<T>(ds);
+   }
+
+   static void skip_pairs(stream& ds, size_t pair_size) {
+      ds.skip(read<fc::unsigned_int>(ds).value * pair_size);
+   }
+
+   // skips an action_trace_v0, returns whether on_action(receiver, account, action) matched it
+   template <typename F>
+   static bool skip_action_trace(stream& ds, F& on_action) {
+      read<fc::unsigned_int>(ds); // variant index
+      read<fc::unsigned_int>(ds); // action_ordinal
+      read<fc::unsigned_int>(ds); // creator_action_ordinal
+      if (read<bool>(ds)) {       // action_receipt_v0
+         read<fc::unsigned_int>(ds);
+         ds.skip(sizeof(uint64_t) + sizeof(chain::digest_type) + 2 * sizeof(uint64_t));
+         skip_pairs(ds, 2 * sizeof(uint64_t)); // auth_sequence
+         read<fc::unsigned_int>(ds);           // code_sequence
+         read<fc::unsigned_int>(ds);           // abi_sequence
+      }
+      const auto receiver = read<uint64_t>(ds);
+      const auto account  = read<uint64_t>(ds);
+      const auto act      = read<uint64_t>(ds);
+      skip_pairs(ds, 2 * sizeof(uint64_t)); // authorization
+      skip_bytes(ds);                       // data
+      ds.skip(sizeof(bool) + sizeof(int64_t)); // context_free, elapsed
+      skip_bytes(ds);                          // console
+      skip_pairs(ds, sizeof(uint64_t) + sizeof(int64_t)); // account_ram_deltas
+      skip_optional<std::string>(ds);                     // except
+      skip_optional<uint64_t>(ds);                        // error_code
+      return on_action(receiver, account, act);
+   }
+
+   /**
+    * Skips a transaction_trace_v0 up to, not including, its optional partial_transaction. Returns its id and whether
+    * on_action matched any of its actions, or those of its failed deferred trace.
+    */
+   template <typename F>
+   static std::pair<chain::transaction_id_type, bool> skip_transaction_trace_head(stream& ds, F& on_action) {
+      read<fc::unsigned_int>(ds); // variant index
+      auto id = read<chain::transaction_id_type>(ds);
+      ds.skip(sizeof(uint8_t) + sizeof(uint32_t)); // status, cpu_usage_us
+      read<fc::unsigned_int>(ds);                  // net_usage_words
+      ds.skip(sizeof(int64_t) + sizeof(uint64_t) + sizeof(bool)); // elapsed, net_usage, scheduled
+      bool matched     = false;
+      auto num_actions = read<fc::unsigned_int>(ds).value;
+      for (uint32_t i = 0; i < num_actions; ++i)
+         matched |= skip_action_trace(ds, on_action);
+      if (read<bool>(ds)) // account_ram_delta
+         ds.skip(sizeof(uint64_t) + sizeof(int64_t));
+      skip_optional<std::string>(ds); // except
+      skip_optional<uint64_t>(ds);    // error_code
+      if (read<bool>(ds))             // failed_dtrx_trace
+         matched |= skip_transaction_trace(ds, on_action);
+      return {id, matched};
+   }
+
+   static void skip_partial_transaction(stream& ds) {
+      read<fc::unsigned_int>(ds);
+      ds.skip(sizeof(uint32_t) + sizeof(uint16_t) + sizeof(uint32_t)); // expiration, ref_block_num, ref_block_prefix
+      read<fc::unsigned_int>(ds);                                    // max_net_usage_words
+      ds.skip(sizeof(uint8_t));                                      // max_cpu_usage_ms
+      read<fc::unsigned_int>(ds);                                    // delay_sec
+      read<chain::extensions_type>(ds);
+      read<std::vector<chain::signature_type>>(ds);
+      read<std::vector<chain::bytes>>(ds); // context_free_data
+   }
+
+   // skips a transaction_trace_v0, returns whether on_action matched any of its actions
+   template <typename F>
+   static bool skip_transaction_trace(stream& ds, F& on_action) {
+      bool matched = skip_transaction_trace_head(ds, on_action).second;
+      if (read<bool>(ds))
+         skip_partial_transaction(ds);
+      return matched;
+   }
+
+   /// packs a partial_transaction_v0 of trx, as state_history_serialization does for a trace with a partial
+   static void append_partial_transaction(chain::bytes& out, const chain::signed_transaction& trx) {
+      append(out, fc::unsigned_int(0));
+      append(out, trx.expiration);
+      append(out, trx.ref_block_num);
+      append(out, trx.ref_block_prefix);
+      append(out, trx.max_net_usage_words);
+      append(out, trx.max_cpu_usage_ms);
+      append(out, trx.delay_sec);
+      append(out, trx.transaction_extensions);
+      append(out, trx.signatures);
+      append(out, trx.context_free_data);
+   }
+
+   /**
+    * Rebuilds a trace_history entry stored with ship_block_refs: the traces of the transactions packed in block were
+    * written without their partial_transaction, which is recreated here from the block.
+    */
+   static chain::bytes expand_block_refs(const chain::bytes& in, const chain::signed_block& block) {
+      std::map<chain::transaction_id_type, const chain::packed_transaction*> packed;
+      for (const auto& r : block.transactions) {
+         if (r.trx.contains<chain::packed_transaction>()) {
+            const auto& pt = r.trx.get<chain::packed_transaction>();
+            packed.emplace(pt.id(), &pt);
+         }
+      }
+
+      stream ds(in.data(), in.size());
+      auto   num_traces = read<fc::unsigned_int>(ds);
+      auto   any_action = [](uint64_t, uint64_t, uint64_t) { return false; };
+
+      chain::bytes out;
+      out.reserve(in.size());
+      append(out, num_traces);
+      for (uint32_t i = 0; i < num_traces.value; ++i) {
+         const char* begin   = ds.pos();
+         auto        id      = skip_transaction_trace_head(ds, any_action).first;
+         out.insert(out.end(), begin, ds.pos());
+         const char* partial = ds.pos();
+         if (read<bool>(ds)) {
+            skip_partial_transaction(ds);
+            out.insert(out.end(), partial, ds.pos());
+            continue;
+         }
+         auto it = packed.find(id);
+         append(out, it != packed.end());
+         if (it != packed.end())
+            append_partial_transaction(out, it->second->get_signed_transaction());
+      }
+      return out;
+   }
+};
+
+/**
+ * Server-side filter of a get_blocks_request_v1. The log entries are filtered in their serialized form: only the
+ * fields needed to decide whether a transaction trace or a contract row matches are read, everything else is
+ * skipped over and matching entries are copied through unchanged.
+ */
+struct get_blocks_filter : history_trace_reader {
+   boost::container::flat_set<chain::name> accounts; ///< contract table code, or action account or receiver
+   boost::container::flat_set<chain::name> tables;   ///< contract table name
+   boost::container::flat_set<chain::name> actions;  ///< action name
+
+   bool filters_deltas() const { return !accounts.empty() || !tables.empty(); }
+   bool filters_traces() const { return !accounts.empty() || !actions.empty(); }
+
+   bool match_row(uint64_t code, uint64_t table) const {
+      return (accounts.empty() || accounts.count(chain::name(code))) &&
+             (tables.empty() || tables.count(chain::name(table)));
+   }
+
+   bool match_action(uint64_t receiver, uint64_t account, uint64_t act) const {
+      return (accounts.empty() || accounts.count(chain::name(account)) || accounts.count(chain::name(receiver))) &&
+             (actions.empty() || actions.count(chain::name(act)));
+   }
+
+   /**
+    * Filters a chain_state_history entry, fc::raw::pack(std::vector<table_delta>). Only rows of the contract_* tables
+    * whose code and table match are kept; deltas of the other tables, and deltas left without rows, are dropped.
+    */
+   chain::bytes filter_deltas(const chain::bytes& in) const {
+      fc::datastream<const char*> ds(in.data(), in.size());
+      fc::unsigned_int            num_deltas;
+      fc::raw::unpack(ds, num_deltas);
+
+      uint32_t     num_kept = 0;
+      chain::bytes kept;
+      for (uint32_t i = 0; i < num_deltas.value; ++i) {
+         fc::unsigned_int struct_version, num_rows;
+         std::string      name;
+         fc::raw::unpack(ds, struct_version);
+         fc::raw::unpack(ds, name);
+         fc::raw::unpack(ds, num_rows);
+         const bool contract_table = name.compare(0, 9, "contract_") == 0;
+
+         uint32_t     rows_kept = 0;
+         chain::bytes rows;
+         for (uint32_t j = 0; j < num_rows.value; ++j) {
+            const char* begin = ds.pos();
+            bool             present;
+            fc::unsigned_int size;
+            fc::raw::unpack(ds, present);
+            fc::raw::unpack(ds, size);
+            const char* data = ds.pos();
+            ds.skip(size.value);
+            if (!contract_table)
+               continue;
+            // every contract_* row starts with its variant index, code, scope and table
+            fc::datastream<const char*> row(data, size.value);
+            fc::unsigned_int            row_version;
+            uint64_t                    code, scope, table;
+            fc::raw::unpack(row, row_version);
+            fc::raw::unpack(row, code);
+            fc::raw::unpack(row, scope);
+            fc::raw::unpack(row, table);
+            if (match_row(code, table)) {
+               rows.insert(rows.end(), begin, ds.pos());
+               ++rows_kept;
+            }
+         }
+         if (!rows_kept)
+            continue;
+         append(kept, struct_version);
+         append(kept, name);
+         append(kept, fc::unsigned_int(rows_kept));
+         kept.insert(kept.end(), rows.begin(), rows.end());
+         ++num_kept;
+      }
+
+      chain::bytes out;
+      append(out, fc::unsigned_int(num_kept));
+      out.insert(out.end(), kept.begin(), kept.end());
+      return out;
+   }
+
+   /// Filters a trace_history entry, a packed vector of transaction_trace, keeping transactions with a matching action
+   chain::bytes filter_traces(const chain::bytes& in) const {
+      fc::datastream<const char*> ds(in.data(), in.size());
+      fc::unsigned_int            num_traces;
+      fc::raw::unpack(ds, num_traces);
+
+      uint32_t     num_kept = 0;
+      chain::bytes kept;
+      for (uint32_t i = 0; i < num_traces.value; ++i) {
+         const char* begin = ds.pos();
+         if (skip_transaction_trace(ds)) {
+            kept.insert(kept.end(), begin, ds.pos());
+            ++num_kept;
+         }
+      }
+
+      chain::bytes out;
+      append(out, fc::unsigned_int(num_kept));
+      out.insert(out.end(), kept.begin(), kept.end());
+      return out;
+   }
+
+ private:
+   // skips a transaction_trace_v0, returns whether any of its actions, or those of its failed deferred trace, matches
+   bool skip_transaction_trace(stream& ds) const {
+      auto on_action = [this](uint64_t receiver, uint64_t account, uint64_t act) {
+         return match_action(receiver, account, act);
+      };
+      return history_trace_reader::skip_transaction_trace(ds, on_action);
+   }
+};
+
+} // namespace eosio
@@ -1,7 +1,12 @@
 #pragma once
 
 #include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 #include <fstream>
+#include <limits>
+#include <map>
+#include <regex>
 #include <stdint.h>
 
 #include <eosio/chain/block_header.hpp>
@@ -26,12 +31,48 @@ namespace eosio {
  * each entry:
  *    state_history_log_header
  *    payload
+ *
+ * With a stride configured, the log is split once it holds the last block of a stride: the files are renamed to
+ * <name>-<first block>-<last block>.log and .index in the retained directory and a new, empty log is started.
+ * Reads of older blocks are routed to the retained file covering them.
+ */
+
+/*
+ * magic:
+ *    bits 32-63: "ship"
+ *    bits 24-31: flags (ship_block_refs), 0 for self-contained entries
+ *    bits 16-23: compression codec of the payload (ship_compression)
+ *    bits 0-15:  version
  */
+enum class ship_compression : uint8_t {
+   zlib = 0,
+   zstd = 1, // requires building with zstd support (EOSIO_SHIP_ZSTD)
+};
+
+inline bool ship_compression_supported(ship_compression compression) {
+#ifdef EOSIO_SHIP_ZSTD
+   return compression == ship_compression::zlib || compression == ship_compression::zstd;
+#else
+   return compression == ship_compression::zlib;
+#endif
+}
 
-inline uint64_t       ship_magic(uint32_t version) { return N(ship).to_uint64_t() | version; }
-inline bool           is_ship(uint64_t magic) { return (magic & 0xffff'ffff'0000'0000) == N(ship).to_uint64_t(); }
-inline uint32_t       get_ship_version(uint64_t magic) { return magic; }
-inline bool           is_ship_supported_version(uint64_t magic) { return get_ship_version(magic) == 0; }
+// the partial transactions of the traces of transactions packed in the block are left out of the entry; they are
+// rebuilt from the block in the block log when the entry is read
+static const uint8_t ship_block_refs = 0x01;
+
+inline uint64_t ship_magic(uint32_t version, ship_compression compression = ship_compression::zlib,
+                           uint8_t flags = 0) {
+   return N(ship).to_uint64_t() | (uint64_t(flags) << 24) | (uint64_t(compression) << 16) | version;
+}
+inline bool             is_ship(uint64_t magic) { return (magic & 0xffff'ffff'0000'0000) == N(ship).to_uint64_t(); }
+inline uint32_t         get_ship_version(uint64_t magic) { return magic & 0xffff; }
+inline ship_compression get_ship_compression(uint64_t magic) { return ship_compression((magic >> 16) & 0xff); }
+inline uint8_t          get_ship_flags(uint64_t magic) { return (magic >> 24) & 0xff; }
+inline bool             is_ship_supported_version(uint64_t magic) {
+   return get_ship_version(magic) == 0 && (get_ship_flags(magic) & ~ship_block_refs) == 0 &&
+          ship_compression_supported(get_ship_compression(magic));
+}
 static const uint32_t ship_current_version = 0;
 
 struct state_history_log_header {
@@ -43,6 +84,13 @@ static const int state_history_log_header_serial_size = sizeof(state_history_log
                                                         sizeof(state_history_log_header::block_id) +
                                                         sizeof(state_history_log_header::payload_size);
 
+struct state_history_log_config {
+   uint32_t                stride             = 0; ///< blocks per retained file; 0 keeps a single ever growing log
+   uint32_t                max_retained_files = std::numeric_limits<uint32_t>::max();
+   boost::filesystem::path retained_dir;       ///< where split files are kept; empty for the directory of the log
+   boost::filesystem::path archive_dir;        ///< where files beyond max_retained_files move; empty deletes them
+};
+
 class state_history_log {
  private:
    const char* const    name = "";
@@ -54,17 +102,64 @@ class state_history_log {
    uint32_t             _end_block   = 0;
    chain::block_id_type last_block_id;
 
+   // read-only mapping of a file, remapped once it no longer covers a requested range
+   struct file_view {
+      boost::interprocess::mapped_region region;
+      const char* data() const { return static_cast<const char*>(region.get_address()); }
+      uint64_t    size() const { return region.get_size(); }
+   };
+   file_view log_view;
+   file_view index_view;
+
+   // a file split off by the stride, opened on first read
+   struct retained_file {
+      uint32_t                           begin_block = 0;
+      uint32_t                           end_block   = 0;
+      std::string                        path; ///< without the .log or .index extension
+      std::unique_ptr<state_history_log> log;
+   };
+   state_history_log_config                config;
+   std::map<uint32_t, retained_file>       retained; ///< by begin_block, contiguous and ending where the log begins
+
+   struct retained_file_tag {};
+   // opens a retained file itself, which has no retained files of its own and must hold exactly the blocks its name says
+   state_history_log(retained_file_tag, const char* const name, const retained_file& file, state_history_log_config config)
+       : name(name)
+       , log_filename(file.path + ".log")
+       , index_filename(file.path + ".index")
+       , config(std::move(config)) {
+      open_log();
+      open_index();
+      EOS_ASSERT(_begin_block == file.begin_block && _end_block == file.end_block, chain::plugin_exception,
+                 "${p}.log holds blocks ${b}-${e}", ("p", file.path)("b", _begin_block)("e", _end_block - 1));
+   }
+
  public:
-   state_history_log(const char* const name, std::string log_filename, std::string index_filename)
+   state_history_log(const char* const name, std::string log_filename, std::string index_filename,
+                     state_history_log_config config = {})
        : name(name)
        , log_filename(std::move(log_filename))
-       , index_filename(std::move(index_filename)) {
+       , index_filename(std::move(index_filename))
+       , config(std::move(config)) {
+      if (this->config.retained_dir.empty())
+         this->config.retained_dir = boost::filesystem::path(this->log_filename).parent_path();
+      open_retained();
       open_log();
       open_index();
+      if (!retained.empty()) {
+         auto& last = retained.rbegin()->second;
+         EOS_ASSERT(_begin_block == _end_block || last.end_block == _begin_block, chain::plugin_exception,
+                    "${name}.log begins at ${b} but the retained files end at ${e}",
+                    ("name", name)("b", _begin_block)("e", last.end_block));
+         if (_begin_block == _end_block)
+            last_block_id = retained_log(last).get_block_id(last.end_block - 1);
+      }
    }
 
-   uint32_t begin_block() const { return _begin_block; }
-   uint32_t end_block() const { return _end_block; }
+   uint32_t begin_block() const { return retained.empty() ? _begin_block : retained.begin()->first; }
+   uint32_t end_block() const {
+      return retained.empty() || _begin_block != _end_block ? _end_block : retained.rbegin()->second.end_block;
+   }
 
    void read_header(state_history_log_header& header, bool assert_version = true) {
       char bytes[state_history_log_header_serial_size];
@@ -88,6 +183,24 @@ class state_history_log {
    template <typename F>
    void write_entry(const state_history_log_header& header, const chain::block_id_type& prev_id, F write_payload) {
       auto block_num = chain::block_header::num_from_id(header.block_id);
+      if (!retained.empty()) {
+         const uint32_t retained_end = retained.rbegin()->second.end_block;
+         EOS_ASSERT(_begin_block != _end_block || block_num <= retained_end, chain::plugin_exception,
+                    "missed a block in ${name}.log", ("name", name));
+         if (block_num < retained_end) {
+            // a fork replacing blocks which were already split off, every block of the log follows them
+            EOS_ASSERT(block_num >= retained.rbegin()->first, chain::plugin_exception,
+                       "fork of ${name}.log reaches back past the last retained file", ("name", name));
+            EOS_ASSERT(block_num == begin_block() || prev_id == get_block_id(block_num - 1), chain::plugin_exception,
+                       "missed a fork change in ${name}.log", ("name", name));
+            if (_begin_block != _end_block)
+               truncate(_begin_block);
+            reopen_last_retained(block_num);
+         } else if (block_num == retained_end) {
+            EOS_ASSERT(prev_id == retained_log(retained.rbegin()->second).get_block_id(block_num - 1),
+                       chain::plugin_exception, "missed a fork change in ${name}.log", ("name", name));
+         }
+      }
       EOS_ASSERT(_begin_block == _end_block || block_num <= _end_block, chain::plugin_exception,
                  "missed a block in ${name}.log", ("name", name));
 
@@ -120,6 +233,9 @@ class state_history_log {
          _begin_block = block_num;
       _end_block    = block_num + 1;
       last_block_id = header.block_id;
+
+      if (config.stride && _end_block % config.stride == 0)
+         split();
    }
 
    // returns cfile positioned at payload
@@ -131,13 +247,142 @@ class state_history_log {
       return log;
    }
 
+   /**
+    * Returns the payload of an entry as a span of the memory mapped log, without copying it. The span is valid until
+    * the next write_entry, which may truncate the log.
+    */
+   std::pair<const char*, uint64_t> get_payload(uint32_t block_num, state_history_log_header& header) {
+      if (auto* file = find_retained(block_num))
+         return retained_log(*file).get_payload(block_num, header);
+      EOS_ASSERT(block_num >= _begin_block && block_num < _end_block, chain::plugin_exception,
+                 "read non-existing block in ${name}.log", ("name", name));
+      uint64_t pos = get_mapped_pos(block_num);
+      fc::datastream<const char*> ds(view(log_view, log, pos, state_history_log_header_serial_size),
+                                     state_history_log_header_serial_size);
+      fc::raw::unpack(ds, header);
+      EOS_ASSERT(is_ship(header.magic) && is_ship_supported_version(header.magic), chain::plugin_exception,
+                 "corrupt ${name}.log (0)", ("name", name));
+      pos += state_history_log_header_serial_size;
+      return {view(log_view, log, pos, header.payload_size), header.payload_size};
+   }
+
    chain::block_id_type get_block_id(uint32_t block_num) {
       state_history_log_header header;
-      get_entry(block_num, header);
+      get_payload(block_num, header);
       return header.block_id;
    }
 
  private:
+   retained_file* find_retained(uint32_t block_num) {
+      if (retained.empty() || (block_num >= _begin_block && _begin_block != _end_block))
+         return nullptr;
+      auto it = retained.upper_bound(block_num);
+      if (it == retained.begin())
+         return nullptr;
+      --it;
+      return block_num < it->second.end_block ? &it->second : nullptr;
+   }
+
+   state_history_log& retained_log(retained_file& file) {
+      if (!file.log)
+         file.log.reset(new state_history_log(retained_file_tag{}, name, file, config));
+      return *file.log;
+   }
+
+   // rename() cannot cross file systems, which archive directories on other storage usually are
+   static void move_file(const boost::filesystem::path& from, const boost::filesystem::path& to) {
+      boost::system::error_code ec;
+      boost::filesystem::rename(from, to, ec);
+      if (!ec)
+         return;
+      boost::filesystem::copy_file(from, to, boost::filesystem::copy_option::overwrite_if_exists);
+      boost::filesystem::remove(from);
+   }
+
+   void open_retained() {
+      if (!boost::filesystem::is_directory(config.retained_dir))
+         return;
+      const std::regex pattern(std::string(name) + "-([0-9]+)-([0-9]+)\\.log");
+      for (auto& entry : boost::filesystem::directory_iterator(config.retained_dir)) {
+         std::smatch m;
+         const auto  filename = entry.path().filename().string();
+         if (!std::regex_match(filename, m, pattern))
+            continue;
+         retained_file file;
+         file.begin_block = std::stoul(m[1].str());
+         file.end_block   = std::stoul(m[2].str()) + 1;
+         file.path        = (config.retained_dir / entry.path().stem()).string();
+         retained.emplace(file.begin_block, std::move(file));
+      }
+      uint32_t expected = retained.empty() ? 0 : retained.begin()->first;
+      for (auto& r : retained) {
+         EOS_ASSERT(r.first == expected, chain::plugin_exception, "retained ${name} files are missing blocks ${b}-${e}",
+                    ("name", name)("b", expected)("e", r.first - 1));
+         expected = r.second.end_block;
+      }
+      if (!retained.empty())
+         ilog("${name} has ${n} retained files with blocks ${b}-${e}",
+              ("name", name)("n", retained.size())("b", retained.begin()->first)("e", expected - 1));
+   }
+
+   void close_files() {
+      log_view   = {};
+      index_view = {};
+      log.close();
+      index.close();
+   }
+
+   // moves the full log to the retained directory and starts an empty one
+   void split() {
+      close_files();
+      boost::filesystem::create_directories(config.retained_dir);
+      retained_file file;
+      file.begin_block = _begin_block;
+      file.end_block   = _end_block;
+      file.path        = (config.retained_dir / (std::string(name) + "-" + std::to_string(_begin_block) + "-" +
+                                                 std::to_string(_end_block - 1)))
+                      .string();
+      move_file(log_filename, file.path + ".log");
+      move_file(index_filename, file.path + ".index");
+      ilog("split ${name}.log: blocks ${b}-${e} moved to ${p}",
+           ("name", name)("b", file.begin_block)("e", file.end_block - 1)("p", file.path + ".log"));
+      retained.emplace(file.begin_block, std::move(file));
+      _begin_block = _end_block = 0;
+      open_log();
+      open_index();
+
+      while (retained.size() > config.max_retained_files) {
+         auto& oldest = retained.begin()->second;
+         oldest.log.reset();
+         for (const char* ext : {".log", ".index"}) {
+            boost::filesystem::path from = oldest.path + ext;
+            if (config.archive_dir.empty()) {
+               boost::filesystem::remove(from);
+            } else {
+               boost::filesystem::create_directories(config.archive_dir);
+               move_file(from, config.archive_dir / from.filename());
+            }
+         }
+         ilog("${a} ${name} blocks ${b}-${e}", ("a", config.archive_dir.empty() ? "removed" : "archived")
+              ("name", name)("b", oldest.begin_block)("e", oldest.end_block - 1));
+         retained.erase(retained.begin());
+      }
+   }
+
+   // a fork replaces blocks which were already split off; make their file the log again so it can be truncated
+   void reopen_last_retained(uint32_t block_num) {
+      auto it = std::prev(retained.end());
+      EOS_ASSERT(block_num >= it->first, chain::plugin_exception,
+                 "fork of ${name}.log reaches back past the last retained file", ("name", name));
+      close_files();
+      it->second.log.reset();
+      move_file(it->second.path + ".log", log_filename);
+      move_file(it->second.path + ".index", index_filename);
+      retained.erase(it);
+      open_log();
+      open_index();
+   }
+
    bool get_last_block(uint64_t size) {
       state_history_log_header header;
       uint64_t                 suffix;
@@ -259,6 +504,23 @@ class state_history_log {
       }
    }
 
+   const char* view(file_view& v, fc::cfile& file, uint64_t pos, uint64_t size) {
+      if (pos + size > v.size()) {
+         file.flush();
+         boost::interprocess::file_mapping mapping(file.get_file_path().generic_string().c_str(), boost::interprocess::read_only);
+         v.region = boost::interprocess::mapped_region(mapping, boost::interprocess::read_only);
+      }
+      EOS_ASSERT(pos + size <= v.size(), chain::plugin_exception, "read past the end of ${f}",
+                 ("f", file.get_file_path().generic_string()));
+      return v.data() + pos;
+   }
+
+   uint64_t get_mapped_pos(uint32_t block_num) {
+      uint64_t pos;
+      memcpy(&pos, view(index_view, index, (block_num - _begin_block) * sizeof(pos), sizeof(pos)), sizeof(pos));
+      return pos;
+   }
+
    uint64_t get_pos(uint32_t block_num) {
       uint64_t pos;
       index.seek((block_num - _begin_block) * sizeof(pos));
@@ -269,6 +531,9 @@ class state_history_log {
    void truncate(uint32_t block_num) {
       log.flush();
       index.flush();
+      // pages beyond the new end of a mapped file may not be touched once it shrinks
+      log_view   = {};
+      index_view = {};
       uint64_t num_removed = 0;
       if (block_num <= _begin_block) {
          num_removed = _end_block - _begin_block;
@@ -98,6 +98,13 @@ struct get_blocks_request_v0 {
    bool                        fetch_deltas           = false;
 };
 
+// get_blocks_request_v0 with server-side filters, see get_blocks_filter; empty lists do not filter
+struct get_blocks_request_v1 : get_blocks_request_v0 {
+   std::vector<chain::name> filter_accounts = {};
+   std::vector<chain::name> filter_tables   = {};
+   std::vector<chain::name> filter_actions  = {};
+};
+
 struct get_blocks_ack_request_v0 {
    uint32_t num_messages = 0;
 };
@@ -112,8 +119,39 @@ struct get_blocks_result_v0 {
    fc::optional<bytes>          deltas;
 };
 
-using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0>;
-using state_result  = fc::static_variant<get_status_result_v0, get_blocks_result_v0>;
+// an empty scope or table matches every scope or table of code
+struct table_row_filter {
+   chain::name code  = {};
+   chain::name scope = {};
+   chain::name table = {};
+};
+
+// replaces the session's subscription; an empty filter list cancels it
+struct subscribe_table_rows_request_v0 {
+   std::vector<table_row_filter> filters = {};
+};
+
+struct table_row_delta_v0 {
+   bool        present     = false;
+   chain::name code        = {};
+   chain::name scope       = {};
+   chain::name table       = {};
+   uint64_t    primary_key = 0;
+   chain::name payer       = {};
+   bytes       value       = {};
+};
+
+// pushed for every accepted block which changes a row matching the session's subscription. When a fork switch removes
+// a block whose rows were pushed, the rows are pushed again with undo set, restoring them as they were before it.
+struct table_rows_result_v0 {
+   block_position                  this_block = {};
+   std::vector<table_row_delta_v0> rows       = {};
+   bool                            undo       = false;
+};
+
+using state_request = fc::static_variant<get_status_request_v0, get_blocks_request_v0, get_blocks_ack_request_v0,
+                                         subscribe_table_rows_request_v0, get_blocks_request_v1>;
+using state_result  = fc::static_variant<get_status_result_v0, get_blocks_result_v0, table_rows_result_v0>;
 
 class state_history_plugin : public plugin<state_history_plugin> {
  public:
@@ -140,5 +178,10 @@ FC_REFLECT(eosio::block_position, (block_num)(block_id));
 FC_REFLECT_EMPTY(eosio::get_status_request_v0);
 FC_REFLECT(eosio::get_status_result_v0, (head)(last_irreversible)(trace_begin_block)(trace_end_block)(chain_state_begin_block)(chain_state_end_block));
 FC_REFLECT(eosio::get_blocks_request_v0, (start_block_num)(end_block_num)(max_messages_in_flight)(have_positions)(irreversible_only)(fetch_block)(fetch_traces)(fetch_deltas));
+FC_REFLECT_DERIVED(eosio::get_blocks_request_v1, (eosio::get_blocks_request_v0), (filter_accounts)(filter_tables)(filter_actions));
 FC_REFLECT(eosio::get_blocks_ack_request_v0, (num_messages));
+FC_REFLECT(eosio::table_row_filter, (code)(scope)(table));
+FC_REFLECT(eosio::subscribe_table_rows_request_v0, (filters));
+FC_REFLECT(eosio::table_row_delta_v0, (present)(code)(scope)(table)(primary_key)(payer)(value));
+FC_REFLECT(eosio::table_rows_result_v0, (this_block)(rows)(undo));
 // clang-format on
@@ -3,6 +3,7 @@
 #include <eosio/chain/account_object.hpp>
 #include <eosio/chain/controller.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/fixed_layout.hpp>
 #include <eosio/chain/generated_transaction_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/permission_link_object.hpp>
@@ -158,7 +159,10 @@ datastream<ST>& operator<<(datastream<ST>& ds, const history_serial_wrapper<eosi
    fc::raw::pack(ds, as_type<uint8_t>(obj.obj.vm_type));
    fc::raw::pack(ds, as_type<uint8_t>(obj.obj.vm_version));
    fc::raw::pack(ds, as_type<eosio::chain::digest_type>(obj.obj.code_hash));
-   fc::raw::pack(ds, as_type<eosio::chain::shared_string>(obj.obj.code));
+   obj.obj.with_code([&](std::string_view wasm) {
+      fc::raw::pack(ds, fc::unsigned_int(wasm.size()));
+      ds.write(wasm.data(), wasm.size());
+   });
    return ds;
 }
 
@@ -524,7 +528,7 @@ template <typename ST>
 datastream<ST>& operator<<(datastream<ST>& ds, const history_serial_wrapper<eosio::chain::action>& obj) {
    fc::raw::pack(ds, as_type<uint64_t>(obj.obj.account.to_uint64_t()));
    fc::raw::pack(ds, as_type<uint64_t>(obj.obj.name.to_uint64_t()));
-   history_serialize_container(ds, obj.db, as_type<std::vector<eosio::chain::permission_level>>(obj.obj.authorization));
+   eosio::chain::raw_fixed::pack(ds, as_type<std::vector<eosio::chain::permission_level>>(obj.obj.authorization));
    fc::raw::pack(ds, as_type<eosio::bytes>(obj.obj.data));
    return ds;
 }
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/state_history_plugin/state_history_plugin.hpp>
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <vector>
+
+namespace eosio {
+
+/// the contract rows one block changed, and the changes that restore the rows as they were before it
+struct table_rows_change {
+   block_position                  block       = {};
+   chain::block_id_type            previous    = {};
+   std::vector<table_row_delta_v0> rows        = {};
+   std::vector<table_row_delta_v0> undo_rows   = {}; ///< in the order to apply them
+};
+
+/// reads the contract rows changed in the newest undo session of db, that of the block just applied or being built
+inline table_rows_change collect_table_rows_change(const chainbase::database& db) {
+   using namespace chain;
+   table_rows_change change;
+   const auto& index          = db.get_index<key_value_index>();
+   const auto& table_id_index = db.get_index<table_id_multi_index>();
+   if (index.stack().empty() || table_id_index.stack().empty())
+      return change;
+
+   std::map<uint64_t, const table_id_object*> removed_table_id;
+   for (auto& rem : table_id_index.stack().back().removed_values)
+      removed_table_id[rem.first._id] = &rem.second;
+   auto get_table_id = [&](uint64_t tid) -> const table_id_object& {
+      auto obj = table_id_index.find(tid);
+      if (obj)
+         return *obj;
+      auto it = removed_table_id.find(tid);
+      EOS_ASSERT(it != removed_table_id.end(), plugin_exception, "can not found table id ${tid}", ("tid", tid));
+      return *it->second;
+   };
+   auto delta = [&](bool present, const key_value_object& row) {
+      auto& tid = get_table_id(row.t_id._id);
+      return table_row_delta_v0{present, tid.code, tid.scope, tid.table, row.primary_key, row.payer,
+                                bytes(row.value.data(), row.value.data() + row.value.size())};
+   };
+
+   auto& undo = index.stack().back();
+   for (auto& old : undo.old_values) {
+      auto& row = index.get(old.first);
+      if (old.second.payer != row.payer || old.second.value != row.value) {
+         change.rows.push_back(delta(true, row));
+         change.undo_rows.push_back(delta(true, old.second));
+      }
+   }
+   for (auto& old : undo.removed_values) {
+      change.rows.push_back(delta(false, old.second));
+      change.undo_rows.push_back(delta(true, old.second));
+   }
+   for (auto id : undo.new_ids) {
+      auto& row = index.get(id);
+      change.rows.push_back(delta(true, row));
+      change.undo_rows.push_back(delta(false, row));
+   }
+   std::reverse(change.undo_rows.begin(), change.undo_rows.end());
+   return change;
+}
+
+/**
+ * The row changes pushed to subscribers for the reversible blocks, by block id, so the changes of blocks a fork
+ * switch removes can be undone. Every block is recorded, with or without changes, so that the block a new one
+ * follows is always known.
+ */
+class table_rows_history {
+ public:
+   /**
+    * Forgets the blocks after previous, those a block following previous forks out, and returns them newest first.
+    * When previous is not recorded every recorded block is forked out, as they all follow the irreversible block.
+    */
+   std::vector<table_rows_change> fork_to(const chain::block_id_type& previous) {
+      std::vector<table_rows_change> forked;
+      while (!changes.empty() && changes.back().block.block_id != previous) {
+         forked.push_back(std::move(changes.back()));
+         changes.pop_back();
+      }
+      return forked;
+   }
+
+   void push(table_rows_change change) { changes.push_back(std::move(change)); }
+
+   /// forgets the blocks which are irreversible, they can no longer be forked out
+   void prune(uint32_t last_irreversible) {
+      while (!changes.empty() && changes.front().block.block_num <= last_irreversible)
+         changes.pop_front();
+   }
+
+   void   clear() { changes.clear(); }
+   size_t size() const { return changes.size(); }
+
+ private:
+   std::deque<table_rows_change> changes;
+};
+
+} // namespace eosio
@@ -1,6 +1,9 @@
 #include <eosio/chain/config.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#include <eosio/state_history_plugin/state_history_filter.hpp>
 #include <eosio/state_history_plugin/state_history_log.hpp>
 #include <eosio/state_history_plugin/state_history_serialization.hpp>
+#include <eosio/state_history_plugin/table_rows_history.hpp>
 
 #include <boost/asio/bind_executor.hpp>
 #include <boost/asio/ip/host_name.hpp>
@@ -10,9 +13,16 @@
 #include <boost/beast/websocket.hpp>
 #include <boost/iostreams/device/back_inserter.hpp>
 #include <boost/iostreams/filter/zlib.hpp>
+#ifdef EOSIO_SHIP_ZSTD
+#include <boost/iostreams/filter/zstd.hpp>
+#endif
 #include <boost/iostreams/filtering_stream.hpp>
 #include <boost/signals2/connection.hpp>
 
+#include <algorithm>
+#include <deque>
+#include <mutex>
+
 using tcp    = boost::asio::ip::tcp;
 namespace ws = boost::beast::websocket;
 
@@ -38,22 +48,43 @@ auto catch_and_log(F f) {
 }
 
 namespace bio = boost::iostreams;
-static bytes zlib_compress_bytes(bytes in) {
+// level < 0 selects the codec's default level
+static void push_compressor(bio::filtering_ostream& comp, ship_compression compression, int level) {
+   switch (compression) {
+   case ship_compression::zlib:
+      comp.push(bio::zlib_compressor(level < 0 ? bio::zlib::default_compression : level));
+      return;
+#ifdef EOSIO_SHIP_ZSTD
+   case ship_compression::zstd:
+      comp.push(bio::zstd_compressor(level < 0 ? bio::zstd::default_compression : level));
+      return;
+#endif
+   default: EOS_THROW(plugin_exception, "unsupported state history compression ${c}", ("c", (uint32_t)compression));
+   }
+}
+
+static bytes compress_bytes(bytes in, ship_compression compression, int level) {
    bytes                  out;
    bio::filtering_ostream comp;
-   comp.push(bio::zlib_compressor(bio::zlib::default_compression));
+   push_compressor(comp, compression, level);
    comp.push(bio::back_inserter(out));
    bio::write(comp, in.data(), in.size());
    bio::close(comp);
    return out;
 }
 
-static bytes zlib_decompress(const bytes& in) {
+static bytes decompress_bytes(const char* in, size_t size, ship_compression compression) {
    bytes                  out;
    bio::filtering_ostream decomp;
-   decomp.push(bio::zlib_decompressor());
+   switch (compression) {
+   case ship_compression::zlib: decomp.push(bio::zlib_decompressor()); break;
+#ifdef EOSIO_SHIP_ZSTD
+   case ship_compression::zstd: decomp.push(bio::zstd_decompressor()); break;
+#endif
+   default: EOS_THROW(plugin_exception, "unsupported state history compression ${c}", ("c", (uint32_t)compression));
+   }
    decomp.push(bio::back_inserter(out));
-   bio::write(decomp, in.data(), in.size());
+   bio::write(decomp, in, size);
    bio::close(decomp);
    return out;
 }
@@ -114,7 +145,25 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    chain_plugin*                                              chain_plug = nullptr;
    fc::optional<state_history_log>                            trace_log;
    fc::optional<state_history_log>                            chain_state_log;
+   bool                                                       chain_state_fresh = false;
+   std::mutex                                                 logs_mtx; // guards the logs against ship_thread
+   fc::optional<named_thread_pool>                            ship_thread;
+   fc::optional<named_thread_pool>                            backfill_threads; // reads entries of irreversible_only sessions
+
+   // Decompressed log entries recently sent to sessions. Sessions following head all ask for the same few blocks, so
+   // sharing them means each block is decompressed once rather than once per session. Guarded by logs_mtx.
+   struct cached_entry {
+      const state_history_log*     log       = nullptr;
+      uint32_t                     block_num = 0;
+      std::shared_ptr<const bytes> payload;
+   };
+   static constexpr size_t  max_cached_entries = 64;
+   std::deque<cached_entry> entry_cache;
+   uint64_t                 entry_cache_generation = 0; // bumped whenever cached entries are invalidated
    bool                                                       trace_debug_mode = false;
+   bool                                                       trace_block_refs = false;
+   ship_compression                                           compression      = ship_compression::zlib;
+   int                                                        compression_level = -1;
    bool                                                       stopping = false;
    fc::optional<scoped_connection>                            applied_transaction_connection;
    fc::optional<scoped_connection>                            accepted_block_connection;
@@ -124,35 +173,95 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    std::map<transaction_id_type, augmented_transaction_trace> cached_traces;
    fc::optional<augmented_transaction_trace>                  onblock_trace;
 
-   void get_log_entry(state_history_log& log, uint32_t block_num, fc::optional<bytes>& result) {
+   // thread safe as long as block, the block of a trace history entry written with trace-history-block-refs, is given
+   void get_log_entry(state_history_log& log, uint32_t block_num, fc::optional<bytes>& result,
+                      const signed_block_ptr& block = {}) {
+      std::unique_lock<std::mutex> g(logs_mtx);
       if (block_num < log.begin_block() || block_num >= log.end_block())
          return;
+      auto cached = std::find_if(entry_cache.begin(), entry_cache.end(), [&](const cached_entry& e) {
+         return e.log == &log && e.block_num == block_num;
+      });
+      if (cached != entry_cache.end()) {
+         auto payload = cached->payload;
+         g.unlock();
+         result = *payload;
+         return;
+      }
+      // the payload span points into the mapped log, which write_entry may truncate, so copy it out under the lock and
+      // decompress without it, letting sessions on other threads read entries meanwhile
       state_history_log_header header;
-      auto&                    stream = log.get_entry(block_num, header);
-      uint32_t                 s;
-      stream.read((char*)&s, sizeof(s));
-      bytes compressed(s);
-      if (s)
-         stream.read(compressed.data(), s);
-      result = zlib_decompress(compressed);
+      auto     span = log.get_payload(block_num, header);
+      uint32_t s;
+      EOS_ASSERT(span.second >= sizeof(s), plugin_exception, "corrupt state history entry for block ${b}",
+                 ("b", block_num));
+      memcpy(&s, span.first, sizeof(s));
+      EOS_ASSERT(sizeof(s) + s <= span.second, plugin_exception, "corrupt state history entry for block ${b}",
+                 ("b", block_num));
+      const bytes compressed(span.first + sizeof(s), span.first + sizeof(s) + s);
+      const auto  generation = entry_cache_generation;
+      g.unlock();
+
+      auto payload = std::make_shared<const bytes>(
+            decompress_bytes(compressed.data(), compressed.size(), get_ship_compression(header.magic)));
+      if (get_ship_flags(header.magic) & ship_block_refs)
+         payload = std::make_shared<const bytes>(expand_block_refs(*payload, block_num, header.block_id, block));
+      result = *payload;
+
+      g.lock();
+      // an entry replaced while it was decompressed must not be cached
+      if (generation == entry_cache_generation) {
+         entry_cache.push_back({&log, block_num, std::move(payload)});
+         if (entry_cache.size() > max_cached_entries)
+            entry_cache.pop_front();
+      }
    }
 
-   void get_block(uint32_t block_num, fc::optional<bytes>& result) {
-      chain::signed_block_ptr p;
+   /// rebuilds the partial transactions left out of a trace_history entry written with trace-history-block-refs;
+   /// block is read from the chain when not given
+   bytes expand_block_refs(const bytes& payload, uint32_t block_num, const block_id_type& block_id,
+                           signed_block_ptr block) {
+      if (!block)
+         block = get_block(block_num);
+      EOS_ASSERT(block && block->id() == block_id, plugin_exception,
+                 "block ${b} referenced by its trace history entry is not in the block log", ("b", block_num));
+      return history_trace_reader::expand_block_refs(payload, *block);
+   }
+
+   /// drops cached entries of log which the entry just written for block_num replaced or truncated; needs logs_mtx
+   void invalidate_cached_entries(const state_history_log& log, uint32_t block_num) {
+      ++entry_cache_generation;
+      entry_cache.erase(std::remove_if(entry_cache.begin(), entry_cache.end(),
+                                       [&](const cached_entry& e) { return e.log == &log && e.block_num >= block_num; }),
+                        entry_cache.end());
+   }
+
+   /// whether the trace history entry of block_num was written with trace-history-block-refs and needs its block
+   bool trace_entry_has_block_refs(uint32_t block_num) {
+      std::lock_guard<std::mutex> g(logs_mtx);
+      if (!trace_log || block_num < trace_log->begin_block() || block_num >= trace_log->end_block())
+         return false;
+      state_history_log_header header;
+      trace_log->get_payload(block_num, header);
+      return get_ship_flags(header.magic) & ship_block_refs;
+   }
+
+   signed_block_ptr get_block(uint32_t block_num) {
       try {
-         p = chain_plug->chain().fetch_block_by_number(block_num);
+         return chain_plug->chain().fetch_block_by_number(block_num);
       } catch (...) {
-         return;
+         return {};
       }
-      if (p)
-         result = fc::raw::pack(*p);
    }
 
    fc::optional<chain::block_id_type> get_block_id(uint32_t block_num) {
-      if (trace_log && block_num >= trace_log->begin_block() && block_num < trace_log->end_block())
-         return trace_log->get_block_id(block_num);
-      if (chain_state_log && block_num >= chain_state_log->begin_block() && block_num < chain_state_log->end_block())
-         return chain_state_log->get_block_id(block_num);
+      {
+         std::lock_guard<std::mutex> g(logs_mtx);
+         if (trace_log && block_num >= trace_log->begin_block() && block_num < trace_log->end_block())
+            return trace_log->get_block_id(block_num);
+         if (chain_state_log && block_num >= chain_state_log->begin_block() && block_num < chain_state_log->end_block())
+            return chain_state_log->get_block_id(block_num);
+      }
       try {
          auto block = chain_plug->chain().fetch_block_by_number(block_num);
          if (block)
@@ -169,7 +278,11 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       bool                                       sent_abi = false;
       std::vector<std::vector<char>>             send_queue;
       fc::optional<get_blocks_request_v0>        current_request;
+      std::shared_ptr<const get_blocks_filter>   filter = std::make_shared<const get_blocks_filter>(); // read by backfill_threads
+      bool                                       backfilling = false; // a result is being read on backfill_threads
       bool                                       need_to_send_update = false;
+      std::vector<table_row_filter>              table_filters;
+      uint32_t                                   table_rows_since = 0; // first block whose rows were pushed
 
       session(std::shared_ptr<state_history_plugin_impl> plugin)
           : plugin(std::move(plugin)) {}
@@ -241,18 +354,31 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          get_status_result_v0 result;
          result.head              = {chain.head_block_num(), chain.head_block_id()};
          result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
-         if (plugin->trace_log) {
-            result.trace_begin_block = plugin->trace_log->begin_block();
-            result.trace_end_block   = plugin->trace_log->end_block();
-         }
-         if (plugin->chain_state_log) {
-            result.chain_state_begin_block = plugin->chain_state_log->begin_block();
-            result.chain_state_end_block   = plugin->chain_state_log->end_block();
+         {
+            std::lock_guard<std::mutex> g(plugin->logs_mtx);
+            if (plugin->trace_log) {
+               result.trace_begin_block = plugin->trace_log->begin_block();
+               result.trace_end_block   = plugin->trace_log->end_block();
+            }
+            if (plugin->chain_state_log) {
+               result.chain_state_begin_block = plugin->chain_state_log->begin_block();
+               result.chain_state_end_block   = plugin->chain_state_log->end_block();
+            }
          }
          send(std::move(result));
       }
 
-      void operator()(get_blocks_request_v0& req) {
+      void operator()(get_blocks_request_v0& req) { start_get_blocks(req, {}); }
+
+      void operator()(get_blocks_request_v1& req) {
+         get_blocks_filter f;
+         f.accounts.insert(req.filter_accounts.begin(), req.filter_accounts.end());
+         f.tables.insert(req.filter_tables.begin(), req.filter_tables.end());
+         f.actions.insert(req.filter_actions.begin(), req.filter_actions.end());
+         start_get_blocks(req, std::move(f));
+      }
+
+      void start_get_blocks(get_blocks_request_v0& req, get_blocks_filter f) {
          for (auto& cp : req.have_positions) {
             if (req.start_block_num <= cp.block_num)
                continue;
@@ -262,6 +388,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          }
          req.have_positions.clear();
          current_request = req;
+         filter          = std::make_shared<const get_blocks_filter>(std::move(f));
          send_update(true);
       }
 
@@ -272,40 +399,121 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          send_update();
       }
 
+      void operator()(subscribe_table_rows_request_v0& req) {
+         table_filters    = std::move(req.filters);
+         table_rows_since = plugin->chain_plug->chain().head_block_num() + 1;
+      }
+
+      bool subscribed_to(const table_row_delta_v0& row) const {
+         return std::any_of(table_filters.begin(), table_filters.end(), [&](const table_row_filter& f) {
+            return f.code == row.code && (f.scope.empty() || f.scope == row.scope) &&
+                   (f.table.empty() || f.table == row.table);
+         });
+      }
+
+      void send_table_rows(const block_position& block, const std::vector<table_row_delta_v0>& rows, bool undo) {
+         // closed by an earlier push, or the rows of a block before the subscription, which were never pushed
+         if (!plugin->sessions.count(this) || (undo && block.block_num < table_rows_since))
+            return;
+         table_rows_result_v0 result;
+         result.this_block = block;
+         result.undo       = undo;
+         for (auto& row : rows)
+            if (subscribed_to(row))
+               result.rows.push_back(row);
+         if (result.rows.empty())
+            return;
+         if (send_queue.size() >= max_queued_table_rows_results) {
+            elog("table row subscriber is not keeping up; closing connection");
+            return close();
+         }
+         send(std::move(result));
+      }
+
       void send_update(get_blocks_result_v0 result) {
          need_to_send_update = true;
-         if (!send_queue.empty() || !current_request || !current_request->max_messages_in_flight)
+         if (!send_queue.empty() || backfilling || !current_request || !current_request->max_messages_in_flight)
             return;
          auto& chain = plugin->chain_plug->chain();
          result.last_irreversible = {chain.last_irreversible_block_num(), chain.last_irreversible_block_id()};
          uint32_t current =
                current_request->irreversible_only ? result.last_irreversible.block_num : result.head.block_num;
-         if (current_request->start_block_num <= current &&
-             current_request->start_block_num < current_request->end_block_num) {
-            auto block_id = plugin->get_block_id(current_request->start_block_num);
+         // blocks of irreversible_only requests are no longer written to, so their entries are read on
+         // backfill_threads and sessions backfilling disjoint ranges proceed in parallel
+         const bool backfill = plugin->backfill_threads && current_request->irreversible_only;
+         const bool traces   = current_request->fetch_traces && plugin->trace_log;
+         const bool deltas   = current_request->fetch_deltas && plugin->chain_state_log;
+         const uint32_t   block_num = current_request->start_block_num;
+         signed_block_ptr block;
+         bool             have_block = false;
+         if (block_num <= current && block_num < current_request->end_block_num) {
+            auto block_id = plugin->get_block_id(block_num);
             if (block_id) {
-               result.this_block  = block_position{current_request->start_block_num, *block_id};
-               auto prev_block_id = plugin->get_block_id(current_request->start_block_num - 1);
+               have_block = true;
+               result.this_block  = block_position{block_num, *block_id};
+               auto prev_block_id = plugin->get_block_id(block_num - 1);
                if (prev_block_id)
-                  result.prev_block = block_position{current_request->start_block_num - 1, *prev_block_id};
-               if (current_request->fetch_block)
-                  plugin->get_block(current_request->start_block_num, result.block);
-               if (current_request->fetch_traces && plugin->trace_log)
-                  plugin->get_log_entry(*plugin->trace_log, current_request->start_block_num, result.traces);
-               if (current_request->fetch_deltas && plugin->chain_state_log)
-                  plugin->get_log_entry(*plugin->chain_state_log, current_request->start_block_num, result.deltas);
+                  result.prev_block = block_position{block_num - 1, *prev_block_id};
+               // the chain is read on the main thread only, so the block of a trace history entry written with block
+               // refs is fetched here for the backfill thread
+               if (current_request->fetch_block || (backfill && traces && plugin->trace_entry_has_block_refs(block_num)))
+                  block = plugin->get_block(block_num);
+               if (current_request->fetch_block && block)
+                  result.block = fc::raw::pack(*block);
             }
             ++current_request->start_block_num;
          }
-         send(std::move(result));
          --current_request->max_messages_in_flight;
          need_to_send_update = current_request->start_block_num <= current &&
                                current_request->start_block_num < current_request->end_block_num;
+         if (!have_block || !(traces || deltas))
+            return send(std::move(result));
+         if (!backfill) {
+            get_log_entries(*plugin, *filter, block_num, traces, deltas, block, result);
+            return send(std::move(result));
+         }
+
+         backfilling = true;
+         boost::asio::post(plugin->backfill_threads->get_executor(), [self = shared_from_this(), filter = filter,
+                                                                      block_num, traces, deltas, block,
+                                                                      result = std::move(result)]() mutable {
+            fc::optional<std::vector<char>> packed;
+            try {
+               get_log_entries(*self->plugin, *filter, block_num, traces, deltas, block, result);
+               packed = fc::raw::pack(state_result{std::move(result)});
+            } FC_LOG_AND_DROP();
+            app().post(priority::medium, [self, packed = std::move(packed)]() mutable {
+               self->backfilling = false;
+               if (self->plugin->stopping || !self->plugin->sessions.count(self.get()))
+                  return;
+               if (!packed)
+                  return self->close();
+               self->catch_and_close([&] {
+                  self->send_queue.push_back(std::move(*packed));
+                  self->send();
+               });
+            });
+         });
+      }
+
+      // thread safe
+      static void get_log_entries(state_history_plugin_impl& plugin, const get_blocks_filter& filter, uint32_t block_num,
+                                  bool traces, bool deltas, const signed_block_ptr& block, get_blocks_result_v0& result) {
+         if (traces) {
+            plugin.get_log_entry(*plugin.trace_log, block_num, result.traces, block);
+            if (result.traces && filter.filters_traces())
+               result.traces = filter.filter_traces(*result.traces);
+         }
+         if (deltas) {
+            plugin.get_log_entry(*plugin.chain_state_log, block_num, result.deltas);
+            if (result.deltas && filter.filters_deltas())
+               result.deltas = filter.filter_deltas(*result.deltas);
+         }
       }
 
       void send_update(const block_state_ptr& block_state) {
          need_to_send_update = true;
-         if (!send_queue.empty() || !current_request || !current_request->max_messages_in_flight)
+         if (!send_queue.empty() || backfilling || !current_request || !current_request->max_messages_in_flight)
             return;
          get_blocks_result_v0 result;
          result.head = {block_state->block_num, block_state->id};
@@ -315,7 +523,7 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       void send_update(bool changed = false) {
          if (changed)
             need_to_send_update = true;
-         if (!send_queue.empty() || !need_to_send_update || !current_request ||
+         if (!send_queue.empty() || backfilling || !need_to_send_update || !current_request ||
              !current_request->max_messages_in_flight)
             return;
          auto& chain = plugin->chain_plug->chain();
@@ -366,6 +574,8 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       }
    };
    std::map<session*, std::shared_ptr<session>> sessions;
+   static constexpr size_t                      max_queued_table_rows_results = 1024;
+   table_rows_history                           pushed_table_rows; // of the reversible blocks, while there are subscribers
 
    void listen() {
       boost::system::error_code ec;
@@ -436,6 +646,18 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
    void on_accepted_block(const block_state_ptr& block_state) {
       store_traces(block_state);
       store_chain_state(block_state);
+      push_table_rows(block_state);
+      if (!ship_thread)
+         return notify_sessions(block_state);
+      // sessions learn about the block once its entries are in the logs
+      boost::asio::post(ship_thread->get_executor(), [this, block_state]() {
+         app().post(priority::medium, [this, block_state]() { notify_sessions(block_state); });
+      });
+   }
+
+   void notify_sessions(const block_state_ptr& block_state) {
+      if (stopping)
+         return;
       for (auto& s : sessions) {
          auto& p = s.second;
          if (p) {
@@ -446,6 +668,70 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
       }
    }
 
+   // Compresses the payload, unless it already is, and appends it to log on ship_thread. Entries are written in the
+   // order they are queued, so a fork switch still truncates before the replacement blocks are appended.
+   void queue_log_entry(state_history_log& log, const block_state_ptr& block_state, bytes payload, bool compressed,
+                        uint8_t flags = 0) {
+      boost::asio::post(ship_thread->get_executor(), [this, &log, block_state, payload = std::move(payload), compressed,
+                                                      flags, compression = compression,
+                                                      level = compression_level]() mutable {
+         catch_and_log([&] {
+            if (!compressed)
+               payload = compress_bytes(std::move(payload), compression, level);
+            EOS_ASSERT(payload.size() == (uint32_t)payload.size(), plugin_exception, "state history entry is too big");
+            state_history_log_header header{.magic        = ship_magic(ship_current_version, compression, flags),
+                                            .block_id     = block_state->id,
+                                            .payload_size = sizeof(uint32_t) + payload.size()};
+            std::lock_guard<std::mutex> g(logs_mtx);
+            log.write_entry(header, block_state->block->previous, [&](auto& stream) {
+               uint32_t s = (uint32_t)payload.size();
+               stream.write((char*)&s, sizeof(s));
+               if (!payload.empty())
+                  stream.write(payload.data(), payload.size());
+            });
+            invalidate_cached_entries(log, block_state->block_num);
+         });
+      });
+   }
+
+   /// waits for the entries queued so far to be written
+   void drain_ship_thread() {
+      if (ship_thread)
+         async_thread_pool(ship_thread->get_executor(), []() {}).wait();
+   }
+
+   // Pushes the contract rows changed by this block to sessions subscribed to their tables. Reads the same undo
+   // session as store_chain_state, so it does not depend on chain-state-history being enabled. The first block of a
+   // fork switch first undoes the rows of the blocks it forks out, newest first.
+   void push_table_rows(const block_state_ptr& block_state) {
+      bool any_subscriber = std::any_of(sessions.begin(), sessions.end(), [](auto& s) {
+         return s.second && !s.second->table_filters.empty();
+      });
+      if (!any_subscriber)
+         return pushed_table_rows.clear();
+
+      auto& chain  = chain_plug->chain();
+      auto  forked = pushed_table_rows.fork_to(block_state->header.previous);
+      auto  change = collect_table_rows_change(chain.db());
+      change.block    = {block_state->block_num, block_state->id};
+      change.previous = block_state->header.previous;
+
+      // send_table_rows may close, and so erase, a session
+      std::vector<std::shared_ptr<session>> subscribers;
+      for (auto& s : sessions)
+         if (s.second && !s.second->table_filters.empty())
+            subscribers.push_back(s.second);
+      for (auto& f : forked)
+         for (auto& s : subscribers)
+            s->send_table_rows(f.block, f.undo_rows, true);
+      if (!change.rows.empty())
+         for (auto& s : subscribers)
+            s->send_table_rows(change.block, change.rows, false);
+
+      pushed_table_rows.push(std::move(change));
+      pushed_table_rows.prune(chain.last_irreversible_block_num());
+   }
+
    void store_traces(const block_state_ptr& block_state) {
       if (!trace_log)
          return;
@@ -462,34 +748,29 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          EOS_ASSERT(it != cached_traces.end() && it->second.trace->receipt, plugin_exception,
                     "missing trace for transaction ${id}", ("id", id));
          traces.push_back(it->second);
+         // the block log already holds the packed transaction; it is put back into the trace when the entry is read
+         if (trace_block_refs && r.trx.contains<packed_transaction>())
+            traces.back().partial.reset();
       }
       cached_traces.clear();
       onblock_trace.reset();
 
-      auto& db         = chain_plug->chain().db();
-      auto  traces_bin = zlib_compress_bytes(fc::raw::pack(make_history_context_wrapper(db, trace_debug_mode, traces)));
-      EOS_ASSERT(traces_bin.size() == (uint32_t)traces_bin.size(), plugin_exception, "traces is too big");
-
-      state_history_log_header header{.magic        = ship_magic(ship_current_version),
-                                      .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + traces_bin.size()};
-      trace_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
-         uint32_t s = (uint32_t)traces_bin.size();
-         stream.write((char*)&s, sizeof(s));
-         if (!traces_bin.empty())
-            stream.write(traces_bin.data(), traces_bin.size());
-      });
+      // packing reads chainbase so it stays on the main thread; compressing and writing do not
+      auto& db = chain_plug->chain().db();
+      queue_log_entry(*trace_log, block_state, fc::raw::pack(make_history_context_wrapper(db, trace_debug_mode, traces)),
+                      false, trace_block_refs ? ship_block_refs : 0);
    }
 
    void store_chain_state(const block_state_ptr& block_state) {
       if (!chain_state_log)
          return;
-      bool fresh = chain_state_log->begin_block() == chain_state_log->end_block();
+      // the log itself may not have caught up with the queued entries yet
+      bool fresh        = chain_state_fresh;
+      chain_state_fresh = false;
       if (fresh)
          ilog("Placing initial state in block ${n}", ("n", block_state->block->block_num()));
 
-      std::vector<table_delta> deltas;
-      auto&                    db = chain_plug->chain().db();
+      auto& db = chain_plug->chain().db();
 
       const auto&                                table_id_index = db.get_index<table_id_multi_index>();
       std::map<uint64_t, const table_id_object*> removed_table_id;
@@ -511,73 +792,102 @@ struct state_history_plugin_impl : std::enable_shared_from_this<state_history_pl
          return fc::raw::pack(make_history_context_wrapper(db, get_table_id(row.t_id._id), row));
       };
 
+      // Deltas are packed in the same format as fc::raw::pack(std::vector<table_delta>). The initial state contains
+      // every row of every table, so its rows are fed to the compressor as soon as they are packed and only the
+      // compressed result is held in memory. The deltas of a single block are small; they are compressed on
+      // ship_thread so the main thread only pays for packing.
+      bytes                  deltas_bin;
+      bio::filtering_ostream comp;
+      if (fresh)
+         push_compressor(comp, compression, compression_level);
+      comp.push(bio::back_inserter(deltas_bin));
+      auto write_packed = [&](const auto& v) {
+         auto bin = fc::raw::pack(v);
+         bio::write(comp, bin.data(), bin.size());
+      };
+      auto write_row = [&](bool present, const bytes& row) {
+         write_packed(present);
+         write_packed(unsigned_int((uint32_t)row.size()));
+         if (!row.empty())
+            bio::write(comp, row.data(), row.size());
+      };
+      auto write_delta_header = [&](auto* name, size_t num_rows) {
+         EOS_ASSERT(num_rows <= 1024 * 1024 * 1024, plugin_exception, "too many rows in ${name} delta", ("name", name));
+         write_packed(table_delta{}.struct_version);
+         write_packed(std::string(name));
+         write_packed(unsigned_int((uint32_t)num_rows));
+      };
+
+      auto has_delta = [&](auto& index) {
+         if (fresh)
+            return !index.indices().empty();
+         if (index.stack().empty())
+            return false;
+         auto& undo = index.stack().back();
+         return !(undo.old_values.empty() && undo.new_ids.empty() && undo.removed_values.empty());
+      };
+
       auto process_table = [&](auto* name, auto& index, auto& pack_row) {
+         if (!has_delta(index))
+            return;
          if (fresh) {
-            if (index.indices().empty())
-               return;
-            deltas.push_back({});
-            auto& delta = deltas.back();
-            delta.name  = name;
+            write_delta_header(name, index.indices().size());
             for (auto& row : index.indices())
-               delta.rows.obj.emplace_back(true, pack_row(row));
+               write_row(true, pack_row(row));
          } else {
-            if (index.stack().empty())
-               return;
+            // the changes of a single block are small; collect them since include_delta decides the row count
+            std::vector<std::pair<bool, bytes>> rows;
             auto& undo = index.stack().back();
-            if (undo.old_values.empty() && undo.new_ids.empty() && undo.removed_values.empty())
-               return;
-            deltas.push_back({});
-            auto& delta = deltas.back();
-            delta.name  = name;
             for (auto& old : undo.old_values) {
                auto& row = index.get(old.first);
                if (include_delta(old.second, row))
-                  delta.rows.obj.emplace_back(true, pack_row(row));
+                  rows.emplace_back(true, pack_row(row));
             }
             for (auto& old : undo.removed_values)
-               delta.rows.obj.emplace_back(false, pack_row(old.second));
+               rows.emplace_back(false, pack_row(old.second));
             for (auto id : undo.new_ids) {
                auto& row = index.get(id);
-               delta.rows.obj.emplace_back(true, pack_row(row));
+               rows.emplace_back(true, pack_row(row));
             }
+            write_delta_header(name, rows.size());
+            for (auto& row : rows)
+               write_row(row.first, row.second);
          }
       };
 
-      process_table("account", db.get_index<account_index>(), pack_row);
-      process_table("account_metadata", db.get_index<account_metadata_index>(), pack_row);
-      process_table("code", db.get_index<code_index>(), pack_row);
-
-      process_table("contract_table", db.get_index<table_id_multi_index>(), pack_row);
-      process_table("contract_row", db.get_index<key_value_index>(), pack_contract_row);
-      process_table("contract_index64", db.get_index<index64_index>(), pack_contract_row);
-      process_table("contract_index128", db.get_index<index128_index>(), pack_contract_row);
-      process_table("contract_index256", db.get_index<index256_index>(), pack_contract_row);
-      process_table("contract_index_double", db.get_index<index_double_index>(), pack_contract_row);
-      process_table("contract_index_long_double", db.get_index<index_long_double_index>(), pack_contract_row);
-
-      process_table("global_property", db.get_index<global_property_multi_index>(), pack_row);
-      process_table("generated_transaction", db.get_index<generated_transaction_multi_index>(), pack_row);
-      process_table("protocol_state", db.get_index<protocol_state_multi_index>(), pack_row);
-
-      process_table("permission", db.get_index<permission_index>(), pack_row);
-      process_table("permission_link", db.get_index<permission_link_index>(), pack_row);
-
-      process_table("resource_limits", db.get_index<resource_limits::resource_limits_index>(), pack_row);
-      process_table("resource_usage", db.get_index<resource_limits::resource_usage_index>(), pack_row);
-      process_table("resource_limits_state", db.get_index<resource_limits::resource_limits_state_index>(), pack_row);
-      process_table("resource_limits_config", db.get_index<resource_limits::resource_limits_config_index>(), pack_row);
-
-      auto deltas_bin = zlib_compress_bytes(fc::raw::pack(deltas));
-      EOS_ASSERT(deltas_bin.size() == (uint32_t)deltas_bin.size(), plugin_exception, "deltas is too big");
-      state_history_log_header header{.magic        = ship_magic(ship_current_version),
-                                      .block_id     = block_state->block->id(),
-                                      .payload_size = sizeof(uint32_t) + deltas_bin.size()};
-      chain_state_log->write_entry(header, block_state->block->previous, [&](auto& stream) {
-         uint32_t s = (uint32_t)deltas_bin.size();
-         stream.write((char*)&s, sizeof(s));
-         if (!deltas_bin.empty())
-            stream.write(deltas_bin.data(), deltas_bin.size());
-      });
+      auto for_each_table = [&](auto&& f) {
+         f("account", db.get_index<account_index>(), pack_row);
+         f("account_metadata", db.get_index<account_metadata_index>(), pack_row);
+         f("code", db.get_index<code_index>(), pack_row);
+
+         f("contract_table", db.get_index<table_id_multi_index>(), pack_row);
+         f("contract_row", db.get_index<key_value_index>(), pack_contract_row);
+         f("contract_index64", db.get_index<index64_index>(), pack_contract_row);
+         f("contract_index128", db.get_index<index128_index>(), pack_contract_row);
+         f("contract_index256", db.get_index<index256_index>(), pack_contract_row);
+         f("contract_index_double", db.get_index<index_double_index>(), pack_contract_row);
+         f("contract_index_long_double", db.get_index<index_long_double_index>(), pack_contract_row);
+
+         f("global_property", db.get_index<global_property_multi_index>(), pack_row);
+         f("generated_transaction", db.get_index<generated_transaction_multi_index>(), pack_row);
+         f("protocol_state", db.get_index<protocol_state_multi_index>(), pack_row);
+
+         f("permission", db.get_index<permission_index>(), pack_row);
+         f("permission_link", db.get_index<permission_link_index>(), pack_row);
+
+         f("resource_limits", db.get_index<resource_limits::resource_limits_index>(), pack_row);
+         f("resource_usage", db.get_index<resource_limits::resource_usage_index>(), pack_row);
+         f("resource_limits_state", db.get_index<resource_limits::resource_limits_state_index>(), pack_row);
+         f("resource_limits_config", db.get_index<resource_limits::resource_limits_config_index>(), pack_row);
+      };
+
+      uint32_t num_deltas = 0;
+      for_each_table([&](auto*, auto& index, auto&) { num_deltas += has_delta(index); });
+      write_packed(unsigned_int(num_deltas));
+      for_each_table(process_table);
+      bio::close(comp);
+
+      queue_log_entry(*chain_state_log, block_state, std::move(deltas_bin), fresh);
    } // store_chain_state
 };   // state_history_plugin_impl
 
@@ -598,6 +908,32 @@ void state_history_plugin::set_program_options(options_description& cli, options
            "your internal network.");
    options("trace-history-debug-mode", bpo::bool_switch()->default_value(false),
            "enable debug mode for trace history");
+   options("trace-history-block-refs", bpo::bool_switch()->default_value(false),
+           "leave the signatures and context free data of transactions packed in a block out of its trace history "
+           "entry; they are read back from the block log when the entry is sent. The block log must keep every block "
+           "the trace history does.");
+   options("state-history-compression", bpo::value<string>()->default_value("zlib"),
+           "compression codec for new state history entries. Existing entries keep their codec.\n"
+           "  \"zlib\"\n"
+#ifdef EOSIO_SHIP_ZSTD
+           "  \"zstd\" - faster to decompress than zlib\n"
+#endif
+           );
+   options("state-history-compression-level", bpo::value<int>()->default_value(-1),
+           "compression level for the state history codec; -1 for the codec default, lower is faster");
+   options("state-history-stride", bpo::value<uint32_t>()->default_value(0),
+           "split the state history logs into files of this many blocks; 0 keeps a single file per log");
+   options("max-retained-history-files", bpo::value<uint32_t>()->default_value(std::numeric_limits<uint32_t>::max()),
+           "the most split state history files to retain; older files are archived or removed");
+   options("state-history-retained-dir", bpo::value<bfs::path>(),
+           "the location of the split state history files (absolute path or relative to state-history-dir); "
+           "defaults to state-history-dir");
+   options("state-history-archive-dir", bpo::value<bfs::path>(),
+           "the location to move split state history files beyond max-retained-history-files to (absolute path or "
+           "relative to state-history-dir); when not set they are removed");
+   options("state-history-backfill-threads", bpo::value<uint16_t>()->default_value(0),
+           "number of threads reading and packing the blocks of irreversible_only get_blocks requests, so sessions "
+           "backfilling disjoint block ranges are served in parallel; 0 serves every session on the main thread");
 }
 
 void state_history_plugin::plugin_initialize(const variables_map& options) {
@@ -629,22 +965,54 @@ void state_history_plugin::plugin_initialize(const variables_map& options) {
       my->endpoint_port    = std::stoi(port);
       idump((ip_port)(host)(port));
 
+      state_history_log_config log_config;
+      log_config.stride             = options.at("state-history-stride").as<uint32_t>();
+      log_config.max_retained_files = options.at("max-retained-history-files").as<uint32_t>();
+      auto resolve_dir = [&](const char* option) {
+         auto dir = options.at(option).as<bfs::path>();
+         return dir.is_relative() ? state_history_dir / dir : dir;
+      };
+      if (options.count("state-history-retained-dir"))
+         log_config.retained_dir = resolve_dir("state-history-retained-dir");
+      if (options.count("state-history-archive-dir"))
+         log_config.archive_dir = resolve_dir("state-history-archive-dir");
+
       if (options.at("delete-state-history").as<bool>()) {
          ilog("Deleting state history");
          boost::filesystem::remove_all(state_history_dir);
+         if (!log_config.retained_dir.empty())
+            boost::filesystem::remove_all(log_config.retained_dir);
       }
       boost::filesystem::create_directories(state_history_dir);
 
       if (options.at("trace-history-debug-mode").as<bool>()) {
          my->trace_debug_mode = true;
       }
+      my->trace_block_refs = options.at("trace-history-block-refs").as<bool>();
+
+      auto compression = options.at("state-history-compression").as<string>();
+      if (compression == "zlib")
+         my->compression = ship_compression::zlib;
+      else if (compression == "zstd")
+         my->compression = ship_compression::zstd;
+      else
+         EOS_THROW(plugin_config_exception, "unknown state-history-compression ${c}", ("c", compression));
+      EOS_ASSERT(ship_compression_supported(my->compression), plugin_config_exception,
+                 "state-history-compression ${c} is not supported by this build", ("c", compression));
+      my->compression_level = options.at("state-history-compression-level").as<int>();
 
       if (options.at("trace-history").as<bool>())
          my->trace_log.emplace("trace_history", (state_history_dir / "trace_history.log").string(),
-                               (state_history_dir / "trace_history.index").string());
+                               (state_history_dir / "trace_history.index").string(), log_config);
       if (options.at("chain-state-history").as<bool>())
          my->chain_state_log.emplace("chain_state_history", (state_history_dir / "chain_state_history.log").string(),
-                                     (state_history_dir / "chain_state_history.index").string());
+                                     (state_history_dir / "chain_state_history.index").string(), log_config);
+      if (my->chain_state_log)
+         my->chain_state_fresh = my->chain_state_log->begin_block() == my->chain_state_log->end_block();
+      if (my->trace_log || my->chain_state_log)
+         my->ship_thread.emplace("ship", 1);
+      if (auto threads = options.at("state-history-backfill-threads").as<uint16_t>(); threads > 0 && my->ship_thread)
+         my->backfill_threads.emplace("ship_backfill", threads);
    }
    FC_LOG_AND_RETHROW()
 } // state_history_plugin::plugin_initialize
@@ -657,6 +1025,9 @@ void state_history_plugin::plugin_shutdown() {
    while (!my->sessions.empty())
       my->sessions.begin()->second->close();
    my->stopping = true;
+   my->drain_ship_thread();
+   my->ship_thread.reset();
+   my->backfill_threads.reset();
 }
 
 } // namespace eosio
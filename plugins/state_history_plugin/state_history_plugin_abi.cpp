@@ -32,6 +32,21 @@ extern const char* const state_history_plugin_abi = R"({
                 { "name": "fetch_deltas", "type": "bool" }
             ]
         },
+        {
+            "name": "get_blocks_request_v1", "fields": [
+                { "name": "start_block_num", "type": "uint32" },
+                { "name": "end_block_num", "type": "uint32" },
+                { "name": "max_messages_in_flight", "type": "uint32" },
+                { "name": "have_positions", "type": "block_position[]" },
+                { "name": "irreversible_only", "type": "bool" },
+                { "name": "fetch_block", "type": "bool" },
+                { "name": "fetch_traces", "type": "bool" },
+                { "name": "fetch_deltas", "type": "bool" },
+                { "name": "filter_accounts", "type": "name[]" },
+                { "name": "filter_tables", "type": "name[]" },
+                { "name": "filter_actions", "type": "name[]" }
+            ]
+        },
         {
             "name": "get_blocks_ack_request_v0", "fields": [
                 { "name": "num_messages", "type": "uint32" }
@@ -48,6 +63,36 @@ extern const char* const state_history_plugin_abi = R"({
                 { "name": "deltas", "type": "bytes?" }
             ]
         },
+        {
+            "name": "table_row_filter", "fields": [
+                { "name": "code", "type": "name" },
+                { "name": "scope", "type": "name" },
+                { "name": "table", "type": "name" }
+            ]
+        },
+        {
+            "name": "subscribe_table_rows_request_v0", "fields": [
+                { "name": "filters", "type": "table_row_filter[]" }
+            ]
+        },
+        {
+            "name": "table_row_delta_v0", "fields": [
+                { "name": "present", "type": "bool" },
+                { "name": "code", "type": "name" },
+                { "name": "scope", "type": "name" },
+                { "name": "table", "type": "name" },
+                { "name": "primary_key", "type": "uint64" },
+                { "name": "payer", "type": "name" },
+                { "name": "value", "type": "bytes" }
+            ]
+        },
+        {
+            "name": "table_rows_result_v0", "fields": [
+                { "name": "this_block", "type": "block_position" },
+                { "name": "rows", "type": "table_row_delta_v0[]" },
+                { "name": "undo", "type": "bool" }
+            ]
+        },
         {
             "name": "row", "fields": [
                 { "name": "present", "type": "bool" },
@@ -497,8 +542,8 @@ extern const char* const state_history_plugin_abi = R"({
         { "new_type_name": "transaction_id", "type": "checksum256" }
     ],
     "variants": [
-        { "name": "request", "types": ["get_status_request_v0", "get_blocks_request_v0", "get_blocks_ack_request_v0"] },
-        { "name": "result", "types": ["get_status_result_v0", "get_blocks_result_v0"] },
+        { "name": "request", "types": ["get_status_request_v0", "get_blocks_request_v0", "get_blocks_ack_request_v0", "subscribe_table_rows_request_v0", "get_blocks_request_v1"] },
+        { "name": "result", "types": ["get_status_result_v0", "get_blocks_result_v0", "table_rows_result_v0"] },
 
         { "name": "action_receipt", "types": ["action_receipt_v0"] },
         { "name": "action_trace", "types": ["action_trace_v0"] },
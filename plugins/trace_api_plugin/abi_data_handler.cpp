@@ -15,6 +15,19 @@ namespace eosio::trace_api {
          auto type_name = serializer_p->get_action_type(action.action);
 
          if (!type_name.empty()) {
+            fc::sha256 key;
+            if (decode_cache.enabled()) {
+               // abis are only added at startup so a decoded payload never goes stale
+               fc::sha256::encoder enc;
+               fc::raw::pack(enc, action.account);
+               fc::raw::pack(enc, action.action);
+               fc::raw::pack(enc, action.data);
+               key = enc.result();
+               if (auto cached = decode_cache.get(key)) {
+                  return *cached;
+               }
+            }
+
             try {
                // abi_serializer expects a yield function that takes a recursion depth
                auto abi_yield = [yield](size_t recursion_depth) {
@@ -22,7 +35,9 @@ namespace eosio::trace_api {
                   EOS_ASSERT( recursion_depth < chain::abi_serializer::max_recursion_depth, chain::abi_recursion_depth_exception,
                               "exceeded max_recursion_depth ${r} ", ("r", chain::abi_serializer::max_recursion_depth) );
                };
-               return serializer_p->binary_to_variant(type_name, action.data, abi_yield);
+               auto result = serializer_p->binary_to_variant(type_name, action.data, abi_yield);
+               decode_cache.put(key, result);
+               return result;
             } catch (...) {
                except_handler(MAKE_EXCEPTION_WITH_CONTEXT(std::current_exception()));
             }
@@ -2,6 +2,8 @@
 
 #include <zlib.h>
 
+#include <future>
+
 namespace {
    using seek_point_entry = std::tuple<uint64_t, uint64_t>;
    constexpr size_t expected_seek_point_entry_size = 16;
@@ -15,6 +17,40 @@ namespace {
    //
    static_assert(sizeof(seek_point_entry) == expected_seek_point_entry_size, "unexpected size for seek point");
    static_assert(sizeof(seek_point_count_type) == expected_seek_point_count_size, "Unexpected size for seek point count");
+
+   // Compresses one seek point segment with its own deflate stream. A full flush resets the compressor, so the raw
+   // outputs of consecutive segments concatenate into the same kind of stream that a single compressor calling
+   // Z_FULL_FLUSH between them produces, and a decompressor can still start at every segment boundary.
+   std::vector<uint8_t> deflate_segment( std::vector<uint8_t> input, bool last ) {
+      z_stream strm;
+      strm.zalloc = Z_NULL;
+      strm.zfree = Z_NULL;
+      strm.opaque = Z_NULL;
+      if (deflateInit2(&strm, Z_BEST_COMPRESSION, Z_DEFLATED, raw_zlib_window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+         throw eosio::trace_api::compressed_file_error("failed to initialize compression");
+      }
+
+      std::vector<uint8_t> output(deflateBound(&strm, input.size()) + 16);
+      strm.avail_in = input.size();
+      strm.next_in = input.data();
+      const int mode = last ? Z_FINISH : Z_FULL_FLUSH;
+      int ret;
+      do {
+         if (strm.total_out == output.size())
+            output.resize(output.size() * 2);
+         strm.avail_out = output.size() - strm.total_out;
+         strm.next_out = output.data() + strm.total_out;
+         ret = deflate(&strm, mode);
+      } while (ret == Z_OK && (strm.avail_out == 0 || (last && ret != Z_STREAM_END)));
+
+      const bool success = last ? ret == Z_STREAM_END : ret == Z_OK;
+      output.resize(strm.total_out);
+      deflateEnd(&strm);
+      if (!success) {
+         throw eosio::trace_api::compressed_file_error(std::string("deflate failed: ") + std::to_string(ret));
+      }
+      return output;
+   }
 }
 
 namespace eosio::trace_api {
@@ -194,7 +230,7 @@ compressed_file::compressed_file( compressed_file&& ) = default;
 compressed_file& compressed_file::operator= ( compressed_file&& ) = default;
 
 
-bool compressed_file::process( const fc::path& input_path, const fc::path& output_path, size_t seek_point_stride  ) {
+bool compressed_file::process( const fc::path& input_path, const fc::path& output_path, size_t seek_point_stride, size_t threads ) {
    if (!fc::exists(input_path)) {
       throw std::ios_base::failure(std::string("Attempting to create compressed_file from file that does not exist: ") + input_path.generic_string());
    }
@@ -219,6 +255,44 @@ bool compressed_file::process( const fc::path& input_path, const fc::path& outpu
    output_file.set_file_path(output_path);
    output_file.open("wb");
 
+   auto finish = [&]() {
+      // write out the seek point table
+      if (seek_point_map.size() > 0) {
+         output_file.write(reinterpret_cast<const char*>(seek_point_map.data()), seek_point_map.size() * sizeof(seek_point_entry));
+      }
+
+      // write out the seek point count
+      output_file.write(reinterpret_cast<const char*>(&seek_point_count), sizeof(seek_point_count_type));
+
+      output_file.close();
+      return true;
+   };
+
+   if (threads > 1 && seek_point_count > 0) {
+      // segments are compressed `threads` at a time so at most that many strides of input are held in memory
+      const size_t segment_count = seek_point_count + 1;
+      for (size_t first = 0; first < segment_count; first += threads) {
+         const size_t batch_size = std::min(threads, segment_count - first);
+         std::vector<std::future<std::vector<uint8_t>>> batch;
+         batch.reserve(batch_size);
+         for (size_t i = first; i < first + batch_size; ++i) {
+            auto input = std::vector<uint8_t>(std::min(seek_point_stride, input_size - i * seek_point_stride));
+            input_file.read(reinterpret_cast<char*>(input.data()), input.size());
+            batch.emplace_back(std::async(std::launch::async, deflate_segment, std::move(input), i + 1 == segment_count));
+         }
+         for (size_t i = 0; i < batch_size; ++i) {
+            const auto output = batch[i].get();
+            output_file.write(reinterpret_cast<const char*>(output.data()), output.size());
+            const size_t segment = first + i;
+            if (segment < seek_point_count) {
+               seek_point_map.at(segment) = {(segment + 1) * seek_point_stride, output_file.tellp()};
+            }
+         }
+      }
+      input_file.close();
+      return finish();
+   }
+
    z_stream strm;
    strm.zalloc = Z_NULL;
    strm.zfree = Z_NULL;
@@ -300,16 +374,7 @@ bool compressed_file::process( const fc::path& input_path, const fc::path& outpu
    deflateEnd(&strm);
    input_file.close();
 
-   // write out the seek point table
-   if (seek_point_map.size() > 0) {
-      output_file.write(reinterpret_cast<const char*>(seek_point_map.data()), seek_point_map.size() * sizeof(seek_point_entry));
-   }
-
-   // write out the seek point count
-   output_file.write(reinterpret_cast<const char*>(&seek_point_count), sizeof(seek_point_count_type));
-
-   output_file.close();
-   return true;
+   return finish();
 }
 
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 #include <eosio/chain/abi_def.hpp>
 #include <eosio/trace_api/trace.hpp>
 #include <eosio/trace_api/common.hpp>
+#include <eosio/trace_api/lru_cache.hpp>
 
 namespace eosio {
    namespace chain {
@@ -18,8 +19,12 @@ namespace eosio {
     */
    class abi_data_handler {
    public:
-      explicit abi_data_handler( exception_handler except_handler )
+      /**
+       * @param decode_cache_size - number of decoded action payloads retained, 0 disables the cache
+       */
+      explicit abi_data_handler( exception_handler except_handler, size_t decode_cache_size = 0 )
       :except_handler( std::move( except_handler ) )
+      ,decode_cache( decode_cache_size )
       {
       }
 
@@ -56,7 +61,13 @@ namespace eosio {
       };
 
    private:
+      struct digest_hash {
+         size_t operator()( const fc::sha256& d ) const { return d._hash[0]; }
+      };
+
       std::map<chain::name, std::shared_ptr<chain::abi_serializer>> abi_serializer_by_account;
       exception_handler except_handler;
+      // keyed by the digest of the account, action name and data of the decoded action
+      lru_cache<fc::sha256, fc::variant, digest_hash> decode_cache;
    };
 } }
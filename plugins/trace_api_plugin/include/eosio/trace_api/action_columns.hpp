@@ -0,0 +1,57 @@
+#pragma once
+#include <fc/variant.hpp>
+#include <eosio/trace_api/trace.hpp>
+
+namespace eosio { namespace trace_api {
+
+   /**
+    * One row group of the columnar action export: a row per action of the block traces written together, stored
+    * column by column. Every column is an fc::raw packed vector, i.e. a varuint32 row count followed by the
+    * little-endian values back to back, so a reader can load a column of a row group without decoding the others.
+    *
+    * Authorizations and data are variable length; row i owns the entries [offset[i], offset[i+1]) of their columns.
+    */
+   struct action_columns_v0 {
+      std::vector<uint32_t>                    block_num;
+      std::vector<chain::transaction_id_type>  transaction_id;
+      std::vector<uint64_t>                    global_sequence;
+      std::vector<chain::name>                 receiver;
+      std::vector<chain::name>                 account;
+      std::vector<chain::name>                 action;
+      std::vector<uint32_t>                    authorization_offset;
+      std::vector<chain::name>                 actor;
+      std::vector<chain::name>                 permission;
+      std::vector<uint32_t>                    data_offset;
+      chain::bytes                             data;
+
+      size_t size() const { return block_num.size(); }
+
+      void append( const block_trace_v0& bt ) {
+         if (authorization_offset.empty()) {
+            authorization_offset.push_back(0);
+            data_offset.push_back(0);
+         }
+         for (const auto& t : bt.transactions) {
+            for (const auto& a : t.actions) {
+               block_num.push_back(bt.number);
+               transaction_id.push_back(t.id);
+               global_sequence.push_back(a.global_sequence);
+               receiver.push_back(a.receiver);
+               account.push_back(a.account);
+               action.push_back(a.action);
+               for (const auto& auth : a.authorization) {
+                  actor.push_back(auth.account);
+                  permission.push_back(auth.permission);
+               }
+               authorization_offset.push_back(actor.size());
+               data.insert(data.end(), a.data.begin(), a.data.end());
+               data_offset.push_back(data.size());
+            }
+         }
+      }
+   };
+
+}}
+
+FC_REFLECT(eosio::trace_api::action_columns_v0, (block_num)(transaction_id)(global_sequence)(receiver)(account)(action)
+                                                (authorization_offset)(actor)(permission)(data_offset)(data));
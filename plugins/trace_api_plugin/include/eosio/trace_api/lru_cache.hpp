@@ -0,0 +1,72 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+
+namespace eosio::trace_api {
+
+   /**
+    * Bounded, thread safe LRU map. A capacity of 0 disables it: every lookup misses and nothing is retained.
+    * Values are returned by copy so they should be cheap to copy (eg fc::variant, shared_ptr).
+    */
+   template<typename Key, typename Value, typename Hash = std::hash<Key>>
+   class lru_cache {
+   public:
+      explicit lru_cache( size_t capacity )
+      :_capacity(capacity)
+      {}
+
+      bool enabled() const { return _capacity > 0; }
+
+      std::optional<Value> get( const Key& key ) {
+         if (!enabled())
+            return {};
+         std::lock_guard<std::mutex> g(_mtx);
+         auto itr = _index.find(key);
+         if (itr == _index.end())
+            return {};
+         _lru.splice(_lru.begin(), _lru, itr->second);
+         return itr->second->second;
+      }
+
+      void put( const Key& key, Value value ) {
+         if (!enabled())
+            return;
+         std::lock_guard<std::mutex> g(_mtx);
+         auto itr = _index.find(key);
+         if (itr != _index.end()) {
+            itr->second->second = std::move(value);
+            _lru.splice(_lru.begin(), _lru, itr->second);
+            return;
+         }
+         _lru.emplace_front(key, std::move(value));
+         _index.emplace(key, _lru.begin());
+         if (_lru.size() > _capacity) {
+            _index.erase(_lru.back().first);
+            _lru.pop_back();
+         }
+      }
+
+      void erase( const Key& key ) {
+         if (!enabled())
+            return;
+         std::lock_guard<std::mutex> g(_mtx);
+         auto itr = _index.find(key);
+         if (itr != _index.end()) {
+            _lru.erase(itr->second);
+            _index.erase(itr);
+         }
+      }
+
+   private:
+      using entry_list = std::list<std::pair<Key, Value>>;
+
+      const size_t                                                _capacity;
+      std::mutex                                                  _mtx;
+      entry_list                                                  _lru;
+      std::unordered_map<Key, typename entry_list::iterator, Hash> _index;
+   };
+
+}
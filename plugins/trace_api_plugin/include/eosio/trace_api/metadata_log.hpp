@@ -20,7 +20,22 @@ namespace eosio { namespace trace_api {
       lib_entry_v0
    >;
 
+   /**
+    * One run of the transaction id index: the sorted, truncated ids of the transactions in a block and where that
+    * block is in the trace file. A truncated id only selects candidate blocks, the trace itself confirms the match.
+    */
+   struct trx_id_entry_v0 {
+      uint32_t               number;
+      uint64_t               offset;
+      std::vector<uint64_t>  ids;
+
+      static uint64_t truncate_id( const chain::transaction_id_type& id ) {
+         return id._hash[0];
+      }
+   };
+
 }}
 
 FC_REFLECT(eosio::trace_api::block_entry_v0, (id)(number)(offset));
 FC_REFLECT(eosio::trace_api::lib_entry_v0, (lib));
+FC_REFLECT(eosio::trace_api::trx_id_entry_v0, (number)(offset)(ids));
@@ -1,26 +1,42 @@
 #pragma once
 
+#include <algorithm>
+
 #include <fc/variant.hpp>
 #include <eosio/trace_api/metadata_log.hpp>
 #include <eosio/trace_api/data_log.hpp>
 #include <eosio/trace_api/common.hpp>
+#include <eosio/trace_api/lru_cache.hpp>
 
 namespace eosio::trace_api {
    using data_handler_function = std::function<fc::variant(const action_trace_v0&, const yield_function&)>;
+   /// calls its second argument for every index below the first, possibly on several threads, returning when all have
+   using parallel_for_function = std::function<void(size_t, const std::function<void(size_t)>&)>;
 
    namespace detail {
       class response_formatter {
       public:
-         static fc::variant process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield );
+         /// the data of the actions is decoded through parallel_for when it is set, and serially otherwise
+         static fc::variant process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield,
+                                           const parallel_for_function& parallel_for = {} );
+         static fc::variant process_transaction( const transaction_trace_v0& trace, const block_trace_v0& block, bool irreversible, const data_handler_function& data_handler, const yield_function& yield,
+                                                 const parallel_for_function& parallel_for = {} );
       };
    }
 
    template<typename LogfileProvider, typename DataHandlerProvider>
    class request_handler {
    public:
-      request_handler(LogfileProvider&& logfile_provider, DataHandlerProvider&& data_handler_provider)
+      /**
+       * @param response_cache_size - number of formatted block responses retained, 0 disables the cache
+       * @param parallel_for - fans out the decoding of action data, which must then be safe to call concurrently
+       */
+      request_handler(LogfileProvider&& logfile_provider, DataHandlerProvider&& data_handler_provider, size_t response_cache_size = 0,
+                      parallel_for_function parallel_for = {})
       :logfile_provider(std::move(logfile_provider))
       ,data_handler_provider(std::move(data_handler_provider))
+      ,response_cache(response_cache_size)
+      ,parallel_for(std::move(parallel_for))
       {
       }
 
@@ -36,6 +52,11 @@ namespace eosio::trace_api {
        * @throws bad_data_exception when there are issues with the underlying data preventing processing.
        */
       fc::variant get_block_trace( uint32_t block_height, const yield_function& yield = {}) {
+         // an irreversible trace never changes, so it is served without reading the store at all
+         if (auto cached = response_cache.get(response_key(block_height, true))) {
+            return cached->response;
+         }
+
          auto data = logfile_provider.get_block(block_height, yield);
          if (!data) {
             return {};
@@ -43,16 +64,77 @@ namespace eosio::trace_api {
 
          yield();
 
+         const auto& trace = std::get<0>(*data);
+         const bool irreversible = std::get<1>(*data);
+         const auto key = response_key(block_height, irreversible);
+         if (!irreversible) {
+            // a pending block can be replaced by a fork, only reuse the response if it is for the same block
+            auto cached = response_cache.get(key);
+            if (cached && cached->id == trace.id) {
+               return cached->response;
+            }
+         }
+
+         auto data_handler = [this](const action_trace_v0& action, const yield_function& yield) -> fc::variant {
+            return data_handler_provider.process_data(action, yield);
+         };
+
+         auto response = detail::response_formatter::process_block(trace, irreversible, data_handler, yield, parallel_for);
+         response_cache.put(key, cached_response{trace.id, response});
+         if (irreversible) {
+            response_cache.erase(response_key(block_height, false));
+         }
+         return response;
+      }
+
+      /**
+       * Fetch the trace for a given transaction and convert it to a fc::variant for conversion to a final format
+       * (eg JSON)
+       *
+       * @param trx_id - the id of the transaction whose trace is requested
+       * @param yield - a yield function to allow cooperation during long running tasks
+       * @return a properly formatted variant representing the trace and the block of the given transaction if it
+       * exists, an empty variant otherwise.
+       * @throws yield_exception if a call to `yield` throws.
+       * @throws bad_data_exception when there are issues with the underlying data preventing processing.
+       */
+      fc::variant get_transaction_trace( const chain::transaction_id_type& trx_id, const yield_function& yield = {}) {
+         auto data = logfile_provider.get_transaction_block(trx_id, yield);
+         if (!data) {
+            return {};
+         }
+
+         yield();
+
+         const auto& block = std::get<0>(*data);
+         const auto itr = std::find_if(block.transactions.begin(), block.transactions.end(), [&trx_id](const auto& t) {
+            return t.id == trx_id;
+         });
+         if (itr == block.transactions.end()) {
+            return {};
+         }
+
          auto data_handler = [this](const action_trace_v0& action, const yield_function& yield) -> fc::variant {
             return data_handler_provider.process_data(action, yield);
          };
 
-         return detail::response_formatter::process_block(std::get<0>(*data), std::get<1>(*data), data_handler, yield);
+         return detail::response_formatter::process_transaction(*itr, block, std::get<1>(*data), data_handler, yield, parallel_for);
       }
 
    private:
+      struct cached_response {
+         chain::block_id_type id;
+         fc::variant          response;
+      };
+
+      static uint64_t response_key( uint32_t block_height, bool irreversible ) {
+         return (static_cast<uint64_t>(block_height) << 1) | irreversible;
+      }
+
       LogfileProvider logfile_provider;
       DataHandlerProvider data_handler_provider;
+      lru_cache<uint64_t, cached_response> response_cache;
+      parallel_for_function parallel_for;
    };
 
 
@@ -4,12 +4,19 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <deque>
+#include <exception>
+#include <future>
+#include <map>
+#include <unordered_map>
+#include <variant>
 #include <fc/io/cfile.hpp>
 #include <boost/filesystem.hpp>
 #include <fc/variant.hpp>
 #include <eosio/trace_api/common.hpp>
 #include <eosio/trace_api/metadata_log.hpp>
 #include <eosio/trace_api/data_log.hpp>
+#include <eosio/trace_api/action_columns.hpp>
 #include <eosio/trace_api/compressed_file.hpp>
 
 namespace eosio::trace_api {
@@ -60,15 +67,18 @@ namespace eosio::trace_api {
     *
     * @param entry : the entry to append
     * @param file : the file to append entry to
+    * @param sync : flush and sync the file after writing, otherwise the caller is responsible for it
     * @return the offset in the file where that entry is written
     */
    template<typename DataEntry, typename File>
-   static uint64_t append_store(const DataEntry &entry, File &file) {
+   static uint64_t append_store(const DataEntry &entry, File &file, bool sync = true) {
       auto data = fc::raw::pack(entry);
       const auto offset = file.tellp();
       file.write(data.data(), data.size());
-      file.flush();
-      file.sync();
+      if (sync) {
+         file.flush();
+         file.sync();
+      }
       return offset;
    }
 
@@ -101,7 +111,8 @@ namespace eosio::trace_api {
 
       enum class open_state { read /*read from front to back*/, write /*write to end of file*/ };
       slice_directory(const boost::filesystem::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks,
-                      std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride);
+                      std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride,
+                      size_t maintenance_threads = 1);
 
       /**
        * Return the slice number that would include the passed in block_height
@@ -161,6 +172,61 @@ namespace eosio::trace_api {
        */
       bool find_trace_slice(uint32_t slice_number, open_state state, fc::cfile& trace_file, bool open_file = true) const;
 
+      /**
+       * Find or create the transaction id index file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param trx_id_file : the cfile that will be set to the appropriate slice filename
+       *                      and opened to that file
+       * @return the true if file was found (i.e. already existed)
+       */
+      bool find_or_create_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file) const;
+
+      /**
+       * Find the transaction id index file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param trx_id_file : the cfile that will be set to the appropriate slice filename (always)
+       *                      and opened to that file (if it was found)
+       * @param open_file : indicate if the file should be opened (if found) or not
+       * @return the true if file was found (i.e. already existed), if not found trx_id_file
+       *         is set to the appropriate file, but not open
+       */
+      bool find_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file, bool open_file = true) const;
+
+      /**
+       * Find or create the columnar action export file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param columns_file : the cfile that will be set to the appropriate slice filename
+       *                       and opened to that file
+       * @return the true if file was found (i.e. already existed)
+       */
+      bool find_or_create_action_columns_slice(uint32_t slice_number, open_state state, fc::cfile& columns_file) const;
+
+      /**
+       * Find the columnar action export file associated with the indicated slice_number
+       *
+       * @param slice_number : slice number of the requested slice file
+       * @param state : indicate if the file is going to be written to (appended) or read
+       * @param columns_file : the cfile that will be set to the appropriate slice filename (always)
+       *                       and opened to that file (if it was found)
+       * @param open_file : indicate if the file should be opened (if found) or not
+       * @return the true if file was found (i.e. already existed), if not found columns_file
+       *         is set to the appropriate file, but not open
+       */
+      bool find_action_columns_slice(uint32_t slice_number, open_state state, fc::cfile& columns_file, bool open_file = true) const;
+
+      /**
+       * List the slice numbers which have a transaction id index file
+       *
+       * @return the slice numbers, newest first
+       */
+      std::vector<uint32_t> find_trx_id_slice_numbers() const;
+
       /**
        * Find the read-only compressed trace file associated with the indicated slice_number
        *
@@ -200,7 +266,7 @@ namespace eosio::trace_api {
 
       /**
        * Cleans up all slices that are no longer needed to maintain the minimum number of blocks past lib
-       * Compresses up all slices that can be compressed
+       * Compresses up all slices that can be compressed, up to maintenance_threads slices at a time
        *
        * @param lib : block number of the current lib
        */
@@ -221,6 +287,9 @@ namespace eosio::trace_api {
       template<typename F>
       void process_irreversible_slice_range(uint32_t lib, uint32_t upper_bound_block, std::optional<uint32_t>& lower_bound_slice, F&& f);
 
+      // compress a slice's trace file using the given number of threads for its seek point segments, then remove it
+      void compress_slice(uint32_t slice_to_compress, size_t threads, const log_handler& log) const;
+
       const boost::filesystem::path _slice_dir;
       const uint32_t _width;
       const std::optional<uint32_t> _minimum_irreversible_history_blocks;
@@ -228,6 +297,7 @@ namespace eosio::trace_api {
       const std::optional<uint32_t> _minimum_uncompressed_irreversible_history_blocks;
       std::optional<uint32_t> _last_compressed_slice;
       const size_t _compression_seek_point_stride;
+      const size_t _maintenance_threads;
 
       std::atomic<uint32_t> _best_known_lib{0};
       std::mutex _maintenance_mtx;
@@ -244,11 +314,43 @@ namespace eosio::trace_api {
       using open_state = slice_directory::open_state;
 
       store_provider(const boost::filesystem::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks,
-            std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride);
+            std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride,
+            size_t maintenance_threads = 1);
 
+      /**
+       * Append a block trace, or queue it for the writer thread if it is running.
+       * Blocks the caller while the writer thread has max_queued_writes entries pending.
+       * Once the writer thread has failed, rethrows its failure: the entries it had queued were not written.
+       */
       void append(const block_trace_v0& bt);
+      /**
+       * Append a LIB marker, or queue it behind the pending block traces if the writer thread is running.
+       * Maintenance only learns of the new LIB once the marker is written. Rethrows a failure of the writer thread.
+       */
       void append_lib(uint32_t lib);
 
+      /**
+       * Also write every group of appended block traces as a row group of action_columns_v0 to the slice's
+       * columnar action export file. Only to be set before anything is appended.
+       */
+      void set_columnar_export(bool enabled) { _columnar_export = enabled; }
+
+      /**
+       * Start a thread which writes the appended entries in groups: entries appended within group_interval of the
+       * first pending one are written together and share one flush and sync of each file they touch.
+       * Until the group is synced its entries are not visible to readers.
+       *
+       * @param group_interval : how long the first entry of a group may wait for others
+       * @param max_queued_writes : bound of pending entries before append blocks
+       * @param except_handler : called with the failure which stops the writer thread, later appends rethrow it
+       */
+      void start_writer_thread( fc::microseconds group_interval, size_t max_queued_writes, exception_handler except_handler );
+
+      /**
+       * Write the pending entries, then stop and join the writer thread
+       */
+      void stop_writer_thread();
+
       /**
        * Read the trace for a given block
        * @param block_height : the height of the data being read
@@ -257,6 +359,15 @@ namespace eosio::trace_api {
        */
       get_block_t get_block(uint32_t block_height, const yield_function& yield= {});
 
+      /**
+       * Read the trace of the block holding a given transaction, looking it up in the transaction id index of every
+       * slice from newest to oldest. Blocks which have since been forked out are skipped.
+       * @param trx_id : the id of the transaction
+       * @return empty optional if no block holding the transaction can be read OTHERWISE
+       *         optional containing a 2-tuple of the block_trace and a flag indicating irreversibility
+       */
+      get_block_t get_transaction_block(const chain::transaction_id_type& trx_id, const yield_function& yield= {});
+
       void start_maintenance_thread( log_handler log ) {
          _slice_directory.start_maintenance_thread( std::move(log) );
       }
@@ -266,6 +377,13 @@ namespace eosio::trace_api {
 
 
       protected:
+      /**
+       * Find the latest trace offset of a block in its metadata log
+       * @param block_height : height of the requested block
+       * @return 2-tuple of the offset of the block in the trace file, if present, and a flag indicating irreversibility
+       */
+      std::tuple<std::optional<uint64_t>, bool> find_block_offset(uint32_t block_height, const yield_function& yield);
+
       /**
        * Read the metadata log font-to-back starting at an offset passing each entry to a provided functor/lambda
        *
@@ -351,6 +469,42 @@ namespace eosio::trace_api {
       void validate_existing_index_slice_file(fc::cfile& index, open_state state);
 
       slice_directory _slice_directory;
+
+   private:
+      using queued_write = std::variant<block_trace_v0, lib_entry_v0>;
+
+      /**
+       * Write a group of entries in order and sync them. Trace files are synced before any index entry referencing
+       * them is written, LIB markers are only passed to maintenance once synced.
+       */
+      void write_group(const std::deque<queued_write>& group);
+
+      /**
+       * In memory index of one trace_trx_ slice file, mapping the truncated transaction ids to the blocks holding
+       * them in append order. Extended with the runs appended since the last lookup.
+       */
+      struct trx_id_slice_index {
+         uint64_t indexed_to = 0; ///< file offset of the first run not indexed yet, 0 before the header is read
+         std::unordered_map<uint64_t, std::vector<std::tuple<uint32_t, uint64_t>>> blocks;
+      };
+
+      /// the blocks, latest last, whose runs in the slice hold the truncated id
+      std::vector<std::tuple<uint32_t, uint64_t>> find_trx_id_candidates(uint32_t slice_number, uint64_t truncated_id, const yield_function& yield);
+
+      std::mutex                                  _trx_id_index_mtx;
+      std::map<uint32_t, trx_id_slice_index>      _trx_id_index;
+
+      std::mutex                 _write_mtx;
+      std::condition_variable    _write_ready;
+      std::condition_variable    _write_space;
+      std::deque<queued_write>   _write_queue;
+      std::thread                _write_thread;
+      bool                       _writer_running = false;
+      bool                       _writer_shutdown = false;
+      std::exception_ptr         _write_error; ///< the failure which stopped the writer thread
+      fc::microseconds           _group_interval;
+      size_t                     _max_queued_writes = 0;
+      bool                       _columnar_export = false;
    };
 
 }
@@ -27,7 +27,31 @@ namespace {
 
    }
 
-   fc::variants process_actions(const std::vector<action_trace_v0>& actions, const data_handler_function& data_handler, const yield_function& yield ) {
+   /// the decoded data of every action of transactions, in order, the slowest part of formatting a large block
+   std::vector<fc::variant> decode_actions( const std::vector<const std::vector<action_trace_v0>*>& transactions, const data_handler_function& data_handler,
+                                            const yield_function& yield, const parallel_for_function& parallel_for ) {
+      std::vector<const action_trace_v0*> actions;
+      for ( const auto* t: transactions) {
+         for ( const auto& a: *t) {
+            actions.push_back(&a);
+         }
+      }
+
+      std::vector<fc::variant> result(actions.size());
+      const auto decode = [&](size_t i) {
+         result[i] = data_handler(*actions[i], yield);
+      };
+      if (parallel_for) {
+         parallel_for(actions.size(), decode);
+      } else {
+         for (size_t i = 0; i < actions.size(); ++i) {
+            decode(i);
+         }
+      }
+      return result;
+   }
+
+   fc::variants process_actions(const std::vector<action_trace_v0>& actions, const fc::variant* decoded, const yield_function& yield ) {
       fc::variants result;
       result.reserve(actions.size());
 
@@ -49,7 +73,7 @@ namespace {
                ("authorization", process_authorizations(a.authorization, yield))
                ("data", fc::to_hex(a.data.data(), a.data.size()));
 
-         auto params = data_handler(a, yield);
+         const auto& params = decoded[index];
          if (!params.is_null()) {
             action_variant("params", params);
          }
@@ -61,16 +85,26 @@ namespace {
 
    }
 
-   fc::variants process_transactions(const std::vector<transaction_trace_v0>& transactions, const data_handler_function& data_handler, const yield_function& yield ) {
+   fc::variants process_transactions(const std::vector<transaction_trace_v0>& transactions, const data_handler_function& data_handler, const yield_function& yield,
+                                     const parallel_for_function& parallel_for ) {
+      std::vector<const std::vector<action_trace_v0>*> action_lists;
+      action_lists.reserve(transactions.size());
+      for ( const auto& t: transactions) {
+         action_lists.push_back(&t.actions);
+      }
+      const auto decoded = decode_actions(action_lists, data_handler, yield, parallel_for);
+
       fc::variants result;
       result.reserve(transactions.size());
+      size_t offset = 0;
       for ( const auto& t: transactions) {
          yield();
 
          result.emplace_back(fc::mutable_variant_object()
             ("id", t.id.str())
-            ("actions", process_actions(t.actions, data_handler, yield))
+            ("actions", process_actions(t.actions, decoded.data() + offset, yield))
          );
+         offset += t.actions.size();
       }
 
       return result;
@@ -79,7 +113,8 @@ namespace {
 }
 
 namespace eosio::trace_api::detail {
-   fc::variant response_formatter::process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield ) {
+   fc::variant response_formatter::process_block( const block_trace_v0& trace, bool irreversible, const data_handler_function& data_handler, const yield_function& yield,
+                                                  const parallel_for_function& parallel_for ) {
       return fc::mutable_variant_object()
          ("id", trace.id.str() )
          ("number", trace.number )
@@ -87,6 +122,19 @@ namespace eosio::trace_api::detail {
          ("status", irreversible ? "irreversible" : "pending" )
          ("timestamp", to_iso8601_datetime(trace.timestamp))
          ("producer", trace.producer.to_string())
-         ("transactions", process_transactions(trace.transactions, data_handler, yield ));
+         ("transactions", process_transactions(trace.transactions, data_handler, yield, parallel_for ));
+   }
+
+   fc::variant response_formatter::process_transaction( const transaction_trace_v0& trace, const block_trace_v0& block, bool irreversible, const data_handler_function& data_handler, const yield_function& yield,
+                                                        const parallel_for_function& parallel_for ) {
+      const auto decoded = decode_actions({&trace.actions}, data_handler, yield, parallel_for);
+      return fc::mutable_variant_object()
+         ("id", trace.id.str() )
+         ("block_number", block.number )
+         ("block_id", block.id.str() )
+         ("status", irreversible ? "irreversible" : "pending" )
+         ("timestamp", to_iso8601_datetime(block.timestamp))
+         ("producer", block.producer.to_string())
+         ("actions", process_actions(trace.actions, decoded.data(), yield ));
    }
 }
@@ -7,6 +7,8 @@ namespace {
       static constexpr uint32_t _current_version = 1;
       static constexpr const char* _trace_prefix = "trace_";
       static constexpr const char* _trace_index_prefix = "trace_index_";
+      static constexpr const char* _trace_trx_id_prefix = "trace_trx_";
+      static constexpr const char* _trace_actions_prefix = "trace_actions_";
       static constexpr const char* _trace_ext = ".log";
       static constexpr const char* _compressed_trace_ext = ".clog";
       static constexpr uint _max_filename_size = std::char_traits<char>::length(_trace_index_prefix) + 10 + 1 + 10 + std::char_traits<char>::length(_compressed_trace_ext) + 1; // "trace_index_" + 10-digits + '-' + 10-digits + ".clog" + null-char
@@ -30,35 +32,194 @@ namespace {
 
 namespace eosio::trace_api {
    namespace bfs = boost::filesystem;
-   store_provider::store_provider(const bfs::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride)
-   : _slice_directory(slice_dir, stride_width, minimum_irreversible_history_blocks, minimum_uncompressed_irreversible_history_blocks, compression_seek_point_stride) {
+   store_provider::store_provider(const bfs::path& slice_dir, uint32_t stride_width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride, size_t maintenance_threads)
+   : _slice_directory(slice_dir, stride_width, minimum_irreversible_history_blocks, minimum_uncompressed_irreversible_history_blocks, compression_seek_point_stride, maintenance_threads) {
    }
 
    void store_provider::append(const block_trace_v0& bt) {
-      fc::cfile trace;
-      fc::cfile index;
-      const uint32_t slice_number = _slice_directory.slice_number(bt.number);
-      _slice_directory.find_or_create_slice_pair(slice_number, open_state::write, trace, index);
-      // storing as static_variant to allow adding other data types to the trace file in the future
-      const uint64_t offset = append_store(data_log_entry { bt }, trace);
-
-      auto be = metadata_log_entry { block_entry_v0 { .id = bt.id, .number = bt.number, .offset = offset }};
-      append_store(be, index);
+      std::unique_lock<std::mutex> lock(_write_mtx);
+      _write_space.wait(lock, [this]() { return !_writer_running || _write_queue.size() < _max_queued_writes; });
+      if (_write_error) {
+         std::rethrow_exception(_write_error);
+      }
+      if (!_writer_running) {
+         lock.unlock();
+         write_group({ queued_write{ bt } });
+         return;
+      }
+      _write_queue.emplace_back(bt);
+      _write_ready.notify_one();
    }
 
    void store_provider::append_lib(uint32_t lib) {
-      fc::cfile index;
-      const uint32_t slice_number = _slice_directory.slice_number(lib);
-      _slice_directory.find_or_create_index_slice(slice_number, open_state::write, index);
-      auto le = metadata_log_entry { lib_entry_v0 { .lib = lib }};
-      append_store(le, index);
-      _slice_directory.set_lib(lib);
+      std::unique_lock<std::mutex> lock(_write_mtx);
+      if (_write_error) {
+         std::rethrow_exception(_write_error);
+      }
+      if (!_writer_running) {
+         lock.unlock();
+         write_group({ queued_write{ lib_entry_v0 { .lib = lib } } });
+         return;
+      }
+      // LIB markers are small and must stay ordered behind the block traces, so they do not wait for space
+      _write_queue.emplace_back(lib_entry_v0 { .lib = lib });
+      _write_ready.notify_one();
    }
 
-   get_block_t store_provider::get_block(uint32_t block_height, const yield_function& yield) {
+   void store_provider::write_group(const std::deque<queued_write>& group) {
+      struct slice_files {
+         fc::cfile trace;
+         fc::cfile index;
+         fc::cfile trx_ids;
+         fc::cfile action_columns;
+         action_columns_v0 columns;
+      };
+      std::map<uint32_t, slice_files> slices;
+      auto flush_and_sync = [](fc::cfile& f) {
+         if (f.is_open()) {
+            f.flush();
+            f.sync();
+         }
+      };
+
+      // index entries are held back until the trace data they point to is synced
+      std::vector<std::tuple<uint32_t, metadata_log_entry>> index_entries;
+      std::vector<std::tuple<uint32_t, trx_id_entry_v0>> trx_id_entries;
+      std::optional<uint32_t> last_lib;
+      for (const auto& w : group) {
+         if (std::holds_alternative<block_trace_v0>(w)) {
+            const auto& bt = std::get<block_trace_v0>(w);
+            const uint32_t slice_number = _slice_directory.slice_number(bt.number);
+            auto& files = slices[slice_number];
+            if (!files.trace.is_open()) {
+               if (!files.index.is_open()) {
+                  _slice_directory.find_or_create_slice_pair(slice_number, open_state::write, files.trace, files.index);
+               } else {
+                  _slice_directory.find_or_create_trace_slice(slice_number, open_state::write, files.trace);
+               }
+            }
+            // storing as static_variant to allow adding other data types to the trace file in the future
+            const uint64_t offset = append_store(data_log_entry { bt }, files.trace, false);
+
+            index_entries.emplace_back(slice_number, block_entry_v0 { .id = bt.id, .number = bt.number, .offset = offset });
+
+            auto te = trx_id_entry_v0 { .number = bt.number, .offset = offset };
+            te.ids.reserve(bt.transactions.size());
+            for (const auto& t : bt.transactions) {
+               te.ids.push_back(trx_id_entry_v0::truncate_id(t.id));
+            }
+            std::sort(te.ids.begin(), te.ids.end());
+            te.ids.erase(std::unique(te.ids.begin(), te.ids.end()), te.ids.end());
+            trx_id_entries.emplace_back(slice_number, std::move(te));
+
+            if (_columnar_export) {
+               files.columns.append(bt);
+            }
+         } else {
+            const uint32_t lib = std::get<lib_entry_v0>(w).lib;
+            index_entries.emplace_back(_slice_directory.slice_number(lib), lib_entry_v0 { .lib = lib });
+            last_lib = lib;
+         }
+      }
+
+      for (auto& [slice_number, files] : slices) {
+         flush_and_sync(files.trace);
+      }
+
+      for (const auto& [slice_number, entry] : index_entries) {
+         auto& files = slices[slice_number];
+         if (!files.index.is_open()) {
+            _slice_directory.find_or_create_index_slice(slice_number, open_state::write, files.index);
+         }
+         append_store(entry, files.index, false);
+      }
+      for (const auto& [slice_number, entry] : trx_id_entries) {
+         auto& files = slices[slice_number];
+         if (!files.trx_ids.is_open()) {
+            _slice_directory.find_or_create_trx_id_slice(slice_number, open_state::write, files.trx_ids);
+         }
+         append_store(entry, files.trx_ids, false);
+      }
+
+      for (auto& [slice_number, files] : slices) {
+         if (files.columns.size() == 0) {
+            continue;
+         }
+         _slice_directory.find_or_create_action_columns_slice(slice_number, open_state::write, files.action_columns);
+         append_store(files.columns, files.action_columns, false);
+      }
+
+      for (auto& [slice_number, files] : slices) {
+         flush_and_sync(files.index);
+         flush_and_sync(files.trx_ids);
+         flush_and_sync(files.action_columns);
+      }
+
+      if (last_lib) {
+         _slice_directory.set_lib(*last_lib);
+      }
+   }
+
+   void store_provider::start_writer_thread(fc::microseconds group_interval, size_t max_queued_writes, exception_handler except_handler) {
+      {
+         std::lock_guard<std::mutex> lock(_write_mtx);
+         _group_interval = group_interval;
+         _max_queued_writes = std::max<size_t>(max_queued_writes, 1);
+         _writer_shutdown = false;
+         _writer_running = true;
+      }
+      _write_thread = std::thread([this, except_handler=std::move(except_handler)]() {
+         fc::set_os_thread_name("trace-writer");
+         std::unique_lock<std::mutex> lock(_write_mtx);
+         while (true) {
+            _write_ready.wait(lock, [this]() { return !_write_queue.empty() || _writer_shutdown; });
+            if (_write_queue.empty()) {
+               break;
+            }
+
+            // let the group fill up for the rest of the interval, unless the queue is already full or shutting down
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(_group_interval.count());
+            _write_ready.wait_until(lock, deadline, [this]() {
+               return _write_queue.size() >= _max_queued_writes || _writer_shutdown;
+            });
+
+            std::deque<queued_write> group;
+            group.swap(_write_queue);
+            _write_space.notify_all();
+            lock.unlock();
+            try {
+               write_group(group);
+            } catch (...) {
+               lock.lock();
+               _write_error = std::current_exception();
+               _writer_running = false;
+               _write_queue.clear();
+               _write_space.notify_all();
+               lock.unlock();
+               except_handler(MAKE_EXCEPTION_WITH_CONTEXT(std::current_exception()));
+               return;
+            }
+            lock.lock();
+         }
+         _writer_running = false;
+      });
+   }
+
+   void store_provider::stop_writer_thread() {
+      {
+         std::lock_guard<std::mutex> lock(_write_mtx);
+         _writer_shutdown = true;
+      }
+      _write_ready.notify_one();
+      if (_write_thread.joinable()) {
+         _write_thread.join();
+      }
+   }
+
+   std::tuple<std::optional<uint64_t>, bool> store_provider::find_block_offset(uint32_t block_height, const yield_function& yield) {
       std::optional<uint64_t> trace_offset;
       bool irreversible = false;
-      uint64_t offset = scan_metadata_log_from(block_height, 0, [&block_height, &trace_offset, &irreversible](const metadata_log_entry& e) -> bool {
+      scan_metadata_log_from(block_height, 0, [&block_height, &trace_offset, &irreversible](const metadata_log_entry& e) -> bool {
          if (e.contains<block_entry_v0>()) {
             const auto& block = e.get<block_entry_v0>();
             if (block.number == block_height) {
@@ -73,6 +234,11 @@ namespace eosio::trace_api {
          }
          return true;
       }, yield);
+      return std::make_tuple(trace_offset, irreversible);
+   }
+
+   get_block_t store_provider::get_block(uint32_t block_height, const yield_function& yield) {
+      const auto [trace_offset, irreversible] = find_block_offset(block_height, yield);
       if (!trace_offset) {
          return get_block_t{};
       }
@@ -84,12 +250,86 @@ namespace eosio::trace_api {
       return std::make_tuple( bt, irreversible );
    }
 
-   slice_directory::slice_directory(const bfs::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride)
+   get_block_t store_provider::get_transaction_block(const chain::transaction_id_type& trx_id, const yield_function& yield) {
+      const uint64_t truncated_id = trx_id_entry_v0::truncate_id(trx_id);
+      const auto slice_numbers = _slice_directory.find_trx_id_slice_numbers();
+      {
+         // forget the slices removed by maintenance
+         std::lock_guard<std::mutex> g(_trx_id_index_mtx);
+         for (auto itr = _trx_id_index.begin(); itr != _trx_id_index.end();) {
+            if (std::find(slice_numbers.begin(), slice_numbers.end(), itr->first) == slice_numbers.end()) {
+               itr = _trx_id_index.erase(itr);
+            } else {
+               ++itr;
+            }
+         }
+      }
+
+      for (uint32_t slice_number : slice_numbers) {
+         const auto candidates = find_trx_id_candidates(slice_number, truncated_id, yield);
+         for (auto itr = candidates.rbegin(); itr != candidates.rend(); ++itr) {
+            const auto [number, offset] = *itr;
+            // only the latest trace of a block number is part of the chain
+            const auto [trace_offset, irreversible] = find_block_offset(number, yield);
+            if (!trace_offset || *trace_offset != offset) {
+               continue;
+            }
+            std::optional<data_log_entry> entry = read_data_log(number, offset);
+            if (!entry) {
+               continue;
+            }
+            const auto& bt = entry->get<block_trace_v0>();
+            const bool found = std::any_of(bt.transactions.begin(), bt.transactions.end(), [&trx_id](const auto& t) {
+               return t.id == trx_id;
+            });
+            if (found) {
+               return std::make_tuple( bt, irreversible );
+            }
+         }
+      }
+      return get_block_t{};
+   }
+
+   std::vector<std::tuple<uint32_t, uint64_t>> store_provider::find_trx_id_candidates(uint32_t slice_number, uint64_t truncated_id, const yield_function& yield) {
+      std::lock_guard<std::mutex> g(_trx_id_index_mtx);
+      auto& index = _trx_id_index[slice_number];
+
+      fc::cfile trx_ids;
+      if (!_slice_directory.find_trx_id_slice(slice_number, open_state::read, trx_ids)) {
+         _trx_id_index.erase(slice_number);
+         return {};
+      }
+      if (index.indexed_to == 0) {
+         index.indexed_to = trx_ids.tellp();
+      }
+      const uint64_t end = file_size(trx_ids.get_file_path());
+      if (index.indexed_to < end) {
+         trx_ids.seek(index.indexed_to);
+         // a block is appended again for every fork switch, so every run is kept in append order
+         while (index.indexed_to < end) {
+            yield();
+            const auto te = extract_store<trx_id_entry_v0>(trx_ids);
+            for (uint64_t id : te.ids) {
+               index.blocks[id].emplace_back(te.number, te.offset);
+            }
+            index.indexed_to = trx_ids.tellp();
+         }
+      }
+
+      auto itr = index.blocks.find(truncated_id);
+      if (itr == index.blocks.end()) {
+         return {};
+      }
+      return itr->second;
+   }
+
+   slice_directory::slice_directory(const bfs::path& slice_dir, uint32_t width, std::optional<uint32_t> minimum_irreversible_history_blocks, std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks, size_t compression_seek_point_stride, size_t maintenance_threads)
    : _slice_dir(slice_dir)
    , _width(width)
    , _minimum_irreversible_history_blocks(minimum_irreversible_history_blocks)
    , _minimum_uncompressed_irreversible_history_blocks(minimum_uncompressed_irreversible_history_blocks)
    , _compression_seek_point_stride(compression_seek_point_stride)
+   , _maintenance_threads(std::max<size_t>(maintenance_threads, 1))
    , _best_known_lib(0) {
       if (!exists(_slice_dir)) {
          bfs::create_directories(slice_dir);
@@ -158,6 +398,63 @@ namespace eosio::trace_api {
       return true;
    }
 
+   bool slice_directory::find_or_create_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file) const {
+      const bool found = find_trx_id_slice(slice_number, state, trx_id_file);
+      if( !found ) {
+         create_new_index_slice_file(trx_id_file);
+      }
+      return found;
+   }
+
+   bool slice_directory::find_trx_id_slice(uint32_t slice_number, open_state state, fc::cfile& trx_id_file, bool open_file) const {
+      const bool found = find_slice(_trace_trx_id_prefix, slice_number, trx_id_file, open_file);
+      if( !found || !open_file ) {
+         return found;
+      }
+
+      // shares the versioned header of the index files
+      validate_existing_index_slice_file(trx_id_file, state);
+      return true;
+   }
+
+   bool slice_directory::find_or_create_action_columns_slice(uint32_t slice_number, open_state state, fc::cfile& columns_file) const {
+      const bool found = find_action_columns_slice(slice_number, state, columns_file);
+      if( !found ) {
+         create_new_index_slice_file(columns_file);
+      }
+      return found;
+   }
+
+   bool slice_directory::find_action_columns_slice(uint32_t slice_number, open_state state, fc::cfile& columns_file, bool open_file) const {
+      const bool found = find_slice(_trace_actions_prefix, slice_number, columns_file, open_file);
+      if( !found || !open_file ) {
+         return found;
+      }
+
+      // shares the versioned header of the index files
+      validate_existing_index_slice_file(columns_file, state);
+      return true;
+   }
+
+   std::vector<uint32_t> slice_directory::find_trx_id_slice_numbers() const {
+      std::vector<uint32_t> slice_numbers;
+      const std::string prefix = _trace_trx_id_prefix;
+      for (const auto& entry : bfs::directory_iterator(_slice_dir)) {
+         const std::string filename = entry.path().filename().generic_string();
+         if (filename.compare(0, prefix.size(), prefix) != 0 || entry.path().extension() != _trace_ext) {
+            continue;
+         }
+         try {
+            const uint32_t slice_start = std::stoul(filename.substr(prefix.size(), 10));
+            slice_numbers.push_back(slice_number(slice_start));
+         } catch (const std::exception&) {
+            // not a slice file
+         }
+      }
+      std::sort(slice_numbers.rbegin(), slice_numbers.rend());
+      return slice_numbers;
+   }
+
    std::optional<compressed_file> slice_directory::find_compressed_trace_slice(uint32_t slice_number, bool open_file ) const {
       auto filename = make_filename(_trace_prefix, _compressed_trace_ext, slice_number, _width);
       const path slice_path = _slice_dir / filename;
@@ -282,6 +579,20 @@ namespace eosio::trace_api {
                bfs::remove(trace.get_file_path());
             }
 
+            fc::cfile trx_ids;
+            const bool trx_ids_found = find_trx_id_slice(slice_to_clean, open_state::read, trx_ids, dont_open_file);
+            if (trx_ids_found) {
+               log(std::string("Removing: ") + trx_ids.get_file_path().generic_string());
+               bfs::remove(trx_ids.get_file_path());
+            }
+
+            fc::cfile action_columns;
+            const bool action_columns_found = find_action_columns_slice(slice_to_clean, open_state::read, action_columns, dont_open_file);
+            if (action_columns_found) {
+               log(std::string("Removing: ") + action_columns.get_file_path().generic_string());
+               bfs::remove(action_columns.get_file_path());
+            }
+
             auto ctrace = find_compressed_trace_slice(slice_to_clean, dont_open_file);
             if (ctrace) {
                log(std::string("Removing: ") + ctrace->get_file_path().generic_string());
@@ -295,25 +606,62 @@ namespace eosio::trace_api {
       if (_minimum_uncompressed_irreversible_history_blocks &&
           (!_minimum_irreversible_history_blocks || *_minimum_uncompressed_irreversible_history_blocks < *_minimum_irreversible_history_blocks) )
       {
-         process_irreversible_slice_range(lib, *_minimum_uncompressed_irreversible_history_blocks, _last_compressed_slice, [this, &log](uint32_t slice_to_compress){
-            fc::cfile trace;
-            const bool dont_open_file = false;
-            const bool trace_found = find_trace_slice(slice_to_compress, open_state::read, trace, dont_open_file);
+         // collect the slices first so that they can be compressed concurrently, the last compressed slice is only
+         // advanced past a batch once all of its slices are compressed so a failed slice is retried on the next pass
+         std::vector<uint32_t> slices_to_compress;
+         auto next_compressed_slice = _last_compressed_slice;
+         process_irreversible_slice_range(lib, *_minimum_uncompressed_irreversible_history_blocks, next_compressed_slice, [&slices_to_compress](uint32_t slice_to_compress){
+            slices_to_compress.push_back(slice_to_compress);
+         });
 
-            log(std::string("Attempting compression of slice: ") + std::to_string(slice_to_compress));
+         for (size_t first = 0; first < slices_to_compress.size() && !_maintenance_shutdown; first += _maintenance_threads) {
+            const size_t batch_size = std::min(_maintenance_threads, slices_to_compress.size() - first);
+            if (batch_size == 1) {
+               // a single slice gets all of the threads for its seek point segments
+               compress_slice(slices_to_compress[first], _maintenance_threads, log);
+            } else {
+               std::vector<std::future<void>> batch;
+               batch.reserve(batch_size);
+               for (size_t i = first; i < first + batch_size; ++i) {
+                  batch.emplace_back(std::async(std::launch::async, [this, &log, slice = slices_to_compress[i]]() {
+                     compress_slice(slice, 1, log);
+                  }));
+               }
+               // wait on every slice before surfacing the first failure
+               std::exception_ptr failure;
+               for (auto& f : batch) {
+                  try {
+                     f.get();
+                  } catch (...) {
+                     if (!failure)
+                        failure = std::current_exception();
+                  }
+               }
+               if (failure)
+                  std::rethrow_exception(failure);
+            }
+            _last_compressed_slice = slices_to_compress[first + batch_size - 1];
+         }
+      }
+   }
 
-            if (trace_found) {
-               auto compressed_path = trace.get_file_path();
-               compressed_path.replace_extension(_compressed_trace_ext);
+   void slice_directory::compress_slice(uint32_t slice_to_compress, size_t threads, const log_handler& log) const {
+      fc::cfile trace;
+      const bool dont_open_file = false;
+      const bool trace_found = find_trace_slice(slice_to_compress, open_state::read, trace, dont_open_file);
 
-               log(std::string("Compressing: ") + trace.get_file_path().generic_string());
-               compressed_file::process(trace.get_file_path(), compressed_path.generic_string(), _compression_seek_point_stride);
+      log(std::string("Attempting compression of slice: ") + std::to_string(slice_to_compress));
 
-               // after compression is complete, delete the old uncompressed file
-               log(std::string("Removing: ") + trace.get_file_path().generic_string());
-               bfs::remove(trace.get_file_path());
-            }
-         });
+      if (trace_found) {
+         auto compressed_path = trace.get_file_path();
+         compressed_path.replace_extension(_compressed_trace_ext);
+
+         log(std::string("Compressing: ") + trace.get_file_path().generic_string());
+         compressed_file::process(trace.get_file_path(), compressed_path.generic_string(), _compression_seek_point_stride, threads);
+
+         // after compression is complete, delete the old uncompressed file
+         log(std::string("Removing: ") + trace.get_file_path().generic_string());
+         bfs::remove(trace.get_file_path());
       }
    }
 }
@@ -176,6 +176,45 @@ BOOST_FIXTURE_TEST_CASE_TEMPLATE(blob_access, T, test_types, temp_file_fixture)
    }
 }
 
+BOOST_FIXTURE_TEST_CASE_TEMPLATE(parallel_compression, T, test_types, temp_file_fixture) {
+   auto data = std::vector<T>(128);
+   std::generate(data.begin(), data.end(), []() {
+      return make_random<T>();
+   });
+
+   auto uncompressed_filename = create_temp_file(data.data(), data.size() * sizeof(T));
+   auto serial_filename = create_temp_file(nullptr, 0);
+   auto parallel_filename = create_temp_file(nullptr, 0);
+
+   // use a thread count that does not divide the number of seek point segments
+   BOOST_TEST(compressed_file::process(uncompressed_filename, serial_filename, 512));
+   BOOST_TEST(compressed_file::process(uncompressed_filename, parallel_filename, 512, 3));
+
+   // independently compressed segments must still decompress from every seek point and through the end of the file
+   for (int i = 0; i < data.size(); i++) {
+      auto actual_data = std::vector<T>(128);
+      auto compf = compressed_file(parallel_filename);
+      compf.open();
+      compf.seek(i * sizeof(T));
+      compf.read(reinterpret_cast<char*>(actual_data.data()), (actual_data.size() - i) * sizeof(T));
+      compf.close();
+      BOOST_REQUIRE_EQUAL_COLLECTIONS(data.begin() + i, data.end(), actual_data.begin(), actual_data.end() - i);
+   }
+
+   // both forms carry the same number of seek points
+   auto read_seek_point_count = [](const std::string& filename) {
+      fc::cfile compressed;
+      compressed.set_file_path(filename);
+      compressed.open("r");
+      compressed.seek(fc::file_size(filename) - 2);
+      uint16_t count = 0;
+      compressed.read(reinterpret_cast<char*>(&count), 2);
+      compressed.close();
+      return count;
+   };
+   BOOST_REQUIRE_EQUAL(read_seek_point_count(serial_filename), read_seek_point_count(parallel_filename));
+}
+
 BOOST_FIXTURE_TEST_CASE_TEMPLATE(blob_access_no_seek_points, T, test_types, temp_file_fixture) {
    // generate a large dataset where ever 8 bytes is the offset to that 8 bytes of data
    auto data = std::vector<T>(32);
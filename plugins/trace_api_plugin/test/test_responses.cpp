@@ -29,6 +29,10 @@ struct response_test_fixture {
       get_block_t get_block(uint32_t height, const yield_function& yield= {}) {
          return fixture.mock_get_block(height, yield);
       }
+
+      get_block_t get_transaction_block(const chain::transaction_id_type& trx_id, const yield_function& yield= {}) {
+         return fixture.mock_get_transaction_block(trx_id, yield);
+      }
       response_test_fixture& fixture;
    };
 
@@ -63,8 +67,13 @@ struct response_test_fixture {
       return response_impl.get_block_trace( block_height, yield );
    }
 
+   fc::variant get_transaction_trace( const chain::transaction_id_type& trx_id, const yield_function& yield = {} ) {
+      return response_impl.get_transaction_trace( trx_id, yield );
+   }
+
    // fixture data and methods
    std::function<get_block_t(uint32_t, const yield_function&)> mock_get_block;
+   std::function<get_block_t(const chain::transaction_id_type&, const yield_function&)> mock_get_transaction_block;
    std::function<fc::variant(const action_trace_v0&, const yield_function&)> mock_data_handler = default_mock_data_handler;
 
    response_impl_type response_impl;
@@ -323,6 +332,41 @@ BOOST_AUTO_TEST_SUITE(trace_responses)
       BOOST_TEST(to_kv(expected_response) == to_kv(actual_response), boost::test_tools::per_element());
    }
 
+   BOOST_AUTO_TEST_CASE(parallel_decoded_block_response)
+   {
+      auto action = [](uint64_t seq, uint8_t byte) {
+         return action_trace_v0{ seq, "receiver"_n, "contract"_n, "action"_n, {{ "alice"_n, "active"_n }}, { byte, byte } };
+      };
+      auto block_trace = block_trace_v0 {
+         "b000000000000000000000000000000000000000000000000000000000000001"_h,
+         1,
+         "0000000000000000000000000000000000000000000000000000000000000000"_h,
+         chain::block_timestamp_type(0),
+         "bp.one"_n,
+         {
+            { "0000000000000000000000000000000000000000000000000000000000000001"_h, { action(1, 0x01), action(0, 0x00) } },
+            { "0000000000000000000000000000000000000000000000000000000000000002"_h, {} },
+            { "0000000000000000000000000000000000000000000000000000000000000003"_h, { action(2, 0x02), action(4, 0x04), action(3, 0x03) } }
+         }
+      };
+
+      std::vector<size_t> visited;
+      // decodes the last action first, as a thread pool might
+      parallel_for_function backwards = [&visited](size_t n, const std::function<void(size_t)>& f) {
+         for (size_t i = n; i-- > 0;) {
+            visited.push_back(i);
+            f(i);
+         }
+      };
+
+      const auto& handler = response_test_fixture::default_mock_data_handler;
+      auto serial = detail::response_formatter::process_block(block_trace, false, handler, {});
+      auto parallel = detail::response_formatter::process_block(block_trace, false, handler, {}, backwards);
+
+      BOOST_TEST(visited.size() == 5u);
+      BOOST_TEST(to_kv(serial) == to_kv(parallel), boost::test_tools::per_element());
+   }
+
    BOOST_FIXTURE_TEST_CASE(lib_response, response_test_fixture)
    {
       auto block_trace = block_trace_v0 {
@@ -376,6 +420,143 @@ BOOST_AUTO_TEST_SUITE(trace_responses)
       BOOST_TEST(null_response.is_null());
    }
 
+   BOOST_FIXTURE_TEST_CASE(basic_transaction_response, response_test_fixture)
+   {
+      auto block_trace = block_trace_v0 {
+         "b000000000000000000000000000000000000000000000000000000000000001"_h,
+         1,
+         "0000000000000000000000000000000000000000000000000000000000000000"_h,
+         chain::block_timestamp_type(0),
+         "bp.one"_n,
+         {
+            {
+               "0000000000000000000000000000000000000000000000000000000000000001"_h,
+               {
+                  {
+                     0,
+                     "receiver"_n, "contract"_n, "action"_n,
+                     {{ "alice"_n, "active"_n }},
+                     { 0x00, 0x01, 0x02, 0x03 }
+                  }
+               }
+            },
+            {
+               "0000000000000000000000000000000000000000000000000000000000000002"_h,
+               {
+                  {
+                     1,
+                     "receiver"_n, "contract"_n, "other"_n,
+                     {{ "bob"_n, "active"_n }},
+                     { 0x04 }
+                  }
+               }
+            }
+         }
+      };
+
+      fc::variant expected_response = fc::mutable_variant_object()
+         ("id", "0000000000000000000000000000000000000000000000000000000000000002")
+         ("block_number", 1)
+         ("block_id", "b000000000000000000000000000000000000000000000000000000000000001")
+         ("status", "irreversible")
+         ("timestamp", "2000-01-01T00:00:00.000Z")
+         ("producer", "bp.one")
+         ("actions", fc::variants({
+            fc::mutable_variant_object()
+               ("receiver", "receiver")
+               ("account", "contract")
+               ("action", "other")
+               ("authorization", fc::variants({
+                  fc::mutable_variant_object()
+                     ("account", "bob")
+                     ("permission", "active")
+               }))
+               ("data", "04")
+               ("params", fc::mutable_variant_object()
+                     ("hex", "04"))
+         }))
+      ;
+
+      const auto trx_id = "0000000000000000000000000000000000000000000000000000000000000002"_h;
+      mock_get_transaction_block = [&block_trace, &trx_id]( const chain::transaction_id_type& id, const yield_function& ) -> get_block_t {
+         BOOST_TEST(id == trx_id);
+         return std::make_tuple(block_trace, true);
+      };
+
+      fc::variant actual_response = get_transaction_trace( trx_id );
+
+      BOOST_TEST(to_kv(expected_response) == to_kv(actual_response), boost::test_tools::per_element());
+   }
+
+   BOOST_FIXTURE_TEST_CASE(missing_transaction_data, response_test_fixture)
+   {
+      mock_get_transaction_block = []( const chain::transaction_id_type&, const yield_function& ) -> get_block_t {
+         return {};
+      };
+
+      BOOST_TEST(get_transaction_trace( "0000000000000000000000000000000000000000000000000000000000000001"_h ).is_null());
+   }
+
+   BOOST_FIXTURE_TEST_CASE(cached_block_response, response_test_fixture)
+   {
+      auto block_trace = block_trace_v0 {
+         "b000000000000000000000000000000000000000000000000000000000000001"_h,
+         1,
+         "0000000000000000000000000000000000000000000000000000000000000000"_h,
+         chain::block_timestamp_type(0),
+         "bp.one"_n,
+         {
+            {
+               "0000000000000000000000000000000000000000000000000000000000000001"_h,
+               {
+                  {
+                     0,
+                     "receiver"_n, "contract"_n, "action"_n,
+                     {{ "alice"_n, "active"_n }},
+                     { 0x00, 0x01, 0x02, 0x03 }
+                  }
+               }
+            }
+         }
+      };
+
+      bool irreversible = false;
+      int get_block_calls = 0;
+      int data_handler_calls = 0;
+      mock_get_block = [&]( uint32_t height, const yield_function& ) -> get_block_t {
+         BOOST_TEST(height == 1);
+         ++get_block_calls;
+         return std::make_tuple(block_trace, irreversible);
+      };
+      mock_data_handler = [&](const action_trace_v0& a, const yield_function& y) -> fc::variant {
+         ++data_handler_calls;
+         return default_mock_data_handler(a, y);
+      };
+
+      response_impl_type cached_impl(mock_logfile_provider(*this), mock_data_handler_provider(*this), 4);
+
+      // a pending block is read every time but only formatted again when it was replaced by a fork
+      const auto first = cached_impl.get_block_trace(1);
+      const auto second = cached_impl.get_block_trace(1);
+      BOOST_TEST(to_kv(first) == to_kv(second), boost::test_tools::per_element());
+      BOOST_TEST(get_block_calls == 2);
+      BOOST_TEST(data_handler_calls == 1);
+
+      block_trace.id = "b000000000000000000000000000000000000000000000000000000000000002"_h;
+      const auto forked = cached_impl.get_block_trace(1);
+      BOOST_TEST(forked.get_object()["id"].as_string() == block_trace.id.str());
+      BOOST_TEST(get_block_calls == 3);
+      BOOST_TEST(data_handler_calls == 2);
+
+      // once irreversible the store is no longer consulted
+      irreversible = true;
+      const auto final_response = cached_impl.get_block_trace(1);
+      BOOST_TEST(final_response.get_object()["status"].as_string() == "irreversible");
+      cached_impl.get_block_trace(1);
+      BOOST_TEST(get_block_calls == 4);
+      BOOST_TEST(data_handler_calls == 3);
+   }
+
    BOOST_FIXTURE_TEST_CASE(yield_throws, response_test_fixture)
    {
       auto block_trace = block_trace_v0 {
@@ -4,6 +4,8 @@
 #include <eosio/trace_api/test_common.hpp>
 #include <eosio/trace_api/store_provider.hpp>
 #include <boost/filesystem.hpp>
+#include <fstream>
+#include <future>
 
 using namespace eosio;
 using namespace eosio::trace_api;
@@ -728,6 +730,80 @@ BOOST_AUTO_TEST_SUITE(slice_tests)
       BOOST_REQUIRE(first_offset < offset);
    }
 
+   BOOST_FIXTURE_TEST_CASE(store_provider_writer_failure, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      const auto slice_dir = tempdir.path() / "slices";
+      test_store_provider sp(slice_dir, 100);
+
+      // a regular file where the slices belong, so the writer thread cannot create them
+      bfs::remove_all(slice_dir);
+      std::ofstream(slice_dir.generic_string()) << "not a directory";
+
+      std::promise<void> failed;
+      sp.start_writer_thread(fc::milliseconds(1), 10, [&failed](const exception_with_context&) { failed.set_value(); });
+      sp.append(bt);
+      BOOST_REQUIRE(failed.get_future().wait_for(std::chrono::seconds(5)) == std::future_status::ready);
+
+      // later appends report the failure instead of being dropped
+      try {
+         sp.append(bt2);
+         BOOST_FAIL("append should have rethrown the writer failure");
+      } catch (...) {
+      }
+      try {
+         sp.append_lib(1);
+         BOOST_FAIL("append_lib should have rethrown the writer failure");
+      } catch (...) {
+      }
+      sp.stop_writer_thread();
+   }
+
+   BOOST_FIXTURE_TEST_CASE(store_provider_columnar_export, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      test_store_provider sp(tempdir.path(), 100);
+      sp.set_columnar_export(true);
+      sp.append(bt);
+      sp.append_lib(1);
+      sp.append(bt2); // no actions, so no row group
+
+      slice_directory sd(tempdir.path(), 100, std::optional<uint32_t>(1), std::optional<uint32_t>(), 0);
+      fc::cfile file;
+      BOOST_REQUIRE(sd.find_action_columns_slice(0, open_state::read, file));
+      const auto columns = extract_store<action_columns_v0>(file);
+      BOOST_REQUIRE_EQUAL(file.tellp(), bfs::file_size(file.get_file_path()));
+      file.close();
+
+      const auto& actions = bt.transactions[0].actions;
+      BOOST_REQUIRE_EQUAL(columns.size(), actions.size());
+      BOOST_REQUIRE(columns.block_num == std::vector<uint32_t>(3, bt.number));
+      BOOST_REQUIRE(columns.transaction_id == std::vector<chain::transaction_id_type>(3, bt.transactions[0].id));
+      BOOST_REQUIRE(columns.global_sequence == std::vector<uint64_t>({ 0, 1, 2 }));
+      BOOST_REQUIRE(columns.receiver == std::vector<chain::name>({ "eosio.token"_n, "alice"_n, "bob"_n }));
+      BOOST_REQUIRE(columns.account == std::vector<chain::name>(3, "eosio.token"_n));
+      BOOST_REQUIRE(columns.action == std::vector<chain::name>(3, "transfer"_n));
+      BOOST_REQUIRE(columns.authorization_offset == std::vector<uint32_t>({ 0, 1, 2, 3 }));
+      BOOST_REQUIRE(columns.actor == std::vector<chain::name>(3, "alice"_n));
+      BOOST_REQUIRE(columns.permission == std::vector<chain::name>(3, "active"_n));
+      BOOST_REQUIRE_EQUAL(columns.data_offset.size(), actions.size() + 1);
+      for (size_t i = 0; i < actions.size(); ++i) {
+         const chain::bytes data(columns.data.begin() + columns.data_offset[i], columns.data.begin() + columns.data_offset[i + 1]);
+         BOOST_REQUIRE(data == actions[i].data);
+      }
+
+      // pruned with its slice
+      sd.run_maintenance_tasks(250, {});
+      BOOST_REQUIRE(!sd.find_action_columns_slice(0, open_state::read, file, false));
+
+      // and only written when enabled
+      fc::temp_directory tempdir2;
+      test_store_provider sp2(tempdir2.path(), 100);
+      sp2.append(bt);
+      slice_directory sd2(tempdir2.path(), 100, std::optional<uint32_t>(), std::optional<uint32_t>(), 0);
+      BOOST_REQUIRE(!sd2.find_action_columns_slice(0, open_state::read, file, false));
+   }
+
    BOOST_FIXTURE_TEST_CASE(test_get_block, test_fixture)
    {
       fc::temp_directory tempdir;
@@ -777,4 +853,51 @@ BOOST_AUTO_TEST_SUITE(slice_tests)
       BOOST_REQUIRE(!block2);
    }
 
+   BOOST_FIXTURE_TEST_CASE(test_get_transaction_block, test_fixture)
+   {
+      fc::temp_directory tempdir;
+      store_provider sp(tempdir.path(), 100, std::optional<uint32_t>(), std::optional<uint32_t>(), 0);
+      sp.append(bt);
+      sp.append_lib(1);
+      sp.append(bt2);
+
+      const auto trx1 = bt.transactions[0].id;
+      const auto trx2 = bt2.transactions[0].id;
+      const auto missing = "0000000000000000000000000000000000000000000000000000000000000009"_h;
+
+      get_block_t block1 = sp.get_transaction_block(trx1);
+      BOOST_REQUIRE(block1);
+      BOOST_REQUIRE(std::get<1>(*block1));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block1), bt);
+
+      get_block_t block2 = sp.get_transaction_block(trx2);
+      BOOST_REQUIRE(block2);
+      BOOST_REQUIRE(!std::get<1>(*block2));
+      BOOST_REQUIRE_EQUAL(std::get<0>(*block2), bt2);
+
+      BOOST_REQUIRE(!sp.get_transaction_block(missing));
+
+      // block 5 is forked out by a block holding another transaction, appended after the index was built
+      auto bt2_fork = bt2;
+      bt2_fork.id = "0000000000000000000000000000000000000000000000000000000000000006"_h;
+      bt2_fork.transactions[0].id = "e000000000000000000000000000000000000000000000000000000000000004"_h;
+      sp.append(bt2_fork);
+
+      BOOST_REQUIRE(!sp.get_transaction_block(trx2));
+      get_block_t forked = sp.get_transaction_block(bt2_fork.transactions[0].id);
+      BOOST_REQUIRE(forked);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*forked), bt2_fork);
+
+      // same truncated id as trx1 but a different transaction
+      auto collision = trx1;
+      collision._hash[3] ^= 1;
+      BOOST_REQUIRE(!sp.get_transaction_block(collision));
+
+      // a second store finds the same blocks from the files alone
+      store_provider reopened(tempdir.path(), 100, std::optional<uint32_t>(), std::optional<uint32_t>(), 0);
+      get_block_t reread = reopened.get_transaction_block(trx1);
+      BOOST_REQUIRE(reread);
+      BOOST_REQUIRE_EQUAL(std::get<0>(*reread), bt);
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -7,6 +7,8 @@
 
 #include <eosio/trace_api/configuration_utils.hpp>
 
+#include <eosio/chain/thread_utils.hpp>
+
 #include <boost/signals2/connection.hpp>
 
 using namespace eosio::trace_api;
@@ -84,6 +86,10 @@ namespace {
          return store->get_block(height, yield);
       }
 
+      get_block_t get_transaction_block(const chain::transaction_id_type& trx_id, const yield_function& yield) {
+         return store->get_transaction_block(trx_id, yield);
+      }
+
       std::shared_ptr<Store> store;
    };
 }
@@ -106,6 +112,17 @@ struct trace_api_common_impl {
       cfg_options("trace-minimum-uncompressed-irreversible-history-blocks", boost::program_options::value<int32_t>()->default_value(-1),
                   "Number of blocks to ensure are uncompressed past LIB. Compressed \"slice\" files are still accessible but may carry a performance loss on retrieval\n"
                   "A value of -1 indicates that automatic compression of \"slice\" files will be turned off.");
+      cfg_options("trace-write-group-interval-ms", bpo::value<uint32_t>()->default_value(0),
+                  "Milliseconds a block trace may wait on a writer thread for others to share its flush to the \"slice\" files.\n"
+                  "A value of 0 writes and syncs every block trace synchronously on the main thread.");
+      cfg_options("trace-write-max-queued", bpo::value<uint32_t>()->default_value(1000),
+                  "Number of block traces the writer thread may have pending before block processing waits on it.");
+      cfg_options("trace-columnar-export", bpo::bool_switch()->default_value(false),
+                  "Also write the actions of every \"slice\" column by column to a trace_actions_ file of the slice, "
+                  "for bulk loading into analytics tools.");
+      cfg_options("trace-maintenance-threads", bpo::value<uint16_t>()->default_value(1),
+                  "Number of threads used to compress \"slice\" files. Several irreversible slices are compressed concurrently, "
+                  "a single slice is split across the threads at its seek points.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
@@ -132,22 +149,40 @@ struct trace_api_common_impl {
          minimum_uncompressed_irreversible_history_blocks = uncompressed_blocks;
       }
 
+      write_group_interval = fc::milliseconds(options.at("trace-write-group-interval-ms").as<uint32_t>());
+      max_queued_writes = options.at("trace-write-max-queued").as<uint32_t>();
+      EOS_ASSERT(max_queued_writes > 0, chain::plugin_config_exception,
+                 "\"trace-write-max-queued\" must be greater than 0.");
+
+      maintenance_threads = options.at("trace-maintenance-threads").as<uint16_t>();
+      EOS_ASSERT(maintenance_threads > 0, chain::plugin_config_exception,
+                 "\"trace-maintenance-threads\" must be greater than 0.");
+
       store = std::make_shared<store_provider>(
          trace_dir,
          slice_stride,
          minimum_irreversible_history_blocks,
          minimum_uncompressed_irreversible_history_blocks,
-         compression_seek_point_stride
+         compression_seek_point_stride,
+         maintenance_threads
       );
+      store->set_columnar_export(options.at("trace-columnar-export").as<bool>());
    }
 
    void plugin_startup() {
       store->start_maintenance_thread([](const std::string& msg ){
          fc_dlog( _log, msg );
       });
+      if (write_group_interval.count() > 0) {
+         store->start_writer_thread(write_group_interval, max_queued_writes, [](const exception_with_context& e) {
+            log_exception(e, fc::log_level::error);
+            app().post(appbase::priority::high, []() { app().quit(); });
+         });
+      }
    }
 
    void plugin_shutdown() {
+      store->stop_writer_thread();
       store->stop_maintenance_thread();
    }
 
@@ -157,6 +192,9 @@ struct trace_api_common_impl {
 
    std::optional<uint32_t> minimum_irreversible_history_blocks;
    std::optional<uint32_t> minimum_uncompressed_irreversible_history_blocks;
+   uint16_t maintenance_threads = 1;
+   fc::microseconds write_group_interval;
+   uint32_t max_queued_writes = 0;
 
    static constexpr int32_t manual_slice_file_value = -1;
    static constexpr uint32_t compression_seek_point_stride = 6 * 1024 * 1024; // 6 MiB strides for clog seek points
@@ -187,12 +225,18 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
             "Failure to specify this option when there are no trace-rpc-abi configuations will result in an Error.\n"
             "This option is mutually exclusive with trace-rpc-api"
       );
+      cfg_options("trace-rpc-response-cache-size", bpo::value<uint32_t>()->default_value(0),
+                  "Number of formatted get_block responses retained in memory. Irreversible blocks are served from it "
+                  "without reading the trace files. A value of 0 disables the cache.");
+      cfg_options("trace-rpc-abi-cache-size", bpo::value<uint32_t>()->default_value(0),
+                  "Number of ABI decoded action payloads retained in memory, keyed by account, action and data. "
+                  "A value of 0 disables the cache.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
       std::shared_ptr<abi_data_handler> data_handler = std::make_shared<abi_data_handler>([](const exception_with_context& e){
          log_exception(e, fc::log_level::debug);
-      });
+      }, options.at("trace-rpc-abi-cache-size").as<uint32_t>());
 
       if( options.count("trace-rpc-abi") ) {
          EOS_ASSERT(options.count("trace-no-abis") == 0, chain::plugin_config_exception,
@@ -217,7 +261,9 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
 
       req_handler = std::make_shared<request_handler_t>(
          shared_store_provider<store_provider>(common->store),
-         abi_data_handler::shared_provider(data_handler)
+         abi_data_handler::shared_provider(data_handler),
+         options.at("trace-rpc-response-cache-size").as<uint32_t>(),
+         [&http=app().get_plugin<http_plugin>()](size_t n, const std::function<void(size_t)>& f) { http.parallel_for(n, f); }
       );
    }
 
@@ -280,6 +326,48 @@ struct trace_api_rpc_plugin_impl : public std::enable_shared_from_this<trace_api
             http_plugin::handle_exception("trace_api", "get_block", body, cb);
          }
       });
+
+      http.add_async_handler("/v1/trace_api/get_transaction_trace",
+            [wthis=weak_from_this(), max_response_time](std::string, std::string body, url_response_callback cb)
+      {
+         auto that = wthis.lock();
+         if (!that) {
+            return;
+         }
+
+         auto trx_id = ([&body]() -> std::optional<chain::transaction_id_type> {
+            if (body.empty()) {
+               return {};
+            }
+
+            try {
+               auto input = fc::json::from_string(body);
+               return input.get_object()["id"].as<chain::transaction_id_type>();
+            } catch (...) {
+               return {};
+            }
+         })();
+
+         if (!trx_id) {
+            error_results results{400, "Bad or missing id"};
+            cb( 400, fc::variant( results ));
+            return;
+         }
+
+         try {
+
+            const auto deadline = that->calc_deadline( max_response_time );
+            auto resp = that->req_handler->get_transaction_trace(*trx_id, [deadline]() { FC_CHECK_DEADLINE(deadline); });
+            if (resp.is_null()) {
+               error_results results{404, "Transaction trace missing"};
+               cb( 404, fc::variant( results ));
+            } else {
+               cb( 200, std::move(resp) );
+            }
+         } catch (...) {
+            http_plugin::handle_exception("trace_api", "get_transaction_trace", body, cb);
+         }
+      });
    }
 
    void plugin_shutdown() {
@@ -297,9 +385,14 @@ struct trace_api_plugin_impl {
 
    static void set_program_options(appbase::options_description& cli, appbase::options_description& cfg) {
       auto cfg_options = cfg.add_options();
+      cfg_options("trace-signal-max-queued", bpo::value<uint32_t>()->default_value(0),
+                  "Number of blocks and transaction traces that may wait for the trace thread to extract them before block processing waits on it.\n"
+                  "A value of 0 extracts them on the main thread as they are applied.");
    }
 
    void plugin_initialize(const appbase::variables_map& options) {
+      signals = std::make_unique<chain::signal_worker>("trace_signals", options.at("trace-signal-max-queued").as<uint32_t>());
+
       auto log_exceptions_and_shutdown = [](const exception_with_context& e) {
          log_exception(e, fc::log_level::error);
          app().quit();
@@ -309,26 +402,27 @@ struct trace_api_plugin_impl {
 
       auto& chain = app().find_plugin<chain_plugin>()->chain();
 
+      using applied_transaction_t = std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&>;
       applied_transaction_connection.emplace(
-         chain.applied_transaction.connect([this](std::tuple<const chain::transaction_trace_ptr&, const chain::signed_transaction&> t) {
+         chain.applied_transaction.connect(signals->slot<applied_transaction_t>([this](applied_transaction_t t) {
             emit_killer([&](){
                extraction->signal_applied_transaction(std::get<0>(t), std::get<1>(t));
             });
-         }));
+         })));
 
       accepted_block_connection.emplace(
-         chain.accepted_block.connect([this](const chain::block_state_ptr& p) {
+         chain.accepted_block.connect(signals->slot<const chain::block_state_ptr&>([this](const chain::block_state_ptr& p) {
             emit_killer([&](){
                extraction->signal_accepted_block(p);
             });
-         }));
+         })));
 
       irreversible_block_connection.emplace(
-         chain.irreversible_block.connect([this](const chain::block_state_ptr& p) {
+         chain.irreversible_block.connect(signals->slot<const chain::block_state_ptr&>([this](const chain::block_state_ptr& p) {
             emit_killer([&](){
                extraction->signal_irreversible_block(p);
             });
-         }));
+         })));
 
    }
 
@@ -337,6 +431,10 @@ struct trace_api_plugin_impl {
    }
 
    void plugin_shutdown() {
+      applied_transaction_connection.reset();
+      accepted_block_connection.reset();
+      irreversible_block_connection.reset();
+      signals->stop();
       common->plugin_shutdown();
    }
 
@@ -344,6 +442,7 @@ struct trace_api_plugin_impl {
 
    using chain_extraction_t = chain_extraction_impl_type<shared_store_provider<store_provider>>;
    std::shared_ptr<chain_extraction_t> extraction;
+   std::unique_ptr<chain::signal_worker>                      signals;
 
    fc::optional<scoped_connection>                            applied_transaction_connection;
    fc::optional<scoped_connection>                            accepted_block_connection;
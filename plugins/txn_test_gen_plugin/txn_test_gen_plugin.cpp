@@ -2,6 +2,7 @@
 #include <eosio/chain_plugin/chain_plugin.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/transaction_template.hpp>
 
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
@@ -21,6 +22,9 @@
 
 #include <contracts.hpp>
 
+#include <algorithm>
+#include <atomic>
+
 using namespace eosio::testing;
 
 namespace eosio { namespace detail {
@@ -93,6 +97,15 @@ using namespace eosio::chain;
 
 struct txn_test_gen_plugin_impl {
 
+   /// what a generated transaction does; txn-test-gen-workload mixes them
+   enum class workload {
+      transfer,    ///< eosio.token transfer between the "a" and "b" accounts
+      multi_index, ///< emplaces a row with four secondary indices into a table of the "m" account
+      notify       ///< eosio.token transfer between "a" and "n", whose contract runs on the notification
+   };
+
+   using clock_type = boost::asio::high_resolution_timer::clock_type;
+
    uint64_t _total_us = 0;
    uint64_t _txcount = 0;
 
@@ -102,35 +115,66 @@ struct txn_test_gen_plugin_impl {
    name                                                 newaccountA;
    name                                                 newaccountB;
    name                                                 newaccountT;
-
-   void push_next_transaction(const std::shared_ptr<std::vector<signed_transaction>>& trxs, const std::function<void(const fc::exception_ptr&)>& next ) {
+   name                                                 newaccountM;
+   name                                                 newaccountN;
+
+   const fc::crypto::private_key a_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'a')));
+   const fc::crypto::private_key b_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'b')));
+   const fc::crypto::private_key n_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'e')));
+
+   std::vector<workload>                                workload_mix; ///< transaction i runs workload_mix[i % size]
+   std::vector<transaction_template>                    templates;    ///< by template_index of each workload and direction
+   static constexpr uint32_t                            nonce_slot = 0;
+   static constexpr uint32_t                            sequence_slot = 1; ///< multi_index templates only
+   uint64_t                                             presign_count = 0;
+   std::vector<packed_transaction_ptr>                  presigned;
+   std::atomic<size_t>                                  next_presigned{0};
+   std::atomic<uint64_t>                                next_sequence{0};
+   std::atomic<uint64_t>                                nonce{static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32};
+
+   /// microseconds from the time a batch was scheduled to be sent until each of its transactions was accepted
+   std::vector<uint32_t>                                latencies_us;
+
+   void push_next_transaction(const std::shared_ptr<std::vector<packed_transaction_ptr>>& trxs, clock_type::time_point scheduled,
+                              const std::function<void(const fc::exception_ptr&)>& next ) {
       chain_plugin& cp = app().get_plugin<chain_plugin>();
 
       for (size_t i = 0; i < trxs->size(); ++i) {
-         cp.accept_transaction( std::make_shared<packed_transaction>(trxs->at(i)), [=](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result){
+         cp.accept_transaction( trxs->at(i), [=](const fc::static_variant<fc::exception_ptr, transaction_trace_ptr>& result){
             if (result.contains<fc::exception_ptr>()) {
                next(result.get<fc::exception_ptr>());
             } else {
                if (result.contains<transaction_trace_ptr>() && result.get<transaction_trace_ptr>()->receipt) {
                   _total_us += result.get<transaction_trace_ptr>()->receipt->cpu_usage_us;
                   ++_txcount;
+                  // measured from the schedule rather than the actual send, so a backlog shows up as latency
+                  latencies_us.push_back( std::chrono::duration_cast<std::chrono::microseconds>(clock_type::now() - scheduled).count() );
                }
             }
          });
       }
    }
 
-   void push_transactions( std::vector<signed_transaction>&& trxs, const std::function<void(fc::exception_ptr)>& next ) {
+   void push_transactions( std::vector<packed_transaction_ptr>&& trxs, clock_type::time_point scheduled,
+                           const std::function<void(fc::exception_ptr)>& next ) {
       auto trxs_copy = std::make_shared<std::decay_t<decltype(trxs)>>(std::move(trxs));
-      app().post(priority::low, [this, trxs_copy, next]() {
-         push_next_transaction(trxs_copy, next);
+      app().post(priority::low, [this, trxs_copy, scheduled, next]() {
+         push_next_transaction(trxs_copy, scheduled, next);
       });
    }
 
+   void push_transactions( std::vector<signed_transaction>&& trxs, const std::function<void(fc::exception_ptr)>& next ) {
+      std::vector<packed_transaction_ptr> packed;
+      packed.reserve(trxs.size());
+      for (auto& trx : trxs)
+         packed.emplace_back(std::make_shared<packed_transaction>(std::move(trx)));
+      push_transactions(std::move(packed), clock_type::now(), next);
+   }
+
    void create_test_accounts(const std::string& init_name, const std::string& init_priv_key, const std::function<void(const fc::exception_ptr&)>& next) {
       ilog("create_test_accounts");
       std::vector<signed_transaction> trxs;
-      trxs.reserve(2);
+      trxs.reserve(3);
 
       try {
          name creator(init_name);
@@ -147,9 +191,12 @@ struct txn_test_gen_plugin_impl {
          fc::crypto::private_key txn_test_receiver_A_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'a')));
          fc::crypto::private_key txn_test_receiver_B_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'b')));
          fc::crypto::private_key txn_test_receiver_C_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'c')));
+         fc::crypto::private_key txn_test_receiver_M_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'd')));
          fc::crypto::public_key  txn_text_receiver_A_pub_key = txn_test_receiver_A_priv_key.get_public_key();
          fc::crypto::public_key  txn_text_receiver_B_pub_key = txn_test_receiver_B_priv_key.get_public_key();
          fc::crypto::public_key  txn_text_receiver_C_pub_key = txn_test_receiver_C_priv_key.get_public_key();
+         fc::crypto::public_key  txn_text_receiver_M_pub_key = txn_test_receiver_M_priv_key.get_public_key();
+         fc::crypto::public_key  txn_text_receiver_N_pub_key = n_priv_key.get_public_key();
          fc::crypto::private_key creator_priv_key = fc::crypto::private_key(init_priv_key);
 
          //create some test accounts
@@ -177,6 +224,20 @@ struct txn_test_gen_plugin_impl {
 
             trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, newaccountT, owner_auth, active_auth});
             }
+            //create "M" account
+            {
+            auto owner_auth   = eosio::chain::authority{1, {{txn_text_receiver_M_pub_key, 1}}, {}};
+            auto active_auth  = eosio::chain::authority{1, {{txn_text_receiver_M_pub_key, 1}}, {}};
+
+            trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, newaccountM, owner_auth, active_auth});
+            }
+            //create "N" account
+            {
+            auto owner_auth   = eosio::chain::authority{1, {{txn_text_receiver_N_pub_key, 1}}, {}};
+            auto active_auth  = eosio::chain::authority{1, {{txn_text_receiver_N_pub_key, 1}}, {}};
+
+            trx.actions.emplace_back(vector<chain::permission_level>{{creator,name("active")}}, newaccount{creator, newaccountN, owner_auth, active_auth});
+            }
 
             trx.expiration = cc.head_block_time() + fc::seconds(180);
             trx.set_reference_block(cc.head_block_id());
@@ -247,6 +308,17 @@ struct txn_test_gen_plugin_impl {
                                                                    abi_serializer::create_yield_function( abi_serializer_max_time ));
                trx.actions.push_back(act);
             }
+            {
+               action act;
+               act.account = newaccountT;
+               act.name = N(transfer);
+               act.authorization = vector<permission_level>{{newaccountT,config::active_name}};
+               act.data = eosio_token_serializer.variant_to_binary("transfer",
+                                                                   fc::json::from_string(fc::format_string("{\"from\":\"${from}\",\"to\":\"${to}\",\"quantity\":\"20000.0000 CUR\",\"memo\":\"\"}",
+                                                                   fc::mutable_variant_object()("from",newaccountT.to_string())("to",newaccountN.to_string()))),
+                                                                   abi_serializer::create_yield_function( abi_serializer_max_time ));
+               trx.actions.push_back(act);
+            }
 
             trx.expiration = cc.head_block_time() + fc::seconds(180);
             trx.set_reference_block(cc.head_block_id());
@@ -254,6 +326,30 @@ struct txn_test_gen_plugin_impl {
             trx.sign(txn_test_receiver_C_priv_key, chainid);
             trxs.emplace_back(std::move(trx));
          }
+
+         //set the contracts of the multi_index and notify workloads: get_table_test on "M" and noop on "N"
+         {
+            signed_transaction trx;
+
+            vector<uint8_t> m_wasm = contracts::get_table_test_wasm();
+            setcode m_handler;
+            m_handler.account = newaccountM;
+            m_handler.code.assign(m_wasm.begin(), m_wasm.end());
+            trx.actions.emplace_back( vector<chain::permission_level>{{newaccountM,name("active")}}, m_handler);
+
+            vector<uint8_t> n_wasm = contracts::noop_wasm();
+            setcode n_handler;
+            n_handler.account = newaccountN;
+            n_handler.code.assign(n_wasm.begin(), n_wasm.end());
+            trx.actions.emplace_back( vector<chain::permission_level>{{newaccountN,name("active")}}, n_handler);
+
+            trx.expiration = cc.head_block_time() + fc::seconds(180);
+            trx.set_reference_block(cc.head_block_id());
+            trx.max_net_usage_words = 5000;
+            trx.sign(txn_test_receiver_M_priv_key, chainid);
+            trx.sign(n_priv_key, chainid);
+            trxs.emplace_back(std::move(trx));
+         }
       } catch (const fc::exception& e) {
          next(e.dynamic_copy_exception());
          return;
@@ -296,9 +392,14 @@ struct txn_test_gen_plugin_impl {
                                                                   fc::mutable_variant_object()("from",newaccountB.to_string())("to",newaccountA.to_string())("l", salt))),
                                                                   abi_serializer::create_yield_function( abi_serializer_max_time ));
 
+      act_a_to_n = make_transfer(eosio_token_serializer, newaccountA, newaccountN, salt, abi_serializer_max_time);
+      act_n_to_a = make_transfer(eosio_token_serializer, newaccountN, newaccountA, salt, abi_serializer_max_time);
+      make_templates();
+
       timer_timeout = period;
       batch = batch_size/2;
-      nonce_prefix = 0;
+      next_sequence = 0;
+      latencies_us.clear();
 
       thread_pool.emplace( "txntest", thread_pool_size );
       timer = std::make_shared<boost::asio::high_resolution_timer>(thread_pool->get_executor());
@@ -306,22 +407,135 @@ struct txn_test_gen_plugin_impl {
       ilog("Started transaction test plugin; generating ${p} transactions every ${m} ms by ${t} load generation threads",
          ("p", batch_size) ("m", period) ("t", thread_pool_size));
 
-      boost::asio::post( thread_pool->get_executor(), [this]() {
-         arm_timer(boost::asio::high_resolution_timer::clock_type::now());
-      });
+      if (presign_count) {
+         presign_transactions(cc);
+      } else {
+         boost::asio::post( thread_pool->get_executor(), [this]() {
+            arm_timer(clock_type::now());
+         });
+      }
       return "success";
    }
 
-   void arm_timer(boost::asio::high_resolution_timer::time_point s) {
+   action make_transfer(const abi_serializer& eosio_token_serializer, name from, name to, const std::string& salt,
+                        const fc::microseconds& abi_serializer_max_time) {
+      action act;
+      act.account = newaccountT;
+      act.name = N(transfer);
+      act.authorization = vector<permission_level>{{from,config::active_name}};
+      act.data = eosio_token_serializer.variant_to_binary("transfer",
+                                                          fc::json::from_string(fc::format_string("{\"from\":\"${from}\",\"to\":\"${to}\",\"quantity\":\"1.0000 CUR\",\"memo\":\"${l}\"}",
+                                                          fc::mutable_variant_object()("from",from.to_string())("to",to.to_string())("l", salt))),
+                                                          abi_serializer::create_yield_function( abi_serializer_max_time ));
+      return act;
+   }
+
+   block_id_type reference_block_id(const controller& cc)const {
+      uint32_t reference_block_num = cc.last_irreversible_block_num();
+      if (txn_reference_block_lag >= 0) {
+         reference_block_num = cc.head_block_num();
+         if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
+            reference_block_num = 0;
+         } else {
+            reference_block_num -= (uint32_t)txn_reference_block_lag;
+         }
+      }
+      return cc.get_block_id_for_num(reference_block_num);
+   }
+
+   static size_t template_index(workload w, bool back) {
+      return static_cast<size_t>(w) * 2 + back;
+   }
+
+   /// packs each workload in each direction once; transactions then differ only in tapos, nonce and sequence
+   void make_templates() {
+      templates.clear();
+      for (workload w : {workload::transfer, workload::multi_index, workload::notify}) {
+         for (bool back : {false, true}) {
+            transaction trx;
+            trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack(uint64_t(0))));
+            switch (w) {
+               case workload::transfer:
+                  trx.actions.push_back(back ? act_b_to_a : act_a_to_b);
+                  break;
+               case workload::multi_index:
+                  trx.actions.emplace_back(vector<permission_level>{{newaccountA,config::active_name}}, newaccountM, N(addnumobj),
+                                           fc::raw::pack(uint64_t(0)));
+                  break;
+               case workload::notify:
+                  trx.actions.push_back(back ? act_n_to_a : act_a_to_n);
+                  break;
+            }
+            trx.max_net_usage_words = 100;
+            templates.emplace_back(trx);
+            templates.back().add_data_slot(true, 0, 0, sizeof(uint64_t));
+            if (w == workload::multi_index)
+               templates.back().add_data_slot(false, 0, 0, sizeof(uint64_t));
+         }
+      }
+   }
+
+   /// patches and signs the template of the sequence'th transaction of the workload mix
+   packed_transaction_ptr make_transaction(uint64_t sequence, const block_id_type& reference_block_id,
+                                           fc::time_point_sec expiration, const chain_id_type& chainid) {
+      const fc::crypto::private_key* key = &a_priv_key;
+      // each slot of the mix changes direction every round, which keeps the token balances level
+      const bool back = (sequence / workload_mix.size()) & 1;
+      const workload w = workload_mix[sequence % workload_mix.size()];
+      if (back && w == workload::transfer)
+         key = &b_priv_key;
+      else if (back && w == workload::notify)
+         key = &n_priv_key;
+
+      const auto& tmpl = templates[template_index(w, back)];
+      bytes packed = tmpl.packed();
+      tmpl.set_header(packed, expiration, reference_block_id);
+      tmpl.set_slot(packed, nonce_slot, uint64_t(nonce++));
+      if (w == workload::multi_index)
+         tmpl.set_slot(packed, sequence_slot, sequence);
+      vector<signature_type> sigs{ key->sign(transaction_template::sig_digest(packed, chainid)) };
+      return std::make_shared<packed_transaction>(transaction_template::make_packed(std::move(packed), std::move(sigs)));
+   }
+
+   /// signs presign_count transactions on the thread pool, then starts sending them
+   void presign_transactions(const controller& cc) {
+      const auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
+      const auto ref_block_id = reference_block_id(cc);
+      // leave a minute of the allowed lifetime for the transactions to reach a block
+      const uint32_t lifetime = std::max<uint32_t>(cc.get_global_properties().configuration.max_transaction_lifetime, 120) - 60;
+      const fc::time_point_sec expiration = cc.head_block_time() + fc::seconds(lifetime);
+
+      presigned.clear();
+      presigned.resize(presign_count);
+      next_presigned = 0;
+      latencies_us.reserve(presign_count);
+      ilog("Pre-signing ${n} transactions on ${t} threads", ("n", presign_count)("t", thread_pool_size));
+
+      const auto start = fc::time_point::now();
+      auto remaining = std::make_shared<std::atomic<uint16_t>>(thread_pool_size);
+      for (uint16_t t = 0; t < thread_pool_size; ++t) {
+         boost::asio::post( thread_pool->get_executor(), [this, t, remaining, start, ref_block_id, expiration, chainid]() {
+            for (uint64_t i = t; i < presign_count && running; i += thread_pool_size)
+               presigned[i] = make_transaction(i, ref_block_id, expiration, chainid);
+            if (--*remaining == 0 && running) {
+               ilog("Pre-signed ${n} transactions in ${s} ms, valid until ${e}",
+                    ("n", presign_count)("s", (fc::time_point::now() - start).count() / 1000)("e", expiration));
+               arm_timer(clock_type::now());
+            }
+         });
+      }
+   }
+
+   void arm_timer(clock_type::time_point s) {
       timer->expires_at(s + std::chrono::milliseconds(timer_timeout));
-      boost::asio::post( thread_pool->get_executor(), [this]() {
+      boost::asio::post( thread_pool->get_executor(), [this, s]() {
          send_transaction([this](const fc::exception_ptr& e){
             if (e) {
                elog("pushing transaction failed: ${e}", ("e", e->to_detail_string()));
                if(running)
                   stop_generation();
             }
-         }, nonce_prefix++);
+         }, s);
       });
       timer->async_wait([this](const boost::system::error_code& ec) {
          if(!running || ec)
@@ -330,59 +544,57 @@ struct txn_test_gen_plugin_impl {
       });
    }
 
-   void send_transaction(std::function<void(const fc::exception_ptr&)> next, uint64_t nonce_prefix) {
-      std::vector<signed_transaction> trxs;
+   void send_transaction(std::function<void(const fc::exception_ptr&)> next, clock_type::time_point scheduled) {
+      std::vector<packed_transaction_ptr> trxs;
       trxs.reserve(2*batch);
 
-      try {
-         controller& cc = app().get_plugin<chain_plugin>().chain();
-         auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
-
-         static fc::crypto::private_key a_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'a')));
-         static fc::crypto::private_key b_priv_key = fc::crypto::private_key::regenerate(fc::sha256(std::string(64, 'b')));
-
-         static uint64_t nonce = static_cast<uint64_t>(fc::time_point::now().sec_since_epoch()) << 32;
-
-         uint32_t reference_block_num = cc.last_irreversible_block_num();
-         if (txn_reference_block_lag >= 0) {
-            reference_block_num = cc.head_block_num();
-            if (reference_block_num <= (uint32_t)txn_reference_block_lag) {
-               reference_block_num = 0;
-            } else {
-               reference_block_num -= (uint32_t)txn_reference_block_lag;
+      if (!presigned.empty()) {
+         const size_t first = next_presigned.fetch_add(2*batch);
+         if (first >= presigned.size()) {
+            if (first < presigned.size() + 2*batch) {
+               app().post(priority::low, [this]() {
+                  if (running) {
+                     ilog("All ${n} pre-signed transactions sent", ("n", presigned.size()));
+                     stop_generation();
+                  }
+               });
             }
+            return;
          }
+         trxs.assign(presigned.begin() + first, presigned.begin() + std::min(first + 2*batch, presigned.size()));
+         push_transactions(std::move(trxs), scheduled, next);
+         return;
+      }
 
-         block_id_type reference_block_id = cc.get_block_id_for_num(reference_block_num);
+      try {
+         controller& cc = app().get_plugin<chain_plugin>().chain();
+         auto chainid = app().get_plugin<chain_plugin>().get_chain_id();
 
-         for(unsigned int i = 0; i < batch; ++i) {
-         {
-         signed_transaction trx;
-         trx.actions.push_back(act_a_to_b);
-         trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack( std::to_string(nonce_prefix)+std::to_string(nonce++) )));
-         trx.set_reference_block(reference_block_id);
-         trx.expiration = cc.head_block_time() + fc::seconds(30);
-         trx.max_net_usage_words = 100;
-         trx.sign(a_priv_key, chainid);
-         trxs.emplace_back(std::move(trx));
-         }
+         const block_id_type ref_block_id = reference_block_id(cc);
+         const fc::time_point_sec expiration = cc.head_block_time() + fc::seconds(30);
+         const uint64_t first = next_sequence.fetch_add(2*batch);
 
-         {
-         signed_transaction trx;
-         trx.actions.push_back(act_b_to_a);
-         trx.context_free_actions.emplace_back(action({}, config::null_account_name, name("nonce"), fc::raw::pack( std::to_string(nonce_prefix)+std::to_string(nonce++) )));
-         trx.set_reference_block(reference_block_id);
-         trx.expiration = cc.head_block_time() + fc::seconds(30);
-         trx.max_net_usage_words = 100;
-         trx.sign(b_priv_key, chainid);
-         trxs.emplace_back(std::move(trx));
-         }
-         }
+         for(uint64_t i = first; i < first + 2*batch; ++i)
+            trxs.emplace_back(make_transaction(i, ref_block_id, expiration, chainid));
       } catch ( const fc::exception& e ) {
          next(e.dynamic_copy_exception());
+         return;
       }
 
-      push_transactions(std::move(trxs), next);
+      push_transactions(std::move(trxs), scheduled, next);
+   }
+
+   void report_latencies() {
+      if (latencies_us.empty())
+         return;
+      std::sort(latencies_us.begin(), latencies_us.end());
+      const auto percentile = [this](double p) {
+         return latencies_us[std::min<size_t>(latencies_us.size() - 1, latencies_us.size() * p)];
+      };
+      ilog("latency from scheduled send to acceptance of ${n} transactions: p50 ${p50}us, p90 ${p90}us, p99 ${p99}us, p99.9 ${p999}us, max ${max}us",
+           ("n", latencies_us.size())("p50", percentile(0.5))("p90", percentile(0.9))("p99", percentile(0.99))
+           ("p999", percentile(0.999))("max", latencies_us.back()));
+      latencies_us.clear();
    }
 
    void stop_generation() {
@@ -399,16 +611,20 @@ struct txn_test_gen_plugin_impl {
          ilog("${d} transactions executed, ${t}us / transaction", ("d", _txcount)("t", _total_us / (double)_txcount));
          _txcount = _total_us = 0;
       }
+      report_latencies();
+      presigned.clear();
+      presigned.shrink_to_fit();
    }
 
    bool running{false};
 
    unsigned timer_timeout;
    unsigned batch;
-   uint64_t nonce_prefix;
 
    action act_a_to_b;
    action act_b_to_a;
+   action act_a_to_n;
+   action act_n_to_a;
 
    int32_t txn_reference_block_lag;
 };
@@ -421,6 +637,13 @@ void txn_test_gen_plugin::set_program_options(options_description&, options_desc
       ("txn-reference-block-lag", bpo::value<int32_t>()->default_value(0), "Lag in number of blocks from the head block when selecting the reference block for transactions (-1 means Last Irreversible Block)")
       ("txn-test-gen-threads", bpo::value<uint16_t>()->default_value(2), "Number of worker threads in txn_test_gen thread pool")
       ("txn-test-gen-account-prefix", bpo::value<string>()->default_value("txn.test."), "Prefix to use for accounts generated and used by this plugin")
+      ("txn-test-gen-workload", bpo::value<vector<string>>()->composing()->multitoken()->default_value({"transfer"}, "transfer"),
+       "Workload of the generated transactions as <workload>[:<weight>], may be given more than once to mix workloads. "
+       "'transfer' moves tokens between two accounts, 'multi_index' adds a row with four secondary indices to a table and "
+       "'notify' moves tokens to and from an account whose contract runs on the transfer notification")
+      ("txn-test-gen-presign", bpo::value<uint64_t>()->default_value(0),
+       "Number of transactions start_generation builds and signs up front on the thread pool; generation then only sends "
+       "them and stops once all are sent. 0 signs each batch as it is sent")
    ;
 }
 
@@ -433,6 +656,33 @@ void txn_test_gen_plugin::plugin_initialize(const variables_map& options) {
       my->newaccountA = eosio::chain::name(thread_pool_account_prefix + "a");
       my->newaccountB = eosio::chain::name(thread_pool_account_prefix + "b");
       my->newaccountT = eosio::chain::name(thread_pool_account_prefix + "t");
+      my->newaccountM = eosio::chain::name(thread_pool_account_prefix + "m");
+      my->newaccountN = eosio::chain::name(thread_pool_account_prefix + "n");
+      my->presign_count = options.at( "txn-test-gen-presign" ).as<uint64_t>();
+      for( const auto& w : options.at( "txn-test-gen-workload" ).as<vector<string>>() ) {
+         const auto colon = w.find( ':' );
+         const std::string kind = w.substr( 0, colon );
+         uint32_t weight = 1;
+         if( colon != std::string::npos ) {
+            try {
+               weight = std::stoul( w.substr( colon + 1 ) );
+            } catch( const std::exception& ) {
+               EOS_THROW( chain::plugin_config_exception, "invalid weight in txn-test-gen-workload ${w}", ("w", w) );
+            }
+         }
+         txn_test_gen_plugin_impl::workload kind_value;
+         if( kind == "transfer" )
+            kind_value = txn_test_gen_plugin_impl::workload::transfer;
+         else if( kind == "multi_index" )
+            kind_value = txn_test_gen_plugin_impl::workload::multi_index;
+         else if( kind == "notify" )
+            kind_value = txn_test_gen_plugin_impl::workload::notify;
+         else
+            EOS_THROW( chain::plugin_config_exception, "unknown txn-test-gen-workload ${w}", ("w", kind) );
+         EOS_ASSERT( weight > 0 && weight <= 1000, chain::plugin_config_exception,
+                     "txn-test-gen-workload weight ${w} must be between 1 and 1000", ("w", w) );
+         my->workload_mix.insert( my->workload_mix.end(), weight, kind_value );
+      }
       EOS_ASSERT( my->thread_pool_size > 0, chain::plugin_config_exception,
                   "txn-test-gen-threads ${num} must be greater than 0", ("num", my->thread_pool_size) );
    } FC_LOG_AND_RETHROW()
@@ -5,6 +5,7 @@
 
 #include <fc/variant.hpp>
 #include <fc/io/json.hpp>
+#include <fc/io/raw.hpp>
 
 #include <chrono>
 
@@ -32,6 +33,20 @@ using namespace eosio;
           } \
        }}
 
+// binary variant of CALL, served to requests that Accept application/octet-stream; the body is the fc::raw packed
+// parameters and the response the packed result, so signing skips JSON both ways
+#define CALL_BINARY(api_name, api_handle, call_name, INVOKE, http_response_code) \
+{std::string("/v1/" #api_name "/" #call_name), \
+   [&api_handle](string, string body, url_response_callback cb) mutable { \
+          try { \
+             fc::datastream<const char*> ds(body.data(), body.size()); \
+             INVOKE \
+             cb(http_response_code, url_response_body::from_binary(string(result.begin(), result.end()))); \
+          } catch (...) { \
+             http_plugin::handle_exception(#api_name, #call_name, string(), cb); \
+          } \
+       }}
+
 #define INVOKE_R_R(api_handle, call_name, in_param) \
      auto result = api_handle.call_name(fc::json::from_string(body).as<in_param>());
 
@@ -43,6 +58,36 @@ using namespace eosio;
      const auto& vs = fc::json::json::from_string(body).as<fc::variants>(); \
      auto result = api_handle.call_name(vs.at(0).as<in_param0>(), vs.at(1).as<in_param1>(), vs.at(2).as<in_param2>());
 
+// body is an array of [transaction, keys, chain_id] arrays, each as sign_transaction takes them
+#define INVOKE_SIGN_TRANSACTIONS(api_handle) \
+     std::vector<wallet::wallet_manager::sign_request> requests; \
+     for (const auto& v : fc::json::from_string(body).as<fc::variants>()) { \
+        const auto& vs = v.get_array(); \
+        requests.push_back({vs.at(0).as<chain::signed_transaction>(), vs.at(1).as<flat_set<public_key_type>>(), \
+                            vs.at(2).as<chain::chain_id_type>()}); \
+     } \
+     auto result = api_handle.sign_transactions(requests);
+
+// body is a packed digest and public key; responds with the packed signature
+#define INVOKE_BINARY_SIGN_DIGEST(api_handle) \
+     chain::digest_type digest; \
+     public_key_type key; \
+     fc::raw::unpack(ds, digest); \
+     fc::raw::unpack(ds, key); \
+     const auto result = fc::raw::pack(api_handle.sign_digest(digest, key));
+
+// body is a packed signed_transaction, set of public keys and chain id; responds with the packed signatures added
+#define INVOKE_BINARY_SIGN_TRANSACTION(api_handle) \
+     chain::signed_transaction trx; \
+     flat_set<public_key_type> keys; \
+     fc::sha256 chain_id; \
+     fc::raw::unpack(ds, trx); \
+     fc::raw::unpack(ds, keys); \
+     fc::raw::unpack(ds, chain_id); \
+     const auto signed_trx = api_handle.sign_transaction(trx, keys, chain::chain_id_type(chain_id.data(), chain_id.data_size())); \
+     const auto result = fc::raw::pack(vector<chain::signature_type>(signed_trx.signatures.begin() + trx.signatures.size(), \
+                                                                     signed_trx.signatures.end()));
+
 #define INVOKE_R_V(api_handle, call_name) \
      auto result = api_handle.call_name();
 
@@ -75,6 +120,8 @@ void wallet_api_plugin::plugin_startup() {
             INVOKE_V_R(wallet_mgr, set_timeout, int64_t), 200),
        CALL(wallet, wallet_mgr, sign_transaction,
             INVOKE_R_R_R_R(wallet_mgr, sign_transaction, chain::signed_transaction, flat_set<public_key_type>, chain::chain_id_type), 201),
+       CALL(wallet, wallet_mgr, sign_transactions,
+            INVOKE_SIGN_TRANSACTIONS(wallet_mgr), 201),
        CALL(wallet, wallet_mgr, sign_digest,
             INVOKE_R_R_R(wallet_mgr, sign_digest, chain::digest_type, public_key_type), 201),
        CALL(wallet, wallet_mgr, create,
@@ -100,6 +147,13 @@ void wallet_api_plugin::plugin_startup() {
        CALL(wallet, wallet_mgr, get_public_keys,
             INVOKE_R_V(wallet_mgr, get_public_keys), 200)
    });
+
+   app().get_plugin<http_plugin>().add_binary_api({
+       CALL_BINARY(wallet, wallet_mgr, sign_transaction,
+                   INVOKE_BINARY_SIGN_TRANSACTION(wallet_mgr), 201),
+       CALL_BINARY(wallet, wallet_mgr, sign_digest,
+                   INVOKE_BINARY_SIGN_DIGEST(wallet_mgr), 201)
+   });
 }
 
 void wallet_api_plugin::plugin_initialize(const variables_map& options) {
@@ -135,6 +189,7 @@ void wallet_api_plugin::plugin_initialize(const variables_map& options) {
 
 #undef INVOKE_R_R
 #undef INVOKE_R_R_R_R
+#undef INVOKE_SIGN_TRANSACTIONS
 #undef INVOKE_R_V
 #undef INVOKE_V_R
 #undef INVOKE_V_R_R
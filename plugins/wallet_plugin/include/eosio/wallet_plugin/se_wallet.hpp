@@ -33,6 +33,7 @@ class se_wallet final : public wallet_api {
       bool remove_key(string key) override;
 
       fc::optional<signature_type> try_sign_digest(const digest_type digest, const public_key_type public_key) override;
+      bool concurrent_signing() const override { return true; }
 
    private:
       std::unique_ptr<detail::se_wallet_impl> my;
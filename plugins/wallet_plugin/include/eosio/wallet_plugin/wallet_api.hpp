@@ -98,6 +98,10 @@ class wallet_api
       /** Returns a signature given the digest and public_key, if this wallet can sign via that public key
        */
       virtual fc::optional<signature_type> try_sign_digest( const digest_type digest, const public_key_type public_key ) = 0;
+
+      /** Whether try_sign_digest may run on several threads at once, while the wallet is not otherwise changed
+       */
+      virtual bool concurrent_signing()const { return false; }
 };
 
 }}
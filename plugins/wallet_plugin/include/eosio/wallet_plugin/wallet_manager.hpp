@@ -7,6 +7,7 @@
 #include <chrono>
 
 namespace fc { class variant; }
+namespace eosio { namespace chain { class named_thread_pool; } }
 
 namespace eosio {
 namespace wallet {
@@ -51,6 +52,24 @@ public:
                                              const chain::chain_id_type& id);
 
 
+   /// A transaction for sign_transactions, with the keys to sign it with and the chain to sign it for.
+   struct sign_request {
+      chain::signed_transaction  trx;
+      flat_set<public_key_type>  keys;
+      chain::chain_id_type       chain_id;
+   };
+
+   /// Sign many transactions as sign_transaction does each.
+   /// Every key is looked up in the unlocked wallets once for the whole batch, and the transactions are signed on the
+   /// signing threads when all of the wallets holding the keys can sign concurrently.
+   /// @param requests the transactions to sign
+   /// @return the signed transactions, in the order of requests
+   /// @throws fc::exception if corresponding private keys not found in unlocked wallets, before anything is signed
+   std::vector<chain::signed_transaction> sign_transactions(const std::vector<sign_request>& requests);
+
+   /// Set how many threads sign_transactions signs on, 1 to sign on the calling thread.
+   void set_signing_threads(size_t num_threads);
+
    /// Sign digest with the private keys specified via their public keys.
    /// @param digest the digest to sign.
    /// @param key the public key of the corresponding private key to sign the digest with
@@ -130,6 +149,10 @@ private:
    /// Calls lock_all() if timeout has passed.
    void check_timeout();
 
+   /// Each key of the unlocked wallets and the first wallet, by name, holding it.
+   /// Rebuilt on first use after a wallet is created, opened, locked or unlocked or its keys change.
+   const std::map<public_key_type, wallet_api*>& key_index();
+
 private:
    using timepoint_t = std::chrono::time_point<std::chrono::system_clock>;
    std::map<std::string, std::unique_ptr<wallet_api>> wallets;
@@ -138,6 +161,10 @@ private:
    boost::filesystem::path dir = ".";
    boost::filesystem::path lock_path = dir / "wallet.lock";
    std::unique_ptr<boost::interprocess::file_lock> wallet_dir_lock;
+   std::map<public_key_type, wallet_api*> _key_index;
+   bool key_index_valid = false;
+   size_t signing_threads = 1;
+   std::unique_ptr<chain::named_thread_pool> signing_thread_pool; ///< stopped before the wallets it signs with are destroyed
 
    void start_lock_watch(std::shared_ptr<boost::asio::deadline_timer> t);
    void initialize_lock();
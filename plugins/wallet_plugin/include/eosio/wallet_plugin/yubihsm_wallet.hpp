@@ -14,7 +14,8 @@ struct yubihsm_wallet_impl;
 
 class yubihsm_wallet final : public wallet_api {
    public:
-      yubihsm_wallet(const string& connector, const uint16_t authkey);
+      /// @param sessions how many device sessions sign at once, at most the 16 a YubiHSM serves
+      yubihsm_wallet(const string& connector, const uint16_t authkey, const uint16_t sessions = 1);
       ~yubihsm_wallet();
 
       private_key_type get_private_key(public_key_type pubkey) const override;
@@ -33,6 +34,7 @@ class yubihsm_wallet final : public wallet_api {
       bool remove_key(string key) override;
 
       fc::optional<signature_type> try_sign_digest(const digest_type digest, const public_key_type public_key) override;
+      bool concurrent_signing() const override;
 
    private:
       std::unique_ptr<detail::yubihsm_wallet_impl> my;
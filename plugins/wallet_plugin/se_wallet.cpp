@@ -206,6 +206,8 @@ struct se_wallet_impl {
       public_key_data kd;
       compact_signature compact_sig;
       try {
+         // recovering the public key writes into the EC_KEY, so each signature recovers into its own
+         fc::ec_key key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
          kd = get_public_key_data(it->second);
          compact_sig = signature_from_ecdsa(key, kd, sig, d);
       } catch(chain::wallet_exception&) {
@@ -258,7 +260,6 @@ struct se_wallet_impl {
    }
 
    map<public_key_type,SecKeyRef> _keys;
-   fc::ec_key key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
    bool locked = true;
 };
 
@@ -3,6 +3,7 @@
 #include <eosio/wallet_plugin/wallet.hpp>
 #include <eosio/wallet_plugin/se_wallet.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <boost/algorithm/string.hpp>
 namespace eosio {
 namespace wallet {
@@ -83,6 +84,7 @@ std::string wallet_manager::create(const std::string& name) {
    if (it != wallets.end()) {
       wallets.erase(it);
    }
+   key_index_valid = false;
    wallets.emplace(name, std::move(wallet));
 
    return password;
@@ -107,6 +109,7 @@ void wallet_manager::open(const std::string& name) {
    if (it != wallets.end()) {
       wallets.erase(it);
    }
+   key_index_valid = false;
    wallets.emplace(name, std::move(wallet));
 }
 
@@ -153,6 +156,7 @@ flat_set<public_key_type> wallet_manager::get_public_keys() {
 
 void wallet_manager::lock_all() {
    // no call to check_timeout since we are locking all anyway
+   key_index_valid = false;
    for (auto& i : wallets) {
       if (!i.second->is_locked()) {
          i.second->lock();
@@ -169,6 +173,7 @@ void wallet_manager::lock(const std::string& name) {
    if (w->is_locked()) {
       return;
    }
+   key_index_valid = false;
    w->lock();
 }
 
@@ -182,6 +187,7 @@ void wallet_manager::unlock(const std::string& name, const std::string& password
       EOS_THROW(chain::wallet_unlocked_exception, "Wallet is already unlocked: ${w}", ("w", name));
       return;
    }
+   key_index_valid = false;
    w->unlock(password);
 }
 
@@ -194,6 +200,7 @@ void wallet_manager::import_key(const std::string& name, const std::string& wif_
    if (w->is_locked()) {
       EOS_THROW(chain::wallet_locked_exception, "Wallet is locked: ${w}", ("w", name));
    }
+   key_index_valid = false;
    w->import_key(wif_key);
 }
 
@@ -207,6 +214,7 @@ void wallet_manager::remove_key(const std::string& name, const std::string& pass
       EOS_THROW(chain::wallet_locked_exception, "Wallet is locked: ${w}", ("w", name));
    }
    w->check_password(password); //throws if bad password
+   key_index_valid = false;
    w->remove_key(key);
 }
 
@@ -221,6 +229,7 @@ string wallet_manager::create_key(const std::string& name, const std::string& ke
    }
 
    string upper_key_type = boost::to_upper_copy<std::string>(key_type);
+   key_index_valid = false;
    return w->create_key(upper_key_type);
 }
 
@@ -228,38 +237,93 @@ chain::signed_transaction
 wallet_manager::sign_transaction(const chain::signed_transaction& txn, const flat_set<public_key_type>& keys, const chain::chain_id_type& id) {
    check_timeout();
    chain::signed_transaction stxn(txn);
+   const chain::digest_type digest = stxn.sig_digest(id, stxn.context_free_data);
 
+   const auto& index = key_index();
    for (const auto& pk : keys) {
-      bool found = false;
-      for (const auto& i : wallets) {
-         if (!i.second->is_locked()) {
-            fc::optional<signature_type> sig = i.second->try_sign_digest(stxn.sig_digest(id, stxn.context_free_data), pk);
-            if (sig) {
-               stxn.signatures.push_back(*sig);
-               found = true;
-               break; // inner for
-            }
-         }
-      }
-      if (!found) {
+      auto it = index.find(pk);
+      fc::optional<signature_type> sig;
+      if (it != index.end())
+         sig = it->second->try_sign_digest(digest, pk);
+      if (!sig) {
          EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
       }
+      stxn.signatures.push_back(*sig);
    }
 
    return stxn;
 }
 
+std::vector<chain::signed_transaction>
+wallet_manager::sign_transactions(const std::vector<sign_request>& requests) {
+   check_timeout();
+
+   const auto& index = key_index();
+   bool concurrent = true;
+   for (const auto& r : requests) {
+      for (const auto& pk : r.keys) {
+         auto it = index.find(pk);
+         if (it == index.end()) {
+            EOS_THROW(chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
+         }
+         concurrent &= it->second->concurrent_signing();
+      }
+   }
+
+   std::vector<chain::signed_transaction> result(requests.size());
+   auto sign = [&](size_t begin, size_t end) {
+      for (size_t i = begin; i < end; ++i) {
+         const auto& r = requests[i];
+         chain::signed_transaction& stxn = result[i] = r.trx;
+         const chain::digest_type digest = stxn.sig_digest(r.chain_id, stxn.context_free_data);
+         for (const auto& pk : r.keys) {
+            fc::optional<signature_type> sig = index.at(pk)->try_sign_digest(digest, pk);
+            EOS_ASSERT(sig, chain::wallet_missing_pub_key_exception, "Public key not found in unlocked wallets ${k}", ("k", pk));
+            stxn.signatures.push_back(*sig);
+         }
+      }
+   };
+
+   if (!concurrent || !signing_thread_pool || requests.size() < 2) {
+      sign(0, requests.size());
+      return result;
+   }
+
+   // a contiguous slice of the batch per thread; every slice finishes before result or an exception is returned
+   const size_t slices = std::min(signing_threads, requests.size());
+   std::vector<std::future<void>> futures;
+   futures.reserve(slices);
+   for (size_t s = 0; s < slices; ++s) {
+      const size_t begin = requests.size() * s / slices;
+      const size_t end = requests.size() * (s + 1) / slices;
+      futures.emplace_back(chain::async_thread_pool(signing_thread_pool->get_executor(), [&sign, begin, end]() { sign(begin, end); }));
+   }
+   for (auto& f : futures)
+      f.wait();
+   for (auto& f : futures)
+      f.get();
+   return result;
+}
+
+void wallet_manager::set_signing_threads(size_t num_threads) {
+   EOS_ASSERT(num_threads > 0, chain::wallet_exception, "signing threads must be at least 1");
+   signing_thread_pool.reset();
+   signing_threads = num_threads;
+   if (num_threads > 1)
+      signing_thread_pool = std::make_unique<chain::named_thread_pool>("sign", num_threads);
+}
+
 chain::signature_type
 wallet_manager::sign_digest(const chain::digest_type& digest, const public_key_type& key) {
    check_timeout();
 
    try {
-      for (const auto& i : wallets) {
-         if (!i.second->is_locked()) {
-            fc::optional<signature_type> sig = i.second->try_sign_digest(digest, key);
-            if (sig)
-               return *sig;
-         }
+      const auto& index = key_index();
+      auto it = index.find(key);
+      if (it != index.end()) {
+         fc::optional<signature_type> sig = it->second->try_sign_digest(digest, key);
+         if (sig)
+            return *sig;
       }
    } FC_LOG_AND_RETHROW();
 
@@ -269,9 +333,25 @@ wallet_manager::sign_digest(const chain::digest_type& digest, const public_key_t
 void wallet_manager::own_and_use_wallet(const string& name, std::unique_ptr<wallet_api>&& wallet) {
    if(wallets.find(name) != wallets.end())
       EOS_THROW(wallet_exception, "Tried to use wallet name that already exists.");
+   key_index_valid = false;
    wallets.emplace(name, std::move(wallet));
 }
 
+const std::map<public_key_type, wallet_api*>& wallet_manager::key_index() {
+   if (!key_index_valid) {
+      _key_index.clear();
+      // wallets in name order, so a key held by several maps to the first, as a scan of the wallets would find it
+      for (const auto& i : wallets) {
+         if (i.second->is_locked())
+            continue;
+         for (const auto& pk : i.second->list_public_keys())
+            _key_index.emplace(pk, i.second.get());
+      }
+      key_index_valid = true;
+   }
+   return _key_index;
+}
+
 void wallet_manager::start_lock_watch(std::shared_ptr<boost::asio::deadline_timer> t)
 {
    t->async_wait([t, this](const boost::system::error_code& /*ec*/)
@@ -27,10 +27,14 @@ void wallet_plugin::set_program_options(options_description& cli, options_descri
           "Timeout for unlocked wallet in seconds (default 900 (15 minutes)). "
           "Wallets will automatically lock after specified number of seconds of inactivity. "
           "Activity is defined as any wallet command e.g. list-wallets.")
+         ("signing-threads", bpo::value<uint16_t>()->default_value(2),
+          "Number of threads sign_transactions signs a batch of transactions on, 1 to sign on the calling thread")
          ("yubihsm-url", bpo::value<string>()->value_name("URL"),
           "Override default URL of http://localhost:12345 for connecting to yubihsm-connector")
          ("yubihsm-authkey", bpo::value<uint16_t>()->value_name("key_num"),
           "Enables YubiHSM support using given Authkey")
+         ("yubihsm-sessions", bpo::value<uint16_t>()->default_value(1),
+          "Number of YubiHSM sessions to open, each signing one digest at a time; more than 1 lets sign_transactions sign on several threads")
          ;
 }
 
@@ -52,13 +56,20 @@ void wallet_plugin::plugin_initialize(const variables_map& options) {
          std::chrono::seconds t(timeout);
          wallet_manager_ptr->set_timeout(t);
       }
+      if (options.count("signing-threads")) {
+         const auto threads = options.at("signing-threads").as<uint16_t>();
+         EOS_ASSERT(threads > 0, chain::plugin_config_exception, "signing-threads ${n} must be at least 1", ("n", threads));
+         wallet_manager_ptr->set_signing_threads(threads);
+      }
       if (options.count("yubihsm-authkey")) {
          uint16_t key = options.at("yubihsm-authkey").as<uint16_t>();
          string connector_endpoint = "http://localhost:12345";
          if(options.count("yubihsm-url"))
             connector_endpoint = options.at("yubihsm-url").as<string>();
+         const auto sessions = options.at("yubihsm-sessions").as<uint16_t>();
+         EOS_ASSERT(sessions > 0 && sessions <= 16, chain::plugin_config_exception, "yubihsm-sessions ${n} must be between 1 and 16", ("n", sessions));
          try {
-            wallet_manager_ptr->own_and_use_wallet("YubiHSM", make_unique<yubihsm_wallet>(connector_endpoint, key));
+            wallet_manager_ptr->own_and_use_wallet("YubiHSM", make_unique<yubihsm_wallet>(connector_endpoint, key, sessions));
          }FC_LOG_AND_RETHROW()
       }
    } FC_LOG_AND_RETHROW()
@@ -11,6 +11,9 @@
 #include <boost/asio/posix/stream_descriptor.hpp>
 #include <boost/dll/runtime_symbol_info.hpp>
 
+#include <condition_variable>
+#include <mutex>
+
 namespace eosio { namespace wallet {
 
 using namespace fc::crypto::r1;
@@ -20,7 +23,15 @@ namespace detail {
 struct yubihsm_wallet_impl {
    using key_map_type = map<public_key_type,uint16_t>;
 
-   yubihsm_wallet_impl(const string& ep, const uint16_t ak) : endpoint(ep), authkey(ak) {
+   /// a session signs one command at a time; each has its own EC_KEY since recovering the public key writes into it,
+   /// and its own connector since a yh_connector is not thread safe
+   struct hsm_session {
+      yh_connector* connector = nullptr;
+      yh_session* session = nullptr;
+      fc::ec_key key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
+   };
+
+   yubihsm_wallet_impl(const string& ep, const uint16_t ak, const uint16_t sessions) : endpoint(ep), authkey(ak), max_sessions(sessions) {
       yh_rc rc;
       if((rc = yh_init()))
          FC_THROW("yubihsm init failure: ${c}", ("c", yh_strerror(rc)));
@@ -34,15 +45,67 @@ struct yubihsm_wallet_impl {
       ///XXX Probably a race condition on timer shutdown and appbase destruction
    }
 
+   /// a wallet whose device failed a command counts as locked until lock() or unlock() cleans it up
    bool is_locked() const {
-      return !connector;
+      std::lock_guard<std::mutex> g(sessions_mtx);
+      return sessions.empty() || failed;
+   }
+
+   hsm_session* acquire_session() {
+      std::unique_lock<std::mutex> g(sessions_mtx);
+      session_returned.wait(g, [&]() { return !idle_sessions.empty() || failed || sessions.empty(); });
+      if(failed || sessions.empty())
+         return nullptr;
+      hsm_session* s = idle_sessions.back();
+      idle_sessions.pop_back();
+      return s;
+   }
+
+   void release_session(hsm_session* s, bool ok) {
+      {
+         std::lock_guard<std::mutex> g(sessions_mtx);
+         idle_sessions.push_back(s);
+         failed |= !ok;
+      }
+      session_returned.notify_all();
+   }
+
+   bool has_failed() const {
+      std::lock_guard<std::mutex> g(sessions_mtx);
+      return failed;
+   }
+
+   yh_session* open_session(const string& password) {
+      yh_rc rc;
+      hsm_session* s;
+      {
+         std::lock_guard<std::mutex> g(sessions_mtx);
+         sessions.push_back(std::make_unique<hsm_session>());
+         s = sessions.back().get();
+         idle_sessions.push_back(s);
+      }
+      if((rc = yh_init_connector(endpoint.c_str(), &s->connector)))
+         FC_THROW_EXCEPTION(chain::wallet_exception, "Failled to initialize yubihsm connector URL: ${c}", ("c", yh_strerror(rc)));
+      if((rc = yh_connect(s->connector, 0)))
+         FC_THROW_EXCEPTION(chain::wallet_exception, "Failed to connect to YubiHSM connector: ${m}", ("m", yh_strerror(rc)));
+      yh_session*& session = s->session;
+      if((rc = yh_create_session_derived(s->connector, authkey, (const uint8_t *)password.data(), password.size(), false, &session)))
+         FC_THROW_EXCEPTION(chain::wallet_exception, "Failed to create YubiHSM session: ${m}", ("m", yh_strerror(rc)));
+      if((rc = yh_authenticate_session(session)))
+         FC_THROW_EXCEPTION(chain::wallet_exception, "Failed to authenticate YubiHSM session: ${m}", ("m", yh_strerror(rc)));
+      return session;
+   }
+
+   /// the first session, which lists and creates keys on the application thread; any session signs
+   yh_session* main_session() const {
+      return sessions.empty() ? nullptr : sessions.front()->session;
    }
 
    key_map_type::iterator populate_key_map_with_keyid(const uint16_t key_id) {
       yh_rc rc;
       size_t blob_sz = 128;
       uint8_t blob[blob_sz];
-      if((rc = yh_util_get_public_key(session, key_id, blob, &blob_sz, nullptr)))
+      if((rc = yh_util_get_public_key(main_session(), key_id, blob, &blob_sz, nullptr)))
          FC_THROW_EXCEPTION(chain::wallet_exception, "yh_util_get_public_key failed: ${m}", ("m", yh_strerror(rc)));
       if(blob_sz != 64)
          FC_THROW_EXCEPTION(chain::wallet_exception, "unexpected pubkey size from yh_util_get_public_key");
@@ -63,15 +126,11 @@ struct yubihsm_wallet_impl {
    void unlock(const string& password) {
       yh_rc rc;
 
+      if(has_failed())
+         lock();
+
       try {
-         if((rc = yh_init_connector(endpoint.c_str(), &connector)))
-            FC_THROW_EXCEPTION(chain::wallet_exception, "Failled to initialize yubihsm connector URL: ${c}", ("c", yh_strerror(rc)));
-         if((rc = yh_connect(connector, 0)))
-            FC_THROW_EXCEPTION(chain::wallet_exception, "Failed to connect to YubiHSM connector: ${m}", ("m", yh_strerror(rc)));
-         if((rc = yh_create_session_derived(connector, authkey, (const uint8_t *)password.data(), password.size(), false, &session)))
-            FC_THROW_EXCEPTION(chain::wallet_exception, "Failed to create YubiHSM session: ${m}", ("m", yh_strerror(rc)));
-         if((rc = yh_authenticate_session(session)))
-            FC_THROW_EXCEPTION(chain::wallet_exception, "Failed to authenticate YubiHSM session: ${m}", ("m", yh_strerror(rc)));
+         yh_session* session = open_session(password);
 
          yh_object_descriptor authkey_desc;
          if((rc = yh_util_get_object_info(session, authkey, YH_AUTHENTICATION_KEY, &authkey_desc)))
@@ -92,6 +151,10 @@ struct yubihsm_wallet_impl {
 
          for(size_t i = 0; i < found_objects_n; ++i)
             populate_key_map_with_keyid(found_objs[i].id);
+
+         // the rest of the sessions sign alongside the first; the device serves up to 16 at once
+         while(sessions.size() < max_sessions)
+            open_session(password);
       }
       catch(chain::wallet_exception& e) {
          lock();
@@ -102,16 +165,26 @@ struct yubihsm_wallet_impl {
    }
 
    void lock() {
-      if(session) {
-         yh_util_close_session(session);
-         yh_destroy_session(&session);
+      {
+         // every signature in flight returns its session before the sessions close
+         std::unique_lock<std::mutex> g(sessions_mtx);
+         failed = true;
+         session_returned.wait(g, [&]() { return idle_sessions.size() == sessions.size(); });
+         for(auto& s : sessions) {
+            if(s->session) {
+               yh_util_close_session(s->session);
+               yh_destroy_session(&s->session);
+            }
+            //it would seem like this would leak-- there is no destroy() call for it. But I clearly can't reuse connectors
+            // as that fails with a "Unable to find a suitable connector"
+            if(s->connector)
+               yh_disconnect(s->connector);
+         }
+         idle_sessions.clear();
+         sessions.clear();
+         failed = false;
       }
-      session = nullptr;
-      if(connector)
-         yh_disconnect(connector);
-      //it would seem like this would leak-- there is no destroy() call for it. But I clearly can't reuse connectors
-      // as that fails with a "Unable to find a suitable connector"
-      connector = nullptr;
+      session_returned.notify_all();
 
       _keys.clear();
       keepalive_timer.cancel();
@@ -120,16 +193,24 @@ struct yubihsm_wallet_impl {
    void prime_keepalive_timer() {
       keepalive_timer.expires_at(std::chrono::steady_clock::now() + std::chrono::seconds(20));
       keepalive_timer.async_wait([this](const boost::system::error_code& ec){
-         if(ec || !session)
+         if(ec || !main_session())
             return;
-
-         uint8_t data, resp;
-         yh_cmd resp_cmd;
-         size_t resp_sz = 1;
-         if(yh_send_secure_msg(session, YHC_ECHO, &data, 1, &resp_cmd, &resp, &resp_sz))
+         if(has_failed()) {
             lock();
-         else
-            prime_keepalive_timer();
+            return;
+         }
+
+         // runs on the application thread, which waits out any batch being signed, so every session is idle
+         for(auto& s : sessions) {
+            uint8_t data, resp;
+            yh_cmd resp_cmd;
+            size_t resp_sz = 1;
+            if(yh_send_secure_msg(s->session, YHC_ECHO, &data, 1, &resp_cmd, &resp, &resp_sz)) {
+               lock();
+               return;
+            }
+         }
+         prime_keepalive_timer();
       });
    }
 
@@ -138,11 +219,18 @@ struct yubihsm_wallet_impl {
       if(it == _keys.end())
          return fc::optional<signature_type>{};
 
+      hsm_session* session = acquire_session();
+      if(!session)
+         return fc::optional<signature_type>{};
+
       size_t der_sig_sz = 128;
       uint8_t der_sig[der_sig_sz];
       yh_rc rc;
-      if((rc = yh_util_sign_ecdsa(session, it->second, (uint8_t*)d.data(), d.data_size(), der_sig, &der_sig_sz))) {
-         lock();
+      if((rc = yh_util_sign_ecdsa(session->session, it->second, (uint8_t*)d.data(), d.data_size(), der_sig, &der_sig_sz))) {
+         // other sessions may still be signing; the wallet reads as locked and closes them once they are done
+         release_session(session, false);
+         if(max_sessions == 1)
+            lock();
          FC_THROW_EXCEPTION(chain::wallet_exception, "yh_util_sign_ecdsa failed: ${m}", ("m", yh_strerror(rc)));
       }
 
@@ -159,7 +247,13 @@ struct yubihsm_wallet_impl {
       public_key_data* kd = (public_key_data*)(pub_key_shim_data+1);
 
       compact_signature compact_sig;
-      compact_sig = signature_from_ecdsa(key, *kd, sig, d);
+      try {
+         compact_sig = signature_from_ecdsa(session->key, *kd, sig, d);
+      } catch(...) {
+         release_session(session, true);
+         throw;
+      }
+      release_session(session, true);
 
       char serialized_signature[sizeof(compact_sig) + 1];
       serialized_signature[0] = 0x01;
@@ -182,7 +276,7 @@ struct yubihsm_wallet_impl {
          FC_THROW_EXCEPTION(chain::wallet_exception, "Cannot create caps mask");
 
       try {
-         if((rc = yh_util_generate_ec_key(session, &new_key_id, "keosd created key", authkey_domains, &creation_caps, YH_ALGO_EC_P256)))
+         if((rc = yh_util_generate_ec_key(main_session(), &new_key_id, "keosd created key", authkey_domains, &creation_caps, YH_ALGO_EC_P256)))
             FC_THROW_EXCEPTION(chain::wallet_exception, "yh_util_generate_ec_key failed: ${m}", ("m", yh_strerror(rc)));
          return populate_key_map_with_keyid(new_key_id)->first;
       }
@@ -192,10 +286,15 @@ struct yubihsm_wallet_impl {
       }
    }
 
-   yh_connector* connector = nullptr;
-   yh_session* session = nullptr;
    string endpoint;
    uint16_t authkey;
+   uint16_t max_sessions;
+
+   std::vector<std::unique_ptr<hsm_session>> sessions;
+   std::vector<hsm_session*> idle_sessions;
+   bool failed = false; ///< a session failed a command; set under sessions_mtx
+   mutable std::mutex sessions_mtx;
+   std::condition_variable session_returned;
 
    map<public_key_type,uint16_t> _keys;
 
@@ -203,13 +302,12 @@ struct yubihsm_wallet_impl {
    uint16_t authkey_domains;
 
    boost::asio::steady_timer keepalive_timer{appbase::app().get_io_service()};
-   fc::ec_key key = EC_KEY_new_by_curve_name(NID_X9_62_prime256v1);
 };
 
 
 }
 
-yubihsm_wallet::yubihsm_wallet(const string& connector, const uint16_t authkey) : my(new detail::yubihsm_wallet_impl(connector, authkey)) {
+yubihsm_wallet::yubihsm_wallet(const string& connector, const uint16_t authkey, const uint16_t sessions) : my(new detail::yubihsm_wallet_impl(connector, authkey, sessions)) {
 }
 
 yubihsm_wallet::~yubihsm_wallet() {
@@ -265,4 +363,8 @@ fc::optional<signature_type> yubihsm_wallet::try_sign_digest(const digest_type d
    return my->try_sign_digest(digest, public_key);
 }
 
+bool yubihsm_wallet::concurrent_signing() const {
+   return my->max_sessions > 1;
+}
+
 }}
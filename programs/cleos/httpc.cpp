@@ -8,9 +8,12 @@
 // file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
 //
 
+#include <cstdlib>
 #include <iostream>
+#include <map>
 #include <istream>
 #include <ostream>
+#include <sstream>
 #include <string>
 #include <regex>
 #include <boost/algorithm/string.hpp>
@@ -30,9 +33,19 @@ using namespace eosio::chain;
 namespace eosio { namespace client { namespace http {
 
    namespace detail {
+      /// an open connection, kept for the next call to the same server while the server keeps it alive
+      struct http_connection {
+         std::unique_ptr<boost::asio::local::stream_protocol::socket>        unix_socket;
+         std::unique_ptr<tcp::socket>                                        tcp_socket;
+         std::unique_ptr<boost::asio::ssl::context>                          ssl_context;
+         std::unique_ptr<boost::asio::ssl::stream<tcp::socket>>              ssl_socket;
+      };
+
       class http_context_impl {
          public:
             boost::asio::io_service ios;
+            std::map<string, resolved_url>    resolved_urls;  ///< by server and port, resolved once per process
+            std::map<string, http_connection> connections;    ///< by scheme, server, port and certificate verification
       };
 
       void http_context_deleter::operator()(http_context_impl* p) const {
@@ -54,16 +67,49 @@ namespace eosio { namespace client { namespace http {
       boost::asio::connect(sock, endpoints);
    }
 
+   // reads a chunked transfer-coded body, response holds what was already read past the headers
+   template<class T>
+   std::string read_chunked_body(T& socket, boost::asio::streambuf& response) {
+      std::istream response_stream(&response);
+      std::string body, line;
+      while (true) {
+         boost::asio::read_until(socket, response, "\r\n");
+         std::getline(response_stream, line); // chunk size in hex, optionally followed by ;extensions
+         char* end = nullptr;
+         const size_t chunk_size = std::strtoul(line.c_str(), &end, 16);
+         EOS_ASSERT( end != line.c_str(), invalid_http_response, "Invalid chunk size in response" );
+         if (chunk_size == 0)
+            break;
+         if (response.size() < chunk_size + 2)
+            boost::asio::read(socket, response, boost::asio::transfer_exactly(chunk_size + 2 - response.size()));
+         const size_t start = body.size();
+         body.resize(start + chunk_size);
+         response_stream.read(&body[start], chunk_size);
+         response_stream.ignore(2); // CRLF ending the chunk
+      }
+      // optional trailer fields, ended by an empty line
+      do {
+         boost::asio::read_until(socket, response, "\r\n");
+         std::getline(response_stream, line);
+      } while (line != "\r");
+      return body;
+   }
+
+   // keep_alive is set when the connection can carry the next request; responded once any of the response arrived
    template<class T>
-   std::string do_txrx(T& socket, boost::asio::streambuf& request_buff, unsigned int& status_code) {
+   std::string do_txrx(T& socket, const std::string& request, unsigned int& status_code, bool& keep_alive, bool& responded) {
+      keep_alive = false;
+      responded = false;
+
       // Send the request.
-      boost::asio::write(socket, request_buff);
+      boost::asio::write(socket, boost::asio::buffer(request));
 
       // Read the response status line. The response streambuf will automatically
       // grow to accommodate the entire line. The growth may be limited by passing
       // a maximum size to the streambuf constructor.
       boost::asio::streambuf response;
       boost::asio::read_until(socket, response, "\r\n");
+      responded = true;
 
       // Check that response is OK.
       std::istream response_stream(&response);
@@ -81,11 +127,26 @@ namespace eosio { namespace client { namespace http {
       // Process the response headers.
       std::string header;
       int response_content_length = -1;
+      bool chunked = false;
+      bool connection_close = http_version != "HTTP/1.1";
       std::regex clregex(R"xx(^content-length:\s+(\d+))xx", std::regex_constants::icase);
+      std::regex connregex(R"xx(^connection:\s*(\S+))xx", std::regex_constants::icase);
+      std::regex teregex(R"xx(^transfer-encoding:.*chunked)xx", std::regex_constants::icase);
       while (std::getline(response_stream, header) && header != "\r") {
          std::smatch match;
          if(std::regex_search(header, match, clregex))
             response_content_length = std::stoi(match[1]);
+         else if(std::regex_search(header, match, connregex))
+            connection_close = boost::algorithm::iequals(match.str(1), "close");
+         else if(std::regex_search(header, teregex))
+            chunked = true;
+      }
+
+      if( chunked ) {
+         // the last chunk ends the body, a content-length alongside it is ignored
+         auto body = read_chunked_body(socket, response);
+         keep_alive = !connection_close;
+         return body;
       }
 
       // Attempt to read the response body using the length indicated by the
@@ -94,6 +155,8 @@ namespace eosio { namespace client { namespace http {
          response_content_length -= response.size();
          if( response_content_length > 0 )
             boost::asio::read(socket, response, boost::asio::transfer_exactly(response_content_length));
+         // a body of exactly the announced length leaves the connection at the start of the next response
+         keep_alive = !connection_close && response_content_length >= 0;
       } else {
          boost::system::error_code ec;
          boost::asio::read(socket, response, boost::asio::transfer_all(), ec);
@@ -139,6 +202,13 @@ namespace eosio { namespace client { namespace http {
       if(url.scheme == "unix")
          return resolved_url(url);
 
+      const string key = url.server + ":" + url.port;
+      auto cached = context->resolved_urls.find(key);
+      if (cached != context->resolved_urls.end()) {
+         auto addresses = cached->second.resolved_addresses;
+         return resolved_url(url, std::move(addresses), cached->second.resolved_port, cached->second.is_loopback);
+      }
+
       tcp::resolver resolver(context->ios);
       boost::system::error_code ec;
       auto result = resolver.resolve(tcp::v4(), url.server, url.port, ec);
@@ -166,7 +236,9 @@ namespace eosio { namespace client { namespace http {
          }
       }
 
-      return resolved_url(url, std::move(resolved_addresses), *resolved_port, is_loopback);
+      resolved_url resolved(url, std::move(resolved_addresses), *resolved_port, is_loopback);
+      context->resolved_urls.emplace(key, resolved);
+      return resolved;
    }
 
    string format_host_header(const resolved_url& url) {
@@ -181,6 +253,58 @@ namespace eosio { namespace client { namespace http {
       }
    }
 
+   detail::http_connection open_connection( const connection_param& cp ) {
+      const auto& url = cp.url;
+      detail::http_connection c;
+      if(url.scheme == "unix") {
+         c.unix_socket = std::make_unique<boost::asio::local::stream_protocol::socket>(cp.context->ios);
+         c.unix_socket->connect(boost::asio::local::stream_protocol::endpoint(url.server));
+      }
+      else if(url.scheme == "http") {
+         c.tcp_socket = std::make_unique<tcp::socket>(cp.context->ios);
+         do_connect(*c.tcp_socket, url);
+      }
+      else { //https
+         c.ssl_context = std::make_unique<boost::asio::ssl::context>(boost::asio::ssl::context::sslv23_client);
+         fc::add_platform_root_cas_to_context(*c.ssl_context);
+
+         c.ssl_socket = std::make_unique<boost::asio::ssl::stream<tcp::socket>>(cp.context->ios, *c.ssl_context);
+         auto& socket = *c.ssl_socket;
+         SSL_set_tlsext_host_name(socket.native_handle(), url.server.c_str());
+         if(cp.verify_cert) {
+            socket.set_verify_mode(boost::asio::ssl::verify_peer);
+            socket.set_verify_callback(boost::asio::ssl::rfc2818_verification(url.server));
+         }
+         do_connect(socket.next_layer(), url);
+         socket.handshake(boost::asio::ssl::stream_base::client);
+      }
+      return c;
+   }
+
+   void close_connection( detail::http_connection& c ) {
+      //try and do a clean shutdown; but swallow if this fails (other side could have already gave TCP the ax)
+      if(c.ssl_socket)
+         try {c.ssl_socket->shutdown();} catch(...) {}
+   }
+
+   std::string send_request( detail::http_connection& c, const std::string& request, unsigned int& status_code,
+                             bool& keep_alive, bool& responded ) {
+      if(c.unix_socket)
+         return do_txrx(*c.unix_socket, request, status_code, keep_alive, responded);
+      else if(c.tcp_socket)
+         return do_txrx(*c.tcp_socket, request, status_code, keep_alive, responded);
+      else
+         return do_txrx(*c.ssl_socket, request, status_code, keep_alive, responded);
+   }
+
+   // calls that may be sent twice: reads, ABI conversions and signing
+   bool is_idempotent_call( const string& path ) {
+      const string call = path.substr(path.rfind('/') + 1);
+      return boost::algorithm::starts_with(call, "get_") || boost::algorithm::starts_with(call, "abi_") ||
+             boost::algorithm::starts_with(call, "sign_") || call == "list_wallets" || call == "list_keys" ||
+             call == "status" || call == "connections";
+   }
+
    fc::variant do_http_call( const connection_param& cp,
                              const fc::variant& postdata,
                              bool print_request,
@@ -191,15 +315,18 @@ namespace eosio { namespace client { namespace http {
    }
 
    const auto& url = cp.url;
+   // other calls go on a connection of their own, which the server closes after the response, so a failure is
+   // never ambiguous about whether the server saw the request and nothing is ever sent twice
+   const bool reusable = is_idempotent_call(url.path);
 
-   boost::asio::streambuf request;
-   std::ostream request_stream(&request);
+   std::ostringstream request_stream;
    auto host_header_value = format_host_header(url);
-   request_stream << "POST " << url.path << " HTTP/1.0\r\n";
+   request_stream << "POST " << url.path << " HTTP/1.1\r\n";
    request_stream << "Host: " << host_header_value << "\r\n";
    request_stream << "content-length: " << postjson.size() << "\r\n";
    request_stream << "Accept: */*\r\n";
-   request_stream << "Connection: close\r\n";
+   if (!reusable)
+      request_stream << "Connection: close\r\n";
    // append more customized headers
    std::vector<string>::iterator itr;
    for (itr = cp.headers.begin(); itr != cp.headers.end(); itr++) {
@@ -207,45 +334,49 @@ namespace eosio { namespace client { namespace http {
    }
    request_stream << "\r\n";
    request_stream << postjson;
+   const std::string request = request_stream.str();
 
    if ( print_request ) {
-      string s(request.size(), '\0');
-      buffer_copy(boost::asio::buffer(s), request.data());
       std::cerr << "REQUEST:" << std::endl
                 << "---------------------" << std::endl
-                << s << std::endl
+                << request << std::endl
                 << "---------------------" << std::endl;
    }
 
    unsigned int status_code;
    std::string re;
 
+   // connections of idempotent calls stay open for the following calls of this process to the same server
+   auto& connections = cp.context->connections;
+   const string connection_key = url.scheme + "://" + url.server + ":" + url.port + (cp.verify_cert ? "" : "#noverify");
    try {
-      if(url.scheme == "unix") {
-         boost::asio::local::stream_protocol::socket unix_socket(cp.context->ios);
-         unix_socket.connect(boost::asio::local::stream_protocol::endpoint(url.server));
-         re = do_txrx(unix_socket, request, status_code);
+      if (!reusable) {
+         auto c = open_connection(cp);
+         bool keep_alive = false, responded = false;
+         re = send_request(c, request, status_code, keep_alive, responded);
+         close_connection(c);
       }
-      else if(url.scheme == "http") {
-         tcp::socket socket(cp.context->ios);
-         do_connect(socket, url);
-         re = do_txrx(socket, request, status_code);
-      }
-      else { //https
-         boost::asio::ssl::context ssl_context(boost::asio::ssl::context::sslv23_client);
-         fc::add_platform_root_cas_to_context(ssl_context);
-
-         boost::asio::ssl::stream<boost::asio::ip::tcp::socket> socket(cp.context->ios, ssl_context);
-         SSL_set_tlsext_host_name(socket.native_handle(), url.server.c_str());
-         if(cp.verify_cert) {
-            socket.set_verify_mode(boost::asio::ssl::verify_peer);
-            socket.set_verify_callback(boost::asio::ssl::rfc2818_verification(url.server));
+      while (reusable) {
+         auto conn = connections.find(connection_key);
+         const bool reused = conn != connections.end();
+         if (!reused)
+            conn = connections.emplace(connection_key, open_connection(cp)).first;
+
+         bool keep_alive = false, responded = false;
+         try {
+            re = send_request(conn->second, request, status_code, keep_alive, responded);
+         } catch (...) {
+            connections.erase(conn);
+            // the server closed a connection idle since the last call before taking the request; send it on a new one
+            if (reused && !responded)
+               continue;
+            throw;
          }
-         do_connect(socket.next_layer(), url);
-         socket.handshake(boost::asio::ssl::stream_base::client);
-         re = do_txrx(socket, request, status_code);
-         //try and do a clean shutdown; but swallow if this fails (other side could have already gave TCP the ax)
-         try {socket.shutdown();} catch(...) {}
+         if (!keep_alive) {
+            close_connection(conn->second);
+            connections.erase(conn);
+         }
+         break;
       }
    } catch ( invalid_http_request& e ) {
       e.append_log( FC_LOG_MESSAGE( info, "Please verify this url is valid: ${url}", ("url", url.scheme + "://" + url.server + ":" + url.port + url.path) ) );
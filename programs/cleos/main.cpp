@@ -65,10 +65,14 @@ Options:
 */
 
 #include <pwd.h>
+#include <unistd.h>
 #include <string>
 #include <vector>
 #include <regex>
 #include <iostream>
+#include <atomic>
+#include <set>
+#include <thread>
 #include <fc/crypto/hex.hpp>
 #include <fc/variant.hpp>
 #include <fc/io/datastream.hpp>
@@ -162,6 +166,7 @@ bfs::path determine_home_directory()
 string url = "http://127.0.0.1:8888/";
 string default_wallet_url = "unix://" + (determine_home_directory() / "eosio-wallet" / (string(key_store_executable_name) + ".sock")).string();
 string wallet_url; //to be set to default_wallet_url in main
+string abi_cache_dir = (determine_home_directory() / ".cache" / "cleos" / "abi").string();
 bool no_verify = false;
 vector<string> headers;
 
@@ -303,22 +308,25 @@ void sign_transaction(signed_transaction& trx, fc::variant& required_keys, const
    trx = signed_trx.as<signed_transaction>();
 }
 
+// tapos block, defaults to last irreversible block if it's not specified by the user
+block_id_type get_ref_block_id( const eosio::chain_apis::read_only::get_info_results& info ) {
+   block_id_type ref_block_id = info.last_irreversible_block_id;
+   try {
+      fc::variant ref_block;
+      if (!tx_ref_block_num_or_id.empty()) {
+         ref_block = call(get_block_func, fc::mutable_variant_object("block_num_or_id", tx_ref_block_num_or_id));
+         ref_block_id = ref_block["id"].as<block_id_type>();
+      }
+   } EOS_RETHROW_EXCEPTIONS(invalid_ref_block_exception, "Invalid reference block num or id: ${block_num_or_id}", ("block_num_or_id", tx_ref_block_num_or_id));
+   return ref_block_id;
+}
+
 fc::variant push_transaction( signed_transaction& trx, packed_transaction::compression_type compression = packed_transaction::compression_type::none ) {
    auto info = get_info();
 
    if (trx.signatures.size() == 0) { // #5445 can't change txn content if already signed
       trx.expiration = info.head_block_time + tx_expiration;
-
-      // Set tapos, default to last irreversible block if it's not specified by the user
-      block_id_type ref_block_id = info.last_irreversible_block_id;
-      try {
-         fc::variant ref_block;
-         if (!tx_ref_block_num_or_id.empty()) {
-            ref_block = call(get_block_func, fc::mutable_variant_object("block_num_or_id", tx_ref_block_num_or_id));
-            ref_block_id = ref_block["id"].as<block_id_type>();
-         }
-      } EOS_RETHROW_EXCEPTIONS(invalid_ref_block_exception, "Invalid reference block num or id: ${block_num_or_id}", ("block_num_or_id", tx_ref_block_num_or_id));
-      trx.set_reference_block(ref_block_id);
+      trx.set_reference_block(get_ref_block_id(info));
 
       if (tx_force_unique) {
          trx.context_free_actions.emplace_back( generate_nonce_action() );
@@ -389,17 +397,68 @@ void print_action( const fc::variant& at ) {
    }
 }
 
+/// Raw abi of account, kept in abi_cache_dir between runs. The node is sent the hash of the kept copy and only returns
+/// the abi when it differs, so an unchanged abi costs a small reply. Empty when the account has no abi.
+bytes get_raw_abi_cached( const name& account ) {
+   bfs::path cache_file;
+   bytes cached;
+   fc::optional<fc::sha256> cached_hash;
+   auto args = fc::mutable_variant_object("account_name", account);
+   if( !abi_cache_dir.empty() ) {
+      cache_file = bfs::path( abi_cache_dir ) / (account.to_string() + ".abi");
+      std::ifstream in( cache_file.string(), std::ios::binary );
+      if( in ) {
+         cached.assign( std::istreambuf_iterator<char>( in ), std::istreambuf_iterator<char>() );
+         if( !cached.empty() ) {
+            cached_hash = fc::sha256::hash( cached.data(), cached.size() );
+            args( "abi_hash", *cached_hash );
+         }
+      }
+   }
+
+   const auto result = call(get_raw_abi_func, args).as<eosio::chain_apis::read_only::get_raw_abi_results>();
+   if( !result.abi ) {
+      EOSC_ASSERT( cached_hash && *cached_hash == result.abi_hash, "ERROR: ${n} returned no abi for ${a}", ("n", node_executable_name)("a", account) );
+      return cached;
+   }
+   bytes abi( result.abi->data.begin(), result.abi->data.end() );
+   if( !cache_file.empty() && !abi.empty() ) {
+      // the cache only saves round trips, so failing to write it is not an error; the rename keeps readers from a partial file
+      boost::system::error_code ec;
+      bfs::create_directories( cache_file.parent_path(), ec );
+      const bfs::path tmp = cache_file.string() + "." + std::to_string( getpid() );
+      {
+         std::ofstream out( tmp.string(), std::ios::binary | std::ios::trunc );
+         out.write( abi.data(), abi.size() );
+      }
+      bfs::rename( tmp, cache_file, ec );
+      if( ec )
+         bfs::remove( tmp, ec );
+   }
+   return abi;
+}
+
 //resolver for ABI serializer to decode actions in proposed transaction in multisig contract
 auto abi_serializer_resolver = [](const name& account) -> fc::optional<abi_serializer> {
    static unordered_map<account_name, fc::optional<abi_serializer> > abi_cache;
    auto it = abi_cache.find( account );
    if ( it == abi_cache.end() ) {
-      auto result = call(get_abi_func, fc::mutable_variant_object("account_name", account));
-      auto abi_results = result.as<eosio::chain_apis::read_only::get_abi_results>();
+      fc::optional<abi_def> abi;
+      try {
+         const auto raw_abi = get_raw_abi_cached( account );
+         if( !raw_abi.empty() )
+            abi = fc::raw::unpack<abi_def>( raw_abi );
+      } catch( const connection_exception& ) {
+         throw;
+      } catch( const fc::exception& ) {
+         // a node without get_raw_abi, or an abi this cleos cannot unpack; the node serializes it to json instead
+         auto result = call(get_abi_func, fc::mutable_variant_object("account_name", account));
+         abi = result.as<eosio::chain_apis::read_only::get_abi_results>().abi;
+      }
 
       fc::optional<abi_serializer> abis;
-      if( abi_results.abi.valid() ) {
-         abis.emplace( *abi_results.abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
+      if( abi.valid() ) {
+         abis.emplace( *abi, abi_serializer::create_yield_function( abi_serializer_max_time ) );
       } else {
          std::cerr << "ABI for contract " << account.to_string() << " not found. Action data will be shown in hex only." << std::endl;
       }
@@ -559,6 +618,172 @@ void send_transaction( signed_transaction& trx, packed_transaction::compression_
    }
 }
 
+struct bulk_entry {
+   uint64_t           line = 0;
+   signed_transaction trx;
+   fc::variant        result;
+   string             error;   ///< set instead of result when the line could not be read, signed or pushed
+};
+
+/// a JSON action, or an array of them, as in a transaction's "actions"; without "authorization" an action takes -p
+signed_transaction bulk_line_to_transaction( const fc::variant& line_var ) {
+   signed_transaction trx;
+   const fc::variants actions = line_var.is_array() ? line_var.get_array() : fc::variants{ line_var };
+   EOSC_ASSERT( !actions.empty(), "ERROR: a line must hold at least one action" );
+   for( const auto& a : actions ) {
+      const auto& obj = a.get_object();
+      const name account( obj["account"].as_string() );
+      const name act( obj["name"].as_string() );
+      auto auth = obj.contains( "authorization" ) ? obj["authorization"].as<vector<chain::permission_level>>()
+                                                  : get_account_permissions( tx_permission );
+      EOSC_ASSERT( !auth.empty(), "ERROR: ${a}::${n} has no authorization; give one in the line or with -p", ("a", account)("n", act) );
+      // data already packed is given as a hex string, otherwise it is packed with the contract's abi
+      bytes data = obj.contains( "data" ) && obj["data"].is_string() ? obj["data"].as<bytes>()
+                 : variant_to_bin( account, act, obj.contains( "data" ) ? obj["data"] : fc::variant() );
+      trx.actions.emplace_back( std::move(auth), account, act, std::move(data) );
+   }
+   return trx;
+}
+
+/// Pushes a transaction for each non-empty line of in. The reference block and abis are fetched once, required keys
+/// once per set of authorizations, and each batch is signed in one wallet request, or with key when given. Up to
+/// concurrency transactions are in flight at once, each sender on its own connection, and results print a line each
+/// in input order.
+void push_bulk( std::istream& in, size_t concurrency, size_t batch_size, const fc::optional<private_key_type>& key ) {
+   auto info = get_info();
+   auto info_time = fc::time_point::now();
+   auto ref_block_id = get_ref_block_id( info );
+
+   fc::variant public_keys;
+   std::map<std::set<chain::permission_level>, fc::variant> required_keys_by_auth;
+   vector<eosio::client::http::http_context> contexts;
+   for( size_t i = 0; i < concurrency; ++i )
+      contexts.emplace_back( eosio::client::http::create_http_context() );
+
+   uint64_t line_num = 0;
+   string line;
+   bool more = true;
+   while( more ) {
+      vector<bulk_entry> batch;
+      while( batch.size() < batch_size && (more = bool(std::getline( in, line ))) ) {
+         ++line_num;
+         if( line.find_first_not_of( " \t\r" ) == string::npos )
+            continue;
+         bulk_entry e;
+         e.line = line_num;
+         try {
+            e.trx = bulk_line_to_transaction( fc::json::from_string( line, fc::json::parse_type::relaxed_parser ) );
+         } catch( const fc::exception& ex ) {
+            e.error = ex.to_string();
+         }
+         batch.emplace_back( std::move(e) );
+      }
+      if( batch.empty() )
+         break;
+
+      // a long run moves to a newer reference block before half the expiration window has passed
+      if( fc::time_point::now() - info_time > tx_expiration / 2 ) {
+         info = get_info();
+         info_time = fc::time_point::now();
+         ref_block_id = get_ref_block_id( info );
+      }
+      const fc::time_point_sec expiration = info.head_block_time + (fc::time_point::now() - info_time) + tx_expiration;
+
+      fc::variants sign_requests;
+      vector<bulk_entry*> to_sign;
+      for( auto& e : batch ) {
+         if( !e.error.empty() )
+            continue;
+         auto& trx = e.trx;
+         trx.expiration = expiration;
+         trx.set_reference_block( ref_block_id );
+         if( tx_force_unique )
+            trx.context_free_actions.emplace_back( generate_nonce_action() );
+         trx.max_cpu_usage_ms = tx_max_cpu_usage;
+         trx.max_net_usage_words = (tx_max_net_usage + 7)/8;
+         trx.delay_sec = delaysec;
+         if( tx_skip_sign )
+            continue;
+         if( key ) {
+            trx.sign( *key, info.chain_id );
+            continue;
+         }
+
+         std::set<chain::permission_level> auths;
+         for( const auto& a : trx.actions )
+            auths.insert( a.authorization.begin(), a.authorization.end() );
+         auto it = required_keys_by_auth.find( auths );
+         if( it == required_keys_by_auth.end() ) {
+            try {
+               if( public_keys.is_null() )
+                  public_keys = call( wallet_url, wallet_public_keys );
+               auto get_arg = fc::mutable_variant_object
+                       ("transaction", (transaction)trx)
+                       ("available_keys", public_keys);
+               it = required_keys_by_auth.emplace( auths, call( get_required_keys, get_arg )["required_keys"] ).first;
+            } catch( const fc::exception& ex ) {
+               e.error = ex.to_string();
+               continue;
+            }
+         }
+         sign_requests.emplace_back( fc::variants{ fc::variant(trx), it->second, fc::variant(info.chain_id) } );
+         to_sign.push_back( &e );
+      }
+      if( !sign_requests.empty() ) {
+         auto signed_trxs = call( wallet_url, wallet_sign_trxs, sign_requests ).as<vector<signed_transaction>>();
+         EOSC_ASSERT( signed_trxs.size() == to_sign.size(), "ERROR: ${k} returned ${n} transactions for ${r} sign requests",
+                      ("k", key_store_executable_name)("n", signed_trxs.size())("r", to_sign.size()) );
+         for( size_t i = 0; i < to_sign.size(); ++i )
+            to_sign[i]->trx = std::move( signed_trxs[i] );
+      }
+
+      if( !tx_dont_broadcast ) {
+         const auto push_url = parse_url( url ) + (tx_use_old_rpc ? push_txn_func : send_txn_func);
+         std::atomic<size_t> next{0};
+         auto send = [&]( const eosio::client::http::http_context& ctx ) {
+            for( size_t i = next++; i < batch.size(); i = next++ ) {
+               auto& e = batch[i];
+               if( !e.error.empty() )
+                  continue;
+               try {
+                  eosio::client::http::connection_param cp( ctx, push_url, no_verify ? false : true, headers );
+                  e.result = eosio::client::http::do_http_call( cp, fc::variant( packed_transaction( e.trx, packed_transaction::compression_type::none ) ),
+                                                                print_request, print_response );
+               } catch( const fc::exception& ex ) {
+                  e.error = ex.to_string();
+               } catch( const std::exception& ex ) {
+                  e.error = ex.what();
+               }
+            }
+         };
+         vector<std::thread> senders;
+         for( size_t t = 1; t < std::min( concurrency, batch.size() ); ++t )
+            senders.emplace_back( send, std::cref( contexts[t] ) );
+         send( contexts[0] );
+         for( auto& t : senders )
+            t.join();
+      }
+
+      for( const auto& e : batch ) {
+         fc::mutable_variant_object out( "line", e.line );
+         if( !e.error.empty() ) {
+            out( "error", e.error );
+         } else if( tx_dont_broadcast ) {
+            out( "transaction", tx_return_packed ? fc::variant( packed_transaction( e.trx, packed_transaction::compression_type::none ) )
+                                                 : fc::variant( e.trx ) );
+         } else if( tx_print_json ) {
+            out( "result", e.result );
+         } else {
+            const auto& result = e.result.get_object();
+            out( "transaction_id", result["transaction_id"] );
+            if( result.contains( "processed" ) && result["processed"].get_object().contains( "receipt" ) )
+               out( "receipt", result["processed"]["receipt"] );
+         }
+         std::cout << fc::json::to_string( out, fc::time_point::maximum() ) << std::endl;
+      }
+   }
+}
+
 chain::permission_level to_permission_level(const std::string& s) {
    auto at_pos = s.find('@');
    return permission_level { name(s.substr(0, at_pos)), name(s.substr(at_pos + 1)) };
@@ -2411,6 +2636,7 @@ int main( int argc, char** argv ) {
 
    app.add_option( "-r,--header", header_opt_callback, localized("pass specific HTTP header; repeat this option to pass multiple headers"));
    app.add_flag( "-n,--no-verify", no_verify, localized("don't verify peer certificate when using HTTPS"));
+   app.add_option( "--abi-cache-dir", abi_cache_dir, localized("the directory contract abis are kept in between runs, checked against the node's abi hash before use; empty to not keep them"), true );
    app.add_flag( "--no-auto-" + string(key_store_executable_name), no_auto_keosd, localized("don't automatically launch a ${k} if one is not currently running", ("k", key_store_executable_name)));
    app.set_callback([&app]{ ensure_keosd_running(&app);});
 
@@ -3484,6 +3710,34 @@ int main( int argc, char** argv ) {
    });
 
 
+   // push bulk
+   string bulk_input = "-";
+   size_t bulk_concurrency = 4;
+   size_t bulk_batch = 100;
+   string bulk_private_key;
+   auto bulkSubcommand = push->add_subcommand("bulk", localized("Push a transaction for each line of JSON actions, signing in batches and sending several at once"));
+   bulkSubcommand->add_option("file", bulk_input, localized("The file with a JSON action, or an array of actions, on each line; - reads standard input"), true);
+   bulkSubcommand->add_option("--concurrency", bulk_concurrency, localized("The number of transactions in flight at once, each on its own connection"), true);
+   bulkSubcommand->add_option("--batch", bulk_batch, localized("The number of transactions read, signed in one wallet request and pushed before their results print"), true);
+   bulkSubcommand->add_option("-k,--private-key", bulk_private_key, localized("The private key to sign every transaction with, instead of the wallet"));
+   add_standard_transaction_options(bulkSubcommand);
+   bulkSubcommand->set_callback([&] {
+      EOSC_ASSERT( bulk_concurrency > 0 && bulk_batch > 0, "ERROR: --concurrency and --batch must be at least 1" );
+      fc::optional<private_key_type> priv_key;
+      if( !bulk_private_key.empty() ) {
+         try {
+            priv_key = private_key_type(bulk_private_key);
+         } EOS_RETHROW_EXCEPTIONS(private_key_type_exception, "Invalid private key")
+      }
+      if( bulk_input == "-" ) {
+         push_bulk( std::cin, bulk_concurrency, bulk_batch, priv_key );
+      } else {
+         std::ifstream in( bulk_input );
+         EOSC_ASSERT( !in.fail(), "ERROR: Failed to open file \"${p}\"", ("p", bulk_input) );
+         push_bulk( in, bulk_concurrency, bulk_batch, priv_key );
+      }
+   });
+
    // multisig subcommand
    auto msig = app.add_subcommand("multisig", localized("Multisig contract commands"), false);
    msig->require_subcommand();
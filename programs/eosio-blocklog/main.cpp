@@ -1,8 +1,15 @@
 #include <memory>
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/action_index.hpp>
 #include <eosio/chain/block_log.hpp>
 #include <eosio/chain/config.hpp>
 #include <eosio/chain/reversible_block_object.hpp>
+#include <eosio/chain/code_object.hpp>
+#include <eosio/chain/thread_utils.hpp>
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/config.hpp>
+#include <eosio/chain/webassembly/eos-vm-oc/code_cache.hpp>
+#endif
 
 #include <fc/io/json.hpp>
 #include <fc/filesystem.hpp>
@@ -14,7 +21,10 @@
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include <algorithm>
 #include <chrono>
+#include <deque>
+#include <thread>
 
 #ifndef _WIN32
 #define FOPEN(p, m) fopen(p, m)
@@ -44,9 +54,15 @@ struct blocklog {
    uint32_t                         last_block = std::numeric_limits<uint32_t>::max();
    bool                             no_pretty_print = false;
    bool                             as_json_array = false;
+   std::string                      output_format = "json";
+   uint32_t                         threads = 1;
    bool                             make_index = false;
+   bool                             make_action_index = false;
    bool                             trim_log = false;
+   bool                             archive_log = false;
+   uint32_t                         blocks_per_frame = block_log_archive::default_blocks_per_frame;
    bool                             smoke_test = false;
+   bool                             build_oc_cache = false;
    bool                             help = false;
 };
 
@@ -67,7 +83,8 @@ struct report_time {
 
 void blocklog::read_log() {
    report_time rt("reading log");
-   block_log block_logger(blocks_dir);
+   // a mapped log serves concurrent reads from the export workers
+   block_log block_logger(blocks_dir, threads > 1);
    const auto end = block_logger.read_head();
    EOS_ASSERT( end, block_log_exception, "No blocks found in block log" );
    EOS_ASSERT( end->block_num() > 1, block_log_exception, "Only one block found in block log" );
@@ -75,8 +92,15 @@ void blocklog::read_log() {
    //fix message below, first block might not be 1, first_block_num is not set yet
    ilog( "existing block log contains block num ${first} through block num ${n}",
          ("first",block_logger.first_block_num())("n",end->block_num()) );
-   if (first_block < block_logger.first_block_num()) {
-      first_block = block_logger.first_block_num();
+   uint32_t first_readable = block_logger.first_block_num();
+   if (block_log_archive::exists(blocks_dir)) {
+      block_log_archive archive(blocks_dir);
+      ilog( "block log archive contains block num ${first} through block num ${n}",
+            ("first",archive.first_block_num())("n",archive.last_block_num()) );
+      first_readable = std::min(first_readable, archive.first_block_num());
+   }
+   if (first_block < first_readable) {
+      first_block = first_readable;
    }
 
    optional<chainbase::database> reversible_blocks;
@@ -103,7 +127,7 @@ void blocklog::read_log() {
    std::ofstream output_blocks;
    std::ostream* out;
    if (!output_file.empty()) {
-      output_blocks.open(output_file.generic_string().c_str());
+      output_blocks.open(output_file.generic_string().c_str(), std::ios::out | std::ios::binary);
       if (output_blocks.fail()) {
          std::ostringstream ss;
          ss << "Unable to open file '" << output_file.string() << "'";
@@ -117,45 +141,104 @@ void blocklog::read_log() {
    if (as_json_array)
       *out << "[";
    uint32_t block_num = (first_block < 1) ? 1 : first_block;
-   signed_block_ptr next;
-   fc::variant pretty_output;
    const fc::microseconds deadline = fc::seconds(10);
-   auto print_block = [&](signed_block_ptr& next) {
-      abi_serializer::to_variant(*next,
+   const char* const separator = as_json_array ? "," : "";
+   // appends the output for one block to buf, callable from any worker thread
+   auto format_block = [&](const signed_block& block, std::string& buf) {
+      if (output_format == "binary") {
+         const auto packed = fc::raw::pack(block);
+         const uint32_t size = packed.size();
+         buf.append(reinterpret_cast<const char*>(&size), sizeof(size));
+         buf.append(packed.data(), packed.size());
+         return;
+      }
+      fc::variant pretty_output;
+      abi_serializer::to_variant(block,
                                  pretty_output,
                                  []( account_name n ) { return optional<abi_serializer>(); },
                                  abi_serializer::create_yield_function( deadline ));
-      const auto block_id = next->id();
+      const auto block_id = block.id();
       const uint32_t ref_block_prefix = block_id._hash[1];
       const auto enhanced_object = fc::mutable_variant_object
-                 ("block_num",next->block_num())
+                 ("block_num",block.block_num())
                  ("id", block_id)
                  ("ref_block_prefix", ref_block_prefix)
                  (pretty_output.get_object());
       fc::variant v(std::move(enhanced_object));
-      if (no_pretty_print)
-         fc::json::to_stream(*out, v, fc::time_point::maximum(), fc::json::output_formatting::stringify_large_ints_and_doubles);
-      else
-         *out << fc::json::to_pretty_string(v) << "\n";
+      if (output_format == "ndjson") {
+         buf += fc::json::to_string(v, fc::time_point::maximum(), fc::json::output_formatting::stringify_large_ints_and_doubles);
+         buf += "\n";
+      } else if (no_pretty_print) {
+         buf += fc::json::to_string(v, fc::time_point::maximum(), fc::json::output_formatting::stringify_large_ints_and_doubles);
+      } else {
+         buf += fc::json::to_pretty_string(v);
+         buf += "\n";
+      }
    };
    bool contains_obj = false;
-   while((block_num <= last_block) && (next = block_logger.read_block_by_num( block_num ))) {
-      if (as_json_array && contains_obj)
-         *out << ",";
-      print_block(next);
-      ++block_num;
+   auto write_chunk = [&](const std::string& chunk) {
+      if (chunk.empty())
+         return;
+      if (contains_obj)
+         *out << separator;
+      out->write(chunk.data(), chunk.size());
       contains_obj = true;
+   };
+
+   const uint32_t log_last = std::min(last_block, end->block_num());
+   if (threads > 1 && block_num <= log_last) {
+      // the range is cut into chunks that workers read and format independently; at most a few chunks per worker
+      // are in flight and they are written out in block order as they complete
+      constexpr uint32_t chunk_blocks = 256;
+      auto format_chunk = [&](uint32_t first, uint32_t last) {
+         std::string chunk;
+         for (uint32_t n = first; n <= last; ++n) {
+            auto next = block_logger.read_block_by_num(n);
+            EOS_ASSERT( next, block_log_exception, "Block ${n} could not be read from the block log", ("n", n) );
+            if (n != first)
+               chunk += separator;
+            format_block(*next, chunk);
+         }
+         return chunk;
+      };
+      named_thread_pool pool("export", threads);
+      std::deque<std::future<std::string>> pending;
+      uint32_t next_chunk = block_num;
+      auto schedule = [&]() {
+         const uint32_t last = std::min<uint64_t>(uint64_t(next_chunk) + chunk_blocks - 1, log_last);
+         pending.emplace_back(async_thread_pool(pool.get_executor(), [&format_chunk, first = next_chunk, last]() {
+            return format_chunk(first, last);
+         }));
+         next_chunk = last + 1;
+      };
+      while (pending.size() < threads * 4 && next_chunk <= log_last && next_chunk != 0)
+         schedule();
+      while (!pending.empty()) {
+         auto chunk = pending.front().get();
+         pending.pop_front();
+         if (next_chunk <= log_last && next_chunk != 0)
+            schedule();
+         write_chunk(chunk);
+      }
+      pool.stop();
+      block_num = log_last + 1;
+   } else {
+      signed_block_ptr next;
+      while((block_num <= last_block) && (next = block_logger.read_block_by_num( block_num ))) {
+         std::string buf;
+         format_block(*next, buf);
+         write_chunk(buf);
+         ++block_num;
+      }
    }
 
    if (reversible_blocks) {
       const reversible_block_object* obj = nullptr;
       while( (block_num <= last_block) && (obj = reversible_blocks->find<reversible_block_object,by_num>(block_num)) ) {
-         if (as_json_array && contains_obj)
-            *out << ",";
-         auto next = obj->get_block();
-         print_block(next);
+         std::string buf;
+         format_block(*obj->get_block(), buf);
+         write_chunk(buf);
          ++block_num;
-         contains_obj = true;
       }
    }
 
@@ -179,12 +262,36 @@ void blocklog::set_program_options(options_description& cli)
           "Do not pretty print the output.  Useful if piping to jq to improve performance.")
          ("as-json-array", bpo::bool_switch(&as_json_array)->default_value(false),
           "Print out json blocks wrapped in json array (otherwise the output is free-standing json objects).")
+         ("output-format", bpo::value<std::string>(&output_format)->default_value("json"),
+          "Format blocks are printed in: 'json' (see no-pretty-print and as-json-array), 'ndjson' for one compact json "
+          "object per line, or 'binary' for each block as a little-endian uint32 byte count followed by the packed block.")
+         ("threads", bpo::value<uint32_t>(&threads)->default_value(1),
+          "Number of threads reading and formatting blocks; output stays in block order.")
          ("make-index", bpo::bool_switch(&make_index)->default_value(false),
           "Create blocks.index from blocks.log. Must give 'blocks-dir'. Give 'output-file' relative to current directory or absolute path (default is <blocks-dir>/blocks.index).")
+         ("make-action-index", bpo::bool_switch(&make_action_index)->default_value(false),
+          "Create an account to (block, transaction, action ordinal) index of the actions in blocks 'first' to 'last', "
+          "using 'threads' threads. Give 'output-file' (default is <blocks-dir>/actions.index).")
          ("trim-blocklog", bpo::bool_switch(&trim_log)->default_value(false),
           "Trim blocks.log and blocks.index. Must give 'blocks-dir' and 'first and/or 'last'.")
+         ("archive-blocklog", bpo::bool_switch(&archive_log)->default_value(false),
+          "Move the blocks before 'first' from blocks.log into the compressed archive blocks.zlog and blocks.zindex, "
+          "from which nodeos and eosio-blocklog still read them. Must give 'blocks-dir' and 'first'.")
+         ("blocks-per-frame", bpo::value<uint32_t>(&blocks_per_frame)->default_value(block_log_archive::default_blocks_per_frame),
+          "Number of consecutive blocks compressed together by archive-blocklog; larger frames compress better, "
+          "smaller ones are faster to read a single block from")
          ("smoke-test", bpo::bool_switch(&smoke_test)->default_value(false),
           "Quick test that blocks.log and blocks.index are well formed and agree with each other.")
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+         ("build-oc-code-cache", bpo::bool_switch(&build_oc_cache)->default_value(false),
+          "Compile every contract deployed in 'state-dir' with EOS VM OC and store them in the code cache of that state directory. nodeos must not be running on it.")
+         ("state-dir", bpo::value<bfs::path>()->default_value(config::default_state_dir_name),
+          "the location of the state directory used by build-oc-code-cache (absolute path or relative to the current directory)")
+         ("eos-vm-oc-cache-size-mb", bpo::value<uint64_t>()->default_value(eosvmoc::config().cache_size / (1024u*1024u)),
+          "Maximum size (in MiB) of the EOS VM OC code cache, use the same value nodeos is configured with")
+         ("eos-vm-oc-compile-threads", bpo::value<uint64_t>()->default_value(std::max(1u, std::thread::hardware_concurrency())),
+          "Number of contracts build-oc-code-cache compiles in parallel")
+#endif
          ("help,h", bpo::bool_switch(&help)->default_value(false), "Print this help message and exit.")
          ;
 }
@@ -204,6 +311,11 @@ void blocklog::initialize(const variables_map& options) {
          else
             output_file = bld;
       }
+      EOS_ASSERT( output_format == "json" || output_format == "ndjson" || output_format == "binary", fc::invalid_arg_exception,
+                  "Unknown output-format '${f}', must be json, ndjson or binary", ("f", output_format) );
+      EOS_ASSERT( output_format == "json" || !as_json_array, fc::invalid_arg_exception,
+                  "as-json-array can only be used with output-format json" );
+      EOS_ASSERT( threads > 0, fc::invalid_arg_exception, "threads must be greater than 0" );
    } FC_LOG_AND_RETHROW()
 
 }
@@ -269,6 +381,36 @@ void smoke_test(bfs::path block_dir) {
    cout << "\nno problems found\n";                         //if get here there were no exceptions
 }
 
+void make_action_index(const bfs::path& blocks_dir, const bfs::path& out_file, uint32_t first, uint32_t last, uint32_t threads) {
+   report_time rt("making action index");
+   eosio::chain::make_action_index(blocks_dir, out_file, first, last, threads);
+   rt.report();
+}
+
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+void build_oc_code_cache(const bfs::path& state_dir, uint64_t cache_size, uint64_t threads) {
+   report_time rt("building EOS VM OC code cache");
+   EOS_ASSERT( threads > 0, fc::invalid_arg_exception, "eos-vm-oc-compile-threads must be greater than 0" );
+   chainbase::database db(state_dir, chainbase::database::read_only);
+   db.add_index<code_index>();
+
+   eosvmoc::config oc_config;
+   oc_config.cache_size = cache_size;
+   oc_config.threads = threads;
+   eosvmoc::code_cache_async cc(state_dir, oc_config, db);
+
+   std::vector<eosvmoc::code_tuple> codes;
+   for(const code_object& co : db.get_index<code_index, by_code_hash>())
+      if(co.vm_type == 0)
+         codes.emplace_back(eosvmoc::code_tuple{co.code_hash, co.vm_version});
+
+   const auto [cached, compiled] = cc.compile_blocking(codes, codes.size());
+   ilog("EOS VM OC code cache holds ${c} of ${t} deployed contracts, ${n} newly compiled",
+        ("c", cached)("t", codes.size())("n", compiled));
+   rt.report();
+}
+#endif
+
 int main(int argc, char** argv) {
    std::ios::sync_with_stdio(false); // for potential performance boost for large block log files
    options_description cli ("eosio-blocklog command line options");
@@ -286,6 +428,16 @@ int main(int argc, char** argv) {
          smoke_test(vmap.at("blocks-dir").as<bfs::path>());
          return 0;
       }
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      if (blog.build_oc_cache) {
+         bfs::path state_dir = vmap.at("state-dir").as<bfs::path>();
+         if (state_dir.is_relative())
+            state_dir = bfs::current_path() / state_dir;
+         build_oc_code_cache(state_dir, vmap.at("eos-vm-oc-cache-size-mb").as<uint64_t>() * 1024u * 1024u,
+                             vmap.at("eos-vm-oc-compile-threads").as<uint64_t>());
+         return 0;
+      }
+#endif
       if (blog.trim_log) {
          if (blog.first_block == 0 && blog.last_block == std::numeric_limits<uint32_t>::max()) {
             std::cerr << "trim-blocklog does nothing unless specify first and/or last block.";
@@ -301,6 +453,31 @@ int main(int argc, char** argv) {
          }
          return 0;
       }
+      if (blog.archive_log) {
+         if (blog.first_block == 0) {
+            std::cerr << "archive-blocklog does nothing unless specify first block.";
+            return -1;
+         }
+         report_time rt("archiving blocklog start");
+         const bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
+         if (!block_log_archive::archive_blocklog_front(blocks_dir, blocks_dir / "old", blog.first_block, blog.blocks_per_frame))
+            return -1;
+         rt.report();
+         return 0;
+      }
+      if (blog.make_action_index) {
+         bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
+         if (blocks_dir.is_relative())
+            blocks_dir = bfs::current_path() / blocks_dir;
+         bfs::path out_file = blocks_dir / "actions.index";
+         if (vmap.count("output-file") > 0) {
+            out_file = vmap.at("output-file").as<bfs::path>();
+            if (out_file.is_relative())
+               out_file = bfs::current_path() / out_file;
+         }
+         make_action_index(blocks_dir, out_file, blog.first_block, blog.last_block, blog.threads);
+         return 0;
+      }
       if (blog.make_index) {
          const bfs::path blocks_dir = vmap.at("blocks-dir").as<bfs::path>();
          bfs::path out_file = blocks_dir / "blocks.index";
@@ -3,6 +3,9 @@
 #include <math.h>
 #include <sstream>
 #include <regex>
+#include <atomic>
+#include <mutex>
+#include <thread>
 
 #include <boost/algorithm/string.hpp>
 #include <boost/asio/ip/tcp.hpp>
@@ -415,6 +418,10 @@ struct launcher_def {
    int per_host = 0;
    last_run_def last_run;
    int start_delay = 0;
+   size_t launch_threads = 1;
+   std::mutex launch_mtx; ///< guards last_run and add_enable_stale_production while nodes launch side by side
+   bfs::path snapshot;
+   bfs::path code_cache;
    bool gelf_enabled;
    bool nogen;
    bool boot;
@@ -494,6 +501,9 @@ launcher_def::set_options (bpo::options_description &cfg) {
     ("spcfc-inst-num", bpo::value<vector<uint>>()->composing(), ("Specify a specific version installation path (using \"--spcfc-inst-"+ string(node_executable_name) + "\" flag) for launching this specific instance of " + string(node_executable_name) + ". This parameter can be entered multiple times and requires a paired \"--spcfc-inst-" + string(node_executable_name) + "\" flag each time it is used").c_str())
     (("spcfc-inst-" + string(node_executable_name)).c_str(), bpo::value<vector<string>>()->composing(), ("Provide a specific version installation path to its paired specific instance of " + string(node_executable_name) + "(using \"--spcfc-inst-num\")").c_str())
     ("delay,d",bpo::value<int>(&start_delay)->default_value(0),"seconds delay before starting each node after the first")
+    ("launch-threads",bpo::value<size_t>(&launch_threads)->default_value(1),"number of nodes to deploy and start at once; nodes start one at a time when a delay is given")
+    ("snapshot",bpo::value<bfs::path>(&snapshot),"start every node from this snapshot instead of from genesis.json; --timestamp is then ignored")
+    ("code-cache",bpo::value<bfs::path>(&code_cache),"a directory with code_cache.bin, and optionally code_cache_usage.bin, from the state directory of a cleanly stopped node, copied to every node to prefill its EOS VM OC cache")
     ("boot",bpo::bool_switch(&boot)->default_value(false),"After deploying the nodes and generating a boot script, invoke it.")
     ("nogen",bpo::bool_switch(&nogen)->default_value(false),"launch nodes without writing new config files")
     ("host-map",bpo::value<string>(),"a file containing mapping specific nodes to hosts. Used to enhance the custom shape argument")
@@ -568,6 +578,21 @@ launcher_def::initialize (const variables_map &vmap) {
   }
 
   genesis = vmap["genesis"].as<string>();
+  if (launch_threads == 0) {
+     cerr << "ERROR: \"--launch-threads\" must be at least 1" << endl;
+     exit (-1);
+  }
+  if (!snapshot.empty()) {
+     if (!bfs::exists (snapshot)) {
+        cerr << "ERROR: snapshot " << snapshot << " does not exist" << endl;
+        exit (-1);
+     }
+     snapshot = bfs::absolute (snapshot);
+  }
+  if (!code_cache.empty() && !bfs::exists (code_cache / "code_cache.bin")) {
+     cerr << "ERROR: " << code_cache / "code_cache.bin" << " does not exist" << endl;
+     exit (-1);
+  }
   if (vmap.count("host-map")) {
      host_map_file = vmap["host-map"].as<string>();
   }
@@ -1011,6 +1036,15 @@ launcher_def::deploy_config_files (tn_node_def &node) {
     bfs::copy_file (genesis_source, cfgdir / "genesis.json", bfs::copy_option::overwrite_if_exists);
     bfs::copy_file (logging_source, cfgdir / "logging.json", bfs::copy_option::overwrite_if_exists);
     bfs::copy_file (source, cfgdir / "config.ini", bfs::copy_option::overwrite_if_exists);
+
+    // the code cache sits in the state directory, which a snapshot only needs to be free of chain state
+    if (!code_cache.empty()) {
+       bfs::create_directories (dd / shared_mem_dir);
+       for (const char* f : { "code_cache.bin", "code_cache_usage.bin" }) {
+          if (bfs::exists (code_cache / f))
+             bfs::copy_file (code_cache / f, dd / shared_mem_dir / f, bfs::copy_option::overwrite_if_exists);
+       }
+    }
   }
   else {
     prep_remote_config_dir (instance, host);
@@ -1044,6 +1078,38 @@ launcher_def::deploy_config_files (tn_node_def &node) {
        cerr << "unable to scp genesis.json file to host " << host->host_name << endl;
        exit(-1);
     }
+
+    if (!snapshot.empty()) {
+      rfile = bfs::path (host->eosio_home) / instance.data_dir_name / "snapshot.bin";
+
+      scp_cmd_line = compose_scp_command(*host, snapshot, rfile);
+
+      res = boost::process::system (scp_cmd_line);
+      if (res != 0) {
+         cerr << "unable to scp snapshot to host " << host->host_name << endl;
+         exit(-1);
+      }
+    }
+
+    if (!code_cache.empty()) {
+      bfs::path rstate = bfs::path (host->eosio_home) / instance.data_dir_name / shared_mem_dir;
+      string cmd = "mkdir -p " + rstate.string();
+      if (!do_ssh (cmd, host->host_name)) {
+         cerr << "Unable to invoke " << cmd << " on host " << host->host_name << endl;
+         exit (-1);
+      }
+      for (const char* f : { "code_cache.bin", "code_cache_usage.bin" }) {
+         if (!bfs::exists (code_cache / f))
+            continue;
+         scp_cmd_line = compose_scp_command(*host, code_cache / f, rstate / f);
+
+         res = boost::process::system (scp_cmd_line);
+         if (res != 0) {
+            cerr << "unable to scp " << f << " to host " << host->host_name << endl;
+            exit(-1);
+         }
+      }
+    }
   }
   return host;
 }
@@ -1538,7 +1604,7 @@ launcher_def::launch (eosd_def &instance, string &gts) {
   if (instance.name != "bios" && !specific_nodeos_installation_paths.empty()) {
      const auto node_num = boost::lexical_cast<uint16_t,string>(instance.get_node_num());
      if (specific_nodeos_installation_paths.count(node_num)) {
-        install_path = specific_nodeos_installation_paths[node_num] + "/";
+        install_path = specific_nodeos_installation_paths.at(node_num) + "/";
      }
   }
   string eosdcmd = install_path + "programs/nodeos/" + string(node_executable_name) + " ";
@@ -1562,19 +1628,28 @@ launcher_def::launch (eosd_def &instance, string &gts) {
   if (instance.name != "bios" && !specific_nodeos_args.empty()) {
      const auto node_num = boost::lexical_cast<uint16_t,string>(instance.get_node_num());
      if (specific_nodeos_args.count(node_num)) {
-        eosdcmd += specific_nodeos_args[node_num] + " ";
+        eosdcmd += specific_nodeos_args.at(node_num) + " ";
      }
   }
 
-  if( add_enable_stale_production ) {
-    eosdcmd += "--enable-stale-production true ";
-    add_enable_stale_production = false;
+  {
+    std::lock_guard<std::mutex> g(launch_mtx);
+    if( add_enable_stale_production ) {
+      eosdcmd += "--enable-stale-production true ";
+      add_enable_stale_production = false;
+    }
   }
 
   eosdcmd += " --config-dir " + instance.config_dir_name + " --data-dir " + instance.data_dir_name;
-  eosdcmd += " --genesis-json " + instance.config_dir_name + "/genesis.json";
-  if (gts.length()) {
-    eosdcmd += " --genesis-timestamp " + gts;
+  if (!snapshot.empty()) {
+    // the snapshot carries the genesis state, which nodeos will not also take from --genesis-json or --genesis-timestamp
+    eosdcmd += " --snapshot " + (host->is_local() ? snapshot.string() : instance.data_dir_name + "/snapshot.bin");
+  }
+  else {
+    eosdcmd += " --genesis-json " + instance.config_dir_name + "/genesis.json";
+    if (gts.length()) {
+      eosdcmd += " --genesis-timestamp " + gts;
+    }
   }
 
   if (!host->is_local()) {
@@ -1628,6 +1703,7 @@ launcher_def::launch (eosd_def &instance, string &gts) {
     sf << eosdcmd << endl;
     sf.close();
   }
+  std::lock_guard<std::mutex> g(launch_mtx);
   last_run.running_nodes.emplace_back (move(info));
 }
 
@@ -1866,24 +1942,50 @@ launcher_def::start_all (string &gts, launch_modes mode) {
   case LM_REMOTE:
   case LM_LOCAL: {
 
+    vector<eosd_def*> instances;
     for (auto &h : bindings ) {
       if (mode == LM_ALL ||
           (h.is_local() ? mode == LM_LOCAL : mode == LM_REMOTE)) {
         for (auto &inst : h.instances) {
-          try {
-             cerr << "launching " << inst.name << endl;
-             launch (inst, gts);
-          } catch (fc::exception& fce) {
-             cerr << "unable to launch " << inst.name << " fc::exception=" << fce.to_detail_string() << endl;
-          } catch (std::exception& stde) {
-             cerr << "unable to launch " << inst.name << " std::exception=" << stde.what() << endl;
-          } catch (...) {
-            cerr << "unable to launch " << inst.name << endl;
-          }
-          sleep (start_delay);
+          instances.push_back (&inst);
         }
       }
     }
+
+    auto launch_instance = [&](eosd_def &inst) {
+      try {
+         cerr << "launching " << inst.name << endl;
+         launch (inst, gts);
+      } catch (fc::exception& fce) {
+         cerr << "unable to launch " << inst.name << " fc::exception=" << fce.to_detail_string() << endl;
+      } catch (std::exception& stde) {
+         cerr << "unable to launch " << inst.name << " std::exception=" << stde.what() << endl;
+      } catch (...) {
+        cerr << "unable to launch " << inst.name << endl;
+      }
+    };
+
+    if (launch_threads > 1 && start_delay == 0) {
+      // each thread deploys and starts the next node not yet taken, so slow remote copies overlap
+      std::atomic<size_t> next{0};
+      vector<std::thread> threads;
+      for (size_t t = 0; t < std::min (launch_threads, instances.size()); ++t) {
+        threads.emplace_back ([&]() {
+          for (size_t i = next++; i < instances.size(); i = next++) {
+            launch_instance (*instances[i]);
+          }
+        });
+      }
+      for (auto &t : threads) {
+        t.join();
+      }
+    }
+    else {
+      for (auto *inst : instances) {
+        launch_instance (*inst);
+        sleep (start_delay);
+      }
+    }
     break;
   }
   }
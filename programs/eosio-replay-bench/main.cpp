@@ -0,0 +1,304 @@
+#include <eosio/chain/block_log.hpp>
+#include <eosio/chain/controller.hpp>
+#include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/genesis_state.hpp>
+#include <eosio/chain/protocol_feature_manager.hpp>
+#include <eosio/chain/snapshot.hpp>
+#include <eosio/chain/trace.hpp>
+#include <eosio/chain/wasm_interface.hpp>
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/config.hpp>
+#endif
+
+#include <fc/io/json.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/exception/diagnostic_information.hpp>
+#include <boost/program_options.hpp>
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <map>
+
+using namespace eosio::chain;
+namespace bfs = boost::filesystem;
+namespace bpo = boost::program_options;
+using bpo::options_description;
+using bpo::variables_map;
+
+namespace {
+
+/// wall clock time of one replay phase summed over all blocks
+class phase_timer {
+public:
+   template<typename F>
+   auto time( F&& f ) -> decltype(f()) {
+      struct add_elapsed {
+         phase_timer& t;
+         const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+         ~add_elapsed() { t._elapsed += std::chrono::steady_clock::now() - start; }
+      } guard{ *this };
+      return f();
+   }
+
+   int64_t microseconds()const { return std::chrono::duration_cast<std::chrono::microseconds>( _elapsed ).count(); }
+
+private:
+   std::chrono::steady_clock::duration _elapsed{0};
+};
+
+struct contract_stats {
+   uint64_t         actions = 0;
+   fc::microseconds elapsed;
+};
+
+struct replay_bench {
+   bfs::path                source_dir;
+   bfs::path                data_dir;
+   bfs::path                report_file;
+   fc::optional<bfs::path>  snapshot;
+   uint32_t                 blocks = 0;
+   uint32_t                 last_block = std::numeric_limits<uint32_t>::max();
+   controller::config       cfg;
+
+   void set_program_options( options_description& cli );
+   void initialize( const variables_map& vmap );
+   void run();
+
+private:
+   fc::mutable_variant_object make_report( uint32_t first, uint32_t last, double seconds )const;
+
+   uint64_t                               transactions = 0;
+   uint64_t                               actions      = 0;
+   std::map<account_name, contract_stats> contracts;
+   phase_timer                            read_timer;
+   phase_timer                            block_state_timer;
+   phase_timer                            apply_timer;
+};
+
+const char* runtime_name( wasm_interface::vm_type runtime ) {
+   switch( runtime ) {
+      case wasm_interface::vm_type::wabt:       return "wabt";
+      case wasm_interface::vm_type::eos_vm:     return "eos-vm";
+      case wasm_interface::vm_type::eos_vm_jit: return "eos-vm-jit";
+      case wasm_interface::vm_type::eos_vm_oc:  return "eos-vm-oc";
+   }
+   return "unknown";
+}
+
+/// every builtin protocol feature with its default activation requirements, as nodeos has them without a protocol_features dir
+protocol_feature_set make_protocol_feature_set() {
+   protocol_feature_set pfs;
+   std::map< builtin_protocol_feature_t, fc::optional<digest_type> > visited_builtins;
+
+   std::function<digest_type(builtin_protocol_feature_t)> add_builtins =
+   [&pfs, &visited_builtins, &add_builtins]( builtin_protocol_feature_t codename ) -> digest_type {
+      auto res = visited_builtins.emplace( codename, fc::optional<digest_type>() );
+      if( !res.second ) {
+         EOS_ASSERT( res.first->second, protocol_feature_exception,
+                     "invariant failure: cycle found in builtin protocol feature dependencies" );
+         return *res.first->second;
+      }
+      auto f = protocol_feature_set::make_default_builtin_protocol_feature( codename,
+         [&add_builtins]( builtin_protocol_feature_t d ) { return add_builtins( d ); } );
+      const auto& pf = pfs.add_feature( f );
+      res.first->second = pf.feature_digest;
+      return pf.feature_digest;
+   };
+
+   for( const auto& p : builtin_protocol_feature_codenames ) {
+      add_builtins( p.first );
+   }
+   return pfs;
+}
+
+void replay_bench::set_program_options( options_description& cli ) {
+   cli.add_options()
+         ("blocks-dir", bpo::value<bfs::path>(&source_dir)->default_value("blocks"),
+          "the blocks directory holding the recorded blocks.log to replay; it is only read")
+         ("data-dir", bpo::value<bfs::path>(&data_dir)->default_value("replay-bench"),
+          "the work directory the replayed chain keeps its state and blocks in; must not hold a chain yet")
+         ("snapshot", bpo::value<bfs::path>(),
+          "snapshot to start from; otherwise the chain starts from the genesis state of blocks-dir")
+         ("blocks,n", bpo::value<uint32_t>(&blocks)->default_value(0),
+          "number of blocks to replay after the start block, 0 for every block in blocks-dir")
+         ("last,l", bpo::value<uint32_t>(&last_block)->default_value(std::numeric_limits<uint32_t>::max()),
+          "the last block number to replay")
+         ("wasm-runtime", bpo::value<wasm_interface::vm_type>(&cfg.wasm_runtime)->value_name("runtime"),
+          "Override default WASM runtime: wabt, eos-vm or eos-vm-jit")
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+         ("eos-vm-oc-enable", bpo::bool_switch(&cfg.eosvmoc_tierup), "Enable EOS VM OC tier-up runtime")
+         ("eos-vm-oc-compile-threads", bpo::value<uint64_t>()->default_value(1u),
+          "Number of threads to use for EOS VM OC tier-up")
+         ("eos-vm-oc-cache-size-mb", bpo::value<uint64_t>()->default_value(eosvmoc::config().cache_size / (1024u*1024u)),
+          "Maximum size (in MiB) of the EOS VM OC code cache")
+#endif
+         ("chain-threads", bpo::value<uint16_t>(&cfg.thread_pool_size)->default_value(cfg.thread_pool_size),
+          "Number of worker threads in the controller thread pool, which recovers the keys of the replayed transactions")
+         ("chain-state-db-size-mb", bpo::value<uint64_t>()->default_value(cfg.state_size / (1024u*1024u)),
+          "Maximum size (in MiB) of the chain state database")
+         ("report,o", bpo::value<bfs::path>(&report_file),
+          "the file to write the json report to. If not specified then the report is written to stdout.")
+         ("help,h", "Print this help message and exit.")
+         ;
+}
+
+void replay_bench::initialize( const variables_map& vmap ) {
+   if( source_dir.is_relative() )
+      source_dir = bfs::current_path() / source_dir;
+   if( data_dir.is_relative() )
+      data_dir = bfs::current_path() / data_dir;
+   if( vmap.count( "snapshot" ) )
+      snapshot = vmap.at( "snapshot" ).as<bfs::path>();
+
+   EOS_ASSERT( source_dir != data_dir / config::default_blocks_dir_name, plugin_config_exception,
+               "data-dir must not hold blocks-dir, the replayed chain writes its own block log" );
+   EOS_ASSERT( !bfs::exists( data_dir / config::default_state_dir_name ), plugin_config_exception,
+               "data-dir ${d} already holds chain state, remove it to replay again", ("d", data_dir.generic_string()) );
+
+   cfg.blocks_dir = data_dir / config::default_blocks_dir_name;
+   cfg.state_dir  = data_dir / config::default_state_dir_name;
+   cfg.state_size = vmap.at( "chain-state-db-size-mb" ).as<uint64_t>() * 1024u * 1024u;
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   cfg.eosvmoc_config.threads    = vmap.at( "eos-vm-oc-compile-threads" ).as<uint64_t>();
+   cfg.eosvmoc_config.cache_size = vmap.at( "eos-vm-oc-cache-size-mb" ).as<uint64_t>() * 1024u * 1024u;
+#endif
+}
+
+void replay_bench::run() {
+   block_log source( source_dir, true );
+   const auto source_head = source.read_head();
+   EOS_ASSERT( source_head, block_log_exception, "No blocks found in block log ${d}", ("d", source_dir.generic_string()) );
+
+   std::unique_ptr<controller> chain;
+   if( snapshot ) {
+      auto reader = open_snapshot_file( *snapshot );
+      reader->validate();
+      const auto chain_id = controller::extract_chain_id( *reader );
+      chain = std::make_unique<controller>( cfg, make_protocol_feature_set(), chain_id );
+      chain->add_indices();
+      chain->startup( []() { return false; }, open_snapshot_file( *snapshot ) );
+   } else {
+      const auto genesis = block_log::extract_genesis_state( source_dir );
+      EOS_ASSERT( genesis, block_log_exception,
+                  "block log ${d} does not start with a genesis state, give a snapshot", ("d", source_dir.generic_string()) );
+      chain = std::make_unique<controller>( cfg, make_protocol_feature_set(), genesis->compute_chain_id() );
+      chain->add_indices();
+      chain->startup( []() { return false; }, *genesis );
+   }
+
+   // elapsed is each action's own execution time, inline actions are attributed to their own receiver
+   chain->applied_transaction.connect( [this]( std::tuple<const transaction_trace_ptr&, const signed_transaction&> t ) {
+      const auto& trace = std::get<0>( t );
+      ++transactions;
+      for( const auto& at : trace->action_traces ) {
+         auto& stats = contracts[at.receiver];
+         ++stats.actions;
+         stats.elapsed += at.elapsed;
+         ++actions;
+      }
+   } );
+
+   const uint32_t first = chain->head_block_num() + 1;
+   uint32_t last = std::min( last_block, source_head->block_num() );
+   if( blocks )
+      last = std::min<uint64_t>( last, uint64_t(first) + blocks - 1 );
+   EOS_ASSERT( first >= source.first_block_num() && first <= last, block_log_exception,
+               "block log ${d} does not hold the blocks after head block ${h}",
+               ("d", source_dir.generic_string())("h", first - 1) );
+   ilog( "replaying blocks ${first} through ${last}", ("first", first)("last", last) );
+
+   const auto start = std::chrono::steady_clock::now();
+   for( uint32_t n = first; n <= last; ++n ) {
+      const auto block = read_timer.time( [&]() { return source.read_block_by_num( n ); } );
+      EOS_ASSERT( block, block_log_exception, "block ${n} missing from block log", ("n", n) );
+      auto bsf = block_state_timer.time( [&]() {
+         auto f = chain->create_block_state_future( block );
+         f.wait();
+         return f;
+      } );
+      apply_timer.time( [&]() { chain->push_block( bsf, forked_branch_callback(), trx_meta_cache_lookup() ); } );
+      if( (n - first) % 10000 == 9999 )
+         ilog( "replayed block ${n}", ("n", n) );
+   }
+   const double seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+
+   const auto report = fc::json::to_pretty_string( make_report( first, last, seconds ) );
+   if( report_file.empty() ) {
+      std::cout << report << std::endl;
+   } else {
+      std::ofstream out( report_file.generic_string() );
+      EOS_ASSERT( out, fc::file_not_found_exception, "Unable to open file '${f}'", ("f", report_file.generic_string()) );
+      out << report << std::endl;
+   }
+}
+
+fc::mutable_variant_object replay_bench::make_report( uint32_t first, uint32_t last, double seconds )const {
+   std::vector<std::pair<account_name, contract_stats>> by_elapsed( contracts.begin(), contracts.end() );
+   std::sort( by_elapsed.begin(), by_elapsed.end(), []( const auto& a, const auto& b ) {
+      return a.second.elapsed > b.second.elapsed;
+   } );
+   fc::variants contract_report;
+   for( const auto& c : by_elapsed ) {
+      contract_report.emplace_back( fc::mutable_variant_object()
+         ("receiver", c.first)
+         ("actions", c.second.actions)
+         ("elapsed_us", c.second.elapsed.count())
+         ("us_per_action", double( c.second.elapsed.count() ) / c.second.actions) );
+   }
+
+   const uint64_t replayed = uint64_t(last) - first + 1;
+   return fc::mutable_variant_object()
+      ("wasm_runtime", runtime_name( cfg.wasm_runtime ))
+      ("eos_vm_oc", cfg.eosvmoc_tierup)
+      ("chain_threads", cfg.thread_pool_size)
+      ("first_block", first)
+      ("last_block", last)
+      ("blocks", replayed)
+      ("transactions", transactions)
+      ("actions", actions)
+      ("seconds", seconds)
+      ("blocks_per_second", seconds > 0 ? replayed / seconds : 0.0)
+      ("transactions_per_second", seconds > 0 ? transactions / seconds : 0.0)
+      ("read_us", read_timer.microseconds())
+      ("block_state_us", block_state_timer.microseconds())
+      ("apply_us", apply_timer.microseconds())
+      ("contracts", std::move( contract_report ));
+}
+
+}
+
+int main(int argc, char** argv) {
+   options_description cli ("eosio-replay-bench command line options");
+   try {
+      replay_bench bench;
+      bench.set_program_options( cli );
+      variables_map vmap;
+      bpo::store( bpo::parse_command_line( argc, argv, cli ), vmap );
+      bpo::notify( vmap );
+      if( vmap.count( "help" ) ) {
+         cli.print( std::cerr );
+         return 0;
+      }
+      bench.initialize( vmap );
+      bench.run();
+   } catch( const fc::exception& e ) {
+      elog( "${e}", ("e", e.to_detail_string()) );
+      return -1;
+   } catch( const boost::exception& e ) {
+      elog( "${e}", ("e", boost::diagnostic_information(e)) );
+      return -1;
+   } catch( const std::exception& e ) {
+      elog( "${e}", ("e", e.what()) );
+      return -1;
+   } catch( ... ) {
+      elog( "unknown exception" );
+      return -1;
+   }
+
+   return 0;
+}
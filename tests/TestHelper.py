@@ -11,12 +11,13 @@ class AppArgs:
         self.args=[]
 
     class AppArg:
-        def __init__(self, flag, type, help, default, choices=None):
+        def __init__(self, flag, type=None, help=None, default=None, choices=None, action=None):
             self.flag=flag
             self.type=type
             self.help=help
             self.default=default
             self.choices=choices
+            self.action=action
 
     def add(self, flag, type, help, default, choices=None):
         arg=self.AppArg(flag, type, help, default, choices)
@@ -112,7 +113,10 @@ class TestHelper(object):
             parser.add_argument("--alternate-version-labels-file", type=str, help="Provide a file to define the labels that can be used in the test and the path to the version installation associated with that.")
 
         for arg in applicationSpecificArgs.args:
-            parser.add_argument(arg.flag, type=arg.type, help=arg.help, choices=arg.choices, default=arg.default)
+            if arg.action is not None:
+                parser.add_argument(arg.flag, help=arg.help, action=arg.action)
+            else:
+                parser.add_argument(arg.flag, type=arg.type, help=arg.help, choices=arg.choices, default=arg.default)
 
         args = parser.parse_args()
         return args
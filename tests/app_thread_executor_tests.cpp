@@ -0,0 +1,61 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/chain/app_thread_executor.hpp>
+
+#include <chrono>
+#include <thread>
+
+using namespace eosio::chain;
+using appbase::priority;
+
+namespace {
+   /// runs what was posted to the application thread, highest priority first, as application::exec does
+   void run_posted() {
+      auto& io = appbase::app().get_io_service();
+      while( io.poll_one() ) {}
+      bool more = true;
+      while( more )
+         more = appbase::app().get_priority_queue().execute_highest();
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(app_thread_executor_tests)
+
+BOOST_AUTO_TEST_CASE( reads_shed_behind_a_block ) {
+   auto& reads = app_thread_stats::origin( "test:post_read", priority::low );
+   auto& blocks = app_thread_stats::origin( "test:post_block", priority::high, true );
+   const auto deadline = fc::milliseconds( 10 );
+   const auto past_deadline = std::chrono::milliseconds( 20 );
+   int ran = 0;
+   int shed = 0;
+   auto read = [&]() { app_thread_post_read( reads, deadline, [&]() { ++ran; }, [&]() { ++shed; } ); };
+
+   // a block posted after the read runs first and holds the thread past the deadline: the read is shed although no
+   // block is pending any more when it is dequeued
+   read();
+   app_thread_post( blocks, [&]() { std::this_thread::sleep_for( past_deadline ); } );
+   run_posted();
+   BOOST_CHECK_EQUAL( shed, 1 );
+   BOOST_CHECK_EQUAL( ran, 0 );
+   BOOST_CHECK_EQUAL( app_thread_stats::blocks_pending(), 0u );
+
+   // a read that waited as long without a block taking the thread runs
+   read();
+   std::this_thread::sleep_for( past_deadline );
+   run_posted();
+   BOOST_CHECK_EQUAL( ran, 1 );
+
+   // as does one that waited less than its deadline behind a block
+   read();
+   app_thread_post( blocks, []() {} );
+   run_posted();
+   BOOST_CHECK_EQUAL( ran, 2 );
+   BOOST_CHECK_EQUAL( shed, 1 );
+
+   const auto s = reads.get_stats();
+   BOOST_CHECK_EQUAL( s.posted, 3u );
+   BOOST_CHECK_EQUAL( s.ran, 2u );
+   BOOST_CHECK_EQUAL( s.shed, 1u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,75 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/producer_plugin/block_timings.hpp>
+
+#include <algorithm>
+
+using namespace eosio;
+
+namespace {
+   producer_plugin::block_timing make_timing( uint32_t block_num, int64_t commit_us ) {
+      producer_plugin::block_timing t;
+      t.block_num = block_num;
+      t.commit_us = commit_us;
+      return t;
+   }
+
+   producer_plugin::slow_action make_action( int64_t elapsed_us ) {
+      return { chain::transaction_id_type(), N(alice), N(eosio.token), N(transfer), elapsed_us };
+   }
+
+   const producer_plugin::phase_histogram& histogram( const producer_plugin::get_block_timings_result& r, const std::string& phase ) {
+      auto itr = std::find_if( r.histograms.begin(), r.histograms.end(), [&]( const auto& h ) { return h.phase == phase; } );
+      BOOST_REQUIRE( itr != r.histograms.end() );
+      return *itr;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(block_timings_tests)
+
+BOOST_AUTO_TEST_CASE( keeps_the_slowest_actions_of_a_block ) {
+   producer_plugin::block_timing t;
+   for( int64_t us = 1; us <= 3 * block_timings::slowest_actions_per_block; ++us )
+      block_timings::add_action( t, make_action( us * 7 % 31 ) );
+   BOOST_REQUIRE_EQUAL( t.slowest_actions.size(), block_timings::slowest_actions_per_block );
+   BOOST_CHECK_EQUAL( t.slowest_actions.front().elapsed_us, 30 );
+   for( size_t i = 1; i < t.slowest_actions.size(); ++i )
+      BOOST_CHECK_GE( t.slowest_actions[i - 1].elapsed_us, t.slowest_actions[i].elapsed_us );
+
+   // no faster than the slowest kept
+   const auto last = t.slowest_actions.back().elapsed_us;
+   block_timings::add_action( t, make_action( last ) );
+   BOOST_CHECK_EQUAL( t.slowest_actions.back().elapsed_us, last );
+   BOOST_CHECK_EQUAL( t.slowest_actions.size(), block_timings::slowest_actions_per_block );
+}
+
+BOOST_AUTO_TEST_CASE( summarizes_the_retained_blocks ) {
+   block_timings timings( 3 );
+   const int64_t commit_us[] = { 0, 1, 5, 1000 };
+   for( uint32_t n = 0; n < 4; ++n ) {
+      auto t = make_timing( n + 1, commit_us[n] );
+      block_timings::add_action( t, make_action( 100 * (n + 1) ) );
+      timings.record( std::move( t ) );
+   }
+
+   const auto r = timings.summarize( 2 );
+   // most recent first, and block 1 was dropped past the history
+   BOOST_REQUIRE_EQUAL( r.blocks.size(), 2u );
+   BOOST_CHECK_EQUAL( r.blocks[0].block_num, 4u );
+   BOOST_CHECK_EQUAL( r.blocks[1].block_num, 3u );
+
+   // log2 buckets: 1us in bucket 0, 5us in bucket 2, 1000us in bucket 9
+   const auto& commit = histogram( r, "commit" );
+   BOOST_REQUIRE_EQUAL( commit.buckets.size(), 10u );
+   BOOST_CHECK_EQUAL( commit.buckets[0], 1u );
+   BOOST_CHECK_EQUAL( commit.buckets[2], 1u );
+   BOOST_CHECK_EQUAL( commit.buckets[9], 1u );
+   BOOST_REQUIRE_EQUAL( histogram( r, "sign" ).buckets.size(), 1u );
+   BOOST_CHECK_EQUAL( histogram( r, "sign" ).buckets[0], 3u );
+
+   BOOST_REQUIRE_EQUAL( r.slowest_actions.size(), 3u );
+   BOOST_CHECK_EQUAL( r.slowest_actions[0].elapsed_us, 400 );
+   BOOST_CHECK_EQUAL( r.slowest_actions[2].elapsed_us, 200 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -6,6 +6,7 @@
 #include <eosio/chain/wasm_eosio_constraints.hpp>
 #include <eosio/chain/resource_limits.hpp>
 #include <eosio/chain/exceptions.hpp>
+#include <eosio/chain/thread_utils.hpp>
 #include <eosio/chain/wast_to_wasm.hpp>
 #include <eosio/chain_plugin/chain_plugin.hpp>
 
@@ -118,4 +119,42 @@ BOOST_FIXTURE_TEST_CASE( get_block_with_invalid_abi, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// get_block_with_invalid_abi
 
+BOOST_FIXTURE_TEST_CASE( get_block_parallel_decode_matches_serial, TESTER ) try {
+   produce_blocks(2);
+
+   create_accounts( {N(asserter)} );
+   produce_block();
+   set_code( N(asserter), contracts::asserter_wasm() );
+   set_abi( N(asserter), contracts::asserter_abi().data() );
+   produce_blocks(1);
+
+   // one block holding transactions of two contracts, so the decoded transactions differ in abi and content
+   for( int i = 0; i < 8; ++i ) {
+      push_action( N(asserter), N(procassert), N(asserter), mutable_variant_object()
+         ("condition", 1)
+         ("message", "message " + std::to_string(i))
+      );
+   }
+   create_accounts( {N(alice), N(bob), N(carol)} );
+   produce_blocks(1);
+
+   const uint32_t headnum = this->control->head_block_num();
+   BOOST_REQUIRE_GE( this->control->head_block_state()->block->transactions.size(), 11u );
+   chain_apis::read_only::get_block_params param{ std::to_string(headnum) };
+
+   chain_apis::read_only serial(*(this->control), fc::microseconds::maximum());
+   chain_apis::read_only parallel(*(this->control), fc::microseconds::maximum());
+   named_thread_pool pool( "getblk", 4 );
+   parallel.set_parallel_for( [&pool]( size_t n, const std::function<void(size_t)>& f ) {
+      chain::parallel_for( pool.get_executor(), 4, n, f );
+   } );
+
+   const std::string expected = json::to_pretty_string(serial.get_block(param));
+   BOOST_TEST(expected.find("message 7") != std::string::npos);
+   BOOST_TEST(expected.find("carol") != std::string::npos);
+   for( int i = 0; i < 4; ++i ) {
+      BOOST_REQUIRE_EQUAL( json::to_pretty_string(parallel.get_block(param)), expected );
+   }
+} FC_LOG_AND_RETHROW() /// get_block_parallel_decode_matches_serial
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -670,4 +670,103 @@ BOOST_FIXTURE_TEST_CASE( get_table_next_key_test, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// get_table_next_key_test
 
+BOOST_FIXTURE_TEST_CASE( get_table_cursor_test, TESTER ) try {
+   create_account(N(test));
+   set_code( N(test), contracts::get_table_test_wasm() );
+   set_abi( N(test), contracts::get_table_test_abi().data() );
+   produce_block();
+
+   // three rows share the secondary key 5
+   for( uint64_t input : { 5, 5, 5, 7 } ) {
+      push_action(N(test), N(addnumobj), N(test), mutable_variant_object()("input", input));
+      produce_block();
+   }
+
+   chain_apis::read_only plugin(*(this->control), fc::microseconds::maximum());
+   chain_apis::read_only::get_table_rows_params params{
+      .json=true,
+      .code=N(test),
+      .scope="test",
+      .limit=1
+   };
+   params.table = N(numobjs);
+   params.key_type = "i64";
+   params.index_position = "2";
+
+   // pages by next_key cannot get past the first row of a repeated secondary key, pages by cursor visit every row once
+   auto pages = [&]( bool reverse ) {
+      params.reverse = reverse;
+      params.cursor.reset();
+      std::vector<uint64_t> keys;
+      for( int i = 0; i < 10; ++i ) {
+         auto res = plugin.get_table_rows(params);
+         BOOST_REQUIRE_EQUAL(res.rows.size(), 1u);
+         keys.push_back( res.rows[0].get_object()["key"].as<uint64_t>() );
+         if( !res.more ) {
+            BOOST_TEST(res.next_cursor.empty());
+            break;
+         }
+         BOOST_TEST(!res.next_cursor.empty());
+         params.cursor = res.next_cursor;
+      }
+      return keys;
+   };
+   BOOST_TEST(pages( false ) == std::vector<uint64_t>({ 0, 1, 2, 3 }), boost::test_tools::per_element());
+   BOOST_TEST(pages( true ) == std::vector<uint64_t>({ 3, 2, 1, 0 }), boost::test_tools::per_element());
+
+   params.reverse = false;
+   params.cursor.reset();
+   auto first = plugin.get_table_rows(params);
+   BOOST_TEST(first.next_key == "5");
+   params.lower_bound = first.next_key;
+   BOOST_TEST(plugin.get_table_rows(params).rows[0].get_object()["key"].as<uint64_t>() == 0);
+
+   // a cursor overrides lower_bound, and resumes the json and binary formats alike
+   params.cursor = first.next_cursor;
+   auto second = plugin.get_table_rows(params);
+   BOOST_TEST(second.rows[0].get_object()["key"].as<uint64_t>() == 1);
+   params.json = false;
+   auto binary = plugin.get_table_rows(params);
+   BOOST_REQUIRE_EQUAL(binary.rows.size(), 1u);
+   BOOST_TEST(binary.next_cursor == second.next_cursor);
+   params.json = true;
+   params.lower_bound.clear();
+
+   // primary index
+   params.index_position = "1";
+   params.cursor.reset();
+   BOOST_TEST(pages( false ) == std::vector<uint64_t>({ 0, 1, 2, 3 }), boost::test_tools::per_element());
+
+   // a cursor only resumes the query it was issued for
+   params.cursor = first.next_cursor;
+   BOOST_CHECK_THROW(plugin.get_table_rows(params), chain::contract_table_query_exception);
+   params.index_position = "2";
+   params.reverse = true;
+   BOOST_CHECK_THROW(plugin.get_table_rows(params), chain::contract_table_query_exception);
+   params.reverse = false;
+   params.cursor = "zz";
+   BOOST_CHECK_THROW(plugin.get_table_rows(params), chain::contract_table_query_exception);
+   params.cursor = first.next_cursor.substr( 0, first.next_cursor.size() - 4 );
+   BOOST_CHECK_THROW(plugin.get_table_rows(params), chain::contract_table_query_exception);
+} FC_LOG_AND_RETHROW() /// get_table_cursor_test
+
+BOOST_FIXTURE_TEST_CASE( abi_cache_evicts_least_recently_used, TESTER ) try {
+   create_accounts({ N(abia), N(abib), N(abic) });
+   produce_block();
+   for( auto a : { N(abia), N(abib), N(abic) } )
+      set_abi( a, contracts::eosio_token_abi().data() );
+   produce_blocks(1);
+
+   const auto max_time = fc::microseconds::maximum();
+   eosio::chain_apis::abi_cache cache( 2 );
+
+   auto a = cache.get( *control, N(abia), max_time );
+   auto b = cache.get( *control, N(abib), max_time );
+   BOOST_TEST( cache.get( *control, N(abia), max_time ) == a ); // abia is now the most recently used
+
+   cache.get( *control, N(abic), max_time );                    // full, evicts abib rather than the lower abia
+   BOOST_TEST( cache.get( *control, N(abia), max_time ) == a );
+   BOOST_TEST( cache.get( *control, N(abib), max_time ) != b );
+} FC_LOG_AND_RETHROW() /// abi_cache_evicts_least_recently_used
+
 BOOST_AUTO_TEST_SUITE_END()
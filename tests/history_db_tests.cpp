@@ -0,0 +1,85 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/testing/tester.hpp>
+#include <eosio/history_plugin/action_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <set>
+#include <vector>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+namespace {
+   /// records every receipted action of trace as if it were in block_num, in the history of accounts
+   void record( chainbase::database& db, const transaction_trace_ptr& trace, const std::set<account_name>& accounts, uint32_t block_num ) {
+      for( const auto& at : trace->action_traces ) {
+         if( at.receipt )
+            record_action_history( db, at, accounts, block_num, block_timestamp_type() );
+      }
+   }
+
+   /// the account sequence numbers recorded for n, in order
+   std::vector<int32_t> account_history( const chainbase::database& db, account_name n ) {
+      std::vector<int32_t> result;
+      const auto& idx = db.get_index<account_history_index, by_account_action_seq>();
+      for( auto itr = idx.lower_bound( boost::make_tuple( n, 0 ) ); itr != idx.end() && itr->account == n; ++itr )
+         result.push_back( itr->account_sequence_num );
+      return result;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(history_db_tests)
+
+BOOST_AUTO_TEST_CASE( recorded_and_forked_out ) try {
+   tester t;
+   auto alice = t.create_account( N(alice) );
+   t.produce_block();
+   auto bob = t.create_account( N(bob) );
+   t.produce_block();
+
+   fc::temp_directory tmp;
+   chainbase::database db( tmp.path(), chainbase::database::read_write, 8 * 1024 * 1024 );
+   db.add_index<account_history_index>();
+   db.add_index<action_history_index>();
+
+   record( db, alice, {config::system_account_name, N(alice)}, 10 );
+   record( db, bob, {config::system_account_name, N(bob)}, 11 );
+   const auto actions = db.get_index<action_history_index>().size();
+   BOOST_REQUIRE_GE( actions, 2u );
+
+   // each account's history continues where it left off
+   const auto system_history = account_history( db, config::system_account_name );
+   BOOST_REQUIRE_EQUAL( system_history.size(), actions );
+   for( size_t i = 0; i < system_history.size(); ++i )
+      BOOST_CHECK_EQUAL( system_history[i], int32_t(i) );
+   BOOST_CHECK_EQUAL( account_history( db, N(alice) ).front(), 0 );
+   BOOST_CHECK_EQUAL( account_history( db, N(bob) ).front(), 0 );
+
+   const auto& by_trx = db.get_index<action_history_index, by_trx_id>();
+   const auto bobs = by_trx.lower_bound( boost::make_tuple( bob->id, 0 ) );
+   BOOST_REQUIRE( bobs != by_trx.end() && bobs->trx_id == bob->id );
+   BOOST_CHECK_EQUAL( bobs->block_num, 11u );
+   auto at = fc::raw::unpack<action_trace>( bobs->packed_action_trace.data(), bobs->packed_action_trace.size() );
+   BOOST_CHECK_EQUAL( at.act.name, N(newaccount) );
+
+   // block 11 forked out: only what block 10 recorded remains, and history continues from there
+   remove_action_history_from_block( db, 11 );
+   BOOST_CHECK( account_history( db, N(bob) ).empty() );
+   BOOST_CHECK( !account_history( db, N(alice) ).empty() );
+   const auto kept = db.get_index<action_history_index>().size();
+   BOOST_CHECK_LT( kept, actions );
+   BOOST_CHECK_EQUAL( account_history( db, config::system_account_name ).size(), kept );
+
+   record( db, bob, {config::system_account_name, N(bob)}, 11 );
+   BOOST_CHECK( account_history( db, config::system_account_name ) == system_history );
+   BOOST_CHECK_EQUAL( account_history( db, N(bob) ).front(), 0 );
+
+   remove_action_history_from_block( db, 10 );
+   BOOST_CHECK_EQUAL( db.get_index<action_history_index>().size(), 0u );
+   BOOST_CHECK_EQUAL( db.get_index<account_history_index>().size(), 0u );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
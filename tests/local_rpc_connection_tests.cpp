@@ -0,0 +1,161 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/local_rpc_plugin/local_rpc_connection.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include <boost/asio/connect_pair.hpp>
+#include <boost/asio/read.hpp>
+#include <boost/asio/write.hpp>
+
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace eosio;
+
+namespace {
+   /// runs a local_rpc_connection on one end of a socket pair, the test is the client on the other end
+   struct connected_pair {
+      boost::asio::io_context                          ioc;
+      local_rpc_connection::socket_type                client{ioc};
+      std::shared_ptr<local_rpc_connection>            conn;
+      std::unique_ptr<boost::asio::io_context::work>   work;
+      std::thread                                      thread;
+
+      connected_pair( const local_rpc_connection::limits& l, local_rpc_connection::handler h ) {
+         local_rpc_connection::socket_type server{ioc};
+         boost::asio::local::connect_pair( client, server );
+         conn = std::make_shared<local_rpc_connection>( std::move(server), ioc, l, std::move(h) );
+         work = std::make_unique<boost::asio::io_context::work>( ioc );
+         conn->start();
+         thread = std::thread( [this]() { ioc.run(); } );
+      }
+
+      ~connected_pair() {
+         work.reset();
+         ioc.stop();
+         thread.join();
+         conn->close();
+      }
+
+      void write( const local_rpc_request& req ) {
+         auto packed = fc::raw::pack( req );
+         uint32_t size = packed.size();
+         boost::asio::write( client, boost::asio::buffer( &size, sizeof(size) ) );
+         boost::asio::write( client, boost::asio::buffer( packed ) );
+      }
+
+      local_rpc_response read() {
+         uint32_t size = 0;
+         boost::asio::read( client, boost::asio::buffer( &size, sizeof(size) ) );
+         std::vector<char> frame( size );
+         boost::asio::read( client, boost::asio::buffer( frame ) );
+         return fc::raw::unpack<local_rpc_response>( frame );
+      }
+   };
+
+   /// the requests a handler received, answered when the test says so
+   struct pending_requests {
+      std::mutex                                                                   mtx;
+      std::condition_variable                                                      cv;
+      std::vector<std::pair<std::weak_ptr<local_rpc_connection>, local_rpc_request>> requests;
+
+      local_rpc_connection::handler handler() {
+         return [this]( const std::shared_ptr<local_rpc_connection>& c, local_rpc_request req ) {
+            std::lock_guard<std::mutex> g( mtx );
+            requests.emplace_back( c, std::move(req) );
+            cv.notify_all();
+         };
+      }
+
+      /// waits up to a second for n requests to have arrived, returns how many have
+      size_t wait_for( size_t n ) {
+         std::unique_lock<std::mutex> lock( mtx );
+         cv.wait_for( lock, std::chrono::seconds( 1 ), [&]() { return requests.size() >= n; } );
+         return requests.size();
+      }
+
+      void answer( size_t i ) {
+         std::lock_guard<std::mutex> g( mtx );
+         if( auto c = requests[i].first.lock() )
+            c->send_result( requests[i].second.id, requests[i].second.params );
+      }
+   };
+}
+
+BOOST_AUTO_TEST_SUITE(local_rpc_connection_tests)
+
+BOOST_AUTO_TEST_CASE( round_trip ) {
+   connected_pair pair( {}, []( const std::shared_ptr<local_rpc_connection>& c, local_rpc_request req ) {
+      if( req.method == 0 )
+         c->send_result( req.id, req.params );
+      else
+         c->send_error( req.id, "unknown method" );
+   } );
+
+   pair.write( local_rpc_request{ 7, 0, {'a', 'b', 'c'} } );
+   pair.write( local_rpc_request{ 8, 5, {} } );
+   auto echoed = pair.read();
+   BOOST_CHECK_EQUAL( echoed.id, 7u );
+   BOOST_CHECK( echoed.ok );
+   BOOST_CHECK( echoed.result == chain::bytes( {'a', 'b', 'c'} ) );
+   auto failed = pair.read();
+   BOOST_CHECK_EQUAL( failed.id, 8u );
+   BOOST_CHECK( !failed.ok );
+   BOOST_CHECK_EQUAL( failed.error, "unknown method" );
+}
+
+BOOST_AUTO_TEST_CASE( pipelining_is_bounded ) {
+   pending_requests pending;
+   local_rpc_connection::limits l;
+   l.max_in_flight = 2;
+   connected_pair pair( l, pending.handler() );
+
+   for( uint32_t id = 1; id <= 4; ++id )
+      pair.write( local_rpc_request{ id, 0, {} } );
+   BOOST_REQUIRE_EQUAL( pending.wait_for( 2 ), 2u );
+   // the third is not read while two are unanswered
+   BOOST_CHECK_EQUAL( pending.wait_for( 3 ), 2u );
+
+   pending.answer( 0 );
+   BOOST_CHECK_EQUAL( pair.read().id, 1u );
+   BOOST_REQUIRE_EQUAL( pending.wait_for( 3 ), 3u );
+   BOOST_CHECK_EQUAL( pending.wait_for( 4 ), 3u );
+
+   pending.answer( 1 );
+   pending.answer( 2 );
+   BOOST_CHECK_EQUAL( pair.read().id, 2u );
+   BOOST_CHECK_EQUAL( pair.read().id, 3u );
+   BOOST_REQUIRE_EQUAL( pending.wait_for( 4 ), 4u );
+   pending.answer( 3 );
+   BOOST_CHECK_EQUAL( pair.read().id, 4u );
+}
+
+BOOST_AUTO_TEST_CASE( queued_responses_are_bounded ) {
+   pending_requests pending;
+   local_rpc_connection::limits l;
+   l.max_queued_bytes = 1;
+   connected_pair pair( l, pending.handler() );
+
+   // the client does not read the large response, so it stays queued and no request after the one being read is
+   pair.write( local_rpc_request{ 1, 0, chain::bytes( 4 * 1024 * 1024, 'x' ) } );
+   BOOST_REQUIRE_EQUAL( pending.wait_for( 1 ), 1u );
+   pending.answer( 0 );
+   pair.write( local_rpc_request{ 2, 0, {} } );
+   pair.write( local_rpc_request{ 3, 0, {} } );
+   BOOST_REQUIRE_EQUAL( pending.wait_for( 2 ), 2u );
+   BOOST_CHECK_EQUAL( pending.wait_for( 3 ), 2u );
+
+   // once it has been written, reading resumes
+   auto res = pair.read();
+   BOOST_CHECK_EQUAL( res.id, 1u );
+   BOOST_CHECK_EQUAL( res.result.size(), 4u * 1024 * 1024 );
+   BOOST_CHECK_EQUAL( pending.wait_for( 3 ), 3u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
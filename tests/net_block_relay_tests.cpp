@@ -0,0 +1,64 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/net_plugin/block_relay.hpp>
+
+#include <string>
+#include <vector>
+
+using namespace eosio;
+
+namespace {
+   struct peer {
+      std::string name;
+      bool        producer_peer = false;
+      int64_t     rtt_us = -1;
+   };
+
+   std::vector<std::string> names( const std::vector<peer>& peers, size_t n ) {
+      std::vector<std::string> r;
+      for( size_t i = 0; i < n; ++i ) r.push_back( peers[i].name );
+      return r;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(net_block_relay_tests)
+
+BOOST_AUTO_TEST_CASE( time_message_round_trip ) {
+   const int64_t us = 1000; // timestamps are in nanoseconds
+   // 40us on the wire each way, held 500us by the peer
+   BOOST_CHECK_EQUAL( time_message_rtt_us( 1000*us, 1040*us, 1540*us, 1580*us ), 80 );
+   // clock offsets between the two sides cancel out
+   BOOST_CHECK_EQUAL( time_message_rtt_us( 1000*us, 9040*us, 9540*us, 1580*us ), 80 );
+   // a peer claiming to hold the message longer than the exchange took is not a negative round trip
+   BOOST_CHECK_EQUAL( time_message_rtt_us( 1000*us, 1000*us, 2000*us, 1500*us ), 0 );
+
+   BOOST_CHECK_EQUAL( smoothed_rtt_us( -1, 800 ), 800 );
+   BOOST_CHECK_EQUAL( smoothed_rtt_us( 800, 0 ), 700 );
+   BOOST_CHECK_EQUAL( smoothed_rtt_us( 800, 1600 ), 900 );
+}
+
+BOOST_AUTO_TEST_CASE( relay_order_and_fanout ) {
+   auto rank_of = []( const peer& p ) { return block_relay_rank( p.producer_peer, p.rtt_us ); };
+   const std::vector<peer> all = { {"unmeasured", false, -1}, {"slow", false, 9000}, {"bp1", true, 20000},
+                                   {"fast", false, 300},      {"bp2", true, -1},     {"mid", false, 2000} };
+
+   // producer peers first in their configured order, then the others by round trip time, unmeasured last
+   auto peers = all;
+   BOOST_CHECK_EQUAL( order_block_relay( peers, 0, rank_of ), peers.size() );
+   const std::vector<std::string> order = { "bp1", "bp2", "fast", "mid", "slow", "unmeasured" };
+   BOOST_TEST( names( peers, peers.size() ) == order, boost::test_tools::per_element() );
+
+   // the fan-out counts only the peers that are not producer peers
+   peers = all;
+   BOOST_CHECK_EQUAL( order_block_relay( peers, 2, rank_of ), 4u );
+   const std::vector<std::string> full = { "bp1", "bp2", "fast", "mid" };
+   BOOST_TEST( names( peers, 4 ) == full, boost::test_tools::per_element() );
+
+   peers = all;
+   BOOST_CHECK_EQUAL( order_block_relay( peers, 100, rank_of ), peers.size() );
+
+   std::vector<peer> none;
+   BOOST_CHECK_EQUAL( order_block_relay( none, 2, rank_of ), 0u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
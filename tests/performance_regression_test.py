@@ -0,0 +1,296 @@
+#!/usr/bin/env python3
+
+from testUtils import Utils
+from Cluster import Cluster
+from WalletMgr import WalletMgr
+from Node import BlockType
+from TestHelper import AppArgs
+from TestHelper import TestHelper
+
+import base64
+import datetime
+import json
+import os
+import socket
+import struct
+import time
+import urllib.request
+
+###############################################################
+# performance_regression_test
+#
+#  Measures a cluster of one producing node, <--txn-gen-nodes> non-producing nodes running the
+#  txn_test_gen_plugin and one node started late, then compares the measurements with a baseline.
+#  1) sustained tps: transactions per second of block time in <--measure-blocks> blocks, once the
+#     generators have been running for a while
+#  2) block propagation latency: the mean time from block timestamp to acceptance on the
+#     non-producing nodes, less that on the producing node, over the same blocks; taken from the
+#     prometheus_plugin histograms
+#  3) sync speed: blocks per second the late node syncs until it reaches the head the producer
+#     had when that node was started
+#  4) ship throughput: blocks per second and bytes per second of blocks, traces and deltas read
+#     from the state history plugin of the producing node, over every block it has both of
+#
+#  Measurements are written to <--results-file>. A measurement more than <--threshold> worse than
+#  the one in <--baseline-file> fails the test. A missing baseline file, or a metric missing from
+#  it, is taken from this run instead; <--update-baseline> replaces the baseline with this run.
+#  Baselines only mean something on the machine that recorded them.
+#
+###############################################################
+
+Print=Utils.Print
+errorExit=Utils.errorExit
+
+appArgs=AppArgs()
+appArgs.add(flag="--txn-gen-nodes", type=int, help="How many transaction generator nodes", default=2)
+appArgs.add(flag="--txn-period", type=int, help="Milliseconds between batches sent by each generator", default=20)
+appArgs.add(flag="--txn-batch", type=int, help="Transactions per batch sent by each generator, must be even", default=20)
+appArgs.add(flag="--warmup-blocks", type=int, help="Blocks to let the generators run before measuring", default=20)
+appArgs.add(flag="--measure-blocks", type=int, help="Blocks to measure tps and propagation over", default=60)
+appArgs.add(flag="--ship-port", type=int, help="Port of the state history endpoint of the producing node", default=8080)
+appArgs.add(flag="--baseline-file", type=str, help="Baseline measurements to compare with", default="performance_baseline.json")
+appArgs.add(flag="--results-file", type=str, help="Where to write the measurements of this run", default="performance_results.json")
+appArgs.add(flag="--threshold", type=float, help="Fraction a measurement may be worse than its baseline", default=0.2)
+appArgs.add_bool(flag="--update-baseline", help="Replace the baseline with the measurements of this run")
+args = TestHelper.parse_args({"--dump-error-details","--keep-logs","-v","--leave-running","--clean-run","--wallet-port"},
+                             applicationSpecificArgs=appArgs)
+Utils.Debug=args.v
+txnGenNodeCount=max(args.txn_gen_nodes, 1)
+pnodes=1
+totalNodes=pnodes+txnGenNodeCount+1
+cluster=Cluster(walletd=True)
+dumpErrorDetails=args.dump_error_details
+keepLogs=args.keep_logs
+dontKill=args.leave_running
+killAll=args.clean_run
+walletPort=args.wallet_port
+
+walletMgr=WalletMgr(True, port=walletPort)
+testSuccessful=False
+killEosInstances=not dontKill
+killWallet=not dontKill
+
+# metric name -> True when a larger value is better
+metricDirections={
+    "tps": True,
+    "block_propagation_ms": False,
+    "sync_blocks_per_second": True,
+    "ship_blocks_per_second": True,
+    "ship_bytes_per_second": True,
+}
+
+class WebSocket(object):
+    """Just enough of a websocket client, RFC 6455, to read from the state history plugin."""
+
+    def __init__(self, host, port, timeout=30):
+        self.sock=socket.create_connection((host, port), timeout=timeout)
+        key=base64.b64encode(os.urandom(16)).decode()
+        request=("GET / HTTP/1.1\r\nHost: %s:%d\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                 "Sec-WebSocket-Key: %s\r\nSec-WebSocket-Version: 13\r\n\r\n") % (host, port, key)
+        self.sock.sendall(request.encode())
+        response=b""
+        while b"\r\n\r\n" not in response:
+            chunk=self.sock.recv(4096)
+            if not chunk:
+                raise ConnectionError("connection closed during websocket handshake")
+            response+=chunk
+        header, self.buffer=response.split(b"\r\n\r\n", 1)
+        if b" 101 " not in header.split(b"\r\n")[0]:
+            raise ConnectionError("websocket handshake refused: %s" % (header.split(b"\r\n")[0]))
+
+    def __recvExactly(self, size):
+        while len(self.buffer) < size:
+            chunk=self.sock.recv(max(65536, size-len(self.buffer)))
+            if not chunk:
+                raise ConnectionError("websocket connection closed")
+            self.buffer+=chunk
+        data, self.buffer=self.buffer[:size], self.buffer[size:]
+        return data
+
+    def send(self, payload):
+        mask=os.urandom(4)
+        header=bytes([0x82])
+        if len(payload) < 126:
+            header+=bytes([0x80 | len(payload)])
+        elif len(payload) < 65536:
+            header+=bytes([0x80 | 126])+struct.pack("!H", len(payload))
+        else:
+            header+=bytes([0x80 | 127])+struct.pack("!Q", len(payload))
+        masked=bytes(b ^ mask[i % 4] for i, b in enumerate(payload))
+        self.sock.sendall(header+mask+masked)
+
+    def recv(self):
+        """Returns the payload of the next text or binary message, reassembled from its fragments."""
+        message=b""
+        while True:
+            first, second=self.__recvExactly(2)
+            size=second & 0x7f
+            if size == 126:
+                size=struct.unpack("!H", self.__recvExactly(2))[0]
+            elif size == 127:
+                size=struct.unpack("!Q", self.__recvExactly(8))[0]
+            payload=self.__recvExactly(size)
+            opcode=first & 0x0f
+            if opcode == 0x8:
+                raise ConnectionError("websocket closed by server")
+            if opcode in (0x9, 0xa):
+                continue
+            message+=payload
+            if first & 0x80:
+                return message
+
+    def close(self):
+        self.sock.close()
+
+def getStatus(ws):
+    """The blocks with both traces and deltas in the state history, as [begin, end)."""
+    ws.send(bytes([0]))  # get_status_request_v0
+    result=ws.recv()
+    # result variant index, then head and last_irreversible block_positions of 4 + 32 bytes each
+    traceBegin, traceEnd, chainStateBegin, chainStateEnd=struct.unpack_from("<IIII", result, 1+36+36)
+    return max(traceBegin, chainStateBegin), min(traceEnd, chainStateEnd)
+
+def getBlocksRequest(startBlock, endBlock):
+    """A packed get_blocks_request_v0 with everything fetched; variant index 1 of the request type."""
+    return (bytes([1])+struct.pack("<III", startBlock, endBlock, 0xffffffff)+bytes([0])  # no have_positions
+            +bytes([0, 1, 1, 1]))  # irreversible_only, fetch_block, fetch_traces, fetch_deltas
+
+def scrapeMetrics(node):
+    """The samples served by the prometheus_plugin of node, keyed by name with labels."""
+    url="http://%s:%d/v1/prometheus/metrics" % (node.host, node.port)
+    with urllib.request.urlopen(url, timeout=10) as response:
+        text=response.read().decode()
+    samples={}
+    for line in text.splitlines():
+        if not line or line.startswith("#"):
+            continue
+        name, value=line.rsplit(" ", 1)
+        samples[name]=float(value)
+    return samples
+
+def blockTime(block):
+    return datetime.datetime.strptime(block["timestamp"], "%Y-%m-%dT%H:%M:%S.%f")
+
+def waitForBlock(node, blockNum, blockType=BlockType.head, timeout=None):
+    if not node.waitForBlock(blockNum, timeout=timeout, blockType=blockType, reportInterval=20):
+        info=node.getInfo()
+        errorExit("Failed to get to %s block number %d. Last had head block number %d and lib %d" %
+                  (blockType, blockNum, info["head_block_num"], info["last_irreversible_block_num"]))
+
+def meanLatency(before, after):
+    count=after["eosio_chain_block_latency_seconds_count"]-before["eosio_chain_block_latency_seconds_count"]
+    if count <= 0:
+        errorExit("No blocks accepted while measuring block propagation")
+    return (after["eosio_chain_block_latency_seconds_sum"]-before["eosio_chain_block_latency_seconds_sum"]) / count
+
+try:
+    TestHelper.printSystemInfo("BEGIN")
+    cluster.setWalletMgr(walletMgr)
+
+    cluster.killall(allInstances=killAll)
+    cluster.cleanup()
+    specificExtraNodeosArgs={}
+    specificExtraNodeosArgs[0]=("--plugin eosio::prometheus_plugin --plugin eosio::state_history_plugin --trace-history --chain-state-history "
+                                "--disable-replay-opts --state-history-endpoint 127.0.0.1:%d" % (args.ship_port))
+    txnGenNodeNum=pnodes  # next node after producer nodes
+    for nodeNum in range(txnGenNodeNum, txnGenNodeNum+txnGenNodeCount):
+        specificExtraNodeosArgs[nodeNum]="--plugin eosio::prometheus_plugin --plugin eosio::txn_test_gen_plugin --txn-test-gen-account-prefix txntestacct"
+    Print("Stand up cluster")
+    if cluster.launch(prodCount=1, onlyBios=False, pnodes=pnodes, totalNodes=totalNodes, totalProducers=pnodes,
+                      useBiosBootFile=False, specificExtraNodeosArgs=specificExtraNodeosArgs, unstartedNodes=1, loadSystemContract=False) is False:
+        errorExit("Failed to stand up eos cluster.")
+
+    producerNode=cluster.getNode(0)
+    txnGenNodes=[cluster.getNode(nodeNum) for nodeNum in range(txnGenNodeNum, txnGenNodeNum+txnGenNodeCount)]
+
+    Print("Create accounts for generated txns")
+    txnGenNodes[0].txnGenCreateTestAccounts(cluster.eosioAccount.name, cluster.eosioAccount.activePrivateKey)
+    waitForBlock(producerNode, producerNode.getBlockNum(BlockType.head), blockType=BlockType.lib)
+
+    Print("Startup txn generation")
+    for genNum in range(0, len(txnGenNodes)):
+        txnGenNodes[genNum].txnGenStart("%d" % genNum, args.txn_period, args.txn_batch)
+
+    measurements={}
+
+    startBlockNum=producerNode.getBlockNum(BlockType.head)+args.warmup_blocks
+    endBlockNum=startBlockNum+args.measure_blocks
+    waitForBlock(producerNode, startBlockNum)
+    producerBefore=scrapeMetrics(producerNode)
+    peersBefore=[scrapeMetrics(node) for node in txnGenNodes]
+    waitForBlock(producerNode, endBlockNum)
+    producerAfter=scrapeMetrics(producerNode)
+    peersAfter=[scrapeMetrics(node) for node in txnGenNodes]
+
+    Print("Measure sustained tps")
+    transactions=0
+    for blockNum in range(startBlockNum+1, endBlockNum+1):
+        transactions+=len(producerNode.getBlock(blockNum)["transactions"])
+    seconds=(blockTime(producerNode.getBlock(endBlockNum))-blockTime(producerNode.getBlock(startBlockNum))).total_seconds()
+    measurements["tps"]=transactions / seconds
+
+    Print("Measure block propagation")
+    producerLatency=meanLatency(producerBefore, producerAfter)
+    peerLatency=sum(meanLatency(b, a) for b, a in zip(peersBefore, peersAfter)) / len(peersBefore)
+    measurements["block_propagation_ms"]=max(peerLatency-producerLatency, 0) * 1000
+
+    for node in txnGenNodes:
+        node.processCurlCmd("txn_test_gen", "stop_generation", "{}", silentErrors=True)
+
+    Print("Measure sync speed")
+    syncTarget=producerNode.getBlockNum(BlockType.head)
+    syncStart=time.time()
+    cluster.launchUnstarted(cachePopen=True)
+    syncNode=cluster.getNodes()[-1]
+    waitForBlock(syncNode, syncTarget, timeout=max(syncTarget, 120))
+    measurements["sync_blocks_per_second"]=syncTarget / (time.time()-syncStart)
+
+    Print("Measure ship throughput")
+    ws=WebSocket("127.0.0.1", args.ship_port)
+    ws.recv()  # the abi
+    shipBegin, shipEnd=getStatus(ws)
+    if shipEnd <= shipBegin:
+        errorExit("No blocks in the state history of the producing node")
+    shipStart=time.time()
+    ws.send(getBlocksRequest(shipBegin, shipEnd))
+    shipBytes=0
+    for i in range(shipBegin, shipEnd):
+        shipBytes+=len(ws.recv())
+    shipSeconds=time.time()-shipStart
+    ws.close()
+    measurements["ship_blocks_per_second"]=(shipEnd-shipBegin) / shipSeconds
+    measurements["ship_bytes_per_second"]=shipBytes / shipSeconds
+
+    with open(args.results_file, "w") as f:
+        json.dump(measurements, f, indent=2, sort_keys=True)
+
+    baseline={}
+    if os.path.exists(args.baseline_file) and not args.update_baseline:
+        with open(args.baseline_file) as f:
+            baseline=json.load(f)
+
+    regressions=[]
+    for name, value in sorted(measurements.items()):
+        if name not in baseline:
+            Print("%-24s %14.2f (no baseline, recorded)" % (name, value))
+            baseline[name]=value
+            continue
+        expected=baseline[name]
+        limit=expected * (1-args.threshold) if metricDirections[name] else expected * (1+args.threshold)
+        regressed=value < limit if metricDirections[name] else value > limit
+        Print("%-24s %14.2f baseline %14.2f%s" % (name, value, expected, "  REGRESSION" if regressed else ""))
+        if regressed:
+            regressions.append(name)
+
+    with open(args.baseline_file, "w") as f:
+        json.dump(baseline, f, indent=2, sort_keys=True)
+
+    if regressions:
+        errorExit("Performance regressed beyond %d%% of the baseline in %s" % (args.threshold * 100, ", ".join(regressions)))
+
+    testSuccessful=True
+
+finally:
+    TestHelper.shutdown(cluster, walletMgr, testSuccessful=testSuccessful, killEosInstances=killEosInstances, killWallet=killWallet, keepLogs=keepLogs, cleanRun=killAll, dumpErrorDetails=dumpErrorDetails)
+
+exit(0)
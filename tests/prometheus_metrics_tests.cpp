@@ -0,0 +1,72 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/prometheus_plugin/metrics.hpp>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace eosio::prometheus;
+
+BOOST_AUTO_TEST_SUITE(prometheus_metrics_tests)
+
+BOOST_AUTO_TEST_CASE( counter_and_histogram ) {
+   counter c;
+   std::vector<std::thread> threads;
+   for( int t = 0; t < 4; ++t )
+      threads.emplace_back( [&c]() { for( int i = 0; i < 1000; ++i ) c.inc(); } );
+   for( auto& t : threads )
+      t.join();
+   c.inc( 5 );
+   BOOST_CHECK_EQUAL( c.value(), 4005u );
+
+   // upper bounds are inclusive, the last bucket takes what is above them all
+   histogram h( {10, 100} );
+   for( uint64_t v : {0, 10, 11, 100, 101, 5000} )
+      h.observe( v );
+   BOOST_CHECK_EQUAL( h.bucket( 0 ), 2u );
+   BOOST_CHECK_EQUAL( h.bucket( 1 ), 2u );
+   BOOST_CHECK_EQUAL( h.bucket( 2 ), 2u );
+   BOOST_CHECK_EQUAL( h.sum(), 5222u );
+}
+
+BOOST_AUTO_TEST_CASE( text_exposition ) {
+   histogram h( {1000, 10000} );
+   h.observe( 500 );
+   h.observe( 2000 );
+   h.observe( 20000 );
+
+   text_writer w;
+   w.family( "eosio_blocks_total", "counter", "Blocks accepted" );
+   w.sample( "eosio_blocks_total", uint64_t( 7 ), {{"producer", "a\"b\\c\nd"}} );
+   w.family( "eosio_block_seconds", "histogram", "Block time" );
+   // recorded in microseconds, exposed in seconds
+   w.write_histogram( "eosio_block_seconds", h, 1000000, {{"kind", "x"}} );
+   w.sample( "eosio_ratio", 0.25 );
+
+   const std::string expected =
+      "# HELP eosio_blocks_total Blocks accepted\n"
+      "# TYPE eosio_blocks_total counter\n"
+      "eosio_blocks_total{producer=\"a\\\"b\\\\c\\nd\"} 7\n"
+      "# HELP eosio_block_seconds Block time\n"
+      "# TYPE eosio_block_seconds histogram\n"
+      "eosio_block_seconds_bucket{kind=\"x\",le=\"0.001\"} 1\n"
+      "eosio_block_seconds_bucket{kind=\"x\",le=\"0.01\"} 2\n"
+      "eosio_block_seconds_bucket{kind=\"x\",le=\"+Inf\"} 3\n"
+      "eosio_block_seconds_sum{kind=\"x\"} 0.0225\n"
+      "eosio_block_seconds_count{kind=\"x\"} 3\n"
+      "eosio_ratio 0.25\n";
+   BOOST_CHECK_EQUAL( w.release(), expected );
+
+   // buckets accumulated elsewhere, without labels
+   text_writer plain;
+   plain.write_histogram( "lat", std::vector<uint64_t>{1, 2}, std::vector<uint64_t>{3, 0, 1}, 9 );
+   BOOST_CHECK_EQUAL( plain.release(),
+                      "lat_bucket{le=\"1\"} 3\n"
+                      "lat_bucket{le=\"2\"} 3\n"
+                      "lat_bucket{le=\"+Inf\"} 4\n"
+                      "lat_sum 9\n"
+                      "lat_count 4\n" );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
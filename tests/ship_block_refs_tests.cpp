@@ -0,0 +1,63 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/testing/tester.hpp>
+#include <eosio/state_history_plugin/state_history_filter.hpp>
+#include <eosio/state_history_plugin/state_history_serialization.hpp>
+
+#include <map>
+
+#ifdef NON_VALIDATING_TEST
+#define TESTER tester
+#else
+#define TESTER validating_tester
+#endif
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+BOOST_AUTO_TEST_SUITE(ship_block_refs_tests)
+
+// a trace_history entry packed with its partial transactions left to the block reads back as the full entry
+BOOST_FIXTURE_TEST_CASE( expand_block_refs_round_trip, TESTER ) try {
+   produce_blocks(2);
+
+   std::map<transaction_id_type, augmented_transaction_trace> applied;
+   auto c = control->applied_transaction.connect([&](std::tuple<const transaction_trace_ptr&, const signed_transaction&> x) {
+      const auto& trace = std::get<0>(x);
+      if( trace->receipt )
+         applied[trace->id] = augmented_transaction_trace{trace, std::get<1>(x)};
+   });
+   create_accounts( {N(alice), N(bob), N(carol)} );
+   auto block = produce_block();
+   c.disconnect();
+   BOOST_REQUIRE_EQUAL( block->transactions.size(), 3u );
+
+   // the onblock trace first, then the transactions in block order, as store_traces orders them
+   std::vector<augmented_transaction_trace> traces;
+   for( const auto& [id, t] : applied ) {
+      const bool in_block = std::any_of( block->transactions.begin(), block->transactions.end(), [&id=id]( const auto& r ) {
+         return r.trx.template get<packed_transaction>().id() == id;
+      } );
+      if( !in_block )
+         traces.push_back( t );
+   }
+   BOOST_REQUIRE_EQUAL( traces.size(), 1u );
+   for( const auto& r : block->transactions )
+      traces.push_back( applied.at( r.trx.get<packed_transaction>().id() ) );
+
+   auto with_refs = traces;
+   for( size_t i = 1; i < with_refs.size(); ++i )
+      with_refs[i].partial.reset();
+
+   const auto& db = control->db();
+   const bytes full = fc::raw::pack( make_history_context_wrapper( db, false, traces ) );
+   const bytes refs = fc::raw::pack( make_history_context_wrapper( db, false, with_refs ) );
+   BOOST_REQUIRE_LT( refs.size(), full.size() );
+
+   BOOST_CHECK( history_trace_reader::expand_block_refs( refs, *block ) == full );
+   // an entry without refs is left as it is
+   BOOST_CHECK( history_trace_reader::expand_block_refs( full, *block ) == full );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
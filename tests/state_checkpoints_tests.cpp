@@ -0,0 +1,146 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/chain_plugin/state_checkpoints.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+
+#include <boost/filesystem/operations.hpp>
+
+#include <fstream>
+#include <string>
+
+using namespace eosio;
+
+namespace {
+   block_id_type make_id( uint32_t num, const std::string& fork = "" ) {
+      block_id_type id = fc::sha256::hash( std::to_string( num ) + fork );
+      id._hash[0] &= 0xffffffff00000000;
+      id._hash[0] += fc::endian_reverse_u32( num );
+      return id;
+   }
+
+   void write_file( const bfs::path& p ) {
+      std::ofstream out( p.generic_string(), std::ios::out | std::ios::binary );
+      out << "state";
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(state_checkpoints_tests)
+
+BOOST_AUTO_TEST_CASE( kept_once_written_and_irreversible ) {
+   fc::temp_directory tmp;
+   const bfs::path dir = tmp.path();
+   state_checkpoints cps( dir, 2 );
+
+   // written first, then irreversible
+   const auto a = make_id( 100 );
+   const auto pa = cps.start_write( a );
+   BOOST_CHECK_EQUAL( pa.extension().string(), ".pending" );
+   write_file( pa );
+   cps.write_finished( a, true );
+   BOOST_CHECK( bfs::exists( pa ) );
+   BOOST_CHECK( state_checkpoints::list( dir ).empty() );
+   cps.on_irreversible( a );
+   BOOST_CHECK( !bfs::exists( pa ) );
+   BOOST_CHECK( bfs::exists( cps.path( a ) ) );
+
+   // irreversible while it is still being written
+   const auto b = make_id( 200 );
+   const auto pb = cps.start_write( b );
+   write_file( pb );
+   cps.on_irreversible( b );
+   cps.on_irreversible( make_id( 201 ) );
+   BOOST_CHECK( !bfs::exists( cps.path( b ) ) );
+   cps.write_finished( b, true );
+   BOOST_CHECK( bfs::exists( cps.path( b ) ) );
+   BOOST_CHECK( !cps.is_pending( b ) );
+
+   // only the newest are kept
+   const auto c = make_id( 300 );
+   write_file( cps.start_write( c ) );
+   cps.write_finished( c, true );
+   cps.on_irreversible( c );
+   const auto kept = state_checkpoints::list( dir );
+   BOOST_REQUIRE_EQUAL( kept.size(), 2u );
+   BOOST_CHECK( kept.count( 200 ) && kept.count( 300 ) );
+}
+
+BOOST_AUTO_TEST_CASE( failed_and_forked_out_are_removed ) {
+   fc::temp_directory tmp;
+   const bfs::path dir = tmp.path();
+   state_checkpoints cps( dir, 2 );
+
+   // a failed write leaves neither the partial file nor its integrity hash
+   const auto a = make_id( 100 );
+   const auto pa = cps.start_write( a );
+   write_file( pa );
+   write_file( cps.integrity_path( a ) );
+   cps.write_finished( a, false );
+   BOOST_CHECK( !bfs::exists( pa ) );
+   BOOST_CHECK( !bfs::exists( cps.integrity_path( a ) ) );
+   BOOST_CHECK( !cps.is_pending( a ) );
+   cps.on_irreversible( a );
+   BOOST_CHECK( !bfs::exists( cps.path( a ) ) );
+
+   // forked out after its write finished
+   const auto b = make_id( 200, "fork" );
+   const auto pb = cps.start_write( b );
+   write_file( pb );
+   cps.write_finished( b, true );
+   cps.on_irreversible( make_id( 200 ) );
+   BOOST_CHECK( !bfs::exists( pb ) );
+   BOOST_CHECK( !cps.is_pending( b ) );
+
+   // forked out while it was being written
+   const auto c = make_id( 300, "fork" );
+   const auto pc = cps.start_write( c );
+   write_file( pc );
+   cps.on_irreversible( make_id( 301 ) );
+   cps.write_finished( c, true );
+   BOOST_CHECK( !bfs::exists( pc ) );
+   BOOST_CHECK( state_checkpoints::list( dir ).empty() );
+}
+
+BOOST_AUTO_TEST_CASE( incomplete_writes_of_a_previous_run_are_removed ) {
+   fc::temp_directory tmp;
+   const bfs::path dir = tmp.path();
+   const auto a = make_id( 100 );
+   const auto b = make_id( 200 );
+   {
+      state_checkpoints cps( dir, 2 );
+      write_file( cps.start_write( a ) );
+      cps.write_finished( a, true );
+      cps.on_irreversible( a );
+      write_file( cps.integrity_path( a ) );
+      write_file( cps.start_write( b ) );
+      write_file( cps.integrity_path( b ) );
+   }
+   state_checkpoints cps( dir, 2 );
+   cps.remove_incomplete();
+   BOOST_CHECK( bfs::exists( cps.path( a ) ) );
+   BOOST_CHECK( bfs::exists( cps.integrity_path( a ) ) );
+   BOOST_CHECK( !bfs::exists( cps.path( b ).generic_string() + ".pending" ) );
+   BOOST_CHECK( !bfs::exists( cps.integrity_path( b ) ) );
+}
+
+BOOST_AUTO_TEST_CASE( integrity_hash_check ) {
+   fc::temp_directory tmp;
+   state_checkpoints cps( tmp.path(), 2 );
+   const auto a = make_id( 100 );
+   const auto hash = fc::sha256::hash( std::string( "state" ) );
+   BOOST_CHECK( cps.check_integrity_hash( a, hash ) == state_checkpoints::hash_check::unrecorded );
+
+   cps.record_integrity_hash( a, hash );
+   BOOST_CHECK( cps.check_integrity_hash( a, hash ) == state_checkpoints::hash_check::matches );
+   BOOST_CHECK( cps.check_integrity_hash( a, fc::sha256::hash( std::string( "diverged" ) ) ) == state_checkpoints::hash_check::differs );
+   BOOST_CHECK( cps.check_integrity_hash( make_id( 100, "fork" ), hash ) == state_checkpoints::hash_check::unrecorded );
+
+   // a corrupted record never matches
+   write_file( cps.integrity_path( a ) );
+   BOOST_CHECK( cps.check_integrity_hash( a, hash ) == state_checkpoints::hash_check::differs );
+   cps.record_integrity_hash( a, fc::sha256::hash( std::string( "other state" ) ) );
+   BOOST_CHECK( cps.check_integrity_hash( a, hash ) == state_checkpoints::hash_check::differs );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/state_history_plugin/state_history_log.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/filesystem.hpp>
+
+#include <string>
+
+using namespace eosio;
+using namespace eosio::chain;
+namespace bfs = boost::filesystem;
+
+namespace {
+   block_id_type make_id( uint32_t num, const std::string& fork = "" ) {
+      block_id_type id = fc::sha256::hash( std::to_string( num ) + fork );
+      id._hash[0] &= 0xffffffff00000000;
+      id._hash[0] += fc::endian_reverse_u32( num );
+      return id;
+   }
+
+   void write_block( state_history_log& log, const block_id_type& id, const block_id_type& prev_id ) {
+      const std::string payload = id.str();
+      state_history_log_header header{ ship_magic( ship_current_version ), id, payload.size() };
+      log.write_entry( header, prev_id, [&]( fc::cfile& f ) { f.write( payload.data(), payload.size() ); } );
+   }
+
+   std::string read_payload( state_history_log& log, uint32_t block_num ) {
+      state_history_log_header header;
+      auto [data, size] = log.get_payload( block_num, header );
+      return std::string( data, size );
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(state_history_log_tests)
+
+BOOST_AUTO_TEST_CASE( fork_into_retained_file ) {
+   fc::temp_directory tmp;
+   const bfs::path dir = tmp.path();
+   state_history_log_config config;
+   config.stride       = 4;
+   config.retained_dir = dir / "retained";
+   const auto log_path   = ( dir / "trace_history.log" ).string();
+   const auto index_path = ( dir / "trace_history.index" ).string();
+
+   {
+      state_history_log log( "trace_history", log_path, index_path, config );
+      for( uint32_t n = 1; n < 10; ++n )
+         write_block( log, make_id( n ), make_id( n - 1 ) );
+      BOOST_CHECK( bfs::exists( config.retained_dir / "trace_history-1-3.log" ) );
+      BOOST_CHECK( bfs::exists( config.retained_dir / "trace_history-4-7.log" ) );
+      BOOST_CHECK_EQUAL( log.begin_block(), 1u );
+      BOOST_CHECK_EQUAL( log.end_block(), 10u );
+      // served from the retained files, which are opened on their own
+      BOOST_CHECK_EQUAL( read_payload( log, 2 ), make_id( 2 ).str() );
+      BOOST_CHECK_EQUAL( read_payload( log, 6 ), make_id( 6 ).str() );
+
+      // a fork of block 6 replaces the blocks after it, both those of the log and those split off
+      BOOST_CHECK_THROW( write_block( log, make_id( 6, "fork" ), make_id( 5, "fork" ) ), plugin_exception );
+      write_block( log, make_id( 6, "fork" ), make_id( 5 ) );
+      BOOST_CHECK_EQUAL( log.end_block(), 7u );
+      BOOST_CHECK( !bfs::exists( config.retained_dir / "trace_history-4-7.log" ) );
+      BOOST_CHECK_EQUAL( read_payload( log, 5 ), make_id( 5 ).str() );
+      BOOST_CHECK_EQUAL( read_payload( log, 6 ), make_id( 6, "fork" ).str() );
+      BOOST_CHECK_EQUAL( log.get_block_id( 6 ), make_id( 6, "fork" ) );
+      write_block( log, make_id( 7, "fork" ), make_id( 6, "fork" ) );
+      write_block( log, make_id( 8, "fork" ), make_id( 7, "fork" ) );
+      BOOST_CHECK( bfs::exists( config.retained_dir / "trace_history-4-7.log" ) );
+   }
+
+   // found again on startup, without overlapping the log
+   state_history_log log( "trace_history", log_path, index_path, config );
+   BOOST_CHECK_EQUAL( log.begin_block(), 1u );
+   BOOST_CHECK_EQUAL( log.end_block(), 9u );
+   BOOST_CHECK_EQUAL( read_payload( log, 7 ), make_id( 7, "fork" ).str() );
+   BOOST_CHECK_EQUAL( read_payload( log, 8 ), make_id( 8, "fork" ).str() );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,102 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/testing/tester.hpp>
+#include <eosio/state_history_plugin/table_rows_history.hpp>
+
+#include <contracts.hpp>
+
+#include <fc/crypto/sha256.hpp>
+#include <fc/variant_object.hpp>
+
+#include <string>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+namespace {
+   block_id_type make_id( uint32_t num, const std::string& fork = "" ) {
+      block_id_type id = fc::sha256::hash( std::to_string( num ) + fork );
+      id._hash[0] &= 0xffffffff00000000;
+      id._hash[0] += fc::endian_reverse_u32( num );
+      return id;
+   }
+
+   table_rows_change make_change( uint32_t num, const std::string& fork, const block_id_type& previous ) {
+      table_rows_change c;
+      c.block = {num, make_id( num, fork )};
+      c.previous = previous;
+      return c;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(table_rows_history_tests)
+
+BOOST_AUTO_TEST_CASE( rows_and_their_undo_from_the_pending_block ) try {
+   tester t;
+   t.create_accounts( {N(eosio.token)} );
+   t.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+   t.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+   t.produce_block();
+
+   t.push_action( N(eosio.token), N(create), N(eosio.token), fc::mutable_variant_object()
+                  ("issuer", "eosio")
+                  ("maximum_supply", asset::from_string( "1000000000.0000 SYS" )) );
+   auto created = collect_table_rows_change( t.control->db() );
+   BOOST_REQUIRE_EQUAL( created.rows.size(), 1u );
+   BOOST_REQUIRE_EQUAL( created.undo_rows.size(), 1u );
+   BOOST_CHECK( created.rows[0].present );
+   BOOST_CHECK_EQUAL( created.rows[0].code, N(eosio.token) );
+   BOOST_CHECK_EQUAL( created.rows[0].table, N(stat) );
+   BOOST_CHECK( !created.undo_rows[0].present );
+   BOOST_CHECK_EQUAL( created.undo_rows[0].primary_key, created.rows[0].primary_key );
+   t.produce_block();
+
+   // the supply changes and the issuer's balance is created: undone by restoring the supply after removing the balance
+   t.push_action( N(eosio.token), N(issue), config::system_account_name, fc::mutable_variant_object()
+                  ("to", "eosio")
+                  ("quantity", asset::from_string( "100.0000 SYS" ))
+                  ("memo", "") );
+   auto issued = collect_table_rows_change( t.control->db() );
+   BOOST_REQUIRE_EQUAL( issued.rows.size(), 2u );
+   BOOST_REQUIRE_EQUAL( issued.undo_rows.size(), 2u );
+   BOOST_CHECK_EQUAL( issued.rows[0].table, N(stat) );
+   BOOST_CHECK_EQUAL( issued.rows[1].table, N(accounts) );
+   BOOST_CHECK_EQUAL( issued.undo_rows[0].table, N(accounts) );
+   BOOST_CHECK( !issued.undo_rows[0].present );
+   BOOST_CHECK_EQUAL( issued.undo_rows[1].table, N(stat) );
+   BOOST_CHECK( issued.undo_rows[1].present );
+   BOOST_CHECK( issued.undo_rows[1].value == created.rows[0].value );
+   BOOST_CHECK( issued.undo_rows[1].value != issued.rows[0].value );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( blocks_forked_out_newest_first ) {
+   table_rows_history history;
+   BOOST_CHECK( history.fork_to( make_id( 99 ) ).empty() );
+
+   history.push( make_change( 100, "", make_id( 99 ) ) );
+   history.push( make_change( 101, "", make_id( 100 ) ) );
+   history.push( make_change( 102, "", make_id( 101 ) ) );
+   BOOST_CHECK( history.fork_to( make_id( 102 ) ).empty() );
+   BOOST_CHECK_EQUAL( history.size(), 3u );
+
+   // a block following 100 forks out 102 then 101
+   auto forked = history.fork_to( make_id( 100 ) );
+   BOOST_REQUIRE_EQUAL( forked.size(), 2u );
+   BOOST_CHECK( forked[0].block.block_id == make_id( 102 ) );
+   BOOST_CHECK( forked[1].block.block_id == make_id( 101 ) );
+   BOOST_CHECK_EQUAL( history.size(), 1u );
+
+   history.push( make_change( 101, "b", make_id( 100 ) ) );
+   history.push( make_change( 102, "b", make_id( 101, "b" ) ) );
+   history.prune( 100 );
+   BOOST_CHECK_EQUAL( history.size(), 2u );
+
+   // a block following the irreversible block forks out every block recorded
+   forked = history.fork_to( make_id( 100 ) );
+   BOOST_REQUIRE_EQUAL( forked.size(), 2u );
+   BOOST_CHECK( forked[0].block.block_id == make_id( 102, "b" ) );
+   BOOST_CHECK_EQUAL( history.size(), 0u );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
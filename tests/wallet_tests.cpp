@@ -175,6 +175,23 @@ BOOST_AUTO_TEST_CASE(wallet_manager_test)
    BOOST_CHECK(find(pks.cbegin(), pks.cend(), pkey1.get_public_key()) != pks.cend());
    BOOST_CHECK(find(pks.cbegin(), pks.cend(), pkey2.get_public_key()) != pks.cend());
 
+   // a batch signs each transaction as sign_transaction does, on the signing threads and in order
+   wm.set_signing_threads(3);
+   std::vector<wallet_manager::sign_request> requests;
+   for (uint16_t i = 0; i < 10; ++i) {
+      chain::signed_transaction t;
+      t.ref_block_num = i;
+      requests.push_back({t, i % 2 ? pubkeys : flat_set<public_key_type>{pkey1.get_public_key()}, chain_id});
+   }
+   auto signed_trxs = wm.sign_transactions(requests);
+   BOOST_REQUIRE_EQUAL(requests.size(), signed_trxs.size());
+   for (size_t i = 0; i < requests.size(); ++i) {
+      BOOST_CHECK_EQUAL(signed_trxs[i].ref_block_num, i);
+      BOOST_CHECK(signed_trxs[i].signatures == wm.sign_transaction(requests[i].trx, requests[i].keys, chain_id).signatures);
+   }
+   requests.back().keys.emplace(private_key_type::generate().get_public_key());
+   BOOST_CHECK_THROW(wm.sign_transactions(requests), wallet_missing_pub_key_exception);
+
    BOOST_CHECK_EQUAL(3u, wm.get_public_keys().size());
    wm.set_timeout(chrono::seconds(0));
    BOOST_CHECK_THROW(wm.get_public_keys(), wallet_locked_exception);
@@ -2,6 +2,7 @@
 #include <vector>
 #include <iterator>
 #include <cstdlib>
+#include <thread>
 
 #include <boost/test/unit_test.hpp>
 
@@ -51,6 +52,9 @@ void verify_round_trip_conversion( const abi_serializer& abis, const type_name&
    BOOST_REQUIRE_EQUAL(fc::to_hex(bytes), hex);
    auto var2 = abis.binary_to_variant(type, bytes, abi_serializer::create_yield_function( max_serialization_time ));
    BOOST_REQUIRE_EQUAL(fc::json::to_string(var2, fc::time_point::now() + max_serialization_time), expected_json);
+   std::string direct_json;
+   abis.binary_to_json(type, bytes, direct_json, abi_serializer::create_yield_function( max_serialization_time ));
+   BOOST_REQUIRE_EQUAL(direct_json, expected_json);
    auto bytes2 = abis.variant_to_binary(type, var2, abi_serializer::create_yield_function( max_serialization_time ));
    BOOST_REQUIRE_EQUAL(fc::to_hex(bytes2), hex);
 }
@@ -1871,6 +1875,48 @@ BOOST_AUTO_TEST_CASE(abi_type_def)
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(abi_serializer_copy_and_move)
+{ try {
+   const char* abi_str = R"=====(
+   {
+     "version": "eosio::abi/1.1",
+     "types": [{ "new_type_name": "account_name", "type": "name" },
+               { "new_type_name": "names", "type": "account_name[]" }],
+     "structs": [{ "name": "base", "base": "", "fields": [{ "name": "memo", "type": "string" }] },
+                 { "name": "transfer", "base": "base", "fields": [
+                    { "name": "from", "type": "account_name" },
+                    { "name": "to", "type": "names" },
+                    { "name": "amount", "type": "uint64?" },
+                    { "name": "extra", "type": "uint8$" }]
+                 }],
+     "actions": [{ "name": "transfer", "type": "transfer", "ricardian_contract": "" }],
+     "tables": []
+   }
+   )=====";
+
+   auto var = fc::json::from_string(R"({"memo":"hi","from":"kevin","to":["dan","larry"],"amount":16,"extra":2})");
+
+   fc::optional<abi_serializer> copied;
+   fc::optional<abi_serializer> moved;
+   {
+      abi_serializer original(fc::json::from_string(abi_str).as<abi_def>(), abi_serializer::create_yield_function( max_serialization_time ));
+      verify_byte_round_trip_conversion(original, "transfer", var);
+      copied.emplace(original);
+      abi_serializer tmp(original);
+      moved.emplace(std::move(tmp));
+   }
+
+   // serializers must not refer to the (now destroyed) serializer they were copied from
+   verify_byte_round_trip_conversion(*copied, "transfer", var);
+   verify_byte_round_trip_conversion(*moved, "transfer", var);
+
+   abi_serializer assigned;
+   assigned = *copied;
+   copied.reset();
+   verify_byte_round_trip_conversion(assigned, "transfer", var);
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(abi_type_loop)
 { try {
    // inifinite loop in types
@@ -2787,4 +2833,79 @@ BOOST_AUTO_TEST_CASE(serialize_optional_struct_type)
    } FC_LOG_AND_RETHROW()
 }
 
+BOOST_AUTO_TEST_CASE(specialized_built_in_type)
+{
+   auto abi = R"({
+      "version": "eosio::abi/1.0",
+      "structs": [
+         {"name": "s", "base": "", "fields": [
+            {"name": "n", "type": "name"},
+            {"name": "u", "type": "uint64"},
+            {"name": "l", "type": "uint64[]"}
+         ]},
+      ],
+   })";
+
+   try {
+      abi_serializer abis( fc::json::from_string(abi).as<abi_def>(), abi_serializer::create_yield_function( max_serialization_time ) );
+      verify_round_trip_conversion(abis, "s", R"({"n":"alice","u":10,"l":[1,2]})",
+                                   "0000000000855c340a00000000000000020100000000000000" "0200000000000000");
+
+      // a replaced built-in is handled by its own functions, not by the kind it was listed with
+      abis.add_specialized_unpack_pack( "uint64", std::make_pair<abi_serializer::unpack_function, abi_serializer::pack_function>(
+         []( fc::datastream<const char*>& stream, bool is_array, bool is_optional, const abi_serializer::yield_function_t& ) {
+            BOOST_REQUIRE( !is_optional );
+            uint8_t v = 0;
+            if( is_array ) {
+               fc::unsigned_int size;
+               fc::raw::unpack( stream, size );
+               vector<fc::variant> vars;
+               for( uint32_t i = 0; i < size.value; ++i ) {
+                  fc::raw::unpack( stream, v );
+                  vars.emplace_back( v );
+               }
+               return fc::variant( vars );
+            }
+            fc::raw::unpack( stream, v );
+            return fc::variant( v );
+         },
+         []( const fc::variant& var, fc::datastream<char*>& ds, bool is_array, bool, const abi_serializer::yield_function_t& ) {
+            if( is_array )
+               fc::raw::pack( ds, var.as<vector<uint8_t>>() );
+            else
+               fc::raw::pack( ds, var.as<uint8_t>() );
+         } ) );
+      verify_round_trip_conversion(abis, "s", R"({"n":"alice","u":10,"l":[1,2]})", "0000000000855c340a020102");
+   } FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(yield_function_deadline_interval)
+{
+   try {
+      // the first call reads the clock
+      auto expired = abi_serializer::create_yield_function( fc::microseconds(0) );
+      BOOST_CHECK_THROW( expired( 0 ), abi_serialization_deadline_exception );
+
+      auto yield = abi_serializer::create_yield_function( fc::milliseconds(50) );
+      yield( 0 );
+      std::this_thread::sleep_for( std::chrono::milliseconds(100) );
+      // later calls only read it every deadline_check_interval calls, but the recursion depth is checked on each
+      BOOST_CHECK_THROW( yield( abi_serializer::max_recursion_depth ), abi_recursion_depth_exception );
+      bool expired_in_interval = false;
+      for( uint32_t i = 0; i < abi_serializer::deadline_check_interval; ++i ) {
+         try {
+            yield( 1 );
+         } catch( const abi_serialization_deadline_exception& ) {
+            expired_in_interval = true;
+            break;
+         }
+      }
+      BOOST_CHECK( expired_in_interval );
+
+      auto unlimited = abi_serializer::create_yield_function( fc::microseconds::maximum() );
+      for( uint32_t i = 0; i < 2 * abi_serializer::deadline_check_interval; ++i )
+         unlimited( 0 );
+   } FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
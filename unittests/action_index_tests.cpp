@@ -0,0 +1,88 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/action_index.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <vector>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+namespace {
+   std::vector<action_index_entry> read_index( const fc::path& file, action_index_header& header ) {
+      std::ifstream in( file.generic_string(), std::ios::in | std::ios::binary );
+      in.read( reinterpret_cast<char*>( &header ), sizeof( header ) );
+      std::vector<action_index_entry> entries( header.entries );
+      in.read( reinterpret_cast<char*>( entries.data() ), entries.size() * sizeof( action_index_entry ) );
+      BOOST_REQUIRE( in );
+      return entries;
+   }
+
+   bool indexed( const std::vector<action_index_entry>& entries, account_name account, uint32_t block_num, uint32_t ordinal ) {
+      for( const auto& e : entries ) {
+         if( e.account == account.to_uint64_t() && e.block_num == block_num && e.trx_index == 0 && e.action_ordinal == ordinal )
+            return true;
+      }
+      return false;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE(action_index_tests)
+
+BOOST_AUTO_TEST_CASE( actions_indexed_under_account_and_authorizers ) try {
+   fc::temp_directory dir;
+   uint32_t block_num = 0;
+   {
+      tester t( dir, []( controller::config& ) {}, true );
+      t.create_accounts( {N(alice), N(bob), N(carol)} );
+      t.produce_block();
+
+      // neither account has code, the actions only need their authorizations
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{N(alice), config::active_name}}, N(alice), N(first), bytes{} );
+      trx.actions.emplace_back( vector<permission_level>{{N(alice), config::active_name}, {N(bob), config::active_name}},
+                                N(carol), N(second), bytes{} );
+      t.set_transaction_headers( trx );
+      trx.sign( t.get_private_key( N(alice), "active" ), t.control->get_chain_id() );
+      trx.sign( t.get_private_key( N(bob), "active" ), t.control->get_chain_id() );
+      t.push_transaction( trx );
+      block_num = t.produce_block()->block_num();
+      t.produce_blocks( 3 );
+      BOOST_REQUIRE_GE( t.control->last_irreversible_block_num(), block_num );
+   }
+
+   fc::temp_directory out_dir;
+   const auto out_file = out_dir.path() / "actions.index";
+   const auto written = make_action_index( dir.path() / config::default_blocks_dir_name, out_file, 0,
+                                           std::numeric_limits<uint32_t>::max(), 2 );
+   BOOST_CHECK( !fc::exists( out_dir.path() / "actions.index.runs" ) );
+
+   action_index_header header;
+   const auto entries = read_index( out_file, header );
+   BOOST_CHECK_EQUAL( header.magic, action_index_header().magic );
+   BOOST_CHECK_EQUAL( header.first_block, 1u );
+   BOOST_CHECK_GE( header.last_block, block_num );
+   BOOST_CHECK_EQUAL( header.entries, written.entries );
+   BOOST_CHECK( std::is_sorted( entries.begin(), entries.end() ) );
+
+   // the account an action is sent to and each of its authorizers, once each
+   BOOST_CHECK( indexed( entries, N(alice), block_num, 1 ) );
+   BOOST_CHECK( indexed( entries, N(alice), block_num, 2 ) );
+   BOOST_CHECK( indexed( entries, N(bob), block_num, 2 ) );
+   BOOST_CHECK( indexed( entries, N(carol), block_num, 2 ) );
+   BOOST_CHECK( !indexed( entries, N(bob), block_num, 1 ) );
+   BOOST_CHECK_EQUAL( std::count_if( entries.begin(), entries.end(), [&]( const action_index_entry& e ) { return e.block_num == block_num; } ), 4 );
+
+   // only the blocks asked for, none past the end of the log
+   const auto part = make_action_index( dir.path() / config::default_blocks_dir_name, out_file, block_num, block_num, 1 );
+   BOOST_CHECK_EQUAL( part.first_block, block_num );
+   BOOST_CHECK_EQUAL( part.last_block, block_num );
+   BOOST_CHECK_EQUAL( part.entries, 4u );
+   BOOST_CHECK_THROW( make_action_index( dir.path() / config::default_blocks_dir_name, out_file, header.last_block + 1,
+                                         std::numeric_limits<uint32_t>::max(), 1 ), fc::invalid_arg_exception );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2810,4 +2810,39 @@ BOOST_FIXTURE_TEST_CASE(action_ordinal_failtest3, TESTER) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(cpu_breakdown_tests) { try {
+   fc::temp_directory tempdir;
+   tester chain( tempdir, []( controller::config& cfg ) { cfg.trace_cpu_breakdown = true; }, true );
+   chain.execute_setup_policy( setup_policy::full );
+   chain.create_accounts( { N(alice), N(bob), N(eosio.token) } );
+   chain.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+   chain.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+   chain.produce_block();
+
+   chain.push_action( N(eosio.token), N(create), N(eosio.token), fc::mutable_variant_object()("issuer", "alice")("maximum_supply", "1000.0000 TKN") );
+   chain.push_action( N(eosio.token), N(issue), N(alice), fc::mutable_variant_object()("to", "alice")("quantity", "1000.0000 TKN")("memo", "") );
+   auto trace = chain.push_action( N(eosio.token), N(transfer), N(alice),
+                                   fc::mutable_variant_object()("from", "alice")("to", "bob")("quantity", "1.0000 TKN")("memo", "") );
+
+   BOOST_REQUIRE( trace->cpu_breakdown );
+   BOOST_CHECK_GT( trace->cpu_breakdown->authorization_ns, 0u );
+   BOOST_CHECK_GT( trace->cpu_breakdown->ram_ns, 0u );
+   BOOST_REQUIRE_EQUAL( trace->action_traces.size(), 3u ); // the transfer and its notifications of alice and bob
+   const auto& transfer = trace->action_traces[0];
+   BOOST_REQUIRE( transfer.cpu_breakdown );
+   BOOST_CHECK_GT( transfer.cpu_breakdown->wasm_baseline_ns + transfer.cpu_breakdown->wasm_oc_ns, 0u );
+   BOOST_CHECK_GT( transfer.cpu_breakdown->host_db_ns, 0u );
+   BOOST_CHECK_GT( transfer.cpu_breakdown->host_auth_ns, 0u );   // require_auth and is_account
+   BOOST_CHECK_LE( transfer.cpu_breakdown->host_ns() + transfer.cpu_breakdown->ram_ns,
+                   uint64_t( transfer.elapsed.count() + 1 ) * 1000 );
+   for( const auto& at : trace->action_traces )
+      BOOST_CHECK( at.cpu_breakdown );
+
+   fc::temp_directory untraced_dir;
+   tester untraced( untraced_dir, []( controller::config& ) {}, true );
+   auto untraced_trace = untraced.create_account( N(carol) );
+   BOOST_CHECK( !untraced_trace->cpu_breakdown );
+   BOOST_CHECK( !untraced_trace->action_traces[0].cpu_breakdown );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_SUITE_END()
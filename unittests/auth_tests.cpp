@@ -480,6 +480,33 @@ try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE( satisfied_authority_cache ) { try {
+   TESTER chain;
+   chain.create_account(name("alice"));
+   chain.produce_block();
+
+   const auto& auth_manager = chain.control->get_authorization_manager();
+   vector<action> actions{ action{ {{name("alice"), config::active_name}}, name("eosio.token"), name("transfer"), bytes{} } };
+   const auto active_key = chain.get_public_key(name("alice"), "active");
+   const auto other_key = chain.get_public_key(name("alice"), "other");
+
+   auto check = [&]( const flat_set<public_key_type>& keys ) {
+      auth_manager.check_authorization( actions, keys, {}, fc::microseconds(0), std::function<void()>(), false, {}, true );
+   };
+
+   // cached and uncached checks agree, including on irrelevant signatures
+   check( {active_key} );
+   check( {active_key} );
+   BOOST_CHECK_THROW( check( {active_key, other_key} ), tx_irrelevant_sig );
+   BOOST_CHECK_THROW( check( {other_key} ), unsatisfied_authorization );
+
+   // changing the permission invalidates the cached result
+   chain.set_authority(name("alice"), config::active_name, authority(other_key), config::owner_name);
+   BOOST_CHECK_THROW( check( {active_key} ), unsatisfied_authorization );
+   check( {other_key} );
+
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( linkauth_special ) { try {
    TESTER chain;
 
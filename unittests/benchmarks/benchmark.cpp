@@ -0,0 +1,83 @@
+#include "benchmark.hpp"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <new>
+
+namespace eosio { namespace benchmark {
+
+   allocation_counters& allocations() {
+      static allocation_counters counters;
+      return counters;
+   }
+
+   result timer::finish( std::string name, uint64_t iterations )const {
+      result r;
+      r.name       = std::move(name);
+      r.iterations = iterations;
+      if( iterations ) {
+         r.ns_per_op     = std::chrono::duration<double, std::nano>( _elapsed ).count() / iterations;
+         r.allocs_per_op = double( _allocs ) / iterations;
+         r.bytes_per_op  = double( _bytes ) / iterations;
+      }
+      return r;
+   }
+
+   void report( const result& r ) {
+      std::cout << std::left << std::setw(48) << r.name << std::right
+                << std::setw(10) << r.iterations << " iterations"
+                << std::fixed << std::setprecision(1)
+                << std::setw(14) << r.ns_per_op << " ns/op"
+                << std::setw(10) << r.allocs_per_op << " allocs/op"
+                << std::setw(12) << r.bytes_per_op << " B/op" << std::endl;
+   }
+
+   uint64_t scaled( uint64_t iterations ) {
+      static const double scale = []() {
+         const std::string arg = "--benchmark-scale=";
+         auto& suite = boost::unit_test::framework::master_test_suite();
+         for( int i = 0; i < suite.argc; ++i ) {
+            if( std::string( suite.argv[i] ).compare( 0, arg.size(), arg ) == 0 )
+               return std::atof( suite.argv[i] + arg.size() );
+         }
+         return 1.0;
+      }();
+      return std::max<uint64_t>( 1, iterations * scale );
+   }
+
+} } /// eosio::benchmark
+
+// Counting replacements of the global allocation functions; the sized, array and nothrow forms all end up here.
+void* operator new( std::size_t size ) {
+   auto& a = eosio::benchmark::allocations();
+   a.count.fetch_add( 1, std::memory_order_relaxed );
+   a.bytes.fetch_add( size, std::memory_order_relaxed );
+   if( void* p = std::malloc( size ? size : 1 ) )
+      return p;
+   throw std::bad_alloc();
+}
+
+void* operator new[]( std::size_t size ) {
+   return ::operator new( size );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t& ) noexcept {
+   try {
+      return ::operator new( size );
+   } catch( ... ) {
+      return nullptr;
+   }
+}
+
+void* operator new[]( std::size_t size, const std::nothrow_t& ) noexcept {
+   return ::operator new( size, std::nothrow );
+}
+
+void operator delete( void* p ) noexcept { std::free( p ); }
+void operator delete[]( void* p ) noexcept { std::free( p ); }
+void operator delete( void* p, std::size_t ) noexcept { std::free( p ); }
+void operator delete[]( void* p, std::size_t ) noexcept { std::free( p ); }
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+namespace eosio { namespace benchmark {
+
+   /// allocations made through global operator new by every thread, counted by benchmark.cpp
+   struct allocation_counters {
+      std::atomic<uint64_t> count{0};
+      std::atomic<uint64_t> bytes{0};
+   };
+   allocation_counters& allocations();
+
+   struct result {
+      std::string name;
+      uint64_t    iterations     = 0;
+      double      ns_per_op      = 0;
+      double      allocs_per_op  = 0;
+      double      bytes_per_op   = 0;
+   };
+
+   /// accumulates the time and allocations of the measured sections of a benchmark
+   class timer {
+   public:
+      template<typename F>
+      void time( F&& f ) {
+         auto& a = allocations();
+         const uint64_t count = a.count.load( std::memory_order_relaxed );
+         const uint64_t bytes = a.bytes.load( std::memory_order_relaxed );
+         const auto start = std::chrono::steady_clock::now();
+         f();
+         _elapsed += std::chrono::steady_clock::now() - start;
+         _allocs  += a.count.load( std::memory_order_relaxed ) - count;
+         _bytes   += a.bytes.load( std::memory_order_relaxed ) - bytes;
+      }
+
+      result finish( std::string name, uint64_t iterations )const;
+
+   private:
+      std::chrono::steady_clock::duration _elapsed{0};
+      uint64_t                            _allocs = 0;
+      uint64_t                            _bytes  = 0;
+   };
+
+   /// prints one line per benchmark: iterations, ns/op, allocations/op and bytes/op
+   void report( const result& r );
+
+   /**
+    * Runs body(i, t) for i in [0, iterations) after iterations / 10 untimed warm up calls. Only what body passes to
+    * t.time() is measured, so per iteration setup such as signing a transaction or producing a block is left out.
+    */
+   template<typename Body>
+   result run( std::string name, uint64_t iterations, Body&& body ) {
+      timer warm_up;
+      for( uint64_t i = 0; i < iterations / 10; ++i )
+         body( i, warm_up );
+      timer t;
+      for( uint64_t i = 0; i < iterations; ++i )
+         body( iterations / 10 + i, t );
+      auto r = t.finish( std::move(name), iterations );
+      report( r );
+      return r;
+   }
+
+   /// iterations scaled by the --benchmark-scale=<factor> argument given after "--", 1 by default
+   uint64_t scaled( uint64_t iterations );
+
+} } /// eosio::benchmark
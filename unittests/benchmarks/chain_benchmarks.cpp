@@ -0,0 +1,183 @@
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/authorization_manager.hpp>
+#include <eosio/chain/merkle.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/variant_object.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <contracts.hpp>
+
+#include "benchmark.hpp"
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+namespace {
+
+   std::vector<std::pair<std::string, wasm_interface::vm_type>> enabled_runtimes() {
+      std::vector<std::pair<std::string, wasm_interface::vm_type>> runtimes;
+#ifdef EOSIO_WABT_RUNTIME_ENABLED
+      runtimes.emplace_back( "wabt", wasm_interface::vm_type::wabt );
+#endif
+#ifdef EOSIO_EOS_VM_RUNTIME_ENABLED
+      runtimes.emplace_back( "eos-vm", wasm_interface::vm_type::eos_vm );
+#endif
+#ifdef EOSIO_EOS_VM_JIT_RUNTIME_ENABLED
+      runtimes.emplace_back( "eos-vm-jit", wasm_interface::vm_type::eos_vm_jit );
+#endif
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+      runtimes.emplace_back( "eos-vm-oc", wasm_interface::vm_type::eos_vm_oc );
+#endif
+      return runtimes;
+   }
+
+   /// a fully set up chain running its contracts on one wasm runtime
+   struct runtime_chain {
+      fc::temp_directory tempdir;
+      tester             chain;
+
+      explicit runtime_chain( wasm_interface::vm_type runtime )
+      : chain( tempdir, [runtime]( controller::config& cfg ) { cfg.wasm_runtime = runtime; }, true ) {
+         chain.execute_setup_policy( setup_policy::full );
+      }
+
+      /// signs trxs transactions of the action built by make_action(i) outside of the measurement
+      template<typename MakeAction>
+      std::vector<signed_transaction> sign_transactions( uint64_t trxs, account_name signer, MakeAction&& make_action ) {
+         std::vector<signed_transaction> result( trxs );
+         for( uint64_t i = 0; i < trxs; ++i ) {
+            auto& trx = result[i];
+            trx.actions.emplace_back( make_action( i ) );
+            // a context free nonce keeps identical actions from being duplicate transactions
+            trx.context_free_actions.emplace_back( vector<permission_level>(), config::null_account_name, N(nonce),
+                                                   fc::raw::pack( i ) );
+            chain.set_transaction_headers( trx );
+            trx.sign( tester::get_private_key( signer, "active" ), chain.control->get_chain_id() );
+         }
+         return result;
+      }
+
+      /// pushes the transactions, producing a block outside of the measurement every trxs_per_block of them
+      benchmark::result push_transactions( const std::string& name, std::vector<signed_transaction>& trxs ) {
+         const uint64_t trxs_per_block = 50;
+         // benchmark::run uses a tenth of the iterations again to warm up
+         return benchmark::run( name, trxs.size() * 10 / 11, [&]( uint64_t i, benchmark::timer& t ) {
+            t.time( [&]() { chain.push_transaction( trxs[i] ); } );
+            if( i % trxs_per_block == trxs_per_block - 1 )
+               chain.produce_block();
+         } );
+      }
+   };
+
+}
+
+BOOST_AUTO_TEST_SUITE(chain_benchmarks)
+
+BOOST_AUTO_TEST_CASE( token_transfer ) try {
+   for( const auto& runtime : enabled_runtimes() ) {
+      runtime_chain c( runtime.second );
+      c.chain.create_accounts( { N(alice), N(bob), N(eosio.token) } );
+      c.chain.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+      c.chain.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+      c.chain.produce_block();
+      c.chain.push_action( N(eosio.token), N(create), N(eosio.token), mvo()
+                           ("issuer", "alice")("maximum_supply", "1000000000.0000 TKN") );
+      c.chain.push_action( N(eosio.token), N(issue), N(alice), mvo()
+                           ("to", "alice")("quantity", "1000000000.0000 TKN")("memo", "") );
+      c.chain.produce_block();
+
+      auto trxs = c.sign_transactions( benchmark::scaled( 2200 ), N(alice), [&]( uint64_t i ) {
+         return c.chain.get_action( N(eosio.token), N(transfer), { { N(alice), config::active_name } }, mvo()
+                                    ("from", "alice")("to", "bob")("quantity", "0.0001 TKN")("memo", std::to_string(i)) );
+      } );
+      c.push_transactions( "token transfer (" + runtime.first + ")", trxs );
+   }
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( multi_index_scan ) try {
+   for( const auto& runtime : enabled_runtimes() ) {
+      runtime_chain c( runtime.second );
+      c.chain.create_account( N(testapi) );
+      c.chain.set_code( N(testapi), contracts::test_api_multi_index_wasm() );
+      c.chain.set_abi( N(testapi), contracts::test_api_multi_index_abi().data() );
+      c.chain.produce_block();
+      c.chain.push_action( N(testapi), N(s1store), N(testapi), {} ); // idx64_store_only
+      c.chain.produce_block();
+
+      // idx64_check_without_storing walks the primary and secondary indices of the stored table
+      auto trxs = c.sign_transactions( benchmark::scaled( 2200 ), N(testapi), [&]( uint64_t ) {
+         return c.chain.get_action( N(testapi), N(s1check), { { N(testapi), config::active_name } }, {} );
+      } );
+      c.push_transactions( "multi_index idx64 scan (" + runtime.first + ")", trxs );
+   }
+} FC_LOG_AND_RETHROW()
+
+BOOST_FIXTURE_TEST_CASE( check_authorization_tree, tester ) try {
+   // a complete binary tree of accounts; every active permission needs both children, leaves are satisfied by a key
+   const uint32_t depth = 4;
+   std::vector<account_name> accounts;
+   std::function<void(const std::string&, uint32_t)> add_subtree = [&]( const std::string& prefix, uint32_t level ) {
+      accounts.emplace_back( prefix );
+      if( level < depth ) {
+         add_subtree( prefix + "1", level + 1 );
+         add_subtree( prefix + "2", level + 1 );
+      }
+   };
+   add_subtree( "authn", 0 );
+   create_accounts( accounts );
+   produce_block();
+
+   flat_set<public_key_type> keys;
+   for( const auto& a : accounts ) {
+      if( a.to_string().size() == 5 + depth ) {
+         keys.insert( get_public_key( a, "active" ) );
+         continue;
+      }
+      authority auth( 2, {}, { { { name( a.to_string() + "1" ), config::active_name }, 1 },
+                               { { name( a.to_string() + "2" ), config::active_name }, 1 } } );
+      set_authority( a, config::active_name, auth, config::owner_name );
+   }
+   produce_block();
+
+   const auto& authorization = control->get_authorization_manager();
+   const vector<action> actions{ action( { { N(authn), config::active_name } }, N(eosio), N(reqauth), bytes() ) };
+   benchmark::run( "check_authorization depth " + std::to_string( depth ) + ", " + std::to_string( keys.size() ) + " keys",
+                   benchmark::scaled( 20000 ), [&]( uint64_t, benchmark::timer& t ) {
+      t.time( [&]() { authorization.check_authorization( actions, keys ); } );
+   } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( abi_serializer_round_trip ) try {
+   const auto abi = fc::json::from_string( contracts::eosio_token_abi().data() ).as<abi_def>();
+   const auto max_time = fc::microseconds( 1000000 );
+   abi_serializer abis( abi, abi_serializer::create_yield_function( max_time ) );
+
+   const fc::variant transfer = mvo()("from", "alice")("to", "bob")("quantity", "1.0000 TKN")("memo", "benchmark memo");
+   const bytes packed = abis.variant_to_binary( "transfer", transfer, abi_serializer::create_yield_function( max_time ) );
+
+   benchmark::run( "abi_serializer variant_to_binary transfer", benchmark::scaled( 100000 ), [&]( uint64_t, benchmark::timer& t ) {
+      t.time( [&]() { abis.variant_to_binary( "transfer", transfer, abi_serializer::create_yield_function( max_time ) ); } );
+   } );
+   benchmark::run( "abi_serializer binary_to_variant transfer", benchmark::scaled( 100000 ), [&]( uint64_t, benchmark::timer& t ) {
+      t.time( [&]() { abis.binary_to_variant( "transfer", packed, abi_serializer::create_yield_function( max_time ) ); } );
+   } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( merkle_root ) try {
+   for( size_t leaves : { 16, 1024 } ) {
+      vector<digest_type> ids;
+      for( size_t i = 0; i < leaves; ++i )
+         ids.emplace_back( digest_type::hash( i ) );
+      benchmark::run( "merkle " + std::to_string( leaves ) + " digests", benchmark::scaled( 100000 / leaves * 10 ),
+                      [&]( uint64_t, benchmark::timer& t ) {
+         t.time( [&]() { merkle( ids ); } );
+      } );
+   }
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
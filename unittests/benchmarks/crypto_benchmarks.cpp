@@ -0,0 +1,116 @@
+#include <eosio/chain/cpu_features.hpp>
+#include <eosio/chain/recovered_keys_cache.hpp>
+#include <eosio/chain/transaction.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/crypto/ripemd160.hpp>
+#include <fc/crypto/sha1.hpp>
+#include <fc/crypto/sha256.hpp>
+#include <fc/crypto/sha512.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <iostream>
+
+#include "benchmark.hpp"
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+namespace {
+
+   template<typename Hash>
+   void hash_benchmark( const std::string& name ) {
+      for( size_t size : { 64, 4096 } ) {
+         const std::vector<char> data( size, 'x' );
+         benchmark::run( name + " " + std::to_string( size ) + " bytes", benchmark::scaled( 4000000 / size * 10 ),
+                         [&]( uint64_t, benchmark::timer& t ) {
+            t.time( [&]() { Hash::hash( data.data(), data.size() ); } );
+         } );
+      }
+   }
+
+   /// signatures of distinct digests, so a benchmark cannot be served by any cache
+   std::vector<std::pair<digest_type, signature_type>> sign_digests( const private_key_type& key, uint64_t count ) {
+      std::vector<std::pair<digest_type, signature_type>> result;
+      result.reserve( count );
+      for( uint64_t i = 0; i < count; ++i ) {
+         const auto digest = digest_type::hash( i );
+         result.emplace_back( digest, key.sign( digest ) );
+      }
+      return result;
+   }
+
+   void recover_benchmark( const std::string& name, const private_key_type& key ) {
+      const auto iterations = benchmark::scaled( 2000 );
+      const auto signed_digests = sign_digests( key, iterations + iterations / 10 );
+      const public_key_type expected = key.get_public_key();
+      // as crypto_api::recover_key and assert_recover_key do, without the canonical check
+      benchmark::run( name, iterations, [&]( uint64_t i, benchmark::timer& t ) {
+         t.time( [&]() {
+            BOOST_CHECK( public_key_type( signed_digests[i].second, signed_digests[i].first, false ) == expected );
+         } );
+      } );
+   }
+
+}
+
+BOOST_AUTO_TEST_SUITE(crypto_benchmarks)
+
+BOOST_AUTO_TEST_CASE( kernel_report ) {
+   for( const auto& line : crypto_kernel_report() )
+      std::cout << line << std::endl;
+}
+
+BOOST_AUTO_TEST_CASE( hashes ) try {
+   // the sha1, sha256, sha512 and ripemd160 intrinsics hash with these
+   hash_benchmark<fc::sha1>( "sha1" );
+   hash_benchmark<fc::sha256>( "sha256" );
+   hash_benchmark<fc::sha512>( "sha512" );
+   hash_benchmark<fc::ripemd160>( "ripemd160" );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( recover_key ) try {
+   recover_benchmark( "recover_key k1", tester::get_private_key( N(alice), "active" ) );
+   recover_benchmark( "recover_key r1", tester::get_private_key<fc::crypto::r1::private_key_shim>( N(alice), "active" ) );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( transaction_signatures ) try {
+   const auto chain_digest = fc::sha256::hash( std::string( "crypto_benchmarks" ) );
+   const chain_id_type chain_id( chain_digest.data(), chain_digest.data_size() );
+   const std::vector<private_key_type> keys{ tester::get_private_key( N(alice), "active" ), tester::get_private_key( N(bob), "active" ),
+                                             tester::get_private_key( N(carol), "active" ) };
+
+   for( size_t signatures : { 1, 3 } ) {
+      const auto iterations = benchmark::scaled( 1000 );
+      std::vector<signed_transaction> trxs( iterations + iterations / 10 );
+      for( size_t i = 0; i < trxs.size(); ++i ) {
+         trxs[i].actions.emplace_back( vector<permission_level>{ { N(alice), config::active_name } }, N(eosio), N(reqauth), bytes() );
+         trxs[i].ref_block_num = i;
+         trxs[i].expiration = fc::time_point_sec( fc::time_point::now() ) + 3600;
+         for( size_t k = 0; k < signatures; ++k )
+            trxs[i].sign( keys[k], chain_id );
+      }
+
+      const std::string name = "get_signature_keys " + std::to_string( signatures ) + " signature" + (signatures > 1 ? "s" : "");
+      benchmark::run( name, iterations, [&]( uint64_t i, benchmark::timer& t ) {
+         flat_set<public_key_type> recovered;
+         t.time( [&]() { trxs[i].get_signature_keys( chain_id, fc::time_point::maximum(), recovered ); } );
+         BOOST_CHECK_EQUAL( recovered.size(), signatures );
+      } );
+
+      // every transaction recovered once before, as when one arrives again from another peer
+      recovered_keys_cache cache( 1024 * 1024 );
+      for( const auto& trx : trxs ) {
+         flat_set<public_key_type> recovered;
+         trx.get_signature_keys( chain_id, fc::time_point::maximum(), recovered, false, &cache );
+      }
+      benchmark::run( name + " cached", iterations, [&]( uint64_t i, benchmark::timer& t ) {
+         flat_set<public_key_type> recovered;
+         t.time( [&]() { trxs[i].get_signature_keys( chain_id, fc::time_point::maximum(), recovered, false, &cache ); } );
+      } );
+   }
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -2,9 +2,13 @@
 #include <eosio/testing/tester.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/variant_object.hpp>
 
+#include <boost/core/demangle.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <contracts.hpp>
+
 #ifdef NON_VALIDATING_TEST
 #define TESTER tester
 #else
@@ -81,4 +85,93 @@ BOOST_AUTO_TEST_SUITE(database_tests)
       } FC_LOG_AND_RETHROW()
    }
 
+   // Per table rows and memory, per index memory and sampled table accesses
+   BOOST_AUTO_TEST_CASE(table_usage_and_accesses) {
+      try {
+         fc::temp_directory tempdir;
+         tester test( tempdir, []( controller::config& cfg ) { cfg.table_access_sample_rate = 1; }, true );
+         test.execute_setup_policy( setup_policy::full );
+         test.create_accounts( { N(alice), N(bob), N(eosio.token) } );
+         test.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+         test.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+         test.push_action( N(eosio.token), N(create), N(eosio.token), fc::mutable_variant_object()
+                           ("issuer", "alice")("maximum_supply", "1000.0000 TKN") );
+         test.push_action( N(eosio.token), N(issue), N(alice), fc::mutable_variant_object()
+                           ("to", "alice")("quantity", "100.0000 TKN")("memo", "") );
+         test.push_action( N(eosio.token), N(transfer), N(alice), fc::mutable_variant_object()
+                           ("from", "alice")("to", "bob")("quantity", "1.0000 TKN")("memo", "") );
+         test.produce_block();
+
+         const auto tables = test.control->get_table_usage( N(eosio.token), {}, 100, fc::time_point::maximum() ).tables;
+         BOOST_REQUIRE_EQUAL( tables.size(), 2u );
+         for( const auto& t : tables ) {
+            BOOST_TEST( t.code == N(eosio.token) );
+            BOOST_TEST( t.secondary_rows == 0u );
+            BOOST_TEST( t.estimated_bytes > 0u );
+            if( t.table == N(accounts) ) {
+               BOOST_TEST( t.scopes == 2u ); // alice and bob
+               BOOST_TEST( t.primary_rows == 2u );
+            } else {
+               BOOST_TEST( t.table == N(stat) );
+               BOOST_TEST( t.scopes == 1u );
+               BOOST_TEST( t.primary_rows == 1u );
+            }
+         }
+         BOOST_TEST( test.control->get_table_usage( N(alice), {}, 100, fc::time_point::maximum() ).tables.empty() );
+
+         // pages of every code, one table each and past their deadline, add up to the single walk
+         using usage_totals = std::map<std::pair<account_name, table_name>, std::tuple<uint64_t, uint64_t, uint64_t>>;
+         auto add = []( usage_totals& totals, const std::vector<controller::table_usage>& page ) {
+            for( const auto& t : page ) {
+               auto& v = totals[std::make_pair( t.code, t.table )];
+               std::get<0>( v ) += t.scopes;
+               std::get<1>( v ) += t.primary_rows + t.secondary_rows;
+               std::get<2>( v ) += t.estimated_bytes;
+            }
+         };
+         const auto all = test.control->get_table_usage( {}, {}, 1000, fc::time_point::maximum() );
+         BOOST_TEST( !all.more );
+         usage_totals expected, paged;
+         add( expected, all.tables );
+         optional<controller::table_usage_cursor> from;
+         size_t pages = 0;
+         do {
+            auto page = test.control->get_table_usage( {}, from, 1, fc::time_point() );
+            BOOST_TEST( page.tables.size() == 1u );
+            add( paged, page.tables );
+            from = page.more;
+            BOOST_REQUIRE( ++pages < 1000 );
+         } while( from );
+         BOOST_TEST( (paged == expected) );
+         BOOST_TEST( pages >= expected.size() );
+
+         bool key_values_estimated = false;
+         for( const auto& u : test.control->get_index_memory_usage( fc::time_point::maximum() ) ) {
+            if( u.index == boost::core::demangle( typeid(key_value_object).name() ) ) {
+               key_values_estimated = true;
+               BOOST_TEST( u.row_count > 0u );
+               BOOST_TEST( u.estimated_bytes > u.row_count * sizeof(key_value_object) );
+            }
+         }
+         BOOST_TEST( key_values_estimated );
+         // past the deadline each index still has its first 256 rows visited, and only larger ones are extrapolated
+         const auto full_walk = test.control->get_index_memory_usage( fc::time_point::maximum() );
+         const auto past_deadline = test.control->get_index_memory_usage( fc::time_point() );
+         BOOST_REQUIRE_EQUAL( full_walk.size(), past_deadline.size() );
+         for( size_t i = 0; i < full_walk.size(); ++i ) {
+            BOOST_TEST( !full_walk[i].extrapolated );
+            if( past_deadline[i].row_count <= 256 ) {
+               BOOST_TEST( !past_deadline[i].extrapolated );
+               BOOST_TEST( past_deadline[i].estimated_bytes == full_walk[i].estimated_bytes );
+            }
+         }
+
+         const auto accesses = test.control->get_table_accesses();
+         const auto accounts = accesses.find( std::make_pair( N(eosio.token), N(accounts) ) );
+         BOOST_REQUIRE( accounts != accesses.end() );
+         BOOST_TEST( accounts->second.reads > 0u );
+         BOOST_TEST( accounts->second.writes >= 3u ); // issue stores alice, transfer updates alice and stores bob
+      } FC_LOG_AND_RETHROW()
+   }
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,116 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/wasm_interface.hpp>
+
+#include <contracts.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+using mvo = fc::mutable_variant_object;
+
+#if defined(EOSIO_EOS_VM_OC_RUNTIME_ENABLED) && defined(EOSIO_EOS_VM_RUNTIME_ENABLED)
+
+namespace {
+   digest_type code_hash_of( const std::vector<uint8_t>& wasm ) {
+      return fc::sha256::hash( reinterpret_cast<const char*>( wasm.data() ), wasm.size() );
+   }
+
+   uint64_t oc_executions( tester& t, const digest_type& code_hash ) {
+      for( const auto& c : t.control->get_wasm_interface().get_execution_stats().codes ) {
+         if( c.code_hash == code_hash )
+            return c.oc_executions;
+      }
+      return 0;
+   }
+
+   // runs the action until the code has run from the EOS VM OC cache, compiles complete in the background
+   bool run_until_oc( tester& t, const digest_type& code_hash, const std::function<void()>& run ) {
+      for( int i = 0; i < 3000; ++i ) {
+         run();
+         t.produce_block();
+         if( oc_executions( t, code_hash ) )
+            return true;
+         std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+      }
+      return false;
+   }
+
+   void push_doit( tester& t, account_name a ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{a, config::active_name}}, a, N(doit), bytes{} );
+      t.set_transaction_headers( trx );
+      trx.sign( t.get_private_key( a, "active" ), t.control->get_chain_id() );
+      t.push_transaction( trx );
+   }
+}
+
+#endif
+
+BOOST_AUTO_TEST_SUITE(eosvmoc_shared_cache_tests)
+
+BOOST_AUTO_TEST_CASE( follower_runs_owner_code_across_owner_restart ) try {
+#if defined(EOSIO_EOS_VM_OC_RUNTIME_ENABLED) && defined(EOSIO_EOS_VM_RUNTIME_ENABLED)
+   fc::temp_directory owner_dir;
+   const auto shared_dir = owner_dir.path() / config::default_state_dir_name;
+   tester owner( owner_dir, []( controller::config& cfg ) {
+      cfg.wasm_runtime = wasm_interface::vm_type::eos_vm;
+      cfg.eosvmoc_tierup = true;
+      cfg.eosvmoc_config.share_cache = true;
+   }, true );
+   fc::temp_directory follower_dir;
+   tester follower( follower_dir, [&]( controller::config& cfg ) {
+      cfg.wasm_runtime = wasm_interface::vm_type::eos_vm;
+      cfg.eosvmoc_tierup = true;
+      cfg.eosvmoc_config.shared_cache_dir = shared_dir;
+   }, true );
+
+   const auto payloadless = code_hash_of( contracts::payloadless_wasm() );
+   for( tester* t : {&owner, &follower} ) {
+      t->create_account( N(payloadless) );
+      t->set_code( N(payloadless), contracts::payloadless_wasm() );
+      t->produce_block();
+   }
+   BOOST_REQUIRE( run_until_oc( owner, payloadless, [&]() { push_doit( owner, N(payloadless) ); } ) );
+   BOOST_REQUIRE( run_until_oc( follower, payloadless, [&]() { push_doit( follower, N(payloadless) ); } ) );
+
+   // the owner restarts with a new cache file at the same path, code compiled in to it lands at unrelated offsets
+   owner.close();
+   bfs::remove( shared_dir / "code_cache.bin" );
+   bfs::remove( shared_dir / "code_cache_index.bin" );
+   owner.open();
+
+   const auto asserter = code_hash_of( contracts::asserter_wasm() );
+   for( tester* t : {&owner, &follower} ) {
+      t->create_account( N(asserter) );
+      t->set_code( N(asserter), contracts::asserter_wasm() );
+      t->set_abi( N(asserter), contracts::asserter_abi().data() );
+      t->produce_block();
+   }
+   auto procassert = []( tester& t ) {
+      return [&t]() { t.push_action( N(asserter), N(procassert), N(asserter), mvo()( "condition", 1 )( "message", "ok" ) ); };
+   };
+   BOOST_REQUIRE( run_until_oc( owner, asserter, procassert( owner ) ) );
+   // the follower re-attaches to the new file on the miss, then runs from it what the owner compiles in to it
+   BOOST_REQUIRE( run_until_oc( follower, asserter, procassert( follower ) ) );
+   const auto before = oc_executions( follower, payloadless );
+   BOOST_REQUIRE( run_until_oc( owner, payloadless, [&]() { push_doit( owner, N(payloadless) ); } ) );
+   for( int i = 0; i < 300 && oc_executions( follower, payloadless ) == before; ++i ) {
+      push_doit( follower, N(payloadless) );
+      follower.produce_block();
+      std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+   }
+   BOOST_REQUIRE_GT( oc_executions( follower, payloadless ), before );
+#else
+   BOOST_TEST_MESSAGE( "EOS VM OC tier-up is not available in this build" );
+#endif
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
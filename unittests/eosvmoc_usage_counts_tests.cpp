@@ -0,0 +1,58 @@
+#include <boost/test/unit_test.hpp>
+
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+#include <eosio/chain/webassembly/eos-vm-oc/code_cache.hpp>
+
+#include <fc/crypto/sha256.hpp>
+
+#include <string>
+
+using namespace eosio::chain::eosvmoc;
+
+namespace {
+   code_tuple make_code( uint32_t n ) {
+      return code_tuple{ fc::sha256::hash( std::to_string( n ) ), 0 };
+   }
+}
+#endif
+
+BOOST_AUTO_TEST_SUITE(eosvmoc_usage_counts_tests)
+
+BOOST_AUTO_TEST_CASE( hottest_first ) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   usage_counts counts( 10 );
+   for( uint32_t n = 1; n <= 3; ++n )
+      counts.add( make_code( n ), n * 10 );
+   counts.add( make_code( 1 ) );
+
+   auto hottest = counts.hottest( 2 );
+   BOOST_REQUIRE_EQUAL( hottest.size(), 2u );
+   BOOST_CHECK( hottest[0].first == make_code( 3 ) );
+   BOOST_CHECK_EQUAL( hottest[0].second, 30u );
+   BOOST_CHECK( hottest[1].first == make_code( 2 ) );
+   BOOST_CHECK_EQUAL( counts.hottest( 10 ).size(), 3u );
+#endif
+}
+
+BOOST_AUTO_TEST_CASE( bounded_by_decay ) {
+#ifdef EOSIO_EOS_VM_OC_RUNTIME_ENABLED
+   usage_counts counts( 4 );
+
+   // a stream of codes used once never holds more than the bound, nor pushes out the one used all along
+   for( uint32_t n = 1; n <= 1000; ++n ) {
+      counts.add( make_code( 0 ) );
+      counts.add( make_code( n ) );
+      BOOST_REQUIRE_LE( counts.size(), 4u );
+   }
+   auto hottest = counts.hottest( 1 );
+   BOOST_REQUIRE_EQUAL( hottest.size(), 1u );
+   BOOST_CHECK( hottest[0].first == make_code( 0 ) );
+
+   // once it is no longer used its count decays to zero and it is forgotten like the rest
+   while( !counts.empty() )
+      counts.decay();
+   BOOST_CHECK( counts.hottest( 4 ).empty() );
+#endif
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -554,9 +554,11 @@ BOOST_AUTO_TEST_CASE( reopen_forkdb ) try {
    auto fork2_lib_after = c2.control->last_irreversible_block_num();
    BOOST_REQUIRE_EQUAL( fork2_lib_before, fork2_lib_after );
 
+   block_id_type fork2_block_id;
    for( uint32_t block_num = fork2_start_block; block_num < c2.control->head_block_num(); ++block_num ) {
       auto fb = c2.control->fetch_block_by_number( block_num );
       c1.push_block( fb );
+      fork2_block_id = fb->id();
    }
 
    BOOST_REQUIRE( fork1_head_block_id == c1.control->head_block_id() ); // new blocks should not cause fork switch
@@ -565,6 +567,48 @@ BOOST_AUTO_TEST_CASE( reopen_forkdb ) try {
 
    c1.open();
 
+   // the applied fork 1 blocks are read back from the reversible block database, the fork 2 ones from fork_db.dat
+   BOOST_REQUIRE( fork1_head_block_id == c1.control->head_block_id() );
+   auto fork1_head = c1.control->fork_db().get_block( fork1_head_block_id );
+   BOOST_REQUIRE( fork1_head && fork1_head->block && fork1_head->block->id() == fork1_head_block_id );
+   auto fork2_block = c1.control->fork_db().get_block( fork2_block_id );
+   BOOST_REQUIRE( fork2_block && fork2_block->block && fork2_block->block->id() == fork2_block_id );
+
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_CASE( reopen_forkdb_missing_stored_block ) try {
+   tester c;
+   c.create_accounts( {N(alice),N(bob),N(carol)} );
+   c.produce_block();
+   c.set_producers( {N(alice),N(bob),N(carol)} );
+   produce_until_transition( c, N(carol), N(alice) );
+   c.produce_blocks( 3 );
+
+   const auto& root = c.control->fork_db().root();
+   auto branch = c.control->fork_db().fetch_branch( c.control->head_block_id() );
+   BOOST_REQUIRE( !branch.empty() );
+
+   fc::temp_directory dir;
+   auto validator = []( block_timestamp_type, const flat_set<digest_type>&, const vector<digest_type>& ) {};
+   {
+      fork_database fdb( dir.path() );
+      fdb.set_block_store( { []( uint32_t, const block_id_type& ) { return true; },
+                             []( uint32_t ) { return signed_block_ptr(); } } );
+      fdb.reset( *root );
+      for( auto itr = branch.rbegin(); itr != branch.rend(); ++itr )
+         fdb.add( *itr );
+      BOOST_REQUIRE( fdb.head()->id == c.control->head_block_id() );
+   } // closed, the blocks written as stored
+
+   // the stored blocks are gone, as after --fix-reversible-blocks, so only the root is kept
+   fork_database fdb( dir.path() );
+   fdb.set_block_store( { []( uint32_t, const block_id_type& ) { return false; },
+                          []( uint32_t ) { return signed_block_ptr(); } } );
+   fdb.open( validator );
+   BOOST_REQUIRE( fdb.root() );
+   BOOST_CHECK( fdb.root()->id == root->id );
+   BOOST_CHECK( fdb.head()->id == root->id );
+   BOOST_CHECK( !fdb.get_block( c.control->head_block_id() ) );
 } FC_LOG_AND_RETHROW()
 
 BOOST_AUTO_TEST_CASE( push_block_returns_forked_transactions ) try {
@@ -778,4 +822,37 @@ BOOST_AUTO_TEST_CASE( push_block_returns_forked_transactions ) try {
 } FC_LOG_AND_RETHROW()
 
 
+BOOST_AUTO_TEST_CASE( prepared_key_recovery_of_off_branch_blocks ) try {
+   tester c;
+   c.produce_block();
+   tester c2(setup_policy::none);
+   push_blocks(c, c2);
+
+   // c2 builds its own branch two blocks past the fork point
+   c2.produce_blocks(2);
+
+   c.create_accounts( {N(alice), N(bob)} );
+   auto a1 = c.produce_block();
+   auto a2 = c.produce_block();
+   auto a3 = c.produce_block();
+   BOOST_REQUIRE_EQUAL( a1->transactions.size(), 2u );
+
+   // a1 is shorter than the c2 branch, so it waits in fork_db with its keys being recovered
+   c2.push_block( a1 );
+   BOOST_REQUIRE( c2.control->head_block_id() != a1->id() );
+   BOOST_CHECK_EQUAL( c2.control->prepared_trx_count( a1->id() ), 2u );
+
+   c2.push_block( a2 );
+   BOOST_REQUIRE( c2.control->head_block_id() != a2->id() );
+
+   // a3 makes the branch the longest, its blocks take the prepared recoveries as they apply
+   c2.push_block( a3 );
+   BOOST_REQUIRE_EQUAL( c2.control->head_block_id(), a3->id() );
+   BOOST_CHECK_EQUAL( c2.control->prepared_trx_count( a1->id() ), 0u );
+   BOOST_CHECK_EQUAL( c2.control->prepared_trx_count( a2->id() ), 0u );
+   BOOST_CHECK( c2.control->db().find<account_object,by_name>( N(alice) ) );
+   BOOST_CHECK( c2.control->db().find<account_object,by_name>( N(bob) ) );
+} FC_LOG_AND_RETHROW()
+
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+#include <boost/test/unit_test.hpp>
+#include <eosio/chain/hardware_float.hpp>
+
+#include <fc/exception/exception.hpp>
+
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <xmmintrin.h>
+#endif
+
+using namespace eosio::chain;
+
+namespace {
+
+   /// the fast path is off by default; the differential tests turn it on for their duration
+   struct hardware_float_enabled {
+      hardware_float_enabled()  { hardware_float::set_enabled( true ); }
+      ~hardware_float_enabled() { hardware_float::set_enabled( false ); }
+   };
+
+   /// every exponent with the significands around each rounding boundary, both signs
+   template<typename UI>
+   std::vector<UI> boundary_values( int exponent_bits, int significand_bits ) {
+      const UI half = UI(1) << ( significand_bits - 1 );
+      const UI all = ( UI(1) << significand_bits ) - 1;
+      std::vector<UI> values;
+      for( UI sign : { UI(0), UI(1) } ) {
+         for( UI e = 0; e < ( UI(1) << exponent_bits ); ++e ) {
+            for( UI m : { UI(0), UI(1), UI(2), UI(3), UI(half - 1), half, UI(half + 1), UI(all - 1), all } )
+               values.push_back( sign << ( exponent_bits + significand_bits ) | e << significand_bits | m );
+         }
+      }
+      return values;
+   }
+
+   /// the fast path must give softfloat's bits exactly, NaN payloads included
+   void check_f32( uint32_t a, uint32_t b ) {
+      const float32_t sa{ a }, sb{ b };
+      BOOST_REQUIRE_EQUAL( ::f32_add( sa, sb ).v, hardware_float::f32_add( sa, sb ).v );
+      BOOST_REQUIRE_EQUAL( ::f32_sub( sa, sb ).v, hardware_float::f32_sub( sa, sb ).v );
+      BOOST_REQUIRE_EQUAL( ::f32_mul( sa, sb ).v, hardware_float::f32_mul( sa, sb ).v );
+      BOOST_REQUIRE_EQUAL( ::f32_div( sa, sb ).v, hardware_float::f32_div( sa, sb ).v );
+   }
+
+   void check_f64( uint64_t a, uint64_t b ) {
+      const float64_t sa{ a }, sb{ b };
+      BOOST_REQUIRE_EQUAL( ::f64_add( sa, sb ).v, hardware_float::f64_add( sa, sb ).v );
+      BOOST_REQUIRE_EQUAL( ::f64_sub( sa, sb ).v, hardware_float::f64_sub( sa, sb ).v );
+      BOOST_REQUIRE_EQUAL( ::f64_mul( sa, sb ).v, hardware_float::f64_mul( sa, sb ).v );
+      BOOST_REQUIRE_EQUAL( ::f64_div( sa, sb ).v, hardware_float::f64_div( sa, sb ).v );
+   }
+
+   /// EOSIO_EXHAUSTIVE_FLOAT_TESTS=1 sweeps every f32 bit pattern, which takes minutes
+   bool exhaustive() {
+      const char* e = getenv( "EOSIO_EXHAUSTIVE_FLOAT_TESTS" );
+      return e && *e && *e != '0';
+   }
+
+}
+
+BOOST_AUTO_TEST_SUITE(hardware_float_tests)
+
+BOOST_FIXTURE_TEST_CASE(f32_differential, hardware_float_enabled) { try {
+   BOOST_TEST_MESSAGE( "hardware float fast path " << ( hardware_float::usable() ? "in use" : "not usable here" ) );
+   const auto values = boundary_values<uint32_t>( 8, 23 );
+   for( uint32_t a : values ) {
+      BOOST_REQUIRE_EQUAL( ::f32_sqrt( float32_t{ a } ).v, hardware_float::f32_sqrt( float32_t{ a } ).v );
+      for( size_t i = 0; i < values.size(); i += 17 )
+         check_f32( a, values[i] );
+   }
+
+   std::mt19937 rng( 121 );
+   for( int i = 0; i < 1000000; ++i )
+      check_f32( rng(), rng() );
+
+   if( exhaustive() ) {
+      std::mt19937 partners( 4321 );
+      uint32_t a = 0;
+      do {
+         BOOST_REQUIRE_EQUAL( ::f32_sqrt( float32_t{ a } ).v, hardware_float::f32_sqrt( float32_t{ a } ).v );
+         check_f32( a, partners() );
+      } while( ++a != 0 );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_FIXTURE_TEST_CASE(f64_differential, hardware_float_enabled) { try {
+   const auto values = boundary_values<uint64_t>( 11, 52 );
+   for( size_t i = 0; i < values.size(); ++i ) {
+      BOOST_REQUIRE_EQUAL( ::f64_sqrt( float64_t{ values[i] } ).v, hardware_float::f64_sqrt( float64_t{ values[i] } ).v );
+      for( size_t j = i % 601; j < values.size(); j += 601 )
+         check_f64( values[i], values[j] );
+   }
+
+   std::mt19937_64 rng( 121 );
+   for( int i = 0; i < 1000000; ++i ) {
+      const uint64_t a = rng();
+      // operands of nearby magnitude, where add and sub round the most
+      check_f64( a, rng() );
+      check_f64( a, a ^ ( rng() & 0x800FFFFFFFFFFFFFull ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(disabled) { try {
+   BOOST_CHECK( !hardware_float::enabled() ); // off by default
+   BOOST_CHECK( !hardware_float::usable() );
+   check_f32( 0x3F800000u, 0x3F800001u );
+   check_f64( 0x3FF0000000000000ull, 0x3FF0000000000001ull );
+   hardware_float_enabled on;
+   BOOST_CHECK_EQUAL( hardware_float::usable(), hardware_float::compiled && hardware_float::verified() );
+} FC_LOG_AND_RETHROW() }
+
+#if defined(__x86_64__)
+BOOST_FIXTURE_TEST_CASE(unmasked_exception, hardware_float_enabled) { try {
+   // with an exception unmasked a hardware operation could trap, so softfloat computes every result
+   const uint32_t csr = _mm_getcsr();
+   _mm_setcsr( csr & ~_MM_MASK_INVALID );
+   const bool usable = hardware_float::usable();
+   const auto r = hardware_float::f64_sqrt( float64_t{ 0xBFF0000000000000ull } ); // sqrt(-1) raises invalid
+   _mm_setcsr( csr );
+   BOOST_CHECK( !usable );
+   BOOST_CHECK_EQUAL( r.v, ::f64_sqrt( float64_t{ 0xBFF0000000000000ull } ).v );
+} FC_LOG_AND_RETHROW() }
+#endif
+
+BOOST_AUTO_TEST_SUITE_END()
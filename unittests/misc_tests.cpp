@@ -1,9 +1,28 @@
+#include <eosio/chain/account_object.hpp>
 #include <eosio/chain/asset.hpp>
 #include <eosio/chain/authority.hpp>
 #include <eosio/chain/authority_checker.hpp>
 #include <eosio/chain/chain_config.hpp>
+#include <eosio/chain/contract_types.hpp>
+#include <eosio/chain/contract_table_objects.hpp>
+#include <eosio/chain/merkle.hpp>
 #include <eosio/chain/types.hpp>
 #include <eosio/chain/thread_utils.hpp>
+#include <eosio/chain/app_thread_stats.hpp>
+#include <eosio/chain/transaction_latency.hpp>
+#include <eosio/chain/recovered_keys_cache.hpp>
+#include <eosio/chain/transaction_metadata_pool.hpp>
+#include <eosio/chain/unapplied_transaction_queue.hpp>
+#include <eosio/chain/replica_head.hpp>
+#include <eosio/chain/fixed_layout.hpp>
+#include <eosio/chain/transaction_conflict_groups.hpp>
+#include <eosio/chain/access_set.hpp>
+#include <eosio/chain/action_filter.hpp>
+#include <eosio/chain/span_tracer.hpp>
+#include <eosio/chain/sampling_profiler.hpp>
+#include <eosio/chain/transaction_template.hpp>
+#include <eosio/chain/transaction_object.hpp>
+#include <eosio/chain/platform_timer.hpp>
 #include <eosio/testing/tester.hpp>
 
 #include <fc/io/json.hpp>
@@ -25,6 +44,12 @@ using namespace eosio::testing;
 #include <boost/random/mersenne_twister.hpp>
 #include <boost/random/uniform_int_distribution.hpp>
 
+#include <atomic>
+#include <chrono>
+#include <cinttypes>
+#include <set>
+#include <thread>
+
 struct base_reflect : fc::reflect_init {
    int bv = 0;
    bool base_reflect_initialized = false;
@@ -144,6 +169,40 @@ BOOST_AUTO_TEST_CASE(name_suffix_tests)
    BOOST_CHECK_EQUAL( name{name_suffix(N(abcdefhij.123))}, name{N(123)} );
 }
 
+BOOST_AUTO_TEST_CASE(name_string_tests)
+{
+   for( const char* str : { "", "a", "eosio", "eosio.token", "a.b.c", "12345abcdefgh", "zzzzzzzzzzzzj", ".a", "a..b" } ) {
+      BOOST_CHECK_EQUAL( name(str).to_string(), str );
+      BOOST_CHECK_EQUAL( string_to_name(str).to_string(), str );
+   }
+   BOOST_CHECK_EQUAL( name(uint64_t(-1)).to_string(), "zzzzzzzzzzzzj" );
+   BOOST_CHECK_EQUAL( name(uint64_t(1) << 59).to_string(), "1" );
+   BOOST_CHECK_EQUAL( name(uint64_t(1) << 4).to_string(), "...........1" );
+   BOOST_CHECK_EQUAL( name(1).to_string(), "............1" );
+
+   // not what to_string() gives back
+   for( const char* str : { "a.", ".", "A", "a6", "a0", "a-b", "zzzzzzzzzzzzk", "aaaaaaaaaaaaaa" } )
+      BOOST_CHECK_THROW( name{str}, name_type_exception );
+   BOOST_CHECK_THROW( name{std::string_view("a\0", 2)}, name_type_exception );
+
+   std::ostringstream out;
+   out << N(eosio.token);
+   BOOST_CHECK_EQUAL( out.str(), "eosio.token" );
+}
+
+BOOST_AUTO_TEST_CASE(asset_string_tests)
+{
+   for( const char* str : { "0 SYS", "1.0000 SYS", "-1.0000 SYS", "0.0001 SYS", "-0.0001 SYS", "4611686018427387903 A",
+                            "4.611686018427387903 ABCDEFG", "-12.345 XYZ" } )
+      BOOST_CHECK_EQUAL( asset::from_string( str ).to_string(), str );
+   BOOST_CHECK_EQUAL( asset::from_string( "  1.5  EOS " ).to_string(), "1.5 EOS" );
+   BOOST_CHECK_THROW( asset::from_string( "1.5 eos" ), symbol_type_exception );
+   BOOST_CHECK_THROW( asset::from_string( "1.0000000000000000000 EOS" ), symbol_type_exception );
+   BOOST_CHECK_THROW( asset::from_string( "1.5" ), asset_type_exception );
+   BOOST_CHECK( symbol( SY(4,SYS) ).valid() );
+   BOOST_CHECK( !symbol::valid_code( uint64_t('S') | uint64_t('Y') << 16 ) );
+}
+
 /// Test processing of unbalanced strings
 BOOST_AUTO_TEST_CASE(json_from_string_test)
 {
@@ -643,6 +702,28 @@ BOOST_AUTO_TEST_CASE(authority_checker)
       BOOST_TEST(!validate(F2));
       BOOST_TEST(!validate(G2));
    }
+   {
+      // more provided keys than one word of used key bits
+      flat_set<public_key_type> many;
+      for( int i = 0; i < 150; ++i )
+         many.insert( test.get_public_key( name("multisig"), "k" + std::to_string( i ) ) );
+      vector<key_weight> weights;
+      for( auto itr = many.begin(); itr != many.end(); itr += 10 )
+         weights.push_back( key_weight{*itr, 1} );
+      weights.push_back( key_weight{*many.rbegin(), 1} );
+      auto M = authority( weights.size(), weights );
+      auto checker = make_auth_checker(GetNullAuthority, 2, many);
+      BOOST_TEST(checker.satisfied(M));
+      BOOST_TEST(!checker.all_keys_used());
+      BOOST_TEST(checker.used_keys().size() == weights.size());
+      BOOST_TEST(checker.used_keys().count(*many.rbegin()) == 1u);
+      BOOST_TEST(checker.unused_keys().size() == many.size() - weights.size());
+
+      many.erase( many.begin() );
+      auto short_one = make_auth_checker(GetNullAuthority, 2, many);
+      BOOST_TEST(!short_one.satisfied(M));
+      BOOST_TEST(short_one.used_keys().size() == 0u);
+   }
 } FC_LOG_AND_RETHROW() }
 
 BOOST_AUTO_TEST_CASE(alphabetic_sort)
@@ -811,6 +892,179 @@ BOOST_AUTO_TEST_CASE(transaction_test) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(packed_transaction_lazy_unpack_test) { try {
+   const auto chain_digest = fc::sha256::hash( std::string( "packed_transaction_lazy_unpack_test" ) );
+   const chain_id_type chain_id( chain_digest.data(), chain_digest.data_size() );
+   const auto private_key = testing::tester::get_private_key( N(alice), "active" );
+
+   signed_transaction trx;
+   trx.expiration = fc::time_point_sec( fc::time_point::now() ) + 3600;
+   trx.delay_sec = 300;
+   trx.actions.emplace_back( vector<permission_level>{ { N(alice), config::active_name } }, N(eosio), N(reqauth), fc::raw::pack( N(alice) ) );
+   trx.context_free_actions.emplace_back( vector<permission_level>{}, N(eosio), N(nonce), fc::raw::pack( std::string( "dummy" ) ) );
+   trx.context_free_data.emplace_back( fc::raw::pack( std::string( "cfd" ) ) );
+   trx.sign( private_key, chain_id );
+
+   for( auto compression : { packed_transaction::compression_type::none, packed_transaction::compression_type::zlib } ) {
+      // as received from the network
+      packed_transaction pkt = fc::raw::unpack<packed_transaction>( fc::raw::pack( packed_transaction( trx, compression ) ) );
+      BOOST_CHECK( !pkt.is_unpacked() );
+      BOOST_CHECK_EQUAL( trx.id(), pkt.id() );
+      BOOST_CHECK( trx.expiration == pkt.expiration() );
+      BOOST_CHECK_EQUAL( trx.sig_digest( chain_id, trx.context_free_data ), pkt.sig_digest( chain_id ) );
+
+      flat_set<public_key_type> keys;
+      pkt.get_signature_keys( chain_id, fc::time_point::maximum(), keys );
+      BOOST_REQUIRE_EQUAL( 1u, keys.size() );
+      BOOST_CHECK_EQUAL( private_key.get_public_key(), *keys.begin() );
+      BOOST_CHECK( !pkt.is_unpacked() );
+
+      // recovering its keys on the thread pool unpacks it there, as it is about to be applied
+      named_thread_pool thread_pool( "misc", 1 );
+      auto ptrx = std::make_shared<packed_transaction>( fc::raw::unpack<packed_transaction>( fc::raw::pack( pkt ) ) );
+      auto mtrx = transaction_metadata::start_recover_keys( ptrx, thread_pool.get_executor(), chain_id, fc::microseconds::maximum() ).get();
+      BOOST_CHECK( mtrx->recovered_keys() == keys );
+      BOOST_CHECK( ptrx->is_unpacked() );
+      thread_pool.stop();
+
+      // a copy shares what is unpacked already, but after that each unpacks on its own
+      packed_transaction copy( pkt );
+      BOOST_CHECK_EQUAL( 1u, copy.get_transaction().actions.size() );
+      BOOST_CHECK_EQUAL( trx.context_free_data.size(), copy.get_context_free_data().size() );
+      BOOST_CHECK( copy.is_unpacked() );
+      BOOST_CHECK( !pkt.is_unpacked() );
+      BOOST_CHECK_EQUAL( pkt.get_signed_transaction().id(), pkt.id() );
+      BOOST_CHECK( pkt.is_unpacked() );
+   }
+
+   // bytes fc::raw::pack would not write get the id of the transaction as fc packs it, as before
+   bytes raw = fc::raw::pack( static_cast<const transaction&>( trx ) );
+   raw.push_back( 0 );
+   packed_transaction trailing( bytes( raw ), vector<signature_type>( trx.signatures ), fc::raw::pack( trx.context_free_data ),
+                                packed_transaction::compression_type::none );
+   BOOST_CHECK( trailing.is_unpacked() );
+   BOOST_CHECK_EQUAL( trx.id(), trailing.id() );
+   BOOST_CHECK_EQUAL( trx.sig_digest( chain_id, trx.context_free_data ), trailing.sig_digest( chain_id ) );
+
+   raw.pop_back();
+   // delay_sec follows the 4 byte expiration, 2 byte ref_block_num, 4 byte ref_block_prefix, max_net_usage_words and max_cpu_usage_ms
+   BOOST_REQUIRE_EQUAL( 0xac, uint8_t(raw[12]) );
+   BOOST_REQUIRE_EQUAL( 0x02, uint8_t(raw[13]) );
+   raw[13] = char(0x82);
+   raw.insert( raw.begin() + 14, 0 );
+   packed_transaction overlong( std::move( raw ), vector<signature_type>( trx.signatures ), fc::raw::pack( trx.context_free_data ),
+                                packed_transaction::compression_type::none );
+   BOOST_CHECK( overlong.is_unpacked() );
+   BOOST_CHECK_EQUAL( trx.id(), overlong.id() );
+   BOOST_CHECK_EQUAL( 300u, overlong.get_transaction().delay_sec.value );
+} FC_LOG_AND_RETHROW() }
+
+
+BOOST_AUTO_TEST_CASE(transaction_template_test) { try {
+   const auto chain_digest = fc::sha256::hash( std::string( "transaction_template_test" ) );
+   const chain_id_type chain_id( chain_digest.data(), chain_digest.data_size() );
+   const auto private_key = testing::tester::get_private_key( N(alice), "active" );
+
+   signed_transaction trx;
+   trx.max_net_usage_words = 100;
+   trx.context_free_actions.emplace_back( vector<permission_level>{}, N(eosio.null), N(nonce), fc::raw::pack( uint64_t(0) ) );
+   trx.actions.emplace_back( vector<permission_level>{ { N(alice), config::active_name } }, N(eosio), N(reqauth), fc::raw::pack( N(alice) ) );
+   trx.actions.emplace_back( vector<permission_level>{ { N(alice), config::active_name }, { N(bob), config::active_name } },
+                             N(alice), N(addnumobj), fc::raw::pack( std::make_pair( std::string( "x" ), uint64_t(0) ) ) );
+   transaction_template tmpl( trx );
+   const uint32_t nonce_slot = tmpl.add_data_slot( true, 0, 0, sizeof(uint64_t) );
+   const uint32_t sequence_slot = tmpl.add_data_slot( false, 1, 2, sizeof(uint64_t) );
+   BOOST_CHECK_THROW( tmpl.add_data_slot( false, 1, 4, sizeof(uint64_t) ), transaction_exception );
+   BOOST_CHECK_THROW( tmpl.add_data_slot( false, 2, 0, 1 ), transaction_exception );
+
+   const block_id_type reference_block = fc::sha256::hash( std::string( "reference block" ) );
+   trx.expiration = fc::time_point_sec( fc::time_point::now() ) + 3600;
+   trx.set_reference_block( reference_block );
+   trx.context_free_actions[0].data = fc::raw::pack( uint64_t(42) );
+   trx.actions[1].data = fc::raw::pack( std::make_pair( std::string( "x" ), uint64_t(7) ) );
+
+   bytes packed = tmpl.packed();
+   tmpl.set_header( packed, trx.expiration, reference_block );
+   tmpl.set_slot( packed, nonce_slot, uint64_t(42) );
+   tmpl.set_slot( packed, sequence_slot, uint64_t(7) );
+   BOOST_CHECK_THROW( tmpl.set_slot( packed, sequence_slot, uint32_t(7) ), transaction_exception );
+   BOOST_CHECK( fc::raw::pack( static_cast<const transaction&>( trx ) ) == packed );
+
+   const auto digest = transaction_template::sig_digest( packed, chain_id );
+   BOOST_CHECK_EQUAL( trx.sig_digest( chain_id, trx.context_free_data ), digest );
+   trx.sign( private_key, chain_id );
+   vector<signature_type> sigs{ private_key.sign( digest ) };
+   packed_transaction pkt = transaction_template::make_packed( std::move( packed ), std::move( sigs ) );
+   BOOST_CHECK_EQUAL( trx.id(), pkt.id() );
+   flat_set<public_key_type> keys;
+   pkt.get_signature_keys( chain_id, fc::time_point::maximum(), keys );
+   BOOST_REQUIRE_EQUAL( 1u, keys.size() );
+   BOOST_CHECK_EQUAL( private_key.get_public_key(), *keys.begin() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(transaction_dedup_test) { try {
+   testing::TESTER test;
+
+   // recorded under the pending block's undo session
+   auto trace = test.create_account( N(alice) );
+   BOOST_CHECK( test.control->is_known_unexpired_transaction( trace->id ) );
+   test.control->abort_block();
+   BOOST_CHECK( !test.control->is_known_unexpired_transaction( trace->id ) );
+
+   trace = test.create_account( N(alice) );
+   test.produce_block();
+   BOOST_CHECK( test.control->is_known_unexpired_transaction( trace->id ) );
+
+   // the index keeps its hash seed in the state file, so it is found after a restart
+   test.close();
+   test.open();
+   BOOST_CHECK( test.control->is_known_unexpired_transaction( trace->id ) );
+   transaction_id_hash a, b;
+   b.seed = a.seed + 1;
+   BOOST_CHECK_NE( a( trace->id ), b( trace->id ) );
+
+   // dropped by the first block after it expires
+   test.produce_block( fc::seconds( testing::base_tester::DEFAULT_EXPIRATION_DELTA ) );
+   test.produce_block();
+   BOOST_CHECK( !test.control->is_known_unexpired_transaction( trace->id ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(platform_timer_rearm_test) { try {
+   platform_timer timer;
+   const auto wait_expired = [&]( fc::microseconds limit ) {
+      const auto until = fc::time_point::now() + limit;
+      while( !timer.expired && fc::time_point::now() < until ) {}
+      return bool(timer.expired);
+   };
+
+   timer.start( fc::time_point::now() + fc::milliseconds( 20 ) );
+   BOOST_CHECK( !timer.expired );
+   timer.stop();
+   BOOST_CHECK( timer.expired );
+
+   // a later deadline than the one a stopped timer was left armed for still expires, and not before it
+   auto deadline = fc::time_point::now() + fc::milliseconds( 60 );
+   timer.start( deadline );
+   BOOST_CHECK( !timer.expired );
+   BOOST_REQUIRE( wait_expired( fc::seconds( 5 ) ) );
+   BOOST_CHECK( fc::time_point::now() >= deadline );
+
+   // nor does the timer left armed expire a timer started without a deadline
+   timer.start( fc::time_point::now() + fc::milliseconds( 10 ) );
+   timer.stop();
+   timer.start( fc::time_point::maximum() );
+   BOOST_CHECK( !wait_expired( fc::milliseconds( 50 ) ) );
+   timer.stop();
+
+   // an earlier deadline than the one armed
+   timer.start( fc::time_point::now() + fc::seconds( 10 ) );
+   timer.stop();
+   deadline = fc::time_point::now() + fc::milliseconds( 10 );
+   timer.start( deadline );
+   BOOST_REQUIRE( wait_expired( fc::seconds( 5 ) ) );
+   BOOST_CHECK( fc::time_point::now() >= deadline );
+} FC_LOG_AND_RETHROW() }
+
 
 BOOST_AUTO_TEST_CASE(signed_int_test) { try {
     char buf[32];
@@ -917,6 +1171,764 @@ BOOST_AUTO_TEST_CASE(transaction_metadata_test) { try {
 
 } FC_LOG_AND_RETHROW() }
 
+BOOST_AUTO_TEST_CASE(transaction_conflict_groups_test) { try {
+   auto make_receipt = []( std::vector<std::pair<account_name, account_name>> acts ) {
+      signed_transaction trx;
+      for( const auto& a : acts ) {
+         trx.actions.emplace_back( vector<permission_level>{{a.second, config::active_name}}, a.first, N(transfer), bytes() );
+      }
+      return transaction_receipt( packed_transaction( trx ) );
+   };
+
+   signed_block b;
+   b.transactions.push_back( make_receipt( {{N(eosio.token), N(alice)}} ) );  // 0
+   b.transactions.push_back( make_receipt( {{N(dice), N(bob)}} ) );           // 1
+   b.transactions.push_back( transaction_receipt( transaction_id_type() ) );  // 2 scheduled
+   b.transactions.push_back( make_receipt( {{N(game), N(carol)}} ) );         // 3
+   b.transactions.push_back( make_receipt( {{N(dice), N(dave)}} ) );          // 4 conflicts with 1 through dice
+   b.transactions.push_back( make_receipt( {{N(game), N(erin)},
+                                            {N(eosio.token), N(erin)}} ) );   // 5 joins 0 and 3
+
+   auto conflicts = compute_transaction_conflict_groups( b );
+   BOOST_REQUIRE_EQUAL( conflicts.groups.size(), 2u );
+   BOOST_CHECK( conflicts.groups[0] == (vector<uint32_t>{0, 3, 5}) );
+   BOOST_CHECK( conflicts.groups[1] == (vector<uint32_t>{1, 4}) );
+   BOOST_CHECK( conflicts.scheduled == vector<uint32_t>{2} );
+   BOOST_CHECK_EQUAL( conflicts.largest_group(), 3u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(access_set_test) { try {
+   access_set a, b, c, d;
+   a.read( N(dice), N(dice), N(games), 1 );
+   a.write( N(dice), N(dice), N(games), 2 );
+   a.read( N(eosio.token), N(alice), N(accounts), 5459781 );
+
+   b.read( N(dice), N(dice), N(games), 1 );                     // read/read never conflicts
+   b.write( N(eosio.token), N(bob), N(accounts), 5459781 );      // other scope
+   BOOST_CHECK( !a.conflicts_with( b ) );
+   BOOST_CHECK( !b.conflicts_with( a ) );
+
+   c.read( N(dice), N(dice), N(games), 2 );                     // reads a row a writes
+   BOOST_CHECK( a.conflicts_with( c ) );
+   BOOST_CHECK( c.conflicts_with( a ) );
+
+   d.scan( N(dice), N(dice), N(games) );
+   d.read( N(dice), N(dice), N(games), 7 );                     // subsumed by the scan
+   BOOST_REQUIRE_EQUAL( d.tables.size(), 1u );
+   BOOST_CHECK( d.tables[0].scanned );
+   BOOST_CHECK( d.tables[0].reads.empty() );
+   BOOST_CHECK( a.conflicts_with( d ) );                        // a writes into the scanned table
+   BOOST_CHECK( !b.conflicts_with( d ) );
+
+   BOOST_REQUIRE_EQUAL( a.tables.size(), 2u );                  // ordered by code, scope, table
+   BOOST_CHECK_EQUAL( a.tables[0].code, N(dice) );
+   BOOST_CHECK_EQUAL( a.tables[1].code, N(eosio.token) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(action_filter_test) { try {
+   action_filter f;
+   BOOST_CHECK( f.empty() );
+   BOOST_CHECK( !f.match( N(dice), N(bet), N(alice) ) );
+
+   f.add( { N(dice), {}, {} } );                 // everything dice receives
+   f.add( { N(eosio.token), N(transfer), N(bob) } );
+   f.add( { {}, N(vote), {} } );                 // any receiver
+   for( uint64_t i = 1; i < 100; ++i )           // grows the table a few times
+      f.add( { name(i << 4), N(act), name(i) } );
+   BOOST_CHECK( !f.empty() );
+
+   const vector<permission_level> alice{ { N(alice), config::active_name } };
+   const vector<permission_level> alice_bob{ { N(alice), config::active_name }, { N(bob), config::active_name } };
+   BOOST_CHECK( f.match( N(dice), N(bet), alice ) );
+   BOOST_CHECK( f.match( N(dice), N(bet), name() ) );
+   BOOST_CHECK( !f.match( N(eosio.token), N(transfer), alice ) );
+   BOOST_CHECK( f.match( N(eosio.token), N(transfer), alice_bob ) );
+   BOOST_CHECK( f.match( N(eosio.token), N(transfer), N(bob) ) );
+   BOOST_CHECK( !f.match( N(eosio.token), N(transfer), name() ) ); // only entries without an actor
+   BOOST_CHECK( f.match( N(eosio), N(vote), alice ) );
+   BOOST_CHECK( !f.match( N(eosio), N(unvote), alice ) );
+   BOOST_CHECK( f.match( name(7 << 4), N(act), name(7) ) );
+   BOOST_CHECK( !f.match( name(7 << 4), N(act), name(8) ) );
+
+   f.add( { {}, {}, {} } );
+   BOOST_CHECK( f.match( N(eosio), N(unvote), alice ) );
+} FC_LOG_AND_RETHROW() }
+
+// every wildcard pattern against a linear scan of the entries, over names drawn from a few values so that they collide
+BOOST_AUTO_TEST_CASE(action_filter_patterns_test) { try {
+   boost::random::mt19937 gen( 11 );
+   const name names[] = { name(), N(alice), N(bob), N(carol) };
+   boost::random::uniform_int_distribution<size_t> pick( 0, 3 );
+   auto random_name = [&]() { return names[pick( gen )]; };
+
+   using entry = action_filter::entry;
+   auto matches = []( const entry& e, name receiver, name action, name actor ) {
+      return ( e.receiver == name() || e.receiver == receiver ) && ( e.action == name() || e.action == action ) &&
+             ( e.actor == name() || ( actor != name() && e.actor == actor ) );
+   };
+
+   for( int round = 0; round < 50; ++round ) {
+      action_filter f;
+      std::vector<entry> entries;
+      const int count = pick( gen ) + 1;
+      for( int i = 0; i < count; ++i ) {
+         entry e{ random_name(), random_name(), random_name() };
+         if( e.receiver == name() && e.action == name() && e.actor == name() )
+            continue; // matches everything, covered by action_filter_test
+         entries.push_back( e );
+         f.add( e );
+         f.add( e ); // duplicates are ignored
+      }
+      BOOST_REQUIRE_EQUAL( f.empty(), entries.empty() );
+
+      for( name receiver : names ) {
+         for( name action : names ) {
+            for( name actor : names ) {
+               bool expected = false;
+               for( const auto& e : entries )
+                  expected = expected || matches( e, receiver, action, actor );
+               BOOST_REQUIRE_EQUAL( f.match( receiver, action, actor ), expected );
+            }
+
+            // by authorization, any authorizer matching is enough and no authorizer only matches entries without an actor
+            for( size_t n = 0; n <= 2; ++n ) {
+               vector<permission_level> auth;
+               for( size_t i = 0; i < n; ++i )
+                  auth.push_back( { names[1 + ( pick( gen ) % 3 )], config::active_name } );
+               bool expected = false;
+               for( const auto& e : entries ) {
+                  expected = expected || matches( e, receiver, action, name() );
+                  for( const auto& a : auth )
+                     expected = expected || matches( e, receiver, action, a.actor );
+               }
+               BOOST_REQUIRE_EQUAL( f.match( receiver, action, auth ), expected );
+            }
+         }
+      }
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(recovered_keys_cache_test) { try {
+   auto alice_priv = base_tester::get_private_key( N(alice), "active" );
+   auto bob_priv = base_tester::get_private_key( N(bob), "active" );
+   digest_type digest = digest_type::hash( std::string( "recovered_keys_cache_test" ) );
+   auto alice_sig = alice_priv.sign( digest );
+   auto bob_sig = bob_priv.sign( digest );
+
+   recovered_keys_cache disabled( 0 );
+   BOOST_CHECK( !disabled.enabled() );
+   BOOST_CHECK_EQUAL( disabled.recover( alice_sig, digest ), alice_priv.get_public_key() );
+   BOOST_CHECK_EQUAL( disabled.size(), 0u );
+
+   recovered_keys_cache cache( 1024 );
+   BOOST_CHECK_EQUAL( cache.recover( alice_sig, digest ), alice_priv.get_public_key() );
+   BOOST_CHECK_EQUAL( cache.recover( bob_sig, digest ), bob_priv.get_public_key() );
+   BOOST_CHECK_EQUAL( cache.recover( alice_sig, digest ), alice_priv.get_public_key() );
+   BOOST_CHECK_EQUAL( cache.misses(), 2u );
+   BOOST_CHECK_EQUAL( cache.hits(), 1u );
+   BOOST_CHECK_EQUAL( cache.size(), 2u );
+
+   // same signature over a different digest is a distinct entry
+   digest_type other = digest_type::hash( std::string( "other" ) );
+   BOOST_CHECK( cache.recover( alice_sig, other ) != alice_priv.get_public_key() );
+   BOOST_CHECK_EQUAL( cache.misses(), 3u );
+
+   // capacity is bounded
+   recovered_keys_cache small( 1 );
+   for( int i = 0; i < 64; ++i ) {
+      digest_type d = digest_type::hash( std::to_string( i ) );
+      small.recover( alice_priv.sign( d ), d );
+   }
+   BOOST_CHECK_LE( small.size(), 16u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(transaction_metadata_pool_test) { try {
+   tester producer( setup_policy::none );
+   fc::temp_directory tempdir;
+   tester validator( tempdir, []( controller::config& cfg ) { cfg.trx_metadata_pool_size = 64; }, true );
+   auto sync = [&]() {
+      for( uint32_t n = validator.control->head_block_num() + 1; n <= producer.control->head_block_num(); ++n )
+         validator.push_block( producer.control->fetch_block_by_number( n ) );
+   };
+   producer.produce_block();
+   sync();
+
+   signed_transaction trx;
+   trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                             newaccount{ config::system_account_name, N(alice),
+                                         authority( base_tester::get_public_key( N(alice), "owner" ) ),
+                                         authority( base_tester::get_public_key( N(alice), "active" ) ) } );
+   producer.set_transaction_headers( trx );
+   trx.sign( base_tester::get_private_key( config::system_account_name, "active" ), producer.control->get_chain_id() );
+   auto recover = [&]( const signed_transaction& t ) {
+      return transaction_metadata::start_recover_keys( std::make_shared<packed_transaction>( t ), validator.control->get_thread_pool(),
+                                                       validator.control->get_chain_id(), fc::microseconds::maximum() ).get();
+   };
+
+   transaction_metadata_pool disabled( 0 );
+   disabled.add( recover( trx ) );
+   BOOST_CHECK( !disabled.enabled() );
+   BOOST_CHECK( !disabled.find( packed_transaction( trx ) ) );
+
+   // the same id with another signature is not the transaction of the block
+   auto& pool = validator.control->get_transaction_metadata_pool();
+   signed_transaction resigned = trx;
+   resigned.sign( base_tester::get_private_key( N(bob), "active" ), producer.control->get_chain_id() );
+   pool.add( recover( resigned ) );
+   BOOST_CHECK( !pool.find( packed_transaction( trx ) ) );
+   BOOST_CHECK_EQUAL( pool.misses(), 1u );
+
+   // seen before the block, as producer_plugin leaves it for a transaction from a peer
+   const auto meta = recover( trx );
+   pool.add( meta );
+   BOOST_CHECK_EQUAL( pool.size(), 1u );
+   BOOST_CHECK( pool.find( packed_transaction( trx ) ) == meta );
+   producer.push_transaction( trx );
+   producer.produce_block();
+   sync();
+   BOOST_CHECK_EQUAL( pool.hits(), 2u );
+   BOOST_CHECK( validator.control->db().find<account_object, by_name>( N(alice) ) );
+
+   // capacity is bounded
+   transaction_metadata_pool small( 1 );
+   for( int i = 0; i < 64; ++i ) {
+      signed_transaction t = trx;
+      t.actions.front().data.push_back( char(i) );
+      small.add( recover( t ) );
+   }
+   BOOST_CHECK_LE( small.size(), 16u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(unapplied_transaction_queue_bytes_test) { try {
+   auto make_trx = []( uint32_t n, size_t data_size ) {
+      signed_transaction trx;
+      trx.expiration = fc::time_point_sec( fc::time_point::now() ) + 3600;
+      trx.ref_block_num = n;
+      trx.actions.emplace_back( vector<permission_level>{{N(alice), config::active_name}}, N(test), N(act), bytes( data_size ) );
+      return transaction_metadata::create_no_recover_keys( packed_transaction( trx ), transaction_metadata::trx_type::input );
+   };
+   const auto small = make_trx( 1, 10 );
+   const auto big = make_trx( 2, 1000 );
+
+   unapplied_transaction_queue q;
+   q.set_priority_function( [&]( const transaction_metadata_ptr& trx ) -> int64_t { return trx == big ? 1 : 0; } );
+   q.add_aborted( { small, big } );
+   BOOST_CHECK_EQUAL( q.bytes( trx_enum_type::aborted ),
+                      unapplied_transaction_queue::bytes_of( small ) + unapplied_transaction_queue::bytes_of( big ) );
+
+   // promoting moves the bytes to persisted
+   q.add_persisted( small );
+   BOOST_CHECK_EQUAL( q.bytes( trx_enum_type::aborted ), unapplied_transaction_queue::bytes_of( big ) );
+   BOOST_CHECK_EQUAL( q.bytes( trx_enum_type::persisted ), unapplied_transaction_queue::bytes_of( small ) );
+   q.erase( q.persisted_begin() );
+   BOOST_CHECK_EQUAL( q.bytes( trx_enum_type::persisted ), 0u );
+
+   // over the bound, the lowest priority and then newest are evicted
+   std::vector<transaction_metadata_ptr> flood;
+   for( uint32_t i = 10; i < 20; ++i )
+      flood.push_back( make_trx( i, 10 ) );
+   q.set_max_bytes( trx_enum_type::aborted, unapplied_transaction_queue::bytes_of( big ) + 3 * unapplied_transaction_queue::bytes_of( small ) );
+   q.add_aborted( flood );
+   BOOST_CHECK_EQUAL( q.size(), 4u );
+   BOOST_CHECK_EQUAL( q.evicted(), 7u );
+   BOOST_CHECK( q.get_trx( big->id() ) );
+   for( size_t i = 0; i < flood.size(); ++i )
+      BOOST_CHECK_EQUAL( bool( q.get_trx( flood[i]->id() ) ), i < 3 );
+   BOOST_CHECK_LE( q.bytes( trx_enum_type::aborted ),
+                   unapplied_transaction_queue::bytes_of( big ) + 3 * unapplied_transaction_queue::bytes_of( small ) );
+
+   BOOST_CHECK_THROW( q.set_max_bytes( trx_enum_type::persisted, 1 ), fc::exception );
+   q.clear();
+   BOOST_CHECK_EQUAL( q.bytes( trx_enum_type::aborted ), 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(secondary_key_less_test) { try {
+   boost::random::mt19937 gen( 7 );
+   boost::random::uniform_int_distribution<uint64_t> bits;
+
+   std::vector<float64_t> doubles;
+   for( double d : { 0.0, -0.0, 1.0, -1.0, 1e-310, -1e-310, 1e300, -1e300, std::numeric_limits<double>::infinity(),
+                     -std::numeric_limits<double>::infinity(), std::numeric_limits<double>::quiet_NaN() } ) {
+      float64_t f;
+      memcpy( &f, &d, sizeof(f) );
+      doubles.push_back( f );
+   }
+   for( int i = 0; i < 200; ++i )
+      doubles.push_back( float64_t{ bits( gen ) } );
+   for( const auto& l : doubles )
+      for( const auto& r : doubles )
+         BOOST_REQUIRE_EQUAL( soft_double_less()( l, r ), f64_lt( l, r ) );
+
+   std::vector<float128_t> long_doubles;
+   for( const auto& d : doubles )
+      long_doubles.push_back( f64_to_f128( d ) );
+   for( int i = 0; i < 100; ++i )
+      long_doubles.push_back( float128_t{ { bits( gen ), bits( gen ) } } );
+   for( const auto& l : long_doubles )
+      for( const auto& r : long_doubles )
+         BOOST_REQUIRE_EQUAL( soft_long_double_less()( l, r ), f128_lt( l, r ) );
+
+   std::vector<key256_t> keys = { {{0, 0}}, {{0, 1}}, {{1, 0}}, {{~uint128_t(0), 0}}, {{0, ~uint128_t(0)}} };
+   for( int i = 0; i < 50; ++i )
+      keys.push_back( {{ ( uint128_t( bits( gen ) ) << 64 ) | bits( gen ), uint128_t( bits( gen ) % 3 ) }} );
+   for( const auto& l : keys )
+      for( const auto& r : keys )
+         BOOST_REQUIRE_EQUAL( key256_less()( l, r ), std::less<key256_t>()( l, r ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(replica_head_marker_test) { try {
+   fc::temp_directory tempdir;
+   BOOST_CHECK_THROW( replica_head_marker( tempdir.path(), replica_head_marker::mode::follow ), fc::exception );
+
+   replica_head_marker primary( tempdir.path(), replica_head_marker::mode::publish );
+   replica_head_marker replica( tempdir.path(), replica_head_marker::mode::follow );
+   BOOST_CHECK( !replica.read() ); // nothing published yet
+
+   replica_head h;
+   h.head.block_num = 42;
+   h.head.id = block_id_type( "000000002a000000000000000000000000000000000000000000000000000000" );
+   h.irreversible_block_num = 40;
+   primary.publish( h );
+   auto r = replica.read();
+   BOOST_REQUIRE( r );
+   BOOST_CHECK_EQUAL( r->first % 2, 0u );
+   BOOST_CHECK_EQUAL( r->second.head.block_num, 42u );
+   BOOST_CHECK_EQUAL( r->second.head.id, h.head.id );
+   BOOST_CHECK_EQUAL( r->second.irreversible_block_num, 40u );
+   BOOST_CHECK_EQUAL( replica.sequence(), r->first );
+
+   // while the primary writes the head can not be read and the sequence it was read at is gone
+   primary.begin_write();
+   primary.begin_write();
+   BOOST_CHECK( !replica.read() );
+   BOOST_CHECK_EQUAL( replica.sequence(), r->first + 1 );
+   BOOST_CHECK( !replica.unchanged_since( r->first ) );
+   h.head.block_num = 43;
+   primary.publish( h );
+   auto r2 = replica.read();
+   BOOST_REQUIRE( r2 );
+   BOOST_CHECK_EQUAL( r2->first, r->first + 2 );
+   BOOST_CHECK_EQUAL( r2->second.head.block_num, 43u );
+   BOOST_CHECK( !replica.unchanged_since( r->first ) ); // stale
+   BOOST_CHECK( replica.unchanged_since( r2->first ) );
+
+   // the primary never waits on a replica, a read it overlapped is told so afterwards
+   const auto before = replica.sequence();
+   primary.begin_write();
+   BOOST_CHECK( !replica.unchanged_since( before ) );
+   primary.publish( h );
+   BOOST_CHECK( !replica.unchanged_since( before ) );
+   BOOST_CHECK( replica.unchanged_since( replica.sequence() ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(fixed_layout_pack_test) { try {
+   static_assert( is_fixed_layout<permission_level>::value && !is_fixed_layout<transaction_receipt_header>::value, "" );
+
+   vector<permission_level> auth{ {N(alice), N(active)}, {N(bob), N(owner)}, {N(carol), N(eosio.code)} };
+   const block_timestamp_type t( 123456 );
+   for( const auto& v : { auth, vector<permission_level>{} } ) {
+      vector<char> expected = fc::raw::pack( v );
+      const auto packed_t = fc::raw::pack( t );
+      expected.insert( expected.end(), packed_t.begin(), packed_t.end() );
+      vector<char> packed( expected.size() );
+      fc::datastream<char*> ds( packed.data(), packed.size() );
+      raw_fixed::pack( ds, v );
+      raw_fixed::pack( ds, t );
+      BOOST_REQUIRE( packed == expected );
+
+      fc::datastream<const char*> in( packed.data(), packed.size() );
+      vector<permission_level> unpacked_v{ {N(stale), N(stale)} };
+      block_timestamp_type unpacked_t;
+      raw_fixed::unpack( in, unpacked_v );
+      raw_fixed::unpack( in, unpacked_t );
+      BOOST_CHECK( unpacked_v == v );
+      BOOST_CHECK( unpacked_t == t );
+      BOOST_CHECK_EQUAL( in.remaining(), 0u );
+   }
+
+   // the one read of all elements fails on a truncated vector
+   auto packed = fc::raw::pack( auth );
+   fc::datastream<const char*> truncated( packed.data(), packed.size() - 1 );
+   vector<permission_level> unpacked;
+   BOOST_CHECK_THROW( raw_fixed::unpack( truncated, unpacked ), fc::exception );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(merkle_test) { try {
+   // reference implementation hashing packed canonical pairs
+   auto reference_merkle = []( vector<digest_type> ids ) {
+      if( ids.empty() ) return digest_type();
+      while( ids.size() > 1 ) {
+         if( ids.size() % 2 )
+            ids.push_back( ids.back() );
+         for( size_t i = 0; i < ids.size() / 2; ++i )
+            ids[i] = digest_type::hash( make_canonical_pair( ids[2 * i], ids[(2 * i) + 1] ) );
+         ids.resize( ids.size() / 2 );
+      }
+      return ids.front();
+   };
+
+   vector<digest_type> ids;
+   BOOST_CHECK_EQUAL( merkle( ids ), digest_type() );
+   for( uint32_t i = 0; i < 37; ++i ) {
+      ids.emplace_back( digest_type::hash( i ) );
+      BOOST_CHECK_EQUAL( merkle( ids ), reference_merkle( ids ) );
+   }
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(span_tracer_test) { try {
+   // the buffer is process wide and sized once, so keep it to this test
+   if( !span_tracer::initialized() )
+      span_tracer::initialize( 4 );
+   span_tracer::set_enabled( true );
+   const auto trx_id = transaction_id_type::hash( std::string( "trx" ) );
+   const uint64_t trace = span_trace_id( trx_id );
+
+   span_tracer::span s;
+   s.category = "test";
+   for( int i = 0; i < 6; ++i ) {
+      s.name = i % 2 ? "odd" : "even";
+      s.trace_id = i < 3 ? 0 : trace;
+      s.start_us = 1000 + i * 10;
+      s.duration_us = 5;
+      span_tracer::record( s );
+   }
+   {
+      scoped_span scoped( "test", "scoped", trace );
+   }
+   span_tracer::set_enabled( false );
+   { scoped_span ignored( "test", "ignored" ); }
+
+   // the buffer wrapped, leaving the newest 4
+   const auto spans = span_tracer::spans();
+   BOOST_REQUIRE_EQUAL( spans.size(), 4u );
+   BOOST_CHECK_EQUAL( spans[0].start_us, span_tracing_compiled ? 1030 : 1020 );
+   BOOST_CHECK_EQUAL( spans.back().name, span_tracing_compiled ? "scoped" : "odd" );
+
+   // the spans of the trace are joined by a flow, started, stepped through and finished
+   char flow_id[24];
+   snprintf( flow_id, sizeof(flow_id), "0x%" PRIx64, trace );
+   const auto chrome = fc::json::from_string( span_tracer::chrome_trace_json() ).get_object();
+   uint32_t complete = 0, flow = 0;
+   for( const auto& e : chrome["traceEvents"].get_array() ) {
+      const auto phase = e["ph"].as_string();
+      if( phase == "X" )
+         ++complete;
+      if( phase == "s" || phase == "t" || phase == "f" ) {
+         ++flow;
+         BOOST_CHECK_EQUAL( e["id"].as_string(), flow_id );
+      }
+   }
+   BOOST_CHECK_EQUAL( complete, 4u );
+   BOOST_CHECK_EQUAL( flow, span_tracing_compiled ? 4u : 3u );
+
+   const auto otlp = fc::json::from_string( span_tracer::otlp_json( "test" ) ).get_object();
+   const auto& otlp_spans = otlp["resourceSpans"].get_array().at( 0 )["scopeSpans"].get_array().at( 0 )["spans"].get_array();
+   BOOST_REQUIRE_EQUAL( otlp_spans.size(), 4u );
+   BOOST_CHECK_EQUAL( otlp_spans.back()["traceId"].as_string().size(), 32u );
+   BOOST_CHECK_EQUAL( otlp_spans.back()["endTimeUnixNano"].as_string(),
+                      std::to_string( uint64_t( spans.back().start_us + spans.back().duration_us ) * 1000 ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(sampling_profiler_test) { try {
+   BOOST_CHECK_THROW( sampling_profiler( 0, 16 ), misc_exception );
+
+   // samples are taken of process cpu time, so keep a thread busy until enough were taken
+   auto spin_until = []( const sampling_profiler& p, uint32_t taken ) {
+      volatile uint64_t x = 0;
+      const auto deadline = fc::time_point::now() + fc::seconds( 30 );
+      while( p.samples() + p.dropped() < taken && fc::time_point::now() < deadline ) {
+         for( uint32_t i = 0; i < 100000; ++i )
+            x = x + i;
+      }
+   };
+
+   sampling_profiler profiler( 1000, 1024 );
+   profiler.start();
+   sampling_profiler other( 1000, 16 );
+   BOOST_CHECK_THROW( other.start(), misc_exception );
+   std::thread busy( [&]() { spin_until( profiler, 20 ); } );
+   busy.join();
+   profiler.stop();
+   const uint32_t taken = profiler.samples();
+   BOOST_REQUIRE_GE( taken, 20u );
+   BOOST_CHECK_EQUAL( profiler.dropped(), 0u );
+   std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+   BOOST_CHECK_EQUAL( profiler.samples(), taken );
+
+   // every sample is a root first stack of named frames, none of them compiled wasm here
+   uint32_t oc_names = 0;
+   const auto stacks = profiler.folded( [&]( size_t ) { ++oc_names; return std::string(); } );
+   uint64_t folded = 0;
+   for( const auto& s : stacks ) {
+      BOOST_CHECK( !s.first.empty() && s.first.find( ";;" ) == std::string::npos );
+      folded += s.second;
+   }
+   BOOST_CHECK_EQUAL( folded, taken );
+   BOOST_CHECK_EQUAL( oc_names, 0u );
+
+   // once the buffer is full samples are only counted, and another profiler can start once this one stopped
+   sampling_profiler small( 1000, 4 );
+   small.start();
+   spin_until( small, 10 );
+   small.stop();
+   BOOST_CHECK_EQUAL( small.samples(), 4u );
+   BOOST_CHECK_GE( small.dropped(), 6u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(signal_worker_test) { try {
+   using applied_t = std::tuple<const int&, const std::string&>;
+   std::vector<std::string> delivered;
+   std::vector<std::thread::id> threads;
+   auto subscriber = [&]( applied_t t ) {
+      if( std::get<0>( t ) == 3 )
+         throw std::runtime_error( "subscriber failure" );
+      delivered.push_back( std::to_string( std::get<0>( t ) ) + std::get<1>( t ) );
+      threads.push_back( std::this_thread::get_id() );
+   };
+
+   signal_worker sync( "sync", 0 );
+   BOOST_REQUIRE( !sync.is_async() );
+   auto sync_slot = sync.slot<applied_t>( subscriber );
+   int n = 1;
+   std::string s = "a";
+   sync_slot( applied_t( n, s ) );
+   BOOST_REQUIRE_EQUAL( delivered.size(), 1u );
+   BOOST_CHECK( threads.back() == std::this_thread::get_id() );
+
+   delivered.clear();
+   threads.clear();
+   signal_worker async( "async", 2 );
+   auto async_slot = async.slot<applied_t>( subscriber );
+   for( n = 0; n < 50; ++n ) {
+      s = "x" + std::to_string( n );
+      // the worker holds copies, not the references the signal passed
+      async_slot( applied_t( n, s ) );
+   }
+   s.clear();
+   async.drain();
+   BOOST_REQUIRE_EQUAL( delivered.size(), 49u );
+   for( size_t i = 0, v = 0; i < delivered.size(); ++i, ++v ) {
+      if( v == 3 )
+         ++v;
+      BOOST_CHECK_EQUAL( delivered[i], std::to_string( v ) + "x" + std::to_string( v ) );
+      BOOST_CHECK( threads[i] != std::this_thread::get_id() );
+   }
+
+   async.stop();
+   async_slot( applied_t( n, s ) );
+   BOOST_CHECK_EQUAL( delivered.size(), 49u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(work_stealing_test) { try {
+   named_thread_pool pool( "steal", 4 );
+   const size_t n = 100000;
+   std::vector<std::atomic<uint32_t>> calls( n );
+   std::mutex mtx;
+   std::set<std::thread::id> threads;
+   pool.parallel_for( n, [&]( size_t i ) {
+      ++calls[i];
+      std::lock_guard<std::mutex> g( mtx );
+      threads.insert( std::this_thread::get_id() );
+   }, 64 );
+   for( size_t i = 0; i < n; ++i )
+      BOOST_REQUIRE_EQUAL( calls[i].load(), 1u );
+   BOOST_TEST_MESSAGE( "parallel_for ran on " << threads.size() << " threads" );
+
+   // nested from a thread of the pool, which waits by running other tasks
+   std::atomic<size_t> inner{0};
+   auto f = async_thread_pool( pool.get_executor(), [&]() {
+      pool.parallel_for( 16, [&]( size_t ) {
+         pool.parallel_for( 16, [&]( size_t ) { ++inner; } );
+      } );
+   } );
+   f.get();
+   BOOST_CHECK_EQUAL( inner.load(), 256u );
+
+   // both sides run even if one throws, and the exception reaches the caller
+   std::atomic<bool> other{false};
+   BOOST_CHECK_THROW( pool.fork_join( []() { throw std::runtime_error( "fork failure" ); }, [&]() { other = true; } ),
+                      std::runtime_error );
+   BOOST_CHECK( other.load() );
+   BOOST_CHECK_THROW( pool.parallel_for( 1000, []( size_t i ) { if( i == 777 ) throw std::runtime_error( "index" ); } ),
+                      std::runtime_error );
+
+   // once stopped the calling thread runs everything
+   pool.stop();
+   size_t after_stop = 0;
+   pool.parallel_for( 100, [&]( size_t ) { ++after_stop; } );
+   BOOST_CHECK_EQUAL( after_stop, 100u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(transaction_latency_test) { try {
+   auto make_trx = []( uint16_t n ) {
+      signed_transaction trx;
+      trx.ref_block_num = n;
+      return packed_transaction( trx );
+   };
+   auto counts = []() {
+      std::vector<uint64_t> c;
+      for( const auto& s : transaction_latency::all() )
+         c.push_back( s.count );
+      return c;
+   };
+   const auto stage = []( transaction_latency::stage s ) { return static_cast<size_t>( s ); };
+   const auto before = counts();
+   BOOST_REQUIRE_EQUAL( before.size(), stage( transaction_latency::stage::count ) );
+
+   const auto tracked = make_trx( 1 );
+   const auto untracked = make_trx( 2 );
+   signed_block b;
+   b.transactions.emplace_back( tracked );
+   b.transactions.emplace_back( untracked );
+
+   // disabled, nothing is recorded
+   transaction_latency::received( tracked.id() );
+   transaction_latency::irreversible( b );
+   BOOST_CHECK( counts() == before );
+
+   transaction_latency::enable( 8 );
+   transaction_latency::received( tracked.id() );
+   transaction_latency::keys_recovered( tracked.id() );
+   transaction_latency::execution_started( tracked.id() );
+   transaction_latency::executed( tracked.id() );
+   transaction_latency::keys_recovered( untracked.id() );
+   transaction_latency::included( b );
+   transaction_latency::irreversible( b );
+   auto after = counts();
+   for( size_t i = 0; i < after.size(); ++i )
+      BOOST_CHECK_EQUAL( after[i], before[i] + 1 );
+
+   // the record is gone once irreversible
+   transaction_latency::irreversible( b );
+   BOOST_CHECK( counts() == after );
+
+   // the oldest record is dropped for a new one, missing stamps leave their stages out
+   transaction_latency::enable( 1 );
+   transaction_latency::received( tracked.id() );
+   transaction_latency::received( untracked.id() );
+   transaction_latency::irreversible( b );
+   const auto last = counts();
+   BOOST_CHECK_EQUAL( last[stage( transaction_latency::stage::total )], after[stage( transaction_latency::stage::total )] + 1 );
+   BOOST_CHECK_EQUAL( last[stage( transaction_latency::stage::execution )], after[stage( transaction_latency::stage::execution )] );
+
+   for( const auto& s : transaction_latency::all() ) {
+      BOOST_CHECK_EQUAL( s.buckets.size(), transaction_latency::bounds_us.size() + 1 );
+      BOOST_CHECK_LE( s.p50_us, s.p99_us );
+      BOOST_CHECK_LE( s.p99_us, s.max_us );
+   }
+   transaction_latency::enable( 0 );
+   BOOST_CHECK( !transaction_latency::enabled() );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(app_thread_stats_test) { try {
+   auto& reads = app_thread_stats::origin( "test:read", 1 );
+   BOOST_CHECK( &reads == &app_thread_stats::origin( "test:read", 1 ) );
+   BOOST_CHECK( &reads != &app_thread_stats::origin( "test:read", 2 ) );
+   auto& blocks = app_thread_stats::origin( "test:block", 3, true );
+   const auto pending = app_thread_stats::blocks_pending();
+
+   blocks.posted();
+   reads.posted();
+   reads.posted();
+   reads.posted();
+   BOOST_CHECK_EQUAL( app_thread_stats::blocks_pending(), pending + 1 );
+   reads.started( fc::microseconds( 50 ) );
+   reads.finished( fc::microseconds( 700 ) );
+   reads.shed( fc::milliseconds( 30 ) );
+   blocks.started( fc::microseconds( 100 ) );
+   blocks.finished( fc::milliseconds( 2 ) );
+   BOOST_CHECK_EQUAL( app_thread_stats::blocks_pending(), pending );
+
+   const auto s = reads.get_stats();
+   BOOST_CHECK_EQUAL( s.name, "test:read" );
+   BOOST_CHECK_EQUAL( s.posted, 3u );
+   BOOST_CHECK_EQUAL( s.ran, 1u );
+   BOOST_CHECK_EQUAL( s.shed, 1u );
+   BOOST_CHECK_EQUAL( s.queued, 1u );
+   BOOST_CHECK_EQUAL( s.wait_us, 30050u );
+   BOOST_CHECK_EQUAL( s.max_wait_us, 30000u );
+   BOOST_CHECK_EQUAL( s.run_us, 700u );
+   // bounds are inclusive: 50us in the first bucket, 30ms in the one up to 100ms
+   BOOST_REQUIRE_EQUAL( s.wait_buckets.size(), app_thread_origin::wait_bounds_us.size() + 1 );
+   BOOST_CHECK_EQUAL( s.wait_buckets[0], 1u );
+   BOOST_CHECK_EQUAL( s.wait_buckets[4], 1u );
+   BOOST_CHECK_EQUAL( blocks.get_stats().wait_buckets[0], 1u );
+
+   const auto all = app_thread_stats::all();
+   BOOST_CHECK( std::any_of( all.begin(), all.end(), []( const auto& o ) { return o.name == "test:block" && o.priority == 3; } ) );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(app_thread_load_shedding_test) { try {
+   auto& reads = app_thread_stats::origin( "test:shed_read", 1 );
+   auto& blocks = app_thread_stats::origin( "test:shed_block", 3, true );
+   const auto deadline = fc::milliseconds( 10 );
+   const auto queued = fc::time_point::now() + fc::microseconds( 1 );
+   const auto stale = queued + fc::milliseconds( 20 );
+   const auto fresh = queued + fc::milliseconds( 5 );
+   BOOST_REQUIRE_EQUAL( app_thread_stats::blocks_pending(), 0u );
+   BOOST_REQUIRE( app_thread_stats::last_block_started() < queued );
+
+   // without a block waiting or run since, even a stale read runs
+   BOOST_CHECK( !app_thread_stats::should_shed( queued, stale, deadline ) );
+
+   blocks.posted();
+   BOOST_CHECK( app_thread_stats::should_shed( queued, stale, deadline ) );
+   BOOST_CHECK( !app_thread_stats::should_shed( queued, fresh, deadline ) );
+   BOOST_CHECK( !app_thread_stats::should_shed( queued, queued + deadline, deadline ) );
+   // a deadline of zero never sheds
+   BOOST_CHECK( !app_thread_stats::should_shed( queued, stale, fc::microseconds() ) );
+
+   // once the block has run, reads that waited for it are still shed, later ones are not
+   while( fc::time_point::now() < queued ) {}
+   blocks.started( fc::microseconds( 100 ) );
+   BOOST_CHECK_EQUAL( app_thread_stats::blocks_pending(), 0u );
+   BOOST_CHECK( app_thread_stats::should_shed( queued, stale, deadline ) );
+   BOOST_CHECK( !app_thread_stats::should_shed( queued, fresh, deadline ) );
+   const auto later = fc::time_point::now() + fc::microseconds( 1 );
+   BOOST_CHECK( !app_thread_stats::should_shed( later, later + fc::milliseconds( 20 ), deadline ) );
+
+   reads.posted();
+   reads.posted();
+   if( app_thread_stats::should_shed( queued, stale, deadline ) )
+      reads.shed( stale - queued );
+   if( !app_thread_stats::should_shed( queued, fresh, deadline ) )
+      reads.started( fresh - queued );
+
+   const auto s = reads.get_stats();
+   BOOST_CHECK_EQUAL( s.shed, 1u );
+   BOOST_CHECK_EQUAL( s.ran, 1u );
+   BOOST_CHECK_EQUAL( s.queued, 0u );
+} FC_LOG_AND_RETHROW() }
+
+BOOST_AUTO_TEST_CASE(read_only_transaction_test) { try {
+   tester chain;
+
+   // unsigned, authorization is not checked for read-only transactions
+   signed_transaction trx;
+   trx.actions.emplace_back( vector<permission_level>{{config::system_account_name, config::active_name}},
+                             newaccount{ config::system_account_name, N(alice),
+                                         authority( base_tester::get_public_key( N(alice), "owner" ) ),
+                                         authority( base_tester::get_public_key( N(alice), "active" ) ) } );
+   chain.set_transaction_headers( trx );
+
+   BOOST_REQUIRE( chain.control->is_building_block() );
+   const auto pending_receipts = chain.control->get_pending_trx_receipts().size();
+   auto meta = transaction_metadata::create_no_recover_keys( packed_transaction( trx ), transaction_metadata::trx_type::read_only );
+   auto trace = chain.control->push_transaction( meta, fc::time_point::maximum(), 0, false );
+   BOOST_REQUIRE( trace );
+   BOOST_CHECK( !trace->except );
+   BOOST_CHECK( !trace->receipt );
+   BOOST_CHECK_EQUAL( trace->action_traces.size(), 1u );
+
+   // nothing is kept
+   BOOST_CHECK( chain.control->db().find<account_object, by_name>( N(alice) ) == nullptr );
+   BOOST_CHECK_EQUAL( chain.control->get_pending_trx_receipts().size(), pending_receipts );
+
+   // the same transaction can still be applied for real
+   chain.create_account( N(alice) );
+   BOOST_CHECK( chain.control->db().find<account_object, by_name>( N(alice) ) != nullptr );
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE(reflector_init_test) {
    try {
 
@@ -0,0 +1,167 @@
+#include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/resource_limits.hpp>
+#include <eosio/testing/tester.hpp>
+
+#include <fc/variant_object.hpp>
+
+#include <boost/test/unit_test.hpp>
+
+#include <contracts.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+using mvo = fc::mutable_variant_object;
+
+namespace {
+
+   const vector<account_name> token_accounts = { N(eosio.token), N(alice), N(bob), N(carol) };
+
+   struct token_chain {
+      fc::temp_directory tempdir;
+      tester             chain;
+      abi_serializer     abi_ser;
+
+      explicit token_chain( bool native )
+      : chain( tempdir, [native]( controller::config& cfg ) { cfg.native_contracts = native; }, true ) {
+         chain.create_accounts( { N(alice), N(bob), N(carol), N(eosio.token) } );
+         chain.set_code( N(eosio.token), contracts::eosio_token_wasm() );
+         chain.set_abi( N(eosio.token), contracts::eosio_token_abi().data() );
+         chain.produce_blocks();
+         abi_ser.set_abi( fc::json::from_string( contracts::eosio_token_abi().data() ).as<abi_def>(),
+                          abi_serializer::create_yield_function( tester::abi_serializer_max_time ) );
+      }
+
+      bytes pack( action_name name, const fc::variant_object& data ) {
+         return abi_ser.variant_to_binary( abi_ser.get_action_type( name ), data, abi_serializer::create_yield_function( tester::abi_serializer_max_time ) );
+      }
+
+      /// the top message of the failure, or "success" once the transaction is in a block
+      std::string push( action_name name, const bytes& data, const vector<account_name>& signers ) {
+         signed_transaction trx;
+         vector<permission_level> auths;
+         for( const auto& s : signers )
+            auths.push_back( { s, config::active_name } );
+         trx.actions.emplace_back( auths, N(eosio.token), name, data );
+         chain.set_transaction_headers( trx );
+         for( const auto& s : signers )
+            trx.sign( chain.get_private_key( s, "active" ), chain.control->get_chain_id() );
+         try {
+            chain.push_transaction( trx );
+         } catch( const fc::exception& e ) {
+            return e.top_message();
+         }
+         chain.produce_block();
+         return "success";
+      }
+
+      std::string transfer_data( const bytes& data, const vector<account_name>& signers ) {
+         return push( N(transfer), data, signers );
+      }
+
+      std::string transfer( account_name from, account_name to, const string& quantity, const string& memo,
+                            const vector<account_name>& signers ) {
+         return transfer_data( pack( N(transfer), mvo()("from", from)("to", to)("quantity", quantity)("memo", memo) ), signers );
+      }
+
+      /// the balances, supplies and RAM usage the actions left
+      vector<string> state() {
+         vector<string> result;
+         for( const auto& acct : token_accounts ) {
+            for( const char* sym : { "CERO", "DOS" } ) {
+               const auto code = symbol::from_string( string("4,") + sym ).to_symbol_code().value;
+               const auto account_row = chain.get_row_by_account( N(eosio.token), acct, N(accounts), name(code) );
+               const auto stat_row = chain.get_row_by_account( N(eosio.token), name(code), N(stat), name(code) );
+               result.push_back( acct.to_string() + " " + sym + " " + fc::to_hex( account_row ) + " " + fc::to_hex( stat_row ) );
+            }
+            result.push_back( acct.to_string() + " ram " +
+                              std::to_string( chain.control->get_resource_limits_manager().get_account_ram_usage( acct ) ) );
+         }
+         return result;
+      }
+   };
+
+   /// the same transfers through the native handler and the wasm, and what each left
+   template<typename F>
+   void differential( F&& f ) {
+      token_chain native( true ), wasm( false );
+      const auto& metadata = native.chain.control->db().get<account_metadata_object, by_name>( N(eosio.token) );
+      BOOST_REQUIRE( native.chain.control->find_native_contract_handler( metadata.code_hash, N(transfer) ) );
+      BOOST_REQUIRE( !wasm.chain.control->find_native_contract_handler( metadata.code_hash, N(transfer) ) );
+
+      f( native, wasm );
+      const auto native_state = native.state(), wasm_state = wasm.state();
+      BOOST_REQUIRE_EQUAL_COLLECTIONS( native_state.begin(), native_state.end(), wasm_state.begin(), wasm_state.end() );
+
+      // a node running the wasm validates the blocks of one running the native handler to the same state
+      tester validator( setup_policy::none );
+      for( uint32_t n = validator.control->head_block_num() + 1; n <= native.chain.control->head_block_num(); ++n )
+         validator.push_block( native.chain.control->fetch_block_by_number( n ) );
+      BOOST_REQUIRE_EQUAL( validator.control->calculate_integrity_hash().str(), native.chain.control->calculate_integrity_hash().str() );
+   }
+
+}
+
+BOOST_AUTO_TEST_SUITE(native_contract_tests)
+
+BOOST_AUTO_TEST_CASE( token_transfer_differential ) try {
+   differential( []( token_chain& native, token_chain& wasm ) {
+      const auto both = [&]( auto&& f ) {
+         const std::string result = f( native );
+         BOOST_REQUIRE_EQUAL( result, f( wasm ) );
+         return result;
+      };
+
+      for( auto* c : { &native, &wasm } ) {
+         BOOST_REQUIRE_EQUAL( "success", c->push( N(create), c->pack( N(create), mvo()("issuer", "alice")("maximum_supply", "1000000.0000 CERO") ), { N(eosio.token) } ) );
+         BOOST_REQUIRE_EQUAL( "success", c->push( N(create), c->pack( N(create), mvo()("issuer", "alice")("maximum_supply", "1000.00 DOS") ), { N(eosio.token) } ) );
+         BOOST_REQUIRE_EQUAL( "success", c->push( N(issue), c->pack( N(issue), mvo()("to", "alice")("quantity", "1000.0000 CERO")("memo", "") ), { N(alice) } ) );
+         BOOST_REQUIRE_EQUAL( "success", c->push( N(issue), c->pack( N(issue), mvo()("to", "alice")("quantity", "10.00 DOS")("memo", "") ), { N(alice) } ) );
+      }
+
+      // a new balance paid for by the sender, then by the receiver who signed too, then an existing one
+      BOOST_REQUIRE_EQUAL( "success", both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "300.0000 CERO", "hola", { N(alice) } ); } ) );
+      BOOST_REQUIRE_EQUAL( "success", both( []( token_chain& c ) { return c.transfer( N(alice), N(carol), "1.00 DOS", "", { N(alice), N(carol) } ); } ) );
+      BOOST_REQUIRE_EQUAL( "success", both( []( token_chain& c ) { return c.transfer( N(bob), N(alice), "0.0001 CERO", string(256, 'm'), { N(bob) } ); } ) );
+      BOOST_REQUIRE_EQUAL( "success", both( []( token_chain& c ) { return c.transfer( N(bob), N(alice), "299.9999 CERO", "", { N(bob), N(alice) } ); } ) );
+      // the contract's own balance
+      BOOST_REQUIRE_EQUAL( "success", both( []( token_chain& c ) { return c.transfer( N(carol), N(eosio.token), "1.00 DOS", "", { N(carol) } ); } ) );
+
+      // each assertion of transfer, sub_balance and add_balance
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(alice), "1.0000 CERO", "", { N(alice) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "1.0000 CERO", "", { N(bob) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(nobody), "1.0000 CERO", "", { N(alice) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "1.0000 TRES", "", { N(alice) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "-1.0000 CERO", "", { N(alice) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "0.0000 CERO", "", { N(alice) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "1.000 CERO", "", { N(alice) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "1.0000 CERO", string(257, 'm'), { N(alice) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(carol), N(bob), "1.0000 CERO", "", { N(carol) } ); } );
+      both( []( token_chain& c ) { return c.transfer( N(alice), N(bob), "1000.0001 CERO", "", { N(alice) } ); } );
+
+      // action data the abi would not produce
+      const auto valid = native.pack( N(transfer), mvo()("from", "alice")("to", "bob")("quantity", "1.0000 CERO")("memo", "ab") );
+      for( size_t size = 0; size < valid.size(); ++size )
+         both( [&]( token_chain& c ) { return c.transfer_data( bytes( valid.begin(), valid.begin() + size ), { N(alice) } ); } );
+      auto with = [&]( size_t offset, std::initializer_list<uint8_t> patch ) {
+         bytes data = valid;
+         std::copy( patch.begin(), patch.end(), data.begin() + offset );
+         return data;
+      };
+      const size_t amount_offset = 16, symbol_offset = 24, memo_offset = 32;
+      // amounts past 2^62, a symbol with a lower case letter or a gap in its code
+      both( [&]( token_chain& c ) { return c.transfer_data( with( amount_offset, { 0, 0, 0, 0, 0, 0, 0, 0x40 } ), { N(alice) } ); } );
+      both( [&]( token_chain& c ) { return c.transfer_data( with( symbol_offset + 2, { 'e' } ), { N(alice) } ); } );
+      both( [&]( token_chain& c ) { return c.transfer_data( with( symbol_offset + 2, { 0 } ), { N(alice) } ); } );
+      // a memo size running past the data, and trailing bytes after it, which transfer ignores
+      both( [&]( token_chain& c ) { return c.transfer_data( with( memo_offset, { 0x83, 0x00 } ), { N(alice) } ); } );
+      BOOST_REQUIRE_EQUAL( "success", both( [&]( token_chain& c ) {
+         bytes data = valid;
+         data.push_back( 7 );
+         return c.transfer_data( data, { N(alice) } );
+      } ) );
+   } );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -37,7 +37,7 @@ BOOST_AUTO_TEST_SUITE(producer_schedule_tests)
    // However, it won't be applied until the effective block num is deemed irreversible
    uint64_t calc_block_num_of_next_round_first_block(const controller& control){
       auto res = control.head_block_num() + 1;
-      const auto blocks_per_round = control.head_block_state()->active_schedule.producers.size() * config::producer_repetitions;
+      const auto blocks_per_round = control.head_block_state()->active_schedule->producers.size() * config::producer_repetitions;
       while((res % blocks_per_round) != 0) {
          res++;
       }
@@ -50,7 +50,7 @@ BOOST_AUTO_TEST_SUITE(producer_schedule_tests)
       const auto& confirm_schedule_correctness = [&](const vector<producer_key>& new_prod_schd, const uint64_t eff_new_prod_schd_block_num)  {
          const uint32_t check_duration = 1000; // number of blocks
          for (uint32_t i = 0; i < check_duration; ++i) {
-            const auto current_schedule = control->head_block_state()->active_schedule.producers;
+            const auto current_schedule = control->head_block_state()->active_schedule->producers;
             const auto& current_absolute_slot = control->get_global_properties().proposed_schedule_block_num;
             // Determine expected producer
             const auto& expected_producer = get_expected_producer(current_schedule, *current_absolute_slot + 1);
@@ -665,4 +665,47 @@ BOOST_AUTO_TEST_CASE( large_authority_overflow_test ) try {
    BOOST_REQUIRE_EQUAL(res.second, provided_keys.size());
 } FC_LOG_AND_RETHROW()
 
+BOOST_AUTO_TEST_CASE( unchanged_schedules_are_shared ) try {
+   tester c;
+   c.create_accounts( {N(alice),N(bob)} );
+   c.produce_block();
+   c.set_producers( {N(alice),N(bob)} );
+
+   bool saw_pending = false;
+   for( uint32_t i = 0; i < 100 && c.control->head_block_state()->active_schedule->version == 0; ++i ) {
+      auto prev = c.control->head_block_state();
+      c.produce_block();
+      auto head = c.control->head_block_state();
+
+      if( head->active_schedule->version == 0 )
+         BOOST_CHECK( head->active_schedule.shares_with( prev->active_schedule ) );
+      else // promoted
+         BOOST_CHECK( head->active_schedule.shares_with( prev->pending_schedule.schedule ) );
+      if( head->pending_schedule.schedule == prev->pending_schedule.schedule )
+         BOOST_CHECK( head->pending_schedule.schedule.shares_with( prev->pending_schedule.schedule ) );
+      BOOST_CHECK( head->activated_protocol_features == prev->activated_protocol_features );
+      saw_pending = saw_pending || head->has_pending_producers();
+   }
+   BOOST_REQUIRE( saw_pending );
+   BOOST_REQUIRE_EQUAL( c.control->head_block_state()->active_schedule->version, 1u );
+
+   // the shared schedule packs exactly as the schedule it holds
+   auto head = c.control->head_block_state();
+   BOOST_CHECK( fc::raw::pack( head->active_schedule ) == fc::raw::pack( head->active_schedule.get() ) );
+   auto unpacked = fc::raw::unpack<block_header_state>( fc::raw::pack( static_cast<const block_header_state&>( *head ) ) );
+   BOOST_CHECK( unpacked.active_schedule == head->active_schedule );
+   BOOST_CHECK( !unpacked.active_schedule.shares_with( head->active_schedule ) );
+
+   // states read back from the fork database share their parent's copies again
+   c.produce_blocks( 4 );
+   c.close();
+   c.open();
+   head = c.control->head_block_state();
+   auto prev = c.control->fetch_block_state_by_id( head->prev() );
+   BOOST_REQUIRE( prev );
+   BOOST_CHECK( head->active_schedule.shares_with( prev->active_schedule ) );
+   BOOST_CHECK( head->pending_schedule.schedule.shares_with( prev->pending_schedule.schedule ) );
+   BOOST_CHECK( head->activated_protocol_features == prev->activated_protocol_features );
+} FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1555,6 +1555,59 @@ BOOST_AUTO_TEST_CASE( set_proposed_producers_ex_test ) { try {
    c.produce_block();
 } FC_LOG_AND_RETHROW() }
 
+static const char batched_db_intrinsics_wast[] = R"=====(
+(module
+ (import "env" "db_store_i64_batch" (func $store_batch (param i64 i64 i64 i32 i32) (result i32)))
+ (import "env" "db_get_i64_batch" (func $get_batch (param i32 i32 i32 i32 i32) (result i32)))
+ (import "env" "db_lowerbound_i64" (func $lowerbound (param i64 i64 i64 i64) (result i32)))
+ (import "env" "db_end_i64" (func $end (param i64 i64 i64) (result i32)))
+ (import "env" "memcmp" (func $memcmp (param i32 i32 i32) (result i32)))
+ (import "env" "eosio_assert" (func $assert (param i32 i32)))
+ (memory $0 1)
+ (export "apply" (func $apply))
+ (func $apply (param $0 i64) (param $1 i64) (param $2 i64)
+   (local $itr i32)
+   (call $assert (i32.eq (call $store_batch (get_local $0) (i64.const 1) (get_local $0) (i32.const 0) (i32.const 39)) (i32.const 3)) (i32.const 4096))
+   (set_local $itr (call $lowerbound (get_local $0) (get_local $0) (i64.const 1) (i64.const 0)))
+   (set_local $itr (call $get_batch (get_local $itr) (i32.const 2) (i32.const 1024) (i32.const 1024) (i32.const 2048)))
+   (call $assert (i32.eq (i32.load (i32.const 2048)) (i32.const 2)) (i32.const 4112))
+   (set_local $itr (call $get_batch (get_local $itr) (i32.const 10) (i32.const 1050) (i32.const 998) (i32.const 2048)))
+   (call $assert (i32.eq (i32.load (i32.const 2048)) (i32.const 1)) (i32.const 4112))
+   (call $assert (i32.eq (get_local $itr) (call $end (get_local $0) (get_local $0) (i64.const 1))) (i32.const 4128))
+   (call $assert (i32.eqz (call $memcmp (i32.const 0) (i32.const 1024) (i32.const 39))) (i32.const 4144))
+ )
+ (data (i32.const 0) "\01\00\00\00\00\00\00\00\01\00\00\00a\02\00\00\00\00\00\00\00\01\00\00\00b\03\00\00\00\00\00\00\00\01\00\00\00c")
+ (data (i32.const 4096) "store failed\00")
+ (data (i32.const 4112) "wrong row count\00")
+ (data (i32.const 4128) "not at end\00")
+ (data (i32.const 4144) "data mismatch\00")
+)
+)=====";
+
+BOOST_AUTO_TEST_CASE( batched_db_intrinsics_test ) { try {
+   tester c( setup_policy::preactivate_feature_and_new_bios );
+
+   const auto& pfm = c.control->get_protocol_feature_manager();
+   const auto& d = pfm.get_builtin_digest(builtin_protocol_feature_t::batched_db_intrinsics);
+   BOOST_REQUIRE(d);
+
+   const auto& alice_account = account_name("alice");
+   c.create_accounts( {alice_account} );
+   c.produce_block();
+
+   BOOST_CHECK_EXCEPTION(  c.set_code( alice_account, batched_db_intrinsics_wast ),
+                           wasm_exception,
+                           fc_exception_message_is( "env.db_store_i64_batch unresolveable" ) );
+
+   c.preactivate_protocol_features( {*d} );
+   c.produce_block();
+
+   c.set_code( alice_account, batched_db_intrinsics_wast );
+   BOOST_REQUIRE_EQUAL(c.push_action(action({{ alice_account, permission_name("active") }}, alice_account, action_name(), {} ), alice_account.to_uint64_t()), c.success());
+
+   c.produce_block();
+} FC_LOG_AND_RETHROW() }
+
 BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
    tester c( setup_policy::preactivate_feature_and_new_bios );
 
@@ -1587,7 +1640,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
       emplace_extension(
               bad_block->header_extensions,
               producer_schedule_change_extension::extension_id(),
-              fc::raw::pack(std::make_pair(hbs->active_schedule.version + 1, std::vector<char>{}))
+              fc::raw::pack(std::make_pair(hbs->active_schedule->version + 1, std::vector<char>{}))
       );
 
       // re-sign the bad block
@@ -1607,7 +1660,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
 
       // create a bad block that has the producer schedule change extension before the feature upgrade
       auto bad_block = std::make_shared<signed_block>(last_legacy_block->clone());
-      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule.version + 1, {}};
+      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule->version + 1, {}};
 
       // re-sign the bad block
       auto header_bmroot = digest_type::hash( std::make_pair( bad_block->digest(), remote.control->head_block_state()->blockroot_merkle ) );
@@ -1634,7 +1687,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
       emplace_extension(
               bad_block->header_extensions,
               producer_schedule_change_extension::extension_id(),
-              fc::raw::pack(std::make_pair(hbs->active_schedule.version + 1, std::vector<char>{}))
+              fc::raw::pack(std::make_pair(hbs->active_schedule->version + 1, std::vector<char>{}))
       );
 
       // re-sign the bad block
@@ -1654,7 +1707,7 @@ BOOST_AUTO_TEST_CASE( producer_schedule_change_extension_test ) { try {
 
       // create a bad block that has the producer schedule change extension before the feature upgrade
       auto bad_block = std::make_shared<signed_block>(first_new_block->clone());
-      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule.version + 1, {}};
+      bad_block->new_producers = legacy::producer_schedule_type{hbs->active_schedule->version + 1, {}};
 
       // re-sign the bad block
       auto header_bmroot = digest_type::hash( std::make_pair( bad_block->digest(), remote.control->head_block_state()->blockroot_merkle ) );
@@ -334,4 +334,51 @@ BOOST_AUTO_TEST_SUITE(resource_limits_test)
       add_transaction_usage( {N(dan)}, 34, 0, 2 + blocks_per_day );
    } FC_LOG_AND_RETHROW()
 
+   BOOST_FIXTURE_TEST_CASE(bandwidth_limits_match, resource_limits_fixture) try {
+      initialize_account( N(dan) );
+      initialize_account( N(everyone) );
+      set_account_limits( N(dan), 0, 1'000, 1'0000 );
+      set_account_limits( N(everyone), 0, 1'000'000, 1'000'000'0000 );
+      process_account_limit_updates();
+
+      add_transaction_usage( {N(dan)}, 10, 100, 1 );
+
+      for( uint32_t greylist_limit : { 1u, 100u, config::maximum_elastic_resource_multiplier } ) {
+         auto limits = get_account_bandwidth_limits( N(dan), greylist_limit );
+         auto [cpu, cpu_greylisted] = get_account_cpu_limit_ex( N(dan), greylist_limit );
+         auto [net, net_greylisted] = get_account_net_limit_ex( N(dan), greylist_limit );
+         BOOST_CHECK_EQUAL( limits.cpu.used, cpu.used );
+         BOOST_CHECK_EQUAL( limits.cpu.available, cpu.available );
+         BOOST_CHECK_EQUAL( limits.cpu.max, cpu.max );
+         BOOST_CHECK_EQUAL( limits.cpu_greylisted, cpu_greylisted );
+         BOOST_CHECK_EQUAL( limits.net.used, net.used );
+         BOOST_CHECK_EQUAL( limits.net.available, net.available );
+         BOOST_CHECK_EQUAL( limits.net.max, net.max );
+         BOOST_CHECK_EQUAL( limits.net_greylisted, net_greylisted );
+      }
+
+      // unlimited weights
+      initialize_account( N(unlimited) );
+      auto limits = get_account_bandwidth_limits( N(unlimited) );
+      BOOST_CHECK_EQUAL( limits.cpu.available, -1 );
+      BOOST_CHECK_EQUAL( limits.net.available, -1 );
+   } FC_LOG_AND_RETHROW()
+
+   BOOST_FIXTURE_TEST_CASE(update_usage_same_slot_is_noop, resource_limits_fixture) try {
+      initialize_account( N(dan) );
+      set_account_limits( N(dan), 0, 1'000, 1'000 );
+      process_account_limit_updates();
+      add_transaction_usage( {N(dan)}, 10, 100, 5 );
+
+      const auto before = get_account_cpu_limit_ex( N(dan) ).first;
+      update_account_usage( {N(dan)}, 5 );
+      const auto after = get_account_cpu_limit_ex( N(dan) ).first;
+      BOOST_CHECK_EQUAL( before.used, after.used );
+      BOOST_CHECK_EQUAL( before.available, after.available );
+
+      // a later slot still decays the usage
+      update_account_usage( {N(dan)}, 6 );
+      BOOST_CHECK_LT( get_account_cpu_limit_ex( N(dan) ).first.used, before.used );
+   } FC_LOG_AND_RETHROW()
+
 BOOST_AUTO_TEST_SUITE_END()
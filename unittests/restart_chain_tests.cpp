@@ -1,3 +1,4 @@
+#include <fstream>
 #include <sstream>
 
 #include <eosio/chain/block_log.hpp>
@@ -78,4 +79,212 @@ BOOST_AUTO_TEST_CASE(test_restart_with_different_chain_id)
    BOOST_REQUIRE_EXCEPTION(other.open(chain_id), chain_id_type_exception, fc_exception_message_starts_with("chain ID in state "));
 }
 
+BOOST_AUTO_TEST_CASE(test_block_log_mmap_and_cache_reads)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log plain(cfg.blocks_dir);
+   block_log mapped(cfg.blocks_dir, true, 4);
+
+   BOOST_REQUIRE(plain.head());
+   BOOST_REQUIRE_EQUAL(plain.head_id(), mapped.head_id());
+   const uint32_t head_num = plain.head()->block_num();
+   BOOST_REQUIRE_GT(head_num, 10u);
+
+   // read twice so the second pass is served from the cache
+   for (int pass = 0; pass < 2; ++pass) {
+      for (uint32_t n = plain.first_block_num(); n <= head_num; ++n) {
+         auto expected = plain.read_block_by_num(n);
+         auto actual = mapped.read_block_by_num(n);
+         BOOST_REQUIRE(expected && actual);
+         BOOST_CHECK_EQUAL(expected->id(), actual->id());
+         BOOST_CHECK_EQUAL(plain.read_block_id_by_num(n), mapped.read_block_id_by_num(n));
+      }
+   }
+   BOOST_CHECK(!mapped.read_block_by_num(head_num + 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_cache_invalidated_on_reopen)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+
+   tester other;
+   other.create_account(N(alice));
+   other.produce_blocks(20);
+   other.close();
+
+   block_log cached(chain.get_config().blocks_dir, false, 4);
+   auto original = cached.read_block_by_num(10);
+   BOOST_REQUIRE(original);
+   BOOST_REQUIRE_EQUAL(cached.read_block_by_num(10), original); // served from the cache
+
+   const auto expected = block_log(other.get_config().blocks_dir).read_block_id_by_num(10);
+   BOOST_REQUIRE_NE(expected, original->id());
+
+   // the same block number now names a different block, the cached one must not be returned
+   cached.open(other.get_config().blocks_dir);
+   auto reread = cached.read_block_by_num(10);
+   BOOST_REQUIRE(reread);
+   BOOST_CHECK_EQUAL(reread->id(), expected);
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_serialized_reads)
+{
+   tester chain;
+   chain.produce_blocks(10);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log plain(cfg.blocks_dir);
+   block_log mapped(cfg.blocks_dir, true);
+   const uint32_t head_num = plain.head()->block_num();
+
+   for (uint32_t n = plain.first_block_num(); n <= head_num; ++n) {
+      const auto expected = fc::raw::pack(*plain.read_block_by_num(n));
+      for (const block_log* blog : {&plain, &mapped}) {
+         auto serialized = blog->read_serialized_block_by_num(n, 5);
+         BOOST_REQUIRE_EQUAL(serialized.size(), expected.size() + 5);
+         BOOST_CHECK(std::equal(expected.begin(), expected.end(), serialized.begin() + 5));
+      }
+   }
+   BOOST_CHECK(plain.read_serialized_block_by_num(head_num + 1).empty());
+   BOOST_CHECK(mapped.read_serialized_block_by_num(head_num + 1).empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_prefetcher)
+{
+   tester chain;
+   chain.produce_blocks(20);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log blog(cfg.blocks_dir);
+   const uint32_t head_num = blog.head()->block_num();
+
+   // a read ahead smaller than the range makes the reader wait for the consumer
+   block_log_prefetcher reader(cfg.blocks_dir, 3, head_num, 2);
+   for (uint32_t n = 3; n <= head_num; ++n) {
+      auto b = reader.next();
+      BOOST_REQUIRE(b);
+      BOOST_CHECK_EQUAL(b->id(), blog.read_block_id_by_num(n));
+   }
+   BOOST_CHECK(!reader.next());
+
+   // stopping before the end joins the reader
+   block_log_prefetcher partial(cfg.blocks_dir, 1, head_num, 1);
+   BOOST_CHECK(partial.next());
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_archive)
+{
+   tester chain;
+   chain.produce_blocks(30);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   std::vector<block_id_type> ids;
+   uint32_t head_num = 0;
+   {
+      block_log blog(cfg.blocks_dir);
+      head_num = blog.head()->block_num();
+      for (uint32_t n = 1; n <= head_num; ++n)
+         ids.push_back(blog.read_block_id_by_num(n));
+   }
+
+   // archive twice, the second run appends to the archive of the first
+   BOOST_REQUIRE(block_log_archive::archive_blocklog_front(cfg.blocks_dir, cfg.blocks_dir / "old", 10, 4));
+   BOOST_REQUIRE(block_log_archive::archive_blocklog_front(cfg.blocks_dir, cfg.blocks_dir / "old", 20, 4));
+   BOOST_REQUIRE(!block_log_archive::archive_blocklog_front(cfg.blocks_dir, cfg.blocks_dir / "old", 20, 4));
+
+   block_log_archive archive(cfg.blocks_dir);
+   BOOST_CHECK_EQUAL(archive.first_block_num(), 1u);
+   BOOST_CHECK_EQUAL(archive.last_block_num(), 19u);
+
+   block_log blog(cfg.blocks_dir);
+   BOOST_CHECK_EQUAL(blog.first_block_num(), 20u);
+   for (uint32_t n = 1; n <= head_num; ++n) {
+      auto b = blog.read_block_by_num(n);
+      BOOST_REQUIRE(b);
+      BOOST_CHECK_EQUAL(b->id(), ids[n - 1]);
+      BOOST_CHECK_EQUAL(blog.read_block_id_by_num(n), ids[n - 1]);
+   }
+   BOOST_CHECK(!blog.read_block_by_num(head_num + 1));
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_stride)
+{
+   tester chain;
+   chain.produce_blocks(40);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   block_log original(cfg.blocks_dir);
+   const auto stride_dir = cfg.blocks_dir.parent_path() / "stride_blocks";
+   const block_log_stride_config stride{10, 2, stride_dir / "archive"};
+   {
+      block_log blog(stride_dir, false, 0, stride);
+      blog.reset(*block_log::extract_genesis_state(cfg.blocks_dir), original.read_block_by_num(1));
+      for (uint32_t n = 2; n <= 30; ++n)
+         blog.append(original.read_block_by_num(n));
+
+      // 1-10 was moved to the archive dir when 21-30 was rolled off
+      BOOST_CHECK(fc::exists(stride_dir / "archive" / "blocks-1-10.log"));
+      BOOST_CHECK(fc::exists(stride_dir / "blocks-11-20.log"));
+      BOOST_CHECK(fc::exists(stride_dir / "blocks-21-30.log"));
+      BOOST_CHECK_EQUAL(blog.first_block_num(), 11u);
+      BOOST_CHECK_EQUAL(blog.head_id(), original.read_block_id_by_num(30));
+      BOOST_CHECK(!blog.read_block_by_num(10));
+      for (uint32_t n = 11; n <= 30; ++n)
+         BOOST_CHECK_EQUAL(blog.read_block_id_by_num(n), original.read_block_id_by_num(n));
+   }
+
+   // reopened, the head is the last block of the newest range and appends continue after it
+   block_log blog(stride_dir, false, 0, stride);
+   BOOST_REQUIRE(blog.head());
+   BOOST_CHECK_EQUAL(blog.head()->block_num(), 30u);
+   BOOST_CHECK_EQUAL(blog.first_block_num(), 11u);
+   blog.append(original.read_block_by_num(31));
+   BOOST_CHECK_EQUAL(blog.read_block_id_by_num(31), original.read_block_id_by_num(31));
+   BOOST_CHECK_EQUAL(blog.read_block_id_by_num(15), original.read_block_id_by_num(15));
+
+   block_log_prefetcher reader(stride_dir, 11, 31, 4);
+   for (uint32_t n = 11; n <= 31; ++n) {
+      auto b = reader.next();
+      BOOST_REQUIRE(b);
+      BOOST_CHECK_EQUAL(b->id(), original.read_block_id_by_num(n));
+   }
+   BOOST_CHECK(!reader.next());
+}
+
+BOOST_AUTO_TEST_CASE(test_block_log_index_rebuild_and_repair)
+{
+   tester chain;
+   chain.produce_blocks(30);
+   chain.close();
+
+   auto cfg = chain.get_config();
+   auto read_file = [](const fc::path& p) {
+      std::ifstream in(p.generic_string(), std::ios::binary);
+      return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+   };
+   const auto log_contents = read_file(cfg.blocks_dir / "blocks.log");
+   const auto index_contents = read_file(cfg.blocks_dir / "blocks.index");
+
+   block_log::construct_index(cfg.blocks_dir / "blocks.log", cfg.blocks_dir / "rebuilt.index");
+   BOOST_CHECK(read_file(cfg.blocks_dir / "rebuilt.index") == index_contents);
+
+   // a torn write at the tail is dropped, the blocks before it come through unchanged
+   {
+      std::ofstream out((cfg.blocks_dir / "blocks.log").generic_string(), std::ios::binary | std::ios::app);
+      out << std::string(100, '\x7f');
+   }
+   block_log::repair_log(cfg.blocks_dir);
+   BOOST_CHECK(read_file(cfg.blocks_dir / "blocks.log") == log_contents);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
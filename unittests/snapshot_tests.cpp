@@ -1,6 +1,9 @@
+#include <fstream>
+#include <future>
 #include <sstream>
 
 #include <eosio/chain/block_log.hpp>
+#include <eosio/chain/code_object.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/snapshot.hpp>
 #include <eosio/testing/tester.hpp>
@@ -581,4 +584,272 @@ BOOST_AUTO_TEST_CASE_TEMPLATE(test_restart_with_existing_state_and_truncated_blo
    verify_integrity_hash<SNAPSHOT_SUITE>(*chain.control, *snap_chain.control);
 }
 
+BOOST_AUTO_TEST_CASE(test_packed_rows_match_sequential_rows)
+{
+   tester chain;
+   const auto& db = chain.control->db();
+   auto write_rows = [&]( bool packed ) {
+      std::ostringstream out;
+      ostream_snapshot_writer writer(out);
+      writer.write_section("contract_tables", [&]( auto& section ) {
+         detail::packed_rows_buffer buffer;
+         for( uint32_t i = 0; i < 1000; ++i ) {
+            if( packed )
+               buffer.add_row(unsigned_int(i), db);
+            else
+               section.add_row(unsigned_int(i), db);
+         }
+         if( packed )
+            section.add_packed_rows(buffer.data(), buffer.row_count);
+      });
+      writer.finalize();
+      return out.str();
+   };
+
+   auto expected = write_rows(false);
+   BOOST_REQUIRE_EQUAL(expected, write_rows(true));
+
+   std::istringstream in(expected);
+   istream_snapshot_reader reader(in);
+   reader.validate();
+   uint32_t rows = 0;
+   reader.read_section("contract_tables", [&]( auto& section ) {
+      bool more = !section.empty();
+      while( more ) {
+         unsigned_int value;
+         more = section.read_row(value, db);
+         BOOST_REQUIRE_EQUAL(value.value, rows++);
+      }
+   });
+   BOOST_REQUIRE_EQUAL(rows, 1000u);
+
+   fc::mutable_variant_object variant_storage;
+   variant_snapshot_writer variant_writer(variant_storage);
+   BOOST_REQUIRE(!variant_writer.supports_packed_rows());
+}
+
+
+BOOST_AUTO_TEST_CASE(test_indexed_snapshot)
+{
+   tester chain;
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   chain.set_code(N(snapshot), contracts::snapshot_test_wasm());
+   chain.set_abi(N(snapshot), contracts::snapshot_test_abi().data());
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   // small chunks so that sections span several of them
+   std::ostringstream out;
+   auto writer = std::make_shared<indexed_snapshot_writer>(out, indexed_snapshot_writer::compression_type::zlib, 256);
+   chain.control->write_snapshot(writer);
+   writer->finalize();
+   const auto snapshot = out.str();
+
+   std::ostringstream plain_out;
+   auto plain_writer = std::make_shared<ostream_snapshot_writer>(plain_out);
+   chain.control->write_snapshot(plain_writer);
+   plain_writer->finalize();
+   BOOST_TEST_MESSAGE("indexed snapshot is " << snapshot.size() << " bytes, binary snapshot " << plain_out.str().size());
+
+   auto reader = std::make_shared<indexed_snapshot_reader>(snapshot.data(), snapshot.size());
+   reader->validate();
+   snapshotted_tester snap_chain(chain.get_config(), reader, 1);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+
+   auto block = chain.produce_block();
+   snap_chain.push_block(block);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+
+   // a flipped byte in any chunk fails validation
+   auto corrupt = snapshot;
+   corrupt[sizeof(uint32_t) * 2 + 1] ^= 0xff;
+   BOOST_REQUIRE_THROW(indexed_snapshot_reader(corrupt.data(), corrupt.size()).validate(), snapshot_exception);
+
+   // as does a truncated one
+   BOOST_REQUIRE_THROW(indexed_snapshot_reader(snapshot.data(), snapshot.size() - 1), snapshot_exception);
+}
+
+
+BOOST_AUTO_TEST_CASE(test_compressed_contract_code)
+{
+   fc::temp_directory tempdir;
+   tester chain( tempdir, []( controller::config& cfg ) { cfg.compress_contract_code = true; }, true );
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(1);
+   const auto wasm = contracts::snapshot_test_wasm();
+   chain.set_code(N(snapshot), wasm);
+   {
+      // setcode stores the code as sent, it is compressed when its block is finalized
+      const auto& m = chain.control->db().get<account_metadata_object, by_name>(N(snapshot));
+      const auto& c = chain.control->db().get<code_object, by_code_hash>(m.code_hash);
+      BOOST_REQUIRE(!code_compression::is_compressed(c.code.data(), c.code.size()));
+   }
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   const auto& metadata = chain.control->db().get<account_metadata_object, by_name>(N(snapshot));
+   const auto& code = chain.control->db().get<code_object, by_code_hash>(metadata.code_hash);
+   BOOST_REQUIRE(code_compression::is_compressed(code.code.data(), code.code.size()));
+   BOOST_REQUIRE_LT(code.code.size(), wasm.size());
+   BOOST_REQUIRE_EQUAL(code.code_size(), wasm.size());
+   BOOST_REQUIRE(code.with_code([&](std::string_view stored) { return stored == std::string_view((const char*)wasm.data(), wasm.size()); }));
+
+   // the snapshot holds the code uncompressed, and a node that does not compress has the same state from it
+   auto writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   auto snapshot = buffered_snapshot_suite::finalize(writer);
+   auto config = chain.get_config();
+   config.compress_contract_code = false;
+   snapshotted_tester snap_chain(config, buffered_snapshot_suite::get_reader(snapshot), 1);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+   const auto& snap_code = snap_chain.control->db().get<code_object, by_code_hash>(metadata.code_hash);
+   BOOST_REQUIRE_EQUAL(snap_code.code.size(), wasm.size());
+
+   auto block = chain.produce_block();
+   snap_chain.push_block(block);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+}
+
+BOOST_AUTO_TEST_CASE(test_partial_snapshot)
+{
+   tester chain;
+   const std::vector<account_name> codes{N(snapshot), N(snapshot1)};
+   chain.create_accounts(codes);
+   chain.produce_blocks(1);
+   for (auto c : codes) {
+      chain.set_code(c, contracts::snapshot_test_wasm());
+      chain.set_abi(c, contracts::snapshot_test_abi().data());
+   }
+   chain.produce_blocks(1);
+   for (auto c : codes)
+      chain.push_action(c, N(increment), c, mutable_variant_object()("value", 1));
+   chain.produce_blocks(1);
+   chain.control->abort_block();
+
+   auto writer = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(writer);
+   auto snapshot = buffered_snapshot_suite::finalize(writer);
+
+   auto config = chain.get_config();
+   config.snapshot_contracts = {N(snapshot)};
+   snapshotted_tester snap_chain(config, buffered_snapshot_suite::get_reader(snapshot), 1);
+   BOOST_REQUIRE(snap_chain.control->is_partial_state());
+
+   const auto count_tables = [](const controller& control, account_name code) {
+      const auto& idx = control.db().get_index<table_id_multi_index, by_code_scope_table>();
+      return std::distance(idx.lower_bound(boost::make_tuple(code)), idx.upper_bound(boost::make_tuple(code)));
+   };
+   BOOST_REQUIRE_GT(count_tables(*chain.control, N(snapshot)), 0);
+   BOOST_REQUIRE_EQUAL(count_tables(*snap_chain.control, N(snapshot)), count_tables(*chain.control, N(snapshot)));
+   BOOST_REQUIRE_EQUAL(count_tables(*snap_chain.control, N(snapshot1)), 0);
+   BOOST_REQUIRE_EQUAL(snap_chain.control->db().get_index<key_value_index>().size(), 1u);
+   BOOST_REQUIRE_EQUAL(snap_chain.control->db().get_index<index64_index>().size(), 1u);
+
+   // the rest of the state is whole, but blocks of the full chain cannot be applied to it
+   BOOST_REQUIRE(snap_chain.control->db().find<account_object, by_name>(N(snapshot1)));
+   BOOST_REQUIRE_THROW(snap_chain.push_block(chain.produce_block()), block_validate_exception);
+   BOOST_REQUIRE_THROW(snap_chain.control->write_snapshot(buffered_snapshot_suite::get_writer()), snapshot_exception);
+}
+
+BOOST_AUTO_TEST_CASE(test_snapshot_at_committed_block)
+{
+   tester chain;
+   std::vector<std::pair<block_id_type, std::string>> snapshots;
+   bool accepted_with_pending = false;
+   auto accepted = chain.control->accepted_block.connect([&](const block_state_ptr& bsp) {
+      accepted_with_pending = chain.control->is_building_block();
+   });
+   auto committed = chain.control->committed_block.connect([&](const block_state_ptr& bsp) {
+      BOOST_REQUIRE(!chain.control->is_building_block());
+      BOOST_REQUIRE_EQUAL(chain.control->head_block_id(), bsp->id);
+      auto writer = buffered_snapshot_suite::get_writer();
+      chain.control->write_snapshot(writer);
+      snapshots.emplace_back(bsp->id, buffered_snapshot_suite::finalize(writer));
+   });
+
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(3);
+   BOOST_REQUIRE(accepted_with_pending);
+   BOOST_REQUIRE_EQUAL(snapshots.size(), 3u);
+   BOOST_REQUIRE_EQUAL(snapshots.back().first, chain.control->head_block_id());
+
+   chain.control->abort_block();
+   snapshotted_tester snap_chain(chain.get_config(), buffered_snapshot_suite::get_reader(snapshots.back().second), 1);
+   verify_integrity_hash<buffered_snapshot_suite>(*chain.control, *snap_chain.control);
+}
+
+BOOST_AUTO_TEST_CASE(test_snapshot_at_committed_pushed_block)
+{
+   tester chain;
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(3);
+
+   // a node applying the blocks of others, as a non-producing node does
+   tester validator(setup_policy::none);
+   std::vector<block_id_type> committed;
+   auto connection = validator.control->committed_block.connect([&](const block_state_ptr& bsp) {
+      BOOST_REQUIRE(!validator.control->is_building_block());
+      BOOST_REQUIRE_EQUAL(validator.control->head_block_id(), bsp->id);
+      auto writer = buffered_snapshot_suite::get_writer();
+      validator.control->write_snapshot(writer);
+      buffered_snapshot_suite::finalize(writer);
+      committed.push_back(bsp->id);
+   });
+
+   const uint32_t first = validator.control->head_block_num() + 1;
+   for (uint32_t n = first; n <= chain.control->head_block_num(); ++n)
+      validator.push_block(chain.control->fetch_block_by_number(n));
+   BOOST_REQUIRE_EQUAL(committed.size(), chain.control->head_block_num() - first + 1);
+   BOOST_REQUIRE_EQUAL(committed.back(), chain.control->head_block_id());
+}
+
+BOOST_AUTO_TEST_CASE(test_snapshot_chunk_queue)
+{
+   tester chain;
+   chain.create_account(N(snapshot));
+   chain.produce_blocks(2);
+   chain.control->abort_block();
+
+   auto expected = buffered_snapshot_suite::get_writer();
+   chain.control->write_snapshot(expected);
+   const auto expected_bytes = buffered_snapshot_suite::finalize(expected);
+
+   // chunks much smaller than sections, so section headers are patched in chunks already handed off
+   fc::temp_directory dir;
+   const auto path = dir.path() / "snapshot.bin";
+   snapshot_chunk_queue chunks(64);
+   auto written = std::async(std::launch::async, [&]() {
+      std::ofstream out(path.generic_string(), std::ios::out | std::ios::binary);
+      return chunks.write_to(out) && out.flush().good();
+   });
+   {
+      std::ostream out(&chunks);
+      auto writer = std::make_shared<ostream_snapshot_writer>(out);
+      chain.control->write_snapshot(writer);
+      writer->finalize();
+      BOOST_REQUIRE(out.flush().good());
+   }
+   chunks.close();
+   BOOST_REQUIRE(written.get());
+   BOOST_REQUIRE_EQUAL(chunks.size(), expected_bytes.size());
+
+   std::ifstream in(path.generic_string(), std::ios::in | std::ios::binary);
+   const std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+   BOOST_REQUIRE(bytes == expected_bytes);
+
+   // an aborted queue writes nothing more
+   snapshot_chunk_queue aborted(64);
+   auto aborted_written = std::async(std::launch::async, [&]() {
+      std::ostringstream out;
+      return aborted.write_to(out);
+   });
+   {
+      std::ostream out(&aborted);
+      out << std::string(1000, 'x');
+   }
+   aborted.abort();
+   BOOST_REQUIRE(!aborted_written.get());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,64 @@
+#include <boost/test/unit_test.hpp>
+
+#include <eosio/testing/tester.hpp>
+#include <eosio/chain/account_object.hpp>
+
+using namespace eosio;
+using namespace eosio::chain;
+using namespace eosio::testing;
+
+BOOST_AUTO_TEST_SUITE(state_replica_tests)
+
+BOOST_AUTO_TEST_CASE( replica_reads_the_state_and_blocks_of_its_primary ) try {
+   fc::temp_directory primary_dir;
+   tester primary( primary_dir, []( controller::config& cfg ) { cfg.publish_replica_head = true; }, true );
+   primary.create_account( N(alice) );
+   primary.produce_blocks( 3 );
+   // the tester keeps the next block pending, which holds the state off the head
+   primary.control->abort_block();
+
+   fc::temp_directory replica_dir;
+   auto cfg = tester::default_config( replica_dir ).first;
+   cfg.state_dir = primary_dir.path() / config::default_state_dir_name;
+   cfg.replica_blocks_dir = primary_dir.path() / config::default_blocks_dir_name;
+   cfg.state_replica = true;
+   controller replica( cfg, make_protocol_feature_set(), primary.control->get_chain_id() );
+   replica.add_indices();
+   replica.startup( []() { return false; } );
+   BOOST_REQUIRE_EQUAL( replica.head_block_id(), primary.control->head_block_id() );
+   BOOST_REQUIRE_EQUAL( replica.last_irreversible_block_num(), primary.control->last_irreversible_block_num() );
+
+   replica.read_state( [&]() {
+      BOOST_CHECK( replica.db().find<account_object, by_name>( N(alice) ) );
+      // the head from the reversible blocks of the primary, older blocks from its block log
+      for( uint32_t n : { 1u, replica.last_irreversible_block_num(), replica.head_block_num() } ) {
+         const auto b = replica.fetch_block_by_number( n );
+         BOOST_REQUIRE( b );
+         BOOST_CHECK_EQUAL( b->id(), primary.control->fetch_block_by_number( n )->id() );
+         BOOST_CHECK_EQUAL( replica.get_block_id_for_num( n ), b->id() );
+      }
+      BOOST_CHECK( !replica.fetch_block_by_number( replica.head_block_num() + 1 ) );
+      return true;
+   } );
+
+   // the primary does not wait on a read in progress, the read is discarded instead
+   bool read_bob = false;
+   BOOST_CHECK_THROW( replica.read_state( [&]() {
+      primary.create_account( N(bob) );
+      primary.produce_block();
+      read_bob = replica.db().find<account_object, by_name>( N(bob) ) != nullptr;
+      return read_bob;
+   } ), replica_state_exception );
+   BOOST_CHECK( read_bob );
+
+   // not at a block boundary while a block is pending
+   BOOST_CHECK( !replica.refresh_replica_head() );
+   BOOST_CHECK_THROW( replica.read_state( []() { return true; } ), replica_state_exception );
+   primary.control->abort_block();
+   BOOST_REQUIRE( replica.refresh_replica_head() );
+   BOOST_CHECK_EQUAL( replica.head_block_id(), primary.control->head_block_id() );
+   BOOST_CHECK( replica.read_state( [&]() { return replica.db().find<account_object, by_name>( N(bob) ) != nullptr; } ) );
+   BOOST_CHECK_EQUAL( replica.fetch_block_by_number( replica.head_block_num() )->id(), replica.head_block_id() );
+} FC_LOG_AND_RETHROW()
+
+BOOST_AUTO_TEST_SUITE_END()
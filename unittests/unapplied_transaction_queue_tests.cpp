@@ -306,5 +306,39 @@ BOOST_AUTO_TEST_CASE( unapplied_transaction_queue_test ) try {
 
 } FC_LOG_AND_RETHROW() /// unapplied_transaction_queue_test
 
+BOOST_AUTO_TEST_CASE( unapplied_transaction_queue_priority_test ) try {
+
+   unapplied_transaction_queue q;
+
+   auto trx1 = unique_trx_meta_data();
+   auto trx2 = unique_trx_meta_data();
+   auto trx3 = unique_trx_meta_data();
+   auto trx4 = unique_trx_meta_data();
+
+   std::map<transaction_id_type, int64_t> priorities{ {trx1->id(), 1}, {trx2->id(), 5}, {trx3->id(), 5}, {trx4->id(), 9} };
+   q.set_priority_function( [&]( const transaction_metadata_ptr& trx ) { return priorities[trx->id()]; } );
+
+   // highest priority first, fifo for equal priority
+   q.add_aborted( { trx1, trx2, trx3, trx4 } );
+   BOOST_CHECK( q.size() == 4 );
+   BOOST_REQUIRE( next( q ) == trx4 );
+   BOOST_REQUIRE( next( q ) == trx2 );
+   BOOST_REQUIRE( next( q ) == trx3 );
+   BOOST_REQUIRE( next( q ) == trx1 );
+   BOOST_REQUIRE( next( q ) == nullptr );
+
+   // persisted still before aborted regardless of priority
+   q.add_aborted( { trx4 } );
+   q.add_persisted( trx1 );
+   q.add_persisted( trx2 );
+   BOOST_CHECK( q.contains_persisted() );
+   BOOST_REQUIRE( std::distance( q.persisted_begin(), q.persisted_end() ) == 2 );
+   BOOST_REQUIRE( next( q ) == trx2 );
+   BOOST_REQUIRE( next( q ) == trx1 );
+   BOOST_REQUIRE( next( q ) == trx4 );
+   BOOST_CHECK( q.empty() );
+
+} FC_LOG_AND_RETHROW() /// unapplied_transaction_queue_priority_test
+
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -2,6 +2,8 @@
 #include <utility>
 
 #include <eosio/chain/abi_serializer.hpp>
+#include <eosio/chain/account_object.hpp>
+#include <eosio/chain/code_object.hpp>
 #include <eosio/chain/exceptions.hpp>
 #include <eosio/chain/global_property_object.hpp>
 #include <eosio/chain/resource_limits.hpp>
@@ -157,6 +159,44 @@ BOOST_FIXTURE_TEST_CASE( prove_mem_reset, TESTER ) try {
 
 } FC_LOG_AND_RETHROW() /// prove_mem_reset
 
+/**
+ * Prove a code set on several accounts, validated once and prepared once, runs from each of them
+ */
+BOOST_FIXTURE_TEST_CASE( same_code_many_accounts, TESTER ) try {
+   produce_blocks(2);
+
+   const vector<account_name> accounts{ N(asserter), N(asserter2), N(asserter3) };
+   create_accounts( accounts );
+   produce_block();
+
+   const auto hits_before = wasm_interface::validation_cache_hits();
+   for( const auto& a : accounts )
+      set_code(a, contracts::asserter_wasm());
+   produce_blocks(1);
+   // at least every account after the first was answered by the validation cache, validating and pushed or not
+   BOOST_CHECK_GE( wasm_interface::validation_cache_hits() - hits_before, accounts.size() - 1 );
+
+   // and all of them run the one stored code
+   const auto& code_hash = control->db().get<account_metadata_object, by_name>( accounts[0] ).code_hash;
+   for( const auto& a : accounts )
+      BOOST_CHECK_EQUAL( code_hash, control->db().get<account_metadata_object, by_name>( a ).code_hash );
+   BOOST_CHECK_EQUAL( accounts.size(), control->db().get<code_object, by_code_hash>( code_hash ).code_ref_count );
+
+   for( const auto& a : accounts ) {
+      signed_transaction trx;
+      trx.actions.emplace_back( vector<permission_level>{{a,config::active_name}}, provereset {} );
+      trx.actions[0].account = a;
+
+      set_transaction_headers(trx);
+      trx.sign( get_private_key( a, "active" ), control->get_chain_id() );
+      push_transaction( trx );
+      produce_blocks(1);
+      BOOST_REQUIRE_EQUAL(true, chain_has_transaction(trx.id()));
+      BOOST_CHECK_EQUAL(transaction_receipt::executed, get_transaction_receipt(trx.id()).status);
+   }
+
+} FC_LOG_AND_RETHROW() /// same_code_many_accounts
+
 /**
  * Prove the modifications to global variables are wiped between runs
  */